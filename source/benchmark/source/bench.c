@@ -0,0 +1,688 @@
+/*
+ * tb_bench: micro-benchmarks of the operations of tb_ops.h and end-to-end graph benchmarks.
+ *
+ * Usage: tb_bench [--quick] [--filter substring] [--min-time seconds] [--threads n]
+ *                 [--json output.json] [--baseline baseline.json] [--tolerance ratio] [--profile]
+ *
+ * Every benchmark is a graph run through a prepared run (no allocation per iteration), timed as the median of
+ * BENCH_SAMPLES samples. A JSON output can be given back as --baseline to a later run, which then flags
+ * every benchmark slower than the baseline by more than the tolerance and exits with 1. --profile prints the
+ * per-node profile of one extra run of each graph. The JSON output also calibrates the roofline of the cost model
+ * (see `tb_calibrateRoofline`), which is printed at the end.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <inttypes.h>
+#include <stdint.h>
+
+#include "ndarray.h"
+#include "ndarray_std.h"
+
+#include <tb_session.h>
+#include <tb_graph.h>
+#include <tb_factory.h>
+#include <tb_ops.h>
+#include <tb_session_cpu.h>
+#include <tb_autograd.h>
+#include <tb_profiler.h>
+#include <tb_cost.h>
+
+#define BENCH_SAMPLES 5
+#define BENCH_NAME_LEN 128
+
+typedef struct BenchResult {
+    char name[BENCH_NAME_LEN];
+    double ns;                     /**< Median time of an iteration */
+    double flops;                  /**< Floating point operations of an iteration */
+    double bytes;                  /**< Bytes read and written by an iteration */
+    double elements;               /**< Output elements of an iteration */
+}BenchResult;
+
+typedef struct BenchConfig {
+    uint8_t quick;                 /**< Smallest sizes only */
+    const char* filter;            /**< Only benchmarks whose name contains it, NULL for all */
+    double min_time;               /**< Seconds spent measuring each benchmark */
+    uint64_t threads;              /**< Session threads, 0 for every online CPU */
+    const char* json;              /**< JSON output path, NULL for none */
+    const char* baseline;          /**< Baseline JSON path, NULL for none */
+    double tolerance;              /**< Accepted slowdown against the baseline, 0.1 = 10% */
+    uint8_t profile;               /**< Prints the per-node profile of each graph */
+    BenchResult* results;
+    uint64_t count;
+    uint64_t capacity;
+}BenchConfig;
+
+static BenchConfig config = {0, NULL, 0.2, 0, NULL, NULL, 0.1, 0, NULL, 0, 0};
+
+typedef void (*BenchFunc)(void* arg);
+
+static double _bench_now(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec*1e-9;
+}
+
+static uint8_t _bench_enabled(const char* name){
+    return (config.filter == NULL) || (strstr(name, config.filter) != NULL);
+}
+
+static int _bench_compareDouble(const void* a, const void* b){
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Median nanoseconds of an iteration. The repetitions of a sample are doubled until a sample lasts
+ * min_time/BENCH_SAMPLES, after a first untimed call which also plans prepared runs.
+ */
+static double _bench_measure(BenchFunc func, void* arg){
+    double samples[BENCH_SAMPLES];
+    uint64_t reps = 1, i, s;
+
+    func(arg);
+
+    for(;;){
+        double t0 = _bench_now();
+        for(i = 0; i < reps; i++)
+            func(arg);
+        if((_bench_now() - t0 >= config.min_time/BENCH_SAMPLES) || (reps >= ((uint64_t)1 << 30)))
+            break;
+        reps *= 2;
+    }
+
+    for(s = 0; s < BENCH_SAMPLES; s++){
+        double t0 = _bench_now();
+        for(i = 0; i < reps; i++)
+            func(arg);
+        samples[s] = (_bench_now() - t0)/reps;
+    }
+
+    qsort(samples, BENCH_SAMPLES, sizeof(double), _bench_compareDouble);
+
+    return samples[BENCH_SAMPLES/2]*1e9;
+}
+
+static void _bench_report(const char* name, double ns, double flops, double bytes, double elements){
+    if(config.count == config.capacity){
+        config.capacity = (config.capacity == 0) ? 64 : config.capacity*2;
+        config.results = realloc(config.results, config.capacity*sizeof(BenchResult));
+    }
+
+    BenchResult* r = &config.results[config.count++];
+    snprintf(r->name, BENCH_NAME_LEN, "%s", name);
+    r->ns = ns;
+    r->flops = flops;
+    r->bytes = bytes;
+    r->elements = elements;
+
+    printf("%-52s %14.1f ns %9.2f GFLOP/s %9.2f GB/s %9.3f ns/elem\n", name, ns, flops/ns, bytes/ns, ns/elements);
+    fflush(stdout);
+}
+
+/* * * * * * * * * * * *
+ * GRAPH RUNNERS       *
+ * * * * * * * * * * * */
+
+static TBGraphSession* _bench_session(void){
+    TBGraphSession* session = tb_createLocalCPUSession();
+    tb_sessionSetThreads(session, config.threads);
+
+    return session;
+}
+
+static void _bench_runPrepared(void* arg){
+    tb_runPrepared((TBPreparedRun*)arg);
+}
+
+/*
+ * Times the forward pass of the graph rooted at `root`, through a prepared run.
+ */
+static void _bench_graph(const char* name, TBNode* root, double flops, double bytes, double elements){
+    TBGraph* graph = tb_newGraph((char*)name, root);
+    TBGraphSession* session = _bench_session();
+    TBPreparedRun* run = tb_prepareRun(session, graph);
+    TBResultNode* res = tb_runPrepared(run);
+
+    if(res->error != NULL){
+        fprintf(stderr, "%s: skipped, %s\n", name, res->error->message);
+    }
+    else{
+        _bench_report(name, _bench_measure(_bench_runPrepared, run), flops, bytes, elements);
+        
+        if(config.profile){
+            tb_sessionSetProfiling(session, 1);
+            tb_runPrepared(run);
+            tb_profilerWriteSummary(tb_sessionGetProfiler(session), stdout, 8);
+            printf("\n");
+        }
+    }
+
+    tb_freePreparedRun(run);
+    tb_freeSession(session);
+    tb_freeGraph(graph);
+}
+
+typedef struct BenchTraining {
+    TBGraphSession* session;
+    TBGraph* graph;
+}BenchTraining;
+
+static void _bench_freeResult(TBResultNode* res){
+    tb_freeResultNode(NULL, res);
+    free(res);
+}
+
+static void _bench_runTraining(void* arg){
+    BenchTraining* t = (BenchTraining*)arg;
+    _bench_freeResult(tb_runSession(t->session, t->graph, NULL));
+    tb_autogradGraph(t->session, t->graph);
+}
+
+/* * * * * * * * * * * *
+ * TENSORS             *
+ * * * * * * * * * * * */
+
+static NDArray* _bench_random(NDShape* shape){
+    return nda_randomNormal(shape, 0, 1);
+}
+
+static NDArray* _bench_positive(NDShape* shape){
+    NDArray* x = nda_alloc(shape);
+    uint64_t i;
+    for(i = 0; i < shape->raw_len; i++)
+        x->data[i] = 0.5f + (float)rand()/RAND_MAX;
+
+    return x;
+}
+
+static NDArray* _bench_indices(uint64_t n, uint64_t range){
+    NDArray* x = nda_allocType(nda_newShape(1, n), NDA_DTYPE_I64);
+    int64_t* ids = (int64_t*)x->raw;
+    uint64_t i;
+    for(i = 0; i < n; i++)
+        ids[i] = rand() % range;
+
+    return x;
+}
+
+/* * * * * * * * * * * *
+ * OPERATIONS          *
+ * * * * * * * * * * * */
+
+static const char* _bench_binaryNames[] = {"add", "sub", "mult", "div", "pow", "dot"};
+static const char* _bench_unaryNames[] = {"minus", "exp", "log", "sin", "cos", "tan", "tanh", "relu", "softplus", "sigmoid", "dxrelu"};
+static const char* _bench_axisBoundNames[] = {"sum", "product", "min", "max", "mean", "variance", "softmax", "argmin", "argmax", "log_softmax"};
+
+/*
+ * Element-wise binary operations of rows x 256 operands, the RHS broadcast along the rows, the columns or both.
+ */
+static void _bench_binary(const uint64_t* sizes, uint64_t nsizes){
+    static const char* patterns[] = {"same", "row", "col", "scalar"};
+    uint64_t t, s, p;
+    char name[BENCH_NAME_LEN];
+
+    for(t = TBBOT_ADD; t <= TBBOT_POW; t++){
+        for(s = 0; s < nsizes; s++){
+            uint64_t cols = 256, rows = sizes[s]/cols, n = rows*cols;
+
+            for(p = 0; p < 4; p++){
+                // POW only takes a scalar exponent
+                if((t == TBBOT_POW) && (p != 3))
+                    continue;
+
+                snprintf(name, BENCH_NAME_LEN, "binary/%s/%" PRIu64 "/%s", _bench_binaryNames[t], n, patterns[p]);
+                if(!_bench_enabled(name))
+                    continue;
+
+                uint64_t rr = ((p == 0) || (p == 2)) ? rows : 1, rc = ((p == 0) || (p == 1)) ? cols : 1;
+                TBNode* lhs = tb_newConstantNode(_bench_positive(nda_newShape(2, rows, cols)));
+                TBNode* rhs = tb_newConstantNode(_bench_positive(nda_newShape(2, rr, rc)));
+
+                _bench_graph(name, tb_newBinaryOpNode(t, lhs, rhs), n, sizeof(tb_float)*(2*n + rr*rc), n);
+            }
+        }
+    }
+}
+
+static void _bench_dot(void){
+    static const uint64_t quick[][3] = {{8, 64, 32}, {4, 32, 16}, {64, 64, 64}};
+    static const uint64_t full[][3] = {{8, 64, 32}, {4, 32, 16}, {64, 64, 64}, {1, 1024, 1024}, {64, 784, 256},
+                                       {256, 256, 256}, {1024, 1024, 1024}};
+    const uint64_t (*shapes)[3] = config.quick ? quick : full;
+    uint64_t count = config.quick ? sizeof(quick)/sizeof(quick[0]) : sizeof(full)/sizeof(full[0]);
+    uint64_t s;
+    char name[BENCH_NAME_LEN];
+
+    for(s = 0; s < count; s++){
+        uint64_t M = shapes[s][0], K = shapes[s][1], N = shapes[s][2];
+
+        // constant weights are prepacked by small batches, fed ones are not
+        snprintf(name, BENCH_NAME_LEN, "binary/dot/%" PRIu64 "x%" PRIu64 "x%" PRIu64, M, K, N);
+        if(_bench_enabled(name)){
+            TBNode* lhs = tb_newConstantNode(_bench_random(nda_newShape(2, M, K)));
+            TBNode* rhs = tb_newConstantNode(_bench_random(nda_newShape(2, K, N)));
+            _bench_graph(name, tb_newBinaryOpNode(TBBOT_DOT, lhs, rhs), 2.0*M*N*K, sizeof(tb_float)*(M*K + K*N + M*N), M*N);
+        }
+
+        snprintf(name, BENCH_NAME_LEN, "binary/dot/%" PRIu64 "x%" PRIu64 "x%" PRIu64 "/transposed", M, K, N);
+        if(_bench_enabled(name)){
+            TBNode* lhs = tb_newConstantNode(_bench_random(nda_newShape(2, M, K)));
+            TBNode* rhs = tb_newTransposeOpNode(tb_newConstantNode(_bench_random(nda_newShape(2, N, K))), 0, 1);
+            _bench_graph(name, tb_newBinaryOpNode(TBBOT_DOT, lhs, rhs), 2.0*M*N*K, sizeof(tb_float)*(M*K + K*N + M*N), M*N);
+        }
+    }
+}
+
+static void _bench_unary(const uint64_t* sizes, uint64_t nsizes){
+    uint64_t t, s;
+    char name[BENCH_NAME_LEN];
+
+    for(t = 0; t <= MAX_UNARY_OPERATION; t++){
+        for(s = 0; s < nsizes; s++){
+            snprintf(name, BENCH_NAME_LEN, "unary/%s/%" PRIu64, _bench_unaryNames[t], sizes[s]);
+            if(!_bench_enabled(name))
+                continue;
+
+            TBNode* uhs = tb_newConstantNode(_bench_positive(nda_newShape(1, sizes[s])));
+            _bench_graph(name, tb_newUnaryOpNode(t, uhs), sizes[s], 2*sizeof(tb_float)*sizes[s], sizes[s]);
+        }
+    }
+}
+
+/*
+ * Reductions of rows x 256 inputs along both axes.
+ */
+static void _bench_axisBound(const uint64_t* sizes, uint64_t nsizes){
+    uint64_t t, s, axis;
+    char name[BENCH_NAME_LEN];
+
+    for(t = 0; t <= MAX_AXIS_BOUND_OPERATION; t++){
+        for(s = 0; s < nsizes; s++){
+            uint64_t cols = 256, rows = sizes[s]/cols, n = rows*cols;
+
+            for(axis = 0; axis < 2; axis++){
+                snprintf(name, BENCH_NAME_LEN, "axis_bound/%s/%" PRIu64 "x%" PRIu64 "/axis%" PRIu64, _bench_axisBoundNames[t], rows, cols, axis);
+                if(!_bench_enabled(name))
+                    continue;
+
+                uint8_t full = (t == TBABOT_SOFTMAX) || (t == TBABOT_LOG_SOFTMAX);
+                double out = full ? n : (axis ? rows : cols);
+                TBNode* uhs = tb_newConstantNode(_bench_positive(nda_newShape(2, rows, cols)));
+                _bench_graph(name, tb_newAxisBoundOpNode(t, uhs, axis), full ? 4.0*n : n, sizeof(tb_float)*(n + out), out);
+            }
+        }
+    }
+}
+
+static void _bench_transpose(const uint64_t* sizes, uint64_t nsizes){
+    uint64_t s;
+    char name[BENCH_NAME_LEN];
+
+    for(s = 0; s < nsizes; s++){
+        uint64_t cols = 256, rows = sizes[s]/cols, n = rows*cols;
+
+        snprintf(name, BENCH_NAME_LEN, "transpose/%" PRIu64 "x%" PRIu64, rows, cols);
+        if(!_bench_enabled(name))
+            continue;
+
+        TBNode* uhs = tb_newConstantNode(_bench_random(nda_newShape(2, rows, cols)));
+        _bench_graph(name, tb_newTransposeOpNode(uhs, 0, 1), 0, 2*sizeof(tb_float)*n, n);
+    }
+}
+
+static void _bench_quantization(const uint64_t* sizes, uint64_t nsizes){
+    uint64_t s;
+    char name[BENCH_NAME_LEN];
+
+    for(s = 0; s < nsizes; s++){
+        uint64_t n = sizes[s];
+
+        snprintf(name, BENCH_NAME_LEN, "quantization/quantize/%" PRIu64, n);
+        if(_bench_enabled(name)){
+            TBNode* uhs = tb_newConstantNode(_bench_random(nda_newShape(1, n)));
+            _bench_graph(name, tb_newQuantizeOpNode(uhs, NDA_DTYPE_U8, 0.05f, 128), 2.0*n, (sizeof(tb_float) + 1)*n, n);
+        }
+
+        snprintf(name, BENCH_NAME_LEN, "quantization/dequantize/%" PRIu64, n);
+        if(_bench_enabled(name)){
+            NDArray* x = _bench_random(nda_newShape(1, n));
+            TBNode* uhs = tb_newConstantNode(nda_quantize(x, NDA_DTYPE_U8, 0.05f, 128));
+            _bench_graph(name, tb_newDequantizeOpNode(uhs), n, (sizeof(tb_float) + 1)*n, n);
+            nda_free(x);
+            free(x);
+        }
+    }
+}
+
+static void _bench_gather(void){
+    uint64_t rows = config.quick ? 10000 : 1000000, dim = 64, n = 256;
+    char name[BENCH_NAME_LEN];
+
+    snprintf(name, BENCH_NAME_LEN, "gather/%" PRIu64 "x%" PRIu64 "/%" PRIu64, rows, dim, n);
+    if(!_bench_enabled(name))
+        return;
+
+    TBNode* table = tb_newConstantNode(_bench_random(nda_newShape(2, rows, dim)));
+    TBNode* indices = tb_newConstantNode(_bench_indices(n, rows));
+    _bench_graph(name, tb_newGatherOpNode(table, indices), 0, 2*sizeof(tb_float)*n*dim + sizeof(int64_t)*n, n*dim);
+}
+
+static void _bench_crossEntropy(void){
+    uint64_t batch = config.quick ? 32 : 256, classes = 1000;
+    char name[BENCH_NAME_LEN];
+
+    snprintf(name, BENCH_NAME_LEN, "cross_entropy/%" PRIu64 "x%" PRIu64, batch, classes);
+    if(!_bench_enabled(name))
+        return;
+
+    TBNode* logits = tb_newConstantNode(_bench_random(nda_newShape(2, batch, classes)));
+    TBNode* labels = tb_newConstantNode(_bench_indices(batch, classes));
+    _bench_graph(name, tb_newCrossEntropyOpNode(logits, labels, 1), 4.0*batch*classes, sizeof(tb_float)*(batch*classes + batch), batch);
+}
+
+static void _bench_normalization(void){
+    uint64_t batch = config.quick ? 8 : 64, features = 1024;
+    uint64_t C = 64, H = config.quick ? 8 : 28;
+    char name[BENCH_NAME_LEN];
+
+    snprintf(name, BENCH_NAME_LEN, "normalization/layer/%" PRIu64 "x%" PRIu64, batch, features);
+    if(_bench_enabled(name)){
+        uint64_t n = batch*features;
+        TBNode* uhs = tb_newConstantNode(_bench_random(nda_newShape(2, batch, features)));
+        TBNode* gamma = tb_newConstantNode(_bench_positive(nda_newShape(1, features)));
+        TBNode* beta = tb_newConstantNode(_bench_random(nda_newShape(1, features)));
+        _bench_graph(name, tb_newNormalizationOpNode(TBNOT_LAYER, uhs, gamma, beta, 1, 1e-5f), 8.0*n, 3*sizeof(tb_float)*n, n);
+    }
+
+    snprintf(name, BENCH_NAME_LEN, "normalization/batch/%" PRIu64 "x%" PRIu64 "x%" PRIu64 "x%" PRIu64, batch, C, H, H);
+    if(_bench_enabled(name)){
+        uint64_t n = batch*C*H*H;
+        TBNode* uhs = tb_newConstantNode(_bench_random(nda_newShape(4, batch, C, H, H)));
+        TBNode* gamma = tb_newConstantNode(_bench_positive(nda_newShape(1, C)));
+        TBNode* beta = tb_newConstantNode(_bench_random(nda_newShape(1, C)));
+        _bench_graph(name, tb_newNormalizationOpNode(TBNOT_BATCH, uhs, gamma, beta, 1, 1e-5f), 8.0*n, 3*sizeof(tb_float)*n, n);
+    }
+}
+
+/*
+ * 3x3 convolutions of padding 1 with every forward algorithm, in both plain layouts.
+ */
+static void _bench_convolution(void){
+    static const char* layouts[] = {"nchw", "nhwc"};
+    static const char* algorithms[] = {"auto", "im2col", "direct", "winograd"};
+    uint64_t N = 1, C = config.quick ? 16 : 64, H = config.quick ? 16 : 56;
+    uint64_t l, a;
+    char name[BENCH_NAME_LEN];
+
+    for(l = TBCL_NCHW; l <= TBCL_NHWC; l++){
+        for(a = TBCA_AUTO; a <= MAX_CONVOLUTION_ALGORITHM; a++){
+            snprintf(name, BENCH_NAME_LEN, "convolution/%s/%s/%" PRIu64 "x%" PRIu64 "x%" PRIu64 "x%" PRIu64 "/3x3",
+                     layouts[l], algorithms[a], N, C, H, H);
+            if(!_bench_enabled(name))
+                continue;
+
+            NDShape* shape = (l == TBCL_NCHW) ? nda_newShape(4, N, C, H, H) : nda_newShape(4, N, H, H, C);
+            TBNode* uhs = tb_newConstantNode(_bench_random(shape));
+            TBNode* weights = tb_newConstantNode(_bench_random(nda_newShape(4, C, C, 3, 3)));
+            TBNode* conv = tb_newConvolutionOpNode(uhs, weights, l, 1, 1, 1, 1, 1, 1, 1);
+            ((TBConvolutionOperation*)conv->nodePtr)->algorithm = a;
+
+            uint64_t n = N*C*H*H;
+            _bench_graph(name, conv, 2.0*n*C*9, sizeof(tb_float)*(2*n + C*C*9), n);
+        }
+    }
+}
+
+static void _bench_pooling(void){
+    static const char* types[] = {"max", "avg", "global_max", "global_avg"};
+    uint64_t N = config.quick ? 1 : 8, C = 64, H = config.quick ? 16 : 56;
+    uint64_t t;
+    char name[BENCH_NAME_LEN];
+
+    for(t = 0; t <= MAX_POOLING_OPERATION; t++){
+        snprintf(name, BENCH_NAME_LEN, "pooling/%s/%" PRIu64 "x%" PRIu64 "x%" PRIu64 "x%" PRIu64 "/nhwc", types[t], N, H, H, C);
+        if(!_bench_enabled(name))
+            continue;
+
+        uint8_t global = (t == TBPOT_GLOBAL_MAX) || (t == TBPOT_GLOBAL_AVG);
+        uint64_t n = N*H*H*C, out = global ? N*C : n/4;
+        TBNode* uhs = tb_newConstantNode(_bench_random(nda_newShape(4, N, H, H, C)));
+        _bench_graph(name, tb_newPoolingOpNode(t, uhs, TBCL_NHWC, 2, 2, 2, 2, 0, 0), n, sizeof(tb_float)*(n + out), out);
+    }
+}
+
+static void _bench_reorder(void){
+    uint64_t N = config.quick ? 1 : 8, C = 64, H = config.quick ? 16 : 56, block = 16;
+    char name[BENCH_NAME_LEN];
+
+    snprintf(name, BENCH_NAME_LEN, "reorder/nchw_to_nchwc%" PRIu64 "/%" PRIu64 "x%" PRIu64 "x%" PRIu64 "x%" PRIu64, block, N, C, H, H);
+    if(!_bench_enabled(name))
+        return;
+
+    uint64_t n = N*C*H*H;
+    TBNode* uhs = tb_newConstantNode(_bench_random(nda_newShape(4, N, C, H, H)));
+    _bench_graph(name, tb_newReorderOpNode(uhs, TBCL_NCHW, TBCL_NCHWC, block), 0, 2*sizeof(tb_float)*n, n);
+}
+
+/* * * * * * * * * * * *
+ * GRAPHS              *
+ * * * * * * * * * * * */
+
+/*
+ * relu(x.W1 + b1) -> relu(.W2 + b2) -> .W3 + b3, returns the logits and the FLOPs of the forward pass.
+ */
+static TBNode* _bench_mlp(uint64_t batch, const uint64_t* layers, uint64_t depth, double* flops){
+    TBNode* h = tb_newConstantNode(_bench_random(nda_newShape(2, batch, layers[0])));
+    uint64_t l;
+    *flops = 0;
+
+    for(l = 1; l < depth; l++){
+        TBNode* w = tb_newConstantNode(nda_randomNormal(nda_newShape(2, layers[l-1], layers[l]), 0, 1.0f/sqrtf(layers[l-1])));
+        TBNode* b = tb_newConstantNode(_bench_random(nda_newShape(2, 1, layers[l])));
+        h = tb_newBinaryOpNode(TBBOT_ADD, tb_newBinaryOpNode(TBBOT_DOT, h, w), b);
+        *flops += 2.0*batch*layers[l-1]*layers[l] + batch*layers[l];
+
+        if(l < depth - 1){
+            h = tb_newUnaryOpNode(TBUOT_RELU, h);
+            *flops += batch*layers[l];
+        }
+    }
+
+    return h;
+}
+
+static void _bench_graphs(void){
+    static const uint64_t layers[] = {784, 256, 128, 10};
+    uint64_t depth = sizeof(layers)/sizeof(layers[0]);
+    uint64_t batches[] = {1, 64};
+    uint64_t b;
+    char name[BENCH_NAME_LEN];
+
+    for(b = 0; b < 2; b++){
+        uint64_t batch = batches[b];
+        double flops, params = 0;
+        uint64_t l;
+        for(l = 1; l < depth; l++)
+            params += (layers[l-1] + 1)*layers[l];
+
+        snprintf(name, BENCH_NAME_LEN, "graph/mlp_forward/784-256-128-10/batch%" PRIu64, batch);
+        if(_bench_enabled(name)){
+            TBNode* logits = _bench_mlp(batch, layers, depth, &flops);
+            TBNode* probs = tb_newAxisBoundOpNode(TBABOT_SOFTMAX, logits, 1);
+            _bench_graph(name, probs, flops + 4.0*batch*10, sizeof(tb_float)*(params + batch*layers[0]), batch);
+        }
+
+        // the backward pass costs about twice the forward one
+        snprintf(name, BENCH_NAME_LEN, "graph/mlp_forward_backward/784-256-128-10/batch%" PRIu64, batch);
+        if(_bench_enabled(name)){
+            TBNode* logits = _bench_mlp(batch, layers, depth, &flops);
+            TBNode* labels = tb_newConstantNode(_bench_indices(batch, 10));
+            TBNode* loss = tb_newCrossEntropyOpNode(logits, labels, 1);
+            BenchTraining training = {_bench_session(), tb_newGraph(name, loss)};
+
+            TBResultNode* res = tb_runSession(training.session, training.graph, NULL);
+            if(res->error != NULL){
+                fprintf(stderr, "%s: skipped, %s\n", name, res->error->message);
+            }
+            else{
+                _bench_report(name, _bench_measure(_bench_runTraining, &training), 3*flops, 3*sizeof(tb_float)*(params + batch*layers[0]), batch);
+            }
+            _bench_freeResult(res);
+            tb_freeSession(training.session);
+            tb_freeGraph(training.graph);
+        }
+    }
+}
+
+/* * * * * * * * * * * *
+ * OUTPUT              *
+ * * * * * * * * * * * */
+
+/*
+ * One benchmark per line, which is what `_bench_compareBaseline` reads back.
+ */
+static void _bench_writeJSON(const char* path){
+    FILE* f = fopen(path, "w");
+    uint64_t i;
+
+    if(f == NULL){
+        fprintf(stderr, "Cannot write %s\n", path);
+        return;
+    }
+
+    fprintf(f, "{\n  \"threads\": %" PRIu64 ",\n  \"benchmarks\": [\n", config.threads);
+    for(i = 0; i < config.count; i++){
+        BenchResult* r = &config.results[i];
+        fprintf(f, "    {\"name\": \"%s\", \"ns\": %.3f, \"gflops\": %.4f, \"gbps\": %.4f, \"ns_per_elem\": %.6f, "
+                   "\"flops\": %.0f, \"bytes\": %.0f, \"elements\": %.0f}%s\n",
+                r->name, r->ns, r->flops/r->ns, r->bytes/r->ns, r->ns/r->elements,
+                r->flops, r->bytes, r->elements, (i + 1 < config.count) ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+
+    fclose(f);
+}
+
+/*
+ * Returns the number of benchmarks slower than their baseline by more than the tolerance.
+ */
+static uint64_t _bench_compareBaseline(const char* path){
+    FILE* f = fopen(path, "r");
+    char line[1024];
+    uint64_t regressions = 0, matched = 0, i;
+
+    if(f == NULL){
+        fprintf(stderr, "Cannot read baseline %s\n", path);
+        return 0;
+    }
+
+    printf("\nBaseline %s, tolerance %.0f%%\n", path, config.tolerance*100);
+
+    while(fgets(line, sizeof(line), f) != NULL){
+        char* name = strstr(line, "\"name\": \"");
+        char* ns = strstr(line, "\"ns\": ");
+        if((name == NULL) || (ns == NULL))
+            continue;
+
+        name += strlen("\"name\": \"");
+        char* end = strchr(name, '"');
+        if(end == NULL)
+            continue;
+        *end = '\0';
+        double base = strtod(ns + strlen("\"ns\": "), NULL);
+
+        for(i = 0; i < config.count; i++){
+            if(strcmp(config.results[i].name, name) != 0)
+                continue;
+
+            double ratio = config.results[i].ns/base;
+            matched++;
+
+            if(ratio > 1 + config.tolerance){
+                printf("REGRESSION %-52s %12.1f ns vs %12.1f ns (%+.1f%%)\n", name, config.results[i].ns, base, (ratio - 1)*100);
+                regressions++;
+            }
+            else if(ratio < 1 - config.tolerance){
+                printf("improved   %-52s %12.1f ns vs %12.1f ns (%+.1f%%)\n", name, config.results[i].ns, base, (ratio - 1)*100);
+            }
+            break;
+        }
+    }
+
+    fclose(f);
+    printf("%" PRIu64 " benchmarks compared, %" PRIu64 " regressions\n", matched, regressions);
+
+    return regressions;
+}
+
+static void _bench_usage(const char* exe){
+    printf("Usage: %s [--quick] [--filter substring] [--min-time seconds] [--threads n]\n"
+           "          [--json output.json] [--baseline baseline.json] [--tolerance ratio] [--profile]\n", exe);
+}
+
+int main(int argc, char** argv){
+    int i;
+
+    for(i = 1; i < argc; i++){
+        uint8_t more = (i + 1 < argc);
+
+        if(strcmp(argv[i], "--quick") == 0)
+            config.quick = 1;
+        else if((strcmp(argv[i], "--filter") == 0) && more)
+            config.filter = argv[++i];
+        else if((strcmp(argv[i], "--min-time") == 0) && more)
+            config.min_time = strtod(argv[++i], NULL);
+        else if((strcmp(argv[i], "--threads") == 0) && more)
+            config.threads = strtoull(argv[++i], NULL, 10);
+        else if((strcmp(argv[i], "--json") == 0) && more)
+            config.json = argv[++i];
+        else if((strcmp(argv[i], "--baseline") == 0) && more)
+            config.baseline = argv[++i];
+        else if((strcmp(argv[i], "--tolerance") == 0) && more)
+            config.tolerance = strtod(argv[++i], NULL);
+        else if(strcmp(argv[i], "--profile") == 0)
+            config.profile = 1;
+        else{
+            _bench_usage(argv[0]);
+            return (strcmp(argv[i], "--help") == 0) ? 0 : 2;
+        }
+    }
+
+    srand(42);
+
+    static const uint64_t quickSizes[] = {4096};
+    static const uint64_t fullSizes[] = {4096, 65536, 1048576};
+    const uint64_t* sizes = config.quick ? quickSizes : fullSizes;
+    uint64_t nsizes = config.quick ? 1 : 3;
+
+    _bench_binary(sizes, nsizes);
+    _bench_dot();
+    _bench_unary(sizes, nsizes);
+    _bench_axisBound(sizes, nsizes);
+    _bench_transpose(sizes, nsizes);
+    _bench_quantization(sizes, nsizes);
+    _bench_gather();
+    _bench_crossEntropy();
+    _bench_normalization();
+    _bench_convolution();
+    _bench_pooling();
+    _bench_reorder();
+    _bench_graphs();
+
+    if(config.json != NULL){
+        TBRoofline roofline;
+        _bench_writeJSON(config.json);
+
+        if(tb_calibrateRoofline(config.json, &roofline))
+            printf("\nRoofline: %.2f GFLOP/s, %.2f GB/s, %.1f ns per node\n", roofline.gflops, roofline.gbps, roofline.overhead);
+    }
+
+    uint64_t regressions = (config.baseline != NULL) ? _bench_compareBaseline(config.baseline) : 0;
+    free(config.results);
+
+    return (regressions > 0) ? 1 : 0;
+}
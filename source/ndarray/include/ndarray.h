@@ -59,6 +59,11 @@
 
 #define TB_ASSERT_LOG
 
+/**
+ * \brief Prints a formatted message and aborts if the condition does not hold, used by ASSERT
+ */
+void nda_assert(int cond, const char * rawcond, const char* func_name, const char * fmt, ...);
+
 #if defined(TB_ASSERT_STANDARD)
 #define ASSERT(c ,msg, ...) assert(c)
 #elif defined (TB_ASSERT_LOG)
@@ -84,11 +89,49 @@ typedef float tb_float;
 typedef double tb_float;
 #endif
 
+/**
+ * \brief Element type of an array, chosen at runtime. Floating point computations are carried out in tb_float,
+ * or in double when an operand is F64, other types are converted when loaded and stored. Integer types have their own kernels for the operations
+ * which keep them integer (see tb_shape.h).
+ */
+typedef enum NDDType {
+    NDA_DTYPE_F32 = 0,   /**< IEEE 754 single precision */
+    NDA_DTYPE_F64,       /**< IEEE 754 double precision */
+    NDA_DTYPE_F16,       /**< IEEE 754 half precision, storage only */
+    NDA_DTYPE_BF16,      /**< bfloat16 i.e truncated single precision, storage only */
+    NDA_DTYPE_I32,       /**< Signed 32 bits integer */
+    NDA_DTYPE_I64,       /**< Signed 64 bits integer, used for indices */
+    NDA_DTYPE_U8,        /**< Unsigned 8 bits integer */
+    NDA_DTYPE_BOOL,      /**< Boolean stored as one byte, 0 or 1, used for masks */
+    NDA_DTYPE_I8,        /**< Signed 8 bits integer, used for quantized weights */
+}NDDType;
+
+#define NDA_MAX_DTYPE NDA_DTYPE_I8
+
+/**
+ * \brief dtype of tb_float, arrays created by the nda_* factories default to it.
+ */
+#if TB_TYPE == TB_FLOAT
+#define NDA_DTYPE_FLOAT NDA_DTYPE_F32
+#else
+#define NDA_DTYPE_FLOAT NDA_DTYPE_F64
+#endif
+
 /**
  * \brief Tensor Shape
  */
 struct NDShape;
 
+/**
+ * \brief Affine quantization parameters of an integer array
+ */
+struct NDQuantParams;
+
+/**
+ * \brief CSR index of a sparse matrix
+ */
+struct NDSparse;
+
 /**
  * \brief Treats NDShape as a stack to pop elements, does not modify the original shape
  */
@@ -210,6 +253,284 @@ uint64_t nda_getTotalSize(struct NDShape* shape);
  */
 struct NDArray* nda_alloc(struct NDShape* shape);
 
+/**
+ * \brief Creates an empty zeroed array of the given storage type
+ * \param shape initial shape
+ * \param dtype storage type of the elements
+ * \return 0 initialized array
+ */
+struct NDArray* nda_allocType(struct NDShape* shape, NDDType dtype);
+
+/**
+ * \brief Returns the size in bytes of one element
+ * \param[in] dtype storage type
+ * \return size of one element
+ */
+uint64_t nda_dtypeSize(NDDType dtype);
+
+/**
+ * \brief Returns the name of a storage type, used for debugging or generating errors
+ * \param[in] dtype storage type
+ * \return static string
+ */
+const char* nda_dtypeName(NDDType dtype);
+
+/**
+ * \brief Checks whether a dtype holds integers (booleans included)
+ * \param[in] dtype storage type
+ * \return true for integer and boolean types
+ */
+uint8_t nda_dtypeIsInteger(NDDType dtype);
+
+/**
+ * \brief Converts an array to another storage type. The result is contiguous, strided views are
+ * converted in their logical order. Elements are copied as-is when the dtype does not change and converted
+ * exactly when widened to F64, otherwise they go through tb_float: conversions to half precision round to nearest even, conversions to integers
+ * round half away from zero and saturate to the range of the type (NaN gives 0), and conversions to booleans
+ * test against zero.
+ * \param[in] x array to convert
+ * \param[in] dtype target storage type
+ * \return new array, must be explicitly freed
+ */
+struct NDArray* nda_cast(struct NDArray* x, NDDType dtype);
+
+/**
+ * \brief Converts a contiguous buffer of any storage type to tb_float, uses F16C when the compiler targets it
+ * \param[in] src source elements
+ * \param[in] dtype storage type of the source
+ * \param[out] dst destination, len elements
+ * \param[in] len number of elements
+ */
+void nda_toFloat(const void* src, NDDType dtype, tb_float* dst, uint64_t len);
+
+/**
+ * \brief Converts a contiguous tb_float buffer to any storage type with the rounding of `nda_cast`, uses F16C/AVX-512 BF16 when the compiler targets them
+ * \param[in] src source elements
+ * \param[in] dtype storage type of the destination
+ * \param[out] dst destination, len elements
+ * \param[in] len number of elements
+ */
+void nda_fromFloat(const tb_float* src, NDDType dtype, void* dst, uint64_t len);
+
+/**
+ * \brief Returns the element at a raw offset of the data (i.e sum of index*strides) as tb_float, whatever the dtype
+ * \param[in] array NDArray to access
+ * \param[in] offset offset in elements
+ * \return converted element
+ */
+tb_float nda_rawGet(struct NDArray* array, uint64_t offset);
+
+/**
+ * \brief Converts a half precision value to single precision
+ */
+float nda_halfToFloat(uint16_t h);
+
+/**
+ * \brief Converts a single precision value to half precision, rounding to nearest even
+ */
+uint16_t nda_floatToHalf(float f);
+
+/**
+ * \brief Converts a bfloat16 value to single precision
+ */
+float nda_bf16ToFloat(uint16_t h);
+
+/**
+ * \brief Converts a single precision value to bfloat16, rounding to nearest even
+ */
+uint16_t nda_floatToBf16(float f);
+
+/**
+ * \brief Checks whether a shape describes a row-major contiguous array
+ * \param[in] shape Shape to check
+ * \return true if the elements are laid out contiguously in row-major order
+ */
+uint8_t nda_isContiguous(struct NDShape* shape);
+
+/**
+ * \brief Creates quantization parameters with zeroed scales
+ * \param[in] count Number of scales, 1 for per-tensor quantization
+ * \param[in] axis Axis of the channels when count > 1
+ * \param[in] zero_point Zero point shared by every channel
+ * \return new parameters, freed alongside the array they are attached to
+ */
+struct NDQuantParams* nda_newQuantParams(uint64_t count, uint64_t axis, int32_t zero_point);
+
+/**
+ * \brief Copies quantization parameters
+ * \param[in] params Parameters to copy, can be NULL
+ * \return new parameters, NULL if params is NULL
+ */
+struct NDQuantParams* nda_copyQuantParams(struct NDQuantParams* params);
+
+/**
+ * \brief Frees quantization parameters
+ * \param[in/out] params Parameters to free, can be NULL
+ */
+void nda_freeQuantParams(struct NDQuantParams* params);
+
+/**
+ * \brief Chooses per-tensor parameters covering [min, max] (extended to include 0) with the range of an 8 bits dtype.
+ * U8 is asymmetric, I8 is symmetric with a null zero point.
+ * \param[in] min Minimum observed value
+ * \param[in] max Maximum observed value
+ * \param[in] dtype NDA_DTYPE_U8 or NDA_DTYPE_I8
+ * \param[out] scale Chosen scale
+ * \param[out] zero_point Chosen zero point
+ */
+void nda_chooseQuantParams(float min, float max, NDDType dtype, float* scale, int32_t* zero_point);
+
+/**
+ * \brief Quantizes an array per tensor, q = clamp(round(x/scale) + zero_point)
+ * \param[in] x Array to quantize, of any non quantized dtype
+ * \param[in] dtype NDA_DTYPE_U8 or NDA_DTYPE_I8
+ * \param[in] scale Quantization scale
+ * \param[in] zero_point Quantization zero point
+ * \return new contiguous quantized array
+ */
+struct NDArray* nda_quantize(struct NDArray* x, NDDType dtype, float scale, int32_t zero_point);
+
+/**
+ * \brief Quantizes an array into I8 with one symmetric scale per channel, i.e per index along `axis`
+ * \param[in] x Array to quantize
+ * \param[in] axis Channel axis
+ * \return new contiguous quantized array
+ */
+struct NDArray* nda_quantizePerChannel(struct NDArray* x, uint64_t axis);
+
+/**
+ * \brief Quantizes into a preallocated array per tensor, no memory is allocated when x is a contiguous
+ * tb_float array. The quantization parameters of `out` are left untouched.
+ * \param[out] out Contiguous U8 or I8 array, same number of elements as x
+ * \param[in] x Array to quantize
+ * \param[in] scale Quantization scale
+ * \param[in] zero_point Quantization zero point
+ */
+void nda_quantizeInto(struct NDArray* out, struct NDArray* x, float scale, int32_t zero_point);
+
+/**
+ * \brief Converts a quantized array back to tb_float
+ * \param[in] x Quantized array
+ * \return new contiguous tb_float array
+ */
+struct NDArray* nda_dequantize(struct NDArray* x);
+
+/**
+ * \brief Dequantizes into a preallocated contiguous tb_float array of the same shape, no memory is allocated
+ * \param[out] out Destination array
+ * \param[in] x Quantized array
+ */
+void nda_dequantizeInto(struct NDArray* out, struct NDArray* x);
+
+/**
+ * \brief Allocates a sparse tb_float matrix with room for nnz values, the rows are empty until
+ * `row_ptr` and `col_idx` of its index are filled in.
+ * \param[in] rows Number of rows
+ * \param[in] cols Number of columns
+ * \param[in] nnz Number of stored values
+ * \return new sparse matrix
+ */
+struct NDArray* nda_allocSparse(uint64_t rows, uint64_t cols, uint64_t nnz);
+
+/**
+ * \brief Allocates a sparse tb_float matrix stored as a row list of n zero rows, the stored rows are
+ * undefined until `row_ids` of its index is filled in. O(n*cols) whatever the number of rows.
+ * \param[in] rows Number of rows
+ * \param[in] cols Number of columns
+ * \param[in] n Number of stored rows
+ * \return new sparse matrix
+ */
+struct NDArray* nda_allocSparseRows(uint64_t rows, uint64_t cols, uint64_t n);
+
+/**
+ * \brief Creates a sparse tb_float matrix from coordinates (COO), duplicated coordinates are summed.
+ * Sparse matrices are rank 2 and only hold their stored values, element accessors, slices and casts
+ * apply to dense arrays: convert with `nda_sparseToDense` first.
+ * \param[in] rows Number of rows
+ * \param[in] cols Number of columns
+ * \param[in] nnz Number of coordinates
+ * \param[in] row_idx Row of each value
+ * \param[in] col_idx Column of each value
+ * \param[in] values Values
+ * \return new sparse matrix stored in CSR
+ */
+struct NDArray* nda_sparseFromCOO(uint64_t rows, uint64_t cols, uint64_t nnz, const uint64_t* row_idx, const uint64_t* col_idx, const tb_float* values);
+
+/**
+ * \brief Creates a sparse tb_float matrix from the non-zero elements of a dense matrix
+ * \param[in] x Dense rank 2 array of any dtype, can be strided
+ * \return new sparse matrix stored in CSR
+ */
+struct NDArray* nda_sparseFromDense(struct NDArray* x);
+
+/**
+ * \brief Converts a sparse matrix into a dense contiguous array
+ * \param[in] x Sparse matrix
+ * \return new dense tb_float array
+ */
+struct NDArray* nda_sparseToDense(struct NDArray* x);
+
+/**
+ * \brief Transposes a sparse matrix, O(nnz + rows + cols)
+ * \param[in] x Sparse matrix
+ * \return new sparse matrix stored in CSR
+ */
+struct NDArray* nda_sparseTranspose(struct NDArray* x);
+
+/**
+ * \brief Creates a sparse matrix with the sparsity pattern of x and zero values, used for sparse gradients
+ * \param[in] x Sparse matrix
+ * \return new sparse matrix stored like x
+ */
+struct NDArray* nda_sparseZerosLike(struct NDArray* x);
+
+/**
+ * \brief Adds dense rows to a sparse matrix, i.e the scatter-add of row-sparse gradients. Rows receiving values
+ * are stored whole, the other rows keep their pattern. O(rows + nnz + n log n) in CSR, O(nnz + n log n) for
+ * row lists.
+ * \param[in] x Sparse matrix
+ * \param[in] n Number of rows to add
+ * \param[in] rows Destination row of each added row, rows can be repeated
+ * \param[in] values Contiguous tb_float array of n rows of x's number of columns
+ * \return new sparse matrix stored like x
+ */
+struct NDArray* nda_sparseAddRows(struct NDArray* x, uint64_t n, const uint64_t* rows, struct NDArray* values);
+
+/**
+ * \brief Checks whether an array is a sparse matrix
+ * \param[in] x Array to check
+ * \return true if x is stored in CSR or as a row list
+ */
+uint8_t nda_isSparse(struct NDArray* x);
+
+/**
+ * \brief Number of stored values of an array, the number of elements of a dense array
+ * \param[in] x Array
+ * \return number of stored values
+ */
+uint64_t nda_storedLen(struct NDArray* x);
+
+/**
+ * \brief Copies a sparse index
+ * \param[in] sparse Index to copy, can be NULL
+ * \return new index, NULL if sparse is NULL
+ */
+struct NDSparse* nda_copySparseIndex(struct NDSparse* sparse);
+
+/**
+ * \brief Returns the CSR index of a sparse matrix, for the kernels walking rows. The stored values of a row
+ * list are already laid out in CSR order and are shared with the new index.
+ * \param[in] x Sparse matrix
+ * \return index of x in CSR, a new index to free with `nda_freeSparseIndex` when x is a row list
+ */
+struct NDSparse* nda_sparseCSRIndex(struct NDArray* x);
+
+/**
+ * \brief Frees a sparse index
+ * \param[in/out] sparse Index to free, can be NULL
+ */
+void nda_freeSparseIndex(struct NDSparse* sparse);
+
 /**
  * \brief Creates an array from a Guassian Distribution
  * \param shape initial shape
@@ -245,7 +566,7 @@ struct NDArray* nda_ones(struct NDShape* shape);
 struct NDArray* nda_fill(struct NDShape* shape, tb_float value);
 
 /**
- * \brief copies an existent tensor, memory must be explicitly freed.
+ * \brief copies an existent tensor, dtype included, memory must be explicitly freed.
  * \param[in] x tensor to copy
  * \return copy of x, must be explicitly freed
  */
@@ -259,7 +580,7 @@ struct NDArray* nda_copy(struct NDArray* x);
 void nda_reshape(struct NDArray* x, struct NDShape* shape);
 
 /**
- * \brief frees an NDArray alongside its shape
+ * \brief frees an NDArray alongside its shape, quantization parameters and sparse index
  * \param [in/out] array data to free
  */
 void nda_free(struct NDArray* array);
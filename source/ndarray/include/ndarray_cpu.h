@@ -0,0 +1,97 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file ndarray_cpu.h
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing the detection of the instruction set extensions used by the vectorized kernels.
+ *
+ * The library is built for the baseline of its target, the vectorized kernels are compiled for their extensions
+ * with function-level target attributes and picked at run time from the features detected here. The features can
+ * be restricted, e.g to check the vectorized kernels against the portable ones.
+ */
+
+#ifndef _TB_NDARRAY_CPU_H_
+#define _TB_NDARRAY_CPU_H_
+
+#include <stdint.h>
+
+/**
+ * \brief x86 extensions used by the vectorized kernels
+ */
+typedef enum NDCpuFeature {
+    NDA_CPU_AVX2 = 1 << 0,          /**< 256 bits integer and float vectors */
+    NDA_CPU_FMA = 1 << 1,           /**< Fused multiply-add */
+    NDA_CPU_F16C = 1 << 2,          /**< fp16 conversions */
+    NDA_CPU_AVX512F = 1 << 3,       /**< 512 bits vectors */
+    NDA_CPU_AVX512VL = 1 << 4,      /**< AVX-512 instructions on 128 and 256 bits vectors */
+    NDA_CPU_AVX512BF16 = 1 << 5,    /**< bf16 conversions */
+    NDA_CPU_AVX512VNNI = 1 << 6,    /**< u8 x s8 dot products, EVEX encoded */
+    NDA_CPU_AVXVNNI = 1 << 7,       /**< u8 x s8 dot products, VEX encoded */
+}NDCpuFeature;
+
+/**
+ * \brief Every feature
+ */
+#define NDA_CPU_ALL 0xFFFFFFFFu
+
+/**
+ * \brief Returns the features the kernels may use, i.e the detected ones within the restriction
+ * \return bitwise OR of NDCpuFeature
+ */
+uint32_t nda_cpuFeatures(void);
+
+/**
+ * \brief Restricts the features the kernels may use, features that are not detected stay disabled
+ * \param[in] mask Bitwise OR of the allowed NDCpuFeature, NDA_CPU_ALL to lift the restriction, 0 for the
+ *            portable kernels only
+ * \return previous restriction
+ */
+uint32_t nda_cpuRestrictFeatures(uint32_t mask);
+
+/**
+ * \brief Checks that a set of features may be used
+ * \param[in] features Bitwise OR of NDCpuFeature
+ * \return 1 if all of them may be used, 0 otherwise
+ */
+static inline uint8_t nda_cpuHas(uint32_t features){
+    return (nda_cpuFeatures() & features) == features;
+}
+
+#endif
@@ -0,0 +1,148 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file ndarray_io.h
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing the binary archive format of NDArray collections.
+ *
+ * An archive starts with a fixed 64 bytes header, followed by an index of named
+ * entries (rank, dtype, dims, data offset) and the raw data of each array. Every data
+ * block starts on a 64 bytes boundary, so a loaded archive can hand out arrays that
+ * point straight into the mapped file without copying. Integers and data are stored
+ * in host byte order.
+ */
+
+#ifndef _TB_NDARRAY_IO_H_
+#define _TB_NDARRAY_IO_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ndarray.h"
+
+#define NDA_ARCHIVE_MAGIC "TBNDARR"  /**< 7 chars + NULL terminator = 8 bytes */
+#define NDA_ARCHIVE_VERSION 3
+#define NDA_ARCHIVE_ALIGN 64
+
+/**
+ * \brief Archive opened through a memory mapping
+ */
+typedef struct NDArchive NDArchive;
+
+/**
+ * \brief Writes a collection of named arrays to a file, the file is overwritten.
+ * Non contiguous arrays (such as slices or transposed views) are written in their
+ * logical row major order. Sparse matrices are not supported.
+ * \param[in] path Path of the file to write
+ * \param[in] count Number of arrays
+ * \param[in] names Array of count names, names must be unique
+ * \param[in] arrays Array of count arrays to save
+ * \return 1 on success, 0 if the file could not be written or an array is sparse
+ */
+uint8_t nda_saveArchive(const char* path, uint64_t count, const char** names, struct NDArray** arrays);
+
+/**
+ * \brief Writes a collection of named arrays at the current position of an open file, allowing an
+ * archive to be embedded in another file format. Offsets are relative to the start of the archive,
+ * which must be aligned on NDA_ARCHIVE_ALIGN within the file for the data to stay aligned.
+ * \param[in/out] file File opened for writing
+ * \param[in] count Number of arrays
+ * \param[in] names Array of count names, names must be unique
+ * \param[in] arrays Array of count arrays to save
+ * \return 1 on success, 0 if the file could not be written or an array is sparse
+ */
+uint8_t nda_writeArchive(FILE* file, uint64_t count, const char** names, struct NDArray** arrays);
+
+/**
+ * \brief Maps an archive file in memory. The arrays of the archive point directly into
+ * the mapping, pages are loaded lazily and shared with every process mapping the same
+ * file. Writing to an array is allowed, the written pages become private to the
+ * process and are never written back to the file.
+ * \param[in] path Path of the archive
+ * \return Opened archive, NULL if the file cannot be opened or is malformed
+ */
+NDArchive* nda_openArchive(const char* path);
+
+/**
+ * \brief Maps an archive embedded at the end of another file, see `nda_openArchive`.
+ * \param[in] path Path of the file
+ * \param[in] offset Offset of the archive within the file, must be a multiple of the page size
+ * \return Opened archive, NULL on failure
+ */
+NDArchive* nda_openArchiveAt(const char* path, uint64_t offset);
+
+/**
+ * \brief Returns the number of arrays in an archive
+ * \param[in] archive Opened archive
+ * \return number of arrays
+ */
+uint64_t nda_archiveCount(NDArchive* archive);
+
+/**
+ * \brief Returns the name of the i-th array of the archive
+ * \param[in] archive Opened archive
+ * \param[in] i index of the array, must be less than nda_archiveCount
+ * \return name owned by the archive
+ */
+const char* nda_archiveName(NDArchive* archive, uint64_t i);
+
+/**
+ * \brief Returns the i-th array of the archive
+ * \param[in] archive Opened archive
+ * \param[in] i index of the array, must be less than nda_archiveCount
+ * \return array owned by the archive, must not be freed through nda_free
+ */
+struct NDArray* nda_archiveArray(NDArchive* archive, uint64_t i);
+
+/**
+ * \brief Finds an array by name
+ * \param[in] archive Opened archive
+ * \param[in] name name of the array
+ * \return array owned by the archive, NULL if no array has this name
+ */
+struct NDArray* nda_archiveGet(NDArchive* archive, const char* name);
+
+/**
+ * \brief Unmaps an archive, arrays obtained from it become invalid.
+ * \param[in] archive archive to close
+ */
+void nda_closeArchive(NDArchive* archive);
+
+#endif
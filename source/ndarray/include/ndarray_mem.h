@@ -0,0 +1,126 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file ndarray_mem.h
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing the accounting of tensor buffers.
+ *
+ * Tensor buffers (dense data, sparse values and indices) are allocated through `nda_memCalloc`, which
+ * keeps their size in a small header. Every allocation is counted process-wide and charged to the tracker
+ * current on the allocating thread and to its parents, frees are credited to the same trackers whatever
+ * the thread or tracker current at that time. Trackers are reference counted by the buffers charged to
+ * them, so buffers can safely outlive the owner of their tracker.
+ */
+
+#ifndef _TB_NDARRAY_MEM_H_
+#define _TB_NDARRAY_MEM_H_
+
+#include <stdint.h>
+
+/**
+ * \brief Allocation counters, in bytes of tensor buffers
+ */
+typedef struct NDMemCounters {
+    uint64_t current;              /**< Bytes currently allocated */
+    uint64_t peak;                 /**< High-water mark of `current` */
+    uint64_t total;                /**< Bytes allocated overall */
+    uint64_t allocations;          /**< Number of allocations */
+    uint64_t live;                 /**< Number of allocations not yet freed */
+}NDMemCounters;
+
+/**
+ * \brief Allocation counters of a scope (e.g a session or a node), charged along with its parents
+ */
+typedef struct NDMemTracker NDMemTracker;
+
+/**
+ * \brief Creates a tracker
+ * \param[in] parent Tracker also charged with the allocations of the new one, NULL if none
+ * \return new tracker, must be released using `nda_releaseMemTracker`
+ */
+NDMemTracker* nda_newMemTracker(NDMemTracker* parent);
+
+/**
+ * \brief Releases a tracker, it is freed once the buffers charged to it are freed as well
+ * \param[in/out] tracker Tracker
+ */
+void nda_releaseMemTracker(NDMemTracker* tracker);
+
+/**
+ * \brief Sets the tracker charged with the allocations of the calling thread
+ * \param[in] tracker Tracker, NULL to only count allocations process-wide
+ * \return previous tracker of the thread
+ */
+NDMemTracker* nda_memSetTracker(NDMemTracker* tracker);
+
+/**
+ * \brief Returns the tracker charged with the allocations of the calling thread
+ * \return current tracker, NULL if none
+ */
+NDMemTracker* nda_memGetTracker(void);
+
+/**
+ * \brief Returns the counters of a tracker
+ * \param[in] tracker Tracker, NULL for the process-wide counters
+ * \return snapshot of the counters
+ */
+NDMemCounters nda_memCounters(NDMemTracker* tracker);
+
+/**
+ * \brief Lowers the peak of a tracker to its current allocation, e.g between two phases
+ * \param[in/out] tracker Tracker, NULL for the process-wide counters
+ */
+void nda_memResetPeak(NDMemTracker* tracker);
+
+/**
+ * \brief Allocates a zeroed tensor buffer
+ * \param[in] count Number of elements
+ * \param[in] size Size of an element in bytes
+ * \return new buffer, 16 bytes aligned, must be freed using `nda_memFree`
+ */
+void* nda_memCalloc(uint64_t count, uint64_t size);
+
+/**
+ * \brief Frees a buffer allocated by `nda_memCalloc`
+ * \param[in] ptr Buffer, can be NULL
+ */
+void nda_memFree(void* ptr);
+
+#endif
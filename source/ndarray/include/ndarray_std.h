@@ -67,12 +67,45 @@ typedef struct NDShapeStack {
     uint64_t i;           /**< Stack Pointer */
 }NDShapeStack;
 
+/**
+ * \brief Affine quantization parameters, real = scales[c]*(q - zero_point) where c is the index of
+ * the element along `axis` (always 0 for per-tensor quantization).
+ */
+typedef struct NDQuantParams {
+    uint64_t count;        /**< Number of scales, 1 for per-tensor quantization */
+    uint64_t axis;         /**< Axis of the channels when count > 1 */
+    int32_t zero_point;    /**< Zero point shared by every channel */
+    float* scales;         /**< Scales, one per channel */
+}NDQuantParams;
+
+/**
+ * \brief Index of a sparse matrix. In CSR, the stored values of row r are data[row_ptr[r]:row_ptr[r+1]] and
+ * their columns col_idx[row_ptr[r]:row_ptr[r+1]], sorted in increasing order. Row lists (e.g row-sparse
+ * gradients) only store whole rows, the i-th stored row data[i*cols:(i+1)*cols] is row row_ids[i] and
+ * row ids are sorted in increasing order, their size does not depend on the number of rows.
+ */
+typedef struct NDSparse {
+    uint64_t rows;         /**< Number of rows */
+    uint64_t nnz;          /**< Number of stored values */
+    uint64_t* row_ptr;     /**< rows+1 offsets of the rows, NULL for row lists */
+    uint64_t* col_idx;     /**< Column of each stored value, NULL for row lists */
+    uint64_t* row_ids;     /**< Row of each stored row of a row list, NULL in CSR */
+    uint64_t stored_rows;  /**< Number of stored rows of a row list */
+}NDSparse;
+
 /**
  * \brief Tensor data structure
  */
 typedef struct NDArray {
-    tb_float* data;  /**< Raw data as contigious array */
-    NDShape* shape;  /**< Shape of the tensor */
+    union {
+        tb_float* data;    /**< Raw data as contigious array, when dtype is NDA_DTYPE_FLOAT */
+        uint16_t* data16;  /**< Raw data of NDA_DTYPE_F16 and NDA_DTYPE_BF16 arrays */
+        void* raw;         /**< Raw data of any dtype */
+    };
+    NDShape* shape;        /**< Shape of the tensor */
+    NDDType dtype;         /**< Storage type of the elements */
+    NDQuantParams* quant;  /**< Quantization parameters of U8/I8 arrays holding quantized values, NULL otherwise */
+    NDSparse* sparse;      /**< CSR index of sparse matrices whose data holds the nnz stored values, NULL for dense arrays */
 }NDArray;
 
 #endif
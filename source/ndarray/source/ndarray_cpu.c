@@ -0,0 +1,78 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file ndarray_cpu.c
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing the detection of the instruction set extensions used by the vectorized kernels.
+ */
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include <ndarray_cpu.h>
+
+static uint32_t _nda_cpuDetected = 0;
+static uint32_t _nda_cpuMask = NDA_CPU_ALL;
+static pthread_once_t _nda_cpuOnce = PTHREAD_ONCE_INIT;
+
+static void _nda_cpuDetect(void){
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    
+    _nda_cpuDetected |= __builtin_cpu_supports("avx2") ? NDA_CPU_AVX2 : 0;
+    _nda_cpuDetected |= __builtin_cpu_supports("fma") ? NDA_CPU_FMA : 0;
+    _nda_cpuDetected |= __builtin_cpu_supports("f16c") ? NDA_CPU_F16C : 0;
+    _nda_cpuDetected |= __builtin_cpu_supports("avx512f") ? NDA_CPU_AVX512F : 0;
+    _nda_cpuDetected |= __builtin_cpu_supports("avx512vl") ? NDA_CPU_AVX512VL : 0;
+    _nda_cpuDetected |= __builtin_cpu_supports("avx512bf16") ? NDA_CPU_AVX512BF16 : 0;
+    _nda_cpuDetected |= __builtin_cpu_supports("avx512vnni") ? NDA_CPU_AVX512VNNI : 0;
+    _nda_cpuDetected |= __builtin_cpu_supports("avxvnni") ? NDA_CPU_AVXVNNI : 0;
+#endif
+}
+
+uint32_t nda_cpuFeatures(void){
+    pthread_once(&_nda_cpuOnce, _nda_cpuDetect);
+    
+    return _nda_cpuDetected & __atomic_load_n(&_nda_cpuMask, __ATOMIC_RELAXED);
+}
+
+uint32_t nda_cpuRestrictFeatures(uint32_t mask){
+    return __atomic_exchange_n(&_nda_cpuMask, mask, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,517 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file ndarray_dtype.c
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing the storage types of arrays and their conversions.
+ *
+ * Half precision conversions follow the branch-light scalar formulation of F. Giesen,
+ * vectorized through F16C / AVX-512 BF16 when the compiler targets them (e.g -march=native).
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ndarray.h"
+#include "ndarray_std.h"
+#include "ndarray_mem.h"
+#include "ndarray_cpu.h"
+
+#if (TB_TYPE == TB_FLOAT) && (defined(__x86_64__) || defined(__i386__))
+#define NDA_DTYPE_X86 1
+#include <immintrin.h>
+#endif
+
+static inline uint32_t _nda_floatBits(float f){
+    uint32_t u;
+    memcpy(&u, &f, sizeof(uint32_t));
+    return u;
+}
+
+static inline float _nda_bitsFloat(uint32_t u){
+    float f;
+    memcpy(&f, &u, sizeof(float));
+    return f;
+}
+
+float nda_halfToFloat(uint16_t h){
+    const uint32_t shifted_exp = 0x7c00 << 13;
+    
+    uint32_t o = (uint32_t)(h & 0x7fff) << 13;
+    uint32_t exp = shifted_exp & o;
+    o += (127 - 15) << 23;
+    
+    if(exp == shifted_exp){
+        // inf & nan
+        o += (128 - 16) << 23;
+    }
+    else if(exp == 0){
+        // zero & subnormals, renormalized by the FPU
+        o += 1 << 23;
+        o = _nda_floatBits(_nda_bitsFloat(o) - _nda_bitsFloat(113 << 23));
+    }
+    
+    o |= (uint32_t)(h & 0x8000) << 16;
+    
+    return _nda_bitsFloat(o);
+}
+
+uint16_t nda_floatToHalf(float f){
+    const uint32_t f32infty = 255 << 23;
+    const uint32_t f16max = (127 + 16) << 23;
+    const uint32_t denorm_magic = ((127 - 15) + (23 - 10) + 1) << 23;
+    
+    uint32_t u = _nda_floatBits(f);
+    uint32_t sign = u & 0x80000000u;
+    uint16_t o;
+    
+    u ^= sign;
+    
+    if(u >= f16max){
+        // overflow to inf, nan stays a quiet nan
+        o = (u > f32infty) ? 0x7e00 : 0x7c00;
+    }
+    else if(u < (113 << 23)){
+        // subnormals, the FPU rounds the mantissa while adding the magic number
+        o = (uint16_t)(_nda_floatBits(_nda_bitsFloat(u) + _nda_bitsFloat(denorm_magic)) - denorm_magic);
+    }
+    else {
+        uint32_t mant_odd = (u >> 13) & 1;
+        u += ((uint32_t)(15 - 127) << 23) + 0xfff;
+        u += mant_odd;
+        o = (uint16_t)(u >> 13);
+    }
+    
+    return o | (uint16_t)(sign >> 16);
+}
+
+float nda_bf16ToFloat(uint16_t h){
+    return _nda_bitsFloat((uint32_t)h << 16);
+}
+
+uint16_t nda_floatToBf16(float f){
+    uint32_t u = _nda_floatBits(f);
+    
+    if((u & 0x7fffffff) > 0x7f800000){
+        return (uint16_t)((u >> 16) | 0x40);
+    }
+    
+    u += 0x7fff + ((u >> 16) & 1);
+    
+    return (uint16_t)(u >> 16);
+}
+
+uint64_t nda_dtypeSize(NDDType dtype){
+    switch(dtype){
+        case NDA_DTYPE_F32:
+            return sizeof(float);
+        case NDA_DTYPE_F64:
+            return sizeof(double);
+        case NDA_DTYPE_F16:
+        case NDA_DTYPE_BF16:
+            return sizeof(uint16_t);
+        case NDA_DTYPE_I32:
+            return sizeof(int32_t);
+        case NDA_DTYPE_I64:
+            return sizeof(int64_t);
+        case NDA_DTYPE_U8:
+        case NDA_DTYPE_BOOL:
+            return sizeof(uint8_t);
+        case NDA_DTYPE_I8:
+            return sizeof(int8_t);
+    }
+    
+    ASSERT(0, "Unknown dtype %d", dtype);
+    return 0;
+}
+
+const char* nda_dtypeName(NDDType dtype){
+    switch(dtype){
+        case NDA_DTYPE_F32:
+            return "f32";
+        case NDA_DTYPE_F64:
+            return "f64";
+        case NDA_DTYPE_F16:
+            return "f16";
+        case NDA_DTYPE_BF16:
+            return "bf16";
+        case NDA_DTYPE_I32:
+            return "i32";
+        case NDA_DTYPE_I64:
+            return "i64";
+        case NDA_DTYPE_U8:
+            return "u8";
+        case NDA_DTYPE_BOOL:
+            return "bool";
+        case NDA_DTYPE_I8:
+            return "i8";
+    }
+    
+    return "unknown";
+}
+
+uint8_t nda_dtypeIsInteger(NDDType dtype){
+    return (dtype == NDA_DTYPE_I32) || (dtype == NDA_DTYPE_I64) || (dtype == NDA_DTYPE_U8) ||
+           (dtype == NDA_DTYPE_BOOL) || (dtype == NDA_DTYPE_I8);
+}
+
+NDArray* nda_allocType(NDShape* shape, NDDType dtype){
+    NDArray* x = calloc(1, sizeof(NDArray));
+    
+    x->shape = shape;
+    x->raw = nda_memCalloc(nda_getTotalSize(shape), nda_dtypeSize(dtype));
+    x->dtype = dtype;
+    
+    return x;
+}
+
+tb_float nda_rawGet(NDArray* array, uint64_t offset){
+    switch(array->dtype){
+        case NDA_DTYPE_F32:
+            return (tb_float)((float*)array->raw)[offset];
+        case NDA_DTYPE_F64:
+            return (tb_float)((double*)array->raw)[offset];
+        case NDA_DTYPE_F16:
+            return (tb_float)nda_halfToFloat(array->data16[offset]);
+        case NDA_DTYPE_BF16:
+            return (tb_float)nda_bf16ToFloat(array->data16[offset]);
+        case NDA_DTYPE_I32:
+            return (tb_float)((int32_t*)array->raw)[offset];
+        case NDA_DTYPE_I64:
+            return (tb_float)((int64_t*)array->raw)[offset];
+        case NDA_DTYPE_U8:
+        case NDA_DTYPE_BOOL:
+            return (tb_float)((uint8_t*)array->raw)[offset];
+        case NDA_DTYPE_I8:
+            return (tb_float)((int8_t*)array->raw)[offset];
+    }
+    
+    return 0;
+}
+
+#ifdef NDA_DTYPE_X86
+/*
+ * Vectorized conversions, compiled for their extension and only called when `nda_cpuFeatures` has it. Each one
+ * converts the longest prefix made of whole vectors and returns its length, the scalar loops finish the rest.
+ */
+__attribute__((target("avx,f16c")))
+static uint64_t _nda_halfToFloatF16C(const uint16_t* s, float* d, uint64_t len){
+    uint64_t i = 0;
+    
+    for(; i + 8 <= len; i += 8){
+        __m128i h = _mm_loadu_si128((const __m128i*)(s + i));
+        _mm256_storeu_ps(d + i, _mm256_cvtph_ps(h));
+    }
+    
+    return i;
+}
+
+__attribute__((target("avx,f16c")))
+static uint64_t _nda_floatToHalfF16C(const float* s, uint16_t* d, uint64_t len){
+    uint64_t i = 0;
+    
+    for(; i + 8 <= len; i += 8){
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(s + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        _mm_storeu_si128((__m128i*)(d + i), h);
+    }
+    
+    return i;
+}
+
+/*
+ * Denormal inputs convert to zero, unlike `nda_floatToBf16`
+ */
+__attribute__((target("avx512f,avx512vl,avx512bf16")))
+static uint64_t _nda_floatToBf16AVX512(const float* s, uint16_t* d, uint64_t len){
+    uint64_t i = 0;
+    
+    for(; i + 16 <= len; i += 16){
+        __m256bh h = _mm512_cvtneps_pbh(_mm512_loadu_ps(s + i));
+        _mm256_storeu_si256((__m256i*)(d + i), (__m256i)h);
+    }
+    
+    return i;
+}
+#endif
+
+void nda_toFloat(const void* src, NDDType dtype, tb_float* dst, uint64_t len){
+    uint64_t i = 0;
+    
+    switch(dtype){
+        case NDA_DTYPE_F32:{
+            const float* s = src;
+            for(; i < len; i++)
+                dst[i] = (tb_float)s[i];
+            break;
+        }
+        case NDA_DTYPE_F64:{
+            const double* s = src;
+            for(; i < len; i++)
+                dst[i] = (tb_float)s[i];
+            break;
+        }
+        case NDA_DTYPE_F16:{
+            const uint16_t* s = src;
+#ifdef NDA_DTYPE_X86
+            if(nda_cpuHas(NDA_CPU_F16C))
+                i = _nda_halfToFloatF16C(s, dst, len);
+#endif
+            for(; i < len; i++)
+                dst[i] = (tb_float)nda_halfToFloat(s[i]);
+            break;
+        }
+        case NDA_DTYPE_BF16:{
+            const uint16_t* s = src;
+            for(; i < len; i++)
+                dst[i] = (tb_float)nda_bf16ToFloat(s[i]);
+            break;
+        }
+        case NDA_DTYPE_I32:{
+            const int32_t* s = src;
+            for(; i < len; i++)
+                dst[i] = (tb_float)s[i];
+            break;
+        }
+        case NDA_DTYPE_I64:{
+            const int64_t* s = src;
+            for(; i < len; i++)
+                dst[i] = (tb_float)s[i];
+            break;
+        }
+        case NDA_DTYPE_U8:
+        case NDA_DTYPE_BOOL:{
+            const uint8_t* s = src;
+            for(; i < len; i++)
+                dst[i] = (tb_float)s[i];
+            break;
+        }
+        case NDA_DTYPE_I8:{
+            const int8_t* s = src;
+            for(; i < len; i++)
+                dst[i] = (tb_float)s[i];
+            break;
+        }
+    }
+}
+
+/*
+ * Rounds half away from zero and saturates to [lo, hi] like the quantization path, NaN converts to 0. The clamp
+ * happens in double so out of range values never reach the integer conversion.
+ */
+static inline int64_t _nda_roundSaturate(double v, int64_t lo, int64_t hi){
+    if(v != v)
+        return 0;
+    if(v <= (double)lo)
+        return lo;
+    if(v >= (double)hi)
+        return hi;
+    
+    return (int64_t)(v >= 0 ? v + 0.5 : v - 0.5);
+}
+
+void nda_fromFloat(const tb_float* src, NDDType dtype, void* dst, uint64_t len){
+    uint64_t i = 0;
+    
+    switch(dtype){
+        case NDA_DTYPE_F32:{
+            float* d = dst;
+            for(; i < len; i++)
+                d[i] = (float)src[i];
+            break;
+        }
+        case NDA_DTYPE_F64:{
+            double* d = dst;
+            for(; i < len; i++)
+                d[i] = (double)src[i];
+            break;
+        }
+        case NDA_DTYPE_F16:{
+            uint16_t* d = dst;
+#ifdef NDA_DTYPE_X86
+            if(nda_cpuHas(NDA_CPU_F16C))
+                i = _nda_floatToHalfF16C(src, d, len);
+#endif
+            for(; i < len; i++)
+                d[i] = nda_floatToHalf((float)src[i]);
+            break;
+        }
+        case NDA_DTYPE_BF16:{
+            uint16_t* d = dst;
+#ifdef NDA_DTYPE_X86
+            if(nda_cpuHas(NDA_CPU_AVX512F | NDA_CPU_AVX512VL | NDA_CPU_AVX512BF16))
+                i = _nda_floatToBf16AVX512(src, d, len);
+#endif
+            for(; i < len; i++)
+                d[i] = nda_floatToBf16((float)src[i]);
+            break;
+        }
+        case NDA_DTYPE_I32:{
+            int32_t* d = dst;
+            for(; i < len; i++)
+                d[i] = (int32_t)_nda_roundSaturate((double)src[i], INT32_MIN, INT32_MAX);
+            break;
+        }
+        case NDA_DTYPE_I64:{
+            int64_t* d = dst;
+            for(; i < len; i++)
+                d[i] = (int64_t)_nda_roundSaturate((double)src[i], INT64_MIN, INT64_MAX);
+            break;
+        }
+        case NDA_DTYPE_U8:{
+            uint8_t* d = dst;
+            for(; i < len; i++)
+                d[i] = (uint8_t)_nda_roundSaturate((double)src[i], 0, UINT8_MAX);
+            break;
+        }
+        case NDA_DTYPE_BOOL:{
+            uint8_t* d = dst;
+            for(; i < len; i++)
+                d[i] = src[i] != 0;
+            break;
+        }
+        case NDA_DTYPE_I8:{
+            int8_t* d = dst;
+            for(; i < len; i++)
+                d[i] = (int8_t)_nda_roundSaturate((double)src[i], INT8_MIN, INT8_MAX);
+            break;
+        }
+    }
+}
+
+/*
+ * Widening to F64 does not go through tb_float, so that F32 values and integers above 2^24 convert exactly.
+ * The narrower types are exact in single precision.
+ */
+static void _nda_toDouble(const uint8_t* src, NDDType dtype, uint64_t step, double* dst, uint64_t len){
+    uint64_t esize = nda_dtypeSize(dtype);
+    uint64_t i = 0;
+    
+    switch(dtype){
+        case NDA_DTYPE_F32:
+            for(; i < len; i++)
+                dst[i] = (double)((const float*)src)[i*step];
+            break;
+        case NDA_DTYPE_I32:
+            for(; i < len; i++)
+                dst[i] = (double)((const int32_t*)src)[i*step];
+            break;
+        case NDA_DTYPE_I64:
+            for(; i < len; i++)
+                dst[i] = (double)((const int64_t*)src)[i*step];
+            break;
+        default:
+            for(; i < len; i++){
+                tb_float v;
+                nda_toFloat(src + i*step*esize, dtype, &v, 1);
+                dst[i] = (double)v;
+            }
+            break;
+    }
+}
+
+NDArray* nda_cast(NDArray* x, NDDType dtype){
+    ASSERT(x->sparse == NULL, "Cannot cast a sparse matrix, see nda_sparseToDense");
+    NDShape* shape = x->shape;
+    uint64_t rank = shape->rank;
+    uint64_t len = shape->raw_len;
+    uint64_t cols = shape->dims[rank-1];
+    uint64_t step = shape->strides[rank-1];
+    
+    NDArray* res = nda_allocType(nda_newShapeFromArrayCopy(rank, shape->dims), dtype);
+    uint64_t esize = nda_dtypeSize(dtype);
+    uint8_t same = (x->dtype == dtype);
+    
+    // one row at a time, through a tb_float staging buffer when the dtype changes to anything but F64
+    tb_float* row = calloc(cols, sizeof(tb_float));
+    uint64_t* index = calloc(rank, sizeof(uint64_t));
+    uint64_t r = 0;
+    
+    for(; cols > 0 && r < len / cols; r++){
+        uint64_t offset = 0;
+        uint64_t i = 0;
+        for(; i + 1 < rank; i++){
+            offset += index[i]*shape->strides[i];
+        }
+        
+        uint8_t* src = (uint8_t*)x->raw + offset*nda_dtypeSize(x->dtype);
+        uint8_t* dst = (uint8_t*)res->raw + r*cols*esize;
+        
+        if(same && step == 1){
+            memcpy(dst, src, cols*esize);
+        }
+        else if(!same && (dtype == NDA_DTYPE_F64)){
+            _nda_toDouble(src, x->dtype, step, (double*)dst, cols);
+        }
+        else if(same){
+            for(i = 0; i < cols; i++){
+                memcpy(dst + i*esize, src + i*step*esize, esize);
+            }
+        }
+        else if(step == 1){
+            nda_toFloat(src, x->dtype, row, cols);
+            nda_fromFloat(row, dtype, dst, cols);
+        }
+        else {
+            for(i = 0; i < cols; i++){
+                row[i] = nda_rawGet(x, offset + i*step);
+            }
+            nda_fromFloat(row, dtype, dst, cols);
+        }
+        
+        i = rank - 1;
+        while(i > 0){
+            i--;
+            if(++index[i] < shape->dims[i]){
+                break;
+            }
+            index[i] = 0;
+        }
+    }
+    
+    free(index);
+    free(row);
+    
+    if(same){
+        res->quant = nda_copyQuantParams(x->quant);
+    }
+    
+    return res;
+}
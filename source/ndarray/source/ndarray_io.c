@@ -0,0 +1,401 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file ndarray_io.c
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing the binary archive format implementation.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ndarray.h"
+#include "ndarray_std.h"
+#include "ndarray_io.h"
+
+/**
+ * \brief On disk header, always NDA_ARCHIVE_ALIGN bytes long
+ */
+typedef struct NDArchiveHeader {
+    char magic[8];          /**< NDA_ARCHIVE_MAGIC */
+    uint32_t version;       /**< NDA_ARCHIVE_VERSION */
+    uint32_t reserved;      /**< Always 0 */
+    uint64_t count;         /**< Number of arrays */
+    uint64_t index_offset;  /**< Offset of the first index entry */
+    uint64_t index_len;     /**< Size in bytes of the index */
+    uint64_t file_len;      /**< Total size of the archive */
+    uint8_t padding[16];    /**< Pads the header to NDA_ARCHIVE_ALIGN */
+}NDArchiveHeader;
+
+/**
+ * \brief On disk index entry, followed by rank dims, quant_count float scales and a
+ * NULL terminated name padded to 8 bytes
+ */
+typedef struct NDArchiveEntry {
+    uint32_t name_len;     /**< Length of the name, excluding the NULL terminator */
+    uint16_t rank;         /**< Rank of the array */
+    uint16_t dtype;        /**< NDDType of the elements */
+    uint64_t offset;       /**< Offset of the data, multiple of NDA_ARCHIVE_ALIGN */
+    uint64_t len;          /**< Number of elements */
+    uint32_t quant_count;  /**< Number of quantization scales, 0 if the array is not quantized */
+    int32_t zero_point;    /**< Quantization zero point */
+    uint64_t quant_axis;   /**< Quantization channel axis */
+}NDArchiveEntry;
+
+struct NDArchive {
+    uint8_t* base;      /**< Mapped file */
+    uint64_t size;      /**< Size of the mapping */
+    uint64_t count;     /**< Number of arrays */
+    char** names;       /**< Names, pointing into the mapping */
+    NDArray** arrays;   /**< Arrays, data pointing into the mapping */
+};
+
+static inline uint64_t _nda_alignUp(uint64_t value, uint64_t align){
+    return (value + align - 1) / align * align;
+}
+
+static inline uint64_t _nda_entrySize(uint64_t rank, uint64_t quant_count, uint64_t name_len){
+    return _nda_alignUp(sizeof(NDArchiveEntry) + rank*sizeof(uint64_t) + quant_count*sizeof(float) + name_len + 1, 8);
+}
+
+static inline uint64_t _nda_quantCount(NDArray* array){
+    return array->quant == NULL ? 0 : array->quant->count;
+}
+
+static uint8_t _nda_writePadding(FILE* file, uint64_t len){
+    static const uint8_t zeros[NDA_ARCHIVE_ALIGN] = {0};
+    
+    while(len > 0){
+        uint64_t n = len < NDA_ARCHIVE_ALIGN ? len : NDA_ARCHIVE_ALIGN;
+        if(fwrite(zeros, 1, n, file) != n){
+            return 0;
+        }
+        len -= n;
+    }
+    
+    return 1;
+}
+
+uint8_t nda_writeArchive(FILE* file, uint64_t count, const char** names, NDArray** arrays){
+    uint64_t index_len = 0;
+    uint64_t i = 0;
+    
+    for(; i < count; i++){
+        if(arrays[i]->shape->rank == 0 || arrays[i]->shape->rank > UINT16_MAX || _nda_quantCount(arrays[i]) > UINT32_MAX ||
+           arrays[i]->sparse != NULL){
+            return 0;
+        }
+        index_len += _nda_entrySize(arrays[i]->shape->rank, _nda_quantCount(arrays[i]), strlen(names[i]));
+    }
+    
+    uint64_t* offsets = calloc(count, sizeof(uint64_t));
+    uint64_t cursor = _nda_alignUp(sizeof(NDArchiveHeader) + index_len, NDA_ARCHIVE_ALIGN);
+    
+    for(i = 0; i < count; i++){
+        offsets[i] = cursor;
+        cursor = _nda_alignUp(cursor + arrays[i]->shape->raw_len*nda_dtypeSize(arrays[i]->dtype), NDA_ARCHIVE_ALIGN);
+    }
+    
+    NDArchiveHeader header;
+    memset(&header, 0, sizeof(NDArchiveHeader));
+    memcpy(header.magic, NDA_ARCHIVE_MAGIC, sizeof(header.magic));
+    header.version = NDA_ARCHIVE_VERSION;
+    header.count = count;
+    header.index_offset = sizeof(NDArchiveHeader);
+    header.index_len = index_len;
+    header.file_len = cursor;
+    
+    uint8_t ok = fwrite(&header, sizeof(NDArchiveHeader), 1, file) == 1;
+    
+    for(i = 0; i < count && ok; i++){
+        NDShape* shape = arrays[i]->shape;
+        NDQuantParams* quant = arrays[i]->quant;
+        uint64_t name_len = strlen(names[i]);
+        uint64_t quant_count = _nda_quantCount(arrays[i]);
+        
+        NDArchiveEntry entry;
+        memset(&entry, 0, sizeof(NDArchiveEntry));
+        entry.name_len = (uint32_t)name_len;
+        entry.rank = (uint16_t)shape->rank;
+        entry.dtype = (uint16_t)arrays[i]->dtype;
+        entry.offset = offsets[i];
+        entry.len = shape->raw_len;
+        
+        if(quant != NULL){
+            entry.quant_count = (uint32_t)quant_count;
+            entry.zero_point = quant->zero_point;
+            entry.quant_axis = quant->axis;
+        }
+        
+        uint64_t written = sizeof(NDArchiveEntry) + shape->rank*sizeof(uint64_t) + quant_count*sizeof(float) + name_len;
+        
+        ok = fwrite(&entry, sizeof(NDArchiveEntry), 1, file) == 1 &&
+             fwrite(shape->dims, sizeof(uint64_t), shape->rank, file) == shape->rank &&
+             (quant == NULL || fwrite(quant->scales, sizeof(float), quant_count, file) == quant_count) &&
+             fwrite(names[i], 1, name_len, file) == name_len &&
+             _nda_writePadding(file, _nda_entrySize(shape->rank, quant_count, name_len) - written);
+    }
+    
+    uint64_t position = sizeof(NDArchiveHeader) + index_len;
+    
+    for(i = 0; i < count && ok; i++){
+        NDArray* array = arrays[i];
+        uint64_t len = array->shape->raw_len;
+        uint64_t esize = nda_dtypeSize(array->dtype);
+        ok = _nda_writePadding(file, offsets[i] - position);
+        
+        if(ok && nda_isContiguous(array->shape)){
+            ok = fwrite(array->raw, esize, len, file) == len;
+        }
+        else if(ok){
+            NDArray* gathered = nda_cast(array, array->dtype);
+            ok = fwrite(gathered->raw, esize, len, file) == len;
+            nda_free(gathered);
+            free(gathered);
+        }
+        
+        position = offsets[i] + len*esize;
+    }
+    
+    if(ok){
+        ok = _nda_writePadding(file, cursor - position);
+    }
+    
+    free(offsets);
+    
+    return ok;
+}
+
+uint8_t nda_saveArchive(const char* path, uint64_t count, const char** names, NDArray** arrays){
+    FILE* file = fopen(path, "wb");
+    if(file == NULL){
+        return 0;
+    }
+    
+    uint8_t ok = nda_writeArchive(file, count, names, arrays);
+    
+    return (fclose(file) == 0) && ok;
+}
+
+/*
+ * Whether the product of the dimensions equals the number of elements, without overflowing
+ */
+static uint8_t _nda_dimsMatch(uint64_t* dims, uint64_t rank, uint64_t len){
+    uint64_t product = 1;
+    uint64_t i = 0;
+    
+    for(; i < rank; i++){
+        if(dims[i] != 0 && product > UINT64_MAX / dims[i]){
+            return 0;
+        }
+        
+        product *= dims[i];
+    }
+    
+    return product == len;
+}
+
+/*
+ * Validates the index and builds the arrays, every offset and count is checked against the
+ * mapping so a truncated or corrupted file is rejected instead of read out of bounds.
+ */
+static uint8_t _nda_loadIndex(NDArchive* archive, NDArchiveHeader* header){
+    uint64_t cursor = header->index_offset;
+    uint64_t end = header->index_offset + header->index_len;
+    
+    // every entry takes at least sizeof(NDArchiveEntry) bytes of the index
+    if(end < cursor || end > archive->size || cursor % 8 != 0 ||
+       header->count > header->index_len / sizeof(NDArchiveEntry)){
+        return 0;
+    }
+    
+    archive->names = calloc(header->count, sizeof(char*));
+    archive->arrays = calloc(header->count, sizeof(NDArray*));
+    
+    if(header->count > 0 && (archive->names == NULL || archive->arrays == NULL)){
+        return 0;
+    }
+    
+    uint64_t i = 0;
+    for(; i < header->count; i++){
+        if(end - cursor < sizeof(NDArchiveEntry)){
+            return 0;
+        }
+        
+        NDArchiveEntry* entry = (NDArchiveEntry*)(archive->base + cursor);
+        uint64_t entry_size = _nda_entrySize(entry->rank, entry->quant_count, entry->name_len);
+        
+        if(entry->rank == 0 || entry->dtype > NDA_MAX_DTYPE || entry_size > end - cursor){
+            return 0;
+        }
+        
+        uint64_t* dims = (uint64_t*)(entry + 1);
+        float* scales = (float*)(dims + entry->rank);
+        char* name = (char*)(scales + entry->quant_count);
+        
+        if(name[entry->name_len] != '\0' ||
+           (entry->quant_count > 1 && (entry->quant_axis >= entry->rank || dims[entry->quant_axis] != entry->quant_count)) ||
+           entry->offset % NDA_ARCHIVE_ALIGN != 0 ||
+           entry->offset > archive->size ||
+           entry->len > (archive->size - entry->offset) / nda_dtypeSize(entry->dtype) ||
+           !_nda_dimsMatch(dims, entry->rank, entry->len)){
+            return 0;
+        }
+        
+        NDShape* shape = nda_newShapeFromArrayCopy(entry->rank, dims);
+        if(shape->raw_len != entry->len){
+            free(shape->dims);
+            free(shape->strides);
+            free(shape);
+            return 0;
+        }
+        
+        NDArray* array = calloc(1, sizeof(NDArray));
+        array->shape = shape;
+        array->raw = archive->base + entry->offset;
+        array->dtype = (NDDType)entry->dtype;
+        
+        if(entry->quant_count > 0){
+            array->quant = nda_newQuantParams(entry->quant_count, entry->quant_axis, entry->zero_point);
+            memcpy(array->quant->scales, scales, entry->quant_count*sizeof(float));
+        }
+        
+        archive->names[i] = name;
+        archive->arrays[i] = array;
+        archive->count++;
+        
+        cursor += entry_size;
+    }
+    
+    return 1;
+}
+
+NDArchive* nda_openArchive(const char* path){
+    return nda_openArchiveAt(path, 0);
+}
+
+NDArchive* nda_openArchiveAt(const char* path, uint64_t offset){
+    int fd = open(path, O_RDONLY);
+    if(fd < 0){
+        return NULL;
+    }
+    
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (uint64_t)st.st_size < offset + sizeof(NDArchiveHeader)){
+        close(fd);
+        return NULL;
+    }
+    
+    uint64_t size = st.st_size - offset;
+    void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, (off_t)offset);
+    close(fd);
+    
+    if(base == MAP_FAILED){
+        return NULL;
+    }
+    
+    NDArchive* archive = calloc(1, sizeof(NDArchive));
+    archive->base = base;
+    archive->size = size;
+    
+    NDArchiveHeader* header = (NDArchiveHeader*)base;
+    
+    if(memcmp(header->magic, NDA_ARCHIVE_MAGIC, sizeof(header->magic)) != 0 ||
+       header->version != NDA_ARCHIVE_VERSION ||
+       header->file_len != archive->size ||
+       !_nda_loadIndex(archive, header)){
+        nda_closeArchive(archive);
+        return NULL;
+    }
+    
+    return archive;
+}
+
+uint64_t nda_archiveCount(NDArchive* archive){
+    return archive->count;
+}
+
+const char* nda_archiveName(NDArchive* archive, uint64_t i){
+    ASSERT(i < archive->count, "Cannot fetch array %lld of an archive of %lld arrays", i, archive->count);
+    
+    return archive->names[i];
+}
+
+NDArray* nda_archiveArray(NDArchive* archive, uint64_t i){
+    ASSERT(i < archive->count, "Cannot fetch array %lld of an archive of %lld arrays", i, archive->count);
+    
+    return archive->arrays[i];
+}
+
+NDArray* nda_archiveGet(NDArchive* archive, const char* name){
+    uint64_t i = 0;
+    
+    for(; i < archive->count; i++){
+        if(strcmp(archive->names[i], name) == 0){
+            return archive->arrays[i];
+        }
+    }
+    
+    return NULL;
+}
+
+void nda_closeArchive(NDArchive* archive){
+    uint64_t i = 0;
+    
+    for(; i < archive->count; i++){
+        NDArray* array = archive->arrays[i];
+        nda_freeQuantParams(array->quant);
+        free(array->shape->dims);
+        free(array->shape->strides);
+        free(array->shape);
+        free(array);
+    }
+    
+    free(archive->arrays);
+    free(archive->names);
+    munmap(archive->base, archive->size);
+    free(archive);
+}
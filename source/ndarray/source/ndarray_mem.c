@@ -0,0 +1,180 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file ndarray_mem.c
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing the accounting of tensor buffers.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "ndarray_mem.h"
+
+struct NDMemTracker {
+    NDMemCounters counters;        /**< Counters of the allocations charged to the tracker */
+    NDMemTracker* parent;          /**< Tracker charged along, NULL if none */
+    uint64_t refs;                 /**< Owner reference and one per live buffer charged to the tracker */
+};
+
+/*
+ * Prefix of every buffer, keeps the returned pointer 16 bytes aligned like calloc
+ */
+typedef struct __attribute__((aligned(16))) _NDMemHeader {
+    uint64_t size;                 /**< Bytes requested */
+    NDMemTracker* tracker;         /**< Tracker charged with the buffer, NULL if none */
+}_NDMemHeader;
+
+static NDMemCounters _nda_memGlobal = {0, 0, 0, 0, 0};
+static __thread NDMemTracker* _nda_memCurrent = NULL;
+
+static void _nda_memCharge(NDMemCounters* counters, uint64_t size){
+    uint64_t current = __atomic_add_fetch(&counters->current, size, __ATOMIC_RELAXED);
+    uint64_t peak = __atomic_load_n(&counters->peak, __ATOMIC_RELAXED);
+    
+    while((current > peak) && !__atomic_compare_exchange_n(&counters->peak, &peak, current, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    
+    __atomic_add_fetch(&counters->total, size, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&counters->allocations, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&counters->live, 1, __ATOMIC_RELAXED);
+}
+
+static void _nda_memCredit(NDMemCounters* counters, uint64_t size){
+    __atomic_sub_fetch(&counters->current, size, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&counters->live, 1, __ATOMIC_RELAXED);
+}
+
+static void _nda_memUnref(NDMemTracker* tracker){
+    while((tracker != NULL) && (__atomic_sub_fetch(&tracker->refs, 1, __ATOMIC_ACQ_REL) == 0)){
+        NDMemTracker* parent = tracker->parent;
+        free(tracker);
+        tracker = parent;
+    }
+}
+
+NDMemTracker* nda_newMemTracker(NDMemTracker* parent){
+    NDMemTracker* tracker = calloc(1, sizeof(NDMemTracker));
+    tracker->parent = parent;
+    tracker->refs = 1;
+    
+    // children keep their parents alive
+    if(parent != NULL){
+        __atomic_add_fetch(&parent->refs, 1, __ATOMIC_RELAXED);
+    }
+    
+    return tracker;
+}
+
+void nda_releaseMemTracker(NDMemTracker* tracker){
+    _nda_memUnref(tracker);
+}
+
+NDMemTracker* nda_memSetTracker(NDMemTracker* tracker){
+    NDMemTracker* previous = _nda_memCurrent;
+    _nda_memCurrent = tracker;
+    
+    return previous;
+}
+
+NDMemTracker* nda_memGetTracker(void){
+    return _nda_memCurrent;
+}
+
+NDMemCounters nda_memCounters(NDMemTracker* tracker){
+    NDMemCounters* counters = (tracker != NULL) ? &tracker->counters : &_nda_memGlobal;
+    NDMemCounters res;
+    
+    res.current = __atomic_load_n(&counters->current, __ATOMIC_RELAXED);
+    res.peak = __atomic_load_n(&counters->peak, __ATOMIC_RELAXED);
+    res.total = __atomic_load_n(&counters->total, __ATOMIC_RELAXED);
+    res.allocations = __atomic_load_n(&counters->allocations, __ATOMIC_RELAXED);
+    res.live = __atomic_load_n(&counters->live, __ATOMIC_RELAXED);
+    
+    return res;
+}
+
+void nda_memResetPeak(NDMemTracker* tracker){
+    NDMemCounters* counters = (tracker != NULL) ? &tracker->counters : &_nda_memGlobal;
+    
+    __atomic_store_n(&counters->peak, __atomic_load_n(&counters->current, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+}
+
+void* nda_memCalloc(uint64_t count, uint64_t size){
+    uint64_t bytes = count*size;
+    _NDMemHeader* header = calloc(1, sizeof(_NDMemHeader) + bytes);
+    
+    if(header == NULL){
+        return NULL;
+    }
+    
+    NDMemTracker* tracker = _nda_memCurrent;
+    header->size = bytes;
+    header->tracker = tracker;
+    
+    _nda_memCharge(&_nda_memGlobal, bytes);
+    
+    if(tracker != NULL){
+        __atomic_add_fetch(&tracker->refs, 1, __ATOMIC_RELAXED);
+    }
+    
+    for(; tracker != NULL; tracker = tracker->parent){
+        _nda_memCharge(&tracker->counters, bytes);
+    }
+    
+    return header + 1;
+}
+
+void nda_memFree(void* ptr){
+    if(ptr == NULL){
+        return;
+    }
+    
+    _NDMemHeader* header = (_NDMemHeader*)ptr - 1;
+    NDMemTracker* tracker = header->tracker;
+    
+    _nda_memCredit(&_nda_memGlobal, header->size);
+    
+    for(; tracker != NULL; tracker = tracker->parent){
+        _nda_memCredit(&tracker->counters, header->size);
+    }
+    
+    _nda_memUnref(header->tracker);
+    free(header);
+}
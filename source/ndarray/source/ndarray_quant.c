@@ -0,0 +1,275 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file ndarray_quant.c
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing the affine 8 bits quantization of arrays.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ndarray.h"
+#include "ndarray_std.h"
+
+static void _nda_quantRange(NDDType dtype, int32_t* lo, int32_t* hi){
+    ASSERT(dtype == NDA_DTYPE_U8 || dtype == NDA_DTYPE_I8, "Cannot quantize to dtype %s", nda_dtypeName(dtype));
+    
+    *lo = dtype == NDA_DTYPE_U8 ? 0 : -128;
+    *hi = dtype == NDA_DTYPE_U8 ? 255 : 127;
+}
+
+/*
+ * Rounds half away from zero after clamping, the clamp happens in float so
+ * out of range values never overflow the integer conversion.
+ */
+static inline int32_t _nda_roundClamp(float v, int32_t lo, int32_t hi){
+    v = v < (float)lo ? (float)lo : (v > (float)hi ? (float)hi : v);
+    
+    return (int32_t)(v >= 0 ? v + 0.5f : v - 0.5f);
+}
+
+static void _nda_quantizeRow(const tb_float* src, void* dst, NDDType dtype, uint64_t len, float scale, int32_t zero_point){
+    int32_t lo, hi;
+    _nda_quantRange(dtype, &lo, &hi);
+    
+    float inv_scale = 1.0f / scale;
+    float flo = (float)(lo - zero_point);
+    float fhi = (float)(hi - zero_point);
+    uint64_t i = 0;
+    
+    if(dtype == NDA_DTYPE_U8){
+        uint8_t* d = dst;
+        for(; i < len; i++)
+            d[i] = (uint8_t)(_nda_roundClamp((float)src[i]*inv_scale, (int32_t)flo, (int32_t)fhi) + zero_point);
+    }
+    else {
+        int8_t* d = dst;
+        for(; i < len; i++)
+            d[i] = (int8_t)(_nda_roundClamp((float)src[i]*inv_scale, (int32_t)flo, (int32_t)fhi) + zero_point);
+    }
+}
+
+/*
+ * Returns x as a contiguous tb_float array, x itself when it already is one.
+ */
+static NDArray* _nda_floatView(NDArray* x){
+    if(x->quant != NULL){
+        return nda_dequantize(x);
+    }
+    
+    if(x->dtype == NDA_DTYPE_FLOAT && nda_isContiguous(x->shape)){
+        return x;
+    }
+    
+    return nda_cast(x, NDA_DTYPE_FLOAT);
+}
+
+static void _nda_releaseView(NDArray* view, NDArray* x){
+    if(view != x){
+        nda_free(view);
+        free(view);
+    }
+}
+
+NDQuantParams* nda_newQuantParams(uint64_t count, uint64_t axis, int32_t zero_point){
+    ASSERT(count > 0, "Quantization parameters need at least one scale");
+    
+    NDQuantParams* params = calloc(1, sizeof(NDQuantParams));
+    params->count = count;
+    params->axis = axis;
+    params->zero_point = zero_point;
+    params->scales = calloc(count, sizeof(float));
+    
+    return params;
+}
+
+NDQuantParams* nda_copyQuantParams(NDQuantParams* params){
+    if(params == NULL){
+        return NULL;
+    }
+    
+    NDQuantParams* copy = nda_newQuantParams(params->count, params->axis, params->zero_point);
+    memcpy(copy->scales, params->scales, params->count*sizeof(float));
+    
+    return copy;
+}
+
+void nda_freeQuantParams(NDQuantParams* params){
+    if(params == NULL){
+        return;
+    }
+    
+    free(params->scales);
+    free(params);
+}
+
+void nda_chooseQuantParams(float min, float max, NDDType dtype, float* scale, int32_t* zero_point){
+    int32_t lo, hi;
+    _nda_quantRange(dtype, &lo, &hi);
+    
+    min = min < 0 ? min : 0;
+    max = max > 0 ? max : 0;
+    
+    if(dtype == NDA_DTYPE_I8){
+        float bound = -min > max ? -min : max;
+        *scale = bound > 0 ? bound / 127.0f : 1.0f;
+        *zero_point = 0;
+        
+        return;
+    }
+    
+    *scale = max > min ? (max - min) / (float)(hi - lo) : 1.0f;
+    *zero_point = _nda_roundClamp(lo - min / *scale, lo, hi);
+}
+
+NDArray* nda_quantize(NDArray* x, NDDType dtype, float scale, int32_t zero_point){
+    NDArray* res = nda_allocType(nda_newShapeFromArrayCopy(x->shape->rank, x->shape->dims), dtype);
+    res->quant = nda_newQuantParams(1, 0, zero_point);
+    res->quant->scales[0] = scale;
+    
+    nda_quantizeInto(res, x, scale, zero_point);
+    
+    return res;
+}
+
+NDArray* nda_quantizePerChannel(NDArray* x, uint64_t axis){
+    NDShape* shape = x->shape;
+    ASSERT(axis < shape->rank, "Cannot quantize along axis %lld of an array of rank %lld", axis, shape->rank);
+    
+    uint64_t channels = shape->dims[axis];
+    uint64_t inner = 1;
+    uint64_t i = axis + 1;
+    
+    for(; i < shape->rank; i++){
+        inner *= shape->dims[i];
+    }
+    
+    NDArray* view = _nda_floatView(x);
+    NDArray* res = nda_allocType(nda_newShapeFromArrayCopy(shape->rank, shape->dims), NDA_DTYPE_I8);
+    res->quant = nda_newQuantParams(channels, axis, 0);
+    
+    uint64_t len = shape->raw_len;
+    float* bounds = res->quant->scales;
+    
+    // first pass: per channel absolute maximum, second pass: quantize each contiguous run
+    for(i = 0; i < len; i++){
+        uint64_t c = (i / inner) % channels;
+        float v = (float)view->data[i];
+        v = v < 0 ? -v : v;
+        bounds[c] = v > bounds[c] ? v : bounds[c];
+    }
+    
+    for(i = 0; i < channels; i++){
+        bounds[i] = bounds[i] > 0 ? bounds[i] / 127.0f : 1.0f;
+    }
+    
+    int8_t* q = res->raw;
+    for(i = 0; i < len; i += inner){
+        _nda_quantizeRow(view->data + i, q + i, NDA_DTYPE_I8, inner, bounds[(i / inner) % channels], 0);
+    }
+    
+    _nda_releaseView(view, x);
+    
+    return res;
+}
+
+void nda_quantizeInto(NDArray* out, NDArray* x, float scale, int32_t zero_point){
+    ASSERT(out->shape->raw_len == x->shape->raw_len, "Cannot quantize %lld elements into %lld", x->shape->raw_len, out->shape->raw_len);
+    
+    NDArray* view = _nda_floatView(x);
+    
+    _nda_quantizeRow(view->data, out->raw, out->dtype, x->shape->raw_len, scale, zero_point);
+    
+    _nda_releaseView(view, x);
+}
+
+NDArray* nda_dequantize(NDArray* x){
+    NDArray* res = nda_allocType(nda_newShapeFromArrayCopy(x->shape->rank, x->shape->dims), NDA_DTYPE_FLOAT);
+    
+    nda_dequantizeInto(res, x);
+    
+    return res;
+}
+
+void nda_dequantizeInto(NDArray* out, NDArray* x){
+    ASSERT(out->shape->raw_len == x->shape->raw_len, "Cannot dequantize %lld elements into %lld", x->shape->raw_len, out->shape->raw_len);
+    
+    NDArray* src = x;
+    if(!nda_isContiguous(x->shape)){
+        src = nda_cast(x, x->dtype);
+    }
+    
+    uint64_t len = x->shape->raw_len;
+    NDQuantParams* quant = src->quant;
+    
+    if(quant == NULL){
+        nda_toFloat(src->raw, src->dtype, out->data, len);
+        _nda_releaseView(src, x);
+        
+        return;
+    }
+    
+    uint64_t inner = 1;
+    uint64_t i = quant->axis + 1;
+    
+    for(; quant->count > 1 && i < x->shape->rank; i++){
+        inner *= x->shape->dims[i];
+    }
+    
+    // each run of `inner` elements shares one scale, converted then rescaled in place
+    nda_toFloat(src->raw, src->dtype, out->data, len);
+    
+    tb_float zero_point = (tb_float)quant->zero_point;
+    uint64_t run = quant->count > 1 ? inner : len;
+    
+    for(i = 0; i < len; i += run){
+        tb_float scale = quant->scales[(i / run) % quant->count];
+        uint64_t j = i;
+        uint64_t end = i + run < len ? i + run : len;
+        
+        for(; j < end; j++){
+            out->data[j] = (out->data[j] - zero_point)*scale;
+        }
+    }
+    
+    _nda_releaseView(src, x);
+}
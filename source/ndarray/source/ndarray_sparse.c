@@ -0,0 +1,483 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file ndarray_sparse.c
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing sparse matrices stored in CSR or as row lists.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ndarray.h"
+#include "ndarray_std.h"
+#include "ndarray_mem.h"
+
+NDArray* nda_allocSparse(uint64_t rows, uint64_t cols, uint64_t nnz){
+    NDSparse* sparse = calloc(1, sizeof(NDSparse));
+    sparse->rows = rows;
+    sparse->nnz = nnz;
+    sparse->row_ptr = nda_memCalloc(rows + 1, sizeof(uint64_t));
+    sparse->col_idx = nda_memCalloc(nnz ? nnz : 1, sizeof(uint64_t));
+    
+    NDArray* x = calloc(1, sizeof(NDArray));
+    x->shape = nda_newShape(2, rows, cols);
+    x->data = nda_memCalloc(nnz ? nnz : 1, sizeof(tb_float));
+    x->dtype = NDA_DTYPE_FLOAT;
+    x->sparse = sparse;
+    
+    return x;
+}
+
+NDArray* nda_allocSparseRows(uint64_t rows, uint64_t cols, uint64_t n){
+    NDSparse* sparse = calloc(1, sizeof(NDSparse));
+    sparse->rows = rows;
+    sparse->nnz = n*cols;
+    sparse->row_ids = nda_memCalloc(n ? n : 1, sizeof(uint64_t));
+    sparse->stored_rows = n;
+    
+    NDArray* x = calloc(1, sizeof(NDArray));
+    x->shape = nda_newShape(2, rows, cols);
+    x->data = nda_memCalloc((n*cols != 0) ? n*cols : 1, sizeof(tb_float));
+    x->dtype = NDA_DTYPE_FLOAT;
+    x->sparse = sparse;
+    
+    return x;
+}
+
+NDSparse* nda_copySparseIndex(NDSparse* sparse){
+    if(sparse == NULL){
+        return NULL;
+    }
+    
+    NDSparse* copy = calloc(1, sizeof(NDSparse));
+    copy->rows = sparse->rows;
+    copy->nnz = sparse->nnz;
+    
+    if(sparse->row_ids != NULL){
+        copy->stored_rows = sparse->stored_rows;
+        copy->row_ids = nda_memCalloc(sparse->stored_rows ? sparse->stored_rows : 1, sizeof(uint64_t));
+        memcpy(copy->row_ids, sparse->row_ids, sparse->stored_rows*sizeof(uint64_t));
+        
+        return copy;
+    }
+    
+    copy->row_ptr = nda_memCalloc(sparse->rows + 1, sizeof(uint64_t));
+    copy->col_idx = nda_memCalloc(sparse->nnz ? sparse->nnz : 1, sizeof(uint64_t));
+    memcpy(copy->row_ptr, sparse->row_ptr, (sparse->rows + 1)*sizeof(uint64_t));
+    memcpy(copy->col_idx, sparse->col_idx, sparse->nnz*sizeof(uint64_t));
+    
+    return copy;
+}
+
+void nda_freeSparseIndex(NDSparse* sparse){
+    if(sparse == NULL){
+        return;
+    }
+    
+    nda_memFree(sparse->row_ptr);
+    nda_memFree(sparse->col_idx);
+    nda_memFree(sparse->row_ids);
+    free(sparse);
+}
+
+NDSparse* nda_sparseCSRIndex(NDArray* x){
+    ASSERT(x->sparse != NULL, "Expected a sparse matrix");
+    
+    NDSparse* sparse = x->sparse;
+    if(sparse->row_ids == NULL){
+        return sparse;
+    }
+    
+    uint64_t cols = x->shape->dims[1];
+    uint64_t r, c, i = 0;
+    NDSparse* index = calloc(1, sizeof(NDSparse));
+    index->rows = sparse->rows;
+    index->nnz = sparse->nnz;
+    index->row_ptr = nda_memCalloc(sparse->rows + 1, sizeof(uint64_t));
+    index->col_idx = nda_memCalloc(sparse->nnz ? sparse->nnz : 1, sizeof(uint64_t));
+    
+    for(r = 0; r < sparse->rows; r++){
+        i += (i < sparse->stored_rows) && (sparse->row_ids[i] == r);
+        index->row_ptr[r + 1] = i*cols;
+    }
+    
+    for(i = 0; i < sparse->stored_rows; i++){
+        for(c = 0; c < cols; c++){
+            index->col_idx[i*cols + c] = c;
+        }
+    }
+    
+    return index;
+}
+
+uint8_t nda_isSparse(NDArray* x){
+    return x->sparse != NULL;
+}
+
+uint64_t nda_storedLen(NDArray* x){
+    return (x->sparse != NULL) ? x->sparse->nnz : x->shape->raw_len;
+}
+
+NDArray* nda_sparseFromCOO(uint64_t rows, uint64_t cols, uint64_t nnz, const uint64_t* row_idx, const uint64_t* col_idx, const tb_float* values){
+    uint64_t i = 0;
+    uint64_t* row_ptr = calloc(rows + 1, sizeof(uint64_t));
+    
+    for(; i < nnz; i++){
+        ASSERT(row_idx[i] < rows && col_idx[i] < cols, "Coordinate (%lld, %lld) is out of a (%lld, %lld) matrix", row_idx[i], col_idx[i], rows, cols);
+        row_ptr[row_idx[i] + 1]++;
+    }
+    
+    for(i = 0; i < rows; i++){
+        row_ptr[i + 1] += row_ptr[i];
+    }
+    
+    // counting sort by row, then insertion sort of each (short) row by column
+    uint64_t* cursor = calloc(rows, sizeof(uint64_t));
+    uint64_t* cols_sorted = calloc(nnz ? nnz : 1, sizeof(uint64_t));
+    tb_float* values_sorted = calloc(nnz ? nnz : 1, sizeof(tb_float));
+    
+    for(i = 0; i < nnz; i++){
+        uint64_t p = row_ptr[row_idx[i]] + cursor[row_idx[i]]++;
+        cols_sorted[p] = col_idx[i];
+        values_sorted[p] = values[i];
+    }
+    
+    uint64_t r = 0;
+    for(; r < rows; r++){
+        uint64_t p = row_ptr[r] + 1;
+        for(; p < row_ptr[r + 1]; p++){
+            uint64_t c = cols_sorted[p];
+            tb_float v = values_sorted[p];
+            uint64_t q = p;
+            for(; q > row_ptr[r] && cols_sorted[q - 1] > c; q--){
+                cols_sorted[q] = cols_sorted[q - 1];
+                values_sorted[q] = values_sorted[q - 1];
+            }
+            cols_sorted[q] = c;
+            values_sorted[q] = v;
+        }
+    }
+    
+    // duplicates are now adjacent
+    uint64_t unique = 0;
+    for(r = 0; r < rows; r++){
+        uint64_t p = row_ptr[r];
+        for(; p < row_ptr[r + 1]; p++){
+            unique += (p == row_ptr[r]) || (cols_sorted[p] != cols_sorted[p - 1]);
+        }
+    }
+    
+    NDArray* x = nda_allocSparse(rows, cols, unique);
+    NDSparse* sparse = x->sparse;
+    uint64_t n = 0;
+    
+    for(r = 0; r < rows; r++){
+        uint64_t p = row_ptr[r];
+        for(; p < row_ptr[r + 1]; p++){
+            if((p == row_ptr[r]) || (cols_sorted[p] != cols_sorted[p - 1])){
+                sparse->col_idx[n] = cols_sorted[p];
+                x->data[n++] = values_sorted[p];
+            }
+            else {
+                x->data[n - 1] += values_sorted[p];
+            }
+        }
+        sparse->row_ptr[r + 1] = n;
+    }
+    
+    free(values_sorted);
+    free(cols_sorted);
+    free(cursor);
+    free(row_ptr);
+    
+    return x;
+}
+
+NDArray* nda_sparseFromDense(NDArray* x){
+    ASSERT(x->sparse == NULL && x->shape->rank == 2, "Sparse matrices are built from dense rank 2 arrays");
+    
+    NDShape* shape = x->shape;
+    uint64_t rows = shape->dims[0], cols = shape->dims[1];
+    uint64_t r, c, nnz = 0;
+    
+    for(r = 0; r < rows; r++){
+        for(c = 0; c < cols; c++){
+            nnz += nda_rawGet(x, r*shape->strides[0] + c*shape->strides[1]) != 0;
+        }
+    }
+    
+    NDArray* res = nda_allocSparse(rows, cols, nnz);
+    NDSparse* sparse = res->sparse;
+    uint64_t n = 0;
+    
+    for(r = 0; r < rows; r++){
+        for(c = 0; c < cols; c++){
+            tb_float v = nda_rawGet(x, r*shape->strides[0] + c*shape->strides[1]);
+            if(v != 0){
+                sparse->col_idx[n] = c;
+                res->data[n++] = v;
+            }
+        }
+        sparse->row_ptr[r + 1] = n;
+    }
+    
+    return res;
+}
+
+NDArray* nda_sparseToDense(NDArray* x){
+    ASSERT(x->sparse != NULL, "Cannot densify a dense array");
+    
+    NDSparse* sparse = x->sparse;
+    uint64_t cols = x->shape->dims[1];
+    NDArray* res = nda_alloc(nda_newShape(2, sparse->rows, cols));
+    uint64_t r = 0;
+    
+    if(sparse->row_ids != NULL){
+        for(; r < sparse->stored_rows; r++){
+            memcpy(res->data + sparse->row_ids[r]*cols, x->data + r*cols, cols*sizeof(tb_float));
+        }
+        
+        return res;
+    }
+    
+    for(; r < sparse->rows; r++){
+        uint64_t p = sparse->row_ptr[r];
+        for(; p < sparse->row_ptr[r + 1]; p++){
+            res->data[r*cols + sparse->col_idx[p]] = x->data[p];
+        }
+    }
+    
+    return res;
+}
+
+NDArray* nda_sparseTranspose(NDArray* x){
+    ASSERT(x->sparse != NULL, "Cannot transpose a dense array as a sparse matrix");
+    
+    NDSparse* sparse = nda_sparseCSRIndex(x);
+    uint64_t rows = sparse->rows, cols = x->shape->dims[1];
+    NDArray* res = nda_allocSparse(cols, rows, sparse->nnz);
+    NDSparse* t = res->sparse;
+    uint64_t r, p;
+    
+    for(p = 0; p < sparse->nnz; p++){
+        t->row_ptr[sparse->col_idx[p] + 1]++;
+    }
+    
+    for(r = 0; r < cols; r++){
+        t->row_ptr[r + 1] += t->row_ptr[r];
+    }
+    
+    // rows are visited in order, so the columns of the transposed rows come out sorted
+    uint64_t* cursor = calloc(cols ? cols : 1, sizeof(uint64_t));
+    
+    for(r = 0; r < rows; r++){
+        for(p = sparse->row_ptr[r]; p < sparse->row_ptr[r + 1]; p++){
+            uint64_t c = sparse->col_idx[p];
+            uint64_t q = t->row_ptr[c] + cursor[c]++;
+            t->col_idx[q] = r;
+            res->data[q] = x->data[p];
+        }
+    }
+    
+    free(cursor);
+    
+    if(sparse != x->sparse){
+        nda_freeSparseIndex(sparse);
+    }
+    
+    return res;
+}
+
+NDArray* nda_sparseZerosLike(NDArray* x){
+    ASSERT(x->sparse != NULL, "Expected a sparse matrix");
+    
+    if(x->sparse->row_ids != NULL){
+        NDArray* res = nda_allocSparseRows(x->sparse->rows, x->shape->dims[1], x->sparse->stored_rows);
+        memcpy(res->sparse->row_ids, x->sparse->row_ids, x->sparse->stored_rows*sizeof(uint64_t));
+        
+        return res;
+    }
+    
+    NDArray* res = nda_allocSparse(x->sparse->rows, x->shape->dims[1], x->sparse->nnz);
+    memcpy(res->sparse->row_ptr, x->sparse->row_ptr, (x->sparse->rows + 1)*sizeof(uint64_t));
+    memcpy(res->sparse->col_idx, x->sparse->col_idx, x->sparse->nnz*sizeof(uint64_t));
+    
+    return res;
+}
+
+typedef struct _NDRowRef{
+    uint64_t row;                  /**< Destination row */
+    uint64_t pos;                  /**< Index of the source row */
+}_NDRowRef;
+
+static int _nda_compareRowRefs(const void* a, const void* b){
+    const _NDRowRef* x = (const _NDRowRef*)a;
+    const _NDRowRef* y = (const _NDRowRef*)b;
+    
+    if(x->row != y->row){
+        return (x->row < y->row) ? -1 : 1;
+    }
+    
+    return (x->pos < y->pos) ? -1 : (x->pos > y->pos);
+}
+
+/*
+ * Scatter-add into a CSR matrix, every row is visited
+ */
+static NDArray* _nda_csrAddRows(NDArray* x, uint64_t n, _NDRowRef* refs, NDArray* values){
+    NDSparse* sparse = x->sparse;
+    uint64_t cols = x->shape->dims[1];
+    uint64_t i, r, p, c;
+    
+    uint64_t nnz = sparse->nnz;
+    for(i = 0; i < n; i++){
+        if((i == 0) || (refs[i].row != refs[i - 1].row)){
+            nnz += cols - (sparse->row_ptr[refs[i].row + 1] - sparse->row_ptr[refs[i].row]);
+        }
+    }
+    
+    NDArray* res = nda_allocSparse(sparse->rows, cols, nnz);
+    NDSparse* out = res->sparse;
+    uint64_t k = 0, q = 0;
+    
+    // touched rows are stored whole, the others keep their pattern
+    for(r = 0; r < sparse->rows; r++){
+        if((k < n) && (refs[k].row == r)){
+            tb_float* dst = res->data + q;
+            
+            for(c = 0; c < cols; c++){
+                out->col_idx[q + c] = c;
+            }
+            
+            for(p = sparse->row_ptr[r]; p < sparse->row_ptr[r + 1]; p++){
+                dst[sparse->col_idx[p]] += x->data[p];
+            }
+            
+            for(; (k < n) && (refs[k].row == r); k++){
+                tb_float* src = values->data + refs[k].pos*cols;
+                for(c = 0; c < cols; c++){
+                    dst[c] += src[c];
+                }
+            }
+            
+            q += cols;
+        }
+        else {
+            uint64_t len = sparse->row_ptr[r + 1] - sparse->row_ptr[r];
+            memcpy(out->col_idx + q, sparse->col_idx + sparse->row_ptr[r], len*sizeof(uint64_t));
+            memcpy(res->data + q, x->data + sparse->row_ptr[r], len*sizeof(tb_float));
+            q += len;
+        }
+        
+        out->row_ptr[r + 1] = q;
+    }
+    
+    return res;
+}
+
+/*
+ * Scatter-add into a row list, the stored rows and the sorted added rows are merged
+ */
+static NDArray* _nda_rowListAddRows(NDArray* x, uint64_t n, _NDRowRef* refs, NDArray* values){
+    NDSparse* sparse = x->sparse;
+    uint64_t cols = x->shape->dims[1];
+    uint64_t i = 0, k = 0, len = sparse->stored_rows, c;
+    
+    for(; k < n; k++){
+        if((k > 0) && (refs[k].row == refs[k - 1].row))
+            continue;
+        
+        for(; (i < sparse->stored_rows) && (sparse->row_ids[i] < refs[k].row); i++);
+        
+        len += (i == sparse->stored_rows) || (sparse->row_ids[i] != refs[k].row);
+    }
+    
+    NDArray* res = nda_allocSparseRows(sparse->rows, cols, len);
+    uint64_t* ids = res->sparse->row_ids;
+    uint64_t q = 0;
+    
+    for(i = 0, k = 0; (i < sparse->stored_rows) || (k < n); q++){
+        uint64_t r = ((k == n) || ((i < sparse->stored_rows) && (sparse->row_ids[i] < refs[k].row))) ? sparse->row_ids[i] : refs[k].row;
+        tb_float* dst = res->data + q*cols;
+        ids[q] = r;
+        
+        if((i < sparse->stored_rows) && (sparse->row_ids[i] == r)){
+            memcpy(dst, x->data + i*cols, cols*sizeof(tb_float));
+            i++;
+        }
+        
+        for(; (k < n) && (refs[k].row == r); k++){
+            tb_float* src = values->data + refs[k].pos*cols;
+            for(c = 0; c < cols; c++){
+                dst[c] += src[c];
+            }
+        }
+    }
+    
+    return res;
+}
+
+NDArray* nda_sparseAddRows(NDArray* x, uint64_t n, const uint64_t* rows, NDArray* values){
+    ASSERT(x->sparse != NULL, "Expected a sparse matrix");
+    
+    NDSparse* sparse = x->sparse;
+    uint64_t cols = x->shape->dims[1];
+    uint64_t i;
+    
+    ASSERT(values->dtype == NDA_DTYPE_FLOAT && nda_isContiguous(values->shape) && values->shape->raw_len == n*cols, "Expected %lld contiguous rows of %lld values", n, cols);
+    
+    // the source rows are sorted by destination, rows added several times are adjacent
+    _NDRowRef* refs = calloc(n ? n : 1, sizeof(_NDRowRef));
+    for(i = 0; i < n; i++){
+        ASSERT(rows[i] < sparse->rows, "Row %lld is out of a matrix of %lld rows", rows[i], sparse->rows);
+        refs[i].row = rows[i];
+        refs[i].pos = i;
+    }
+    
+    qsort(refs, n, sizeof(_NDRowRef), _nda_compareRowRefs);
+    
+    NDArray* res = (sparse->row_ids != NULL) ? _nda_rowListAddRows(x, n, refs, values) : _nda_csrAddRows(x, n, refs, values);
+    
+    free(refs);
+    
+    return res;
+}
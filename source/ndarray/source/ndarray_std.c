@@ -54,6 +54,7 @@
 
 #include "ndarray.h"
 #include "ndarray_std.h"
+#include "ndarray_mem.h"
 
 #define ranf()   ((rand())/(double)RAND_MAX)
 
@@ -233,11 +234,12 @@ tb_float nda_get(NDArray* array, uint64_t* index){
         data_index += index[i]*shape->strides[i];
     }
     
-    return array->data[data_index];
+    return nda_rawGet(array, data_index);
 }
 
 
 NDArray* nda_slice(struct NDArray* array, uint64_t* index){
+    ASSERT(array->sparse == NULL, "Cannot slice a sparse matrix");
     NDShape* shape = array->shape;
     uint64_t rank = shape->rank;
     
@@ -275,7 +277,9 @@ NDArray* nda_slice(struct NDArray* array, uint64_t* index){
     
     NDArray* arr = calloc(1, sizeof(NDArray));
     arr->shape = new_shape;
-    arr->data = (tb_float*)(array->data+padding);
+    arr->raw = (uint8_t*)array->raw + padding*nda_dtypeSize(array->dtype);
+    arr->dtype = array->dtype;
+    arr->quant = nda_copyQuantParams(array->quant);
     
     return arr;
 }
@@ -298,7 +302,7 @@ tb_float nda_vget(NDArray* array, uint64_t* index, NDShape* vshape){
     
     //nda_debugShape(shape);
     
-    return array->data[data_index];
+    return nda_rawGet(array, data_index);
 }
 
 
@@ -306,7 +310,7 @@ tb_float nda_vget(NDArray* array, uint64_t* index, NDShape* vshape){
 tb_float nda_get1D(NDArray* array, uint64_t index){
     ASSERT(index < array->shape->raw_len, "Cannot fetch index %lld >= total size %lld of the array", index, array->shape->raw_len);
     
-    return array->data[index];
+    return nda_rawGet(array, index);
 }
 
 tb_float nda_vget1D(NDArray* array, uint64_t index){
@@ -314,7 +318,7 @@ tb_float nda_vget1D(NDArray* array, uint64_t index){
         index = index/array->shape->raw_len;
     
     printf("fetching %lld\n", index);
-    return array->data[index];
+    return nda_rawGet(array, index);
 }
 
 void nda_debugValue(NDArray* tensor){
@@ -352,6 +356,20 @@ uint64_t nda_getTotalSize(NDShape* shape){
     return size;
 }
 
+uint8_t nda_isContiguous(NDShape* shape){
+    uint64_t expected = 1;
+    uint64_t i = shape->rank;
+    
+    for(; i > 0; i--){
+        if(shape->dims[i-1] != 1 && shape->strides[i-1] != expected){
+            return 0;
+        }
+        expected *= shape->dims[i-1];
+    }
+    
+    return 1;
+}
+
 NDShape* nda_copyShape(NDShape* shape){
     NDShape* shape2 = calloc(1, sizeof(NDShape));
     shape2->rank = shape->rank;
@@ -397,12 +415,13 @@ uint8_t nda_shapeCanBroadCast(NDShape* shape1, NDShape* shape2){
 
 NDArray* nda_alloc(NDShape* shape){
     uint64_t len = nda_getTotalSize(shape);
-    tb_float* raw = calloc(len, sizeof(tb_float));
+    tb_float* raw = nda_memCalloc(len, sizeof(tb_float));
 
     NDArray* x = calloc(1, sizeof(NDArray));
 
     x->shape = shape;
     x->data = raw;
+    x->dtype = NDA_DTYPE_FLOAT;
 
     return x;
 }
@@ -410,7 +429,7 @@ NDArray* nda_alloc(NDShape* shape){
 
 NDArray* nda_randomNormal(struct NDShape* shape, float mu, float sig){
     uint64_t len = nda_getTotalSize(shape);
-    tb_float* raw = calloc(len, sizeof(tb_float));
+    tb_float* raw = nda_memCalloc(len, sizeof(tb_float));
     
     NDArray* x = calloc(1, sizeof(NDArray));
     
@@ -424,6 +443,7 @@ NDArray* nda_randomNormal(struct NDShape* shape, float mu, float sig){
     
     x->shape = shape;
     x->data = raw;
+    x->dtype = NDA_DTYPE_FLOAT;
     
     return x;
 }
@@ -450,12 +470,24 @@ NDArray* nda_linspace(tb_float a, tb_float b, uint64_t n){
 }
 
 NDArray* nda_copy(NDArray* x){
+    if(x->sparse != NULL){
+        NDArray* x_cpy = calloc(1, sizeof(NDArray));
+        x_cpy->shape = nda_copyShape(x->shape);
+        x_cpy->data = nda_memCalloc(x->sparse->nnz ? x->sparse->nnz : 1, sizeof(tb_float));
+        x_cpy->dtype = NDA_DTYPE_FLOAT;
+        x_cpy->sparse = nda_copySparseIndex(x->sparse);
+        memcpy(x_cpy->data, x->data, x->sparse->nnz*sizeof(tb_float));
+        
+        return x_cpy;
+    }
+    
     NDShape* shape = nda_copyShape(x->shape);
 
     uint64_t len = nda_getTotalSize(x->shape);
 
-    NDArray* x_cpy = nda_alloc(shape);
-    memcpy(x_cpy->data, x->data, len*sizeof(tb_float));
+    NDArray* x_cpy = nda_allocType(shape, x->dtype);
+    memcpy(x_cpy->raw, x->raw, len*nda_dtypeSize(x->dtype));
+    x_cpy->quant = nda_copyQuantParams(x->quant);
 
     return x_cpy;
 }
@@ -466,7 +498,7 @@ NDArray* nda_ones(NDShape* shape){
 
 struct NDArray* nda_fill(struct NDShape* shape, tb_float value){
     uint64_t len = nda_getTotalSize(shape);
-    tb_float* raw = calloc(len, sizeof(tb_float));
+    tb_float* raw = nda_memCalloc(len, sizeof(tb_float));
     
     NDArray* x = calloc(1, sizeof(NDArray));
     
@@ -477,6 +509,7 @@ struct NDArray* nda_fill(struct NDShape* shape, tb_float value){
     
     x->shape = shape;
     x->data = raw;
+    x->dtype = NDA_DTYPE_FLOAT;
     
     return x;
 }
@@ -489,13 +522,16 @@ void nda_reshape(NDArray* x, NDShape* shape){
     assert(old_len == new_len);
 
     free(old_shape->dims);
+    free(old_shape->strides);
     free(old_shape);
 
     x->shape = shape;
 }
 
 void nda_free(NDArray* array){
-    free(array->data);
+    nda_memFree(array->data);
+    nda_freeQuantParams(array->quant);
+    nda_freeSparseIndex(array->sparse);
     free(array->shape->dims);
     free(array->shape->strides);
     free(array->shape);
@@ -0,0 +1,125 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file tb_batcher.h
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing a dynamic micro-batching front-end for serving single examples through a graph.
+ *
+ * Concurrent requests are queued, coalesced along a new leading batch axis up to a maximum batch size or
+ * until the oldest request waited for the maximum delay, computed by a single batched run and scattered back.
+ * Batches are padded to a power of two (or the maximum batch size), so that a few prepared runs serve any load.
+ */
+
+#ifndef _TB_BATCHER_H_
+#define _TB_BATCHER_H_
+
+#include <stdint.h>
+
+#include <ndarray.h>
+#include <tb_graph.h>
+#include <tb_errors.h>
+#include <tb_session.h>
+
+/**
+ * \brief Structure of a batcher
+ */
+typedef struct TBBatcher TBBatcher;
+
+/**
+ * \brief Measures of a synthetic load run
+ */
+typedef struct TBBatcherStats {
+    uint64_t requests;             /**< Number of served requests */
+    uint64_t batches;              /**< Number of batched runs */
+    double seconds;                /**< Wall-clock duration of the load */
+    double throughput;             /**< Requests per second */
+    double p50_us;                 /**< Median request latency in microseconds */
+    double p99_us;                 /**< 99th percentile request latency in microseconds */
+    double max_us;                 /**< Maximum request latency in microseconds */
+}TBBatcherStats;
+
+/**
+ * \brief Creates a batcher and starts its worker thread. The graph must take its examples through the given slot
+ * with a leading batch axis, and produce one contiguous output row per example along its first axis. The examples
+ * of a batch must be computed independently of each other, padding examples are zeros.
+ * \param[in] session Session to run the graph
+ * \param[in] graph Graph to serve, it must not be run elsewhere while the batcher is alive
+ * \param[in] slot Variable slot receiving the batch, see `tb_graphGetVarSlot`
+ * \param[in] example Shape of a single example, copied
+ * \param[in] max_batch Maximum number of examples per run
+ * \param[in] max_delay_us Maximum time in microseconds the oldest queued request waits for a batch to fill up
+ * \return new batcher, must be freed using `tb_freeBatcher`
+ */
+struct TBBatcher* tb_newBatcher(struct TBGraphSession* session, TBGraph* graph, uint64_t slot, struct NDShape* example, uint64_t max_batch, uint64_t max_delay_us);
+
+/**
+ * \brief Computes a single example, blocks until its batch has been run. Thread-safe.
+ * \param[in/out] batcher Batcher
+ * \param[in] input Dense example of the shape given to `tb_newBatcher`, converted to tb_float when stored in another
+ * dtype or strided
+ * \param[out] output Contiguous destination of the output row of the example, in the dtype of the graph output
+ * \return NULL on success, the error of the batched run otherwise (owned by the batcher)
+ */
+TBError* tb_batcherRun(struct TBBatcher* batcher, struct NDArray* input, struct NDArray* output);
+
+/**
+ * \brief Number of elements of the output row of a single example, computes an example to find it out
+ * \param[in/out] batcher Batcher
+ * \return number of elements, 0 if the graph fails to run
+ */
+uint64_t tb_batcherOutputLen(struct TBBatcher* batcher);
+
+/**
+ * \brief Synthetic closed-loop load: each client thread sends its requests one after another
+ * \param[in/out] batcher Batcher
+ * \param[in] clients Number of concurrent client threads
+ * \param[in] requests Number of requests sent by each client
+ * \param[in] example Input of every request
+ * \return load measures
+ */
+TBBatcherStats tb_batcherLoadTest(struct TBBatcher* batcher, uint64_t clients, uint64_t requests, struct NDArray* example);
+
+/**
+ * \brief Stops the worker thread once the queued requests are served and deallocates/frees the batcher.
+ * \param[in/out] batcher Batcher to free
+ */
+void tb_freeBatcher(struct TBBatcher* batcher);
+
+#endif
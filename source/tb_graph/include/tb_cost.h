@@ -0,0 +1,157 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file tb_cost.h
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing the static cost model of graphs.
+ *
+ * The cost of a graph is estimated from its input shapes without running it: each node gets its output shape,
+ * FLOPs, bytes read and written and a roofline time, bounded by either the compute peak or the memory bandwidth
+ * of the machine. The roofline is calibrated from the JSON written by `tb_bench --json`.
+ */
+
+#ifndef _TB_COST_H_
+#define _TB_COST_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <ndarray.h>
+#include <tb_graph.h>
+#include <tb_errors.h>
+
+/**
+ * \brief Performance bounds of the machine running the graphs
+ */
+typedef struct TBRoofline {
+    double gflops;                 /**< Peak compute throughput, in GFLOP/s */
+    double gbps;                   /**< Memory bandwidth, in GB/s */
+    double overhead;               /**< Fixed cost of an operation node, in nanoseconds */
+}TBRoofline;
+
+/**
+ * \brief Estimated cost of a node
+ */
+typedef struct TBNodeCost {
+    TBNode* node;                  /**< Node, the root of a nested graph stands for its graph node */
+    TBGraph* graph;                /**< Graph holding the node, nested graphs have their own */
+    const char* op;                /**< Operation name, see `tb_nodeOpName` */
+    struct NDShape* shape;         /**< Output shape */
+    NDDType dtype;                 /**< Output dtype */
+    uint64_t lhs;                  /**< Index of the first operand, TB_NO_SLOT if none */
+    uint64_t rhs;                  /**< Index of the second operand, TB_NO_SLOT if none */
+    uint64_t aux;                  /**< Index of the third operand, TB_NO_SLOT if none */
+    uint64_t flops;                /**< Floating point operations, multiply-adds count as two */
+    uint64_t bytes_read;           /**< Bytes of the operands */
+    uint64_t bytes_written;        /**< Bytes of the output, 0 for inputs and constants */
+    double intensity;              /**< FLOPs per byte moved */
+    double ns;                     /**< Roofline time in nanoseconds, 0 for inputs and constants */
+    uint8_t memory_bound;          /**< Boolean flag, true when the time is bounded by the memory bandwidth */
+}TBNodeCost;
+
+/**
+ * \brief Estimated cost of a graph
+ */
+typedef struct TBGraphCost {
+    TBGraph* graph;                /**< Estimated graph */
+    TBRoofline roofline;           /**< Roofline of the estimate */
+    TBNodeCost* nodes;             /**< Nodes in execution order, operands come first and shared nodes are counted once */
+    uint64_t nodes_len;            /**< Number of nodes */
+    uint64_t nodes_cap;            /**< Capacity of the nodes array */
+    uint64_t root;                 /**< Index of the graph output, TB_NO_SLOT on error */
+    uint64_t flops;                /**< Total FLOPs */
+    uint64_t bytes_read;           /**< Total bytes read */
+    uint64_t bytes_written;        /**< Total bytes written */
+    double ns;                     /**< Total roofline time in nanoseconds, nodes running one after the other */
+    TBError* error;                /**< Shape error preventing the estimate, NULL on success */
+}TBGraphCost;
+
+/**
+ * \brief Returns a conservative roofline of a single core, for estimates without calibration
+ * \return roofline
+ */
+TBRoofline tb_defaultRoofline(void);
+
+/**
+ * \brief Calibrates a roofline from the results of `tb_bench --json`: the fastest benchmark gives the node overhead,
+ * then the benchmarks lasting several times longer give the compute peak and the bandwidth once the overhead is removed
+ * \param[in] path JSON written by `tb_bench`
+ * \param[out] roofline Calibrated roofline, left untouched on failure
+ * \return true on success, false if the file cannot be read or holds no benchmark
+ */
+uint8_t tb_calibrateRoofline(const char* path, TBRoofline* roofline);
+
+/**
+ * \brief Estimates the cost of a graph for given input shapes, inferred by `tb_inferShapes`. Inputs are tb_float
+ * tensors, variables without input shape are resolved through the nodes bound to them, like in `tb_runSession`.
+ * Symbolic dimensions must be resolved first, see `tb_concreteShape`.
+ * \param[in/out] graph Graph, compiled if needed
+ * \param[in] inputs Shape of each variable slot (see `tb_graphGetVarSlot`), NULL entries (or a NULL array)
+ * for bound variables
+ * \param[in] roofline Roofline of the estimate, NULL for `tb_defaultRoofline`
+ * \return new estimate, must be freed using `tb_freeGraphCost`. On error the nodes estimated so far are kept.
+ */
+TBGraphCost* tb_estimateGraphCost(TBGraph* graph, struct NDShape** inputs, TBRoofline* roofline);
+
+/**
+ * \brief Writes the estimate of each operation node, then the totals
+ * \param[in] cost Estimate
+ * \param[in/out] out Output stream
+ */
+void tb_writeGraphCost(TBGraphCost* cost, FILE* out);
+
+/**
+ * \brief Frees an estimate, its shapes and error
+ * \param[in/out] cost Estimate
+ */
+void tb_freeGraphCost(TBGraphCost* cost);
+
+/**
+ * \brief Floating point operations of a node from the shapes of its output and operands, multiply-adds count as two
+ * \param[in] node Node
+ * \param[in] out Output shape
+ * \param[in] lhs Shape of the first operand, NULL if none
+ * \param[in] rhs Shape of the second operand (e.g the weights of a convolution), NULL if none. A quantization
+ * given a second operand is a requantized DOT product of both operands.
+ * \return FLOPs
+ */
+uint64_t tb_nodeFlops(TBNode* node, struct NDShape* out, struct NDShape* lhs, struct NDShape* rhs);
+
+#endif
@@ -64,6 +64,13 @@ TBNode* tb_newVarNode(char* name);
  */
 TBNode* tb_newConstantNode(struct NDArray* array);
 
+/**
+ * \brief Creates a new constant node on a value owned elsewhere, the value is left untouched when the node is freed
+ * \param[in] array ND Array, must outlive the node
+ * \return new constant node
+ */
+TBNode* tb_newBorrowedConstantNode(struct NDArray* array);
+
 /**
  * \brief Copies an existing constant node
  * \param[in] node Node to copy (by value, ie deep copy)
@@ -121,6 +128,95 @@ TBNode* tb_newAxisBoundOpNode(TBAxisBoundOperationType type, TBNode* uhs, uint64
  */
 TBNode* tb_newTransposeOpNode(TBNode* uhs, uint64_t axis1, uint64_t axis2);
 
+/**
+ * \brief Creates an operation node which quantizes its operand per tensor
+ * \param[in] uhs Unary hand side node
+ * \param[in] dtype NDA_DTYPE_U8 or NDA_DTYPE_I8
+ * \param[in] scale Quantization scale, see `nda_chooseQuantParams`
+ * \param[in] zero_point Quantization zero point
+ * \return new Quantization node
+ */
+TBNode* tb_newQuantizeOpNode(TBNode* uhs, NDDType dtype, float scale, int32_t zero_point);
+
+/**
+ * \brief Creates an operation node which converts a quantized operand back to tb_float
+ * \param[in] uhs Unary hand side node
+ * \return new Quantization node
+ */
+TBNode* tb_newDequantizeOpNode(TBNode* uhs);
+
+/**
+ * \brief Creates an operation node which looks up rows of a table, e.g an embedding lookup
+ * \param[in] table Table node, its first axis is indexed
+ * \param[in] indices Node of the row indices
+ * \return new Gather node
+ */
+TBNode* tb_newGatherOpNode(TBNode* table, TBNode* indices);
+
+/**
+ * \brief Creates a fused softmax cross-entropy loss node, outputs the loss of each sample
+ * \param[in] logits Logits node
+ * \param[in] labels Node of the class indices, or of the target distributions
+ * \param[in] axis Axis of the classes
+ * \return new Cross-entropy node
+ */
+TBNode* tb_newCrossEntropyOpNode(TBNode* logits, TBNode* labels, uint64_t axis);
+
+/**
+ * \brief Creates a fused layer or batch normalization node
+ * \param[in] type Normalization type
+ * \param[in] uhs Node to normalize
+ * \param[in] gamma Scale node, can be NULL
+ * \param[in] beta Shift node, can be NULL
+ * \param[in] axis First normalized axis (LAYER) or channels axis (BATCH)
+ * \param[in] epsilon Added to the variance, e.g 1e-5
+ * \return new Normalization node
+ */
+TBNode* tb_newNormalizationOpNode(TBNormalizationOperationType type, TBNode* uhs, TBNode* gamma, TBNode* beta, uint64_t axis, float epsilon);
+
+/**
+ * \brief Creates a 2-D convolution node, its algorithm is picked automatically
+ * \param[in] uhs Input node, NCHW, NHWC or blocked NCHWc
+ * \param[in] weights OIHW weights node
+ * \param[in] layout Layout of the input and output
+ * \param[in] stride_h Vertical stride
+ * \param[in] stride_w Horizontal stride
+ * \param[in] pad_h Zero padding added above and below
+ * \param[in] pad_w Zero padding added left and right
+ * \param[in] dilation_h Vertical dilation, 1 for a dense kernel
+ * \param[in] dilation_w Horizontal dilation, 1 for a dense kernel
+ * \param[in] groups Number of groups, dividing the input and output channels
+ * \return new Convolution node
+ */
+TBNode* tb_newConvolutionOpNode(TBNode* uhs, TBNode* weights, TBConvolutionLayout layout, uint64_t stride_h, uint64_t stride_w,
+                                uint64_t pad_h, uint64_t pad_w, uint64_t dilation_h, uint64_t dilation_w, uint64_t groups);
+
+/**
+ * \brief Creates a 2-D pooling node
+ * \param[in] type Pooling type
+ * \param[in] uhs Input node, NCHW, NHWC or blocked NCHWc
+ * \param[in] layout Layout of the input and output
+ * \param[in] window_h Window height, ignored by global poolings
+ * \param[in] window_w Window width, ignored by global poolings
+ * \param[in] stride_h Vertical stride, ignored by global poolings
+ * \param[in] stride_w Horizontal stride, ignored by global poolings
+ * \param[in] pad_h Padding added above and below, ignored by global poolings
+ * \param[in] pad_w Padding added left and right, ignored by global poolings
+ * \return new Pooling node
+ */
+TBNode* tb_newPoolingOpNode(TBPoolingOperationType type, TBNode* uhs, TBConvolutionLayout layout, uint64_t window_h, uint64_t window_w,
+                            uint64_t stride_h, uint64_t stride_w, uint64_t pad_h, uint64_t pad_w);
+
+/**
+ * \brief Creates a node copying an image from a layout to another
+ * \param[in] uhs Input node
+ * \param[in] from Layout of the input
+ * \param[in] to Layout of the output
+ * \param[in] block Channels per block of the blocked side
+ * \return new Reorder node
+ */
+TBNode* tb_newReorderOpNode(TBNode* uhs, TBConvolutionLayout from, TBConvolutionLayout to, uint64_t block);
+
 /**
  * \brief Creates a new result node (do not create in case of error)
  * \param[in] array NDArray, value of the result
@@ -0,0 +1,195 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file tb_gemm.h
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing the in-tree cache-blocked GEMM.
+ *
+ * The GEMM packs its operands into micro-panels sized for a register-tiled micro-kernel, chosen at run time
+ * between AVX-512, AVX2+FMA and a portable one (see `nda_cpuFeatures`). It replaces CBLAS when the library is built without BLAS
+ * (`TB_NO_BLAS`), and is always available for products that need an epilogue fused with the output tiles.
+ * The quantized GEMM follows the same scheme with exact int32 accumulators.
+ */
+
+#ifndef _TB_GEMM_H_
+#define _TB_GEMM_H_
+
+#include <stdint.h>
+
+#include <ndarray.h>
+
+#include <tb_pool.h>
+
+#ifdef TB_NO_BLAS
+
+/**
+ * \brief CBLAS storage orders, for the calls written against CBLAS
+ */
+typedef enum CBLAS_ORDER {CblasRowMajor = 101, CblasColMajor = 102} CBLAS_ORDER;
+
+/**
+ * \brief CBLAS transpositions, for the calls written against CBLAS
+ */
+typedef enum CBLAS_TRANSPOSE {CblasNoTrans = 111, CblasTrans = 112, CblasConjTrans = 113} CBLAS_TRANSPOSE;
+
+#define cblas_sgemm tb_cblasGemm
+#define cblas_dgemm tb_cblasGemm
+
+#else
+#include <cblas.h>
+#endif
+
+/**
+ * \brief Element-wise activations applied by a GEMM epilogue
+ */
+typedef enum TBGemmActivation {
+    TBGA_NONE = 0,       /**< Identity */
+    TBGA_RELU,           /**< max(x, 0) */
+    TBGA_SIGMOID,        /**< 1/(1 + exp(-x)) */
+    TBGA_TANH,           /**< tanh(x) */
+}TBGemmActivation;
+
+/**
+ * \brief Operations fused with the write back of the output tiles, bias first
+ */
+typedef struct TBGemmEpilogue {
+    const tb_float* bias;          /**< N values added to every row of the output, NULL for none */
+    TBGemmActivation activation;   /**< Activation applied last */
+}TBGemmEpilogue;
+
+/**
+ * \brief Row-major C = act(alpha*op(A).op(B) + beta*C + bias). Output tiles are split across the threads of a pool,
+ * each thread packs the operands into buffers it keeps across products.
+ * \param[in/out] pool Pool running the threads, NULL for `tb_defaultThreadPool`
+ * \param[in] threads Maximum number of threads, 0 for every online CPU
+ * \param[in] transA Non-zero if A is given transposed, (K, M) instead of (M, K)
+ * \param[in] transB Non-zero if B is given transposed, (N, K) instead of (K, N)
+ * \param[in] M Rows of the output
+ * \param[in] N Columns of the output
+ * \param[in] K Length of the reduction
+ * \param[in] alpha Scale of the product
+ * \param[in] A Left operand
+ * \param[in] lda Leading dimension of A
+ * \param[in] B Right operand
+ * \param[in] ldb Leading dimension of B
+ * \param[in] beta Scale of the previous output, 0 ignores its content (NaN included)
+ * \param[in/out] C Output
+ * \param[in] ldc Leading dimension of C
+ * \param[in] epilogue Fused operations, NULL for none
+ */
+void tb_gemm(TBThreadPool* pool, uint64_t threads, uint8_t transA, uint8_t transB, uint64_t M, uint64_t N, uint64_t K,
+             tb_float alpha, const tb_float* A, uint64_t lda, const tb_float* B, uint64_t ldb,
+             tb_float beta, tb_float* C, uint64_t ldc, const TBGemmEpilogue* epilogue);
+
+/**
+ * \brief `tb_gemm` behind the signature of `cblas_sgemm` (or `cblas_dgemm` when tb_float is double), which it
+ * replaces in builds without BLAS. Column-major calls compute the transposed row-major product on every online CPU,
+ * the kernels of a session call `tb_gemm` with its threads instead.
+ */
+void tb_cblasGemm(CBLAS_ORDER order, CBLAS_TRANSPOSE transA, CBLAS_TRANSPOSE transB, int M, int N, int K,
+                  tb_float alpha, const tb_float* A, int lda, const tb_float* B, int ldb,
+                  tb_float beta, tb_float* C, int ldc);
+
+/**
+ * \brief int8 (K, N) RHS of `tb_qgemm` stored as panels of 16 columns, each one the reduction rounded up to a multiple
+ * of 4 and padded with zeros, 4 consecutive rows of a column next to each other
+ */
+typedef struct TBQGemmPacked {
+    uint64_t K;                    /**< Rows of the matrix */
+    uint64_t N;                    /**< Columns of the matrix */
+    int8_t* panels;                /**< Panels, in the order of the columns */
+    int32_t* colsum;               /**< Sum of each column, subtracts the zero point of the LHS */
+}TBQGemmPacked;
+
+/**
+ * \brief Dequantization of the int32 accumulators of `tb_qgemm`, written with its output tiles:
+ * v = acc*lhs_scale*rhs_scales[n], then v/scale + zero_point rounded and saturated for an integer output
+ */
+typedef struct TBQGemmOutput {
+    NDDType dtype;                 /**< NDA_DTYPE_FLOAT, NDA_DTYPE_U8 or NDA_DTYPE_I8 */
+    void* C;                       /**< Row-major output */
+    uint64_t ldc;                  /**< Leading dimension of C */
+    float lhs_scale;               /**< Scale of the LHS */
+    const float* rhs_scales;       /**< Scale of the RHS, one per column if `per_channel` */
+    uint8_t per_channel;           /**< Boolean flag, true for a scale per RHS column */
+    float inv_scale;               /**< Inverse of the scale of an integer output */
+    int32_t zero_point;            /**< Zero point of an integer output */
+}TBQGemmOutput;
+
+/**
+ * \brief Packs an int8 (K, N) matrix, element (k, n) read at B[k*rs + n*cs]
+ * \param[in] B Matrix to pack
+ * \param[in] rs Stride of the rows
+ * \param[in] cs Stride of the columns
+ * \param[in] K Rows of the matrix
+ * \param[in] N Columns of the matrix
+ * \return new packed matrix, must be freed using `tb_qgemmFreePacked`
+ */
+TBQGemmPacked* tb_qgemmPack(const int8_t* B, uint64_t rs, uint64_t cs, uint64_t K, uint64_t N);
+
+/**
+ * \brief Frees a packed matrix
+ * \param[in] packed Matrix to free
+ */
+void tb_qgemmFreePacked(TBQGemmPacked* packed);
+
+/**
+ * \brief Quantized product (A - za).B of a u8 (M, K) matrix by an s8 (K, N) one, accumulated exactly in int32 by
+ * register tiles (VNNI, AVX2 or portable micro-kernel chosen at run time) and dequantized by `out`. Output tiles are
+ * split across the threads of a pool, each thread packs A into a buffer it keeps across products.
+ * \param[in/out] pool Pool running the threads, NULL for `tb_defaultThreadPool`
+ * \param[in] threads Maximum number of threads, 0 for every online CPU
+ * \param[in] M Rows of the output
+ * \param[in] N Columns of the output
+ * \param[in] K Length of the reduction
+ * \param[in] A Row-major LHS
+ * \param[in] lda Leading dimension of A
+ * \param[in] za Zero point of A
+ * \param[in] B RHS, element (k, n) at B[k*rs + n*cs], ignored if `packed` is given
+ * \param[in] rs Stride of the rows of B
+ * \param[in] cs Stride of the columns of B
+ * \param[in] packed B packed by `tb_qgemmPack`, NULL to pack it in a buffer of the calling thread
+ * \param[in] out Output and its dequantization
+ */
+void tb_qgemm(TBThreadPool* pool, uint64_t threads, uint64_t M, uint64_t N, uint64_t K,
+              const uint8_t* A, uint64_t lda, int32_t za, const int8_t* B, uint64_t rs, uint64_t cs,
+              const TBQGemmPacked* packed, const TBQGemmOutput* out);
+
+#endif
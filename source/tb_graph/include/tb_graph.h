@@ -88,6 +88,16 @@
  */
 typedef vec_t(void*) TBNode_Vec;
 
+/**
+ * \brief Slot index of variables which are not (yet) resolved by `tb_compileGraph`
+ */
+#define TB_NO_SLOT UINT64_MAX
+
+/**
+ * \brief Index of nodes which are not (yet) collected by `tb_compileGraph`
+ */
+#define TB_NO_ID UINT64_MAX
+
 /**
  * \brief advanced assertion strategy for debugging purposes
  * define TB_ASSERT_STANDARD to use standard C assert
@@ -116,9 +126,16 @@ typedef enum TBNodeType{
 	TBNT_UNARY_OPERATION,          /**< Unary operation. */
 	TBNT_AXIS_BOUND_OPERATION,     /**< Axis-bounded operations i.e operations that are applied over a specific axis or dimension. */
     TBNT_AXES_TRANSPOSE,           /**< Transpose two axes of an NDArray */
+    TBNT_QUANTIZATION,             /**< Quantizes or dequantizes an NDArray */
+    TBNT_GATHER,                   /**< Looks up rows of a table, e.g embeddings */
+    TBNT_CROSS_ENTROPY,            /**< Fused softmax cross-entropy loss */
+    TBNT_NORMALIZATION,            /**< Fused layer or batch normalization */
+    TBNT_CONVOLUTION,              /**< 2-D convolution */
+    TBNT_POOLING,                  /**< 2-D max or average pooling */
+    TBNT_REORDER,                  /**< Image layout conversion */
 }TBNodeType;
 
-#define MAX_NODE_TYPE TBNT_AXES_TRANSPOSE
+#define MAX_NODE_TYPE TBNT_REORDER
 
 /**
  * \brief Node data structure
@@ -127,8 +144,7 @@ typedef struct TBNode {
 	TBNodeType type;               /**< Node type */
     void* nodePtr;                 /**< Pointer to the actual node structure */
     uint8_t calc_grad;             /**< Boolean flag indicating that the gradient will be calculated for this node. If it is set to false, its child will also be set to false */
-    struct TBResultNode* result;   /**< Pointer to the actual result of the node, in order to improve performance . */
-    struct TBResultNode* diff;     /**< Pointer to the derivative of this node w.r.t to the root node in the graph. */
+    uint64_t id;                   /**< Index of the node in the graph which compiled it, results and derivatives are stored per run under this index */
 }TBNode;
 
 /**
@@ -137,6 +153,7 @@ typedef struct TBNode {
 typedef struct TBResultNode {
 	struct NDArray* value;         /**< Tensor value */
 	TBError* error;                /**< Error pointer in case of exception during the execution */
+	uint8_t borrowed;              /**< Boolean flag, true when `value` is the value of a constant node and is not freed with the result */
 }TBResultNode;
 
 /**
@@ -147,6 +164,16 @@ typedef struct TBGraph {
 	TBNode* root;                  /**< Graph Root Node */
 	map_t(TBNode*) vars;           /**< variables, a map from char* => TBNode* */
 	TBNode_Vec nodes;              /**< Lookup table to free nodes later on */
+	
+	uint8_t compiled;              /**< Boolean flag indicating that variable slots have been resolved */
+	map_t(uint64_t) slot_ids;      /**< Slot index of each variable name, used only when binding by name */
+	TBNode_Vec slots;              /**< Node bound to each slot, NULL if the slot is not bound */
+	TBNode_Vec feeds;              /**< Lazily created constant nodes used by `tb_graphFeedSlot`, one per slot */
+	
+	struct NDArchive* archive;     /**< Mapped file holding the constant tensors of a graph loaded by `tb_loadGraph`, NULL otherwise */
+	uint8_t owns_names;            /**< Boolean flag, true when the graph name, variable names and nested graph parameters were allocated along with the graph */
+	struct TBGraph* base;          /**< Graph this one was derived from, whose nodes it reuses (e.g nested graphs), NULL if none */
+	struct TBGraphShapes* shapes;  /**< Shapes cached by `tb_inferGraphShapes`, NULL if never inferred */
 }TBGraph;
 
 
@@ -175,7 +202,10 @@ typedef struct TBGraphNodeParam {
 TBGraph* tb_newGraph(char* name, TBNode* rootNode);
 
 /**
- * \brief Frees a graph
+ * \brief Frees a graph along with its nodes, nested graphs, constant values it owns and the state of the runs without
+ * session. Nodes bound to variables from outside the graph, borrowed constant values and nodes of its base graph are left
+ * untouched. Sessions which ran the graph must be freed first, and graphs derived from it (`tb_quantizeGraph`,
+ * `tb_blockGraphLayouts`) before it.
  * \param[in/out] graph Graph to deallocate
  */
 void tb_freeGraph(TBGraph* graph);
@@ -209,6 +239,73 @@ void tb_graphSetVar(TBGraph* graph, TBNode* node, const char* name);
  */
 TBNode* tb_graphGetVar(TBGraph* graph, const char* name);
 
+/**
+ * \brief Compiles a graph, i.e collects and numbers its nodes and resolves every variable name into an integer
+ * slot. Variables already bound by name are moved into their slots, nested graphs are compiled as well.
+ * This function is automatically called the first time the graph is run, calling it again has no effect.
+ * Concurrent calls compile the graph once. A compiled graph is never modified by runs, sessions running it
+ * concurrently only need their own session.
+ * \param[in/out] graph Graph to compile
+ */
+void tb_compileGraph(TBGraph* graph);
+
+/**
+ * \brief Returns the slot of a variable, should be called once at setup since it hashes the name.
+ * Compiles the graph if needed.
+ * \param[in/out] graph Base graph
+ * \param[in] name Variable name
+ * \return Slot index, TB_NO_SLOT if the variable is not used within the graph
+ */
+uint64_t tb_graphGetVarSlot(TBGraph* graph, const char* name);
+
+/**
+ * \brief Binds a node with a variable slot, O(1).
+ * \param[in/out] graph Compiled graph to update
+ * \param[in] slot Slot index returned by `tb_graphGetVarSlot`
+ * \param[in] node Node to bind
+ */
+void tb_graphSetVarSlot(TBGraph* graph, uint64_t slot, TBNode* node);
+
+/**
+ * \brief Checks whether a node has been collected by the compilation of the graph, O(1)
+ * \param[in] graph Compiled graph
+ * \param[in] node Node to check
+ * \return true if `node->id` indexes the node within the graph
+ */
+uint8_t tb_graphOwnsNode(TBGraph* graph, TBNode* node);
+
+/**
+ * \brief Returns the slot of a variable node within the graph, O(1) for variables owned by the graph.
+ * \param[in/out] graph Base graph
+ * \param[in] node Variable node
+ * \return Slot index, TB_NO_SLOT if the variable is not used within the graph
+ */
+uint64_t tb_graphVarNodeSlot(TBGraph* graph, TBNode* node);
+
+/**
+ * \brief Binds a tensor with a variable slot, O(1). The tensor is not copied, nor freed with the graph,
+ * it must remain valid while the graph is being run and differentiated. The constant node wrapping the tensor is allocated
+ * the first time the slot is fed and reused afterwards.
+ * \param[in/out] graph Compiled graph to update
+ * \param[in] slot Slot index returned by `tb_graphGetVarSlot`
+ * \param[in] value Tensor to feed
+ */
+void tb_graphFeedSlot(TBGraph* graph, uint64_t slot, struct NDArray* value);
+
+/**
+ * \brief Signals that the value of a constant node has been modified in place, values derived from the constant
+ * (e.g packed DOT product weights cached by sessions) are rebuilt on their next use.
+ * \param[in/out] node Constant node
+ */
+void tb_constantChanged(TBNode* node);
+
+/**
+ * \brief Returns the name of the operation computed by a node, e.g DOT or RELU, for logs and profiles
+ * \param[in] node Node
+ * \return static string
+ */
+const char* tb_nodeOpName(TBNode* node);
+
 /**
  * \brief Recursively travers a node and stores all nodes in the graph nodes list,
  * in order to make freeing them later on a piece of cake (or so I hope). This
@@ -0,0 +1,77 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file tb_layout.h
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing the propagation of blocked image layouts through graphs.
+ *
+ * Convolutions whose channels split in SIMD-width blocks run on NCHWc images, (N, C/c, H, W, c) arrays that keep a
+ * full vector of channels per pixel. Poolings and element-wise unary operations fed by a blocked node stay blocked,
+ * so that a chain of such nodes only pays one reorder where it enters and one where a plain consumer reads it.
+ */
+
+#ifndef _TB_LAYOUT_H_
+#define _TB_LAYOUT_H_
+
+#include <stdint.h>
+
+#include <tb_graph.h>
+
+/**
+ * \brief Channels per block chosen when none is given, the number of floats of a vector register
+ */
+#if defined(__AVX512F__)
+#define TB_LAYOUT_BLOCK 16
+#else
+#define TB_LAYOUT_BLOCK 8
+#endif
+
+/**
+ * \brief Rewrites a graph with blocked layouts, compiles the graph if needed. Convolutions of a single group whose
+ * weights are constant and whose input and output channels are multiples of the block are blocked, reorder nodes are
+ * inserted at the boundaries of the blocked regions, each tensor being reordered at most once per layout.
+ * \param[in] graph Source graph, left untouched
+ * \param[in] block Channels per block, TB_LAYOUT_BLOCK if 0
+ * \param[in] name Name of the new graph
+ * \return new graph computing the same root, constants and bindings are shared with the source graph
+ */
+TBGraph* tb_blockGraphLayouts(TBGraph* graph, uint64_t block, char* name);
+
+#endif
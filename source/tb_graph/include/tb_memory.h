@@ -0,0 +1,131 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file tb_memory.h
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing the tensor memory accounting of CPU sessions.
+ *
+ * Once enabled on a session, the tensor buffers allocated while evaluating a node are charged to that node,
+ * and all of them to the session. When the session is freed, the buffers still allocated are reported
+ * per node, e.g results never freed by the caller. Sessions without accounting only pay a NULL check per node.
+ */
+
+#ifndef _TB_MEMORY_H_
+#define _TB_MEMORY_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include <tb_graph.h>
+#include <tb_session_cpu.h>
+
+#include <ndarray_mem.h>
+
+/**
+ * \brief Allocations charged to a node
+ */
+typedef struct TBNodeMemory {
+    NDMemTracker* tracker;         /**< Counters of the node, charged along with the session */
+    char graph[64];                /**< Name of the graph of the node, truncated */
+    uint64_t node_id;              /**< Id of the node in its graph */
+    const char* op;                /**< Operation name, see `tb_nodeOpName` */
+}TBNodeMemory;
+
+/**
+ * \brief Tensor memory accounting of a session
+ */
+typedef struct TBSessionMemory {
+    pthread_mutex_t lock;          /**< Guards the nodes */
+    NDMemTracker* tracker;         /**< Counters of the session */
+    FILE* leaks;                   /**< Stream receiving the leak report when the session is freed, NULL for none */
+    TBNodeMemory** nodes;          /**< Nodes in order of first evaluation */
+    uint64_t nodes_len;            /**< Number of nodes */
+    uint64_t nodes_cap;            /**< Capacity of the nodes array */
+}TBSessionMemory;
+
+/**
+ * \brief Enables the memory accounting of a session, counters restart from 0 when it was already enabled
+ * \param[in/out] session Session
+ * \param[in/out] leaks Stream receiving the leak report when the session is freed, NULL for none
+ */
+void tb_sessionTrackMemory(TBGraphSession* session, FILE* leaks);
+
+/**
+ * \brief Returns the counters of the tensors allocated by the runs of a session
+ * \param[in] session Session
+ * \return counters, zeroed when accounting is disabled
+ */
+NDMemCounters tb_sessionMemory(TBGraphSession* session);
+
+/**
+ * \brief Returns the counters of the tensors allocated by evaluating a node, its operands excluded
+ * \param[in] session Session
+ * \param[in] graph Graph run by the session
+ * \param[in] node Node of the graph
+ * \return counters, zeroed when accounting is disabled or the node was never evaluated
+ */
+NDMemCounters tb_sessionNodeMemory(TBGraphSession* session, TBGraph* graph, TBNode* node);
+
+/**
+ * \brief Writes the counters of the session, then of its nodes sorted by peak
+ * \param[in] session Session
+ * \param[in/out] out Output stream
+ */
+void tb_sessionWriteMemoryReport(TBGraphSession* session, FILE* out);
+
+/**
+ * \brief Returns the tracker charged with the allocations of a node, created on first use.
+ * Nodes of the single-use contexts of `tb_runSessionNodeOnly` are charged to the session only.
+ * \param[in/out] session Session with accounting enabled
+ * \param[in/out] ctx Run context of the node
+ * \param[in] node Node
+ * \return tracker
+ */
+NDMemTracker* _tb_nodeMemory(TBGraphSession* session, TBRunContext* ctx, TBNode* node);
+
+/**
+ * \brief Writes the leak report of a session and frees its accounting.
+ * Must be called once the session has freed its own tensors.
+ * \param[in/out] memory Accounting of the session
+ */
+void _tb_freeSessionMemory(TBSessionMemory* memory);
+
+#endif
@@ -96,9 +96,65 @@ typedef enum TBAxisBoundOperationType {
 	TBABOT_SOFTMAX,   /**< Numerically stable SOFTMAX */
 	TBABOT_ARGMIN,    /**< ARGMIN */
 	TBABOT_ARGMAX,    /**< ARGMAX */
+	TBABOT_LOG_SOFTMAX, /**< Numerically stable log of SOFTMAX */
 }TBAxisBoundOperationType;
 
-#define MAX_AXIS_BOUND_OPERATION TBABOT_VARIANCE
+#define MAX_AXIS_BOUND_OPERATION TBABOT_LOG_SOFTMAX
+
+/**
+ * \brief List of the quantization operation types
+ */
+typedef enum TBQuantizationOperationType {
+    TBQOT_QUANTIZE = 0,  /**< Affine per-tensor quantization to an 8 bits dtype */
+    TBQOT_DEQUANTIZE,    /**< Converts a quantized tensor back to tb_float */
+}TBQuantizationOperationType;
+
+#define MAX_QUANTIZATION_OPERATION TBQOT_DEQUANTIZE
+
+/**
+ * \brief List of the normalization operation types
+ */
+typedef enum TBNormalizationOperationType {
+    TBNOT_LAYER = 0,     /**< Layer normalization, each sample is normalized over the axis and every following one */
+    TBNOT_BATCH,         /**< Batch normalization with batch statistics, each channel of the axis is normalized over every other axis */
+}TBNormalizationOperationType;
+
+#define MAX_NORMALIZATION_OPERATION TBNOT_BATCH
+
+/**
+ * \brief Memory layouts of the input and output of convolutions and poolings, weights are always OIHW
+ */
+typedef enum TBConvolutionLayout {
+    TBCL_NCHW = 0,       /**< (batch, channels, height, width) */
+    TBCL_NHWC,           /**< (batch, height, width, channels) */
+    TBCL_NCHWC,          /**< (batch, channels/c, height, width, c), channels split in blocks of c = the last dimension */
+}TBConvolutionLayout;
+
+#define MAX_CONVOLUTION_LAYOUT TBCL_NCHWC
+
+/**
+ * \brief Convolution algorithms
+ */
+typedef enum TBConvolutionAlgorithm {
+    TBCA_AUTO = 0,       /**< Picked from the dimensions of the convolution */
+    TBCA_IM2COL,         /**< Input patches unfolded into a matrix multiplied by GEMM */
+    TBCA_DIRECT,         /**< Direct loops, for short reductions e.g few input channels */
+    TBCA_WINOGRAD,       /**< Winograd F(2x2, 3x3), 3x3 kernels of stride and dilation 1 only, falls back to IM2COL */
+}TBConvolutionAlgorithm;
+
+#define MAX_CONVOLUTION_ALGORITHM TBCA_WINOGRAD
+
+/**
+ * \brief List of the pooling operation types
+ */
+typedef enum TBPoolingOperationType {
+    TBPOT_MAX = 0,       /**< Maximum of each window */
+    TBPOT_AVG,           /**< Average of each window, padding excluded */
+    TBPOT_GLOBAL_MAX,    /**< Maximum of each channel over the whole image */
+    TBPOT_GLOBAL_AVG,    /**< Average of each channel over the whole image */
+}TBPoolingOperationType;
+
+#define MAX_POOLING_OPERATION TBPOT_GLOBAL_AVG
 
 
 /**
@@ -139,11 +195,95 @@ typedef struct TBTransposeOperation{
     uint64_t axis2;                   /**< Second Axis to swap */
 }TBTransposeOperation;
 
+/**
+ * \brief Quantization operation, q = clamp(round(x/scale) + zero_point). A quantize node whose operand is
+ * a DOT of quantized tensors is fused with it, the product is requantized without a tb_float intermediate.
+ */
+typedef struct TBQuantizationOperation{
+    struct TBNode* uhs;               /**< UHS */
+    TBQuantizationOperationType type; /**< Type of the operation */
+    NDDType dtype;                    /**< Quantized dtype, NDA_DTYPE_U8 or NDA_DTYPE_I8, unused by DEQUANTIZE */
+    float scale;                      /**< Quantization scale, unused by DEQUANTIZE */
+    int32_t zero_point;               /**< Quantization zero point, unused by DEQUANTIZE */
+}TBQuantizationOperation;
+
+/**
+ * \brief Gather operation, i.e looks up rows of a table: out[i..., :] = table[indices[i...], :]. Its derivative
+ * w.r.t a rank 2 table is a row list (see `NDSparse`), only the looked up rows are stored.
+ */
+typedef struct TBGatherOperation{
+    struct TBNode* table;             /**< Table whose first axis is indexed, e.g an embedding matrix */
+    struct TBNode* indices;           /**< Row indices, I32, I64 or integral tb_float values */
+}TBGatherOperation;
+
+/**
+ * \brief Softmax cross-entropy loss along an axis, fused so that the probabilities are never materialized. Labels are
+ * either class indices (the shape of the logits without the axis) or target distributions (the shape of the logits).
+ */
+typedef struct TBCrossEntropyOperation{
+    struct TBNode* logits;            /**< Unnormalized log-probabilities */
+    struct TBNode* labels;            /**< Class indices or target distributions */
+    uint64_t axis;                    /**< Axis of the classes */
+}TBCrossEntropyOperation;
+
+/**
+ * \brief Normalization operation, y = (x - mean)*rstd*gamma + beta with rstd = 1/sqrt(variance + epsilon). The statistics
+ * and the normalization are fused, only the mean and rstd of each group are kept for the derivatives.
+ * LAYER normalization takes a gamma and a beta of the dimensions from the axis on, BATCH normalization one per channel.
+ */
+typedef struct TBNormalizationOperation{
+    struct TBNode* uhs;               /**< UHS */
+    struct TBNode* gamma;             /**< Scale, NULL for no scaling */
+    struct TBNode* beta;              /**< Shift, NULL for no shift */
+    TBNormalizationOperationType type;/**< Type of the operation */
+    uint64_t axis;                    /**< First normalized axis of LAYER, channels axis of BATCH */
+    float epsilon;                    /**< Added to the variance */
+}TBNormalizationOperation;
+
+/**
+ * \brief 2-D convolution (cross-correlation as in most frameworks) of an NCHW, NHWC or NCHWc input with OIHW weights of
+ * shape (out channels, in channels/groups, kernel height, kernel width). Index 0 of the spatial parameters is the height.
+ */
+typedef struct TBConvolutionOperation{
+    struct TBNode* uhs;               /**< Input */
+    struct TBNode* weights;           /**< OIHW weights */
+    TBConvolutionLayout layout;       /**< Layout of the input and output */
+    TBConvolutionAlgorithm algorithm; /**< Algorithm of the forward pass, TBCA_AUTO by default */
+    uint64_t stride[2];               /**< Stride */
+    uint64_t padding[2];              /**< Zero padding added on both sides */
+    uint64_t dilation[2];             /**< Spacing between kernel elements, 1 for a dense kernel */
+    uint64_t groups;                  /**< Number of groups, channels only see the channels of their group, 1 when blocked */
+}TBConvolutionOperation;
+
+/**
+ * \brief 2-D pooling of an NCHW, NHWC or NCHWc input, the window, stride and padding are ignored by global poolings.
+ * Max pooling records the position of each maximum for its derivative. Index 0 of the spatial parameters is the height.
+ */
+typedef struct TBPoolingOperation{
+    struct TBNode* uhs;               /**< Input */
+    TBPoolingOperationType type;      /**< Type of the operation */
+    TBConvolutionLayout layout;       /**< Layout of the input and output */
+    uint64_t window[2];               /**< Window dimensions */
+    uint64_t stride[2];               /**< Stride */
+    uint64_t padding[2];              /**< Padding added on both sides, smaller than the window */
+}TBPoolingOperation;
+
+/**
+ * \brief Copies an image from a layout to another, inserted by the layout propagation around blocked nodes
+ */
+typedef struct TBReorderOperation{
+    struct TBNode* uhs;               /**< Input */
+    TBConvolutionLayout from;         /**< Layout of the input */
+    TBConvolutionLayout to;           /**< Layout of the output */
+    uint64_t block;                   /**< Channels per block of the blocked side */
+}TBReorderOperation;
+
 /**
  * \brief variable node
  */
 typedef struct TBVariable {
-	char* name; /**< Name of the variable */
+	char* name;    /**< Name of the variable */
+	uint64_t slot; /**< Slot index assigned by `tb_compileGraph`, TB_NO_SLOT until the graph is compiled */
 } TBVariable;
 
 /**
@@ -151,6 +291,8 @@ typedef struct TBVariable {
  */
 typedef struct TBConstant {
 	struct NDArray* value;  /**< Constant node value */
+	uint64_t version;       /**< Incremented by `tb_constantChanged`, invalidates the values derived from the constant */
+	uint8_t borrowed;       /**< Boolean flag, true when the value belongs to someone else (a fed tensor, an archive or another graph) and is not freed with the node */
 }TBConstant;
 
 /**
@@ -52,6 +52,369 @@
 #include <tb_graph.h>
 #include <tb_operation.h>
 
+/* * * * * * * * * * * * *
+ *       WORKSPACE       *
+ * * * * * * * * * * * * */
+
+/**
+ * \brief Makes `workspace` the scratch memory of the kernels called by this thread
+ * \param[in] workspace Workspace, NULL to allocate the scratch of every call
+ * \return previous workspace of the thread
+ */
+TBWorkspace* _tb_setWorkspace(TBWorkspace* workspace);
+
+/**
+ * \brief Scratch buffer of a kernel, taken from the workspace of the thread while it has room and allocated otherwise.
+ * Its content is undefined.
+ * \param[in] count Number of elements
+ * \param[in] size Size of an element in bytes
+ * \return buffer, must be released using `_tb_releaseScratch`
+ */
+void* _tb_scratch(uint64_t count, uint64_t size);
+
+/**
+ * \brief Releases a scratch buffer, memory of the workspace is only reused by the next step
+ * \param[in] scratch Buffer returned by `_tb_scratch`
+ */
+void _tb_releaseScratch(void* scratch);
+
+/**
+ * \brief Bytes of workspace taken by a scratch buffer
+ * \param[in] count Number of elements
+ * \param[in] size Size of an element in bytes
+ * \return bytes, padded to keep the following buffers aligned
+ */
+uint64_t _tb_scratchBytes(uint64_t count, uint64_t size);
+
+/**
+ * \brief Bytes of workspace needed by `_tb_binaryInto`
+ */
+uint64_t _tb_binaryWorkspace(TBBinaryOperationType type, struct NDArray* out, struct NDArray* lhs, struct NDArray* rhs);
+
+/**
+ * \brief Bytes of workspace needed by `_tb_axisBoundInto`
+ */
+uint64_t _tb_axisBoundWorkspace(TBGraphSession* sess, TBAxisBoundOperation* abop, struct NDArray* out, struct NDArray* uhs);
+
+/**
+ * \brief Bytes of workspace needed by `_tb_convolutionInto`
+ * \param[in] packed Boolean flag, true if the weights are given transformed by `_tb_convPackWeights`
+ */
+uint64_t _tb_convolutionWorkspace(TBConvolutionOperation* cop, struct NDArray* uhs, struct NDArray* weights, uint8_t packed);
+
+/**
+ * \brief Transform of the weights read by the kernel of a convolution: 0 for none, 1 for the Winograd U matrices and
+ * 1 + c for the c x c tiles of an NCHWc kernel. Weights transformed for another kind cannot be reused.
+ */
+uint64_t _tb_convPackKind(TBConvolutionOperation* cop, struct NDArray* uhs, struct NDArray* weights);
+
+/**
+ * \brief Transforms the weights of a convolution for its kernel, see `_tb_convPackKind`
+ * \return new buffer, must be freed using `nda_memFree`, NULL if the kernel reads the weights as they are
+ */
+tb_float* _tb_convPackWeights(TBConvolutionOperation* cop, struct NDArray* uhs, struct NDArray* weights);
+
+/* * * * * * * * * * * * *
+ * DESTINATION  KERNELS  *
+ * * * * * * * * * * * * */
+
+/**
+ * \brief Computes a binary operation into a preallocated array, no memory is allocated unless an operand is stored in reduced precision.
+ * A sparse LHS of a DOT product runs the row-parallel sparse x dense kernel, other sparse operands are densified.
+ * \param[in] sess Session which contains the context of execution
+ * \param[in] type Binary operation type
+ * \param[out] out Contiguous destination array, its shape and dtype must be the ones given by `tb_binaryOpShape` and `tb_binaryOpDType`
+ * \param[in] lhs Left-hand side operand, can be strided
+ * \param[in] rhs Right-hand side operand, can be strided
+ */
+void _tb_binaryInto(TBGraphSession* sess, TBBinaryOperationType type, struct NDArray* out, struct NDArray* lhs, struct NDArray* rhs);
+
+/**
+ * \brief Computes an unary operation into a preallocated array, no memory is allocated unless an operand is stored in reduced precision.
+ * \param[in] sess Session which contains the context of execution
+ * \param[in] type Unary operation type
+ * \param[out] out Contiguous destination array, its shape and dtype must be the ones given by `tb_unaryOpShape` and `tb_unaryOpDType`
+ * \param[in] uhs Operand, can be strided
+ */
+void _tb_unaryInto(TBGraphSession* sess, TBUnaryOperationType type, struct NDArray* out, struct NDArray* uhs);
+
+/**
+ * \brief Computes an axis-bound operation into a preallocated array, no memory is allocated unless an operand is stored in reduced precision.
+ * \param[in] sess Session which contains the context of execution
+ * \param[in] abop Axis-bound operation node, contains operation meta-data
+ * \param[out] out Contiguous destination array, its shape and dtype must be the ones given by `tb_axisBoundOpShape` and `tb_axisBoundOpDType`
+ * \param[in] uhs Operand, can be strided
+ */
+void _tb_axisBoundInto(TBGraphSession* sess, TBAxisBoundOperation* abop, struct NDArray* out, struct NDArray* uhs);
+
+/**
+ * \brief Materializes a transposition into a preallocated contiguous array, no memory is allocated.
+ * \param[in] sess Session which contains the context of execution
+ * \param[in] top Transpose operation node
+ * \param[out] out Contiguous destination array, its shape must be the one given by `tb_transposeOpShape` and its dtype the one of the operand
+ * \param[in] uhs Operand, can be strided
+ */
+void _tb_transposeInto(TBGraphSession* sess, TBTransposeOperation* top, struct NDArray* out, struct NDArray* uhs);
+
+/**
+ * \brief Makes `view` the transposition of `uhs` without moving any element: `view` reads the data of the operand
+ * through swapped strides.
+ * \param[in] top Transpose operation node
+ * \param[out] view Array whose shape is the one given by `tb_transposeOpShape`, its data and strides are overwritten
+ * \param[in] uhs Dense operand, can be strided
+ */
+void _tb_transposeView(TBTransposeOperation* top, struct NDArray* view, struct NDArray* uhs);
+
+/**
+ * \brief Quantizes or dequantizes into a preallocated contiguous array, no memory is allocated unless the operand is strided.
+ * \param[in] sess Session which contains the context of execution
+ * \param[in] qop Quantization operation node
+ * \param[out] out Contiguous destination array, its shape and dtype must be the ones given by `tb_quantizationOpShape` and `tb_quantizationOpDType`
+ * \param[in] uhs Operand, can be strided
+ */
+void _tb_quantizationInto(TBGraphSession* sess, TBQuantizationOperation* qop, struct NDArray* out, struct NDArray* uhs);
+
+/**
+ * \brief Checks whether a DOT product can run on the quantized kernel, i.e LHS is a contiguous U8 array quantized
+ * per tensor and RHS a (K, N) I8 matrix quantized symmetrically per tensor or per output column.
+ * \param[in] lhs Left-hand side operand
+ * \param[in] rhs Right-hand side operand
+ * \return true if `_tb_quantizedDotInto` accepts the operands
+ */
+uint8_t _tb_isQuantizedDot(struct NDArray* lhs, struct NDArray* rhs);
+
+/**
+ * \brief Quantized DOT product computed by `tb_qgemm` on the threads of the session, the epilogue rescales the int32
+ * accumulators into tb_float or requantizes them into U8/I8 with the given parameters, without a tb_float intermediate.
+ * \param[in] sess Session which contains the context of execution, sets the threads
+ * \param[out] out Contiguous destination array of shape `tb_binaryOpShape`, of dtype tb_float, U8 or I8
+ * \param[in] lhs Left-hand side operand, see `_tb_isQuantizedDot`
+ * \param[in] rhs Right-hand side operand, see `_tb_isQuantizedDot`
+ * \param[in] packed `rhs` packed by `tb_qgemmPack`, NULL to pack it on every call
+ * \param[in] scale Scale of a quantized output, ignored for a tb_float output
+ * \param[in] zero_point Zero point of a quantized output, ignored for a tb_float output
+ */
+void _tb_quantizedDotInto(TBGraphSession* sess, struct NDArray* out, struct NDArray* lhs, struct NDArray* rhs,
+                          const struct TBQGemmPacked* packed, float scale, int32_t zero_point);
+
+/**
+ * \brief Looks up rows of a table into a preallocated array, no memory is allocated unless the table is sparse.
+ * Rows are moved without conversion and split across threads, the rows of the following indices are prefetched.
+ * \param[in] sess Session which contains the context of execution, sets the number of threads
+ * \param[in] gop Gather operation node
+ * \param[out] out Contiguous destination array, its shape and dtype must be the ones given by `tb_gatherOpShape` and `tb_gatherOpDType`
+ * \param[in] table Table, contiguous or a strided matrix
+ * \param[in] indices Row indices, can be strided
+ */
+void _tb_gatherInto(TBGraphSession* sess, TBGatherOperation* gop, struct NDArray* out, struct NDArray* table, struct NDArray* indices);
+
+/**
+ * \brief Quantization parameters of the output of a gather, the per-channel axis is shifted by the extra indices dimensions
+ * \param[in] quant Quantization parameters of the table, can be NULL
+ * \param[in] irank Rank of the indices
+ * \return new quantization parameters, NULL if quant is NULL
+ */
+struct NDQuantParams* _tb_gatherQuant(struct NDQuantParams* quant, uint64_t irank);
+
+/**
+ * \brief Scatter-adds the gradient of a gather into the derivative of its table. A sparse derivative is replaced by a
+ * new one storing the touched rows whole, a dense derivative is updated in place.
+ * \param[in] sess Session which contains the context of execution
+ * \param[in/out] diff Derivative of the table
+ * \param[in] g Gradient of the gather output
+ * \param[in] indices Row indices of the gather
+ */
+void _tb_gatherGradAccumulate(TBGraphSession* sess, TBResultNode* diff, struct NDArray* g, struct NDArray* indices);
+
+/**
+ * \brief Computes the derivative of SOFTMAX or LOG_SOFTMAX w.r.t their operand, from their output and its derivative
+ * \param[in] sess Session which contains the context of execution
+ * \param[in] abop Axis-bound operation node, SOFTMAX or LOG_SOFTMAX
+ * \param[out] out Contiguous destination array of the shape of the operand
+ * \param[in] y Output of the operation
+ * \param[in] g Derivative of the output
+ */
+void _tb_softmaxGradInto(TBGraphSession* sess, TBAxisBoundOperation* abop, struct NDArray* out, struct NDArray* y, struct NDArray* g);
+
+/**
+ * \brief Computes a softmax cross-entropy into a preallocated array in a single pass over each lane of logits, the
+ * probabilities are never stored.
+ * \param[in] sess Session which contains the context of execution
+ * \param[in] ceop Cross-entropy operation node
+ * \param[out] out Contiguous destination array, its shape must be the one given by `tb_crossEntropyOpShape`
+ * \param[in] logits Logits, can be strided
+ * \param[in] labels Class indices or target distributions, can be strided
+ */
+void _tb_crossEntropyInto(TBGraphSession* sess, TBCrossEntropyOperation* ceop, struct NDArray* out, struct NDArray* logits, struct NDArray* labels);
+
+/**
+ * \brief Computes the derivative of a softmax cross-entropy w.r.t its logits, g*(softmax(logits) - labels)
+ * \param[in] sess Session which contains the context of execution
+ * \param[in] ceop Cross-entropy operation node
+ * \param[out] out Contiguous destination array of the shape of the logits
+ * \param[in] logits Logits
+ * \param[in] labels Class indices or target distributions
+ * \param[in] g Derivative of the loss
+ */
+void _tb_crossEntropyGradInto(TBGraphSession* sess, TBCrossEntropyOperation* ceop, struct NDArray* out, struct NDArray* logits, struct NDArray* labels, struct NDArray* g);
+
+/**
+ * \brief Number of normalized groups of an operand, i.e the samples of LAYER or the channels of BATCH normalization
+ * \param[in] nop Normalization operation node
+ * \param[in] shape Shape of the operand
+ * \return number of groups, each one has a mean and a rstd
+ */
+uint64_t _tb_normalizationGroups(TBNormalizationOperation* nop, struct NDShape* shape);
+
+/**
+ * \brief Normalizes into a preallocated array in two passes over each group, one for the Welford statistics and one
+ * writing (x - mean)*rstd*gamma + beta. Groups are split across threads, no memory is allocated for contiguous tb_float operands.
+ * \param[in] sess Session which contains the context of execution, sets the number of threads
+ * \param[in] nop Normalization operation node
+ * \param[out] out Contiguous destination array of the shape of the operand
+ * \param[in] uhs Operand, can be strided
+ * \param[in] gamma Scale, can be NULL
+ * \param[in] beta Shift, can be NULL
+ * \param[out] stats Contiguous (groups, 2) array receiving the mean and rstd of each group, can be NULL
+ */
+void _tb_normalizationInto(TBGraphSession* sess, TBNormalizationOperation* nop, struct NDArray* out, struct NDArray* uhs, struct NDArray* gamma, struct NDArray* beta, struct NDArray* stats);
+
+/**
+ * \brief Computes the derivatives of a normalization w.r.t its operand, gamma and beta in two passes over each group,
+ * from the saved mean and rstd. The normalized values are recomputed instead of being stored by the forward pass.
+ * \param[in] sess Session which contains the context of execution, sets the number of threads
+ * \param[in] nop Normalization operation node
+ * \param[out] dx Contiguous destination array of the shape of the operand
+ * \param[out] dgamma Contiguous destination array of the shape of gamma, can be NULL
+ * \param[out] dbeta Contiguous destination array of the shape of beta, can be NULL
+ * \param[in] uhs Operand
+ * \param[in] gamma Scale, can be NULL
+ * \param[in] stats Statistics written by `_tb_normalizationInto`, recomputed when NULL
+ * \param[in] g Derivative of the output
+ */
+void _tb_normalizationGradInto(TBGraphSession* sess, TBNormalizationOperation* nop, struct NDArray* dx, struct NDArray* dgamma, struct NDArray* dbeta,
+                               struct NDArray* uhs, struct NDArray* gamma, struct NDArray* stats, struct NDArray* g);
+
+/**
+ * \brief 2-D convolution into a preallocated array. 3x3 kernels of stride and dilation 1 with enough channels run
+ * Winograd F(2x2, 3x3), short reductions (few channels, small kernels) a direct kernel split across threads, the
+ * others im2col feeding GEMM, unless the operation forces an algorithm.
+ * \param[in] sess Session which contains the context of execution, sets the number of threads of the direct kernel
+ * \param[in] cop Convolution operation node
+ * \param[out] out Contiguous destination array, its shape must be the one given by `tb_convolutionOpShape`
+ * \param[in] uhs Input, can be strided
+ * \param[in] weights OIHW weights, can be strided
+ * \param[in] packed `weights` transformed by `_tb_convPackWeights`, NULL to transform them on every call
+ */
+void _tb_convolutionInto(TBGraphSession* sess, TBConvolutionOperation* cop, struct NDArray* out, struct NDArray* uhs, struct NDArray* weights,
+                         const tb_float* packed);
+
+/**
+ * \brief Computes the derivatives of a 2-D convolution w.r.t its input and its weights through im2col and GEMM
+ * \param[in] sess Session which contains the context of execution
+ * \param[in] cop Convolution operation node
+ * \param[out] dx Contiguous destination array of the shape of the input, can be NULL
+ * \param[out] dw Contiguous destination array of the shape of the weights, can be NULL
+ * \param[in] uhs Input
+ * \param[in] weights OIHW weights
+ * \param[in] g Derivative of the output
+ */
+void _tb_convolutionGradInto(TBGraphSession* sess, TBConvolutionOperation* cop, struct NDArray* dx, struct NDArray* dw, struct NDArray* uhs, struct NDArray* weights, struct NDArray* g);
+
+/**
+ * \brief Max or average pooling into a preallocated array, output rows are split across threads. Channels are the
+ * innermost loop so NHWC windows are reduced as contiguous vectors of channels.
+ * \param[in] sess Session which contains the context of execution, sets the number of threads
+ * \param[in] pop Pooling operation node
+ * \param[out] out Contiguous destination array, its shape must be the one given by `tb_poolingOpShape`
+ * \param[in] uhs Input, can be strided
+ * \param[out] indices Contiguous I64 array of the output shape receiving the input offset of each maximum, can be NULL
+ */
+void _tb_poolingInto(TBGraphSession* sess, TBPoolingOperation* pop, struct NDArray* out, struct NDArray* uhs, struct NDArray* indices);
+
+/**
+ * \brief Computes the derivative of a pooling w.r.t its input, max pooling scatters the gradient to the recorded maxima
+ * \param[in] sess Session which contains the context of execution
+ * \param[in] pop Pooling operation node
+ * \param[out] dx Contiguous destination array of the shape of the input
+ * \param[in] uhs Input
+ * \param[in] indices Maxima written by `_tb_poolingInto`, recomputed when NULL, unused by average pooling
+ * \param[in] g Derivative of the output
+ */
+void _tb_poolingGradInto(TBGraphSession* sess, TBPoolingOperation* pop, struct NDArray* dx, struct NDArray* uhs, struct NDArray* indices, struct NDArray* g);
+
+/**
+ * \brief Copies an image to another layout into a preallocated array
+ * \param[in] rop Reorder operation node
+ * \param[out] out Contiguous destination array, its shape must be the one given by `tb_reorderOpShape`
+ * \param[in] uhs Input, can be strided
+ */
+void _tb_reorderInto(TBReorderOperation* rop, struct NDArray* out, struct NDArray* uhs);
+
+/**
+ * \brief Computes the derivative of a reorder w.r.t its input, the reverse reorder of the gradient
+ * \param[in] rop Reorder operation node
+ * \param[out] dx Contiguous destination array of the shape of the input
+ * \param[in] g Derivative of the output
+ */
+void _tb_reorderGradInto(TBReorderOperation* rop, struct NDArray* dx, struct NDArray* g);
+
+/**
+ * \brief Checks whether a DOT product RHS can be packed, a dense tb_float matrix
+ * \param[in] rhs DOT product RHS
+ * \return 1 if `_tb_packMatrix` accepts it, 0 otherwise
+ */
+uint8_t _tb_packable(struct NDArray* rhs);
+
+/**
+ * \brief Checks whether a DOT product is run by the packed kernel: a packable RHS and a small dense tb_float LHS,
+ * for which repacking the RHS dominates the product
+ * \param[in] lhs DOT product LHS
+ * \param[in] rhs DOT product RHS
+ * \return 1 if `_tb_packedDotInto` should be used, 0 otherwise
+ */
+uint8_t _tb_packedDotApplies(struct NDArray* lhs, struct NDArray* rhs);
+
+/**
+ * \brief Packs a DOT product RHS into the panel format of the packed GEMM micro-kernel
+ * \param[in] rhs Packable (K, N) matrix, can be strided
+ * \return new packed matrix, must be freed using `_tb_freePackedMatrix`
+ */
+TBPackedMatrix* _tb_packMatrix(struct NDArray* rhs);
+
+/**
+ * \brief Frees a packed matrix
+ * \param[in] packed Matrix to free
+ */
+void _tb_freePackedMatrix(TBPackedMatrix* packed);
+
+/**
+ * \brief DOT product of a tb_float LHS with a packed RHS into a preallocated array, panels of output columns are split
+ * across threads. No memory is allocated.
+ * \param[in] sess Session which contains the context of execution, sets the number of threads
+ * \param[out] out Contiguous destination array, its shape must be the one given by `tb_binaryOpShape`
+ * \param[in] lhs Dense tb_float LHS of rank 1 or 2, can be strided
+ * \param[in] rhs Packed RHS
+ */
+void _tb_packedDotInto(TBGraphSession* sess, struct NDArray* out, struct NDArray* lhs, TBPackedMatrix* rhs);
+
+/**
+ * \brief Accumulates the gradient of a sparse DOT product LHS, out[m, k] += sum_n g[m, n] * w[k, n], only at the
+ * stored positions of `out` so the gradient keeps the sparsity pattern of the operand. Rows are split across threads.
+ * \param[in] sess Session which contains the context of execution, sets the number of threads
+ * \param[in/out] out Sparse gradient, with the sparsity pattern of the DOT product LHS
+ * \param[in] g Dense gradient of the DOT product output
+ * \param[in] w Dense DOT product RHS
+ */
+void _tb_sparseMaskedDotAccumulate(TBGraphSession* sess, struct NDArray* out, struct NDArray* g, struct NDArray* w);
+
+/**
+ * \brief Checks whether the backend implements the operation of a node
+ * \param[in] node Node to check
+ * \return true if the node can be computed by the destination kernels
+ */
+uint8_t _tb_isImplemented(TBNode* node);
+
 /* * * * * * * * * * *
  * BINARY OPERATIONS *
  * * * * * * * * * * */
@@ -101,6 +464,18 @@ TBResultNode* _tb_div(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResu
  */
 TBResultNode* _tb_dot(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* lhs, TBResultNode* rhs);
 
+/**
+ * \brief Dot product with a RHS packed ahead of time, see `_tb_packedDotApplies`
+ * \param[in] sess Session which contains the context of execution
+ * \param[in] graph Parent graph which is being executed
+ * \param[in] node Current node that is being executed
+ * \param[in] lhs Left-hand side result node
+ * \param[in] rhs Right-hand side result node
+ * \param[in] packed Value of `rhs` packed by `_tb_packMatrix`
+ * \return Result of the operation
+ */
+TBResultNode* _tb_packedDot(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* lhs, TBResultNode* rhs, TBPackedMatrix* packed);
+
 /**
  * \brief Multiplication between two tensors. Support broadcasting
  * \param[in] sess Session which contains the context of execution
@@ -170,7 +545,7 @@ TBResultNode* _tb_sum(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResu
 TBResultNode* _tb_product(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBAxisBoundOperation* abop);
 
 /**
- * \brief Mean of the element in the given axis
+ * \brief Mean of the element in the given axis, computed with the one-pass Welford update
  * \param[in] sess Session which contains the context of execution
  * \param[in] graph Parent graph which is being executed
  * \param[in] node Current node that is being executed
@@ -180,6 +555,18 @@ TBResultNode* _tb_product(TBGraphSession* sess, TBGraph* graph, TBNode* node, TB
  */
 TBResultNode* _tb_mean(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBAxisBoundOperation* abop);
 
+/**
+ * \brief Population variance of the element in the given axis, computed with the one-pass Welford update. Lanes,
+ * or chunks of long lanes whose moments are merged afterwards, are split across threads.
+ * \param[in] sess Session which contains the context of execution
+ * \param[in] graph Parent graph which is being executed
+ * \param[in] node Current node that is being executed
+ * \param[in] uhs Unary-hand side result node
+ * \param[in] abop Axis-bound operation node, contains operation meta-data
+ * \return Result of the operation
+ */
+TBResultNode* _tb_variance(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBAxisBoundOperation* abop);
+
 /**
  * \brief Argmax element in the given axis
  * \param[in] sess Session which contains the context of execution
@@ -203,7 +590,7 @@ TBResultNode* _tb_argmax(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBR
 TBResultNode* _tb_argmin(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBAxisBoundOperation* abop);
 
 /**
- * \brief Numerically stable softmax
+ * \brief Numerically stable SOFTMAX or LOG_SOFTMAX, each lane is read once for its online max and sum of exponentials
  * \param[in] sess Session which contains the context of execution
  * \param[in] graph Parent graph which is being executed
  * \param[in] node Current node that is being executed
@@ -236,4 +623,39 @@ TBResultNode* _tb_elu(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResu
  * * * * * * */
 TBResultNode* _tb_transpose(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBTransposeOperation* top);
 
+/* * * * * * * * *
+ * Quantization  *
+ * * * * * * * * */
+TBResultNode* _tb_quantization(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBQuantizationOperation* qop);
+
+/* * * * * *
+ * Gather  *
+ * * * * * */
+TBResultNode* _tb_gather(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* table, TBResultNode* indices, TBGatherOperation* gop);
+
+/* * * * * * * * * *
+ * Cross-entropy   *
+ * * * * * * * * * */
+TBResultNode* _tb_crossEntropy(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* logits, TBResultNode* labels, TBCrossEntropyOperation* ceop);
+
+/* * * * * * * * * *
+ * Normalization   *
+ * * * * * * * * * */
+TBResultNode* _tb_normalization(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBResultNode* gamma, TBResultNode* beta, TBNormalizationOperation* nop, struct NDArray* stats);
+
+/* * * * * * * * *
+ * Convolution   *
+ * * * * * * * * */
+TBResultNode* _tb_convolution(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBResultNode* weights, TBConvolutionOperation* cop);
+
+/* * * * * * *
+ * Pooling   *
+ * * * * * * */
+TBResultNode* _tb_pooling(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBPoolingOperation* pop, struct NDArray* indices);
+
+/* * * * * * *
+ * Reorder   *
+ * * * * * * */
+TBResultNode* _tb_reorder(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBReorderOperation* rop);
+
 #endif
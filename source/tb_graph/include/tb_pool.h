@@ -0,0 +1,90 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file tb_pool.h
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing the worker threads of the parallel kernels.
+ *
+ * A pool keeps its workers across calls, so a parallel kernel only pays a wake up instead of a thread creation,
+ * and the workers can keep per-thread scratch (e.g the packing buffers of `tb_gemm`) for their whole lifetime.
+ * Workers are created on demand, up to the largest number of tasks run at once.
+ */
+
+#ifndef _TB_POOL_H_
+#define _TB_POOL_H_
+
+#include <stdint.h>
+
+/**
+ * \brief Persistent worker threads
+ */
+typedef struct TBThreadPool TBThreadPool;
+
+/**
+ * \brief Creates a pool without workers
+ * \return new pool, must be freed using `tb_freeThreadPool`
+ */
+TBThreadPool* tb_newThreadPool(void);
+
+/**
+ * \brief Returns the pool shared by the callers which have none, e.g runs without session
+ * \return process-wide pool
+ */
+TBThreadPool* tb_defaultThreadPool(void);
+
+/**
+ * \brief Runs `worker` on each of `n` tasks and waits for all of them. The first task runs on the calling thread,
+ * the other ones on the workers. A pool already running tasks (e.g when called from one of its workers) runs all
+ * of them on the calling thread instead.
+ * \param[in/out] pool Pool, NULL for `tb_defaultThreadPool`
+ * \param[in] n Number of tasks
+ * \param[in] worker Function called with the address of each task
+ * \param[in/out] tasks Array of tasks
+ * \param[in] task_size Size of a task in bytes
+ */
+void tb_poolRun(TBThreadPool* pool, uint64_t n, void* (*worker)(void*), void* tasks, uint64_t task_size);
+
+/**
+ * \brief Stops the workers and frees a pool
+ * \param[in/out] pool Pool
+ */
+void tb_freeThreadPool(TBThreadPool* pool);
+
+#endif
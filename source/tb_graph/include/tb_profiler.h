@@ -0,0 +1,163 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file tb_profiler.h
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing the per-node execution profiler of CPU sessions.
+ *
+ * Once enabled on a session, every operation node it evaluates (through `tb_runSession` or a prepared run) is
+ * recorded with its timestamps, thread, output shape, FLOPs and allocated bytes. Sessions without profiler only
+ * pay a NULL check per node.
+ */
+
+#ifndef _TB_PROFILER_H_
+#define _TB_PROFILER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include <tb_graph.h>
+#include <tb_session_cpu.h>
+
+/**
+ * \brief Output dimensions kept per event, higher ranks are truncated
+ */
+#define TB_PROFILE_MAX_RANK 6
+
+/**
+ * \brief Evaluation of a node
+ */
+typedef struct TBProfileEvent {
+    const char* op;                /**< Operation name, see `tb_nodeOpName` */
+    TBNodeType type;               /**< Node type */
+    uint64_t node_id;              /**< Id of the node in its graph */
+    uint64_t tid;                  /**< Profiler id of the evaluating thread, 0 for the first thread seen */
+    uint64_t start;                /**< Start, nanoseconds since the profiler was enabled */
+    uint64_t duration;             /**< Nanoseconds, including the evaluation of its operands by `tb_runSession` */
+    uint64_t self;                 /**< Nanoseconds spent in the node itself */
+    uint64_t flops;                /**< Estimated floating point operations */
+    uint64_t bytes;                /**< Bytes allocated for the output, 0 for prepared runs */
+    uint64_t rank;                 /**< Rank of the output */
+    uint64_t dims[TB_PROFILE_MAX_RANK]; /**< Output dimensions */
+    uint8_t prepared;              /**< Boolean flag, true for prepared run steps */
+}TBProfileEvent;
+
+/**
+ * \brief Events recorded by a session, appended under a lock so concurrent runs of the session can be profiled
+ */
+typedef struct TBProfiler {
+    pthread_mutex_t lock;          /**< Guards the events */
+    uint64_t origin;               /**< Monotonic nanoseconds when the profiler was enabled */
+    TBProfileEvent* events;        /**< Events in recording order */
+    uint64_t events_len;           /**< Number of events */
+    uint64_t events_cap;           /**< Capacity of the events array */
+}TBProfiler;
+
+/**
+ * \brief Timing of a node in progress, see `_tb_profileBegin`
+ */
+typedef struct TBProfileScope {
+    uint64_t start;                /**< Monotonic nanoseconds at the start of the node */
+    uint64_t children;             /**< Operand time of the enclosing node, restored when the node ends */
+}TBProfileScope;
+
+/**
+ * \brief Enables or disables the profiling of a session. Enabling starts a new profile, disabling drops it.
+ * \param[in/out] session Session
+ * \param[in] enabled Boolean flag
+ */
+void tb_sessionSetProfiling(TBGraphSession* session, uint8_t enabled);
+
+/**
+ * \brief Returns the profiler of a session
+ * \param[in] session Session
+ * \return profiler, NULL when profiling is disabled
+ */
+TBProfiler* tb_sessionGetProfiler(TBGraphSession* session);
+
+/**
+ * \brief Drops the recorded events, timestamps restart from 0
+ * \param[in/out] profiler Profiler
+ */
+void tb_profilerClear(TBProfiler* profiler);
+
+/**
+ * \brief Writes the events in the Chrome trace event format, to open in chrome://tracing or Perfetto
+ * \param[in] profiler Profiler
+ * \param[in/out] out Output stream
+ */
+void tb_profilerWriteTrace(TBProfiler* profiler, FILE* out);
+
+/**
+ * \brief Writes a summary of the profile: nodes sorted by self time, then totals per operation
+ * \param[in] profiler Profiler
+ * \param[in/out] out Output stream
+ * \param[in] top Maximum number of nodes listed, 0 for all
+ */
+void tb_profilerWriteSummary(TBProfiler* profiler, FILE* out, uint64_t top);
+
+/**
+ * \brief Frees a profiler and its events
+ * \param[in/out] profiler Profiler
+ */
+void _tb_freeProfiler(TBProfiler* profiler);
+
+/**
+ * \brief Starts timing a node, nested nodes started before it ends count as its operands
+ * \param[out] scope Timing of the node
+ */
+void _tb_profileBegin(TBProfileScope* scope);
+
+/**
+ * \brief Ends timing a node and records it
+ * \param[in/out] profiler Profiler
+ * \param[in] scope Timing started by `_tb_profileBegin` on the same thread
+ * \param[in] node Evaluated node
+ * \param[in] out Value of the node
+ * \param[in] lhs Value of its first operand, NULL if none
+ * \param[in] rhs Value of its second operand (e.g the weights of a convolution), NULL if none
+ * \param[in] bytes Bytes allocated by the evaluation
+ * \param[in] prepared Boolean flag, true for prepared run steps
+ */
+void _tb_profileEnd(TBProfiler* profiler, TBProfileScope* scope, TBNode* node, struct NDArray* out,
+                    struct NDArray* lhs, struct NDArray* rhs, uint64_t bytes, uint8_t prepared);
+
+#endif
@@ -0,0 +1,106 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file tb_quantize.h
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing the post-training INT8 quantization of graphs.
+ *
+ * A calibrator records the range of every node over a few tb_float runs, the graph is then rewritten so
+ * that DOT products with constant weights run on the quantized kernel: activations are quantized to U8
+ * with the calibrated range, weights to I8 with one scale per output column.
+ */
+
+#ifndef _TB_QUANTIZE_H_
+#define _TB_QUANTIZE_H_
+
+#include <stdint.h>
+
+#include <ndarray.h>
+#include <tb_graph.h>
+#include <tb_session.h>
+
+/**
+ * \brief Structure of a calibrator
+ */
+typedef struct TBCalibrator TBCalibrator;
+
+/**
+ * \brief Creates a calibrator of a graph, compiles the graph if needed.
+ * \param[in] graph Graph to calibrate
+ * \return new calibrator, must be freed using `tb_freeCalibrator`
+ */
+struct TBCalibrator* tb_newCalibrator(TBGraph* graph);
+
+/**
+ * \brief Records the minimum and maximum of every node computed by the last `tb_runSession` of the graph
+ * within the session, should be called after each calibration run.
+ * \param[in/out] cal Calibrator
+ * \param[in] session Session which ran the graph, NULL for the runs which were not given a session
+ */
+void tb_calibratorObserve(struct TBCalibrator* cal, struct TBGraphSession* session);
+
+/**
+ * \brief Returns the range recorded for a node
+ * \param[in] cal Calibrator
+ * \param[in] node Node of the calibrated graph
+ * \param[out] min Minimum observed value
+ * \param[out] max Maximum observed value
+ * \return true if the node has been observed
+ */
+uint8_t tb_calibratorRange(struct TBCalibrator* cal, TBNode* node, float* min, float* max);
+
+/**
+ * \brief Builds the quantized version of the calibrated graph. Every DOT whose RHS is a constant tb_float matrix
+ * (directly or through a bound variable) and whose LHS has been observed becomes DOT(QUANTIZE(lhs), weights),
+ * the output of a DOT feeding another one is requantized by the fused kernel. Other nodes are copied, constant
+ * tensors, variable names and nested graphs are shared with the calibrated graph which must outlive the new one.
+ * \param[in] cal Calibrator
+ * \param[in] name Name of the new graph, not copied
+ * \return new graph, variables keep their names and bindings
+ */
+TBGraph* tb_quantizeGraph(struct TBCalibrator* cal, char* name);
+
+/**
+ * \brief Deallocates/frees a calibrator, the calibrated graph is left untouched.
+ * \param[in/out] cal Calibrator to free
+ */
+void tb_freeCalibrator(struct TBCalibrator* cal);
+
+#endif
@@ -0,0 +1,85 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file tb_serialize.h
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing the binary serialization of graphs.
+ *
+ * A graph file holds a header, the structure of the graph and, at the end of the file,
+ * an ndarray archive (see ndarray_io.h) containing the constant tensors. Nodes are written
+ * children first, so loading is a single pass over the structure, and constants point straight
+ * into the mapped archive.
+ */
+
+#ifndef _TB_SERIALIZE_H_
+#define _TB_SERIALIZE_H_
+
+#include <stdint.h>
+
+#include <tb_graph.h>
+
+#define TB_GRAPH_MAGIC "TBGRAPH"  /**< 7 chars + NULL terminator = 8 bytes */
+#define TB_GRAPH_VERSION 2
+
+/**
+ * \brief Alignment of the embedded tensor archive within the file, large enough for every common page size
+ * so the archive can be mapped in place.
+ */
+#define TB_GRAPH_ARCHIVE_ALIGN 65536
+
+/**
+ * \brief Saves a graph, its nested graphs, the variables bound to it and its constant tensors.
+ * Tensors fed through `tb_graphFeedSlot` are not saved. Compiles the graph if needed.
+ * \param[in/out] graph Graph to save
+ * \param[in] path Path of the file to write, the file is overwritten. It must not be the file a graph
+ * still in use was loaded from, since its tensors are mapped from that file.
+ * \return 1 on success, 0 if the file could not be written
+ */
+uint8_t tb_saveGraph(TBGraph* graph, const char* path);
+
+/**
+ * \brief Loads a graph saved by `tb_saveGraph`. The returned graph is already compiled and its
+ * constant tensors are mapped from the file, they must not be freed independently.
+ * \param[in] path Path of the file to load
+ * \return compiled graph, NULL if the file cannot be read or is malformed
+ */
+TBGraph* tb_loadGraph(const char* path);
+
+#endif
@@ -55,6 +55,13 @@
 struct TBGraphSession;
 struct TBGraphNodeParam;
 
+/**
+ * \brief Structure of a prepared run
+ * A prepared run binds the inputs and the output of a graph once, and keeps the buffers of every node
+ * between executions, which lets repeated runs on inputs of the same shapes perform no heap allocation.
+ */
+struct TBPreparedRun;
+
 /* * * * * * * *
  * Session API *
  * * * * * * * */ 
@@ -65,6 +72,13 @@ struct TBGraphNodeParam;
  */
 struct TBGraphSession* tb_createLocalCPUSession();
 
+/**
+ * \brief Limits the number of threads used by the parallel kernels of a session
+ * \param[in/out] session Session to configure
+ * \param[in] threads Maximum number of threads, 0 (the default) to use every online CPU
+ */
+void tb_sessionSetThreads(struct TBGraphSession* session, uint64_t threads);
+
 // TODO: Requires OpenCL
 // TBGraphSession* tb_createLocalAutoSelectSession(TBGraphNodeParam** params);
 // TBGraphSession* tb_createLocalGPUSession(uint8_t gpu_id, TBGraphNodeParam** params);
@@ -72,10 +86,13 @@ struct TBGraphSession* tb_createLocalCPUSession();
 
 
 /**
- * \brief Computes session
- * \param[in] session Session to run
+ * \brief Computes session. Results, derivatives and the nodes given as parameters are kept by the session,
+ * different sessions can run the same compiled graph concurrently from different threads. A session holds a
+ * single run state per graph and must only be used by one thread at a time.
+ * \param[in] session Session to run, NULL to use the process-wide session shared by every run without session,
+ * a graph must then not be run without session from two threads at once
  * \param[in/out] graph Graph to run
- * \param[in] params Optional array of Node-Var name pairs, set to NULL if not needed
+ * \param[in] params Optional array of Node-Var name pairs bound for this session, set to NULL if not needed
  * \return computation result which can be checked for error
  */
 struct TBResultNode* tb_runSession(struct TBGraphSession* session, struct TBGraph* graph, struct TBGraphNodeParam** params);
@@ -83,11 +100,69 @@ struct TBResultNode* tb_runSession(struct TBGraphSession* session, struct TBGrap
 /**
  * \brief Computes session with no parent graph
  * \param[in] session Session to run
- * \param[in/out] node Node to run
+ * \param[in/out] node Node to run, the node and the nodes it reaches are freed by the call (constant values included)
  * \return computation result which can be checked for error
  */
 struct TBResultNode* tb_runSessionNodeOnly(struct TBGraphSession* session, struct TBNode* node);
 
+/**
+ * \brief Returns the last computed value of a node in a session run
+ * \param[in] session Session which ran the graph, NULL for runs without session
+ * \param[in] graph Graph which has been run
+ * \param[in] node Node of the graph
+ * \return result owned by the session, NULL if the node has not been computed
+ */
+struct TBResultNode* tb_sessionGetResult(struct TBGraphSession* session, struct TBGraph* graph, struct TBNode* node);
+
+/**
+ * \brief Returns the derivative of the graph root w.r.t a node, computed by `tb_autogradGraph`
+ * \param[in] session Session which ran the graph, NULL for runs without session
+ * \param[in] graph Graph which has been run
+ * \param[in] node Node of the graph, or node bound to one of its variables
+ * \return derivative owned by the session, NULL if the node has not been computed
+ */
+struct TBResultNode* tb_sessionGetDiff(struct TBGraphSession* session, struct TBGraph* graph, struct TBNode* node);
+
+/* * * * * * * * * * *
+ * Prepared run API  *
+ * * * * * * * * * * */
+
+/**
+ * \brief Prepares a graph for repeated runs. The graph is compiled, its buffers are planned on the first run.
+ * \param[in] session Session to run
+ * \param[in] graph Graph to prepare, it must not be modified while the prepared run is in use
+ * \return new prepared run, must be freed using `tb_freePreparedRun`
+ */
+struct TBPreparedRun* tb_prepareRun(struct TBGraphSession* session, struct TBGraph* graph);
+
+/**
+ * \brief Binds a caller-owned tensor to a variable slot of the prepared graph, the tensor is not copied.
+ * Its content can be changed between runs, binding a tensor of a different shape re-plans the next run.
+ * \param[in/out] run Prepared run
+ * \param[in] slot Variable slot, see `tb_graphGetVarSlot`
+ * \param[in] input Input tensor, must outlive its binding
+ */
+void tb_preparedBindInput(struct TBPreparedRun* run, uint64_t slot, struct NDArray* input);
+
+/**
+ * \brief Binds a caller-owned tensor as the destination of the graph output, its shape must match the output shape.
+ * \param[in/out] run Prepared run
+ * \param[in] output Contiguous output tensor, NULL to let the run own the output
+ */
+void tb_preparedBindOutput(struct TBPreparedRun* run, struct NDArray* output);
+
+/**
+ * \brief Runs a prepared graph, only the first run after binding new shapes allocates memory.
+ * \param[in/out] run Prepared run
+ * \return computation result owned by the run, valid until the next run. Its value is the bound output if any.
+ */
+struct TBResultNode* tb_runPrepared(struct TBPreparedRun* run);
+
+/**
+ * \brief Deallocates/frees a prepared run and the buffers it owns, bound tensors are left untouched.
+ * \param[in/out] run Prepared run to free
+ */
+void tb_freePreparedRun(struct TBPreparedRun* run);
 
 /**
  * \brief Deallocates/frees a session after use, graph is freed as well. 
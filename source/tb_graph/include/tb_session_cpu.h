@@ -46,8 +46,166 @@
 #ifndef _TB_SESSION_CPU_
 #define _TB_SESSION_CPU_
 
+#include <stdint.h>
+#include <pthread.h>
+
+#include <tb_graph.h>
+#include <tb_pool.h>
+
+/**
+ * \brief Per-run state of a node
+ */
+typedef struct TBContextEntry {
+    TBNode* node;                  /**< Node owning the state */
+    TBResultNode* result;          /**< Last computed value of the node, the value of constants is borrowed */
+    TBResultNode* diff;            /**< Derivative of the root node w.r.t the node */
+    uint8_t row_sparse;            /**< Boolean flag, true when the node is the table of a gather: its derivative is a row list */
+    struct NDArray* saved;         /**< Values kept by the forward pass for the derivatives, e.g normalization statistics */
+    struct TBNodeMemory* memory;   /**< Allocations charged to the node, NULL until evaluated with memory accounting */
+    uint64_t run;                  /**< Last run which used the state, only tracked for nodes outside the graph */
+}TBContextEntry;
+
+/**
+ * \brief Per-run state of a graph, the graph itself is left untouched by runs.
+ * Nodes of the graph are indexed by their id, nodes reached from outside the graph (i.e bound to variables
+ * after compilation) are kept apart and dropped once a run went by without using them.
+ */
+typedef struct TBRunContext {
+    TBGraph* graph;                /**< Graph the state belongs to */
+    TBContextEntry* entries;       /**< State of each node of the graph, indexed by node id */
+    uint64_t entries_len;          /**< Number of nodes of the graph */
+    TBContextEntry** extras;       /**< State of nodes outside the graph */
+    uint64_t extras_len;           /**< Number of nodes outside the graph */
+    uint64_t runs;                 /**< Number of runs of the graph within the context */
+    TBNode** bindings;             /**< Node bound to each variable slot for this run, NULL to use the graph binding */
+    uint8_t temporary;             /**< Boolean flag, true for the single-use contexts of `tb_runSessionNodeOnly` */
+}TBRunContext;
+
+typedef vec_t(TBRunContext*) TBRunContext_Vec;
+
+/**
+ * \brief (K, N) matrix stored as panels of consecutive columns, the layout read by the packed GEMM micro-kernel
+ */
+typedef struct TBPackedMatrix {
+    uint64_t K;                    /**< Rows of the matrix */
+    uint64_t N;                    /**< Columns of the matrix */
+    tb_float* data;                /**< Panels, each one K rows of a fixed number of columns padded with zeros */
+}TBPackedMatrix;
+
+/**
+ * \brief Packed value of a constant DOT product RHS or convolution weights, kept by a session across runs
+ */
+typedef struct TBPackedWeights {
+    struct TBConstant* constant;   /**< Packed constant */
+    struct NDArray* value;         /**< Value of the constant when it was packed */
+    void* raw;                     /**< Data of the value when it was packed */
+    uint64_t version;              /**< Version of the constant when it was packed */
+    TBPackedMatrix* packed;        /**< Value packed for the tb_float DOT product, NULL until used */
+    struct TBQGemmPacked* quantized; /**< Value packed for the quantized DOT product, NULL until used */
+    tb_float* conv;                /**< Value transformed for the kernel of a convolution, NULL until used */
+    uint64_t conv_kind;            /**< Transform of `conv`, see `_tb_convPackKind` */
+}TBPackedWeights;
+
+typedef vec_t(TBPackedWeights*) TBPackedWeights_Vec;
+
 typedef struct TBGraphSession{
-    uint8_t dummy;
+    TBRunContext_Vec contexts;     /**< Run context of each graph run by the session */
+    uint64_t threads;              /**< Maximum number of threads of the parallel kernels, 0 for every online CPU */
+    TBThreadPool* pool;            /**< Worker threads of the parallel kernels */
+    TBPackedWeights_Vec packs;     /**< Packed constant DOT product operands */
+    struct TBProfiler* profiler;   /**< Per-node profiler, NULL when profiling is disabled */
+    struct TBSessionMemory* memory; /**< Tensor memory accounting, NULL when disabled */
+    pthread_mutex_t lock;          /**< Protects the contexts and the pack cache of the session */
 }TBGraphSession;
 
+/**
+ * \brief Scratch memory of the kernels of a prepared run, sized when planning. Steps run one after the other and each
+ * one takes its scratch from the beginning of the buffer.
+ */
+typedef struct TBWorkspace {
+    uint8_t* data;             /**< Buffer, NULL when no step needs scratch */
+    uint64_t size;             /**< Bytes of `data` */
+    uint64_t used;             /**< Bytes handed out to the running step */
+}TBWorkspace;
+
+/**
+ * \brief Single node evaluation of a prepared run
+ */
+typedef struct TBPreparedStep {
+    TBNode* node;              /**< Evaluated node, a variable node for bound inputs */
+    uint64_t lhs;              /**< Step index of the left-hand side (or only) operand */
+    uint64_t rhs;              /**< Step index of the right-hand side operand */
+    uint64_t aux;              /**< Step index of a third operand, TB_NO_SLOT when unused */
+    struct NDArray* value;     /**< Value of the node */
+    uint8_t owned;             /**< Boolean flag indicating whether `value` is allocated by the run */
+    uint8_t view;              /**< Boolean flag, true if `value` reads the data of its operand through strides */
+    TBPackedWeights* packs;    /**< Packs of the constant RHS of a DOT product or convolution, resolved when planning */
+}TBPreparedStep;
+
+/**
+ * \brief Graph execution plan with pre-bound inputs and output
+ */
+typedef struct TBPreparedRun {
+    TBGraphSession* session;   /**< Session running the graph */
+    TBGraph* graph;            /**< Prepared graph */
+    
+    TBPreparedStep* steps;     /**< Steps in execution order, operands come before the nodes using them */
+    uint64_t steps_len;        /**< Number of steps */
+    uint64_t steps_cap;        /**< Capacity of the steps array */
+    uint64_t root;             /**< Step index of the graph output */
+    
+    struct NDArray** inputs;   /**< Tensor bound to each variable slot, NULL when not bound */
+    uint64_t inputs_len;       /**< Number of variable slots */
+    struct NDArray* output;    /**< Caller-owned output, NULL if the output is owned by the run */
+    
+    TBWorkspace workspace;     /**< Scratch memory of the steps */
+    
+    uint8_t planned;           /**< Boolean flag, false when steps must be planned before the next run */
+    TBResultNode result;       /**< Result returned by every run */
+}TBPreparedRun;
+
+/**
+ * \brief Returns the run context of a graph within a session, created on first use.
+ * Runs without session use the contexts of a session shared by the process, the graph itself is never modified.
+ * \param[in/out] session Session, can be NULL
+ * \param[in/out] graph Compiled graph
+ * \return run context
+ */
+TBRunContext* _tb_sessionContext(TBGraphSession* session, TBGraph* graph);
+
+/**
+ * \brief Frees the context of a graph run without session, called when the graph is freed
+ * \param[in] graph Graph
+ */
+void _tb_releaseGraphContext(TBGraph* graph);
+
+/**
+ * \brief Creates an empty run context
+ * \param[in] graph Compiled graph
+ * \return new run context, must be freed using `_tb_freeContext`
+ */
+TBRunContext* _tb_newContext(TBGraph* graph);
+
+/**
+ * \brief Frees a run context and the results and derivatives it holds
+ * \param[in/out] ctx Run context
+ */
+void _tb_freeContext(TBRunContext* ctx);
+
+/**
+ * \brief Returns the state of a node within a run context, created on first use
+ * \param[in/out] ctx Run context
+ * \param[in] node Node
+ * \return node state, its address is stable for the lifetime of the context
+ */
+TBContextEntry* _tb_contextEntry(TBRunContext* ctx, TBNode* node);
+
+/**
+ * \brief Resolves a variable node into the node bound to it for the run
+ * \param[in] ctx Run context
+ * \param[in] node Variable node
+ * \return bound node, NULL if the variable is not bound
+ */
+TBNode* _tb_contextResolveVar(TBRunContext* ctx, TBNode* node);
+
 #endif
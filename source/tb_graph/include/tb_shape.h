@@ -0,0 +1,329 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file tb_shape.h
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing output shape computation of graph operations.
+ *
+ * Shapes are computed without touching the data, which allows buffers to be allocated
+ * before running a graph and shape errors to be reported before any computation.
+ *
+ * Dimensions unknown until the graph is run (e.g the batch size) can be left symbolic, see `TB_SYMBOLIC_DIM`.
+ * Symbolic dimensions flow through the operations like any other, two symbolic dimensions are equal when they
+ * carry the same symbol. Strides and raw length of shapes holding symbolic dimensions are meaningless.
+ */
+
+#ifndef _TB_SHAPE_H_
+#define _TB_SHAPE_H_
+
+#include <stdint.h>
+
+#include <ndarray.h>
+#include <tb_graph.h>
+#include <tb_errors.h>
+#include <tb_operation.h>
+
+/**
+ * \brief Flag of symbolic dimensions
+ */
+#define TB_DIM_SYMBOLIC ((uint64_t)1 << 62)
+
+/**
+ * \brief Symbolic dimension number `k`, resolved by `tb_concreteShape`
+ */
+#define TB_SYMBOLIC_DIM(k) (TB_DIM_SYMBOLIC | (uint64_t)(k))
+
+/**
+ * \brief Symbolic batch dimension, i.e symbol 0
+ */
+#define TB_DIM_BATCH TB_SYMBOLIC_DIM(0)
+
+/**
+ * \brief Checks whether a dimension is symbolic
+ */
+#define TB_IS_SYMBOLIC_DIM(d) (((d) & TB_DIM_SYMBOLIC) != 0)
+
+/**
+ * \brief Inferred output of a node
+ */
+typedef struct TBNodeShape {
+    TBNode* node;                  /**< Node, the root of a nested graph stands for its graph node */
+    TBGraph* graph;                /**< Graph holding the node, nested graphs have their own */
+    struct NDShape* shape;         /**< Output shape, may hold symbolic dimensions */
+    NDDType dtype;                 /**< Output dtype */
+    uint64_t lhs;                  /**< Index of the first operand, TB_NO_SLOT if none */
+    uint64_t rhs;                  /**< Index of the second operand, TB_NO_SLOT if none */
+    uint64_t aux;                  /**< Index of the third operand, TB_NO_SLOT if none */
+}TBNodeShape;
+
+/**
+ * \brief Output shapes of the nodes of a graph
+ */
+typedef struct TBGraphShapes {
+    TBGraph* graph;                /**< Inferred graph */
+    TBNodeShape* nodes;            /**< Nodes in execution order, operands come first and shared nodes appear once */
+    uint64_t nodes_len;            /**< Number of nodes */
+    uint64_t nodes_cap;            /**< Capacity of the nodes array */
+    uint64_t* index;               /**< Index in `nodes` of each node of the graph by id, TB_NO_SLOT if not reached */
+    uint64_t root;                 /**< Index of the graph output, TB_NO_SLOT on error */
+    TBError* error;                /**< First shape error, NULL on success */
+}TBGraphShapes;
+
+/**
+ * \brief Computes the output shape of a binary operation. Element-wise operations follow numpy broadcasting
+ * rules, DOT follows the matrix product rules where a LHS vector is treated as a row vector.
+ * \param[in] type Binary operation type
+ * \param[in] lhs Shape of the left-hand side operand
+ * \param[in] rhs Shape of the right-hand side operand
+ * \param[out] error Set to a newly allocated error if the shapes are incompatible, can be NULL
+ * \return new allocated shape, NULL in case of error
+ */
+struct NDShape* tb_binaryOpShape(TBBinaryOperationType type, struct NDShape* lhs, struct NDShape* rhs, TBError** error);
+
+/**
+ * \brief Computes the output shape of an unary operation, i.e a copy of the operand shape
+ * \param[in] type Unary operation type
+ * \param[in] uhs Shape of the operand
+ * \param[out] error Set to a newly allocated error in case of failure, can be NULL
+ * \return new allocated shape, NULL in case of error
+ */
+struct NDShape* tb_unaryOpShape(TBUnaryOperationType type, struct NDShape* uhs, TBError** error);
+
+/**
+ * \brief Computes the output shape of an axis-bound operation. Reductions drop the axis (a vector is
+ * reduced into a shape of (1)), while SOFTMAX and LOG_SOFTMAX keep the shape of their operand.
+ * \param[in] abop Axis-bound operation node
+ * \param[in] uhs Shape of the operand
+ * \param[out] error Set to a newly allocated error in case of failure, can be NULL
+ * \return new allocated shape, NULL in case of error
+ */
+struct NDShape* tb_axisBoundOpShape(TBAxisBoundOperation* abop, struct NDShape* uhs, TBError** error);
+
+/**
+ * \brief Computes the row-major output shape of a transposition, a vector is treated as a (1, n) matrix
+ * \param[in] top Transpose operation node
+ * \param[in] uhs Shape of the operand
+ * \param[out] error Set to a newly allocated error in case of failure, can be NULL
+ * \return new allocated shape, NULL in case of error
+ */
+struct NDShape* tb_transposeOpShape(TBTransposeOperation* top, struct NDShape* uhs, TBError** error);
+
+/**
+ * \brief Computes the output shape of a quantization, i.e a copy of the operand shape
+ * \param[in] qop Quantization operation node
+ * \param[in] uhs Shape of the operand
+ * \param[out] error Set to a newly allocated error in case of failure, can be NULL
+ * \return new allocated shape, NULL in case of error
+ */
+struct NDShape* tb_quantizationOpShape(TBQuantizationOperation* qop, struct NDShape* uhs, TBError** error);
+
+/**
+ * \brief Computes the output shape of a gather, i.e the indices dimensions followed by the table dimensions but the first
+ * \param[in] gop Gather operation node
+ * \param[in] table Shape of the table
+ * \param[in] indices Shape of the indices
+ * \param[out] error Set to a newly allocated error in case of failure, can be NULL
+ * \return new allocated shape, NULL in case of error
+ */
+struct NDShape* tb_gatherOpShape(TBGatherOperation* gop, struct NDShape* table, struct NDShape* indices, TBError** error);
+
+/**
+ * \brief Computes the output shape of a cross-entropy, i.e the shape of the logits reduced over the classes axis
+ * \param[in] ceop Cross-entropy operation node
+ * \param[in] logits Shape of the logits
+ * \param[in] labels Shape of the labels, either the output shape or the shape of the logits
+ * \param[out] error Set to a newly allocated error in case of failure, can be NULL
+ * \return new allocated shape, NULL in case of error
+ */
+struct NDShape* tb_crossEntropyOpShape(TBCrossEntropyOperation* ceop, struct NDShape* logits, struct NDShape* labels, TBError** error);
+
+/**
+ * \brief Computes the output shape of a normalization, i.e a copy of the operand shape. LAYER gamma and beta must
+ * hold as many values as the dimensions from the axis on, BATCH gamma and beta one value per channel.
+ * \param[in] nop Normalization operation node
+ * \param[in] uhs Shape of the operand
+ * \param[in] gamma Shape of the scale, NULL if there is none
+ * \param[in] beta Shape of the shift, NULL if there is none
+ * \param[out] error Set to a newly allocated error in case of failure, can be NULL
+ * \return new allocated shape, NULL in case of error
+ */
+struct NDShape* tb_normalizationOpShape(TBNormalizationOperation* nop, struct NDShape* uhs, struct NDShape* gamma, struct NDShape* beta, TBError** error);
+
+/**
+ * \brief Computes the output shape of a 2-D convolution, (N, CO, OH, OW), (N, OH, OW, CO) or (N, CO/c, OH, OW, c) with
+ * OH = (H + 2*padding - dilation*(KH - 1) - 1)/stride + 1 and likewise for OW
+ * \param[in] cop Convolution operation node
+ * \param[in] uhs Shape of the input
+ * \param[in] weights Shape of the OIHW weights
+ * \param[out] error Set to a newly allocated error in case of failure, can be NULL
+ * \return new allocated shape, NULL in case of error
+ */
+struct NDShape* tb_convolutionOpShape(TBConvolutionOperation* cop, struct NDShape* uhs, struct NDShape* weights, TBError** error);
+
+/**
+ * \brief Computes the output shape of a 2-D pooling, OH = (H + 2*padding - window)/stride + 1 and likewise for OW,
+ * global poolings output a single pixel per channel
+ * \param[in] pop Pooling operation node
+ * \param[in] uhs Shape of the input
+ * \param[out] error Set to a newly allocated error in case of failure, can be NULL
+ * \return new allocated shape, NULL in case of error
+ */
+struct NDShape* tb_poolingOpShape(TBPoolingOperation* pop, struct NDShape* uhs, TBError** error);
+
+/**
+ * \brief Computes the output shape of a layout reorder, blocked layouts need a multiple of the block of channels
+ * \param[in] rop Reorder operation node
+ * \param[in] uhs Shape of the input
+ * \param[out] error Set to a newly allocated error in case of failure, can be NULL
+ * \return new allocated shape, NULL in case of error
+ */
+struct NDShape* tb_reorderOpShape(TBReorderOperation* rop, struct NDShape* uhs, TBError** error);
+
+/**
+ * \brief Computes the output dtype of a binary operation. ADD, SUB and MULT of two I32 or two I64 operands
+ * stay integer, every other combination is floating point: F64 when an operand is F64, tb_float otherwise.
+ * \param[in] type Binary operation type
+ * \param[in] lhs dtype of the left-hand side operand
+ * \param[in] rhs dtype of the right-hand side operand
+ * \return output dtype
+ */
+NDDType tb_binaryOpDType(TBBinaryOperationType type, NDDType lhs, NDDType rhs);
+
+/**
+ * \brief Computes the output dtype of an unary operation, MINUS keeps I32 and I64 operands integer,
+ * every other operation outputs F64 for an F64 operand and tb_float otherwise.
+ * \param[in] type Unary operation type
+ * \param[in] uhs dtype of the operand
+ * \return output dtype
+ */
+NDDType tb_unaryOpDType(TBUnaryOperationType type, NDDType uhs);
+
+/**
+ * \brief Computes the output dtype of an axis-bound operation, ARGMIN and ARGMAX output I64 indices,
+ * every other operation outputs F64 for an F64 operand and tb_float otherwise.
+ * \param[in] abop Axis-bound operation node
+ * \param[in] uhs dtype of the operand
+ * \return output dtype
+ */
+NDDType tb_axisBoundOpDType(TBAxisBoundOperation* abop, NDDType uhs);
+
+/**
+ * \brief Computes the output dtype of a quantization, QUANTIZE outputs the dtype of the node and
+ * DEQUANTIZE outputs tb_float.
+ * \param[in] qop Quantization operation node
+ * \param[in] uhs dtype of the operand
+ * \return output dtype
+ */
+NDDType tb_quantizationOpDType(TBQuantizationOperation* qop, NDDType uhs);
+
+/**
+ * \brief Computes the output dtype of a gather, rows are moved without conversion so the output keeps the dtype of the table
+ * \param[in] gop Gather operation node
+ * \param[in] table dtype of the table
+ * \return output dtype
+ */
+NDDType tb_gatherOpDType(TBGatherOperation* gop, NDDType table);
+
+/**
+ * \brief Checks whether two shapes have the same dimensions, strides are ignored.
+ * \param[in] shape1 First shape
+ * \param[in] shape2 Second shape
+ * \return true if both shapes have the same rank and dimensions
+ */
+uint8_t tb_shapeEquals(struct NDShape* shape1, struct NDShape* shape2);
+
+/**
+ * \brief Checks whether a shape holds symbolic dimensions
+ * \param[in] shape Shape
+ * \return true if at least one dimension is symbolic
+ */
+uint8_t tb_shapeIsSymbolic(struct NDShape* shape);
+
+/**
+ * \brief Resolves the symbolic dimensions of a shape, e.g once the batch size is known
+ * \param[in] shape Shape
+ * \param[in] symbols Value of each symbol, indexed by symbol number
+ * \param[in] symbols_len Number of symbols
+ * \return new allocated shape, NULL if the shape uses a symbol without value
+ */
+struct NDShape* tb_concreteShape(struct NDShape* shape, uint64_t* symbols, uint64_t symbols_len);
+
+/**
+ * \brief Infers the output shape and dtype of every node of a graph from the shapes of its inputs, without running
+ * it. Inputs are tb_float tensors, variables without input shape are resolved through the nodes bound to them,
+ * like in `tb_runSession`. Errors (e.g shapes which cannot be broadcast) are reported on the faulty node.
+ * \param[in/out] graph Graph, compiled if needed
+ * \param[in] inputs Shape of each variable slot (see `tb_graphGetVarSlot`), may hold symbolic dimensions. NULL
+ * entries (or a NULL array) for bound variables.
+ * \return new inferred shapes, must be freed using `tb_freeGraphShapes`. On error the nodes inferred so far are kept.
+ */
+TBGraphShapes* tb_inferShapes(TBGraph* graph, struct NDShape** inputs);
+
+/**
+ * \brief Infers the shapes of a graph (see `tb_inferShapes`) and caches them in the graph, replacing the previous ones
+ * \param[in/out] graph Graph
+ * \param[in] inputs Shape of each variable slot, NULL entries (or a NULL array) for bound variables
+ * \return error of the inference, owned by the cache. NULL on success.
+ */
+TBError* tb_inferGraphShapes(TBGraph* graph, struct NDShape** inputs);
+
+/**
+ * \brief Returns the inferred output shape of a node, O(1) for nodes of the inferred graph
+ * \param[in] shapes Inferred shapes
+ * \param[in] node Node
+ * \return shape owned by `shapes`, NULL if no shape was inferred for the node
+ */
+struct NDShape* tb_inferredNodeShape(TBGraphShapes* shapes, TBNode* node);
+
+/**
+ * \brief Returns the cached output shape of a node, O(1) for nodes of the graph
+ * \param[in] graph Graph whose shapes were inferred by `tb_inferGraphShapes`
+ * \param[in] node Node
+ * \return shape owned by the cache, NULL if no shape was inferred for the node
+ */
+struct NDShape* tb_graphNodeShape(TBGraph* graph, TBNode* node);
+
+/**
+ * \brief Frees inferred shapes
+ * \param[in/out] shapes Inferred shapes
+ */
+void tb_freeGraphShapes(TBGraphShapes* shapes);
+
+#endif
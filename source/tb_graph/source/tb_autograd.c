@@ -53,11 +53,22 @@
 #include <tb_graph.h>
 #include <tb_factory.h>
 #include <tb_operation.h>
+#include <tb_session_cpu.h>
+#include <tb_ops.h>
+#include <tb_memory.h>
 
-
-static void _tb_freeNodeDiff(TBNode* node){
-    tb_freeResultNode(NULL, node->diff);
-    free(node->diff);
+/*
+ * Results and derivatives are kept by the run context of the session, `ctx` must be in scope
+ */
+#define RESULT(node) (_tb_contextEntry(ctx, node)->result)
+#define DIFF(node) (_tb_contextEntry(ctx, node)->diff)
+
+static void _tb_freeNodeDiff(TBRunContext* ctx, TBNode* node){
+    if(DIFF(node) != NULL){
+        tb_freeResultNode(NULL, DIFF(node));
+        free(DIFF(node));
+        DIFF(node) = NULL;
+    }
 }
 
 static TBNode* _tb_adaptDiffToShape(TBNode* diff_node, NDShape* diffShape, NDShape* valueShape){
@@ -92,158 +103,163 @@ static TBResultNode* _tb_convertNodetoResultNode(TBNode* res){
 }
 
 static void _tb_autograd_bop_add(struct TBGraphSession* session, TBGraph* graph, TBNode* node, TBBinaryOperation* bop){
-    NDShape* lhsDiffShape = bop->lhs->diff->value->shape;
-    NDShape* rhsDiffShape = bop->rhs->diff->value->shape;
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    NDShape* lhsDiffShape = DIFF(bop->lhs)->value->shape;
+    NDShape* rhsDiffShape = DIFF(bop->rhs)->value->shape;
     
     TBNode* mult1 = tb_newBinaryOpNode(TBBOT_ADD,
-                                       _tb_convertResultNodeToNode(bop->lhs->diff),
-                                       _tb_convertResultNodeToNode(node->diff)
+                                       _tb_convertResultNodeToNode(DIFF(bop->lhs)),
+                                       _tb_convertResultNodeToNode(DIFF(node))
                                        );
     
-    mult1 = _tb_adaptDiffToShape(mult1, lhsDiffShape, node->result->value->shape);
+    mult1 = _tb_adaptDiffToShape(mult1, lhsDiffShape, RESULT(node)->value->shape);
     TBResultNode* res1 = tb_runSessionNodeOnly(session, mult1);
-    _tb_freeNodeDiff(bop->lhs);
-    nda_reshape(res1->value, nda_copyShape(bop->lhs->result->value->shape));
-    bop->lhs->diff = (res1);
+    _tb_freeNodeDiff(ctx, bop->lhs);
+    nda_reshape(res1->value, nda_copyShape(RESULT(bop->lhs)->value->shape));
+    DIFF(bop->lhs) = (res1);
     
     TBNode* mult2 = tb_newBinaryOpNode(TBBOT_ADD,
-                                       _tb_convertResultNodeToNode(bop->rhs->diff),
-                                       _tb_convertResultNodeToNode(node->diff)
+                                       _tb_convertResultNodeToNode(DIFF(bop->rhs)),
+                                       _tb_convertResultNodeToNode(DIFF(node))
                                        );
     
-    mult2 = _tb_adaptDiffToShape(mult2, rhsDiffShape, node->result->value->shape);
+    mult2 = _tb_adaptDiffToShape(mult2, rhsDiffShape, RESULT(node)->value->shape);
     
     TBResultNode* res2 = tb_runSessionNodeOnly(session, mult2);
-    _tb_freeNodeDiff(bop->rhs);
-    nda_reshape(res2->value, nda_copyShape(bop->rhs->result->value->shape));
-    bop->rhs->diff = (res2);
+    _tb_freeNodeDiff(ctx, bop->rhs);
+    nda_reshape(res2->value, nda_copyShape(RESULT(bop->rhs)->value->shape));
+    DIFF(bop->rhs) = (res2);
 }
 
 
 static void _tb_autograd_bop_sub(struct TBGraphSession* session, TBGraph* graph, TBNode* node, TBBinaryOperation* bop){
-    NDShape* lhsDiffShape = bop->lhs->diff->value->shape;
-    NDShape* rhsDiffShape = bop->rhs->diff->value->shape;
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    NDShape* lhsDiffShape = DIFF(bop->lhs)->value->shape;
+    NDShape* rhsDiffShape = DIFF(bop->rhs)->value->shape;
     
     TBNode* mult1 = tb_newBinaryOpNode(TBBOT_ADD,
-                                       _tb_convertResultNodeToNode(bop->lhs->diff),
-                                       _tb_convertResultNodeToNode(node->diff)
+                                       _tb_convertResultNodeToNode(DIFF(bop->lhs)),
+                                       _tb_convertResultNodeToNode(DIFF(node))
                                        );
     
-    mult1 = _tb_adaptDiffToShape(mult1, lhsDiffShape, node->result->value->shape);
+    mult1 = _tb_adaptDiffToShape(mult1, lhsDiffShape, RESULT(node)->value->shape);
     TBResultNode* res1 = tb_runSessionNodeOnly(session, mult1);
-    _tb_freeNodeDiff(bop->lhs);
-    nda_reshape(res1->value, nda_copyShape(bop->lhs->result->value->shape));
-    bop->lhs->diff = (res1);
+    _tb_freeNodeDiff(ctx, bop->lhs);
+    nda_reshape(res1->value, nda_copyShape(RESULT(bop->lhs)->value->shape));
+    DIFF(bop->lhs) = (res1);
     
     TBNode* mult2 = tb_newBinaryOpNode(TBBOT_ADD,
-                                       _tb_convertResultNodeToNode(bop->rhs->diff),
+                                       _tb_convertResultNodeToNode(DIFF(bop->rhs)),
                                        tb_newUnaryOpNode(TBUOT_MINUS,
-                                                         _tb_convertResultNodeToNode(node->diff)
+                                                         _tb_convertResultNodeToNode(DIFF(node))
                                                          )
                                        );
     
-    mult2 = _tb_adaptDiffToShape(mult2, rhsDiffShape, node->result->value->shape);
+    mult2 = _tb_adaptDiffToShape(mult2, rhsDiffShape, RESULT(node)->value->shape);
     
     TBResultNode* res2 = tb_runSessionNodeOnly(session, mult2);
-    nda_reshape(res2->value, nda_copyShape(bop->rhs->result->value->shape));
-    _tb_freeNodeDiff(bop->rhs);
-    bop->rhs->diff = (res2);
+    nda_reshape(res2->value, nda_copyShape(RESULT(bop->rhs)->value->shape));
+    _tb_freeNodeDiff(ctx, bop->rhs);
+    DIFF(bop->rhs) = (res2);
 }
 
 static void _tb_autograd_bop_mult(struct TBGraphSession* session, TBGraph* graph, TBNode* node, TBBinaryOperation* bop){
-    NDShape* lhsDiffShape = bop->lhs->diff->value->shape;
-    NDShape* rhsDiffShape = bop->rhs->diff->value->shape;
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    NDShape* lhsDiffShape = DIFF(bop->lhs)->value->shape;
+    NDShape* rhsDiffShape = DIFF(bop->rhs)->value->shape;
     
     TBNode* mult1 = tb_newBinaryOpNode(TBBOT_ADD,
-                                       _tb_convertResultNodeToNode(bop->lhs->diff),
+                                       _tb_convertResultNodeToNode(DIFF(bop->lhs)),
                                        tb_newBinaryOpNode(TBBOT_MULT,
-                                                          _tb_convertResultNodeToNode(node->diff),
-                                                          _tb_convertResultNodeToNode(bop->rhs->result)
+                                                          _tb_convertResultNodeToNode(DIFF(node)),
+                                                          _tb_convertResultNodeToNode(RESULT(bop->rhs))
                                                           )
                                        );
     
-    mult1 = _tb_adaptDiffToShape(mult1, lhsDiffShape, node->result->value->shape);
+    mult1 = _tb_adaptDiffToShape(mult1, lhsDiffShape, RESULT(node)->value->shape);
     TBResultNode* res1 = tb_runSessionNodeOnly(session, mult1);
-    nda_reshape(res1->value, nda_copyShape(bop->lhs->result->value->shape));
-    _tb_freeNodeDiff(bop->lhs);
-    bop->lhs->diff = (res1);
+    nda_reshape(res1->value, nda_copyShape(RESULT(bop->lhs)->value->shape));
+    _tb_freeNodeDiff(ctx, bop->lhs);
+    DIFF(bop->lhs) = (res1);
     
     TBNode* mult2 = tb_newBinaryOpNode(TBBOT_ADD,
-                                       _tb_convertResultNodeToNode(bop->rhs->diff),
+                                       _tb_convertResultNodeToNode(DIFF(bop->rhs)),
                                        tb_newBinaryOpNode(TBBOT_MULT,
-                                                          _tb_convertResultNodeToNode(node->diff),
-                                                          _tb_convertResultNodeToNode(bop->lhs->result)
+                                                          _tb_convertResultNodeToNode(DIFF(node)),
+                                                          _tb_convertResultNodeToNode(RESULT(bop->lhs))
                                                           )
                                        );
     
-    mult2 = _tb_adaptDiffToShape(mult2, rhsDiffShape, node->result->value->shape);
+    mult2 = _tb_adaptDiffToShape(mult2, rhsDiffShape, RESULT(node)->value->shape);
     
     TBResultNode* res2 = tb_runSessionNodeOnly(session, mult2);
-    nda_reshape(res2->value, nda_copyShape(bop->rhs->result->value->shape));
-    _tb_freeNodeDiff(bop->rhs);
-    bop->rhs->diff = (res2);
+    nda_reshape(res2->value, nda_copyShape(RESULT(bop->rhs)->value->shape));
+    _tb_freeNodeDiff(ctx, bop->rhs);
+    DIFF(bop->rhs) = (res2);
 }
 
 static void _tb_autograd_bop_div(struct TBGraphSession* session, TBGraph* graph, TBNode* node, TBBinaryOperation* bop){
-    NDShape* lhsDiffShape = bop->lhs->diff->value->shape;
-    NDShape* rhsDiffShape = bop->rhs->diff->value->shape;
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    NDShape* lhsDiffShape = DIFF(bop->lhs)->value->shape;
+    NDShape* rhsDiffShape = DIFF(bop->rhs)->value->shape;
     
     TBNode* mult1 = tb_newBinaryOpNode(TBBOT_ADD,
-                                       _tb_convertResultNodeToNode(bop->lhs->diff),
+                                       _tb_convertResultNodeToNode(DIFF(bop->lhs)),
                                        tb_newBinaryOpNode(TBBOT_MULT,
-                                                          _tb_convertResultNodeToNode(node->diff),
+                                                          _tb_convertResultNodeToNode(DIFF(node)),
                                                           tb_newBinaryOpNode(TBBOT_DIV,
                                                                              tb_newConstantNode(nda_ones(nda_newShape(1, 1))),
-                                                                             _tb_convertResultNodeToNode(bop->rhs->result)
+                                                                             _tb_convertResultNodeToNode(RESULT(bop->rhs))
                                                                              )
                                                           )
                                        );
     
-    mult1 = _tb_adaptDiffToShape(mult1, lhsDiffShape, node->result->value->shape);
+    mult1 = _tb_adaptDiffToShape(mult1, lhsDiffShape, RESULT(node)->value->shape);
     TBResultNode* res1 = tb_runSessionNodeOnly(session, mult1);
-    nda_reshape(res1->value, nda_copyShape(bop->lhs->result->value->shape));
-    _tb_freeNodeDiff(bop->lhs);
-    bop->lhs->diff = (res1);
+    nda_reshape(res1->value, nda_copyShape(RESULT(bop->lhs)->value->shape));
+    _tb_freeNodeDiff(ctx, bop->lhs);
+    DIFF(bop->lhs) = (res1);
     
     TBNode* mult2 = tb_newBinaryOpNode(TBBOT_ADD,
-                                       _tb_convertResultNodeToNode(bop->rhs->diff),
+                                       _tb_convertResultNodeToNode(DIFF(bop->rhs)),
                                        tb_newBinaryOpNode(TBBOT_MULT,
                                                           tb_newUnaryOpNode(TBUOT_MINUS,
                                                                             tb_newBinaryOpNode(TBBOT_DIV,
-                                                                                               _tb_convertResultNodeToNode(bop->lhs->result),
+                                                                                               _tb_convertResultNodeToNode(RESULT(bop->lhs)),
                                                                                                tb_newBinaryOpNode(TBBOT_POW,
-                                                                                                                  _tb_convertResultNodeToNode(bop->rhs->result),
+                                                                                                                  _tb_convertResultNodeToNode(RESULT(bop->rhs)),
                                                                                                                   tb_newConstantNode(nda_fill(nda_newShape(1, 1), 2))
                                                                                                                   )
                                                                                                )
                                                                             ),
-                                                          _tb_convertResultNodeToNode(node->diff)
+                                                          _tb_convertResultNodeToNode(DIFF(node))
                                                           )
                                        );
     
-    mult2 = _tb_adaptDiffToShape(mult2, rhsDiffShape, node->result->value->shape);
+    mult2 = _tb_adaptDiffToShape(mult2, rhsDiffShape, RESULT(node)->value->shape);
     
     TBResultNode* res2 = tb_runSessionNodeOnly(session, mult2);
-    nda_reshape(res2->value, nda_copyShape(bop->rhs->result->value->shape));
-    _tb_freeNodeDiff(bop->rhs);
-    bop->rhs->diff = (res2);
+    nda_reshape(res2->value, nda_copyShape(RESULT(bop->rhs)->value->shape));
+    _tb_freeNodeDiff(ctx, bop->rhs);
+    DIFF(bop->rhs) = (res2);
 }
 
 
 static void _tb_autograd_bop_pow(struct TBGraphSession* session, TBGraph* graph, TBNode* node, TBBinaryOperation* bop){
-    NDShape* lhsDiffShape = bop->lhs->diff->value->shape;
-    NDShape* rhsDiffShape = bop->rhs->diff->value->shape;
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    NDShape* lhsDiffShape = DIFF(bop->lhs)->value->shape;
+    NDShape* rhsDiffShape = DIFF(bop->rhs)->value->shape;
     
     TBNode* mult1 = tb_newBinaryOpNode(TBBOT_ADD,
-                                       _tb_convertResultNodeToNode(bop->lhs->diff),
+                                       _tb_convertResultNodeToNode(DIFF(bop->lhs)),
                                        tb_newBinaryOpNode(TBBOT_MULT,
-                                                          _tb_convertResultNodeToNode(node->diff),
+                                                          _tb_convertResultNodeToNode(DIFF(node)),
                                                           tb_newBinaryOpNode(TBBOT_MULT,
-                                                                             _tb_convertResultNodeToNode(bop->rhs->result),
+                                                                             _tb_convertResultNodeToNode(RESULT(bop->rhs)),
                                                                              tb_newBinaryOpNode(TBBOT_POW,
-                                                                                                _tb_convertResultNodeToNode(bop->lhs->result),
+                                                                                                _tb_convertResultNodeToNode(RESULT(bop->lhs)),
                                                                                                 tb_newBinaryOpNode(TBBOT_SUB,
-                                                                                                                   _tb_convertResultNodeToNode(bop->rhs->result),
+                                                                                                                   _tb_convertResultNodeToNode(RESULT(bop->rhs)),
                                                                                                                    tb_newConstantNode(nda_ones(nda_newShape(1, 1)))
                                                                                                                    )
                                                                                                 )
@@ -251,304 +267,398 @@ static void _tb_autograd_bop_pow(struct TBGraphSession* session, TBGraph* graph,
                                                           )
                                        );
     
-    mult1 = _tb_adaptDiffToShape(mult1, lhsDiffShape, node->result->value->shape);
+    mult1 = _tb_adaptDiffToShape(mult1, lhsDiffShape, RESULT(node)->value->shape);
     TBResultNode* res1 = tb_runSessionNodeOnly(session, mult1);
-    nda_reshape(res1->value, nda_copyShape(bop->lhs->result->value->shape));
-    _tb_freeNodeDiff(bop->lhs);
-    bop->lhs->diff = (res1);
+    nda_reshape(res1->value, nda_copyShape(RESULT(bop->lhs)->value->shape));
+    _tb_freeNodeDiff(ctx, bop->lhs);
+    DIFF(bop->lhs) = (res1);
     
     TBNode* mult2 = tb_newBinaryOpNode(TBBOT_ADD,
-                                       _tb_convertResultNodeToNode(bop->rhs->diff),
+                                       _tb_convertResultNodeToNode(DIFF(bop->rhs)),
                                        tb_newBinaryOpNode(TBBOT_MULT,
-                                                          _tb_convertResultNodeToNode(node->diff),
+                                                          _tb_convertResultNodeToNode(DIFF(node)),
                                                           tb_newBinaryOpNode(TBBOT_MULT,
-                                                                             _tb_convertResultNodeToNode(node->result),
+                                                                             _tb_convertResultNodeToNode(RESULT(node)),
                                                                              tb_newUnaryOpNode(TBUOT_LOG,
-                                                                                               _tb_convertResultNodeToNode(bop->lhs->result)
+                                                                                               _tb_convertResultNodeToNode(RESULT(bop->lhs))
                                                                                                )
                                                                              )
                                                           )
                                        );
     
-    mult2 = _tb_adaptDiffToShape(mult2, rhsDiffShape, node->result->value->shape);
+    mult2 = _tb_adaptDiffToShape(mult2, rhsDiffShape, RESULT(node)->value->shape);
     
     TBResultNode* res2 = tb_runSessionNodeOnly(session, mult2);
-    nda_reshape(res2->value, nda_copyShape(bop->rhs->result->value->shape));
-    _tb_freeNodeDiff(bop->rhs);
-    bop->rhs->diff = (res2);
+    nda_reshape(res2->value, nda_copyShape(RESULT(bop->rhs)->value->shape));
+    _tb_freeNodeDiff(ctx, bop->rhs);
+    DIFF(bop->rhs) = (res2);
 }
 
 static void _tb_autograd_bop_dot(struct TBGraphSession* session, TBGraph* graph, TBNode* node, TBBinaryOperation* bop){
-    NDShape* lhsDiffShape = bop->lhs->diff->value->shape;
-    NDShape* rhsDiffShape = bop->rhs->diff->value->shape;
-   
-    TBNode* mult1 = tb_newBinaryOpNode(TBBOT_ADD,
-                                       _tb_convertResultNodeToNode(bop->lhs->diff),
-                                       tb_newBinaryOpNode(TBBOT_DOT,
-                                                          _tb_convertResultNodeToNode(node->diff),
-                                                          tb_newTransposeOpNode(_tb_convertResultNodeToNode(bop->rhs->result), 1, 0)
-                                                          )
-                                       );
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    NDShape* lhsDiffShape = DIFF(bop->lhs)->value->shape;
+    NDShape* rhsDiffShape = DIFF(bop->rhs)->value->shape;
     
-    mult1 = _tb_adaptDiffToShape(mult1, lhsDiffShape, node->result->value->shape);
-    TBResultNode* res1 = tb_runSessionNodeOnly(session, mult1);
-    nda_reshape(res1->value, nda_copyShape(bop->lhs->result->value->shape));
-    _tb_freeNodeDiff(bop->lhs);
-    bop->lhs->diff = (res1);
+    // a sparse LHS gets a sparse gradient, only computed at its stored positions
+    if(nda_isSparse(DIFF(bop->lhs)->value)){
+        _tb_sparseMaskedDotAccumulate(session, DIFF(bop->lhs)->value, DIFF(node)->value, RESULT(bop->rhs)->value);
+    }
+    else{
+        TBNode* mult1 = tb_newBinaryOpNode(TBBOT_ADD,
+                                           _tb_convertResultNodeToNode(DIFF(bop->lhs)),
+                                           tb_newBinaryOpNode(TBBOT_DOT,
+                                                              _tb_convertResultNodeToNode(DIFF(node)),
+                                                              tb_newTransposeOpNode(_tb_convertResultNodeToNode(RESULT(bop->rhs)), 1, 0)
+                                                              )
+                                           );
+        
+        mult1 = _tb_adaptDiffToShape(mult1, lhsDiffShape, RESULT(node)->value->shape);
+        TBResultNode* res1 = tb_runSessionNodeOnly(session, mult1);
+        nda_reshape(res1->value, nda_copyShape(RESULT(bop->lhs)->value->shape));
+        _tb_freeNodeDiff(ctx, bop->lhs);
+        DIFF(bop->lhs) = (res1);
+    }
     
     TBNode* mult2 = tb_newBinaryOpNode(TBBOT_ADD,
-                                       _tb_convertResultNodeToNode(bop->rhs->diff),
+                                       _tb_convertResultNodeToNode(DIFF(bop->rhs)),
                                        tb_newBinaryOpNode(TBBOT_DOT,
-                                                          tb_newTransposeOpNode(_tb_convertResultNodeToNode(bop->lhs->result), 1, 0),
-                                                          _tb_convertResultNodeToNode(node->diff)
+                                                          tb_newTransposeOpNode(_tb_convertResultNodeToNode(RESULT(bop->lhs)), 1, 0),
+                                                          _tb_convertResultNodeToNode(DIFF(node))
                                                           )
                                        );
     
-    mult2 = _tb_adaptDiffToShape(mult2, rhsDiffShape, node->result->value->shape);
+    mult2 = _tb_adaptDiffToShape(mult2, rhsDiffShape, RESULT(node)->value->shape);
     
     TBResultNode* res2 = tb_runSessionNodeOnly(session, mult2);
-    nda_reshape(res2->value, nda_copyShape(bop->rhs->result->value->shape));
-    _tb_freeNodeDiff(bop->rhs);
-    bop->rhs->diff = (res2);
+    nda_reshape(res2->value, nda_copyShape(RESULT(bop->rhs)->value->shape));
+    _tb_freeNodeDiff(ctx, bop->rhs);
+    DIFF(bop->rhs) = (res2);
 }
 
 static void _tb_autograd_uop_minus(struct TBGraphSession* session, TBGraph* graph, TBNode* node, TBUnaryOperation* uop){
-    NDShape* uhsDiffShape = uop->uhs->diff->value->shape;
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    NDShape* uhsDiffShape = DIFF(uop->uhs)->value->shape;
     
     TBNode* mult1 = tb_newBinaryOpNode(TBBOT_ADD,
-                                       _tb_convertResultNodeToNode(uop->uhs->diff),
+                                       _tb_convertResultNodeToNode(DIFF(uop->uhs)),
                                        tb_newBinaryOpNode(TBBOT_MULT,
-                                                          _tb_convertResultNodeToNode(node->diff),
+                                                          _tb_convertResultNodeToNode(DIFF(node)),
                                                           tb_newConstantNode(nda_fill(nda_newShape(1, 1), -1.0f))
                                                           )
                                        );
     
-    mult1 = _tb_adaptDiffToShape(mult1, uhsDiffShape, node->result->value->shape);
+    mult1 = _tb_adaptDiffToShape(mult1, uhsDiffShape, RESULT(node)->value->shape);
     TBResultNode* res1 = tb_runSessionNodeOnly(session, mult1);
-    nda_reshape(res1->value, nda_copyShape(uop->uhs->result->value->shape));
-    _tb_freeNodeDiff(uop->uhs);
-    uop->uhs->diff = (res1);
+    nda_reshape(res1->value, nda_copyShape(RESULT(uop->uhs)->value->shape));
+    _tb_freeNodeDiff(ctx, uop->uhs);
+    DIFF(uop->uhs) = (res1);
 }
 
 static void _tb_autograd_uop_exp(struct TBGraphSession* session, TBGraph* graph, TBNode* node, TBUnaryOperation* uop){
-    NDShape* uhsDiffShape = uop->uhs->diff->value->shape;
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    NDShape* uhsDiffShape = DIFF(uop->uhs)->value->shape;
     
     TBNode* mult1 = tb_newBinaryOpNode(TBBOT_ADD,
-                                       _tb_convertResultNodeToNode(uop->uhs->diff),
+                                       _tb_convertResultNodeToNode(DIFF(uop->uhs)),
                                        tb_newBinaryOpNode(TBBOT_MULT,
-                                                          _tb_convertResultNodeToNode(node->diff),
-                                                          _tb_convertResultNodeToNode(node->result)
+                                                          _tb_convertResultNodeToNode(DIFF(node)),
+                                                          _tb_convertResultNodeToNode(RESULT(node))
                                                           )
                                        );
     
-    mult1 = _tb_adaptDiffToShape(mult1, uhsDiffShape, node->result->value->shape);
+    mult1 = _tb_adaptDiffToShape(mult1, uhsDiffShape, RESULT(node)->value->shape);
     TBResultNode* res1 = tb_runSessionNodeOnly(session, mult1);
-    nda_reshape(res1->value, nda_copyShape(uop->uhs->result->value->shape));
-    _tb_freeNodeDiff(uop->uhs);
-    uop->uhs->diff = (res1);
+    nda_reshape(res1->value, nda_copyShape(RESULT(uop->uhs)->value->shape));
+    _tb_freeNodeDiff(ctx, uop->uhs);
+    DIFF(uop->uhs) = (res1);
 }
 
 static void _tb_autograd_uop_log(struct TBGraphSession* session, TBGraph* graph, TBNode* node, TBUnaryOperation* uop){
-    NDShape* uhsDiffShape = uop->uhs->diff->value->shape;
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    NDShape* uhsDiffShape = DIFF(uop->uhs)->value->shape;
     
     TBNode* mult1 = tb_newBinaryOpNode(TBBOT_ADD,
-                                       _tb_convertResultNodeToNode(uop->uhs->diff),
+                                       _tb_convertResultNodeToNode(DIFF(uop->uhs)),
                                        tb_newBinaryOpNode(TBBOT_MULT,
-                                                          _tb_convertResultNodeToNode(node->diff),
+                                                          _tb_convertResultNodeToNode(DIFF(node)),
                                                           tb_newBinaryOpNode(TBBOT_DIV,
                                                                              tb_newConstantNode(nda_ones(nda_newShape(1, 1))),
-                                                                             _tb_convertResultNodeToNode(node->result))
+                                                                             _tb_convertResultNodeToNode(RESULT(node)))
                                                           )
                                        );
     
-    mult1 = _tb_adaptDiffToShape(mult1, uhsDiffShape, node->result->value->shape);
+    mult1 = _tb_adaptDiffToShape(mult1, uhsDiffShape, RESULT(node)->value->shape);
     TBResultNode* res1 = tb_runSessionNodeOnly(session, mult1);
-    nda_reshape(res1->value, nda_copyShape(uop->uhs->result->value->shape));
-    _tb_freeNodeDiff(uop->uhs);
-    uop->uhs->diff = (res1);
+    nda_reshape(res1->value, nda_copyShape(RESULT(uop->uhs)->value->shape));
+    _tb_freeNodeDiff(ctx, uop->uhs);
+    DIFF(uop->uhs) = (res1);
 }
 
 static void _tb_autograd_uop_sin(struct TBGraphSession* session, TBGraph* graph, TBNode* node, TBUnaryOperation* uop){
-    NDShape* uhsDiffShape = uop->uhs->diff->value->shape;
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    NDShape* uhsDiffShape = DIFF(uop->uhs)->value->shape;
     
     TBNode* mult1 = tb_newBinaryOpNode(TBBOT_ADD,
-                                       _tb_convertResultNodeToNode(uop->uhs->diff),
+                                       _tb_convertResultNodeToNode(DIFF(uop->uhs)),
                                        tb_newBinaryOpNode(TBBOT_MULT,
-                                                          _tb_convertResultNodeToNode(node->diff),
+                                                          _tb_convertResultNodeToNode(DIFF(node)),
                                                           tb_newUnaryOpNode(TBUOT_COS,
-                                                                             _tb_convertResultNodeToNode(uop->uhs->result))
+                                                                             _tb_convertResultNodeToNode(RESULT(uop->uhs)))
                                                           )
                                        );
     
-    mult1 = _tb_adaptDiffToShape(mult1, uhsDiffShape, node->result->value->shape);
+    mult1 = _tb_adaptDiffToShape(mult1, uhsDiffShape, RESULT(node)->value->shape);
     TBResultNode* res1 = tb_runSessionNodeOnly(session, mult1);
-    nda_reshape(res1->value, nda_copyShape(uop->uhs->result->value->shape));
-    _tb_freeNodeDiff(uop->uhs);
-    uop->uhs->diff = (res1);
+    nda_reshape(res1->value, nda_copyShape(RESULT(uop->uhs)->value->shape));
+    _tb_freeNodeDiff(ctx, uop->uhs);
+    DIFF(uop->uhs) = (res1);
 }
 
 static void _tb_autograd_uop_cos(struct TBGraphSession* session, TBGraph* graph, TBNode* node, TBUnaryOperation* uop){
-    NDShape* uhsDiffShape = uop->uhs->diff->value->shape;
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    NDShape* uhsDiffShape = DIFF(uop->uhs)->value->shape;
     
     TBNode* mult1 = tb_newBinaryOpNode(TBBOT_ADD,
-                                       _tb_convertResultNodeToNode(uop->uhs->diff),
+                                       _tb_convertResultNodeToNode(DIFF(uop->uhs)),
                                        tb_newBinaryOpNode(TBBOT_MULT,
-                                                          _tb_convertResultNodeToNode(node->diff),
+                                                          _tb_convertResultNodeToNode(DIFF(node)),
                                                           tb_newUnaryOpNode(TBUOT_MINUS,
                                                                             tb_newUnaryOpNode(TBUOT_SIN,
-                                                                                              _tb_convertResultNodeToNode(uop->uhs->result))
+                                                                                              _tb_convertResultNodeToNode(RESULT(uop->uhs)))
                                                                             )
                                                           )
                                        );
     
-    mult1 = _tb_adaptDiffToShape(mult1, uhsDiffShape, node->result->value->shape);
+    mult1 = _tb_adaptDiffToShape(mult1, uhsDiffShape, RESULT(node)->value->shape);
     TBResultNode* res1 = tb_runSessionNodeOnly(session, mult1);
-    nda_reshape(res1->value, nda_copyShape(uop->uhs->result->value->shape));
-    _tb_freeNodeDiff(uop->uhs);
-    uop->uhs->diff = (res1);
+    nda_reshape(res1->value, nda_copyShape(RESULT(uop->uhs)->value->shape));
+    _tb_freeNodeDiff(ctx, uop->uhs);
+    DIFF(uop->uhs) = (res1);
 }
 
 static void _tb_autograd_uop_tan(struct TBGraphSession* session, TBGraph* graph, TBNode* node, TBUnaryOperation* uop){
-    NDShape* uhsDiffShape = uop->uhs->diff->value->shape;
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    NDShape* uhsDiffShape = DIFF(uop->uhs)->value->shape;
     
     TBNode* mult1 = tb_newBinaryOpNode(TBBOT_ADD,
-                                       _tb_convertResultNodeToNode(uop->uhs->diff),
+                                       _tb_convertResultNodeToNode(DIFF(uop->uhs)),
                                        tb_newBinaryOpNode(TBBOT_MULT,
-                                                          _tb_convertResultNodeToNode(node->diff),
+                                                          _tb_convertResultNodeToNode(DIFF(node)),
                                                           tb_newBinaryOpNode(TBBOT_DIV,
                                                                              tb_newConstantNode(nda_ones(nda_newShape(1,1))),
                                                                              tb_newBinaryOpNode(TBBOT_POW,
-                                                                                                tb_newUnaryOpNode(TBUOT_COS, _tb_convertResultNodeToNode(uop->uhs->result)),
+                                                                                                tb_newUnaryOpNode(TBUOT_COS, _tb_convertResultNodeToNode(RESULT(uop->uhs))),
                                                                                                 tb_newConstantNode(nda_fill(nda_newShape(1, 1), 2.0f))
                                                                                                 )
                                                                              )
                                                           )
                                        );
     
-    mult1 = _tb_adaptDiffToShape(mult1, uhsDiffShape, node->result->value->shape);
+    mult1 = _tb_adaptDiffToShape(mult1, uhsDiffShape, RESULT(node)->value->shape);
     TBResultNode* res1 = tb_runSessionNodeOnly(session, mult1);
-    nda_reshape(res1->value, nda_copyShape(uop->uhs->result->value->shape));
-    _tb_freeNodeDiff(uop->uhs);
-    uop->uhs->diff = (res1);
+    nda_reshape(res1->value, nda_copyShape(RESULT(uop->uhs)->value->shape));
+    _tb_freeNodeDiff(ctx, uop->uhs);
+    DIFF(uop->uhs) = (res1);
 }
 
 static void _tb_autograd_uop_tanh(struct TBGraphSession* session, TBGraph* graph, TBNode* node, TBUnaryOperation* uop){
-    NDShape* uhsDiffShape = uop->uhs->diff->value->shape;
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    NDShape* uhsDiffShape = DIFF(uop->uhs)->value->shape;
     
     TBNode* mult1 = tb_newBinaryOpNode(TBBOT_ADD,
-                                       _tb_convertResultNodeToNode(uop->uhs->diff),
+                                       _tb_convertResultNodeToNode(DIFF(uop->uhs)),
                                        tb_newBinaryOpNode(TBBOT_MULT,
-                                                          _tb_convertResultNodeToNode(node->diff),
+                                                          _tb_convertResultNodeToNode(DIFF(node)),
                                                           tb_newBinaryOpNode(TBBOT_SUB,
                                                                              tb_newConstantNode(nda_fill(nda_newShape(1, 1), 1.0f)),
                                                                              tb_newBinaryOpNode(TBBOT_POW,
-                                                                                                _tb_convertResultNodeToNode(uop->uhs->result),
+                                                                                                _tb_convertResultNodeToNode(RESULT(uop->uhs)),
                                                                                                 tb_newConstantNode(nda_fill(nda_newShape(1, 1), 2.0f))
                                                                                                 )
                                                                              )
                                                           )
                                        );
     
-    mult1 = _tb_adaptDiffToShape(mult1, uhsDiffShape, node->result->value->shape);
+    mult1 = _tb_adaptDiffToShape(mult1, uhsDiffShape, RESULT(node)->value->shape);
     TBResultNode* res1 = tb_runSessionNodeOnly(session, mult1);
-    nda_reshape(res1->value, nda_copyShape(uop->uhs->result->value->shape));
-    _tb_freeNodeDiff(uop->uhs);
-    uop->uhs->diff = (res1);
+    nda_reshape(res1->value, nda_copyShape(RESULT(uop->uhs)->value->shape));
+    _tb_freeNodeDiff(ctx, uop->uhs);
+    DIFF(uop->uhs) = (res1);
 }
 
 static void _tb_autograd_uop_relu(struct TBGraphSession* session, TBGraph* graph, TBNode* node, TBUnaryOperation* uop){
-    NDShape* uhsDiffShape = uop->uhs->diff->value->shape;
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    NDShape* uhsDiffShape = DIFF(uop->uhs)->value->shape;
     
     TBNode* mult1 = tb_newBinaryOpNode(TBBOT_ADD,
-                                       _tb_convertResultNodeToNode(uop->uhs->diff),
+                                       _tb_convertResultNodeToNode(DIFF(uop->uhs)),
                                        tb_newBinaryOpNode(TBBOT_MULT,
-                                                          _tb_convertResultNodeToNode(node->diff),
-                                                          tb_newUnaryOpNode(TBUOT_DXRELU, _tb_convertResultNodeToNode(uop->uhs->result))
+                                                          _tb_convertResultNodeToNode(DIFF(node)),
+                                                          tb_newUnaryOpNode(TBUOT_DXRELU, _tb_convertResultNodeToNode(RESULT(uop->uhs)))
                                                           )
                                        );
     
-    mult1 = _tb_adaptDiffToShape(mult1, uhsDiffShape, node->result->value->shape);
+    mult1 = _tb_adaptDiffToShape(mult1, uhsDiffShape, RESULT(node)->value->shape);
     TBResultNode* res1 = tb_runSessionNodeOnly(session, mult1);
-    nda_reshape(res1->value, nda_copyShape(uop->uhs->result->value->shape));
-    _tb_freeNodeDiff(uop->uhs);
-    uop->uhs->diff = (res1);
+    nda_reshape(res1->value, nda_copyShape(RESULT(uop->uhs)->value->shape));
+    _tb_freeNodeDiff(ctx, uop->uhs);
+    DIFF(uop->uhs) = (res1);
 }
 
 static void _tb_autograd_uop_softplus(struct TBGraphSession* session, TBGraph* graph, TBNode* node, TBUnaryOperation* uop){
-    NDShape* uhsDiffShape = uop->uhs->diff->value->shape;
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    NDShape* uhsDiffShape = DIFF(uop->uhs)->value->shape;
     
     TBNode* mult1 = tb_newBinaryOpNode(TBBOT_ADD,
-                                       _tb_convertResultNodeToNode(uop->uhs->diff),
+                                       _tb_convertResultNodeToNode(DIFF(uop->uhs)),
                                        tb_newBinaryOpNode(TBBOT_MULT,
-                                                          _tb_convertResultNodeToNode(node->diff),
-                                                          tb_newUnaryOpNode(TBUOT_SIGMOID, _tb_convertResultNodeToNode(uop->uhs->result))
+                                                          _tb_convertResultNodeToNode(DIFF(node)),
+                                                          tb_newUnaryOpNode(TBUOT_SIGMOID, _tb_convertResultNodeToNode(RESULT(uop->uhs)))
                                                           )
                                        );
     
-    mult1 = _tb_adaptDiffToShape(mult1, uhsDiffShape, node->result->value->shape);
+    mult1 = _tb_adaptDiffToShape(mult1, uhsDiffShape, RESULT(node)->value->shape);
     TBResultNode* res1 = tb_runSessionNodeOnly(session, mult1);
-    nda_reshape(res1->value, nda_copyShape(uop->uhs->result->value->shape));
-    _tb_freeNodeDiff(uop->uhs);
-    uop->uhs->diff = (res1);
+    nda_reshape(res1->value, nda_copyShape(RESULT(uop->uhs)->value->shape));
+    _tb_freeNodeDiff(ctx, uop->uhs);
+    DIFF(uop->uhs) = (res1);
 }
 
 static void _tb_autograd_uop_sigmoid(struct TBGraphSession* session, TBGraph* graph, TBNode* node, TBUnaryOperation* uop){
-    NDShape* uhsDiffShape = uop->uhs->diff->value->shape;
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    NDShape* uhsDiffShape = DIFF(uop->uhs)->value->shape;
     
     TBNode* mult1 = tb_newBinaryOpNode(TBBOT_ADD,
-                                       _tb_convertResultNodeToNode(uop->uhs->diff),
+                                       _tb_convertResultNodeToNode(DIFF(uop->uhs)),
                                        tb_newBinaryOpNode(TBBOT_MULT,
-                                                          _tb_convertResultNodeToNode(node->diff),
+                                                          _tb_convertResultNodeToNode(DIFF(node)),
                                                           tb_newBinaryOpNode(TBBOT_MULT,
-                                                                             _tb_convertResultNodeToNode(node->result),
+                                                                             _tb_convertResultNodeToNode(RESULT(node)),
                                                                              tb_newBinaryOpNode(TBBOT_SUB,
                                                                                                 tb_newConstantNode(nda_ones(nda_newShape(1, 1))),
-                                                                                                _tb_convertResultNodeToNode(node->result)
+                                                                                                _tb_convertResultNodeToNode(RESULT(node))
                                                                                                 )
                                                                              )
                                                           )
                                        );
     
-    mult1 = _tb_adaptDiffToShape(mult1, uhsDiffShape, node->result->value->shape);
+    mult1 = _tb_adaptDiffToShape(mult1, uhsDiffShape, RESULT(node)->value->shape);
     TBResultNode* res1 = tb_runSessionNodeOnly(session, mult1);
-    nda_reshape(res1->value, nda_copyShape(uop->uhs->result->value->shape));
-    _tb_freeNodeDiff(uop->uhs);
-    uop->uhs->diff = (res1);
+    nda_reshape(res1->value, nda_copyShape(RESULT(uop->uhs)->value->shape));
+    _tb_freeNodeDiff(ctx, uop->uhs);
+    DIFF(uop->uhs) = (res1);
 }
 
 static void _tb_autograd_abop_sum(struct TBGraphSession* session, TBGraph* graph, TBNode* node, TBAxisBoundOperation* abop){
-    NDShape* uhsDiffShape = abop->uhs->diff->value->shape;
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    NDShape* uhsDiffShape = DIFF(abop->uhs)->value->shape;
     
     TBNode* mult1 = tb_newBinaryOpNode(TBBOT_ADD,
-                                       _tb_convertResultNodeToNode(abop->uhs->diff),
-                                       //tb_newTransposeOpNode(_tb_convertResultNodeToNode(node->diff), abop->axis, 1)
-                                       _tb_convertResultNodeToNode(node->diff)
+                                       _tb_convertResultNodeToNode(DIFF(abop->uhs)),
+                                       //tb_newTransposeOpNode(_tb_convertResultNodeToNode(DIFF(node)), abop->axis, 1)
+                                       _tb_convertResultNodeToNode(DIFF(node))
                                        );
     
-    //mult1 = _tb_adaptDiffToShape(mult1, uhsDiffShape, node->result->value->shape);
+    //mult1 = _tb_adaptDiffToShape(mult1, uhsDiffShape, RESULT(node)->value->shape);
     TBResultNode* res1 = tb_runSessionNodeOnly(session, mult1);
-    nda_reshape(res1->value, nda_copyShape(abop->uhs->result->value->shape));
-    _tb_freeNodeDiff(abop->uhs);
-    abop->uhs->diff = (res1);
+    nda_reshape(res1->value, nda_copyShape(RESULT(abop->uhs)->value->shape));
+    _tb_freeNodeDiff(ctx, abop->uhs);
+    DIFF(abop->uhs) = (res1);
+}
+
+/*
+ * Gradients computed by a dedicated kernel are accumulated into the derivative of `uhs`
+ */
+static void _tb_autograd_accumulate(struct TBGraphSession* session, TBGraph* graph, TBNode* uhs, NDArray* grad){
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    
+    TBNode* add1 = tb_newBinaryOpNode(TBBOT_ADD,
+                                      _tb_convertResultNodeToNode(DIFF(uhs)),
+                                      tb_newConstantNode(grad)
+                                      );
+    
+    TBResultNode* res1 = tb_runSessionNodeOnly(session, add1);
+    nda_reshape(res1->value, nda_copyShape(RESULT(uhs)->value->shape));
+    _tb_freeNodeDiff(ctx, uhs);
+    DIFF(uhs) = (res1);
+}
+
+static void _tb_autograd_abop_softmax(struct TBGraphSession* session, TBGraph* graph, TBNode* node, TBAxisBoundOperation* abop){
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    NDArray* grad = nda_alloc(nda_copyShape(RESULT(node)->value->shape));
+    
+    _tb_softmaxGradInto(session, abop, grad, RESULT(node)->value, DIFF(node)->value);
+    _tb_autograd_accumulate(session, graph, abop->uhs, grad);
+}
+
+static void _tb_autograd_cross_entropy(struct TBGraphSession* session, TBGraph* graph, TBNode* node, TBCrossEntropyOperation* ceop){
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    NDArray* grad = nda_alloc(nda_copyShape(RESULT(ceop->logits)->value->shape));
+    
+    _tb_crossEntropyGradInto(session, ceop, grad, RESULT(ceop->logits)->value, RESULT(ceop->labels)->value, DIFF(node)->value);
+    _tb_autograd_accumulate(session, graph, ceop->logits, grad);
+}
+
+static void _tb_autograd_normalization(struct TBGraphSession* session, TBGraph* graph, TBNode* node, TBNormalizationOperation* nop){
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    NDArray* gamma = (nop->gamma != NULL) ? RESULT(nop->gamma)->value : NULL;
+    NDArray* dx = nda_alloc(nda_copyShape(RESULT(nop->uhs)->value->shape));
+    NDArray* dgamma = (nop->gamma != NULL) ? nda_alloc(nda_copyShape(gamma->shape)) : NULL;
+    NDArray* dbeta = (nop->beta != NULL) ? nda_alloc(nda_copyShape(RESULT(nop->beta)->value->shape)) : NULL;
+    
+    _tb_normalizationGradInto(session, nop, dx, dgamma, dbeta, RESULT(nop->uhs)->value, gamma, _tb_contextEntry(ctx, node)->saved, DIFF(node)->value);
+    
+    _tb_autograd_accumulate(session, graph, nop->uhs, dx);
+    if(dgamma != NULL)
+        _tb_autograd_accumulate(session, graph, nop->gamma, dgamma);
+    if(dbeta != NULL)
+        _tb_autograd_accumulate(session, graph, nop->beta, dbeta);
+}
+
+static void _tb_autograd_convolution(struct TBGraphSession* session, TBGraph* graph, TBNode* node, TBConvolutionOperation* cop){
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    NDArray* dx = nda_alloc(nda_copyShape(RESULT(cop->uhs)->value->shape));
+    NDArray* dw = nda_alloc(nda_copyShape(RESULT(cop->weights)->value->shape));
+    
+    _tb_convolutionGradInto(session, cop, dx, dw, RESULT(cop->uhs)->value, RESULT(cop->weights)->value, DIFF(node)->value);
+    
+    _tb_autograd_accumulate(session, graph, cop->uhs, dx);
+    _tb_autograd_accumulate(session, graph, cop->weights, dw);
+}
+
+static void _tb_autograd_pooling(struct TBGraphSession* session, TBGraph* graph, TBNode* node, TBPoolingOperation* pop){
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    NDArray* dx = nda_alloc(nda_copyShape(RESULT(pop->uhs)->value->shape));
+    
+    _tb_poolingGradInto(session, pop, dx, RESULT(pop->uhs)->value, _tb_contextEntry(ctx, node)->saved, DIFF(node)->value);
+    _tb_autograd_accumulate(session, graph, pop->uhs, dx);
+}
+
+static void _tb_autograd_reorder(struct TBGraphSession* session, TBGraph* graph, TBNode* node, TBReorderOperation* rop){
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    NDArray* dx = nda_alloc(nda_copyShape(RESULT(rop->uhs)->value->shape));
+    
+    _tb_reorderGradInto(rop, dx, DIFF(node)->value);
+    _tb_autograd_accumulate(session, graph, rop->uhs, dx);
 }
 
 void tb_autogradNode(struct TBGraphSession* session, TBGraph* graph, TBNode* node){
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
     switch(node->type){
             
         case TBNT_CONSTANT:
-            printf("constant found\n");
             break;
         
         case TBNT_VARIABLE:{
-            const char* name = ((TBVariable*)node->nodePtr)->name;
-            TBNode* original = tb_graphGetVar(graph, name);
-            original->diff = (node->diff);
+            TBNode* original = _tb_contextResolveVar(ctx, node);
+            _tb_freeNodeDiff(ctx, original);
+            DIFF(original) = tb_copyResultNode(DIFF(node));
             break;
         }
             
         case TBNT_GRAPH:{
             TBGraphNode* g = (TBGraphNode*)node->nodePtr;
-            tb_autogradNestedGraph(session, g, node->diff);
+            tb_autogradNestedGraph(session, g->graph, DIFF(node));
             break;
         }
         case TBNT_BINARY_OPERATION:
@@ -651,8 +761,10 @@ void tb_autogradNode(struct TBGraphSession* session, TBGraph* graph, TBNode* nod
                     
                     break;
                 case TBABOT_SOFTMAX:
-                    
-                    break;
+                case TBABOT_LOG_SOFTMAX:
+                    _tb_autograd_abop_softmax(session, graph, node, abop);
+                    tb_autogradNode(session, graph, abop->uhs);
+                    return;
                 case TBABOT_ARGMIN:
                     
                     break;
@@ -668,40 +780,137 @@ void tb_autogradNode(struct TBGraphSession* session, TBGraph* graph, TBNode* nod
         case TBNT_AXES_TRANSPOSE:
         {
             TBTransposeOperation* top = (TBTransposeOperation*)node->nodePtr;
-            NDShape* uhsDiffShape = top->uhs->diff->value->shape;
+            NDShape* uhsDiffShape = DIFF(top->uhs)->value->shape;
             
             TBNode* mult1 = tb_newBinaryOpNode(TBBOT_ADD,
-                                               _tb_convertResultNodeToNode(top->uhs->diff),
-                                               tb_newTransposeOpNode(_tb_convertResultNodeToNode(node->diff), top->axis1, top->axis2)
+                                               _tb_convertResultNodeToNode(DIFF(top->uhs)),
+                                               tb_newTransposeOpNode(_tb_convertResultNodeToNode(DIFF(node)), top->axis1, top->axis2)
                                                );
             
-            mult1 = _tb_adaptDiffToShape(mult1, uhsDiffShape, node->result->value->shape);
+            mult1 = _tb_adaptDiffToShape(mult1, uhsDiffShape, RESULT(node)->value->shape);
             TBResultNode* res1 = tb_runSessionNodeOnly(session, mult1);
-            nda_reshape(res1->value, nda_copyShape(top->uhs->result->value->shape));
-            _tb_freeNodeDiff(top->uhs);
-            top->uhs->diff = (res1);
+            nda_reshape(res1->value, nda_copyShape(RESULT(top->uhs)->value->shape));
+            _tb_freeNodeDiff(ctx, top->uhs);
+            DIFF(top->uhs) = (res1);
             
             tb_autogradNode(session, graph, top->uhs);
             
+            break;
+        }
+        case TBNT_QUANTIZATION:
+        {
+            // straight-through estimator: the rounding is differentiated as the identity
+            TBQuantizationOperation* qop = (TBQuantizationOperation*)node->nodePtr;
+            NDShape* uhsDiffShape = DIFF(qop->uhs)->value->shape;
+            
+            TBNode* add1 = tb_newBinaryOpNode(TBBOT_ADD,
+                                              _tb_convertResultNodeToNode(DIFF(qop->uhs)),
+                                              _tb_convertResultNodeToNode(DIFF(node))
+                                              );
+            
+            add1 = _tb_adaptDiffToShape(add1, uhsDiffShape, RESULT(node)->value->shape);
+            TBResultNode* res1 = tb_runSessionNodeOnly(session, add1);
+            nda_reshape(res1->value, nda_copyShape(RESULT(qop->uhs)->value->shape));
+            _tb_freeNodeDiff(ctx, qop->uhs);
+            DIFF(qop->uhs) = (res1);
+            
+            tb_autogradNode(session, graph, qop->uhs);
+            
+            break;
+        }
+        case TBNT_GATHER:
+        {
+            // rows are scatter-added into the table derivative, indices are not differentiable
+            TBGatherOperation* gop = (TBGatherOperation*)node->nodePtr;
+            _tb_gatherGradAccumulate(session, DIFF(gop->table), DIFF(node)->value, RESULT(gop->indices)->value);
+            
+            tb_autogradNode(session, graph, gop->table);
+            
+            break;
+        }
+        case TBNT_CROSS_ENTROPY:
+        {
+            // labels are not differentiated
+            TBCrossEntropyOperation* ceop = (TBCrossEntropyOperation*)node->nodePtr;
+            _tb_autograd_cross_entropy(session, graph, node, ceop);
+            
+            tb_autogradNode(session, graph, ceop->logits);
+            
+            break;
+        }
+        case TBNT_NORMALIZATION:
+        {
+            TBNormalizationOperation* nop = (TBNormalizationOperation*)node->nodePtr;
+            _tb_autograd_normalization(session, graph, node, nop);
+            
+            tb_autogradNode(session, graph, nop->uhs);
+            if(nop->gamma != NULL)
+                tb_autogradNode(session, graph, nop->gamma);
+            if(nop->beta != NULL)
+                tb_autogradNode(session, graph, nop->beta);
+            
+            break;
+        }
+        case TBNT_CONVOLUTION:
+        {
+            TBConvolutionOperation* cop = (TBConvolutionOperation*)node->nodePtr;
+            _tb_autograd_convolution(session, graph, node, cop);
+            
+            tb_autogradNode(session, graph, cop->uhs);
+            tb_autogradNode(session, graph, cop->weights);
+            
+            break;
+        }
+        case TBNT_POOLING:
+        {
+            TBPoolingOperation* pop = (TBPoolingOperation*)node->nodePtr;
+            _tb_autograd_pooling(session, graph, node, pop);
+            
+            tb_autogradNode(session, graph, pop->uhs);
+            
+            break;
+        }
+        case TBNT_REORDER:
+        {
+            TBReorderOperation* rop = (TBReorderOperation*)node->nodePtr;
+            _tb_autograd_reorder(session, graph, node, rop);
+            
+            tb_autogradNode(session, graph, rop->uhs);
+            
             break;
         }
     }
     /*printf("node type = %d\n", node->type);
     printf("node value\n");
-    nda_debugValue(node->result->value);
+    nda_debugValue(RESULT(node)->value);
     printf("node diff\n");
-    nda_debugValue(node->diff->value);
+    nda_debugValue(DIFF(node)->value);
     printf("----------\n\n");
      */
 }
 
 
 void tb_autogradGraph(struct TBGraphSession* session, TBGraph* graph){
-    graph->root->diff = tb_newResultNode(nda_ones(nda_copyShape(graph->root->result->value->shape)));
+    // derivatives are charged to the session, not to the nodes
+    TBSessionMemory* memory = (session != NULL) ? session->memory : NULL;
+    NDMemTracker* previous = (memory != NULL) ? nda_memSetTracker(memory->tracker) : NULL;
+    
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    _tb_freeNodeDiff(ctx, graph->root);
+    DIFF(graph->root) = tb_newResultNode(nda_ones(nda_copyShape(RESULT(graph->root)->value->shape)));
     tb_autogradNode(session, graph, graph->root);
+    
+    if(memory != NULL){
+        nda_memSetTracker(previous);
+    }
 }
 
 void tb_autogradNestedGraph(struct TBGraphSession* session, TBGraph* graph, TBResultNode* parentDiff){
-    graph->root->diff = tb_copyResultNode(parentDiff);
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    _tb_freeNodeDiff(ctx, graph->root);
+    DIFF(graph->root) = tb_copyResultNode(parentDiff);
     tb_autogradNode(session, graph, graph->root);
 }
+
+#undef RESULT
+#undef DIFF
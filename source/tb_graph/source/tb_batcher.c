@@ -0,0 +1,455 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file tb_batcher.c
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing a dynamic micro-batching front-end for serving single examples through a graph.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <ndarray.h>
+#include <ndarray_std.h>
+
+#include <tb_graph.h>
+#include <tb_session.h>
+#include <tb_session_cpu.h>
+#include <tb_batcher.h>
+
+/**
+ * \brief Pending request, lives on the stack of the calling thread
+ */
+typedef struct TBBatchRequest {
+    struct NDArray* input;         /**< Example to compute */
+    struct NDArray* output;        /**< Destination of the output row */
+    TBError* error;                /**< Error of the batched run, NULL on success */
+    uint64_t arrival_ns;           /**< Monotonic time at which the request was queued */
+    uint8_t done;                  /**< Boolean flag set once the output has been written */
+    pthread_cond_t cond;           /**< Signaled once the request is done */
+    struct TBBatchRequest* next;   /**< Next request in the queue */
+}TBBatchRequest;
+
+struct TBBatcher {
+    TBGraphSession* session;       /**< Session running the graph */
+    TBGraph* graph;                /**< Served graph */
+    uint64_t slot;                 /**< Variable slot receiving the batch */
+    
+    NDShape* example;              /**< Shape of a single example */
+    uint64_t example_len;          /**< Number of elements of a single example */
+    uint64_t row_len;              /**< Number of elements of the output row of a single example */
+    NDDType row_dtype;             /**< Storage type of the graph output */
+    uint64_t max_batch;            /**< Maximum number of examples per run */
+    uint64_t max_delay_us;         /**< Maximum waiting time of the oldest request */
+    
+    TBPreparedRun** runs;          /**< Prepared run of each bucket size, lazily created */
+    NDArray** inputs;              /**< Batched input bound to each prepared run */
+    TBBatchRequest** batch;        /**< Requests of the batch being computed */
+    TBError row_error;             /**< Error reported when the graph output is not one row per example */
+    
+    pthread_mutex_t lock;          /**< Protects the queue and the counters */
+    pthread_cond_t has_work;       /**< Signaled when the worker may have a batch to run */
+    pthread_t worker;              /**< Worker thread running the batches */
+    uint8_t stop;                  /**< Boolean flag asking the worker to exit once the queue is empty */
+    
+    TBBatchRequest* head;          /**< Oldest queued request */
+    TBBatchRequest* tail;          /**< Newest queued request */
+    uint64_t queued;               /**< Number of queued requests */
+    
+    uint64_t served;               /**< Number of served requests */
+    uint64_t batches;              /**< Number of batched runs */
+};
+
+static uint64_t _tb_nowNs(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    
+    return (uint64_t)ts.tv_sec*1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Batches are padded to the next power of two, or to the maximum batch size, so that a handful of runs are prepared
+ * whatever the load.
+ */
+static uint64_t _tb_batcherBucket(TBBatcher* batcher, uint64_t n){
+    uint64_t bucket = 1;
+    while(bucket < n){
+        bucket *= 2;
+    }
+    
+    return (bucket < batcher->max_batch)?bucket:batcher->max_batch;
+}
+
+static TBPreparedRun* _tb_batcherGetRun(TBBatcher* batcher, uint64_t n){
+    if(batcher->runs[n-1] == NULL){
+        uint64_t rank = batcher->example->rank;
+        uint64_t* dims = calloc(rank+1, sizeof(uint64_t));
+        dims[0] = n;
+        memcpy(dims+1, batcher->example->dims, rank*sizeof(uint64_t));
+        
+        batcher->inputs[n-1] = nda_alloc(nda_newShapeFromArray(rank+1, dims));
+        batcher->runs[n-1] = tb_prepareRun(batcher->session, batcher->graph);
+        tb_preparedBindInput(batcher->runs[n-1], batcher->slot, batcher->inputs[n-1]);
+    }
+    
+    return batcher->runs[n-1];
+}
+
+/*
+ * Writes an example into its row of the batch, examples of another dtype or strided are converted.
+ */
+static void _tb_batcherGather(TBBatcher* batcher, NDArray* example, tb_float* row){
+    if(!nda_isContiguous(example->shape)){
+        NDArray* x = nda_cast(example, NDA_DTYPE_FLOAT);
+        memcpy(row, x->data, batcher->example_len*sizeof(tb_float));
+        nda_free(x);
+        free(x);
+        return;
+    }
+    
+    if(example->dtype == NDA_DTYPE_FLOAT){
+        memcpy(row, example->data, batcher->example_len*sizeof(tb_float));
+        return;
+    }
+    
+    nda_toFloat(example->raw, example->dtype, row, batcher->example_len);
+}
+
+/*
+ * Gathers the examples of the current batch, runs the graph once and scatters the output rows.
+ */
+static void _tb_batcherExecute(TBBatcher* batcher, uint64_t n){
+    uint64_t bucket = _tb_batcherBucket(batcher, n);
+    TBPreparedRun* run = _tb_batcherGetRun(batcher, bucket);
+    NDArray* input = batcher->inputs[bucket-1];
+    
+    uint64_t i = 0;
+    for(; i < n; i++){
+        _tb_batcherGather(batcher, batcher->batch[i]->input, input->data + i*batcher->example_len);
+    }
+    
+    // padding rows are computed and dropped
+    memset(input->data + n*batcher->example_len, 0, (bucket - n)*batcher->example_len*sizeof(tb_float));
+    
+    TBResultNode* res = tb_runPrepared(run);
+    TBError* error = res->error;
+    uint64_t row_size = batcher->row_len*nda_dtypeSize(batcher->row_dtype);
+    
+    if((error == NULL) && ((res->value->shape->raw_len != bucket*batcher->row_len) || (res->value->dtype != batcher->row_dtype))){
+        error = &batcher->row_error;
+    }
+    
+    for(i = 0; i < n; i++){
+        batcher->batch[i]->error = error;
+        
+        if(error == NULL){
+            memcpy(batcher->batch[i]->output->raw, (uint8_t*)res->value->raw + i*row_size, row_size);
+        }
+    }
+}
+
+static void* _tb_batcherWorker(void* arg){
+    TBBatcher* batcher = (TBBatcher*)arg;
+    
+    pthread_mutex_lock(&batcher->lock);
+    
+    while(1){
+        while((batcher->queued == 0) && !batcher->stop){
+            pthread_cond_wait(&batcher->has_work, &batcher->lock);
+        }
+        
+        if(batcher->queued == 0){
+            break;
+        }
+        
+        // let the batch fill up until the oldest request reaches its deadline
+        uint64_t deadline = batcher->head->arrival_ns + batcher->max_delay_us*1000;
+        struct timespec ts = {(time_t)(deadline/1000000000ull), (long)(deadline%1000000000ull)};
+        
+        while((batcher->queued < batcher->max_batch) && !batcher->stop){
+            if(pthread_cond_timedwait(&batcher->has_work, &batcher->lock, &ts) == ETIMEDOUT)
+                break;
+        }
+        
+        uint64_t n = batcher->queued < batcher->max_batch?batcher->queued:batcher->max_batch;
+        uint64_t i = 0;
+        for(; i < n; i++){
+            batcher->batch[i] = batcher->head;
+            batcher->head = batcher->head->next;
+        }
+        
+        batcher->queued -= n;
+        if(batcher->head == NULL){
+            batcher->tail = NULL;
+        }
+        
+        pthread_mutex_unlock(&batcher->lock);
+        _tb_batcherExecute(batcher, n);
+        pthread_mutex_lock(&batcher->lock);
+        
+        for(i = 0; i < n; i++){
+            batcher->batch[i]->done = 1;
+            pthread_cond_signal(&batcher->batch[i]->cond);
+        }
+        
+        batcher->served += n;
+        batcher->batches++;
+    }
+    
+    pthread_mutex_unlock(&batcher->lock);
+    
+    return NULL;
+}
+
+TBBatcher* tb_newBatcher(TBGraphSession* session, TBGraph* graph, uint64_t slot, NDShape* example, uint64_t max_batch, uint64_t max_delay_us){
+    ASSERT(graph != NULL, "Cannot serve a NULL Graph");
+    ASSERT(max_batch > 0, "Maximum batch size must be positive");
+    ASSERT(example->raw_len > 0, "Examples must not be empty");
+    
+    TBBatcher* batcher = calloc(1, sizeof(TBBatcher));
+    batcher->session = session;
+    batcher->graph = graph;
+    batcher->slot = slot;
+    batcher->example = nda_newShapeFromArrayCopy(example->rank, example->dims);
+    batcher->example_len = example->raw_len;
+    batcher->max_batch = max_batch;
+    batcher->max_delay_us = max_delay_us;
+    
+    batcher->runs = calloc(max_batch, sizeof(TBPreparedRun*));
+    batcher->inputs = calloc(max_batch, sizeof(NDArray*));
+    batcher->batch = calloc(max_batch, sizeof(TBBatchRequest*));
+    
+    batcher->row_error.errorType = TBET_INCOMPATIBLE_DIMENTIONS_EXCEPTION;
+    batcher->row_error.graph = graph;
+    batcher->row_error.message = "Graph output must have one row per example along its first axis";
+    
+    // a first run on a single (zero) example finds out the output row length and dtype
+    TBResultNode* res = tb_runPrepared(_tb_batcherGetRun(batcher, 1));
+    batcher->row_len = (res->error == NULL)?res->value->shape->raw_len:0;
+    batcher->row_dtype = (res->error == NULL)?res->value->dtype:NDA_DTYPE_FLOAT;
+    
+    if((res->error == NULL) && ((res->value->shape->rank == 0) || (res->value->shape->dims[0] != 1) ||
+                                (res->value->sparse != NULL) || !nda_isContiguous(res->value->shape))){
+        batcher->row_len = 0;
+    }
+    
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&batcher->has_work, &attr);
+    pthread_condattr_destroy(&attr);
+    
+    pthread_mutex_init(&batcher->lock, NULL);
+    pthread_create(&batcher->worker, NULL, _tb_batcherWorker, batcher);
+    
+    return batcher;
+}
+
+TBError* tb_batcherRun(TBBatcher* batcher, NDArray* input, NDArray* output){
+    ASSERT(input->shape->raw_len == batcher->example_len, "Example of %"PRIu64" elements given, %"PRIu64" expected", input->shape->raw_len, batcher->example_len);
+    ASSERT((input->quant == NULL) && (input->sparse == NULL), "Examples must be dense and not quantized");
+    ASSERT(output->shape->raw_len >= batcher->row_len, "Output of %"PRIu64" elements is too small for a row of %"PRIu64, output->shape->raw_len, batcher->row_len);
+    ASSERT(output->dtype == batcher->row_dtype, "Output of dtype %s given, the graph outputs %s", nda_dtypeName(output->dtype), nda_dtypeName(batcher->row_dtype));
+    ASSERT(nda_isContiguous(output->shape), "Output must be contiguous");
+    
+    TBBatchRequest req;
+    memset(&req, 0, sizeof(TBBatchRequest));
+    req.input = input;
+    req.output = output;
+    pthread_cond_init(&req.cond, NULL);
+    
+    pthread_mutex_lock(&batcher->lock);
+    
+    req.arrival_ns = _tb_nowNs();
+    
+    if(batcher->tail != NULL){
+        batcher->tail->next = &req;
+    }
+    else {
+        batcher->head = &req;
+    }
+    
+    batcher->tail = &req;
+    batcher->queued++;
+    
+    // the worker only cares about the first request and a full batch
+    if((batcher->queued == 1) || (batcher->queued >= batcher->max_batch)){
+        pthread_cond_signal(&batcher->has_work);
+    }
+    
+    while(!req.done){
+        pthread_cond_wait(&req.cond, &batcher->lock);
+    }
+    
+    pthread_mutex_unlock(&batcher->lock);
+    pthread_cond_destroy(&req.cond);
+    
+    return req.error;
+}
+
+uint64_t tb_batcherOutputLen(TBBatcher* batcher){
+    return batcher->row_len;
+}
+
+typedef struct TBLoadClient {
+    TBBatcher* batcher;
+    NDArray* example;
+    NDArray* output;
+    uint64_t requests;
+    double* latencies;
+}TBLoadClient;
+
+static void* _tb_loadClient(void* arg){
+    TBLoadClient* client = (TBLoadClient*)arg;
+    
+    uint64_t i = 0;
+    for(; i < client->requests; i++){
+        uint64_t start = _tb_nowNs();
+        tb_batcherRun(client->batcher, client->example, client->output);
+        client->latencies[i] = (double)(_tb_nowNs() - start)/1000.0;
+    }
+    
+    return NULL;
+}
+
+static int _tb_compareDouble(const void* a, const void* b){
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    
+    return (x > y) - (x < y);
+}
+
+static double _tb_percentile(double* sorted, uint64_t len, double p){
+    uint64_t rank = (uint64_t)(p*len + 0.999999);
+    
+    return sorted[rank > 0?rank-1:0];
+}
+
+TBBatcherStats tb_batcherLoadTest(TBBatcher* batcher, uint64_t clients, uint64_t requests, NDArray* example){
+    TBBatcherStats stats;
+    memset(&stats, 0, sizeof(TBBatcherStats));
+    
+    uint64_t total = clients*requests;
+    if(total == 0){
+        return stats;
+    }
+    
+    double* latencies = calloc(total, sizeof(double));
+    pthread_t* threads = calloc(clients, sizeof(pthread_t));
+    TBLoadClient* loads = calloc(clients, sizeof(TBLoadClient));
+    
+    pthread_mutex_lock(&batcher->lock);
+    uint64_t batches = batcher->batches;
+    pthread_mutex_unlock(&batcher->lock);
+    
+    uint64_t start = _tb_nowNs();
+    
+    uint64_t i = 0;
+    for(; i < clients; i++){
+        loads[i].batcher = batcher;
+        loads[i].example = example;
+        loads[i].output = nda_alloc(nda_newShape(1, batcher->row_len > 0?batcher->row_len:1));
+        loads[i].requests = requests;
+        loads[i].latencies = latencies + i*requests;
+        
+        pthread_create(threads + i, NULL, _tb_loadClient, loads + i);
+    }
+    
+    for(i = 0; i < clients; i++){
+        pthread_join(threads[i], NULL);
+        nda_free(loads[i].output);
+        free(loads[i].output);
+    }
+    
+    stats.seconds = (double)(_tb_nowNs() - start)/1e9;
+    
+    pthread_mutex_lock(&batcher->lock);
+    stats.batches = batcher->batches - batches;
+    pthread_mutex_unlock(&batcher->lock);
+    
+    qsort(latencies, total, sizeof(double), _tb_compareDouble);
+    
+    stats.requests = total;
+    stats.throughput = stats.seconds > 0?total/stats.seconds:0;
+    stats.p50_us = _tb_percentile(latencies, total, 0.50);
+    stats.p99_us = _tb_percentile(latencies, total, 0.99);
+    stats.max_us = latencies[total-1];
+    
+    free(latencies);
+    free(threads);
+    free(loads);
+    
+    return stats;
+}
+
+void tb_freeBatcher(TBBatcher* batcher){
+    pthread_mutex_lock(&batcher->lock);
+    batcher->stop = 1;
+    pthread_cond_signal(&batcher->has_work);
+    pthread_mutex_unlock(&batcher->lock);
+    
+    pthread_join(batcher->worker, NULL);
+    
+    uint64_t i = 0;
+    for(; i < batcher->max_batch; i++){
+        if(batcher->runs[i] != NULL){
+            tb_freePreparedRun(batcher->runs[i]);
+            nda_free(batcher->inputs[i]);
+            free(batcher->inputs[i]);
+        }
+    }
+    
+    free(batcher->example->dims);
+    free(batcher->example->strides);
+    free(batcher->example);
+    free(batcher->runs);
+    free(batcher->inputs);
+    free(batcher->batch);
+    
+    pthread_cond_destroy(&batcher->has_work);
+    pthread_mutex_destroy(&batcher->lock);
+    free(batcher);
+}
@@ -0,0 +1,350 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file tb_cost.c
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing the static cost model of graphs.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <ndarray.h>
+#include <ndarray_std.h>
+
+#include <tb_graph.h>
+#include <tb_errors.h>
+#include <tb_operation.h>
+#include <tb_factory.h>
+#include <tb_shape.h>
+#include <tb_cost.h>
+
+TBRoofline tb_defaultRoofline(void){
+    TBRoofline roofline = {50, 10, 500};
+    
+    return roofline;
+}
+
+uint8_t tb_calibrateRoofline(const char* path, TBRoofline* roofline){
+    FILE* f = fopen(path, "r");
+    char line[1024];
+    
+    if(f == NULL){
+        return 0;
+    }
+    
+    // one benchmark per line, see `_bench_writeJSON`
+    double* ns = NULL;
+    double* flops = NULL;
+    double* bytes = NULL;
+    uint64_t count = 0, cap = 0, i;
+    TBRoofline res = {0, 0, -1};
+    
+    while(fgets(line, sizeof(line), f) != NULL){
+        char* n = strstr(line, "\"ns\": ");
+        char* fl = strstr(line, "\"flops\": ");
+        char* by = strstr(line, "\"bytes\": ");
+        
+        if((n == NULL) || (fl == NULL) || (by == NULL))
+            continue;
+        
+        if(count == cap){
+            cap = (cap == 0) ? 64 : 2*cap;
+            ns = realloc(ns, cap*sizeof(double));
+            flops = realloc(flops, cap*sizeof(double));
+            bytes = realloc(bytes, cap*sizeof(double));
+        }
+        
+        ns[count] = strtod(n + strlen("\"ns\": "), NULL);
+        flops[count] = strtod(fl + strlen("\"flops\": "), NULL);
+        bytes[count] = strtod(by + strlen("\"bytes\": "), NULL);
+        
+        if(ns[count] <= 0)
+            continue;
+        
+        if((res.overhead < 0) || (ns[count] < res.overhead))
+            res.overhead = ns[count];
+        
+        count++;
+    }
+    
+    fclose(f);
+    
+    // the fastest benchmark is mostly overhead, only benchmarks well above it measure throughput. Benchmarks of
+    // similar durations cannot tell the overhead apart and all measure throughput.
+    uint8_t all = 1;
+    for(i = 0; i < count; i++){
+        all &= (ns[i] < 4*res.overhead);
+    }
+    
+    if(all){
+        res.overhead = 0;
+    }
+    
+    for(i = 0; i < count; i++){
+        double t = ns[i] - res.overhead;
+        
+        if(t < 3*res.overhead)
+            continue;
+        
+        if(flops[i]/t > res.gflops)
+            res.gflops = flops[i]/t;
+        if(bytes[i]/t > res.gbps)
+            res.gbps = bytes[i]/t;
+    }
+    
+    uint8_t ok = (res.gflops > 0) && (res.gbps > 0);
+    
+    if(ok){
+        *roofline = res;
+    }
+    
+    free(ns);
+    free(flops);
+    free(bytes);
+    
+    return ok;
+}
+
+uint64_t tb_nodeFlops(TBNode* node, NDShape* out, NDShape* lhs, NDShape* rhs){
+    uint64_t len = out->raw_len;
+    
+    switch(node->type){
+        case TBNT_BINARY_OPERATION:
+            if(((TBBinaryOperation*)node->nodePtr)->type == TBBOT_DOT)
+                return 2*len*lhs->dims[lhs->rank-1];
+            return len;
+        case TBNT_UNARY_OPERATION:
+            return len;
+        case TBNT_AXIS_BOUND_OPERATION:
+            return lhs->raw_len;
+        case TBNT_QUANTIZATION:
+            // prepared runs fuse a DOT product into the requantization
+            if(rhs != NULL)
+                return 2*len*lhs->dims[lhs->rank-1];
+            return 2*len;
+        case TBNT_CROSS_ENTROPY:
+            return 4*lhs->raw_len;
+        case TBNT_NORMALIZATION:
+            return 8*len;
+        case TBNT_CONVOLUTION:
+            return 2*len*rhs->dims[1]*rhs->dims[2]*rhs->dims[3];
+        case TBNT_POOLING:{
+            TBPoolingOperation* pop = (TBPoolingOperation*)node->nodePtr;
+            if((pop->type == TBPOT_GLOBAL_MAX) || (pop->type == TBPOT_GLOBAL_AVG))
+                return lhs->raw_len;
+            return len*pop->window[0]*pop->window[1];
+        }
+        case TBNT_VARIABLE:
+        case TBNT_CONSTANT:
+        case TBNT_GRAPH:
+        case TBNT_AXES_TRANSPOSE:
+        case TBNT_GATHER:
+        case TBNT_REORDER:
+            break;
+    }
+    
+    return 0;
+}
+
+/*
+ * Bytes of the value of an estimated node, constants are counted as stored (e.g sparse or quantized)
+ */
+static uint64_t _tb_costValueBytes(TBNodeCost* c){
+    if(c->node->type == TBNT_CONSTANT){
+        NDArray* value = ((TBConstant*)c->node->nodePtr)->value;
+        return nda_storedLen(value)*nda_dtypeSize(value->dtype);
+    }
+    
+    return c->shape->raw_len*nda_dtypeSize(c->dtype);
+}
+
+static uint64_t _tb_pushCost(TBGraphCost* cost, TBNode* node, TBGraph* graph, NDShape* shape, NDDType dtype,
+                             uint64_t lhs, uint64_t rhs, uint64_t aux){
+    if(cost->nodes_len == cost->nodes_cap){
+        cost->nodes_cap = cost->nodes_cap ? 2*cost->nodes_cap : 16;
+        cost->nodes = realloc(cost->nodes, cost->nodes_cap*sizeof(TBNodeCost));
+    }
+    
+    TBNodeCost* c = cost->nodes + cost->nodes_len;
+    memset(c, 0, sizeof(TBNodeCost));
+    c->node = node;
+    c->graph = graph;
+    c->op = tb_nodeOpName(node);
+    c->shape = shape;
+    c->dtype = dtype;
+    c->lhs = lhs;
+    c->rhs = rhs;
+    c->aux = aux;
+    
+    // inputs and constants are already in memory
+    if((node->type == TBNT_VARIABLE) || (node->type == TBNT_CONSTANT)){
+        return cost->nodes_len++;
+    }
+    
+    TBNodeCost* a = (lhs != TB_NO_SLOT) ? cost->nodes + lhs : NULL;
+    TBNodeCost* b = (rhs != TB_NO_SLOT) ? cost->nodes + rhs : NULL;
+    c->flops = tb_nodeFlops(node, shape, (a != NULL) ? a->shape : NULL, (b != NULL) ? b->shape : NULL);
+    c->bytes_written = _tb_costValueBytes(c);
+    
+    // a gather reads the indices and the gathered rows only
+    if(node->type == TBNT_GATHER){
+        c->bytes_read = _tb_costValueBytes(b) + c->bytes_written;
+    }
+    else {
+        c->bytes_read = ((a != NULL) ? _tb_costValueBytes(a) : 0) + ((b != NULL) ? _tb_costValueBytes(b) : 0) +
+                        ((aux != TB_NO_SLOT) ? _tb_costValueBytes(cost->nodes + aux) : 0);
+    }
+    
+    uint64_t moved = c->bytes_read + c->bytes_written;
+    double compute = c->flops/cost->roofline.gflops;
+    double memory = moved/cost->roofline.gbps;
+    
+    c->intensity = (moved > 0) ? (double)c->flops/moved : 0;
+    c->memory_bound = (memory > compute);
+    c->ns = (c->memory_bound ? memory : compute) + cost->roofline.overhead;
+    
+    cost->flops += c->flops;
+    cost->bytes_read += c->bytes_read;
+    cost->bytes_written += c->bytes_written;
+    cost->ns += c->ns;
+    
+    return cost->nodes_len++;
+}
+
+TBGraphCost* tb_estimateGraphCost(TBGraph* graph, NDShape** inputs, TBRoofline* roofline){
+    TBGraphShapes* shapes = tb_inferShapes(graph, inputs);
+    
+    TBGraphCost* cost = calloc(1, sizeof(TBGraphCost));
+    cost->graph = graph;
+    cost->roofline = (roofline != NULL) ? *roofline : tb_defaultRoofline();
+    cost->root = shapes->root;
+    cost->error = shapes->error;
+    shapes->error = NULL;
+    
+    // the estimate takes over the inferred shapes
+    uint64_t i = 0;
+    for(; i < shapes->nodes_len; i++){
+        TBNodeShape* n = shapes->nodes + i;
+        
+        if(tb_shapeIsSymbolic(n->shape)){
+            TBResultNode* res = tb_newErrorResultNode(TBET_INCOMPATIBLE_ARGS_EXCEPTION,
+                                                      "Cannot estimate the cost of symbolic shapes, see `tb_concreteShape`", n->node, n->graph);
+            
+            if(cost->error != NULL){
+                free((char*)cost->error->message);
+                free(cost->error);
+            }
+            
+            cost->error = res->error;
+            cost->root = TB_NO_SLOT;
+            free(res);
+            break;
+        }
+        
+        _tb_pushCost(cost, n->node, n->graph, n->shape, n->dtype, n->lhs, n->rhs, n->aux);
+        n->shape = NULL;
+    }
+    
+    tb_freeGraphShapes(shapes);
+    
+    return cost;
+}
+
+static void _tb_costShape(NDShape* shape, char* buffer, uint64_t size){
+    uint64_t i = 0, len = snprintf(buffer, size, "(");
+    
+    for(; (i < shape->rank) && (len < size); i++){
+        len += snprintf(buffer + len, size - len, (i == 0) ? "%" PRIu64 : ", %" PRIu64, shape->dims[i]);
+    }
+    
+    if(len < size){
+        snprintf(buffer + len, size - len, ")");
+    }
+}
+
+void tb_writeGraphCost(TBGraphCost* cost, FILE* out){
+    char shape[128];
+    uint64_t i = 0;
+    
+    fprintf(out, "Cost of `%s`: roofline %.2f GFLOP/s, %.2f GB/s, %.1f ns per node\n\n",
+            cost->graph->name, cost->roofline.gflops, cost->roofline.gbps, cost->roofline.overhead);
+    fprintf(out, "%6s  %-16s %-24s %12s %12s %12s %9s %11s  %s\n", "node", "op", "shape", "MFLOP", "read KB", "write KB",
+            "FLOP/B", "est us", "bound");
+    
+    for(; i < cost->nodes_len; i++){
+        TBNodeCost* c = cost->nodes + i;
+        
+        if((c->node->type == TBNT_VARIABLE) || (c->node->type == TBNT_CONSTANT))
+            continue;
+        
+        _tb_costShape(c->shape, shape, sizeof(shape));
+        fprintf(out, "%6" PRIu64 "  %-16s %-24s %12.3f %12.1f %12.1f %9.2f %11.3f  %s\n", c->node->id, c->op, shape,
+                c->flops/1e6, c->bytes_read/1024.0, c->bytes_written/1024.0, c->intensity, c->ns/1e3,
+                c->memory_bound ? "memory" : "compute");
+    }
+    
+    fprintf(out, "\nTotal: %.3f MFLOP, %.1f KB read, %.1f KB written, %.3f us\n", cost->flops/1e6,
+            cost->bytes_read/1024.0, cost->bytes_written/1024.0, cost->ns/1e3);
+    
+    if(cost->error != NULL){
+        fprintf(out, "Incomplete estimate: %s\n", cost->error->message);
+    }
+}
+
+void tb_freeGraphCost(TBGraphCost* cost){
+    uint64_t i = 0;
+    for(; i < cost->nodes_len; i++){
+        free(cost->nodes[i].shape->dims);
+        free(cost->nodes[i].shape->strides);
+        free(cost->nodes[i].shape);
+    }
+    
+    if(cost->error != NULL){
+        free((char*)cost->error->message);
+        free(cost->error);
+    }
+    
+    free(cost->nodes);
+    free(cost);
+}
@@ -57,11 +57,12 @@ TBNode* node = calloc(1, sizeof(TBNode));\
 node->calc_grad = grad;\
 node->type = t;\
 node->nodePtr = ptrVal;\
-node->diff = NULL;
+node->id = TB_NO_ID;
 
 TBNode* tb_newVarNode(char* name){
 	TBVariable* var = calloc(1, sizeof(TBVariable));
 	var->name = name;
+	var->slot = TB_NO_SLOT;
 	
 	TB_ALLOC_NODE(node, TBNT_VARIABLE, 1, var);
 	
@@ -79,6 +80,13 @@ TBNode* tb_newConstantNode(NDArray* array){
 }
 
 
+TBNode* tb_newBorrowedConstantNode(NDArray* array){
+    TBNode* node = tb_newConstantNode(array);
+    ((TBConstant*)node->nodePtr)->borrowed = 1;
+    
+    return node;
+}
+
 TBNode* tb_copyConstantNode(TBNode* con){
     ASSERT(con != NULL, "NULL node passed to copy a constant node");
     ASSERT(con->type == TBNT_CONSTANT, "Non-constant node node passed to copy a constant node");
@@ -158,6 +166,118 @@ TBNode* tb_newTransposeOpNode(TBNode* uhs, uint64_t axis1, uint64_t axis2){
     return node;
 }
 
+TBNode* tb_newQuantizeOpNode(TBNode* uhs, NDDType dtype, float scale, int32_t zero_point){
+    ASSERT(dtype == NDA_DTYPE_U8 || dtype == NDA_DTYPE_I8, "Cannot quantize to dtype %s", nda_dtypeName(dtype));
+    
+    TBQuantizationOperation* qop = calloc(1, sizeof(TBQuantizationOperation));
+    qop->uhs = uhs;
+    qop->type = TBQOT_QUANTIZE;
+    qop->dtype = dtype;
+    qop->scale = scale;
+    qop->zero_point = zero_point;
+    
+    TB_ALLOC_NODE(node, TBNT_QUANTIZATION, 1, qop);
+    
+    return node;
+}
+
+TBNode* tb_newDequantizeOpNode(TBNode* uhs){
+    TBQuantizationOperation* qop = calloc(1, sizeof(TBQuantizationOperation));
+    qop->uhs = uhs;
+    qop->type = TBQOT_DEQUANTIZE;
+    qop->dtype = NDA_DTYPE_FLOAT;
+    qop->scale = 1.0f;
+    
+    TB_ALLOC_NODE(node, TBNT_QUANTIZATION, 1, qop);
+    
+    return node;
+}
+
+TBNode* tb_newGatherOpNode(TBNode* table, TBNode* indices){
+    TBGatherOperation* gop = calloc(1, sizeof(TBGatherOperation));
+    gop->table = table;
+    gop->indices = indices;
+    
+    TB_ALLOC_NODE(node, TBNT_GATHER, 1, gop);
+    
+    return node;
+}
+
+TBNode* tb_newCrossEntropyOpNode(TBNode* logits, TBNode* labels, uint64_t axis){
+    TBCrossEntropyOperation* ceop = calloc(1, sizeof(TBCrossEntropyOperation));
+    ceop->logits = logits;
+    ceop->labels = labels;
+    ceop->axis = axis;
+    
+    TB_ALLOC_NODE(node, TBNT_CROSS_ENTROPY, 1, ceop);
+    
+    return node;
+}
+
+TBNode* tb_newNormalizationOpNode(TBNormalizationOperationType type, TBNode* uhs, TBNode* gamma, TBNode* beta, uint64_t axis, float epsilon){
+    TBNormalizationOperation* nop = calloc(1, sizeof(TBNormalizationOperation));
+    nop->uhs = uhs;
+    nop->gamma = gamma;
+    nop->beta = beta;
+    nop->type = type;
+    nop->axis = axis;
+    nop->epsilon = epsilon;
+    
+    TB_ALLOC_NODE(node, TBNT_NORMALIZATION, 1, nop);
+    
+    return node;
+}
+
+TBNode* tb_newConvolutionOpNode(TBNode* uhs, TBNode* weights, TBConvolutionLayout layout, uint64_t stride_h, uint64_t stride_w,
+                                uint64_t pad_h, uint64_t pad_w, uint64_t dilation_h, uint64_t dilation_w, uint64_t groups){
+    TBConvolutionOperation* cop = calloc(1, sizeof(TBConvolutionOperation));
+    cop->uhs = uhs;
+    cop->weights = weights;
+    cop->layout = layout;
+    cop->algorithm = TBCA_AUTO;
+    cop->stride[0] = stride_h;
+    cop->stride[1] = stride_w;
+    cop->padding[0] = pad_h;
+    cop->padding[1] = pad_w;
+    cop->dilation[0] = dilation_h;
+    cop->dilation[1] = dilation_w;
+    cop->groups = groups;
+    
+    TB_ALLOC_NODE(node, TBNT_CONVOLUTION, 1, cop);
+    
+    return node;
+}
+
+TBNode* tb_newPoolingOpNode(TBPoolingOperationType type, TBNode* uhs, TBConvolutionLayout layout, uint64_t window_h, uint64_t window_w,
+                            uint64_t stride_h, uint64_t stride_w, uint64_t pad_h, uint64_t pad_w){
+    TBPoolingOperation* pop = calloc(1, sizeof(TBPoolingOperation));
+    pop->uhs = uhs;
+    pop->type = type;
+    pop->layout = layout;
+    pop->window[0] = window_h;
+    pop->window[1] = window_w;
+    pop->stride[0] = stride_h;
+    pop->stride[1] = stride_w;
+    pop->padding[0] = pad_h;
+    pop->padding[1] = pad_w;
+    
+    TB_ALLOC_NODE(node, TBNT_POOLING, 1, pop);
+    
+    return node;
+}
+
+TBNode* tb_newReorderOpNode(TBNode* uhs, TBConvolutionLayout from, TBConvolutionLayout to, uint64_t block){
+    TBReorderOperation* rop = calloc(1, sizeof(TBReorderOperation));
+    rop->uhs = uhs;
+    rop->from = from;
+    rop->to = to;
+    rop->block = block;
+    
+    TB_ALLOC_NODE(node, TBNT_REORDER, 1, rop);
+    
+    return node;
+}
+
 TBResultNode* tb_newResultNode(NDArray* array){
     TBResultNode* res = calloc(1, sizeof(TBResultNode));
     res->error = NULL;
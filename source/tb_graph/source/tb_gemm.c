@@ -0,0 +1,856 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file tb_gemm.c
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing the in-tree cache-blocked GEMM.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <ndarray.h>
+#include <ndarray_cpu.h>
+#include <ndarray_mem.h>
+
+#include <tb_gemm.h>
+#include <tb_pool.h>
+
+#if (TB_TYPE == TB_FLOAT) && (defined(__x86_64__) || defined(__i386__))
+#define TB_GEMM_X86 1
+#include <immintrin.h>
+#endif
+
+/*
+ * Register tile of the micro-kernel (MR rows by NR columns of C kept in vector registers for the whole KC
+ * reduction), then the cache blocks: a KC x NR panel of B stays in L1, an MC x KC block of A in L2, and a
+ * KC x NC block of B in L3. The micro-kernel, hence MR, NR and MC, is picked at run time between AVX-512,
+ * AVX2+FMA and a portable one.
+ */
+#define TB_GEMM_KC 256
+#define TB_GEMM_NC 4096
+/* Largest MC and NR of the micro-kernels, the packing buffers fit all of them */
+#define TB_GEMM_MAX_MC 168
+#define TB_GEMM_MAX_MR 14
+#define TB_GEMM_MAX_NR 32
+/* Minimum number of multiply-adds given to each thread */
+#define TB_GEMM_GRAIN 1048576
+
+typedef struct _TBGemmKernel{
+    uint64_t mr;                   /**< Rows of the register tile */
+    uint64_t nr;                   /**< Columns of the register tile */
+    uint64_t mc;                   /**< Rows of the L2 block of A, a multiple of mr */
+    void (*run)(uint64_t kc, const tb_float* a, const tb_float* b, tb_float* acc);
+}_TBGemmKernel;
+
+/*
+ * acc = A_panel . B_panel over kc steps, A packed as MR interleaved rows and B as NR interleaved columns.
+ */
+#ifdef TB_GEMM_X86
+__attribute__((target("avx512f")))
+static void _tb_gemmMicroKernel512(uint64_t kc, const tb_float* a, const tb_float* b, tb_float* acc){
+    __m512 c[14][2];
+    uint64_t i, k;
+
+#pragma GCC unroll 14
+    for(i = 0; i < 14; i++){
+        c[i][0] = _mm512_setzero_ps();
+        c[i][1] = _mm512_setzero_ps();
+    }
+
+    for(k = 0; k < kc; k++){
+        __m512 b0 = _mm512_load_ps(b);
+        __m512 b1 = _mm512_load_ps(b + 16);
+
+#pragma GCC unroll 14
+        for(i = 0; i < 14; i++){
+            __m512 av = _mm512_set1_ps(a[i]);
+            c[i][0] = _mm512_fmadd_ps(av, b0, c[i][0]);
+            c[i][1] = _mm512_fmadd_ps(av, b1, c[i][1]);
+        }
+
+        a += 14;
+        b += 32;
+    }
+
+#pragma GCC unroll 14
+    for(i = 0; i < 14; i++){
+        _mm512_store_ps(acc + i*32, c[i][0]);
+        _mm512_store_ps(acc + i*32 + 16, c[i][1]);
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void _tb_gemmMicroKernel256(uint64_t kc, const tb_float* a, const tb_float* b, tb_float* acc){
+    __m256 c[6][2];
+    uint64_t i, k;
+
+#pragma GCC unroll 6
+    for(i = 0; i < 6; i++){
+        c[i][0] = _mm256_setzero_ps();
+        c[i][1] = _mm256_setzero_ps();
+    }
+
+    for(k = 0; k < kc; k++){
+        __m256 b0 = _mm256_load_ps(b);
+        __m256 b1 = _mm256_load_ps(b + 8);
+
+#pragma GCC unroll 6
+        for(i = 0; i < 6; i++){
+            __m256 av = _mm256_broadcast_ss(a + i);
+            c[i][0] = _mm256_fmadd_ps(av, b0, c[i][0]);
+            c[i][1] = _mm256_fmadd_ps(av, b1, c[i][1]);
+        }
+
+        a += 6;
+        b += 16;
+    }
+
+#pragma GCC unroll 6
+    for(i = 0; i < 6; i++){
+        _mm256_store_ps(acc + i*16, c[i][0]);
+        _mm256_store_ps(acc + i*16 + 8, c[i][1]);
+    }
+}
+#endif
+
+static void _tb_gemmMicroKernelPortable(uint64_t kc, const tb_float* a, const tb_float* b, tb_float* acc){
+    uint64_t i, j, k;
+
+    memset(acc, 0, 4*8*sizeof(tb_float));
+
+    for(k = 0; k < kc; k++){
+#pragma GCC unroll 4
+        for(i = 0; i < 4; i++)
+            for(j = 0; j < 8; j++)
+                acc[i*8 + j] += a[i]*b[j];
+
+        a += 4;
+        b += 8;
+    }
+}
+
+/*
+ * Widest micro-kernel the CPU runs, checked on every product so that a restriction of the features applies at once.
+ */
+static _TBGemmKernel _tb_gemmKernel(void){
+#ifdef TB_GEMM_X86
+    if(nda_cpuHas(NDA_CPU_AVX512F)){
+        _TBGemmKernel kernel = {14, 32, 168, _tb_gemmMicroKernel512};
+        return kernel;
+    }
+
+    if(nda_cpuHas(NDA_CPU_AVX2 | NDA_CPU_FMA)){
+        _TBGemmKernel kernel = {6, 16, 144, _tb_gemmMicroKernel256};
+        return kernel;
+    }
+#endif
+
+    _TBGemmKernel kernel = {4, 8, 128, _tb_gemmMicroKernelPortable};
+    return kernel;
+}
+
+/*
+ * Packs the block op(A)[i0:i0+mc, p0:p0+kc] as micro-panels of mr rows, element (i, k) of a panel at k*mr + i.
+ * alpha is folded in here, rows past the end are zero.
+ */
+static void _tb_gemmPackA(uint64_t mr, uint8_t trans, const tb_float* A, uint64_t lda, uint64_t i0, uint64_t mc,
+                          uint64_t p0, uint64_t kc, tb_float alpha, tb_float* ap){
+    uint64_t ir, i, k;
+
+    for(ir = 0; ir < mc; ir += mr){
+        uint64_t rows = (mc - ir < mr) ? mc - ir : mr;
+        tb_float* panel = ap + ir*kc;
+
+        for(k = 0; k < kc; k++){
+            for(i = 0; i < rows; i++){
+                uint64_t r = i0 + ir + i, c = p0 + k;
+                panel[k*mr + i] = alpha*(trans ? A[c*lda + r] : A[r*lda + c]);
+            }
+            for(; i < mr; i++)
+                panel[k*mr + i] = 0;
+        }
+    }
+}
+
+/*
+ * Packs the block op(B)[p0:p0+kc, j0:j0+nc] as micro-panels of nr columns, element (k, j) of a panel at k*nr + j.
+ * Columns past the end are zero.
+ */
+static void _tb_gemmPackB(uint64_t nr, uint8_t trans, const tb_float* B, uint64_t ldb, uint64_t p0, uint64_t kc,
+                          uint64_t j0, uint64_t nc, tb_float* bp){
+    uint64_t jr, j, k;
+
+    for(jr = 0; jr < nc; jr += nr){
+        uint64_t cols = (nc - jr < nr) ? nc - jr : nr;
+        tb_float* panel = bp + jr*kc;
+
+        for(k = 0; k < kc; k++){
+            uint64_t r = p0 + k;
+
+            if(!trans && (cols == nr)){
+                memcpy(panel + k*nr, B + r*ldb + j0 + jr, nr*sizeof(tb_float));
+                continue;
+            }
+
+            for(j = 0; j < cols; j++){
+                uint64_t c = j0 + jr + j;
+                panel[k*nr + j] = trans ? B[c*ldb + r] : B[r*ldb + c];
+            }
+            for(; j < nr; j++)
+                panel[k*nr + j] = 0;
+        }
+    }
+}
+
+/*
+ * Packing buffers of a thread, allocated by its first product and kept until it exits
+ */
+typedef struct _TBGemmBuffers{
+    tb_float* ap;                  /**< MC x KC block of A */
+    tb_float* bp;                  /**< KC x NC block of B */
+    uint8_t* qa;                   /**< Block of packed rows of a quantized A, grown to the largest reduction */
+    uint64_t qa_size;              /**< Bytes of `qa` */
+    int8_t* qb;                    /**< Quantized B packed by the thread, grown to the largest one */
+    uint64_t qb_size;              /**< Bytes of `qb` */
+    int32_t* qsum;                 /**< Column sums of `qb` */
+    uint64_t qsum_size;            /**< Bytes of `qsum` */
+}_TBGemmBuffers;
+
+static __thread _TBGemmBuffers* _tb_gemmThreadBuffers = NULL;
+static pthread_key_t _tb_gemmBuffersKey;
+static pthread_once_t _tb_gemmBuffersOnce = PTHREAD_ONCE_INIT;
+
+static void _tb_gemmFreeBuffers(void* arg){
+    _TBGemmBuffers* buffers = (_TBGemmBuffers*)arg;
+
+    free(buffers->ap);
+    free(buffers->bp);
+    free(buffers->qa);
+    free(buffers->qb);
+    free(buffers->qsum);
+    free(buffers);
+}
+
+static void _tb_gemmCreateBuffersKey(void){
+    pthread_key_create(&_tb_gemmBuffersKey, _tb_gemmFreeBuffers);
+}
+
+static _TBGemmBuffers* _tb_gemmBuffers(void){
+    if(_tb_gemmThreadBuffers != NULL)
+        return _tb_gemmThreadBuffers;
+
+    _TBGemmBuffers* buffers = calloc(1, sizeof(_TBGemmBuffers));
+    buffers->ap = aligned_alloc(64, TB_GEMM_MAX_MC*TB_GEMM_KC*sizeof(tb_float));
+    buffers->bp = aligned_alloc(64, ((TB_GEMM_NC + TB_GEMM_MAX_NR - 1)/TB_GEMM_MAX_NR)*TB_GEMM_MAX_NR*TB_GEMM_KC*sizeof(tb_float));
+
+    // the key only frees the buffers when the thread exits
+    pthread_once(&_tb_gemmBuffersOnce, _tb_gemmCreateBuffersKey);
+    pthread_setspecific(_tb_gemmBuffersKey, buffers);
+    _tb_gemmThreadBuffers = buffers;
+
+    return buffers;
+}
+
+/*
+ * Buffer of at least `bytes` bytes, only reallocated when it has to grow.
+ */
+static void* _tb_gemmGrow(void* buffer, uint64_t* size, uint64_t bytes){
+    if(bytes <= *size)
+        return buffer;
+
+    free(buffer);
+    *size = (bytes + 63) & ~(uint64_t)63;
+
+    return aligned_alloc(64, *size);
+}
+
+static inline tb_float _tb_gemmActivate(TBGemmActivation activation, tb_float x){
+    switch(activation){
+        case TBGA_RELU:
+            return (x > 0) ? x : 0;
+        case TBGA_SIGMOID:
+            return 1/(1 + exp(-x));
+        case TBGA_TANH:
+            return tanh(x);
+        case TBGA_NONE:
+            break;
+    }
+
+    return x;
+}
+
+typedef struct _TBGemmTask{
+    uint8_t transA, transB;
+    uint64_t M, N, K;              /**< Dimensions of the sub-product given to the worker */
+    tb_float alpha;
+    const tb_float* A;             /**< First row of the sub-product */
+    uint64_t lda;
+    const tb_float* B;             /**< First column of the sub-product */
+    uint64_t ldb;
+    tb_float* C;                   /**< First element of the output block */
+    uint64_t ldc;
+    const tb_float* bias;          /**< Bias of the first column, NULL for none */
+    TBGemmActivation activation;
+    _TBGemmKernel kernel;          /**< Micro-kernel */
+}_TBGemmTask;
+
+/*
+ * Goto's loop nest over one output block: NC columns, then KC reductions (packing B once), then MC rows
+ * (packing A once), then the NR x MR register tiles. C already holds beta*C, the epilogue is applied to each
+ * tile when its last reduction block is added.
+ */
+static void* _tb_gemmWorker(void* arg){
+    _TBGemmTask* t = (_TBGemmTask*)arg;
+    _TBGemmBuffers* buffers = _tb_gemmBuffers();
+    tb_float* ap = buffers->ap;
+    tb_float* bp = buffers->bp;
+    tb_float acc[TB_GEMM_MAX_MR*TB_GEMM_MAX_NR] __attribute__((aligned(64)));
+    uint64_t mr = t->kernel.mr, nr = t->kernel.nr, mc_max = t->kernel.mc;
+    uint64_t jc, pc, ic, jr, ir, i, j;
+
+    for(jc = 0; jc < t->N; jc += TB_GEMM_NC){
+        uint64_t nc = (t->N - jc < TB_GEMM_NC) ? t->N - jc : TB_GEMM_NC;
+
+        for(pc = 0; pc < t->K; pc += TB_GEMM_KC){
+            uint64_t kc = (t->K - pc < TB_GEMM_KC) ? t->K - pc : TB_GEMM_KC;
+            uint8_t last = (pc + kc == t->K);
+            _tb_gemmPackB(nr, t->transB, t->B, t->ldb, pc, kc, jc, nc, bp);
+
+            for(ic = 0; ic < t->M; ic += mc_max){
+                uint64_t mc = (t->M - ic < mc_max) ? t->M - ic : mc_max;
+                _tb_gemmPackA(mr, t->transA, t->A, t->lda, ic, mc, pc, kc, t->alpha, ap);
+
+                for(jr = 0; jr < nc; jr += nr){
+                    uint64_t cols = (nc - jr < nr) ? nc - jr : nr;
+
+                    for(ir = 0; ir < mc; ir += mr){
+                        uint64_t rows = (mc - ir < mr) ? mc - ir : mr;
+                        tb_float* c = t->C + (ic + ir)*t->ldc + jc + jr;
+
+                        t->kernel.run(kc, ap + ir*kc, bp + jr*kc, acc);
+
+                        for(i = 0; i < rows; i++){
+                            tb_float* ci = c + i*t->ldc;
+                            const tb_float* ai = acc + i*nr;
+
+                            for(j = 0; j < cols; j++)
+                                ci[j] += ai[j];
+
+                            if(last && (t->bias != NULL))
+                                for(j = 0; j < cols; j++)
+                                    ci[j] += t->bias[jc + jr + j];
+                            if(last && (t->activation != TBGA_NONE))
+                                for(j = 0; j < cols; j++)
+                                    ci[j] = _tb_gemmActivate(t->activation, ci[j]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+void tb_gemm(TBThreadPool* pool, uint64_t threads, uint8_t transA, uint8_t transB, uint64_t M, uint64_t N, uint64_t K,
+             tb_float alpha, const tb_float* A, uint64_t lda, const tb_float* B, uint64_t ldb,
+             tb_float beta, tb_float* C, uint64_t ldc, const TBGemmEpilogue* epilogue){
+    const tb_float* bias = (epilogue != NULL) ? epilogue->bias : NULL;
+    TBGemmActivation activation = (epilogue != NULL) ? epilogue->activation : TBGA_NONE;
+    uint64_t i, j;
+
+    if((M == 0) || (N == 0))
+        return;
+
+    for(i = 0; i < M; i++){
+        tb_float* ci = C + i*ldc;
+
+        if(beta == 0)
+            memset(ci, 0, N*sizeof(tb_float));
+        else if(beta != 1)
+            for(j = 0; j < N; j++)
+                ci[j] *= beta;
+
+        // without a reduction the epilogue has no tile to ride on
+        if(K == 0)
+            for(j = 0; j < N; j++)
+                ci[j] = _tb_gemmActivate(activation, ci[j] + ((bias != NULL) ? bias[j] : 0));
+    }
+
+    if(K == 0)
+        return;
+
+    // output split along its longest side, in whole register tiles
+    if(threads == 0)
+        threads = (uint64_t)sysconf(_SC_NPROCESSORS_ONLN);
+    if(threads > (M*N*K)/TB_GEMM_GRAIN)
+        threads = (M*N*K)/TB_GEMM_GRAIN;
+
+    _TBGemmKernel kernel = _tb_gemmKernel();
+    uint8_t byRows = (M/kernel.mr >= N/kernel.nr);
+    uint64_t tile = byRows ? kernel.mr : kernel.nr;
+    uint64_t tiles = ((byRows ? M : N) + tile - 1)/tile;
+
+    if(threads > tiles)
+        threads = tiles;
+    if(threads == 0)
+        threads = 1;
+
+    _TBGemmTask tasks[threads];
+
+    for(i = 0; i < threads; i++){
+        uint64_t t0 = ((tiles*i)/threads)*tile, t1 = ((tiles*(i + 1))/threads)*tile;
+        uint64_t len = (byRows ? M : N);
+        t1 = (t1 > len) ? len : t1;
+
+        _TBGemmTask task = {transA, transB, byRows ? t1 - t0 : M, byRows ? N : t1 - t0, K, alpha,
+                            A + (byRows ? (transA ? t0 : t0*lda) : 0), lda,
+                            B + (byRows ? 0 : (transB ? t0*ldb : t0)), ldb,
+                            C + (byRows ? t0*ldc : t0), ldc,
+                            (bias != NULL) ? bias + (byRows ? 0 : t0) : NULL, activation, kernel};
+        tasks[i] = task;
+    }
+
+    tb_poolRun(pool, threads, _tb_gemmWorker, tasks, sizeof(_TBGemmTask));
+}
+
+void tb_cblasGemm(CBLAS_ORDER order, CBLAS_TRANSPOSE transA, CBLAS_TRANSPOSE transB, int M, int N, int K,
+                  tb_float alpha, const tb_float* A, int lda, const tb_float* B, int ldb,
+                  tb_float beta, tb_float* C, int ldc){
+    // a column-major C is the row-major C^T = op(B)^T . op(A)^T
+    if(order == CblasColMajor){
+        tb_gemm(NULL, 0, transB != CblasNoTrans, transA != CblasNoTrans, N, M, K, alpha, B, ldb, A, lda, beta, C, ldc, NULL);
+        return;
+    }
+
+    tb_gemm(NULL, 0, transA != CblasNoTrans, transB != CblasNoTrans, M, N, K, alpha, A, lda, B, ldb, beta, C, ldc, NULL);
+}
+
+/*
+ * Quantized GEMM. A panel of B holds NR columns over the whole reduction, packed by groups of 4 rows so that a
+ * 32 bits lane holds 4 consecutive values of a column (the operand layout of `vpdpbusd`). An MR x NR int32 tile is
+ * accumulated over the whole reduction and dequantized at once, the MC rows of A packed by a thread stay in L2.
+ * The layout of B does not depend on the micro-kernel, so a packed B outlives a restriction of the CPU features.
+ */
+#define TB_QGEMM_NR 16
+/* Largest MR of the micro-kernels */
+#define TB_QGEMM_MAX_MR 12
+/* Bytes of the block of packed rows of A */
+#define TB_QGEMM_MC_BYTES 262144
+/* Minimum number of multiply-adds given to each thread */
+#define TB_QGEMM_GRAIN 1048576
+
+typedef struct _TBQGemmKernel{
+    uint64_t mr;                   /**< Rows of the register tile */
+    void (*run)(uint64_t kp, const uint8_t* a, const int8_t* b, int32_t* acc);
+}_TBQGemmKernel;
+
+/* Reduction of the panels, rounded up to the groups of 4 and never empty */
+static inline uint64_t _tb_qgemmDepth(uint64_t K){
+    return (K == 0) ? 4 : (K + 3) & ~(uint64_t)3;
+}
+
+static inline int32_t _tb_qgemmLoad4(const uint8_t* a){
+    int32_t v;
+    memcpy(&v, a, sizeof(int32_t));
+
+    return v;
+}
+
+/*
+ * acc = A_panel . B_panel over kp reductions, A packed as groups of 4 values of MR interleaved rows, B as groups of
+ * 4 values of NR interleaved columns.
+ */
+#ifdef TB_GEMM_X86
+__attribute__((target("avx512f,avx512vnni")))
+static void _tb_qgemmMicroKernelVNNI512(uint64_t kp, const uint8_t* a, const int8_t* b, int32_t* acc){
+    __m512i c[12];
+    uint64_t i, k;
+
+#pragma GCC unroll 12
+    for(i = 0; i < 12; i++)
+        c[i] = _mm512_setzero_si512();
+
+    for(k = 0; k < kp; k += 4){
+        __m512i bv = _mm512_loadu_si512((const void*)b);
+
+#pragma GCC unroll 12
+        for(i = 0; i < 12; i++)
+            c[i] = _mm512_dpbusd_epi32(c[i], _mm512_set1_epi32(_tb_qgemmLoad4(a + 4*i)), bv);
+
+        a += 48;
+        b += 64;
+    }
+
+#pragma GCC unroll 12
+    for(i = 0; i < 12; i++)
+        _mm512_storeu_si512((void*)(acc + i*16), c[i]);
+}
+
+__attribute__((target("avx2,avxvnni")))
+static void _tb_qgemmMicroKernelVNNI256(uint64_t kp, const uint8_t* a, const int8_t* b, int32_t* acc){
+    __m256i c[6][2];
+    uint64_t i, k;
+
+#pragma GCC unroll 6
+    for(i = 0; i < 6; i++){
+        c[i][0] = _mm256_setzero_si256();
+        c[i][1] = _mm256_setzero_si256();
+    }
+
+    for(k = 0; k < kp; k += 4){
+        __m256i b0 = _mm256_loadu_si256((const __m256i*)b);
+        __m256i b1 = _mm256_loadu_si256((const __m256i*)(b + 32));
+
+#pragma GCC unroll 6
+        for(i = 0; i < 6; i++){
+            __m256i av = _mm256_set1_epi32(_tb_qgemmLoad4(a + 4*i));
+            c[i][0] = _mm256_dpbusd_avx_epi32(c[i][0], av, b0);
+            c[i][1] = _mm256_dpbusd_avx_epi32(c[i][1], av, b1);
+        }
+
+        a += 24;
+        b += 64;
+    }
+
+#pragma GCC unroll 6
+    for(i = 0; i < 6; i++){
+        _mm256_storeu_si256((__m256i*)(acc + i*16), c[i][0]);
+        _mm256_storeu_si256((__m256i*)(acc + i*16 + 8), c[i][1]);
+    }
+}
+
+/*
+ * Without VNNI both operands are widened to 16 bits before `madd_epi16` instead of using `maddubs_epi16`, whose
+ * 16 bits pair sums saturate on full range operands. Each column keeps two pair sums until the end.
+ */
+__attribute__((target("avx2")))
+static void _tb_qgemmMicroKernel256(uint64_t kp, const uint8_t* a, const int8_t* b, int32_t* acc){
+    __m256i c[3][4];
+    uint64_t i, q, k;
+
+#pragma GCC unroll 3
+    for(i = 0; i < 3; i++)
+        for(q = 0; q < 4; q++)
+            c[i][q] = _mm256_setzero_si256();
+
+    for(k = 0; k < kp; k += 4){
+        __m256i av[3];
+
+#pragma GCC unroll 3
+        for(i = 0; i < 3; i++)
+            av[i] = _mm256_cvtepu8_epi16(_mm_set1_epi32(_tb_qgemmLoad4(a + 4*i)));
+
+#pragma GCC unroll 4
+        for(q = 0; q < 4; q++){
+            __m256i bq = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(b + 16*q)));
+
+#pragma GCC unroll 3
+            for(i = 0; i < 3; i++)
+                c[i][q] = _mm256_add_epi32(c[i][q], _mm256_madd_epi16(av[i], bq));
+        }
+
+        a += 12;
+        b += 64;
+    }
+
+    // the pair sums of columns 0-3 and 4-7 are added in 128 bits lanes, leaving columns 0 1 4 5 | 2 3 6 7
+#pragma GCC unroll 3
+    for(i = 0; i < 3; i++){
+        for(q = 0; q < 4; q += 2){
+            __m256i sum = _mm256_hadd_epi32(c[i][q], c[i][q + 1]);
+            sum = _mm256_permute4x64_epi64(sum, _MM_SHUFFLE(3, 1, 2, 0));
+            _mm256_storeu_si256((__m256i*)(acc + i*16 + 4*q), sum);
+        }
+    }
+}
+#endif
+
+static void _tb_qgemmMicroKernelPortable(uint64_t kp, const uint8_t* a, const int8_t* b, int32_t* acc){
+    uint64_t i, j, k, l;
+
+    memset(acc, 0, 4*TB_QGEMM_NR*sizeof(int32_t));
+
+    for(k = 0; k < kp; k += 4){
+        for(i = 0; i < 4; i++)
+            for(j = 0; j < TB_QGEMM_NR; j++)
+                for(l = 0; l < 4; l++)
+                    acc[i*TB_QGEMM_NR + j] += (int32_t)a[4*i + l]*(int32_t)b[4*j + l];
+
+        a += 16;
+        b += 4*TB_QGEMM_NR;
+    }
+}
+
+/*
+ * Widest micro-kernel the CPU runs, checked on every product so that a restriction of the features applies at once.
+ */
+static _TBQGemmKernel _tb_qgemmKernel(void){
+#ifdef TB_GEMM_X86
+    if(nda_cpuHas(NDA_CPU_AVX512F | NDA_CPU_AVX512VNNI)){
+        _TBQGemmKernel kernel = {12, _tb_qgemmMicroKernelVNNI512};
+        return kernel;
+    }
+
+    if(nda_cpuHas(NDA_CPU_AVX2 | NDA_CPU_AVXVNNI)){
+        _TBQGemmKernel kernel = {6, _tb_qgemmMicroKernelVNNI256};
+        return kernel;
+    }
+
+    if(nda_cpuHas(NDA_CPU_AVX2)){
+        _TBQGemmKernel kernel = {3, _tb_qgemmMicroKernel256};
+        return kernel;
+    }
+#endif
+
+    _TBQGemmKernel kernel = {4, _tb_qgemmMicroKernelPortable};
+    return kernel;
+}
+
+/*
+ * Packs the rows [i0, i0+mc) of A as micro-panels of mr rows, element (i, k) of a panel at (k/4)*4*mr + 4*i + k%4.
+ * Rows past the end and the reduction past K are zero.
+ */
+static void _tb_qgemmPackA(uint64_t mr, const uint8_t* A, uint64_t lda, uint64_t i0, uint64_t mc, uint64_t K,
+                           uint64_t kp, uint8_t* ap){
+    uint64_t ir, i, k;
+
+    for(ir = 0; ir < mc; ir += mr){
+        uint64_t rows = (mc - ir < mr) ? mc - ir : mr;
+        uint8_t* panel = ap + ir*kp;
+
+        for(i = 0; i < mr; i++){
+            const uint8_t* src = (i < rows) ? A + (i0 + ir + i)*lda : NULL;
+
+            for(k = 0; k < kp; k++)
+                panel[(k/4)*4*mr + 4*i + k%4] = ((src != NULL) && (k < K)) ? src[k] : 0;
+        }
+    }
+}
+
+/*
+ * Packs B in the layout of `TBQGemmPacked`, `panels` holds the panels of every column rounded up to NR.
+ */
+static void _tb_qgemmPackB(const int8_t* B, uint64_t rs, uint64_t cs, uint64_t K, uint64_t N, int8_t* panels, int32_t* colsum){
+    uint64_t kp = _tb_qgemmDepth(K);
+    uint64_t n, k;
+
+    memset(panels, 0, ((N + TB_QGEMM_NR - 1)/TB_QGEMM_NR)*TB_QGEMM_NR*kp);
+
+    for(n = 0; n < N; n++){
+        int8_t* panel = panels + (n/TB_QGEMM_NR)*TB_QGEMM_NR*kp + 4*(n%TB_QGEMM_NR);
+        int32_t sum = 0;
+
+        for(k = 0; k < K; k++){
+            int8_t v = B[k*rs + n*cs];
+            panel[(k/4)*4*TB_QGEMM_NR + k%4] = v;
+            sum += v;
+        }
+
+        colsum[n] = sum;
+    }
+}
+
+TBQGemmPacked* tb_qgemmPack(const int8_t* B, uint64_t rs, uint64_t cs, uint64_t K, uint64_t N){
+    TBQGemmPacked* packed = calloc(1, sizeof(TBQGemmPacked));
+    packed->K = K;
+    packed->N = N;
+    packed->panels = nda_memCalloc(((N + TB_QGEMM_NR - 1)/TB_QGEMM_NR)*TB_QGEMM_NR*_tb_qgemmDepth(K), sizeof(int8_t));
+    packed->colsum = nda_memCalloc(N, sizeof(int32_t));
+
+    _tb_qgemmPackB(B, rs, cs, K, N, packed->panels, packed->colsum);
+
+    return packed;
+}
+
+void tb_qgemmFreePacked(TBQGemmPacked* packed){
+    nda_memFree(packed->panels);
+    nda_memFree(packed->colsum);
+    free(packed);
+}
+
+/*
+ * Same rounding as `nda_quantizeInto`, so fused and unfused requantizations agree.
+ */
+static inline void _tb_qgemmStore(const TBQGemmOutput* out, uint64_t i, uint64_t j, int32_t acc){
+    float v = (float)acc*out->lhs_scale*out->rhs_scales[out->per_channel ? j : 0];
+
+    if(out->dtype == NDA_DTYPE_FLOAT){
+        ((tb_float*)out->C)[i*out->ldc + j] = v;
+        return;
+    }
+
+    int32_t lo = (out->dtype == NDA_DTYPE_U8) ? 0 : -128;
+    int32_t hi = (out->dtype == NDA_DTYPE_U8) ? 255 : 127;
+
+    v = v*out->inv_scale;
+    v = (v < (float)(lo - out->zero_point)) ? (float)(lo - out->zero_point) : ((v > (float)(hi - out->zero_point)) ? (float)(hi - out->zero_point) : v);
+
+    int32_t q = (int32_t)((v >= 0) ? v + 0.5f : v - 0.5f) + out->zero_point;
+
+    if(out->dtype == NDA_DTYPE_U8)
+        ((uint8_t*)out->C)[i*out->ldc + j] = (uint8_t)q;
+    else
+        ((int8_t*)out->C)[i*out->ldc + j] = (int8_t)q;
+}
+
+typedef struct _TBQGemmTask{
+    uint64_t M, N, K;              /**< Dimensions of the sub-product given to the worker */
+    const uint8_t* A;              /**< First row of the sub-product */
+    uint64_t lda;
+    int32_t za;
+    const int8_t* panels;          /**< Panel of the first column */
+    const int32_t* colsum;         /**< Sum of the first column */
+    TBQGemmOutput out;             /**< Output from the first element of the block */
+    _TBQGemmKernel kernel;         /**< Micro-kernel */
+}_TBQGemmTask;
+
+/*
+ * MC rows (packing A once), then the NR x MR register tiles over the whole reduction.
+ */
+static void* _tb_qgemmWorker(void* arg){
+    _TBQGemmTask* t = (_TBQGemmTask*)arg;
+    _TBGemmBuffers* buffers = _tb_gemmBuffers();
+    int32_t acc[TB_QGEMM_MAX_MR*TB_QGEMM_NR] __attribute__((aligned(64)));
+    uint64_t mr = t->kernel.mr, kp = _tb_qgemmDepth(t->K);
+    uint64_t mc_max = ((TB_QGEMM_MC_BYTES/kp)/mr)*mr;
+    uint64_t ic, jr, ir, i, j;
+
+    mc_max = (mc_max < mr) ? mr : mc_max;
+    buffers->qa = _tb_gemmGrow(buffers->qa, &buffers->qa_size, mc_max*kp);
+
+    for(ic = 0; ic < t->M; ic += mc_max){
+        uint64_t mc = (t->M - ic < mc_max) ? t->M - ic : mc_max;
+        _tb_qgemmPackA(mr, t->A, t->lda, ic, mc, t->K, kp, buffers->qa);
+
+        for(jr = 0; jr < t->N; jr += TB_QGEMM_NR){
+            uint64_t cols = (t->N - jr < TB_QGEMM_NR) ? t->N - jr : TB_QGEMM_NR;
+            const int8_t* panel = t->panels + jr*kp;
+
+            for(ir = 0; ir < mc; ir += mr){
+                uint64_t rows = (mc - ir < mr) ? mc - ir : mr;
+
+                t->kernel.run(kp, buffers->qa + ir*kp, panel, acc);
+
+                // sum_k (a - za)*b = sum_k a*b - za*sum_k b
+                for(i = 0; i < rows; i++)
+                    for(j = 0; j < cols; j++)
+                        _tb_qgemmStore(&t->out, ic + ir + i, jr + j, acc[i*TB_QGEMM_NR + j] - t->za*t->colsum[jr + j]);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+void tb_qgemm(TBThreadPool* pool, uint64_t threads, uint64_t M, uint64_t N, uint64_t K,
+              const uint8_t* A, uint64_t lda, int32_t za, const int8_t* B, uint64_t rs, uint64_t cs,
+              const TBQGemmPacked* packed, const TBQGemmOutput* out){
+    uint64_t kp = _tb_qgemmDepth(K);
+    uint64_t i;
+
+    if((M == 0) || (N == 0))
+        return;
+
+    TBQGemmPacked local;
+
+    if(packed == NULL){
+        _TBGemmBuffers* buffers = _tb_gemmBuffers();
+        buffers->qb = _tb_gemmGrow(buffers->qb, &buffers->qb_size, ((N + TB_QGEMM_NR - 1)/TB_QGEMM_NR)*TB_QGEMM_NR*kp);
+        buffers->qsum = _tb_gemmGrow(buffers->qsum, &buffers->qsum_size, N*sizeof(int32_t));
+        _tb_qgemmPackB(B, rs, cs, K, N, buffers->qb, buffers->qsum);
+
+        TBQGemmPacked own = {K, N, buffers->qb, buffers->qsum};
+        local = own;
+        packed = &local;
+    }
+
+    // output split along its longest side, in whole register tiles
+    if(threads == 0)
+        threads = (uint64_t)sysconf(_SC_NPROCESSORS_ONLN);
+    if(threads > (M*N*K)/TB_QGEMM_GRAIN)
+        threads = (M*N*K)/TB_QGEMM_GRAIN;
+
+    _TBQGemmKernel kernel = _tb_qgemmKernel();
+    uint8_t byRows = (M/kernel.mr >= N/TB_QGEMM_NR);
+    uint64_t tile = byRows ? kernel.mr : TB_QGEMM_NR;
+    uint64_t tiles = ((byRows ? M : N) + tile - 1)/tile;
+    uint64_t size = (out->dtype == NDA_DTYPE_FLOAT) ? sizeof(tb_float) : sizeof(int8_t);
+
+    if(threads > tiles)
+        threads = tiles;
+    if(threads == 0)
+        threads = 1;
+
+    _TBQGemmTask tasks[threads];
+
+    for(i = 0; i < threads; i++){
+        uint64_t t0 = ((tiles*i)/threads)*tile, t1 = ((tiles*(i + 1))/threads)*tile;
+        uint64_t len = (byRows ? M : N);
+        t1 = (t1 > len) ? len : t1;
+
+        TBQGemmOutput o = *out;
+        o.C = (uint8_t*)out->C + (byRows ? t0*out->ldc : t0)*size;
+        o.rhs_scales = out->rhs_scales + ((!byRows && out->per_channel) ? t0 : 0);
+
+        _TBQGemmTask task = {byRows ? t1 - t0 : M, byRows ? N : t1 - t0, K, A + (byRows ? t0*lda : 0), lda, za,
+                             packed->panels + (byRows ? 0 : t0*kp), packed->colsum + (byRows ? 0 : t0), o, kernel};
+        tasks[i] = task;
+    }
+
+    tb_poolRun(pool, threads, _tb_qgemmWorker, tasks, sizeof(_TBQGemmTask));
+}
+
+#undef TB_QGEMM_NR
+#undef TB_QGEMM_MAX_MR
+#undef TB_QGEMM_MC_BYTES
+#undef TB_QGEMM_GRAIN
+
+#undef TB_GEMM_KC
+#undef TB_GEMM_NC
+#undef TB_GEMM_MAX_MC
+#undef TB_GEMM_MAX_MR
+#undef TB_GEMM_MAX_NR
+#undef TB_GEMM_GRAIN
@@ -46,9 +46,15 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <inttypes.h>
+#include <pthread.h>
 
 #include <tb_operation.h>
 #include <tb_graph.h>
+#include <tb_factory.h>
+#include <tb_session_cpu.h>
+#include <tb_shape.h>
+#include <ndarray_io.h>
 #include <map.h>
 #include <vec.h>
 
@@ -74,37 +80,339 @@ TBGraph* tb_newGraph(char* name, TBNode* rootNode){
     graph->root = rootNode;
 
     map_init(&graph->vars);
+    map_init(&graph->slot_ids);
 
     vec_init(&graph->nodes);
+    vec_init(&graph->slots);
+    vec_init(&graph->feeds);
 
     tb_storeNodesInGraph(graph, rootNode);
     
     return graph;
 }
 
-// TODO:
-void tb_freeGraph(TBGraph* graph){
+/*
+ * Frees a graph structure and its state, its nodes are freed by the caller
+ */
+static void _tb_freeGraphState(TBGraph* graph){
+    int i = 0;
+    
+    _tb_releaseGraphContext(graph);
+    
+    // fed values belong to the caller, feeds borrow them
+    for(; i < graph->feeds.length; i++){
+        if(graph->feeds.data[i] != NULL){
+            tb_freeNode(graph, graph->feeds.data[i]);
+            free(graph->feeds.data[i]);
+        }
+    }
+    
+    if(graph->archive != NULL){
+        nda_closeArchive(graph->archive);
+    }
+    
+    if(graph->shapes != NULL){
+        tb_freeGraphShapes(graph->shapes);
+    }
+    
+    if(graph->owns_names){
+        free(graph->name);
+    }
+    
+    map_deinit(&graph->vars);
+    map_deinit(&graph->slot_ids);
+    vec_deinit(&graph->nodes);
+    vec_deinit(&graph->slots);
+    vec_deinit(&graph->feeds);
+    free(graph);
+}
 
+void tb_freeGraph(TBGraph* graph){
+    // nodes are only collected by the compilation
+    if(graph->nodes.length == 0){
+        tb_storeNodesInGraph(graph, graph->root);
+    }
+    
+    int i = 0;
+    for(; i < graph->nodes.length; i++){
+        TBNode* node = graph->nodes.data[i];
+        int idx = -1;
+        
+        if(graph->base != NULL){
+            vec_find(&graph->base->nodes, node, idx);
+            if(idx != -1)
+                continue;
+        }
+        
+        if((node->type == TBNT_VARIABLE) && graph->owns_names){
+            free(((TBVariable*)node->nodePtr)->name);
+        }
+        else if(node->type == TBNT_GRAPH){
+            // the nodes of a nested graph are collected along with ours
+            TBGraphNode* graphNode = (TBGraphNode*)node->nodePtr;
+            TBGraphNodeParam** params = graphNode->params;
+            
+            if(graphNode->graph->owns_names && (params != NULL)){
+                uint64_t j = 0;
+                for(; params[j]->node != NULL; j++){
+                    free(params[j]->var_name);
+                    free(params[j]);
+                }
+                free(params[j]);
+                free(params);
+            }
+            
+            _tb_freeGraphState(graphNode->graph);
+        }
+        
+        tb_freeNode(graph, node);
+        free(node);
+    }
+    
+    _tb_freeGraphState(graph);
 }
 
 void tb_graphSetVar(TBGraph* graph, TBNode* node, const char* name){
-    TBNode** old = map_get(&graph->vars, name);
-    if(old != NULL){
-        //freeNode(graph, *old);
-        //free(*old);
-        map_remove(&graph->vars, name);
+    if(graph->compiled){
+        uint64_t* slot = map_get(&graph->slot_ids, name);
+        if(slot != NULL){
+            graph->slots.data[*slot] = node;
+            return;
+        }
     }
 
-    /*int res = */map_set(&graph->vars, name, node);
+    map_set(&graph->vars, name, node);
 }
 
 TBNode* tb_graphGetVar(TBGraph* graph, const char* name){
+    if(graph->compiled){
+        uint64_t* slot = map_get(&graph->slot_ids, name);
+        if(slot != NULL){
+            return graph->slots.data[*slot];
+        }
+    }
+    
     TBNode** noderef = map_get(&graph->vars, name);
     if (noderef == NULL)
         return NULL;
     return *noderef;
 }
 
+/*
+ * Serializes the compilations, run once per graph
+ */
+static pthread_mutex_t _tb_compileLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void _tb_compile(TBGraph* graph);
+
+/*
+ * Assigns slots to the variables reachable from the given node. Nested graphs are not traversed,
+ * their variables are resolved by their own compilation.
+ */
+static void _tb_assignSlots(TBGraph* graph, TBNode* node, TBNode_Vec* visited){
+    int idx = -1;
+    
+    vec_find(visited, node, idx);
+    
+    if(idx != -1)
+        return;
+    
+    vec_push(visited, node);
+    
+    switch(node->type){
+        case TBNT_VARIABLE:{
+            TBVariable* var = (TBVariable*)node->nodePtr;
+            uint64_t* slot = map_get(&graph->slot_ids, var->name);
+            
+            if(slot != NULL){
+                var->slot = *slot;
+            }
+            else {
+                var->slot = graph->slots.length;
+                map_set(&graph->slot_ids, var->name, var->slot);
+                
+                TBNode** bound = map_get(&graph->vars, var->name);
+                vec_push(&graph->slots, bound != NULL?*bound:NULL);
+                vec_push(&graph->feeds, NULL);
+            }
+            break;
+        }
+        case TBNT_CONSTANT:
+            break;
+        case TBNT_GRAPH:
+            _tb_compile(((TBGraphNode*)node->nodePtr)->graph);
+            break;
+        case TBNT_BINARY_OPERATION:
+            _tb_assignSlots(graph, ((TBBinaryOperation*)node->nodePtr)->lhs, visited);
+            _tb_assignSlots(graph, ((TBBinaryOperation*)node->nodePtr)->rhs, visited);
+            break;
+        case TBNT_UNARY_OPERATION:
+            _tb_assignSlots(graph, ((TBUnaryOperation*)node->nodePtr)->uhs, visited);
+            break;
+        case TBNT_AXIS_BOUND_OPERATION:
+            _tb_assignSlots(graph, ((TBAxisBoundOperation*)node->nodePtr)->uhs, visited);
+            break;
+        case TBNT_AXES_TRANSPOSE:
+            _tb_assignSlots(graph, ((TBTransposeOperation*)node->nodePtr)->uhs, visited);
+            break;
+        case TBNT_QUANTIZATION:
+            _tb_assignSlots(graph, ((TBQuantizationOperation*)node->nodePtr)->uhs, visited);
+            break;
+        case TBNT_GATHER:
+            _tb_assignSlots(graph, ((TBGatherOperation*)node->nodePtr)->table, visited);
+            _tb_assignSlots(graph, ((TBGatherOperation*)node->nodePtr)->indices, visited);
+            break;
+        case TBNT_CROSS_ENTROPY:
+            _tb_assignSlots(graph, ((TBCrossEntropyOperation*)node->nodePtr)->logits, visited);
+            _tb_assignSlots(graph, ((TBCrossEntropyOperation*)node->nodePtr)->labels, visited);
+            break;
+        case TBNT_NORMALIZATION:{
+            TBNormalizationOperation* nop = (TBNormalizationOperation*)node->nodePtr;
+            _tb_assignSlots(graph, nop->uhs, visited);
+            if(nop->gamma != NULL)
+                _tb_assignSlots(graph, nop->gamma, visited);
+            if(nop->beta != NULL)
+                _tb_assignSlots(graph, nop->beta, visited);
+            break;
+        }
+        case TBNT_CONVOLUTION:
+            _tb_assignSlots(graph, ((TBConvolutionOperation*)node->nodePtr)->uhs, visited);
+            _tb_assignSlots(graph, ((TBConvolutionOperation*)node->nodePtr)->weights, visited);
+            break;
+        case TBNT_POOLING:
+            _tb_assignSlots(graph, ((TBPoolingOperation*)node->nodePtr)->uhs, visited);
+            break;
+        case TBNT_REORDER:
+            _tb_assignSlots(graph, ((TBReorderOperation*)node->nodePtr)->uhs, visited);
+            break;
+    }
+}
+
+/*
+ * Compiles a graph and the graphs nested in it, the caller holds `_tb_compileLock`
+ */
+static void _tb_compile(TBGraph* graph){
+    ASSERT(graph != NULL, "Cannot compile a NULL Graph");
+    ASSERT(graph->root != NULL, "Root node of the graph %s must not be NULL", graph->name);
+    
+    if(graph->compiled)
+        return;
+    
+    tb_storeNodesInGraph(graph, graph->root);
+    
+    uint64_t i = 0;
+    for(; i < (uint64_t)graph->nodes.length; i++){
+        ((TBNode*)graph->nodes.data[i])->id = i;
+    }
+    
+    TBNode_Vec visited;
+    vec_init(&visited);
+    _tb_assignSlots(graph, graph->root, &visited);
+    vec_deinit(&visited);
+    
+    __atomic_store_n(&graph->compiled, 1, __ATOMIC_RELEASE);
+}
+
+void tb_compileGraph(TBGraph* graph){
+    // graphs are compiled lazily by their first run, which may happen in several sessions at once
+    if(__atomic_load_n(&graph->compiled, __ATOMIC_ACQUIRE))
+        return;
+    
+    pthread_mutex_lock(&_tb_compileLock);
+    _tb_compile(graph);
+    pthread_mutex_unlock(&_tb_compileLock);
+}
+
+uint64_t tb_graphGetVarSlot(TBGraph* graph, const char* name){
+    tb_compileGraph(graph);
+    
+    uint64_t* slot = map_get(&graph->slot_ids, name);
+    if(slot == NULL)
+        return TB_NO_SLOT;
+    
+    return *slot;
+}
+
+uint8_t tb_graphOwnsNode(TBGraph* graph, TBNode* node){
+    return (node->id < (uint64_t)graph->nodes.length) && (graph->nodes.data[node->id] == node);
+}
+
+uint64_t tb_graphVarNodeSlot(TBGraph* graph, TBNode* node){
+    TBVariable* var = (TBVariable*)node->nodePtr;
+    
+    if(graph->compiled && tb_graphOwnsNode(graph, node)){
+        return var->slot;
+    }
+    
+    return tb_graphGetVarSlot(graph, var->name);
+}
+
+void tb_graphSetVarSlot(TBGraph* graph, uint64_t slot, TBNode* node){
+    ASSERT(slot < (uint64_t)graph->slots.length, "Slot %"PRIu64" is out of range in graph %s", slot, graph->name);
+    graph->slots.data[slot] = node;
+}
+
+void tb_graphFeedSlot(TBGraph* graph, uint64_t slot, struct NDArray* value){
+    ASSERT(slot < (uint64_t)graph->slots.length, "Slot %"PRIu64" is out of range in graph %s", slot, graph->name);
+    
+    TBNode* feed = graph->feeds.data[slot];
+    if(feed == NULL){
+        feed = tb_newBorrowedConstantNode(value);
+        graph->feeds.data[slot] = feed;
+    }
+    
+    ((TBConstant*)feed->nodePtr)->value = value;
+    graph->slots.data[slot] = feed;
+}
+
+void tb_constantChanged(TBNode* node){
+    ASSERT(node->type == TBNT_CONSTANT, "Node %"PRIu64" is not a constant", node->id);
+    
+    ((TBConstant*)node->nodePtr)->version++;
+}
+
+const char* tb_nodeOpName(TBNode* node){
+    static const char* binary[] = {"ADD", "SUB", "MULT", "DIV", "POW", "DOT"};
+    static const char* unary[] = {"MINUS", "EXP", "LOG", "SIN", "COS", "TAN", "TANH", "RELU", "SOFTPLUS", "SIGMOID", "DXRELU"};
+    static const char* axisBound[] = {"SUM", "PRODUCT", "MIN", "MAX", "MEAN", "VARIANCE", "SOFTMAX", "ARGMIN", "ARGMAX", "LOG_SOFTMAX"};
+    static const char* quantization[] = {"QUANTIZE", "DEQUANTIZE"};
+    static const char* normalization[] = {"LAYER_NORM", "BATCH_NORM"};
+    static const char* pooling[] = {"MAX_POOL", "AVG_POOL", "GLOBAL_MAX_POOL", "GLOBAL_AVG_POOL"};
+    
+    switch(node->type){
+        case TBNT_VARIABLE:
+            return "VARIABLE";
+        case TBNT_CONSTANT:
+            return "CONSTANT";
+        case TBNT_GRAPH:
+            return "GRAPH";
+        case TBNT_BINARY_OPERATION:
+            return binary[((TBBinaryOperation*)node->nodePtr)->type];
+        case TBNT_UNARY_OPERATION:
+            return unary[((TBUnaryOperation*)node->nodePtr)->type];
+        case TBNT_AXIS_BOUND_OPERATION:
+            return axisBound[((TBAxisBoundOperation*)node->nodePtr)->type];
+        case TBNT_AXES_TRANSPOSE:
+            return "TRANSPOSE";
+        case TBNT_QUANTIZATION:
+            return quantization[((TBQuantizationOperation*)node->nodePtr)->type];
+        case TBNT_GATHER:
+            return "GATHER";
+        case TBNT_CROSS_ENTROPY:
+            return "CROSS_ENTROPY";
+        case TBNT_NORMALIZATION:
+            return normalization[((TBNormalizationOperation*)node->nodePtr)->type];
+        case TBNT_CONVOLUTION:
+            return "CONVOLUTION";
+        case TBNT_POOLING:
+            return pooling[((TBPoolingOperation*)node->nodePtr)->type];
+        case TBNT_REORDER:
+            return "REORDER";
+    }
+    
+    return "UNKNOWN";
+}
+
 void tb_storeNodesInGraph(TBGraph* graph, TBNode* node){
 	int idx = -1;
 	
@@ -132,37 +440,64 @@ void tb_storeNodesInGraph(TBGraph* graph, TBNode* node){
 			tb_storeNodesInGraph(graph, ((TBUnaryOperation*)node->nodePtr)->uhs);
 			break;
 		case TBNT_GRAPH:
-			tb_storeNodesInGraph(graph, ((TBGraph*)node->nodePtr)->root);
+			tb_storeNodesInGraph(graph, ((TBGraphNode*)node->nodePtr)->graph->root);
 			break;
         case TBNT_AXES_TRANSPOSE:
             tb_storeNodesInGraph(graph, ((TBTransposeOperation*)node->nodePtr)->uhs);
             break;
+        case TBNT_QUANTIZATION:
+            tb_storeNodesInGraph(graph, ((TBQuantizationOperation*)node->nodePtr)->uhs);
+            break;
+        case TBNT_GATHER:
+            tb_storeNodesInGraph(graph, ((TBGatherOperation*)node->nodePtr)->table);
+            tb_storeNodesInGraph(graph, ((TBGatherOperation*)node->nodePtr)->indices);
+            break;
+        case TBNT_CROSS_ENTROPY:
+            tb_storeNodesInGraph(graph, ((TBCrossEntropyOperation*)node->nodePtr)->logits);
+            tb_storeNodesInGraph(graph, ((TBCrossEntropyOperation*)node->nodePtr)->labels);
+            break;
+        case TBNT_NORMALIZATION:{
+            TBNormalizationOperation* nop = (TBNormalizationOperation*)node->nodePtr;
+            tb_storeNodesInGraph(graph, nop->uhs);
+            if(nop->gamma != NULL)
+                tb_storeNodesInGraph(graph, nop->gamma);
+            if(nop->beta != NULL)
+                tb_storeNodesInGraph(graph, nop->beta);
+            break;
+        }
+        case TBNT_CONVOLUTION:
+            tb_storeNodesInGraph(graph, ((TBConvolutionOperation*)node->nodePtr)->uhs);
+            tb_storeNodesInGraph(graph, ((TBConvolutionOperation*)node->nodePtr)->weights);
+            break;
+        case TBNT_POOLING:
+            tb_storeNodesInGraph(graph, ((TBPoolingOperation*)node->nodePtr)->uhs);
+            break;
+        case TBNT_REORDER:
+            tb_storeNodesInGraph(graph, ((TBReorderOperation*)node->nodePtr)->uhs);
+            break;
     }
 }
 
 void tb_freeNode(TBGraph* graph, TBNode* node){
-    if (node->diff != NULL){
-        tb_freeResultNode(graph, node->diff);
-        free(node->diff);
-    }
-    
-    if(node->result != NULL){
-        tb_freeResultNode(graph, node->result);
-        free(node->result);
-    }
-    
     switch(node->type){
         case TBNT_VARIABLE:
             free(node->nodePtr);
             break;
             
-        case TBNT_CONSTANT:
-            nda_free(((TBConstant*)node->nodePtr)->value);
+        case TBNT_CONSTANT:{
+            TBConstant* constant = (TBConstant*)node->nodePtr;
+            
+            if(!constant->borrowed){
+                nda_free(constant->value);
+                free(constant->value);
+            }
             free(node->nodePtr);
             break;
+        }
             
         case TBNT_GRAPH:
-            // TODO
+            // the nested graph is freed by `tb_freeGraph`
+            free(node->nodePtr);
             break;
             
         case TBNT_BINARY_OPERATION:
@@ -180,15 +515,44 @@ void tb_freeNode(TBGraph* graph, TBNode* node){
         case TBNT_AXES_TRANSPOSE:
             free(node->nodePtr);
             break;
+            
+        case TBNT_QUANTIZATION:
+            free(node->nodePtr);
+            break;
+            
+        case TBNT_GATHER:
+            free(node->nodePtr);
+            break;
+            
+        case TBNT_CROSS_ENTROPY:
+            free(node->nodePtr);
+            break;
+            
+        case TBNT_NORMALIZATION:
+            free(node->nodePtr);
+            break;
+            
+        case TBNT_CONVOLUTION:
+            free(node->nodePtr);
+            break;
+            
+        case TBNT_POOLING:
+            free(node->nodePtr);
+            break;
+            
+        case TBNT_REORDER:
+            free(node->nodePtr);
+            break;
     }
 }
 
 void tb_freeResultNode(TBGraph* graph, TBResultNode* node){
     if(node->error){
+        free((char*)node->error->message);
         free(node->error);
     }
     
-    if(node->value != NULL){
+    if((node->value != NULL) && !node->borrowed){
         nda_free(node->value);
         free(node->value);
     }
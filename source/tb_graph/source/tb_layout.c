@@ -0,0 +1,341 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file tb_layout.c
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing the propagation of blocked image layouts through graphs.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <ndarray.h>
+#include <ndarray_std.h>
+
+#include <tb_graph.h>
+#include <tb_factory.h>
+#include <tb_operation.h>
+#include <tb_layout.h>
+
+/*
+ * Memoized rewrite, indexed by the ids of the source graph nodes
+ */
+typedef struct TBLayoutPass {
+    TBGraph* graph;
+    uint64_t len;                  /**< Number of nodes of the source graph */
+    uint64_t block;                /**< Channels per block */
+    int8_t* blockable;             /**< 1 if the node runs blocked, 0 if not, -1 until decided */
+    TBNode** plain;                /**< Copy of each node in its original layout */
+    TBNode** blocked;              /**< Blocked copy of each blockable node */
+    TBNode** entering;             /**< NCHWc reorder of each plain image, one per source layout */
+}TBLayoutPass;
+
+static uint8_t _tb_layoutOwns(TBLayoutPass* p, TBNode* node){
+    return tb_graphOwnsNode(p->graph, node) && (node->id < p->len);
+}
+
+/*
+ * Shape of constant weights, either given directly or through a variable bound to a constant.
+ */
+static NDShape* _tb_layoutConstantShape(TBGraph* graph, TBNode* node){
+    if(node->type == TBNT_VARIABLE){
+        uint64_t slot = tb_graphVarNodeSlot(graph, node);
+        
+        if((slot == TB_NO_SLOT) || (graph->slots.data[slot] == graph->feeds.data[slot]))
+            return NULL;
+        
+        node = graph->slots.data[slot];
+    }
+    
+    if((node == NULL) || (node->type != TBNT_CONSTANT))
+        return NULL;
+    
+    return ((TBConstant*)node->nodePtr)->value->shape;
+}
+
+/*
+ * Original layout of the image computed by a blockable node
+ */
+static TBConvolutionLayout _tb_layoutOf(TBNode* node){
+    switch(node->type){
+        case TBNT_CONVOLUTION:
+            return ((TBConvolutionOperation*)node->nodePtr)->layout;
+        case TBNT_POOLING:
+            return ((TBPoolingOperation*)node->nodePtr)->layout;
+        case TBNT_UNARY_OPERATION:
+            return _tb_layoutOf(((TBUnaryOperation*)node->nodePtr)->uhs);
+        default:
+            break;
+    }
+    
+    return TBCL_NCHW;
+}
+
+static uint8_t _tb_layoutBlockable(TBLayoutPass* p, TBNode* node){
+    if(!_tb_layoutOwns(p, node))
+        return 0;
+    
+    if(p->blockable[node->id] >= 0)
+        return (uint8_t)p->blockable[node->id];
+    
+    uint8_t res = 0;
+    
+    switch(node->type){
+        case TBNT_CONVOLUTION:{
+            TBConvolutionOperation* cop = (TBConvolutionOperation*)node->nodePtr;
+            NDShape* w = _tb_layoutConstantShape(p->graph, cop->weights);
+            
+            res = (cop->layout != TBCL_NCHWC) && (cop->groups == 1) && (w != NULL) && (w->rank == 4) &&
+                  (w->dims[0] % p->block == 0) && (w->dims[1] % p->block == 0);
+            break;
+        }
+        case TBNT_POOLING:{
+            TBPoolingOperation* pop = (TBPoolingOperation*)node->nodePtr;
+            res = (pop->layout != TBCL_NCHWC) && _tb_layoutBlockable(p, pop->uhs) && (_tb_layoutOf(pop->uhs) == pop->layout);
+            break;
+        }
+        case TBNT_UNARY_OPERATION:
+            res = _tb_layoutBlockable(p, ((TBUnaryOperation*)node->nodePtr)->uhs);
+            break;
+        default:
+            break;
+    }
+    
+    p->blockable[node->id] = (int8_t)res;
+    
+    return res;
+}
+
+static TBNode* _tb_layoutPlain(TBLayoutPass* p, TBNode* node);
+static TBNode* _tb_layoutBlocked(TBLayoutPass* p, TBNode* node);
+
+/*
+ * Blocked copy of an image given in a plain layout to a blocked consumer
+ */
+static TBNode* _tb_layoutInput(TBLayoutPass* p, TBNode* node, TBConvolutionLayout layout){
+    if(_tb_layoutBlockable(p, node) && (_tb_layoutOf(node) == layout))
+        return _tb_layoutBlocked(p, node);
+    
+    if(!_tb_layoutOwns(p, node))
+        return tb_newReorderOpNode(node, layout, TBCL_NCHWC, p->block);
+    
+    uint64_t i = node->id*2 + (layout == TBCL_NHWC);
+    
+    if(p->entering[i] == NULL){
+        p->entering[i] = tb_newReorderOpNode(_tb_layoutPlain(p, node), layout, TBCL_NCHWC, p->block);
+        p->entering[i]->calc_grad = node->calc_grad;
+    }
+    
+    return p->entering[i];
+}
+
+static TBNode* _tb_layoutBlocked(TBLayoutPass* p, TBNode* node){
+    if(p->blocked[node->id] != NULL)
+        return p->blocked[node->id];
+    
+    TBNode* clone = NULL;
+    
+    switch(node->type){
+        case TBNT_CONVOLUTION:{
+            TBConvolutionOperation* cop = (TBConvolutionOperation*)node->nodePtr;
+            clone = tb_newConvolutionOpNode(_tb_layoutInput(p, cop->uhs, cop->layout), _tb_layoutPlain(p, cop->weights), TBCL_NCHWC,
+                                            cop->stride[0], cop->stride[1], cop->padding[0], cop->padding[1],
+                                            cop->dilation[0], cop->dilation[1], 1);
+            break;
+        }
+        case TBNT_POOLING:{
+            TBPoolingOperation* pop = (TBPoolingOperation*)node->nodePtr;
+            clone = tb_newPoolingOpNode(pop->type, _tb_layoutBlocked(p, pop->uhs), TBCL_NCHWC, pop->window[0], pop->window[1],
+                                        pop->stride[0], pop->stride[1], pop->padding[0], pop->padding[1]);
+            break;
+        }
+        case TBNT_UNARY_OPERATION:{
+            TBUnaryOperation* uop = (TBUnaryOperation*)node->nodePtr;
+            clone = tb_newUnaryOpNode(uop->type, _tb_layoutBlocked(p, uop->uhs));
+            break;
+        }
+        default:
+            break;
+    }
+    
+    clone->calc_grad = node->calc_grad;
+    p->blocked[node->id] = clone;
+    
+    return clone;
+}
+
+static TBNode* _tb_layoutPlain(TBLayoutPass* p, TBNode* node){
+    // nodes out of the graph (i.e nested graph internals) are shared
+    if(!_tb_layoutOwns(p, node))
+        return node;
+    
+    if(p->plain[node->id] != NULL)
+        return p->plain[node->id];
+    
+    TBNode* clone = NULL;
+    
+    if(_tb_layoutBlockable(p, node)){
+        clone = tb_newReorderOpNode(_tb_layoutBlocked(p, node), TBCL_NCHWC, _tb_layoutOf(node), p->block);
+        clone->calc_grad = node->calc_grad;
+        p->plain[node->id] = clone;
+        
+        return clone;
+    }
+    
+    switch(node->type){
+        case TBNT_VARIABLE:
+            clone = tb_newVarNode(((TBVariable*)node->nodePtr)->name);
+            break;
+        case TBNT_CONSTANT:
+            clone = tb_newBorrowedConstantNode(((TBConstant*)node->nodePtr)->value);
+            break;
+        case TBNT_GRAPH:
+            clone = node;
+            break;
+        case TBNT_BINARY_OPERATION:{
+            TBBinaryOperation* bop = (TBBinaryOperation*)node->nodePtr;
+            clone = tb_newBinaryOpNode(bop->type, _tb_layoutPlain(p, bop->lhs), _tb_layoutPlain(p, bop->rhs));
+            break;
+        }
+        case TBNT_UNARY_OPERATION:{
+            TBUnaryOperation* uop = (TBUnaryOperation*)node->nodePtr;
+            clone = tb_newUnaryOpNode(uop->type, _tb_layoutPlain(p, uop->uhs));
+            break;
+        }
+        case TBNT_AXIS_BOUND_OPERATION:{
+            TBAxisBoundOperation* abop = (TBAxisBoundOperation*)node->nodePtr;
+            clone = tb_newAxisBoundOpNode(abop->type, _tb_layoutPlain(p, abop->uhs), abop->axis);
+            break;
+        }
+        case TBNT_AXES_TRANSPOSE:{
+            TBTransposeOperation* top = (TBTransposeOperation*)node->nodePtr;
+            clone = tb_newTransposeOpNode(_tb_layoutPlain(p, top->uhs), top->axis1, top->axis2);
+            break;
+        }
+        case TBNT_QUANTIZATION:{
+            TBQuantizationOperation* qop = (TBQuantizationOperation*)node->nodePtr;
+            clone = (qop->type == TBQOT_QUANTIZE) ?
+                    tb_newQuantizeOpNode(_tb_layoutPlain(p, qop->uhs), qop->dtype, qop->scale, qop->zero_point) :
+                    tb_newDequantizeOpNode(_tb_layoutPlain(p, qop->uhs));
+            break;
+        }
+        case TBNT_GATHER:{
+            TBGatherOperation* gop = (TBGatherOperation*)node->nodePtr;
+            clone = tb_newGatherOpNode(_tb_layoutPlain(p, gop->table), _tb_layoutPlain(p, gop->indices));
+            break;
+        }
+        case TBNT_CROSS_ENTROPY:{
+            TBCrossEntropyOperation* ceop = (TBCrossEntropyOperation*)node->nodePtr;
+            clone = tb_newCrossEntropyOpNode(_tb_layoutPlain(p, ceop->logits), _tb_layoutPlain(p, ceop->labels), ceop->axis);
+            break;
+        }
+        case TBNT_NORMALIZATION:{
+            TBNormalizationOperation* nop = (TBNormalizationOperation*)node->nodePtr;
+            clone = tb_newNormalizationOpNode(nop->type, _tb_layoutPlain(p, nop->uhs),
+                                              (nop->gamma != NULL) ? _tb_layoutPlain(p, nop->gamma) : NULL,
+                                              (nop->beta != NULL) ? _tb_layoutPlain(p, nop->beta) : NULL,
+                                              nop->axis, nop->epsilon);
+            break;
+        }
+        case TBNT_CONVOLUTION:{
+            TBConvolutionOperation* cop = (TBConvolutionOperation*)node->nodePtr;
+            clone = tb_newConvolutionOpNode(_tb_layoutPlain(p, cop->uhs), _tb_layoutPlain(p, cop->weights), cop->layout,
+                                            cop->stride[0], cop->stride[1], cop->padding[0], cop->padding[1],
+                                            cop->dilation[0], cop->dilation[1], cop->groups);
+            ((TBConvolutionOperation*)clone->nodePtr)->algorithm = cop->algorithm;
+            break;
+        }
+        case TBNT_POOLING:{
+            TBPoolingOperation* pop = (TBPoolingOperation*)node->nodePtr;
+            clone = tb_newPoolingOpNode(pop->type, _tb_layoutPlain(p, pop->uhs), pop->layout, pop->window[0], pop->window[1],
+                                        pop->stride[0], pop->stride[1], pop->padding[0], pop->padding[1]);
+            break;
+        }
+        case TBNT_REORDER:{
+            TBReorderOperation* rop = (TBReorderOperation*)node->nodePtr;
+            clone = tb_newReorderOpNode(_tb_layoutPlain(p, rop->uhs), rop->from, rop->to, rop->block);
+            break;
+        }
+    }
+    
+    clone->calc_grad = node->calc_grad;
+    p->plain[node->id] = clone;
+    
+    return clone;
+}
+
+TBGraph* tb_blockGraphLayouts(TBGraph* graph, uint64_t block, char* name){
+    tb_compileGraph(graph);
+    
+    TBLayoutPass p;
+    p.graph = graph;
+    p.len = graph->nodes.length;
+    p.block = (block == 0) ? TB_LAYOUT_BLOCK : block;
+    p.blockable = malloc(p.len*sizeof(int8_t));
+    p.plain = calloc(p.len, sizeof(TBNode*));
+    p.blocked = calloc(p.len, sizeof(TBNode*));
+    p.entering = calloc(2*p.len, sizeof(TBNode*));
+    
+    uint64_t i = 0;
+    for(; i < p.len; i++){
+        p.blockable[i] = -1;
+    }
+    
+    TBGraph* res = tb_newGraph(name, _tb_layoutPlain(&p, graph->root));
+    res->base = graph;
+    
+    // bindings are shared, fed slots are left to the caller
+    const char* var_name;
+    map_iter_t iter = map_iter(&graph->slot_ids);
+    while((var_name = map_next(&graph->slot_ids, &iter))){
+        uint64_t slot = *map_get(&graph->slot_ids, var_name);
+        TBNode* bound = graph->slots.data[slot];
+        
+        if((bound != NULL) && (bound != graph->feeds.data[slot]))
+            tb_graphSetVar(res, bound, var_name);
+    }
+    
+    free(p.blockable);
+    free(p.plain);
+    free(p.blocked);
+    free(p.entering);
+    
+    return res;
+}
@@ -0,0 +1,258 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file tb_memory.c
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing the tensor memory accounting of CPU sessions.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
+
+#include <tb_graph.h>
+#include <tb_session_cpu.h>
+#include <tb_memory.h>
+
+#include <ndarray_mem.h>
+
+static void _tb_forgetNodeMemory(TBRunContext* ctx){
+    uint64_t i = 0;
+    for(; i < ctx->entries_len; i++){
+        ctx->entries[i].memory = NULL;
+    }
+    
+    for(i = 0; i < ctx->extras_len; i++){
+        ctx->extras[i]->memory = NULL;
+    }
+}
+
+void tb_sessionTrackMemory(TBGraphSession* session, FILE* leaks){
+    if(session->memory != NULL){
+        int i = 0;
+        for(; i < session->contexts.length; i++){
+            _tb_forgetNodeMemory(session->contexts.data[i]);
+        }
+        
+        // replaced accounting is not a leak
+        session->memory->leaks = NULL;
+        _tb_freeSessionMemory(session->memory);
+    }
+    
+    TBSessionMemory* memory = calloc(1, sizeof(TBSessionMemory));
+    pthread_mutex_init(&memory->lock, NULL);
+    memory->tracker = nda_newMemTracker(NULL);
+    memory->leaks = leaks;
+    
+    session->memory = memory;
+}
+
+NDMemCounters tb_sessionMemory(TBGraphSession* session){
+    if(session->memory == NULL){
+        NDMemCounters none = {0};
+        return none;
+    }
+    
+    return nda_memCounters(session->memory->tracker);
+}
+
+NDMemCounters tb_sessionNodeMemory(TBGraphSession* session, TBGraph* graph, TBNode* node){
+    NDMemCounters none = {0};
+    
+    if(session->memory == NULL){
+        return none;
+    }
+    
+    tb_compileGraph(graph);
+    TBNodeMemory* record = _tb_contextEntry(_tb_sessionContext(session, graph), node)->memory;
+    
+    return (record != NULL) ? nda_memCounters(record->tracker) : none;
+}
+
+NDMemTracker* _tb_nodeMemory(TBGraphSession* session, TBRunContext* ctx, TBNode* node){
+    TBSessionMemory* memory = session->memory;
+    
+    // temporary nodes are freed right after their evaluation, there is nothing to attribute them to
+    if(ctx->temporary){
+        return memory->tracker;
+    }
+    
+    TBContextEntry* entry = _tb_contextEntry(ctx, node);
+    if(entry->memory != NULL){
+        return entry->memory->tracker;
+    }
+    
+    pthread_mutex_lock(&memory->lock);
+    
+    if(entry->memory == NULL){
+        TBNodeMemory* record = calloc(1, sizeof(TBNodeMemory));
+        record->tracker = nda_newMemTracker(memory->tracker);
+        snprintf(record->graph, sizeof(record->graph), "%s", (ctx->graph->name != NULL) ? ctx->graph->name : "");
+        record->node_id = node->id;
+        record->op = tb_nodeOpName(node);
+        
+        if(memory->nodes_len == memory->nodes_cap){
+            memory->nodes_cap = (memory->nodes_cap == 0) ? 16 : 2*memory->nodes_cap;
+            memory->nodes = realloc(memory->nodes, memory->nodes_cap*sizeof(TBNodeMemory*));
+        }
+        
+        memory->nodes[memory->nodes_len++] = record;
+        entry->memory = record;
+    }
+    
+    pthread_mutex_unlock(&memory->lock);
+    
+    return entry->memory->tracker;
+}
+
+/*
+ * Node counters, taken once so that the sort and the report agree
+ */
+typedef struct _TBNodeCounters {
+    TBNodeMemory* record;
+    NDMemCounters counters;
+}_TBNodeCounters;
+
+static int _tb_cmpNodePeak(const void* a, const void* b){
+    uint64_t pa = ((const _TBNodeCounters*)a)->counters.peak;
+    uint64_t pb = ((const _TBNodeCounters*)b)->counters.peak;
+    
+    return (pa < pb) - (pa > pb);
+}
+
+static _TBNodeCounters* _tb_nodeCounters(TBSessionMemory* memory){
+    _TBNodeCounters* nodes = calloc(memory->nodes_len + 1, sizeof(_TBNodeCounters));
+    
+    uint64_t i = 0;
+    for(; i < memory->nodes_len; i++){
+        nodes[i].record = memory->nodes[i];
+        nodes[i].counters = nda_memCounters(memory->nodes[i]->tracker);
+    }
+    
+    return nodes;
+}
+
+void tb_sessionWriteMemoryReport(TBGraphSession* session, FILE* out){
+    TBSessionMemory* memory = session->memory;
+    
+    if(memory == NULL){
+        fprintf(out, "Memory accounting is disabled\n");
+        return;
+    }
+    
+    pthread_mutex_lock(&memory->lock);
+    
+    NDMemCounters all = nda_memCounters(memory->tracker);
+    fprintf(out, "Memory: %.1f KB current, %.1f KB peak, %.1f KB allocated in %" PRIu64 " tensors\n\n",
+            all.current/1024.0, all.peak/1024.0, all.total/1024.0, all.allocations);
+    
+    _TBNodeCounters* nodes = _tb_nodeCounters(memory);
+    qsort(nodes, memory->nodes_len, sizeof(_TBNodeCounters), _tb_cmpNodePeak);
+    
+    fprintf(out, "%11s %11s %11s %7s %6s  %-16s %s\n", "peak KB", "current KB", "total KB", "allocs", "node", "op", "graph");
+    
+    uint64_t i = 0;
+    for(; i < memory->nodes_len; i++){
+        NDMemCounters* c = &nodes[i].counters;
+        
+        fprintf(out, "%11.1f %11.1f %11.1f %7" PRIu64 " %6" PRIu64 "  %-16s %s\n", c->peak/1024.0, c->current/1024.0,
+                c->total/1024.0, c->allocations, nodes[i].record->node_id, nodes[i].record->op, nodes[i].record->graph);
+    }
+    
+    free(nodes);
+    
+    pthread_mutex_unlock(&memory->lock);
+}
+
+/*
+ * Lists the tensors still allocated, per node then the ones allocated outside of any node (e.g derivatives)
+ */
+static void _tb_writeLeaks(TBSessionMemory* memory, FILE* out){
+    NDMemCounters all = nda_memCounters(memory->tracker);
+    
+    if(all.live == 0){
+        return;
+    }
+    
+    fprintf(out, "Session leaks %" PRIu64 " bytes in %" PRIu64 " tensors\n", all.current, all.live);
+    
+    _TBNodeCounters* nodes = _tb_nodeCounters(memory);
+    uint64_t i = 0;
+    
+    for(; i < memory->nodes_len; i++){
+        NDMemCounters* c = &nodes[i].counters;
+        
+        if(c->live == 0)
+            continue;
+        
+        fprintf(out, "    %" PRIu64 " bytes in %" PRIu64 " tensors allocated by node %" PRIu64 " (%s) of graph `%s`\n",
+                c->current, c->live, nodes[i].record->node_id, nodes[i].record->op, nodes[i].record->graph);
+        
+        all.current -= c->current;
+        all.live -= c->live;
+    }
+    
+    if(all.live != 0){
+        fprintf(out, "    %" PRIu64 " bytes in %" PRIu64 " tensors allocated outside of nodes\n", all.current, all.live);
+    }
+    
+    free(nodes);
+}
+
+void _tb_freeSessionMemory(TBSessionMemory* memory){
+    if(memory->leaks != NULL){
+        _tb_writeLeaks(memory, memory->leaks);
+    }
+    
+    // trackers still charged with tensors stay alive until those are freed
+    uint64_t i = 0;
+    for(; i < memory->nodes_len; i++){
+        nda_releaseMemTracker(memory->nodes[i]->tracker);
+        free(memory->nodes[i]);
+    }
+    
+    nda_releaseMemTracker(memory->tracker);
+    pthread_mutex_destroy(&memory->lock);
+    free(memory->nodes);
+    free(memory);
+}
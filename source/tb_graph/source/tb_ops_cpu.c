@@ -50,17 +50,25 @@
 #include <stdio.h>
 #include <string.h>
 #include <inttypes.h>
+#include <unistd.h>
 
-#include <cblas.h>
+#include <tb_gemm.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 #include <ndarray.h>
 #include <ndarray_std.h>
+#include <ndarray_mem.h>
+#include <ndarray_cpu.h>
 
 #include <tb_session.h>
 #include <tb_graph.h>
 #include <tb_operation.h>
 #include <tb_ops.h>
 #include <tb_factory.h>
+#include <tb_shape.h>
 
 #if tb_float == float
 #define POW powf
@@ -151,825 +159,3406 @@ static inline tb_float _negative(tb_float x){
     return -x;
 }
 
-static NDArray* _tb_prepareBroadcast(uint8_t res, NDArray* lhs, NDArray* rhs, NDArray* biggerArray, NDArray* smallerArray){
-    NDShape* lhsShape = lhs->shape;
-    NDShape* rhsShape = rhs->shape;
-    
-    NDShape* biggerShape  = res==1?lhsShape:rhsShape;
-    NDShape* smallerShape = res==1?rhsShape:lhsShape;
-    
-    biggerArray  = res==1?lhs:rhs;
-    smallerArray = res==1?rhs:lhs;
-    
-    uint64_t vshape_len = biggerShape->rank;
-    uint64_t num_pads = biggerShape->rank-smallerShape->rank;
-    
-    uint64_t* array = calloc(vshape_len, sizeof(uint64_t));
-    
-    size_t i = 0;
-    size_t j = 0;
-    
-    for(; i < num_pads; i++){
-        array[i] = biggerShape->dims[i];
-    }
-    
-    for(; i < vshape_len; i++,j++){
-        //printf("%lld, %lld\n", biggerShape->dims[i], smallerShape->dims[j]);
-        if(biggerShape->dims[i] > smallerShape->dims[j]){
-            array[i] = biggerShape->dims[i];
-        }
-        else {
-            array[i] = smallerShape->dims[j];
-        }
-    }
-    
-    NDShape* vshape = nda_newShapeFromArray(vshape_len, array);
-    //nda_debugShape(vshape);
-    
-    // creating output arrray
-    return nda_alloc(vshape);
-    
+/*
+ * F64 arrays have their own double kernels when tb_float is single precision, see `tb_binaryOpDType`. When it is
+ * double they are plain tb_float arrays.
+ */
+#if TB_TYPE == TB_FLOAT
+#define TB_F64_KERNELS 1
+
+static inline double _reluF64(double x){
+    return (x > 0) ? x : 0.0;
 }
 
-/* * * * * * * * * * *
- * BINARY OPERATIONS *
- * * * * * * * * * * */
+static inline double _sigmoidF64(double x){
+    return 1.0/(1.0 + exp(-x));
+}
 
-TBResultNode* _tb_add(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* lhs, TBResultNode* rhs){
-    NDShape* lhsShape = lhs->value->shape;
-    NDShape* rhsShape = rhs->value->shape;
-    
-    uint8_t res = nda_shapeCanBroadCast(lhsShape, rhsShape);
-    
-    if(!res){
-        char msg[1024] = {0};
-        char* lhsShapeInfo = nda_shapeToString(lhsShape);
-        char* rhsShapeInfo = nda_shapeToString(rhsShape);
-        snprintf(msg, 1024, "Cannot broadcast shapes %s and %s", lhsShapeInfo, rhsShapeInfo);
-        
-        free(lhsShapeInfo);
-        free(rhsShapeInfo);
-        
-        return tb_newErrorResultNode(TBET_INCOMPATIBLE_DIMENTIONS_EXCEPTION, msg, node, graph);
-    }
-    NDArray* biggerArray = NULL, * smallerArray = NULL;
-    NDArray* arr_res = NULL;
-    
-    arr_res = _tb_prepareBroadcast(res, lhs->value, rhs->value, biggerArray, smallerArray);
-    
-    ASSERT(arr_res != NULL, "Fatal Error Occured.");
-    
-    NDShape* vshape = arr_res->shape;
-
-    tb_float* arr = arr_res->data;
-    
-    size_t counter = 0;
-    
-    for(; counter<vshape->raw_len;counter++){
-        size_t i = vshape->rank;
-        uint64_t mul = vshape->raw_len;
-        uint64_t counter_tmp = counter;
-        uint64_t* index = calloc(vshape->rank, sizeof(uint64_t));
-        for(; i !=0 ; i--){
-            mul /= vshape->dims[vshape->rank - i];
-            index[vshape->rank - i] = counter_tmp / mul;
-            counter_tmp -= index[vshape->rank - i] * mul;
-        }
-        free(index);
-        
-        arr[counter] = nda_vget(lhs->value, index, vshape) + nda_vget(rhs->value, index, vshape);
-    }
-    
-    return tb_newResultNode(arr_res);
+static inline double _dxreluF64(double x){
+    return (x > 0) ? 1.0 : 0.0;
 }
 
+static inline double _softplusF64(double x){
+    return log(1.0 + exp(x));
+}
 
-TBResultNode* _tb_sub(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* lhs, TBResultNode* rhs){
-    NDShape* lhsShape = lhs->value->shape;
-    NDShape* rhsShape = rhs->value->shape;
-    
-    uint8_t res = nda_shapeCanBroadCast(lhsShape, rhsShape);
-    
-    if(!res){
-        char msg[1024] = {0};
-        char* lhsShapeInfo = nda_shapeToString(lhsShape);
-        char* rhsShapeInfo = nda_shapeToString(rhsShape);
-        snprintf(msg, 1024, "Cannot broadcast shapes %s and %s", lhsShapeInfo, rhsShapeInfo);
-        
-        free(lhsShapeInfo);
-        free(rhsShapeInfo);
-        
-        return tb_newErrorResultNode(TBET_INCOMPATIBLE_DIMENTIONS_EXCEPTION, msg, node, graph);
-    }
-    NDArray* biggerArray = NULL, * smallerArray = NULL;
-    NDArray* arr_res = NULL;
-    
-    arr_res = _tb_prepareBroadcast(res, lhs->value, rhs->value, biggerArray, smallerArray);
-    
-    ASSERT(arr_res != NULL, "Fatal Error Occured.");
-    
-    NDShape* vshape = arr_res->shape;
-    
-    tb_float* arr = arr_res->data;
-    
-    size_t counter = 0;
-    
-    for(; counter<vshape->raw_len;counter++){
-        size_t i = vshape->rank;
-        uint64_t mul = vshape->raw_len;
-        uint64_t counter_tmp = counter;
-        uint64_t* index = calloc(vshape->rank, sizeof(uint64_t));
-        for(; i !=0 ; i--){
-            mul /= vshape->dims[vshape->rank - i];
-            index[vshape->rank - i] = counter_tmp / mul;
-            counter_tmp -= index[vshape->rank - i] * mul;
-        }
-        free(index);
-        
-        arr[counter] = nda_vget(lhs->value, index, vshape) - nda_vget(rhs->value, index, vshape);
-    }
-    
-    return tb_newResultNode(arr_res);
+static inline double _negativeF64(double x){
+    return -x;
 }
+#endif
 
-TBResultNode* _tb_div(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* lhs, TBResultNode* rhs){
-    NDShape* lhsShape = lhs->value->shape;
-    NDShape* rhsShape = rhs->value->shape;
-    
-    uint8_t res = nda_shapeCanBroadCast(lhsShape, rhsShape);
-    
-    if(!res){
-        char msg[1024] = {0};
-        char* lhsShapeInfo = nda_shapeToString(lhsShape);
-        char* rhsShapeInfo = nda_shapeToString(rhsShape);
-        snprintf(msg, 1024, "Cannot broadcast shapes %s and %s", lhsShapeInfo, rhsShapeInfo);
-        
-        free(lhsShapeInfo);
-        free(rhsShapeInfo);
-        
-        return tb_newErrorResultNode(TBET_INCOMPATIBLE_DIMENTIONS_EXCEPTION, msg, node, graph);
-    }
-    NDArray* biggerArray = NULL, * smallerArray = NULL;
-    NDArray* arr_res = NULL;
-    
-    arr_res = _tb_prepareBroadcast(res, lhs->value, rhs->value, biggerArray, smallerArray);
-    
-    ASSERT(arr_res != NULL, "Fatal Error Occured.");
-    
-    NDShape* vshape = arr_res->shape;
-    
-    tb_float* arr = arr_res->data;
-    
-    size_t counter = 0;
-    
-    for(; counter<vshape->raw_len;counter++){
-        size_t i = vshape->rank;
-        uint64_t mul = vshape->raw_len;
-        uint64_t counter_tmp = counter;
-        uint64_t* index = calloc(vshape->rank, sizeof(uint64_t));
-        for(; i !=0 ; i--){
-            mul /= vshape->dims[vshape->rank - i];
-            index[vshape->rank - i] = counter_tmp / mul;
-            counter_tmp -= index[vshape->rank - i] * mul;
-        }
-        free(index);
-        
-        arr[counter] = nda_vget(lhs->value, index, vshape) / nda_vget(rhs->value, index, vshape);
-    }
-    
-    return tb_newResultNode(arr_res);
-    
-    return NULL;
+static TBResultNode* _tb_errorResult(TBError* error, TBNode* node, TBGraph* graph){
+    TBResultNode* res = tb_newErrorResultNode(error->errorType, error->message, node, graph);
+
+    free((char*)error->message);
+    free(error);
+
+    return res;
 }
 
-TBResultNode* _tb_dot(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* lhs, TBResultNode* rhs){
-    NDShape* lhsShape = lhs->value->shape;
-    NDShape* rhsShape = rhs->value->shape;
-    
-    ASSERT((lhsShape->rank <= 2) && (rhsShape->rank <= 2), "Cannot perform DOT product on shapes of ranks (%"PRIu64", %"PRIu64")", lhsShape->rank, rhsShape->rank);
-    
-    uint64_t lhsRows = 1;
-    uint64_t lhsCols = lhsShape->dims[0];
-    
-    if(lhsShape->rank > 1){
-        lhsRows = lhsShape->dims[0];
-        lhsCols = lhsShape->dims[1];
-    }
-    
-    
-    uint64_t rhsRows = 1;
-    uint64_t rhsCols = rhsShape->dims[0];
-    
-    if(rhsShape->rank > 1){
-        rhsRows = rhsShape->dims[0];
-        rhsCols = rhsShape->dims[1];
-    }
-    
-    
-    ASSERT((lhsCols == rhsRows), "Cannot perform DOT product on shapes (%"PRIu64", %"PRIu64") .  (%"PRIu64", %"PRIu64")", lhsRows, lhsCols, rhsRows, rhsCols);
-    
-    NDArray* res_arr = NULL;
-    
-    // when calculating the dot product over a vector as LHS, the output is a vector by default, unless LHS has been
-    // reshaped into a matrix of 1,m
-    
-    if(lhsShape->rank == 1){
-        res_arr = nda_alloc(nda_newShape(1, rhsCols));
-    }
-    else{
-        res_arr = nda_alloc(nda_newShape(2, lhsRows, rhsCols));
+static inline uint8_t _tb_isContiguous(NDShape* shape){
+    uint64_t i = shape->rank;
+    uint64_t stride = 1;
+    for(; i > 0; i--){
+        if((shape->dims[i-1] != 1) && (shape->strides[i-1] != stride))
+            return 0;
+        stride *= shape->dims[i-1];
     }
-    
-    
-#if TB_TYPE == TB_FLOAT
-#define GEMM cblas_sgemm
-#else
-#define GEMM cblas_dgemm
-#endif
-    
-    GEMM(CblasRowMajor,
-         CblasNoTrans, CblasNoTrans, lhsRows, rhsCols, lhsCols,
-         1.0, lhs->value->data, lhsCols, rhs->value->data, rhsCols, 0.0, res_arr->data, rhsCols);
 
-    
-#undef GEMM
-    return tb_newResultNode(res_arr);
+    return 1;
 }
 
-TBResultNode* _tb_mul(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* lhs, TBResultNode* rhs){
-    NDShape* lhsShape = lhs->value->shape;
-    NDShape* rhsShape = rhs->value->shape;
-    
-    uint8_t res = nda_shapeCanBroadCast(lhsShape, rhsShape);
-    
-    if(!res){
-        char msg[1024] = {0};
-        char* lhsShapeInfo = nda_shapeToString(lhsShape);
-        char* rhsShapeInfo = nda_shapeToString(rhsShape);
-        snprintf(msg, 1024, "Cannot broadcast shapes %s and %s", lhsShapeInfo, rhsShapeInfo);
-        
-        free(lhsShapeInfo);
-        free(rhsShapeInfo);
-        
-        return tb_newErrorResultNode(TBET_INCOMPATIBLE_DIMENTIONS_EXCEPTION, msg, node, graph);
-    }
-    NDArray* biggerArray = NULL, * smallerArray = NULL;
-    NDArray* arr_res = NULL;
-    
-    arr_res = _tb_prepareBroadcast(res, lhs->value, rhs->value, biggerArray, smallerArray);
-    
-    ASSERT(arr_res != NULL, "Fatal Error Occured.");
-    
-    NDShape* vshape = arr_res->shape;
-    
-    tb_float* arr = arr_res->data;
-    
-    size_t counter = 0;
-    
-    for(; counter<vshape->raw_len;counter++){
-        size_t i = vshape->rank;
-        uint64_t mul = vshape->raw_len;
-        uint64_t counter_tmp = counter;
-        uint64_t* index = calloc(vshape->rank, sizeof(uint64_t));
-        for(; i !=0 ; i--){
-            mul /= vshape->dims[vshape->rank - i];
-            index[vshape->rank - i] = counter_tmp / mul;
-            counter_tmp -= index[vshape->rank - i] * mul;
-        }
-        free(index);
-        
-        arr[counter] = nda_vget(lhs->value, index, vshape) * nda_vget(rhs->value, index, vshape);
+/*
+ * Strides of `arr` expressed in the index space of `shape`, broadcasted dimensions have a null stride.
+ */
+static inline void _tb_broadcastStrides(NDArray* arr, NDShape* shape, uint64_t* strides){
+    NDShape* arrShape = arr->shape;
+    uint64_t pad = shape->rank - arrShape->rank;
+
+    uint64_t i = 0;
+    for(; i < shape->rank; i++){
+        if((i < pad) || (arrShape->dims[i-pad] == 1))
+            strides[i] = 0;
+        else
+            strides[i] = arrShape->strides[i-pad];
     }
-    
-    return tb_newResultNode(arr_res);
-    
-    return NULL;
 }
 
-TBResultNode* _tb_pow(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* lhs, TBResultNode* rhs){
-    NDShape* lhsShape = lhs->value->shape;
-    NDShape* rhsShape = rhs->value->shape;
-    
-    uint8_t res = nda_shapeCanBroadCast(lhsShape, rhsShape);
-    
-    if(!res){
-        char msg[1024] = {0};
-        char* lhsShapeInfo = nda_shapeToString(lhsShape);
-        char* rhsShapeInfo = nda_shapeToString(rhsShape);
-        snprintf(msg, 1024, "Cannot broadcast shapes %s and %s", lhsShapeInfo, rhsShapeInfo);
-        
-        free(lhsShapeInfo);
-        free(rhsShapeInfo);
-        
-        return tb_newErrorResultNode(TBET_INCOMPATIBLE_DIMENTIONS_EXCEPTION, msg, node, graph);
-    }
-    NDArray* biggerArray = NULL, * smallerArray = NULL;
-    NDArray* arr_res = NULL;
-    
-    arr_res = _tb_prepareBroadcast(res, lhs->value, rhs->value, biggerArray, smallerArray);
-    
-    ASSERT(arr_res != NULL, "Fatal Error Occured.");
-    
-    NDShape* vshape = arr_res->shape;
-    
-    tb_float* arr = arr_res->data;
-    
-    size_t counter = 0;
-    
-    for(; counter<vshape->raw_len;counter++){
-        size_t i = vshape->rank;
-        uint64_t mul = vshape->raw_len;
-        uint64_t counter_tmp = counter;
-        uint64_t* index = calloc(vshape->rank, sizeof(uint64_t));
-        for(; i !=0 ; i--){
-            mul /= vshape->dims[vshape->rank - i];
-            index[vshape->rank - i] = counter_tmp / mul;
-            counter_tmp -= index[vshape->rank - i] * mul;
-        }
-        free(index);
-        
-        arr[counter] = POW(nda_vget(lhs->value, index, vshape), nda_vget(rhs->value, index, vshape));
+/*
+ * Advances the index of the outer dimensions [0, rank-1) of `shape` and the offsets of up to two operands
+ * walking it with the given strides, returns false once every index has been visited.
+ */
+static inline uint8_t _tb_nextRow(NDShape* shape, uint64_t* index, uint64_t* off1, uint64_t* strides1, uint64_t* off2, uint64_t* strides2){
+    int64_t d = (int64_t)shape->rank - 2;
+    for(; d >= 0; d--){
+        index[d]++;
+        *off1 += strides1[d];
+        *off2 += strides2[d];
+
+        if(index[d] < shape->dims[d])
+            return 1;
+
+        *off1 -= strides1[d]*index[d];
+        *off2 -= strides2[d]*index[d];
+        index[d] = 0;
     }
-    
-    return tb_newResultNode(arr_res);
-    
-    return NULL;
+
+    return 0;
 }
 
-/* * * * * * * * * * * * * *
- * AXIS-BOUNDED OPERATIONS *
- * * * * * * * * * * * * * */
+#define TB_BROADCAST_KERNEL(func_name, type, expr)\
+static void func_name(NDArray* out, NDArray* lhs, NDArray* rhs){\
+    NDShape* shape = out->shape;\
+    uint64_t rank = shape->rank;\
+    uint64_t ls[rank], rs[rank], index[rank];\
+    _tb_broadcastStrides(lhs, shape, ls);\
+    _tb_broadcastStrides(rhs, shape, rs);\
+    memset(index, 0, rank*sizeof(uint64_t));\
+\
+    type* a = (type*)lhs->raw;\
+    type* b = (type*)rhs->raw;\
+    type* c = (type*)out->raw;\
+    uint64_t len = shape->dims[rank-1], lstep = ls[rank-1], rstep = rs[rank-1];\
+    uint64_t loff = 0, roff = 0, k;\
+\
+    do {\
+        for(k = 0; k < len; k++){\
+            type x = a[loff + k*lstep];\
+            type y = b[roff + k*rstep];\
+            c[k] = (expr);\
+        }\
+        c += len;\
+    } while(_tb_nextRow(shape, index, &loff, ls, &roff, rs));\
+}
+
+TB_BROADCAST_KERNEL(_tb_addKernel, tb_float, x + y);
+TB_BROADCAST_KERNEL(_tb_subKernel, tb_float, x - y);
+TB_BROADCAST_KERNEL(_tb_mulKernel, tb_float, x * y);
+TB_BROADCAST_KERNEL(_tb_divKernel, tb_float, x / y);
+TB_BROADCAST_KERNEL(_tb_powKernel, tb_float, POW(x, y));
+
+TB_BROADCAST_KERNEL(_tb_addKernelI32, int32_t, x + y);
+TB_BROADCAST_KERNEL(_tb_subKernelI32, int32_t, x - y);
+TB_BROADCAST_KERNEL(_tb_mulKernelI32, int32_t, x * y);
+
+TB_BROADCAST_KERNEL(_tb_addKernelI64, int64_t, x + y);
+TB_BROADCAST_KERNEL(_tb_subKernelI64, int64_t, x - y);
+TB_BROADCAST_KERNEL(_tb_mulKernelI64, int64_t, x * y);
+
+#ifdef TB_F64_KERNELS
+TB_BROADCAST_KERNEL(_tb_addKernelF64, double, x + y);
+TB_BROADCAST_KERNEL(_tb_subKernelF64, double, x - y);
+TB_BROADCAST_KERNEL(_tb_mulKernelF64, double, x * y);
+TB_BROADCAST_KERNEL(_tb_divKernelF64, double, x / y);
+TB_BROADCAST_KERNEL(_tb_powKernelF64, double, pow(x, y));
+#endif
+
+#undef TB_BROADCAST_KERNEL
+
+/*
+ * Describes a rank <= 2 operand as a BLAS matrix, transposed views (i.e output of `_tb_transpose`) are
+ * handed to BLAS as-is with the transpose flag instead of being copied.
+ */
+static void _tb_blasMatrix(NDArray* arr, uint8_t isLHS, uint64_t* rows, uint64_t* cols, CBLAS_TRANSPOSE* trans, uint64_t* ld){
+    NDShape* shape = arr->shape;
 
-TBResultNode* _tb_max(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBAxisBoundOperation* abop){
-    NDShape* shape = uhs->value->shape;
-    NDArray* arr = uhs->value;
-    
-    uint64_t axis = abop->axis;
-    
-    ASSERT(axis < shape->rank, "Cannot compute axis bound operation MAX on axis %lld >= array of rank %llu", axis, shape->rank);
-    
-    uint64_t* new_dims = NULL;
-    uint64_t new_rank = 1;
     if(shape->rank == 1){
-        new_dims = calloc(1, sizeof(uint64_t));
-        new_dims[0] = 1;
-    }
-    else{
-        new_dims = calloc(shape->rank-1, sizeof(uint64_t));
-        new_rank =shape->rank-1;
+        *rows = 1;
+        *cols = shape->dims[0];
+        *trans = CblasNoTrans;
+        *ld = shape->dims[0];
+
+        ASSERT(shape->strides[0] == 1, "Cannot perform DOT product on a strided vector");
+        return;
     }
-    
-    uint64_t i = 0;
-    uint64_t j = 0;
-    for(; i < shape->rank; i++){
-        if (i != axis){
-            new_dims[j++] = shape->dims[i];
-        }
+
+    *rows = shape->dims[0];
+    *cols = shape->dims[1];
+
+    if((shape->strides[1] == 1) && ((shape->strides[0] == *cols) || (*rows == 1))){
+        *trans = CblasNoTrans;
+        *ld = *cols;
     }
-    
-    NDShape* newShape = nda_newShapeFromArray(new_rank, new_dims);
-    NDArray* new_arr = nda_alloc(newShape);
-    
-    i = 0;
-    uint64_t k = 0;
-    for(; i < newShape->raw_len; i++){
-        
-        uint64_t m = shape->rank;
-        uint64_t mod = i;
-        j = 0; //i/shape->strides[axis] % shape->dims[axis];
-        for(;m > 0; m--){
-            if(m-1 == axis){
-                continue;
-            }
-            else{
-                j += (mod%shape->dims[m-1])*shape->strides[m-1];
-                mod = mod/shape->dims[m-1];
-            }
-        }
-        new_arr->data[i] = arr->data[j];
+    else if((shape->strides[0] == 1) && ((shape->strides[1] == *rows) || (*cols == 1))){
+        *trans = CblasTrans;
+        *ld = *rows;
     }
-    
-    k = 0;
-    i = 0;
-    
-    for(; i < newShape->raw_len; i++){
-        
-        uint64_t m = shape->rank;
-        uint64_t mod = i;
-        j = 0; //i/shape->strides[axis] % shape->dims[axis];
-        for(;m > 0; m--){
-            if(m-1 == axis){
-                continue;
-            }
-            else{
-                j += (mod%shape->dims[m-1])*shape->strides[m-1];
-                mod = mod/shape->dims[m-1];
-                //printf("%lld, %lld, m= %lld, %f\n", i, j, m, arr->data[j]);
-            }
-        }
-        
-        j+=shape->strides[axis];
-        for(k=1; k < shape->dims[axis]; j+=shape->strides[axis],k++){
-            //printf("%lld, %lld, %f\n", i, j,  arr->data[j]);
-            new_arr->data[i] = (new_arr->data[i]>arr->data[j])?new_arr->data[i]:arr->data[j];
-        }
+    else{
+        ASSERT(0, "Cannot perform DOT product on a non-contiguous %s operand", isLHS?"LHS":"RHS");
     }
-    
-    
-    return tb_newResultNode(new_arr);
 }
 
-TBResultNode* _tb_min(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBAxisBoundOperation* abop){
-    NDShape* shape = uhs->value->shape;
-    NDArray* arr = uhs->value;
-    
-    uint64_t axis = abop->axis;
-    
-    ASSERT(axis < shape->rank, "Cannot compute axis bound operation MAX on axis %lld >= array of rank %llu", axis, shape->rank);
-    
-    uint64_t* new_dims = NULL;
-    uint64_t new_rank = 1;
-    if(shape->rank == 1){
-        new_dims = calloc(1, sizeof(uint64_t));
-        new_dims[0] = 1;
-    }
-    else{
-        new_dims = calloc(shape->rank-1, sizeof(uint64_t));
-        new_rank =shape->rank-1;
-    }
-    
-    uint64_t i = 0;
-    uint64_t j = 0;
-    for(; i < shape->rank; i++){
-        if (i != axis){
-            new_dims[j++] = shape->dims[i];
+/*
+ * Row-major GEMM of the kernels: BLAS when the library has it, the in-tree GEMM on the threads of the session otherwise.
+ */
+static void _tb_sessionGemm(TBGraphSession* sess, CBLAS_TRANSPOSE transA, CBLAS_TRANSPOSE transB, uint64_t M, uint64_t N, uint64_t K,
+                            tb_float alpha, const tb_float* A, uint64_t lda, const tb_float* B, uint64_t ldb,
+                            tb_float beta, tb_float* C, uint64_t ldc){
+#ifdef TB_NO_BLAS
+    tb_gemm((sess != NULL) ? sess->pool : NULL, (sess != NULL) ? sess->threads : 0, transA != CblasNoTrans, transB != CblasNoTrans,
+            M, N, K, alpha, A, lda, B, ldb, beta, C, ldc, NULL);
+#elif TB_TYPE == TB_FLOAT
+    (void)sess;
+    cblas_sgemm(CblasRowMajor, transA, transB, M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+#else
+    (void)sess;
+    cblas_dgemm(CblasRowMajor, transA, transB, M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+#endif
+}
+
+/*
+ * Small DOT products: below TB_SMALL_DOT_MACS multiply-adds the BLAS call (argument checks, buffer setup,
+ * thread dispatch) costs more than the product itself. Each kernel keeps an MR x NR output tile in registers,
+ * both sizes are compile time constants so the tile loops are fully unrolled and vectorized along NR, only the
+ * reduction loop remains. A is read through strides, B is row-major (NN) or given transposed (NT).
+ */
+#define TB_SMALL_DOT_MACS 65536
+#define TB_SMALL_DOT_MAX_DIM 256
+
+#define TB_SMALL_DOT_NN(b, ldb, k, j) b[(k)*(ldb) + (j)]
+#define TB_SMALL_DOT_NT(b, ldb, k, j) b[(j)*(ldb) + (k)]
+
+#define TB_SMALL_DOT_KERNEL(name, MR, NR, B_AT, TARGET)\
+TARGET static void name(uint64_t K, const tb_float* a, uint64_t ars, uint64_t acs, const tb_float* b, uint64_t ldb, tb_float* c, uint64_t ldc){\
+    tb_float acc[MR][NR];\
+    uint64_t i, j, k;\
+    memset(acc, 0, sizeof(acc));\
+\
+    for(k = 0; k < K; k++){\
+        _Pragma("GCC unroll 4")\
+        for(i = 0; i < MR; i++){\
+            tb_float ai = a[i*ars + k*acs];\
+            for(j = 0; j < NR; j++)\
+                acc[i][j] += ai*B_AT(b, ldb, k, j);\
+        }\
+    }\
+\
+    for(i = 0; i < MR; i++)\
+        for(j = 0; j < NR; j++)\
+            c[i*ldc + j] = acc[i][j];\
+}
+
+/*
+ * Every tile, for the baseline of the target and for AVX2+FMA (picked at run time), where the NR loops are
+ * vectorized on 8 lanes with fused multiply-adds
+ */
+#define TB_SMALL_DOT_KERNELS(suffix, TARGET)\
+TB_SMALL_DOT_KERNEL(_tb_smallDotNN_4x32##suffix, 4, 32, TB_SMALL_DOT_NN, TARGET)\
+TB_SMALL_DOT_KERNEL(_tb_smallDotNN_4x16##suffix, 4, 16, TB_SMALL_DOT_NN, TARGET)\
+TB_SMALL_DOT_KERNEL(_tb_smallDotNN_4x8##suffix, 4, 8, TB_SMALL_DOT_NN, TARGET)\
+TB_SMALL_DOT_KERNEL(_tb_smallDotNN_4x1##suffix, 4, 1, TB_SMALL_DOT_NN, TARGET)\
+TB_SMALL_DOT_KERNEL(_tb_smallDotNN_1x32##suffix, 1, 32, TB_SMALL_DOT_NN, TARGET)\
+TB_SMALL_DOT_KERNEL(_tb_smallDotNN_1x16##suffix, 1, 16, TB_SMALL_DOT_NN, TARGET)\
+TB_SMALL_DOT_KERNEL(_tb_smallDotNN_1x8##suffix, 1, 8, TB_SMALL_DOT_NN, TARGET)\
+TB_SMALL_DOT_KERNEL(_tb_smallDotNN_1x1##suffix, 1, 1, TB_SMALL_DOT_NN, TARGET)\
+\
+TB_SMALL_DOT_KERNEL(_tb_smallDotNT_4x32##suffix, 4, 32, TB_SMALL_DOT_NT, TARGET)\
+TB_SMALL_DOT_KERNEL(_tb_smallDotNT_4x16##suffix, 4, 16, TB_SMALL_DOT_NT, TARGET)\
+TB_SMALL_DOT_KERNEL(_tb_smallDotNT_4x8##suffix, 4, 8, TB_SMALL_DOT_NT, TARGET)\
+TB_SMALL_DOT_KERNEL(_tb_smallDotNT_4x1##suffix, 4, 1, TB_SMALL_DOT_NT, TARGET)\
+TB_SMALL_DOT_KERNEL(_tb_smallDotNT_1x32##suffix, 1, 32, TB_SMALL_DOT_NT, TARGET)\
+TB_SMALL_DOT_KERNEL(_tb_smallDotNT_1x16##suffix, 1, 16, TB_SMALL_DOT_NT, TARGET)\
+TB_SMALL_DOT_KERNEL(_tb_smallDotNT_1x8##suffix, 1, 8, TB_SMALL_DOT_NT, TARGET)\
+TB_SMALL_DOT_KERNEL(_tb_smallDotNT_1x1##suffix, 1, 1, TB_SMALL_DOT_NT, TARGET)
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TB_SMALL_DOT_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define TB_SMALL_DOT_AVX2
+#endif
+
+TB_SMALL_DOT_KERNELS(, )
+TB_SMALL_DOT_KERNELS(_avx2, TB_SMALL_DOT_AVX2)
+
+#undef TB_SMALL_DOT_KERNEL
+#undef TB_SMALL_DOT_KERNELS
+#undef TB_SMALL_DOT_AVX2
+#undef TB_SMALL_DOT_NN
+#undef TB_SMALL_DOT_NT
+
+typedef void (*_TBSmallDotKernel)(uint64_t K, const tb_float* a, uint64_t ars, uint64_t acs, const tb_float* b, uint64_t ldb, tb_float* c, uint64_t ldc);
+
+/* Indexed by [AVX2+FMA][transposed B][4 rows][32, 16, 8 or 1 columns] */
+static const _TBSmallDotKernel _tb_smallDotKernels[2][2][2][4] = {
+    {{{_tb_smallDotNN_1x32, _tb_smallDotNN_1x16, _tb_smallDotNN_1x8, _tb_smallDotNN_1x1},
+      {_tb_smallDotNN_4x32, _tb_smallDotNN_4x16, _tb_smallDotNN_4x8, _tb_smallDotNN_4x1}},
+     {{_tb_smallDotNT_1x32, _tb_smallDotNT_1x16, _tb_smallDotNT_1x8, _tb_smallDotNT_1x1},
+      {_tb_smallDotNT_4x32, _tb_smallDotNT_4x16, _tb_smallDotNT_4x8, _tb_smallDotNT_4x1}}},
+    {{{_tb_smallDotNN_1x32_avx2, _tb_smallDotNN_1x16_avx2, _tb_smallDotNN_1x8_avx2, _tb_smallDotNN_1x1_avx2},
+      {_tb_smallDotNN_4x32_avx2, _tb_smallDotNN_4x16_avx2, _tb_smallDotNN_4x8_avx2, _tb_smallDotNN_4x1_avx2}},
+     {{_tb_smallDotNT_1x32_avx2, _tb_smallDotNT_1x16_avx2, _tb_smallDotNT_1x8_avx2, _tb_smallDotNT_1x1_avx2},
+      {_tb_smallDotNT_4x32_avx2, _tb_smallDotNT_4x16_avx2, _tb_smallDotNT_4x8_avx2, _tb_smallDotNT_4x1_avx2}}},
+};
+
+static inline uint8_t _tb_smallDotApplies(uint64_t M, uint64_t N, uint64_t K){
+    return (M <= TB_SMALL_DOT_MAX_DIM) && (N <= TB_SMALL_DOT_MAX_DIM) && (K <= TB_SMALL_DOT_MAX_DIM) && (M*N*K <= TB_SMALL_DOT_MACS);
+}
+
+/*
+ * out (M x N, contiguous) = A . B, covered by the widest tiles that fit.
+ */
+static void _tb_smallDotKernel(uint64_t M, uint64_t N, uint64_t K, const tb_float* a, uint64_t ars, uint64_t acs,
+                               const tb_float* b, uint64_t ldb, uint8_t transB, tb_float* out){
+    static const uint64_t widths[4] = {32, 16, 8, 1};
+    uint8_t avx2 = nda_cpuHas(NDA_CPU_AVX2 | NDA_CPU_FMA);
+    uint64_t i, j;
+
+    for(i = 0; i < M;){
+        uint8_t rows = (M - i >= 4);
+
+        for(j = 0; j < N;){
+            uint64_t rest = N - j;
+            uint8_t width = (rest >= 32) ? 0 : (rest >= 16) ? 1 : (rest >= 8) ? 2 : 3;
+
+            _tb_smallDotKernels[avx2][transB][rows][width](K, a + i*ars, ars, acs, b + (transB ? j*ldb : j), ldb, out + i*N + j, N);
+            j += widths[width];
         }
+
+        i += rows ? 4 : 1;
     }
-    
-    NDShape* newShape = nda_newShapeFromArray(new_rank, new_dims);
-    NDArray* new_arr = nda_alloc(newShape);
-    
-    i = 0;
-    uint64_t k = 0;
-    for(; i < newShape->raw_len; i++){
-        
-        uint64_t m = shape->rank;
-        uint64_t mod = i;
-        j = 0; //i/shape->strides[axis] % shape->dims[axis];
-        for(;m > 0; m--){
-            if(m-1 == axis){
-                continue;
-            }
-            else{
-                j += (mod%shape->dims[m-1])*shape->strides[m-1];
-                mod = mod/shape->dims[m-1];
-            }
-        }
-        new_arr->data[i] = arr->data[j];
+}
+
+static void _tb_dotKernel(TBGraphSession* sess, NDArray* out, NDArray* lhs, NDArray* rhs){
+    uint64_t lhsRows, lhsCols, lhsLD;
+    uint64_t rhsRows, rhsCols, rhsLD;
+    CBLAS_TRANSPOSE lhsTrans, rhsTrans;
+
+    _tb_blasMatrix(lhs, 1, &lhsRows, &lhsCols, &lhsTrans, &lhsLD);
+    _tb_blasMatrix(rhs, 0, &rhsRows, &rhsCols, &rhsTrans, &rhsLD);
+
+    if(_tb_smallDotApplies(lhsRows, rhsCols, lhsCols)){
+        uint8_t lt = (lhsTrans == CblasTrans);
+        _tb_smallDotKernel(lhsRows, rhsCols, lhsCols, lhs->data, lt ? 1 : lhsLD, lt ? lhsLD : 1,
+                           rhs->data, rhsLD, rhsTrans == CblasTrans, out->data);
+        return;
     }
-    
-    k = 0;
-    i = 0;
-    
-    for(; i < newShape->raw_len; i++){
-        
-        uint64_t m = shape->rank;
-        uint64_t mod = i;
-        j = 0; //i/shape->strides[axis] % shape->dims[axis];
-        for(;m > 0; m--){
-            if(m-1 == axis){
-                continue;
-            }
-            else{
-                j += (mod%shape->dims[m-1])*shape->strides[m-1];
-                mod = mod/shape->dims[m-1];
-                //printf("%lld, %lld, m= %lld, %f\n", i, j, m, arr->data[j]);
-            }
+
+    _tb_sessionGemm(sess, lhsTrans, rhsTrans, lhsRows, rhsCols, lhsCols,
+                    1.0, lhs->data, lhsLD, rhs->data, rhsLD, 0.0, out->data, rhsCols);
+}
+
+#define TB_GEMM_KC 256
+#define TB_GEMM_NC 256
+
+/*
+ * Copies the block [r0, r0+rows) x [c0, c0+cols) of a rank <= 2 operand into a dense tb_float panel.
+ */
+static void _tb_upcastPanel(NDArray* arr, uint64_t r0, uint64_t rows, uint64_t c0, uint64_t cols, tb_float* panel){
+    NDShape* shape = arr->shape;
+    uint64_t rs = (shape->rank == 1) ? 0 : shape->strides[0];
+    uint64_t cs = shape->strides[shape->rank-1];
+    uint64_t esize = nda_dtypeSize(arr->dtype);
+    uint64_t i, j;
+
+    for(i = 0; i < rows; i++){
+        uint64_t offset = (r0 + i)*rs + c0*cs;
+        if(cs == 1){
+            nda_toFloat((uint8_t*)arr->raw + offset*esize, arr->dtype, panel + i*cols, cols);
         }
-        
-        j+=shape->strides[axis];
-        for(k=1; k < shape->dims[axis]; j+=shape->strides[axis],k++){
-            //printf("%lld, %lld, %f\n", i, j,  arr->data[j]);
-            new_arr->data[i] = (new_arr->data[i]<arr->data[j])?new_arr->data[i]:arr->data[j];
+        else{
+            for(j = 0; j < cols; j++)
+                panel[i*cols + j] = nda_rawGet(arr, offset + j*cs);
         }
     }
-    
-    return tb_newResultNode(new_arr);
 }
 
-TBResultNode* _tb_sum(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBAxisBoundOperation* abop){
-    NDShape* shape = uhs->value->shape;
-    NDArray* arr = uhs->value;
-    
-    uint64_t axis = abop->axis;
-    
-    ASSERT(axis < shape->rank, "Cannot compute axis bound operation SUM on axis %lld >= array of rank %llu", axis, shape->rank);
-    
-    uint64_t* new_dims = NULL;
-    uint64_t new_rank = 1;
-    if(shape->rank == 1){
-        new_dims = calloc(1, sizeof(uint64_t));
-        new_dims[0] = 1;
-    }
-    else{
-        new_dims = calloc(shape->rank-1, sizeof(uint64_t));
-        new_rank =shape->rank-1;
-    }
-    
-    uint64_t i = 0;
-    uint64_t j = 0;
-    for(; i < shape->rank; i++){
-        if (i != axis){
-            new_dims[j++] = shape->dims[i];
-        }
-    }
-    
-    NDShape* newShape = nda_newShapeFromArray(new_rank, new_dims);
-    NDArray* new_arr = nda_alloc(newShape);
-    
-    i = 0;
-    uint64_t k = 0;
-    for(; i < newShape->raw_len; i++){
-        
-        uint64_t m = shape->rank;
-        uint64_t mod = i;
-        j = 0; //i/shape->strides[axis] % shape->dims[axis];
-        for(;m > 0; m--){
-            if(m-1 == axis){
-                continue;
-            }
-            else{
-                j += (mod%shape->dims[m-1])*shape->strides[m-1];
-                mod = mod/shape->dims[m-1];
-                //printf("%lld, %lld, m= %lld, %f\n", i, j, m, arr->data[j]);
-            }
-        }
-        
-        
-        for(k=0; k < shape->dims[axis]; j+=shape->strides[axis],k++){
-            //printf("%lld, %lld, %f\n", i, j,  arr->data[j]);
-            new_arr->data[i] += arr->data[j];
+/*
+ * DOT product of reduced precision operands. The reduction dimension and the output columns are tiled,
+ * each tile of the operands is upcast into a small tb_float panel and accumulated into the output by GEMM,
+ * so a full precision copy of the (usually large) weights is never materialized.
+ */
+static void _tb_dotUpcastKernel(TBGraphSession* sess, NDArray* out, NDArray* lhs, NDArray* rhs){
+    uint64_t M = (lhs->shape->rank == 1) ? 1 : lhs->shape->dims[0];
+    uint64_t K = lhs->shape->dims[lhs->shape->rank-1];
+    uint64_t N = rhs->shape->dims[rhs->shape->rank-1];
+
+    uint64_t kc = (K < TB_GEMM_KC) ? K : TB_GEMM_KC;
+    uint64_t nc = (N < TB_GEMM_NC) ? N : TB_GEMM_NC;
+    tb_float* a = _tb_scratch(M*kc, sizeof(tb_float));
+    tb_float* b = _tb_scratch(kc*nc, sizeof(tb_float));
+    uint64_t k0, n0;
+
+    for(k0 = 0; k0 < K; k0 += kc){
+        uint64_t kb = (K - k0 < kc) ? K - k0 : kc;
+        _tb_upcastPanel(lhs, 0, M, k0, kb, a);
+
+        for(n0 = 0; n0 < N; n0 += nc){
+            uint64_t nb = (N - n0 < nc) ? N - n0 : nc;
+            _tb_upcastPanel(rhs, k0, kb, n0, nb, b);
+
+            _tb_sessionGemm(sess, CblasNoTrans, CblasNoTrans, M, nb, kb,
+                            1.0, a, kb, b, nb, (k0 == 0) ? 0.0 : 1.0, out->data + n0, N);
         }
     }
-    
-    return tb_newResultNode(new_arr);
+
+    _tb_releaseScratch(b);
+    _tb_releaseScratch(a);
 }
 
-TBResultNode* _tb_mean(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBAxisBoundOperation* abop){
-    return NULL;
+/*
+ * Reduced precision operands of a DOT product, neither quantized nor sparse, are upcast by panels.
+ */
+static inline uint8_t _tb_dotUpcasts(NDArray* lhs, NDArray* rhs){
+    return ((lhs->dtype != NDA_DTYPE_FLOAT) || (rhs->dtype != NDA_DTYPE_FLOAT)) &&
+           (lhs->quant == NULL) && (rhs->quant == NULL) && (lhs->sparse == NULL) && (rhs->sparse == NULL);
 }
 
-TBResultNode* _tb_argmax(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBAxisBoundOperation* abop){
-    NDShape* shape = uhs->value->shape;
-    //NDArray* arr = uhs->value;
-    
-    uint64_t axis = abop->axis;
-    
-    ASSERT(axis < shape->rank, "Cannot compute axis bound operation MAX on axis %lld >= array of rank %llu", axis, shape->rank);
-    
-    uint64_t* new_dims = NULL;
-    uint64_t new_rank = 1;
-    if(shape->rank == 1){
-        new_dims = calloc(1, sizeof(uint64_t));
-        new_dims[0] = 1;
-    }
-    else{
-        new_dims = calloc(shape->rank-1, sizeof(uint64_t));
-        new_rank =shape->rank-1;
+uint64_t _tb_binaryWorkspace(TBBinaryOperationType type, NDArray* out, NDArray* lhs, NDArray* rhs){
+    if((type != TBBOT_DOT) || (out->dtype != NDA_DTYPE_FLOAT) || !_tb_dotUpcasts(lhs, rhs))
+        return 0;
+
+    uint64_t M = (lhs->shape->rank == 1) ? 1 : lhs->shape->dims[0];
+    uint64_t K = lhs->shape->dims[lhs->shape->rank-1];
+    uint64_t N = rhs->shape->dims[rhs->shape->rank-1];
+    uint64_t kc = (K < TB_GEMM_KC) ? K : TB_GEMM_KC;
+    uint64_t nc = (N < TB_GEMM_NC) ? N : TB_GEMM_NC;
+
+    return _tb_scratchBytes(M*kc, sizeof(tb_float)) + _tb_scratchBytes(kc*nc, sizeof(tb_float));
+}
+
+/*
+ * Integer outputs, `tb_binaryOpDType` guarantees both operands share the output dtype.
+ */
+static void _tb_integerBinaryInto(TBBinaryOperationType type, NDArray* out, NDArray* lhs, NDArray* rhs){
+    uint8_t wide = (out->dtype == NDA_DTYPE_I64);
+
+    switch(type){
+        case TBBOT_ADD:
+            wide ? _tb_addKernelI64(out, lhs, rhs) : _tb_addKernelI32(out, lhs, rhs);
+            break;
+        case TBBOT_SUB:
+            wide ? _tb_subKernelI64(out, lhs, rhs) : _tb_subKernelI32(out, lhs, rhs);
+            break;
+        case TBBOT_MULT:
+            wide ? _tb_mulKernelI64(out, lhs, rhs) : _tb_mulKernelI32(out, lhs, rhs);
+            break;
+        default:
+            ASSERT(0, "Binary operation %d has no %s kernel", type, nda_dtypeName(out->dtype));
+            break;
     }
-    
-    uint64_t i = 0;
-    uint64_t j = 0;
-    for(; i < shape->rank; i++){
-        if (i != axis){
-            new_dims[j++] = shape->dims[i];
-        }
+}
+
+/*
+ * Operands stored in another dtype than tb_float are computed in tb_float, returns `arr` itself or
+ * a converted copy to release with `_tb_releaseUpcast`. Quantized operands are dequantized, sparse
+ * operands are densified.
+ */
+static inline NDArray* _tb_upcast(NDArray* arr){
+    if(arr->sparse != NULL){
+        return nda_sparseToDense(arr);
     }
-    
-    NDShape* newShape = nda_newShapeFromArray(new_rank, new_dims);
-    NDArray* new_arr = nda_alloc(newShape);
-    
-    i = 0;
-    uint64_t k = 0;
-    for(; i < newShape->raw_len; i++){
-        
-        uint64_t m = shape->rank;
-        uint64_t mod = i;
-        j = 0; //i/shape->strides[axis] % shape->dims[axis];
-        for(;m > 0; m--){
-            if(m-1 == axis){
-                continue;
-            }
-            else{
-                j += (mod%shape->dims[m-1])*shape->strides[m-1];
-                mod = mod/shape->dims[m-1];
-            }
-        }
-        new_arr->data[i] = 0;
+
+    if(arr->quant != NULL){
+        return nda_dequantize(arr);
     }
-    
-    k = 0;
-    i = 0;
-    
-    for(; i < newShape->raw_len; i++){
-        
-        uint64_t m = shape->rank;
-        uint64_t mod = i;
-        j = 0; //i/shape->strides[axis] % shape->dims[axis];
-        for(;m > 0; m--){
-            if(m-1 == axis){
-                continue;
-            }
-            else{
-                j += (mod%shape->dims[m-1])*shape->strides[m-1];
-                mod = mod/shape->dims[m-1];
-                //printf("%lld, %lld, m= %lld, %f\n", i, j, m, arr->data[j]);
-            }
-        }
-        
-        j+=shape->strides[axis];
-        for(k=1; k < shape->dims[axis]; j+=shape->strides[axis],k++){
-            //printf("%lld, %lld, %f\n", i, j,  arr->data[j]);
-            new_arr->data[i] = (new_arr->data[i]>k)?new_arr->data[i]:k;
-        }
+
+    return (arr->dtype == NDA_DTYPE_FLOAT) ? arr : nda_cast(arr, NDA_DTYPE_FLOAT);
+}
+
+static inline void _tb_releaseUpcast(NDArray* arr, NDArray* orig){
+    if(arr != orig){
+        nda_free(arr);
+        free(arr);
     }
-    
-    return tb_newResultNode(new_arr);
 }
 
+#ifdef TB_F64_KERNELS
+/*
+ * Same as `_tb_upcast` for the double kernels, dense operands are converted to F64 without going through tb_float.
+ */
+static NDArray* _tb_upcastF64(NDArray* arr){
+    if((arr->sparse == NULL) && (arr->quant == NULL))
+        return (arr->dtype == NDA_DTYPE_F64) ? arr : nda_cast(arr, NDA_DTYPE_F64);
 
-TBResultNode* _tb_argmin(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBAxisBoundOperation* abop){
-    NDShape* shape = uhs->value->shape;
-    //NDArray* arr = uhs->value;
-    
-    uint64_t axis = abop->axis;
-    
-    ASSERT(axis < shape->rank, "Cannot compute axis bound operation MAX on axis %lld >= array of rank %llu", axis, shape->rank);
-    
-    uint64_t* new_dims = NULL;
-    uint64_t new_rank = 1;
-    if(shape->rank == 1){
-        new_dims = calloc(1, sizeof(uint64_t));
-        new_dims[0] = 1;
-    }
-    else{
-        new_dims = calloc(shape->rank-1, sizeof(uint64_t));
-        new_rank =shape->rank-1;
-    }
-    
-    uint64_t i = 0;
-    uint64_t j = 0;
-    for(; i < shape->rank; i++){
-        if (i != axis){
-            new_dims[j++] = shape->dims[i];
+    NDArray* u = _tb_upcast(arr);
+    NDArray* d = nda_cast(u, NDA_DTYPE_F64);
+    _tb_releaseUpcast(u, arr);
+
+    return d;
+}
+
+/*
+ * F64 DOT product, dgemm when the library has BLAS, a plain i-k-j loop otherwise.
+ */
+static void _tb_dotKernelF64(NDArray* out, NDArray* lhs, NDArray* rhs){
+    uint64_t M, K, N, unused, lda, ldb;
+    CBLAS_TRANSPOSE transA, transB;
+
+    _tb_blasMatrix(lhs, 1, &M, &K, &transA, &lda);
+    _tb_blasMatrix(rhs, 0, &unused, &N, &transB, &ldb);
+
+    const double* a = (const double*)lhs->raw;
+    const double* b = (const double*)rhs->raw;
+    double* c = (double*)out->raw;
+
+#ifdef TB_NO_BLAS
+    uint64_t ars = (transA == CblasTrans) ? 1 : lda, acs = (transA == CblasTrans) ? lda : 1;
+    uint64_t brs = (transB == CblasTrans) ? 1 : ldb, bcs = (transB == CblasTrans) ? ldb : 1;
+    uint64_t i, j, k;
+
+    memset(c, 0, M*N*sizeof(double));
+    for(i = 0; i < M; i++){
+        for(k = 0; k < K; k++){
+            double aik = a[i*ars + k*acs];
+            for(j = 0; j < N; j++)
+                c[i*N + j] += aik*b[k*brs + j*bcs];
         }
     }
-    
-    NDShape* newShape = nda_newShapeFromArray(new_rank, new_dims);
-    NDArray* new_arr = nda_alloc(newShape);
-    
-    i = 0;
-    uint64_t k = 0;
-    for(; i < newShape->raw_len; i++){
-        
-        uint64_t m = shape->rank;
-        uint64_t mod = i;
-        j = 0; //i/shape->strides[axis] % shape->dims[axis];
-        for(;m > 0; m--){
-            if(m-1 == axis){
-                continue;
-            }
-            else{
-                j += (mod%shape->dims[m-1])*shape->strides[m-1];
-                mod = mod/shape->dims[m-1];
-            }
-        }
-        new_arr->data[i] = 0;
+#else
+    cblas_dgemm(CblasRowMajor, transA, transB, M, N, K, 1.0, a, lda, b, ldb, 0.0, c, N);
+#endif
+}
+
+/*
+ * F64 outputs, operands of any other dtype are converted to F64 first.
+ */
+static void _tb_doubleBinaryInto(TBBinaryOperationType type, NDArray* out, NDArray* lhs, NDArray* rhs){
+    NDArray* l = _tb_upcastF64(lhs);
+    NDArray* r = _tb_upcastF64(rhs);
+
+    switch(type){
+        case TBBOT_ADD:
+            _tb_addKernelF64(out, l, r);
+            break;
+        case TBBOT_SUB:
+            _tb_subKernelF64(out, l, r);
+            break;
+        case TBBOT_MULT:
+            _tb_mulKernelF64(out, l, r);
+            break;
+        case TBBOT_DIV:
+            _tb_divKernelF64(out, l, r);
+            break;
+        case TBBOT_POW:
+            _tb_powKernelF64(out, l, r);
+            break;
+        case TBBOT_DOT:
+            _tb_dotKernelF64(out, l, r);
+            break;
     }
-    
-    k = 0;
-    i = 0;
-    
-    for(; i < newShape->raw_len; i++){
-        
-        uint64_t m = shape->rank;
-        uint64_t mod = i;
-        j = 0; //i/shape->strides[axis] % shape->dims[axis];
-        for(;m > 0; m--){
-            if(m-1 == axis){
-                continue;
-            }
-            else{
-                j += (mod%shape->dims[m-1])*shape->strides[m-1];
-                mod = mod/shape->dims[m-1];
-                //printf("%lld, %lld, m= %lld, %f\n", i, j, m, arr->data[j]);
+
+    _tb_releaseUpcast(l, lhs);
+    _tb_releaseUpcast(r, rhs);
+}
+#endif
+
+uint8_t _tb_isQuantizedDot(NDArray* lhs, NDArray* rhs){
+    NDQuantParams* lq = lhs->quant;
+    NDQuantParams* rq = rhs->quant;
+
+    if((lq == NULL) || (rq == NULL) || (lhs->dtype != NDA_DTYPE_U8) || (rhs->dtype != NDA_DTYPE_I8))
+        return 0;
+
+    if((lhs->shape->rank > 2) || (rhs->shape->rank != 2) || !_tb_isContiguous(lhs->shape))
+        return 0;
+
+    uint64_t N = rhs->shape->dims[1];
+
+    return (lq->count == 1) && (rq->zero_point == 0) && ((rq->count == 1) || ((rq->count == N) && (rq->axis == 1)));
+}
+
+void _tb_quantizedDotInto(TBGraphSession* sess, NDArray* out, NDArray* lhs, NDArray* rhs, const TBQGemmPacked* packed,
+                          float scale, int32_t zero_point){
+    ASSERT(_tb_isQuantizedDot(lhs, rhs), "Quantized DOT needs an asymmetric per-tensor U8 LHS and a symmetric I8 RHS");
+
+    uint64_t M = (lhs->shape->rank == 1) ? 1 : lhs->shape->dims[0];
+    uint64_t K = lhs->shape->dims[lhs->shape->rank-1];
+    uint64_t N = rhs->shape->dims[1];
+
+    TBQGemmOutput output = {out->dtype, out->raw, N, lhs->quant->scales[0], rhs->quant->scales, (rhs->quant->count > 1),
+                            1.0f/scale, zero_point};
+
+    tb_qgemm((sess != NULL) ? sess->pool : NULL, (sess != NULL) ? sess->threads : 0, M, N, K,
+             (const uint8_t*)lhs->raw, K, lhs->quant->zero_point,
+             (const int8_t*)rhs->raw, rhs->shape->strides[0], rhs->shape->strides[1], packed, &output);
+}
+
+/*
+ * Number of threads of a parallel kernel: the limit of the session or every online CPU, reduced so that each
+ * thread gets at least `grain` units of work and one of the `max` independent pieces.
+ */
+static uint64_t _tb_parallelThreads(TBGraphSession* sess, uint64_t work, uint64_t grain, uint64_t max){
+    uint64_t threads = ((sess != NULL) && (sess->threads != 0)) ? sess->threads : (uint64_t)sysconf(_SC_NPROCESSORS_ONLN);
+
+    if(threads > work/grain)
+        threads = work/grain;
+    if(threads > max)
+        threads = max;
+
+    return (threads == 0) ? 1 : threads;
+}
+
+/*
+ * Runs the tasks of a parallel kernel on the pool of the session, the first one on the calling thread.
+ */
+static inline void _tb_parallelRun(TBGraphSession* sess, uint64_t n, void* (*worker)(void*), void* tasks, uint64_t task_size){
+    tb_poolRun((sess != NULL) ? sess->pool : NULL, n, worker, tasks, task_size);
+}
+
+/* Workspace of the prepared run executed by the thread, NULL out of a prepared run */
+static __thread TBWorkspace* _tb_workspace = NULL;
+
+TBWorkspace* _tb_setWorkspace(TBWorkspace* workspace){
+    TBWorkspace* previous = _tb_workspace;
+    _tb_workspace = workspace;
+
+    return previous;
+}
+
+uint64_t _tb_scratchBytes(uint64_t count, uint64_t size){
+    return (count*size + 63) & ~(uint64_t)63;
+}
+
+void* _tb_scratch(uint64_t count, uint64_t size){
+    TBWorkspace* workspace = _tb_workspace;
+    uint64_t bytes = _tb_scratchBytes(count, size);
+
+    if((workspace != NULL) && (workspace->used + bytes <= workspace->size)){
+        void* scratch = workspace->data + workspace->used;
+        workspace->used += bytes;
+        return scratch;
+    }
+
+    return nda_memCalloc(bytes ? bytes : 1, 1);
+}
+
+void _tb_releaseScratch(void* scratch){
+    TBWorkspace* workspace = _tb_workspace;
+
+    if((workspace != NULL) && ((uint8_t*)scratch >= workspace->data) && ((uint8_t*)scratch < workspace->data + workspace->size))
+        return;
+
+    nda_memFree(scratch);
+}
+
+/* Minimum number of multiply-adds given to each worker of the sparse kernels */
+#define TB_SPARSE_GRAIN 32768
+
+typedef struct _TBSparseTask{
+    NDArray* out;                  /**< Destination array */
+    NDArray* lhs;                  /**< Sparse operand */
+    NDArray* rhs;                  /**< Dense operand, read through its strides */
+    NDArray* g;                    /**< Dense upstream gradient of the masked kernel, NULL for the product */
+    NDSparse* index;               /**< CSR index of the sparse operand, see `nda_sparseCSRIndex` */
+    uint64_t row0;                 /**< First row of the sparse operand given to the worker */
+    uint64_t row1;                 /**< Last row (excluded) of the sparse operand given to the worker */
+}_TBSparseTask;
+
+/*
+ * out[m, :] = sum_k S[m, k] * rhs[k, :], the rows of `out` are owned by a single worker.
+ */
+static void* _tb_sparseDotWorker(void* arg){
+    _TBSparseTask* task = (_TBSparseTask*)arg;
+    NDSparse* sparse = task->index;
+    NDShape* shape = task->rhs->shape;
+    uint64_t N = (shape->rank == 1) ? 1 : shape->dims[1];
+    uint64_t s0 = shape->strides[0], s1 = (shape->rank == 1) ? 0 : shape->strides[1];
+    uint64_t m, p, n;
+
+    for(m = task->row0; m < task->row1; m++){
+        tb_float* dst = task->out->data + m*N;
+        memset(dst, 0, N*sizeof(tb_float));
+
+        for(p = sparse->row_ptr[m]; p < sparse->row_ptr[m + 1]; p++){
+            tb_float v = task->lhs->data[p];
+            tb_float* src = task->rhs->data + sparse->col_idx[p]*s0;
+
+            if(s1 == 1){
+                for(n = 0; n < N; n++)
+                    dst[n] += v*src[n];
+            }
+            else{
+                for(n = 0; n < N; n++)
+                    dst[n] += v*src[n*s1];
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * out.values[p] += sum_n g[m, n] * w[k, n] at each stored position p = (m, k) of `out`.
+ */
+static void* _tb_sparseMaskedWorker(void* arg){
+    _TBSparseTask* task = (_TBSparseTask*)arg;
+    NDSparse* sparse = task->index;
+    NDShape* gshape = task->g->shape;
+    NDShape* wshape = task->rhs->shape;
+    uint64_t N = (gshape->rank == 1) ? 1 : gshape->dims[1];
+    uint64_t g0 = gshape->strides[0], g1 = (gshape->rank == 1) ? 0 : gshape->strides[1];
+    uint64_t w0 = wshape->strides[0], w1 = (wshape->rank == 1) ? 0 : wshape->strides[1];
+    uint64_t m, p, n;
+
+    for(m = task->row0; m < task->row1; m++){
+        tb_float* grow = task->g->data + m*g0;
+
+        for(p = sparse->row_ptr[m]; p < sparse->row_ptr[m + 1]; p++){
+            tb_float* wrow = task->rhs->data + sparse->col_idx[p]*w0;
+            double acc = 0;
+
+            for(n = 0; n < N; n++)
+                acc += grow[n*g1]*wrow[n*w1];
+
+            task->out->data[p] += (tb_float)acc;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Splits the rows of `sparse` into ranges of about the same number of stored values and runs `worker` on each
+ * range, on the calling thread when the product is too small to amortize the threads.
+ */
+static void _tb_sparseParallel(TBGraphSession* sess, NDSparse* sparse, uint64_t N, void* (*worker)(void*), _TBSparseTask* proto){
+    uint64_t threads = _tb_parallelThreads(sess, sparse->nnz*N, TB_SPARSE_GRAIN, sparse->rows);
+    uint64_t i = 0, m = 0;
+
+    if(threads == 1){
+        _TBSparseTask task = *proto;
+        task.row0 = 0;
+        task.row1 = sparse->rows;
+        worker(&task);
+        return;
+    }
+
+    _TBSparseTask tasks[threads];
+
+    for(; i < threads; i++){
+        uint64_t target = (sparse->nnz*(i + 1))/threads;
+
+        tasks[i] = *proto;
+        tasks[i].row0 = m;
+
+        while((m < sparse->rows) && ((sparse->row_ptr[m + 1] <= target) || (i == threads - 1)))
+            m++;
+
+        tasks[i].row1 = m;
+    }
+
+    // the calling thread takes the first range
+    _tb_parallelRun(sess, threads, worker, tasks, sizeof(*tasks));
+}
+
+static void _tb_sparseDotKernel(TBGraphSession* sess, NDArray* out, NDArray* lhs, NDArray* rhs){
+    _TBSparseTask proto = {out, lhs, rhs, NULL, nda_sparseCSRIndex(lhs), 0, 0};
+    uint64_t N = (rhs->shape->rank == 1) ? 1 : rhs->shape->dims[1];
+
+    _tb_sparseParallel(sess, proto.index, N, _tb_sparseDotWorker, &proto);
+
+    if(proto.index != lhs->sparse)
+        nda_freeSparseIndex(proto.index);
+}
+
+void _tb_sparseMaskedDotAccumulate(TBGraphSession* sess, NDArray* out, NDArray* g, NDArray* w){
+    NDArray* gf = _tb_upcast(g);
+    NDArray* wf = _tb_upcast(w);
+    _TBSparseTask proto = {out, NULL, wf, gf, nda_sparseCSRIndex(out), 0, 0};
+    uint64_t N = (gf->shape->rank == 1) ? 1 : gf->shape->dims[1];
+
+    _tb_sparseParallel(sess, proto.index, N, _tb_sparseMaskedWorker, &proto);
+
+    if(proto.index != out->sparse)
+        nda_freeSparseIndex(proto.index);
+
+    _tb_releaseUpcast(gf, g);
+    _tb_releaseUpcast(wf, w);
+}
+
+#undef TB_SPARSE_GRAIN
+
+/* Rows and columns of the register tile of the packed GEMM micro-kernel */
+#define TB_PACK_MR 4
+#define TB_PACK_NR 16
+/* Minimum number of multiply-adds given to each worker of the packed GEMM */
+#define TB_PACK_GRAIN 262144
+/* Largest LHS for which the packed kernel is used, above it the cost of packing is amortized by BLAS itself */
+#define TB_PACK_MAX_ROWS 64
+
+uint8_t _tb_packable(NDArray* rhs){
+    return (rhs->dtype == NDA_DTYPE_FLOAT) && (rhs->quant == NULL) && (rhs->sparse == NULL) && (rhs->shape->rank == 2);
+}
+
+uint8_t _tb_packedDotApplies(NDArray* lhs, NDArray* rhs){
+    uint64_t M = (lhs->shape->rank == 1) ? 1 : lhs->shape->dims[0];
+
+    return _tb_packable(rhs) && (lhs->dtype == NDA_DTYPE_FLOAT) && (lhs->quant == NULL) && (lhs->sparse == NULL) &&
+           (lhs->shape->rank <= 2) && (M <= TB_PACK_MAX_ROWS);
+}
+
+/*
+ * Panel p holds the columns [p*NR, (p+1)*NR) of the (K, N) matrix as K contiguous rows of NR values, the last panel
+ * is padded with zeros so that the micro-kernel never tests the width.
+ */
+TBPackedMatrix* _tb_packMatrix(NDArray* rhs){
+    NDShape* shape = rhs->shape;
+    uint64_t K = shape->dims[0], N = shape->dims[1];
+    uint64_t panels = (N + TB_PACK_NR - 1)/TB_PACK_NR;
+    uint64_t p, k, j;
+
+    TBPackedMatrix* packed = calloc(1, sizeof(TBPackedMatrix));
+    packed->K = K;
+    packed->N = N;
+    packed->data = nda_memCalloc(panels*K*TB_PACK_NR, sizeof(tb_float));
+
+    for(p = 0; p < panels; p++){
+        uint64_t width = (N - p*TB_PACK_NR < TB_PACK_NR) ? N - p*TB_PACK_NR : TB_PACK_NR;
+        tb_float* panel = packed->data + p*K*TB_PACK_NR;
+
+        for(k = 0; k < K; k++){
+            const tb_float* src = rhs->data + k*shape->strides[0] + p*TB_PACK_NR*shape->strides[1];
+
+            for(j = 0; j < width; j++)
+                panel[k*TB_PACK_NR + j] = src[j*shape->strides[1]];
+        }
+    }
+
+    return packed;
+}
+
+void _tb_freePackedMatrix(TBPackedMatrix* packed){
+    nda_memFree(packed->data);
+    free(packed);
+}
+
+typedef struct _TBPackTask{
+    NDArray* out;                  /**< Contiguous (M, N) destination */
+    NDArray* lhs;                  /**< tb_float LHS, read through its strides */
+    TBPackedMatrix* b;             /**< Packed RHS */
+    uint64_t panel0;               /**< First panel given to the worker */
+    uint64_t panel1;               /**< Last panel (excluded) given to the worker */
+}_TBPackTask;
+
+/*
+ * MR x NR tile of the output, accumulated over the whole reduction. The panel is read sequentially, NR values per
+ * step, against one value of each of the MR rows of the LHS.
+ */
+static inline void _tb_packedMicroKernel(uint64_t K, const tb_float** a, uint64_t cs, const tb_float* b, tb_float acc[TB_PACK_MR][TB_PACK_NR]){
+    uint64_t k, i, j;
+
+    memset(acc, 0, TB_PACK_MR*TB_PACK_NR*sizeof(tb_float));
+
+    for(k = 0; k < K; k++){
+        const tb_float* bk = b + k*TB_PACK_NR;
+
+        for(i = 0; i < TB_PACK_MR; i++){
+            tb_float av = a[i][k*cs];
+
+            for(j = 0; j < TB_PACK_NR; j++)
+                acc[i][j] += av*bk[j];
+        }
+    }
+}
+
+static void* _tb_packedDotWorker(void* arg){
+    _TBPackTask* task = (_TBPackTask*)arg;
+    NDShape* shape = task->lhs->shape;
+    uint64_t M = (shape->rank == 1) ? 1 : shape->dims[0];
+    uint64_t rs = (shape->rank == 1) ? 0 : shape->strides[0];
+    uint64_t cs = shape->strides[shape->rank - 1];
+    uint64_t K = task->b->K, N = task->b->N;
+    uint64_t p, m0, i, j;
+    tb_float acc[TB_PACK_MR][TB_PACK_NR];
+    const tb_float* rows[TB_PACK_MR];
+
+    for(p = task->panel0; p < task->panel1; p++){
+        const tb_float* panel = task->b->data + p*K*TB_PACK_NR;
+        uint64_t n0 = p*TB_PACK_NR;
+        uint64_t width = (N - n0 < TB_PACK_NR) ? N - n0 : TB_PACK_NR;
+
+        for(m0 = 0; m0 < M; m0 += TB_PACK_MR){
+            uint64_t height = (M - m0 < TB_PACK_MR) ? M - m0 : TB_PACK_MR;
+
+            // rows past the end repeat the last row, their results are dropped
+            for(i = 0; i < TB_PACK_MR; i++)
+                rows[i] = task->lhs->data + ((i < height) ? m0 + i : M - 1)*rs;
+
+            _tb_packedMicroKernel(K, rows, cs, panel, acc);
+
+            for(i = 0; i < height; i++)
+                for(j = 0; j < width; j++)
+                    task->out->data[(m0 + i)*N + n0 + j] = acc[i][j];
+        }
+    }
+
+    return NULL;
+}
+
+void _tb_packedDotInto(TBGraphSession* sess, NDArray* out, NDArray* lhs, TBPackedMatrix* rhs){
+    uint64_t M = (lhs->shape->rank == 1) ? 1 : lhs->shape->dims[0];
+    uint64_t panels = (rhs->N + TB_PACK_NR - 1)/TB_PACK_NR;
+    uint64_t threads = _tb_parallelThreads(sess, M*rhs->N*rhs->K, TB_PACK_GRAIN, panels);
+    uint64_t i = 0;
+    _TBPackTask tasks[threads];
+
+    for(; i < threads; i++){
+        _TBPackTask task = {out, lhs, rhs, (panels*i)/threads, (panels*(i + 1))/threads};
+        tasks[i] = task;
+    }
+
+    _tb_parallelRun(sess, threads, _tb_packedDotWorker, tasks, sizeof(*tasks));
+}
+
+#undef TB_PACK_MR
+#undef TB_PACK_NR
+#undef TB_PACK_GRAIN
+#undef TB_PACK_MAX_ROWS
+
+/* Minimum number of bytes copied by each worker of the gather kernel */
+#define TB_GATHER_GRAIN 65536
+/* Distance, in rows, at which the table rows are prefetched */
+#define TB_GATHER_PREFETCH 8
+
+/*
+ * Reads the i-th index in row-major order, indices can be strided and stored as I32, I64 or tb_float.
+ */
+static inline uint64_t _tb_gatherIndex(NDArray* indices, uint64_t i){
+    NDShape* shape = indices->shape;
+    uint64_t off = 0;
+    int64_t d = (int64_t)shape->rank - 1;
+
+    for(; d >= 0; d--){
+        off += (i % shape->dims[d])*shape->strides[d];
+        i /= shape->dims[d];
+    }
+
+    switch(indices->dtype){
+        case NDA_DTYPE_I32:
+            return (uint64_t)((int32_t*)indices->raw)[off];
+        case NDA_DTYPE_I64:
+            return (uint64_t)((int64_t*)indices->raw)[off];
+        default:
+            return (uint64_t)nda_rawGet(indices, off);
+    }
+}
+
+typedef struct _TBGatherTask{
+    NDArray* out;                  /**< Destination array */
+    NDArray* table;                /**< Table, contiguous or a strided matrix */
+    NDArray* indices;              /**< Row indices */
+    uint64_t row0;                 /**< First output row given to the worker */
+    uint64_t row1;                 /**< Last output row (excluded) given to the worker */
+}_TBGatherTask;
+
+static void* _tb_gatherWorker(void* arg){
+    _TBGatherTask* task = (_TBGatherTask*)arg;
+    NDShape* shape = task->table->shape;
+    uint64_t rows = shape->dims[0];
+    uint64_t cols = shape->raw_len/rows;
+    uint64_t esize = nda_dtypeSize(task->table->dtype);
+    uint64_t stride = shape->strides[0]*esize;
+    uint64_t step = ((shape->rank == 1) ? 1 : shape->strides[shape->rank - 1])*esize;
+    uint8_t contiguous = _tb_isContiguous(shape);
+    uint8_t* src = (uint8_t*)task->table->raw;
+    uint8_t* dst = (uint8_t*)task->out->raw + task->row0*cols*esize;
+    uint64_t i, c;
+
+    for(i = task->row0; i < task->row1; i++, dst += cols*esize){
+        uint64_t r = _tb_gatherIndex(task->indices, i);
+        ASSERT(r < rows, "Gather index %"PRIu64" is out of a table of %"PRIu64" rows", r, rows);
+
+#if defined(__GNUC__)
+        // rows of large tables are cache misses, the ones a few iterations ahead are requested early
+        if(i + TB_GATHER_PREFETCH < task->row1){
+            uint64_t next = _tb_gatherIndex(task->indices, i + TB_GATHER_PREFETCH);
+            if(next < rows){
+                for(c = 0; c < cols*esize; c += 64)
+                    __builtin_prefetch(src + next*stride + c, 0, 0);
+            }
+        }
+#endif
+
+        if(contiguous){
+            memcpy(dst, src + r*stride, cols*esize);
+        }
+        else{
+            for(c = 0; c < cols; c++)
+                memcpy(dst + c*esize, src + r*stride + c*step, esize);
+        }
+    }
+
+    return NULL;
+}
+
+#undef TB_GATHER_PREFETCH
+
+NDQuantParams* _tb_gatherQuant(NDQuantParams* quant, uint64_t irank){
+    NDQuantParams* res = nda_copyQuantParams(quant);
+
+    if((res != NULL) && (res->count > 1)){
+        ASSERT(res->axis != 0, "Cannot gather rows of a table quantized per row");
+        res->axis += irank - 1;
+    }
+
+    return res;
+}
+
+void _tb_gatherInto(TBGraphSession* sess, TBGatherOperation* gop, NDArray* out, NDArray* table, NDArray* indices){
+    // sparse tables are densified, embeddings tables are expected dense
+    if(table->sparse != NULL){
+        NDArray* t = nda_sparseToDense(table);
+        _tb_gatherInto(sess, gop, out, t, indices);
+        _tb_releaseUpcast(t, table);
+        return;
+    }
+
+    ASSERT((table->shape->rank <= 2) || _tb_isContiguous(table->shape), "Cannot gather rows of a strided table of rank %"PRIu64, table->shape->rank);
+
+    uint64_t n = indices->shape->raw_len;
+    uint64_t bytes = (table->shape->raw_len/table->shape->dims[0])*nda_dtypeSize(table->dtype);
+    uint64_t threads = _tb_parallelThreads(sess, n*bytes, TB_GATHER_GRAIN, n);
+    uint64_t i = 0;
+
+    _TBGatherTask tasks[threads];
+
+    for(; i < threads; i++){
+        tasks[i] = (_TBGatherTask){out, table, indices, (n*i)/threads, (n*(i + 1))/threads};
+    }
+
+    _tb_parallelRun(sess, threads, _tb_gatherWorker, tasks, sizeof(*tasks));
+}
+
+#undef TB_GATHER_GRAIN
+
+void _tb_gatherGradAccumulate(TBGraphSession* sess, TBResultNode* diff, NDArray* g, NDArray* indices){
+    uint64_t n = indices->shape->raw_len;
+    uint64_t* rows = calloc(n ? n : 1, sizeof(uint64_t));
+    uint64_t i, c;
+
+    for(i = 0; i < n; i++)
+        rows[i] = _tb_gatherIndex(indices, i);
+
+    NDArray* gf = _tb_upcast(g);
+
+    if(diff->value->sparse != NULL){
+        NDArray* value = nda_sparseAddRows(diff->value, n, rows, gf);
+        nda_free(diff->value);
+        free(diff->value);
+        diff->value = value;
+    }
+    else{
+        // indices can repeat, rows are accumulated in order on a single thread
+        NDArray* d = diff->value;
+        uint64_t cols = d->shape->raw_len/d->shape->dims[0];
+
+        for(i = 0; i < n; i++){
+            ASSERT(rows[i] < d->shape->dims[0], "Gather index %"PRIu64" is out of a table of %"PRIu64" rows", rows[i], d->shape->dims[0]);
+            for(c = 0; c < cols; c++)
+                d->data[rows[i]*cols + c] += gf->data[i*cols + c];
+        }
+    }
+
+    _tb_releaseUpcast(gf, g);
+    free(rows);
+}
+
+/* * * * * * * * * * * * *
+ * DESTINATION  KERNELS  *
+ * * * * * * * * * * * * */
+
+void _tb_binaryInto(TBGraphSession* sess, TBBinaryOperationType type, NDArray* out, NDArray* lhs, NDArray* rhs){
+#ifdef TB_F64_KERNELS
+    if(out->dtype == NDA_DTYPE_F64){
+        _tb_doubleBinaryInto(type, out, lhs, rhs);
+        return;
+    }
+#endif
+
+    if(out->dtype != NDA_DTYPE_FLOAT){
+        _tb_integerBinaryInto(type, out, lhs, rhs);
+        return;
+    }
+
+    if((type == TBBOT_DOT) && _tb_isQuantizedDot(lhs, rhs)){
+        _tb_quantizedDotInto(sess, out, lhs, rhs, NULL, 1.0f, 0);
+        return;
+    }
+
+    // sparse x dense DOT, other sparse operands are densified
+    if((type == TBBOT_DOT) && (lhs->sparse != NULL) && (rhs->sparse == NULL)){
+        NDArray* r = _tb_upcast(rhs);
+        _tb_sparseDotKernel(sess, out, lhs, r);
+        _tb_releaseUpcast(r, rhs);
+        return;
+    }
+
+    if((lhs->dtype != NDA_DTYPE_FLOAT) || (rhs->dtype != NDA_DTYPE_FLOAT) || (lhs->sparse != NULL) || (rhs->sparse != NULL)){
+        if((type == TBBOT_DOT) && _tb_dotUpcasts(lhs, rhs)){
+            _tb_dotUpcastKernel(sess, out, lhs, rhs);
+            return;
+        }
+
+        NDArray* l = _tb_upcast(lhs);
+        NDArray* r = _tb_upcast(rhs);
+        _tb_binaryInto(sess, type, out, l, r);
+        _tb_releaseUpcast(l, lhs);
+        _tb_releaseUpcast(r, rhs);
+        return;
+    }
+
+    switch(type){
+        case TBBOT_ADD:
+            _tb_addKernel(out, lhs, rhs);
+            break;
+        case TBBOT_SUB:
+            _tb_subKernel(out, lhs, rhs);
+            break;
+        case TBBOT_MULT:
+            _tb_mulKernel(out, lhs, rhs);
+            break;
+        case TBBOT_DIV:
+            _tb_divKernel(out, lhs, rhs);
+            break;
+        case TBBOT_POW:
+            _tb_powKernel(out, lhs, rhs);
+            break;
+        case TBBOT_DOT:
+            _tb_dotKernel(sess, out, lhs, rhs);
+            break;
+    }
+}
+
+#define TB_UNARY_CASE(type, elt_func)\
+        case type:\
+            if(contiguous){\
+                for(i = 0; i < len; i++)\
+                    dst[i] = elt_func(src[i]);\
+            }\
+            else{\
+                do {\
+                    for(k = 0; k < cols; k++)\
+                        dst[k] = elt_func(src[off + k*step]);\
+                    dst += cols;\
+                } while(_tb_nextRow(shape, index, &off, shape->strides, &unused, zeros));\
+            }\
+            break;
+
+#define TB_NEGATE_KERNEL(type)\
+    do {\
+        type* src = (type*)uhs->raw;\
+        type* dst = (type*)out->raw;\
+        do {\
+            for(k = 0; k < cols; k++)\
+                dst[k] = -src[off + k*step];\
+            dst += cols;\
+        } while(_tb_nextRow(shape, index, &off, shape->strides, &unused, zeros));\
+    } while(0)
+
+/*
+ * Integer outputs, `tb_unaryOpDType` only keeps MINUS integer.
+ */
+static void _tb_integerUnaryInto(TBUnaryOperationType type, NDArray* out, NDArray* uhs){
+    NDShape* shape = uhs->shape;
+    uint64_t rank = shape->rank;
+    uint64_t index[rank], zeros[rank];
+    memset(index, 0, rank*sizeof(uint64_t));
+    memset(zeros, 0, rank*sizeof(uint64_t));
+
+    uint64_t cols = shape->dims[rank-1], step = shape->strides[rank-1];
+    uint64_t off = 0, unused = 0, k;
+
+    ASSERT(type == TBUOT_MINUS, "Unary operation %d has no %s kernel", type, nda_dtypeName(out->dtype));
+
+    if(out->dtype == NDA_DTYPE_I64)
+        TB_NEGATE_KERNEL(int64_t);
+    else
+        TB_NEGATE_KERNEL(int32_t);
+}
+
+#undef TB_NEGATE_KERNEL
+
+#ifdef TB_F64_KERNELS
+/*
+ * F64 outputs, the operand is converted to F64 first.
+ */
+static void _tb_doubleUnaryInto(TBUnaryOperationType type, NDArray* out, NDArray* uhs){
+    NDArray* u = _tb_upcastF64(uhs);
+    NDShape* shape = u->shape;
+    uint64_t rank = shape->rank;
+    uint64_t index[rank], zeros[rank];
+    memset(index, 0, rank*sizeof(uint64_t));
+    memset(zeros, 0, rank*sizeof(uint64_t));
+
+    uint8_t contiguous = _tb_isContiguous(shape);
+    double* src = (double*)u->raw;
+    double* dst = (double*)out->raw;
+    uint64_t len = shape->raw_len, cols = shape->dims[rank-1], step = shape->strides[rank-1];
+    uint64_t off = 0, unused = 0, i, k;
+
+    switch(type){
+        TB_UNARY_CASE(TBUOT_MINUS, _negativeF64)
+        TB_UNARY_CASE(TBUOT_EXP, exp)
+        TB_UNARY_CASE(TBUOT_LOG, log)
+        TB_UNARY_CASE(TBUOT_SIN, sin)
+        TB_UNARY_CASE(TBUOT_COS, cos)
+        TB_UNARY_CASE(TBUOT_TAN, tan)
+        TB_UNARY_CASE(TBUOT_TANH, tanh)
+        TB_UNARY_CASE(TBUOT_RELU, _reluF64)
+        TB_UNARY_CASE(TBUOT_SOFTPLUS, _softplusF64)
+        TB_UNARY_CASE(TBUOT_SIGMOID, _sigmoidF64)
+        TB_UNARY_CASE(TBUOT_DXRELU, _dxreluF64)
+    }
+
+    _tb_releaseUpcast(u, uhs);
+}
+#endif
+
+void _tb_unaryInto(TBGraphSession* sess, TBUnaryOperationType type, NDArray* out, NDArray* uhs){
+#ifdef TB_F64_KERNELS
+    if(out->dtype == NDA_DTYPE_F64){
+        _tb_doubleUnaryInto(type, out, uhs);
+        return;
+    }
+#endif
+
+    if(out->dtype != NDA_DTYPE_FLOAT){
+        _tb_integerUnaryInto(type, out, uhs);
+        return;
+    }
+
+    if((uhs->dtype != NDA_DTYPE_FLOAT) || (uhs->sparse != NULL)){
+        NDArray* u = _tb_upcast(uhs);
+        _tb_unaryInto(sess, type, out, u);
+        _tb_releaseUpcast(u, uhs);
+        return;
+    }
+
+    NDShape* shape = uhs->shape;
+    uint64_t rank = shape->rank;
+    uint64_t index[rank], zeros[rank];
+    memset(index, 0, rank*sizeof(uint64_t));
+    memset(zeros, 0, rank*sizeof(uint64_t));
+
+    uint8_t contiguous = _tb_isContiguous(shape);
+    tb_float* src = uhs->data;
+    tb_float* dst = out->data;
+    uint64_t len = shape->raw_len, cols = shape->dims[rank-1], step = shape->strides[rank-1];
+    uint64_t off = 0, unused = 0, i, k;
+
+    switch(type){
+        TB_UNARY_CASE(TBUOT_MINUS, _negative)
+        TB_UNARY_CASE(TBUOT_EXP, _exp)
+        TB_UNARY_CASE(TBUOT_LOG, _log)
+        TB_UNARY_CASE(TBUOT_SIN, _sin)
+        TB_UNARY_CASE(TBUOT_COS, _cos)
+        TB_UNARY_CASE(TBUOT_TAN, _tan)
+        TB_UNARY_CASE(TBUOT_TANH, _tanh)
+        TB_UNARY_CASE(TBUOT_RELU, _relu)
+        TB_UNARY_CASE(TBUOT_SOFTPLUS, _softplus)
+        TB_UNARY_CASE(TBUOT_SIGMOID, _sigmoid)
+        TB_UNARY_CASE(TBUOT_DXRELU, _dxrelu)
+    }
+}
+
+#undef TB_UNARY_CASE
+
+/*
+ * Moves `offset` to the first element of the next lane of a reduction over `axis`, lanes are visited in
+ * the row-major order of the remaining dimensions, i.e the order of the output elements.
+ */
+static inline uint64_t _tb_nextLane(NDShape* shape, uint64_t axis, uint64_t* index, uint64_t offset){
+    int64_t d = (int64_t)shape->rank - 1;
+    for(; d >= 0; d--){
+        if((uint64_t)d == axis)
+            continue;
+
+        index[d]++;
+        offset += shape->strides[d];
+
+        if(index[d] < shape->dims[d])
+            break;
+
+        offset -= shape->strides[d]*index[d];
+        index[d] = 0;
+    }
+
+    return offset;
+}
+
+#if (TB_TYPE == TB_FLOAT) && (defined(__x86_64__) || defined(__i386__))
+#define TB_SIMD_EXP 1
+
+/*
+ * Cephes expf on 8 lanes, accurate to a few ulps, inputs below -88.37 flush to 0.
+ */
+__attribute__((target("avx2,fma")))
+static inline __m256 _tb_exp256(__m256 x){
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-88.3762626647949f)), _mm256_set1_ps(88.3762626647949f));
+
+    __m256 fx = _mm256_floor_ps(_mm256_fmadd_ps(x, _mm256_set1_ps(1.44269504088896341f), _mm256_set1_ps(0.5f)));
+    x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(0.693359375f), x);
+    x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(-2.12194440e-4f), x);
+
+    __m256 y = _mm256_set1_ps(1.9875691500e-4f);
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.3981999507e-3f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(8.3334519073e-3f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(4.1665795894e-2f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.6666665459e-1f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(5.0000001201e-1f));
+    y = _mm256_fmadd_ps(y, _mm256_mul_ps(x, x), _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+
+    __m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(fx), _mm256_set1_epi32(127)), 23);
+
+    return _mm256_mul_ps(y, _mm256_castsi256_ps(e));
+}
+
+/*
+ * `_tb_softmaxStats` of a contiguous lane of at least 8 elements, over its whole vectors. Returns the number of
+ * elements covered, the caller adds the rest.
+ */
+__attribute__((target("avx2,fma")))
+static uint64_t _tb_softmaxStats256(const tb_float* x, uint64_t len, tb_float* max, double* sum){
+    __m256 vm = _mm256_loadu_ps(x);
+    __m256 vs = _mm256_set1_ps(1.0f);
+    tb_float m = -INFINITY;
+    double s = 0;
+    uint64_t k;
+
+    // the first block sums exp(0) per lane
+    for(k = 8; k + 8 <= len; k += 8){
+        __m256 v = _mm256_loadu_ps(x + k);
+        __m256 nm = _mm256_max_ps(vm, v);
+        vs = _mm256_fmadd_ps(vs, _tb_exp256(_mm256_sub_ps(vm, nm)), _tb_exp256(_mm256_sub_ps(v, nm)));
+        vm = nm;
+    }
+
+    float lm[8], ls[8];
+    _mm256_storeu_ps(lm, vm);
+    _mm256_storeu_ps(ls, vs);
+
+    uint64_t l = 0;
+    for(; l < 8; l++)
+        m = (lm[l] > m) ? lm[l] : m;
+    for(l = 0; l < 8; l++)
+        s += ls[l]*_exp(lm[l] - m);
+
+    *max = m;
+    *sum = s;
+
+    return k;
+}
+
+/*
+ * y = exp(x - m)*inv over the whole vectors of contiguous lanes, returns the number of elements written
+ */
+__attribute__((target("avx2,fma")))
+static uint64_t _tb_softmaxScale256(const tb_float* x, tb_float* y, uint64_t len, tb_float m, tb_float inv){
+    __m256 vm = _mm256_set1_ps(m), vi = _mm256_set1_ps(inv);
+    uint64_t k = 0;
+
+    for(; k + 8 <= len; k += 8)
+        _mm256_storeu_ps(y + k, _mm256_mul_ps(_tb_exp256(_mm256_sub_ps(_mm256_loadu_ps(x + k), vm)), vi));
+
+    return k;
+}
+#endif
+
+/*
+ * Online softmax statistics of a lane, i.e its maximum and the sum of exp(x - max): the sum is rescaled
+ * whenever the maximum grows, so the lane is read once.
+ */
+static inline void _tb_softmaxStats(const tb_float* x, uint64_t stride, uint64_t len, tb_float* max, double* sum){
+    tb_float m = -INFINITY;
+    double s = 0;
+    uint64_t k = 0;
+
+#ifdef TB_SIMD_EXP
+    if((stride == 1) && (len >= 8) && nda_cpuHas(NDA_CPU_AVX2 | NDA_CPU_FMA))
+        k = _tb_softmaxStats256(x, len, &m, &s);
+#endif
+
+    for(; k < len; k++){
+        tb_float v = x[k*stride];
+        if(v > m){
+            s = s*_exp(m - v) + 1;
+            m = v;
+        }
+        else {
+            s += _exp(v - m);
+        }
+    }
+
+    *max = m;
+    *sum = s;
+}
+
+/*
+ * y = softmax(x) or log-softmax(x) along a lane, from the statistics of `_tb_softmaxStats`
+ */
+static inline void _tb_softmaxLane(const tb_float* x, uint64_t xs, tb_float* y, uint64_t ys, uint64_t len, uint8_t logarithm){
+    tb_float m;
+    double s;
+    uint64_t k = 0;
+    _tb_softmaxStats(x, xs, len, &m, &s);
+
+    if(logarithm){
+        tb_float lse = m + (tb_float)log(s);
+        for(; k < len; k++)
+            y[k*ys] = x[k*xs] - lse;
+        return;
+    }
+
+    tb_float inv = (tb_float)(1.0/s);
+
+#ifdef TB_SIMD_EXP
+    if((xs == 1) && (ys == 1) && nda_cpuHas(NDA_CPU_AVX2 | NDA_CPU_FMA))
+        k = _tb_softmaxScale256(x, y, len, m, inv);
+#endif
+
+    for(; k < len; k++)
+        y[k*ys] = _exp(x[k*xs] - m)*inv;
+}
+
+static void _tb_softmaxInto(TBAxisBoundOperation* abop, NDArray* out, NDArray* uhs){
+    NDShape* shape = uhs->shape;
+    uint64_t axis = abop->axis;
+    uint64_t index[shape->rank], oindex[shape->rank];
+    memset(index, 0, shape->rank*sizeof(uint64_t));
+    memset(oindex, 0, shape->rank*sizeof(uint64_t));
+
+    uint64_t len = shape->dims[axis];
+    uint64_t lanes = out->shape->raw_len/len;
+    uint64_t i = 0, j = 0, o = 0;
+
+    for(; i < lanes; i++, j = _tb_nextLane(shape, axis, index, j), o = _tb_nextLane(out->shape, axis, oindex, o)){
+        _tb_softmaxLane(uhs->data + j, shape->strides[axis], out->data + o, out->shape->strides[axis], len, abop->type == TBABOT_LOG_SOFTMAX);
+    }
+}
+
+void _tb_softmaxGradInto(TBGraphSession* sess, TBAxisBoundOperation* abop, NDArray* out, NDArray* y, NDArray* g){
+    NDArray* yf = _tb_upcast(y);
+    NDArray* gf = _tb_upcast(g);
+    uint64_t rank = out->shape->rank, axis = abop->axis;
+    uint64_t yindex[rank], gindex[rank], oindex[rank];
+    memset(yindex, 0, rank*sizeof(uint64_t));
+    memset(gindex, 0, rank*sizeof(uint64_t));
+    memset(oindex, 0, rank*sizeof(uint64_t));
+
+    uint64_t len = out->shape->dims[axis];
+    uint64_t lanes = out->shape->raw_len/len;
+    uint64_t ys = yf->shape->strides[axis], gs = gf->shape->strides[axis], os = out->shape->strides[axis];
+    uint64_t i = 0, j = 0, l = 0, o = 0, k;
+
+    for(; i < lanes; i++){
+        tb_float* yl = yf->data + j;
+        tb_float* gl = gf->data + l;
+        tb_float* ol = out->data + o;
+        double acc = 0;
+
+        // softmax: dx = y*(g - sum(g*y)), log-softmax: dx = g - exp(y)*sum(g)
+        if(abop->type == TBABOT_SOFTMAX){
+            for(k = 0; k < len; k++)
+                acc += gl[k*gs]*yl[k*ys];
+            for(k = 0; k < len; k++)
+                ol[k*os] = yl[k*ys]*(gl[k*gs] - (tb_float)acc);
+        }
+        else {
+            for(k = 0; k < len; k++)
+                acc += gl[k*gs];
+            for(k = 0; k < len; k++)
+                ol[k*os] = gl[k*gs] - _exp(yl[k*ys])*(tb_float)acc;
+        }
+
+        j = _tb_nextLane(yf->shape, axis, yindex, j);
+        l = _tb_nextLane(gf->shape, axis, gindex, l);
+        o = _tb_nextLane(out->shape, axis, oindex, o);
+    }
+
+    _tb_releaseUpcast(yf, y);
+    _tb_releaseUpcast(gf, g);
+}
+
+/*
+ * Cross-entropy of a lane against a class index (`label` set, `t` NULL) or a target distribution `t`:
+ * loss = sum_k t_k*(lse - x_k) with lse = log(sum_k exp(x_k)), computed in the pass of the softmax statistics.
+ */
+static inline tb_float _tb_crossEntropyLane(const tb_float* x, uint64_t xs, const tb_float* t, uint64_t ts, uint64_t label, uint64_t len){
+    tb_float m = -INFINITY;
+    double s = 0, tsum = 0, tx = 0;
+    uint64_t k = 0;
+
+    if(t == NULL){
+        ASSERT(label < len, "Label %"PRIu64" is out of %"PRIu64" classes", label, len);
+        _tb_softmaxStats(x, xs, len, &m, &s);
+
+        return (m + (tb_float)log(s)) - x[label*xs];
+    }
+
+    for(; k < len; k++){
+        tb_float v = x[k*xs];
+        tsum += t[k*ts];
+        tx += t[k*ts]*v;
+
+        if(v > m){
+            s = s*_exp(m - v) + 1;
+            m = v;
+        }
+        else {
+            s += _exp(v - m);
+        }
+    }
+
+    return (tb_float)((m + log(s))*tsum - tx);
+}
+
+static inline uint8_t _tb_crossEntropyDenseLabels(NDArray* logits, NDArray* labels){
+    return tb_shapeEquals(logits->shape, labels->shape);
+}
+
+void _tb_crossEntropyInto(TBGraphSession* sess, TBCrossEntropyOperation* ceop, NDArray* out, NDArray* logits, NDArray* labels){
+    NDArray* xf = _tb_upcast(logits);
+    uint8_t dense = _tb_crossEntropyDenseLabels(logits, labels);
+    NDArray* tf = dense ? _tb_upcast(labels) : NULL;
+    NDShape* shape = xf->shape;
+    uint64_t rank = shape->rank, axis = ceop->axis;
+    uint64_t index[rank], tindex[rank];
+    memset(index, 0, rank*sizeof(uint64_t));
+    memset(tindex, 0, rank*sizeof(uint64_t));
+
+    uint64_t len = shape->dims[axis];
+    uint64_t i = 0, j = 0, l = 0;
+
+    for(; i < out->shape->raw_len; i++, j = _tb_nextLane(shape, axis, index, j)){
+        if(dense){
+            out->data[i] = _tb_crossEntropyLane(xf->data + j, shape->strides[axis], tf->data + l, tf->shape->strides[axis], 0, len);
+            l = _tb_nextLane(tf->shape, axis, tindex, l);
+        }
+        else {
+            out->data[i] = _tb_crossEntropyLane(xf->data + j, shape->strides[axis], NULL, 0, _tb_gatherIndex(labels, i), len);
+        }
+    }
+
+    _tb_releaseUpcast(xf, logits);
+    if(dense)
+        _tb_releaseUpcast(tf, labels);
+}
+
+void _tb_crossEntropyGradInto(TBGraphSession* sess, TBCrossEntropyOperation* ceop, NDArray* out, NDArray* logits, NDArray* labels, NDArray* g){
+    NDArray* xf = _tb_upcast(logits);
+    NDArray* gf = _tb_upcast(g);
+    uint8_t dense = _tb_crossEntropyDenseLabels(logits, labels);
+    NDArray* tf = dense ? _tb_upcast(labels) : NULL;
+    NDShape* shape = xf->shape;
+    uint64_t rank = shape->rank, axis = ceop->axis;
+    uint64_t index[rank], tindex[rank], oindex[rank];
+    memset(index, 0, rank*sizeof(uint64_t));
+    memset(tindex, 0, rank*sizeof(uint64_t));
+    memset(oindex, 0, rank*sizeof(uint64_t));
+
+    uint64_t len = shape->dims[axis];
+    uint64_t xs = shape->strides[axis], os = out->shape->strides[axis];
+    uint64_t lanes = gf->shape->raw_len;
+    uint64_t i = 0, j = 0, l = 0, o = 0, k;
+
+    // dx = g*(softmax(x)*sum(t) - t), the probabilities are recomputed instead of being stored by the forward pass
+    for(; i < lanes; i++){
+        tb_float* xl = xf->data + j;
+        tb_float* ol = out->data + o;
+        tb_float m;
+        double s, tsum = 1;
+        tb_float gi = gf->data[i];
+
+        _tb_softmaxStats(xl, xs, len, &m, &s);
+
+        if(dense){
+            tb_float* tl = tf->data + l;
+            uint64_t ts = tf->shape->strides[axis];
+
+            for(tsum = 0, k = 0; k < len; k++)
+                tsum += tl[k*ts];
+            for(k = 0; k < len; k++)
+                ol[k*os] = gi*(_exp(xl[k*xs] - m)*(tb_float)(tsum/s) - tl[k*ts]);
+
+            l = _tb_nextLane(tf->shape, axis, tindex, l);
+        }
+        else {
+            uint64_t label = _tb_gatherIndex(labels, i);
+            for(k = 0; k < len; k++)
+                ol[k*os] = gi*(_exp(xl[k*xs] - m)*(tb_float)(1.0/s) - (k == label));
+        }
+
+        j = _tb_nextLane(shape, axis, index, j);
+        o = _tb_nextLane(out->shape, axis, oindex, o);
+    }
+
+    _tb_releaseUpcast(xf, logits);
+    _tb_releaseUpcast(gf, g);
+    if(dense)
+        _tb_releaseUpcast(tf, labels);
+}
+
+/*
+ * Count, mean and sum of squared deviations of a set of values, merged with Chan et al. pairwise update
+ */
+typedef struct _TBMoments{
+    double n;                      /**< Number of values */
+    double mean;                   /**< Mean of the values */
+    double m2;                     /**< Sum of the squared deviations from the mean */
+}_TBMoments;
+
+static inline _TBMoments _tb_mergeMoments(_TBMoments a, _TBMoments b){
+    if(a.n == 0)
+        return b;
+    if(b.n == 0)
+        return a;
+
+    double n = a.n + b.n;
+    double d = b.mean - a.mean;
+    _TBMoments res = {n, a.mean + d*(b.n/n), a.m2 + b.m2 + d*d*(a.n*b.n/n)};
+
+    return res;
+}
+
+/* Number of interleaved Welford accumulators of contiguous lanes */
+#define TB_WELFORD_WIDTH 8
+
+/*
+ * Welford moments of a lane in a single read. Contiguous lanes run TB_WELFORD_WIDTH independent accumulators
+ * sharing the same count, which the compiler vectorizes, then merge them.
+ */
+static _TBMoments _tb_laneMoments(const tb_float* x, uint64_t stride, uint64_t len){
+    _TBMoments res = {0, 0, 0};
+    uint64_t k = 0, l;
+
+    if((stride == 1) && (len >= 2*TB_WELFORD_WIDTH)){
+        double mean[TB_WELFORD_WIDTH] = {0}, m2[TB_WELFORD_WIDTH] = {0};
+        uint64_t blocks = len/TB_WELFORD_WIDTH, b;
+
+        for(b = 0; b < blocks; b++){
+            const tb_float* v = x + b*TB_WELFORD_WIDTH;
+            double inv = 1.0/(double)(b + 1);
+
+            for(l = 0; l < TB_WELFORD_WIDTH; l++){
+                double d = v[l] - mean[l];
+                mean[l] += d*inv;
+                m2[l] += d*(v[l] - mean[l]);
+            }
+        }
+
+        for(l = 0; l < TB_WELFORD_WIDTH; l++){
+            _TBMoments m = {(double)blocks, mean[l], m2[l]};
+            res = _tb_mergeMoments(res, m);
+        }
+
+        k = blocks*TB_WELFORD_WIDTH;
+    }
+
+    for(; k < len; k++){
+        double v = x[k*stride];
+        double d = v - res.mean;
+        res.n += 1;
+        res.mean += d/res.n;
+        res.m2 += d*(v - res.mean);
+    }
+
+    return res;
+}
+
+#undef TB_WELFORD_WIDTH
+
+/*
+ * Offset of the first element of a lane given its rank in the order of `_tb_nextLane`, sets the matching index
+ */
+static uint64_t _tb_laneStart(NDShape* shape, uint64_t axis, uint64_t lane, uint64_t* index){
+    int64_t d = (int64_t)shape->rank - 1;
+    uint64_t offset = 0;
+
+    for(; d >= 0; d--){
+        index[d] = 0;
+        if((uint64_t)d == axis)
+            continue;
+
+        index[d] = lane % shape->dims[d];
+        lane /= shape->dims[d];
+        offset += index[d]*shape->strides[d];
+    }
+
+    return offset;
+}
+
+typedef struct _TBMomentsTask{
+    TBAxisBoundOperation* abop;    /**< MEAN or VARIANCE */
+    NDArray* out;                  /**< Destination array, written when `moments` is NULL */
+    NDArray* uhs;                  /**< Operand */
+    _TBMoments* moments;           /**< Partial moments of each (lane, chunk), NULL when lanes are not split */
+    uint64_t lane0;                /**< First lane given to the worker */
+    uint64_t lane1;                /**< Last lane (excluded) given to the worker */
+    uint64_t chunk;                /**< Chunk of the lanes given to the worker */
+    uint64_t chunks;               /**< Number of chunks each lane is split into */
+}_TBMomentsTask;
+
+static inline tb_float _tb_momentsValue(TBAxisBoundOperation* abop, _TBMoments m){
+    return (tb_float)((abop->type == TBABOT_VARIANCE) ? m.m2/m.n : m.mean);
+}
+
+static void* _tb_momentsWorker(void* arg){
+    _TBMomentsTask* task = (_TBMomentsTask*)arg;
+    NDShape* shape = task->uhs->shape;
+    uint64_t axis = task->abop->axis;
+    uint64_t len = shape->dims[axis], stride = shape->strides[axis];
+    uint64_t k0 = (len*task->chunk)/task->chunks, k1 = (len*(task->chunk + 1))/task->chunks;
+    uint64_t index[shape->rank];
+    uint64_t i = task->lane0, j = _tb_laneStart(shape, axis, task->lane0, index);
+
+    for(; i < task->lane1; i++, j = _tb_nextLane(shape, axis, index, j)){
+        _TBMoments m = _tb_laneMoments(task->uhs->data + j + k0*stride, stride, k1 - k0);
+
+        if(task->moments != NULL)
+            task->moments[i*task->chunks + task->chunk] = m;
+        else
+            task->out->data[i] = _tb_momentsValue(task->abop, m);
+    }
+
+    return NULL;
+}
+
+/* Minimum number of elements reduced by each worker of the moments kernel */
+#define TB_MOMENTS_GRAIN 65536
+
+static inline uint64_t _tb_momentsThreads(TBGraphSession* sess, uint64_t lanes, uint64_t len){
+    return _tb_parallelThreads(sess, lanes*len, TB_MOMENTS_GRAIN, (lanes > 1) ? lanes : len);
+}
+
+/*
+ * MEAN and population VARIANCE, threads take ranges of lanes or, when there are fewer lanes than threads,
+ * chunks of every lane whose moments are merged afterwards.
+ */
+static void _tb_momentsInto(TBGraphSession* sess, TBAxisBoundOperation* abop, NDArray* out, NDArray* uhs){
+    uint64_t lanes = out->shape->raw_len;
+    uint64_t len = uhs->shape->dims[abop->axis];
+    uint64_t threads = _tb_momentsThreads(sess, lanes, len);
+    uint64_t split = (lanes < threads) ? threads : 1;
+    uint64_t i = 0, c;
+
+    _TBMomentsTask tasks[threads];
+    _TBMoments* moments = (split > 1) ? _tb_scratch(lanes*split, sizeof(_TBMoments)) : NULL;
+
+    for(; i < threads; i++){
+        _TBMomentsTask task = {abop, out, uhs, moments, 0, lanes, i, split};
+        if(split == 1){
+            task.lane0 = (lanes*i)/threads;
+            task.lane1 = (lanes*(i + 1))/threads;
+            task.chunk = 0;
+        }
+        tasks[i] = task;
+    }
+
+    _tb_parallelRun(sess, threads, _tb_momentsWorker, tasks, sizeof(*tasks));
+
+    if(moments != NULL){
+        for(i = 0; i < lanes; i++){
+            _TBMoments m = moments[i*split];
+            for(c = 1; c < split; c++)
+                m = _tb_mergeMoments(m, moments[i*split + c]);
+            out->data[i] = _tb_momentsValue(abop, m);
+        }
+
+        _tb_releaseScratch(moments);
+    }
+}
+
+#undef TB_MOMENTS_GRAIN
+
+/*
+ * Groups of a normalization within a contiguous operand: group i is made of `segs` runs of `seg_len` values starting
+ * at i*group_stride + o*seg_stride. LAYER groups are a single run, BATCH groups take a run of every outer index.
+ */
+typedef struct _TBNormGeometry{
+    uint64_t groups;               /**< Number of groups */
+    uint64_t segs;                 /**< Number of runs of each group */
+    uint64_t seg_len;              /**< Number of values of each run */
+    uint64_t group_stride;         /**< Offset between the first runs of two consecutive groups */
+    uint64_t seg_stride;           /**< Offset between two consecutive runs of a group */
+}_TBNormGeometry;
+
+static _TBNormGeometry _tb_normGeometry(TBNormalizationOperation* nop, NDShape* shape){
+    uint64_t outer = 1, inner = 1, i = 0;
+    uint64_t channels = shape->dims[nop->axis];
+
+    for(; i < nop->axis; i++)
+        outer *= shape->dims[i];
+    for(i = nop->axis + 1; i < shape->rank; i++)
+        inner *= shape->dims[i];
+
+    if(nop->type == TBNOT_LAYER){
+        _TBNormGeometry geom = {outer, 1, channels*inner, channels*inner, 0};
+        return geom;
+    }
+
+    _TBNormGeometry geom = {channels, outer, inner, inner, channels*inner};
+    return geom;
+}
+
+uint64_t _tb_normalizationGroups(TBNormalizationOperation* nop, NDShape* shape){
+    return _tb_normGeometry(nop, shape).groups;
+}
+
+/*
+ * Contiguous tb_float view of an operand, to release with `_tb_releaseUpcast`
+ */
+static NDArray* _tb_contiguousUpcast(NDArray* arr){
+    NDArray* f = _tb_upcast(arr);
+
+    if(_tb_isContiguous(f->shape))
+        return f;
+
+    NDArray* c = nda_cast(f, NDA_DTYPE_FLOAT);
+    _tb_releaseUpcast(f, arr);
+
+    return c;
+}
+
+typedef struct _TBNormTask{
+    TBNormalizationOperation* nop; /**< Normalization */
+    _TBNormGeometry* geom;         /**< Groups of the operand */
+    const tb_float* x;             /**< Contiguous operand */
+    const tb_float* gamma;         /**< Scale, NULL for 1 */
+    const tb_float* beta;          /**< Shift, NULL for 0 */
+    tb_float* stats;               /**< Mean and rstd of each group, NULL when not kept */
+    tb_float* out;                 /**< Output of the forward pass, derivative w.r.t x of the backward pass */
+    const tb_float* g;             /**< Derivative of the output, NULL for the forward pass */
+    double* dgamma;                /**< Sum of g*xhat, per value of a group (LAYER, owned by the task) or per group (BATCH) */
+    double* dbeta;                 /**< Sum of g, same layout as dgamma */
+    uint64_t group0;               /**< First group given to the worker */
+    uint64_t group1;               /**< Last group (excluded) given to the worker */
+}_TBNormTask;
+
+static void _tb_normGroupStats(_TBNormTask* task, uint64_t i, tb_float* mean, tb_float* rstd){
+    _TBNormGeometry* geom = task->geom;
+
+    if((task->g != NULL) && (task->stats != NULL)){
+        *mean = task->stats[2*i];
+        *rstd = task->stats[2*i + 1];
+        return;
+    }
+
+    _TBMoments m = {0, 0, 0};
+    uint64_t o = 0;
+    for(; o < geom->segs; o++)
+        m = _tb_mergeMoments(m, _tb_laneMoments(task->x + i*geom->group_stride + o*geom->seg_stride, 1, geom->seg_len));
+
+    *mean = (tb_float)m.mean;
+    *rstd = (tb_float)(1.0/sqrt(m.m2/m.n + task->nop->epsilon));
+
+    if(task->stats != NULL){
+        task->stats[2*i] = *mean;
+        task->stats[2*i + 1] = *rstd;
+    }
+}
+
+/*
+ * y = (x - mean)*rstd*gamma + beta, LAYER reads gamma and beta per value of the group, BATCH once per group
+ */
+static void* _tb_normForwardWorker(void* arg){
+    _TBNormTask* task = (_TBNormTask*)arg;
+    _TBNormGeometry* geom = task->geom;
+    uint8_t layer = (task->nop->type == TBNOT_LAYER);
+    uint64_t i = task->group0, o, k;
+
+    for(; i < task->group1; i++){
+        tb_float mean, rstd;
+        _tb_normGroupStats(task, i, &mean, &rstd);
+
+        for(o = 0; o < geom->segs; o++){
+            uint64_t off = i*geom->group_stride + o*geom->seg_stride;
+            const tb_float* x = task->x + off;
+            tb_float* y = task->out + off;
+
+            if(layer){
+                for(k = 0; k < geom->seg_len; k++){
+                    tb_float v = (x[k] - mean)*rstd;
+                    y[k] = v*((task->gamma != NULL) ? task->gamma[k] : 1) + ((task->beta != NULL) ? task->beta[k] : 0);
+                }
+            }
+            else {
+                tb_float scale = rstd*((task->gamma != NULL) ? task->gamma[i] : 1);
+                tb_float shift = ((task->beta != NULL) ? task->beta[i] : 0) - mean*scale;
+
+                for(k = 0; k < geom->seg_len; k++)
+                    y[k] = x[k]*scale + shift;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * dx = rstd*(g*gamma - mean(g*gamma) - xhat*mean(g*gamma*xhat)), the first pass sums over the group and accumulates
+ * the derivatives of gamma and beta, the second one writes dx.
+ */
+static void* _tb_normBackwardWorker(void* arg){
+    _TBNormTask* task = (_TBNormTask*)arg;
+    _TBNormGeometry* geom = task->geom;
+    uint8_t layer = (task->nop->type == TBNOT_LAYER);
+    double n = (double)(geom->segs*geom->seg_len);
+    uint64_t i = task->group0, o, k;
+
+    for(; i < task->group1; i++){
+        tb_float mean, rstd;
+        double sg = 0, sgx = 0;
+        _tb_normGroupStats(task, i, &mean, &rstd);
+
+        for(o = 0; o < geom->segs; o++){
+            uint64_t off = i*geom->group_stride + o*geom->seg_stride;
+            const tb_float* x = task->x + off;
+            const tb_float* g = task->g + off;
+
+            for(k = 0; k < geom->seg_len; k++){
+                tb_float xhat = (x[k] - mean)*rstd;
+                tb_float gk = g[k]*((layer && (task->gamma != NULL)) ? task->gamma[k] : 1);
+                sg += gk;
+                sgx += gk*xhat;
+
+                if(layer){
+                    task->dgamma[k] += g[k]*xhat;
+                    task->dbeta[k] += g[k];
+                }
+            }
+        }
+
+        // BATCH gamma is constant over the group, sg and sgx are the derivatives of beta and gamma before scaling
+        tb_float scale = (!layer && (task->gamma != NULL)) ? task->gamma[i] : 1;
+        if(!layer){
+            task->dgamma[i] = sgx;
+            task->dbeta[i] = sg;
+        }
+
+        tb_float a = (tb_float)(sg*scale/n), b = (tb_float)(sgx*scale/n);
+
+        for(o = 0; o < geom->segs; o++){
+            uint64_t off = i*geom->group_stride + o*geom->seg_stride;
+            const tb_float* x = task->x + off;
+            const tb_float* g = task->g + off;
+            tb_float* dx = task->out + off;
+
+            for(k = 0; k < geom->seg_len; k++){
+                tb_float xhat = (x[k] - mean)*rstd;
+                tb_float gk = g[k]*((task->gamma != NULL) ? task->gamma[layer ? k : i] : 1);
+                dx[k] = rstd*(gk - a - xhat*b);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/* Minimum number of values normalized by each worker */
+#define TB_NORM_GRAIN 65536
+
+static void _tb_normParallel(TBGraphSession* sess, _TBNormTask* proto, uint64_t tasks_len, _TBNormTask* tasks, void* (*worker)(void*)){
+    uint64_t groups = proto->geom->groups;
+    uint64_t i = 0;
+
+    for(; i < tasks_len; i++){
+        _TBNormTask task = *proto;
+        task.group0 = (groups*i)/tasks_len;
+        task.group1 = (groups*(i + 1))/tasks_len;
+        task.dgamma = (proto->dgamma != NULL) ? tasks[i].dgamma : NULL;
+        task.dbeta = (proto->dbeta != NULL) ? tasks[i].dbeta : NULL;
+        tasks[i] = task;
+    }
+
+    _tb_parallelRun(sess, tasks_len, worker, tasks, sizeof(*tasks));
+}
+
+static uint64_t _tb_normThreads(TBGraphSession* sess, _TBNormGeometry* geom){
+    return _tb_parallelThreads(sess, geom->groups*geom->segs*geom->seg_len, TB_NORM_GRAIN, geom->groups);
+}
+
+void _tb_normalizationInto(TBGraphSession* sess, TBNormalizationOperation* nop, NDArray* out, NDArray* uhs, NDArray* gamma, NDArray* beta, NDArray* stats){
+    NDArray* xf = _tb_contiguousUpcast(uhs);
+    NDArray* gf = (gamma != NULL) ? _tb_contiguousUpcast(gamma) : NULL;
+    NDArray* bf = (beta != NULL) ? _tb_contiguousUpcast(beta) : NULL;
+    _TBNormGeometry geom = _tb_normGeometry(nop, xf->shape);
+    uint64_t threads = _tb_normThreads(sess, &geom);
+    _TBNormTask tasks[threads];
+
+    _TBNormTask proto = {nop, &geom, xf->data, (gf != NULL) ? gf->data : NULL, (bf != NULL) ? bf->data : NULL,
+                         (stats != NULL) ? stats->data : NULL, out->data, NULL, NULL, NULL, 0, 0};
+    _tb_normParallel(sess, &proto, threads, tasks, _tb_normForwardWorker);
+
+    _tb_releaseUpcast(xf, uhs);
+    if(gf != NULL)
+        _tb_releaseUpcast(gf, gamma);
+    if(bf != NULL)
+        _tb_releaseUpcast(bf, beta);
+}
+
+void _tb_normalizationGradInto(TBGraphSession* sess, TBNormalizationOperation* nop, NDArray* dx, NDArray* dgamma, NDArray* dbeta,
+                               NDArray* uhs, NDArray* gamma, NDArray* stats, NDArray* g){
+    NDArray* xf = _tb_contiguousUpcast(uhs);
+    NDArray* gf = _tb_contiguousUpcast(g);
+    NDArray* gamf = (gamma != NULL) ? _tb_contiguousUpcast(gamma) : NULL;
+    _TBNormGeometry geom = _tb_normGeometry(nop, xf->shape);
+    uint64_t threads = _tb_normThreads(sess, &geom);
+    uint8_t layer = (nop->type == TBNOT_LAYER);
+    uint64_t params = layer ? geom.seg_len : geom.groups;
+    uint64_t i = 0, k;
+    _TBNormTask tasks[threads];
+
+    // LAYER workers sum the derivatives of gamma and beta into buffers of their own, BATCH workers own their groups
+    double* sums = _tb_scratch(2*params*(layer ? threads : 1), sizeof(double));
+    memset(sums, 0, 2*params*(layer ? threads : 1)*sizeof(double));
+    for(; i < threads; i++){
+        tasks[i].dgamma = sums + 2*params*(layer ? i : 0);
+        tasks[i].dbeta = tasks[i].dgamma + params;
+    }
+
+    _TBNormTask proto = {nop, &geom, xf->data, (gamf != NULL) ? gamf->data : NULL, NULL,
+                         (stats != NULL) ? stats->data : NULL, dx->data, gf->data, sums, sums + params, 0, 0};
+    _tb_normParallel(sess, &proto, threads, tasks, _tb_normBackwardWorker);
+
+    for(k = 0; k < params; k++){
+        double sgx = 0, sg = 0;
+        for(i = 0; i < (layer ? threads : 1); i++){
+            sgx += sums[2*params*i + k];
+            sg += sums[2*params*i + params + k];
+        }
+
+        if(dgamma != NULL)
+            dgamma->data[k] = (tb_float)sgx;
+        if(dbeta != NULL)
+            dbeta->data[k] = (tb_float)sg;
+    }
+
+    _tb_releaseScratch(sums);
+    _tb_releaseUpcast(xf, uhs);
+    _tb_releaseUpcast(gf, g);
+    if(gamf != NULL)
+        _tb_releaseUpcast(gamf, gamma);
+}
+
+#undef TB_NORM_GRAIN
+
+/*
+ * Strides of an image of logical dimensions (N, C, H, W) in a layout, in (n, c/block, c%block, h, w) order. Plain
+ * layouts take block*c_stride between blocks so that the same loop addresses every layout.
+ */
+static void _tb_imageStrides(TBConvolutionLayout layout, uint64_t* dims, uint64_t block, uint64_t* st){
+    uint64_t C = dims[1], H = dims[2], W = dims[3];
+
+    switch(layout){
+        case TBCL_NHWC:{
+            uint64_t s[5] = {H*W*C, block, 1, W*C, C};
+            memcpy(st, s, sizeof(s));
+            break;
+        }
+        case TBCL_NCHWC:{
+            uint64_t s[5] = {C*H*W, H*W*block, 1, W*block, block};
+            memcpy(st, s, sizeof(s));
+            break;
+        }
+        case TBCL_NCHW:{
+            uint64_t s[5] = {C*H*W, block*H*W, H*W, W, 1};
+            memcpy(st, s, sizeof(s));
+            break;
+        }
+    }
+}
+
+void _tb_reorderInto(TBReorderOperation* rop, NDArray* out, NDArray* uhs){
+    NDArray* xf = _tb_contiguousUpcast(uhs);
+    NDShape* shape = xf->shape;
+    uint64_t block = rop->block;
+    uint64_t dims[4];
+    uint64_t is[5], os[5];
+    uint64_t n, cb, h, w, ci;
+
+    if(rop->from == TBCL_NHWC){
+        uint64_t d[4] = {shape->dims[0], shape->dims[3], shape->dims[1], shape->dims[2]};
+        memcpy(dims, d, sizeof(d));
+    }
+    else {
+        uint64_t d[4] = {shape->dims[0], shape->dims[1]*((rop->from == TBCL_NCHWC) ? block : 1), shape->dims[2], shape->dims[3]};
+        memcpy(dims, d, sizeof(d));
+    }
+
+    // between two plain layouts a block of one channel keeps the loop valid
+    if((rop->from != TBCL_NCHWC) && (rop->to != TBCL_NCHWC))
+        block = 1;
+
+    _tb_imageStrides(rop->from, dims, block, is);
+    _tb_imageStrides(rop->to, dims, block, os);
+
+    for(n = 0; n < dims[0]; n++)
+        for(cb = 0; cb < dims[1]/block; cb++)
+            for(h = 0; h < dims[2]; h++)
+                for(w = 0; w < dims[3]; w++){
+                    const tb_float* x = xf->data + n*is[0] + cb*is[1] + h*is[3] + w*is[4];
+                    tb_float* o = out->data + n*os[0] + cb*os[1] + h*os[3] + w*os[4];
+
+                    for(ci = 0; ci < block; ci++)
+                        o[ci*os[2]] = x[ci*is[2]];
+                }
+
+    _tb_releaseUpcast(xf, uhs);
+}
+
+/*
+ * Reordering is a permutation, its derivative is the reverse reorder of the gradient
+ */
+void _tb_reorderGradInto(TBReorderOperation* rop, NDArray* dx, NDArray* g){
+    TBReorderOperation reverse = *rop;
+    reverse.from = rop->to;
+    reverse.to = rop->from;
+
+    _tb_reorderInto(&reverse, dx, g);
+}
+
+/*
+ * Dimensions of a convolution and strides of its contiguous operands in (n, c, h, w) order, so that every kernel
+ * handles NCHW and NHWC alike.
+ */
+typedef struct _TBConvGeometry{
+    uint64_t N, C, H, W;           /**< Input dimensions */
+    uint64_t CO, KH, KW, OH, OW;   /**< Output channels, kernel and output spatial dimensions */
+    uint64_t sh, sw, ph, pw, dh, dw;/**< Stride, padding and dilation */
+    uint64_t groups, CG, COG;      /**< Number of groups, input and output channels per group */
+    uint64_t block;                /**< Channels per block of NCHWc operands, 0 for plain layouts which alone use the strides */
+    uint64_t xs[4];                /**< Strides of the input */
+    uint64_t os[4];                /**< Strides of the output */
+}_TBConvGeometry;
+
+static _TBConvGeometry _tb_convGeometry(TBConvolutionOperation* cop, NDShape* x, NDShape* w){
+    uint8_t nhwc = (cop->layout == TBCL_NHWC);
+    uint8_t blocked = (cop->layout == TBCL_NCHWC);
+    _TBConvGeometry geom;
+
+    geom.N = x->dims[0];
+    geom.C = x->dims[nhwc ? 3 : 1]*(blocked ? x->dims[4] : 1);
+    geom.block = blocked ? x->dims[4] : 0;
+    geom.H = x->dims[nhwc ? 1 : 2];
+    geom.W = x->dims[nhwc ? 2 : 3];
+    geom.CO = w->dims[0];
+    geom.KH = w->dims[2];
+    geom.KW = w->dims[3];
+    geom.sh = cop->stride[0];
+    geom.sw = cop->stride[1];
+    geom.ph = cop->padding[0];
+    geom.pw = cop->padding[1];
+    geom.dh = cop->dilation[0];
+    geom.dw = cop->dilation[1];
+    geom.OH = (geom.H + 2*geom.ph - geom.dh*(geom.KH - 1) - 1)/geom.sh + 1;
+    geom.OW = (geom.W + 2*geom.pw - geom.dw*(geom.KW - 1) - 1)/geom.sw + 1;
+    geom.groups = cop->groups;
+    geom.CG = geom.C/geom.groups;
+    geom.COG = geom.CO/geom.groups;
+
+    if(nhwc){
+        uint64_t xs[4] = {geom.H*geom.W*geom.C, 1, geom.W*geom.C, geom.C};
+        uint64_t os[4] = {geom.OH*geom.OW*geom.CO, 1, geom.OW*geom.CO, geom.CO};
+        memcpy(geom.xs, xs, sizeof(xs));
+        memcpy(geom.os, os, sizeof(os));
+    }
+    else {
+        uint64_t xs[4] = {geom.C*geom.H*geom.W, geom.H*geom.W, geom.W, 1};
+        uint64_t os[4] = {geom.CO*geom.OH*geom.OW, geom.OH*geom.OW, geom.OW, 1};
+        memcpy(geom.xs, xs, sizeof(xs));
+        memcpy(geom.os, os, sizeof(os));
+    }
+
+    return geom;
+}
+
+/*
+ * col[p, k] = x[n, g*CG + c, oh*sh - ph + kh*dh, ow*sw - pw + kw*dw] with p = (oh, ow) and k = (c, kh, kw), i.e
+ * one row per output pixel in the order of the OIHW weights, zero in the padding.
+ */
+static void _tb_im2col(_TBConvGeometry* geom, const tb_float* x, uint64_t n, uint64_t g, tb_float* col){
+    uint64_t K = geom->CG*geom->KH*geom->KW;
+    uint64_t oh, ow, c, kh, kw;
+    const tb_float* xn = x + n*geom->xs[0] + g*geom->CG*geom->xs[1];
+
+    for(oh = 0; oh < geom->OH; oh++){
+        for(ow = 0; ow < geom->OW; ow++){
+            tb_float* row = col + (oh*geom->OW + ow)*K;
+
+            for(c = 0; c < geom->CG; c++){
+                for(kh = 0; kh < geom->KH; kh++){
+                    int64_t ih = (int64_t)(oh*geom->sh + kh*geom->dh) - (int64_t)geom->ph;
+
+                    for(kw = 0; kw < geom->KW; kw++){
+                        int64_t iw = (int64_t)(ow*geom->sw + kw*geom->dw) - (int64_t)geom->pw;
+                        uint8_t inside = (ih >= 0) && (ih < (int64_t)geom->H) && (iw >= 0) && (iw < (int64_t)geom->W);
+
+                        *row++ = inside ? xn[c*geom->xs[1] + ih*geom->xs[2] + iw*geom->xs[3]] : 0;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Scatter-adds the rows of `col` back into the input positions they were read from, inverse of `_tb_im2col`
+ */
+static void _tb_col2im(_TBConvGeometry* geom, const tb_float* col, uint64_t n, uint64_t g, tb_float* x){
+    uint64_t oh, ow, c, kh, kw;
+    tb_float* xn = x + n*geom->xs[0] + g*geom->CG*geom->xs[1];
+
+    for(oh = 0; oh < geom->OH; oh++){
+        for(ow = 0; ow < geom->OW; ow++){
+            for(c = 0; c < geom->CG; c++){
+                for(kh = 0; kh < geom->KH; kh++){
+                    int64_t ih = (int64_t)(oh*geom->sh + kh*geom->dh) - (int64_t)geom->ph;
+
+                    for(kw = 0; kw < geom->KW; kw++, col++){
+                        int64_t iw = (int64_t)(ow*geom->sw + kw*geom->dw) - (int64_t)geom->pw;
+
+                        if((ih >= 0) && (ih < (int64_t)geom->H) && (iw >= 0) && (iw < (int64_t)geom->W))
+                            xn[c*geom->xs[1] + ih*geom->xs[2] + iw*geom->xs[3]] += *col;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*
+ * out_g = W_g . col^T, written in place through the output strides: NCHW output channels are rows of P pixels,
+ * NHWC pixels are rows of CO channels.
+ */
+static void _tb_convIm2colKernel(TBGraphSession* sess, _TBConvGeometry* geom, tb_float* out, const tb_float* x, const tb_float* w){
+    uint64_t P = geom->OH*geom->OW, K = geom->CG*geom->KH*geom->KW;
+    tb_float* col = _tb_scratch(P*K, sizeof(tb_float));
+    uint64_t n, g;
+
+    for(n = 0; n < geom->N; n++){
+        for(g = 0; g < geom->groups; g++){
+            tb_float* o = out + n*geom->os[0] + g*geom->COG*geom->os[1];
+            const tb_float* wg = w + g*geom->COG*K;
+            _tb_im2col(geom, x, n, g, col);
+
+            if(geom->os[3] == 1)
+                _tb_sessionGemm(sess, CblasNoTrans, CblasTrans, geom->COG, P, K, 1.0, wg, K, col, K, 0.0, o, P);
+            else
+                _tb_sessionGemm(sess, CblasNoTrans, CblasTrans, P, geom->COG, K, 1.0, col, K, wg, K, 0.0, o, geom->CO);
+        }
+    }
+
+    _tb_releaseScratch(col);
+}
+
+typedef struct _TBConvTask{
+    _TBConvGeometry* geom;         /**< Convolution */
+    tb_float* out;                 /**< Contiguous output */
+    const tb_float* x;             /**< Contiguous input */
+    const tb_float* w;             /**< OIHW weights */
+    uint64_t row0;                 /**< First (n, oh) output row given to the worker */
+    uint64_t row1;                 /**< Last output row (excluded) given to the worker */
+}_TBConvTask;
+
+/*
+ * Direct convolution of small reductions, each output row is accumulated weight by weight along the contiguous
+ * pixels of the row, no column buffer is built.
+ */
+static void* _tb_convDirectWorker(void* arg){
+    _TBConvTask* task = (_TBConvTask*)arg;
+    _TBConvGeometry* geom = task->geom;
+    uint64_t K = geom->CG*geom->KH*geom->KW;
+    uint64_t r, co, c, kh, kw, ow;
+    tb_float acc[geom->OW];
+
+    for(r = task->row0; r < task->row1; r++){
+        uint64_t n = r/geom->OH, oh = r%geom->OH;
+
+        for(co = 0; co < geom->CO; co++){
+            uint64_t g = co/geom->COG;
+            const tb_float* wc = task->w + co*K;
+            memset(acc, 0, geom->OW*sizeof(tb_float));
+
+            for(c = 0; c < geom->CG; c++){
+                const tb_float* xc = task->x + n*geom->xs[0] + (g*geom->CG + c)*geom->xs[1];
+
+                for(kh = 0; kh < geom->KH; kh++){
+                    int64_t ih = (int64_t)(oh*geom->sh + kh*geom->dh) - (int64_t)geom->ph;
+                    if((ih < 0) || (ih >= (int64_t)geom->H))
+                        continue;
+
+                    const tb_float* xr = xc + ih*geom->xs[2];
+
+                    for(kw = 0; kw < geom->KW; kw++){
+                        tb_float wv = wc[(c*geom->KH + kh)*geom->KW + kw];
+                        int64_t off = (int64_t)(kw*geom->dw) - (int64_t)geom->pw;
+
+                        // pixels whose input column falls in the padding are skipped
+                        uint64_t ow0 = (off < 0) ? (uint64_t)((-off + geom->sw - 1)/geom->sw) : 0;
+                        for(ow = ow0; ow < geom->OW; ow++){
+                            int64_t iw = (int64_t)(ow*geom->sw) + off;
+                            if(iw >= (int64_t)geom->W)
+                                break;
+                            acc[ow] += wv*xr[iw*geom->xs[3]];
+                        }
+                    }
+                }
+            }
+
+            tb_float* o = task->out + n*geom->os[0] + co*geom->os[1] + oh*geom->os[2];
+            for(ow = 0; ow < geom->OW; ow++)
+                o[ow*geom->os[3]] = acc[ow];
+        }
+    }
+
+    return NULL;
+}
+
+/* Minimum number of multiply-adds given to each worker of the direct convolution */
+#define TB_CONV_GRAIN 65536
+
+static void _tb_convDirectKernel(TBGraphSession* sess, _TBConvGeometry* geom, tb_float* out, const tb_float* x, const tb_float* w){
+    uint64_t rows = geom->N*geom->OH;
+    uint64_t work = rows*geom->OW*geom->CO*geom->CG*geom->KH*geom->KW;
+    uint64_t threads = _tb_parallelThreads(sess, work, TB_CONV_GRAIN, rows);
+    uint64_t i = 0;
+    _TBConvTask tasks[threads];
+
+    for(; i < threads; i++){
+        _TBConvTask task = {geom, out, x, w, (rows*i)/threads, (rows*(i + 1))/threads};
+        tasks[i] = task;
+    }
+
+    _tb_parallelRun(sess, threads, _tb_convDirectWorker, tasks, sizeof(*tasks));
+}
+
+/*
+ * Weights of a blocked convolution packed as (CO/c, C/c, KH, KW, c_in, c_out): each kernel tap of a block pair is a
+ * contiguous c x c tile whose rows are broadcast against one input channel.
+ */
+static void _tb_convPackBlocked(_TBConvGeometry* geom, const tb_float* w, tb_float* wp){
+    uint64_t B = geom->block, CB = geom->C/B, COB = geom->CO/B;
+    uint64_t KK = geom->KH*geom->KW;
+    uint64_t cob, cib, k, ci, co;
+
+    for(cob = 0; cob < COB; cob++)
+        for(cib = 0; cib < CB; cib++)
+            for(k = 0; k < KK; k++){
+                tb_float* tile = wp + ((cob*CB + cib)*KK + k)*B*B;
+
+                for(ci = 0; ci < B; ci++)
+                    for(co = 0; co < B; co++)
+                        tile[ci*B + co] = w[((cob*B + co)*geom->C + cib*B + ci)*KK + k];
+            }
+}
+
+/*
+ * Direct NCHWc convolution, each output pixel keeps its block of c output channels in a single accumulator vector
+ * and the input block of a tap is read once for the whole vector.
+ */
+static void* _tb_convBlockedWorker(void* arg){
+    _TBConvTask* task = (_TBConvTask*)arg;
+    _TBConvGeometry* geom = task->geom;
+    uint64_t B = geom->block, CB = geom->C/B, COB = geom->CO/B;
+    uint64_t r, ow, cib, kh, kw, ci, co;
+    tb_float acc[B];
+
+    for(r = task->row0; r < task->row1; r++){
+        uint64_t n = r/(COB*geom->OH), cob = (r/geom->OH)%COB, oh = r%geom->OH;
+        tb_float* o = task->out + ((n*COB + cob)*geom->OH + oh)*geom->OW*B;
+
+        for(ow = 0; ow < geom->OW; ow++){
+            memset(acc, 0, B*sizeof(tb_float));
+
+            for(cib = 0; cib < CB; cib++){
+                const tb_float* xc = task->x + (n*CB + cib)*geom->H*geom->W*B;
+
+                for(kh = 0; kh < geom->KH; kh++){
+                    int64_t ih = (int64_t)(oh*geom->sh + kh*geom->dh) - (int64_t)geom->ph;
+                    if((ih < 0) || (ih >= (int64_t)geom->H))
+                        continue;
+
+                    for(kw = 0; kw < geom->KW; kw++){
+                        int64_t iw = (int64_t)(ow*geom->sw + kw*geom->dw) - (int64_t)geom->pw;
+                        if((iw < 0) || (iw >= (int64_t)geom->W))
+                            continue;
+
+                        const tb_float* xp = xc + (ih*geom->W + iw)*B;
+                        const tb_float* tile = task->w + ((cob*CB + cib)*geom->KH*geom->KW + kh*geom->KW + kw)*B*B;
+
+                        for(ci = 0; ci < B; ci++){
+                            tb_float xv = xp[ci];
+                            for(co = 0; co < B; co++)
+                                acc[co] += xv*tile[ci*B + co];
+                        }
+                    }
+                }
+            }
+
+            memcpy(o + ow*B, acc, B*sizeof(tb_float));
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * `packed` holds the weights already packed by `_tb_convPackBlocked`, NULL to pack them for this call only
+ */
+static void _tb_convBlockedKernel(TBGraphSession* sess, _TBConvGeometry* geom, tb_float* out, const tb_float* x, const tb_float* w, const tb_float* packed){
+    uint64_t rows = geom->N*(geom->CO/geom->block)*geom->OH;
+    uint64_t work = rows*geom->OW*geom->block*geom->C*geom->KH*geom->KW;
+    uint64_t threads = _tb_parallelThreads(sess, work, TB_CONV_GRAIN, rows);
+    tb_float* wp = (packed == NULL) ? _tb_scratch(geom->CO*geom->C*geom->KH*geom->KW, sizeof(tb_float)) : NULL;
+    uint64_t i = 0;
+    _TBConvTask tasks[threads];
+
+    if(wp != NULL)
+        _tb_convPackBlocked(geom, w, wp);
+
+    for(; i < threads; i++){
+        _TBConvTask task = {geom, out, x, (wp != NULL) ? wp : packed, (rows*i)/threads, (rows*(i + 1))/threads};
+        tasks[i] = task;
+    }
+
+    _tb_parallelRun(sess, threads, _tb_convBlockedWorker, tasks, sizeof(*tasks));
+
+    if(wp != NULL)
+        _tb_releaseScratch(wp);
+}
+
+#undef TB_CONV_GRAIN
+
+/*
+ * Winograd transform of the 3x3 filters, U_e[co, c] = (G g G^T)[e] with G = [1 0 0; .5 .5 .5; .5 -.5 .5; 0 0 1]
+ */
+static void _tb_winogradFilters(_TBConvGeometry* geom, const tb_float* w, tb_float* U){
+    uint64_t CG = geom->CG;
+    uint64_t co, c, i, j, e;
+
+    for(co = 0; co < geom->CO; co++){
+        for(c = 0; c < CG; c++){
+            const tb_float* f = w + (co*CG + c)*9;
+            tb_float gg[4][3], u[4][4];
+
+            for(j = 0; j < 3; j++){
+                gg[0][j] = f[j];
+                gg[1][j] = 0.5f*(f[j] + f[3 + j] + f[6 + j]);
+                gg[2][j] = 0.5f*(f[j] - f[3 + j] + f[6 + j]);
+                gg[3][j] = f[6 + j];
+            }
+            for(i = 0; i < 4; i++){
+                u[i][0] = gg[i][0];
+                u[i][1] = 0.5f*(gg[i][0] + gg[i][1] + gg[i][2]);
+                u[i][2] = 0.5f*(gg[i][0] - gg[i][1] + gg[i][2]);
+                u[i][3] = gg[i][2];
+            }
+            for(e = 0; e < 16; e++)
+                U[(e*geom->CO + co)*CG + c] = u[e/4][e%4];
+        }
+    }
+}
+
+/*
+ * Winograd F(2x2, 3x3): each 4x4 input tile d and 3x3 filter g give a 2x2 output tile A^T[(G g G^T) . (B^T d B)]A.
+ * The 16 element-wise products summed over the channels are 16 GEMMs M_e = U_e . V_e of (COG x CG) by (CG x tiles).
+ * `packed` holds the filters transformed by `_tb_winogradFilters`, NULL to transform them for this call only.
+ */
+static void _tb_convWinogradKernel(TBGraphSession* sess, _TBConvGeometry* geom, tb_float* out, const tb_float* x, const tb_float* w, const tb_float* packed){
+    uint64_t TH = (geom->OH + 1)/2, TW = (geom->OW + 1)/2, T = TH*TW;
+    uint64_t CG = geom->CG, COG = geom->COG;
+    tb_float* filters = (packed == NULL) ? _tb_scratch(16*geom->CO*CG, sizeof(tb_float)) : NULL;
+    tb_float* V = _tb_scratch(16*CG*T, sizeof(tb_float));
+    tb_float* M = _tb_scratch(16*COG*T, sizeof(tb_float));
+    const tb_float* U = (filters != NULL) ? filters : packed;
+    uint64_t n, g, co, c, t, i, j, e;
+
+    if(filters != NULL)
+        _tb_winogradFilters(geom, w, filters);
+
+    for(n = 0; n < geom->N; n++){
+        for(g = 0; g < geom->groups; g++){
+            const tb_float* xn = x + n*geom->xs[0] + g*CG*geom->xs[1];
+
+            // V_e[c, t] = (B^T d B)[e] with B^T = [1 0 -1 0; 0 1 1 0; 0 -1 1 0; 0 1 0 -1]
+            for(c = 0; c < CG; c++){
+                for(t = 0; t < T; t++){
+                    int64_t h0 = (int64_t)(2*(t/TW)) - (int64_t)geom->ph, w0 = (int64_t)(2*(t%TW)) - (int64_t)geom->pw;
+                    tb_float d[4][4], bd[4][4];
+
+                    for(i = 0; i < 4; i++){
+                        for(j = 0; j < 4; j++){
+                            int64_t ih = h0 + (int64_t)i, iw = w0 + (int64_t)j;
+                            uint8_t inside = (ih >= 0) && (ih < (int64_t)geom->H) && (iw >= 0) && (iw < (int64_t)geom->W);
+                            d[i][j] = inside ? xn[c*geom->xs[1] + ih*geom->xs[2] + iw*geom->xs[3]] : 0;
+                        }
+                    }
+                    for(j = 0; j < 4; j++){
+                        bd[0][j] = d[0][j] - d[2][j];
+                        bd[1][j] = d[1][j] + d[2][j];
+                        bd[2][j] = d[2][j] - d[1][j];
+                        bd[3][j] = d[1][j] - d[3][j];
+                    }
+                    for(i = 0; i < 4; i++){
+                        tb_float* v = V + (i*4*CG + c)*T + t;
+                        v[0] = bd[i][0] - bd[i][2];
+                        v[CG*T] = bd[i][1] + bd[i][2];
+                        v[2*CG*T] = bd[i][2] - bd[i][1];
+                        v[3*CG*T] = bd[i][1] - bd[i][3];
+                    }
+                }
+            }
+
+            for(e = 0; e < 16; e++){
+                _tb_sessionGemm(sess, CblasNoTrans, CblasNoTrans, COG, T, CG,
+                                1.0, U + (e*geom->CO + g*COG)*CG, CG, V + e*CG*T, T, 0.0, M + e*COG*T, T);
+            }
+
+            // Y = A^T m A with A^T = [1 1 1 0; 0 1 -1 -1], tiles on the last row or column may be cut
+            for(co = 0; co < COG; co++){
+                tb_float* o = out + n*geom->os[0] + (g*COG + co)*geom->os[1];
+
+                for(t = 0; t < T; t++){
+                    uint64_t oh = 2*(t/TW), ow = 2*(t%TW);
+                    tb_float m[16], am[2][4];
+
+                    for(e = 0; e < 16; e++)
+                        m[e] = M[(e*COG + co)*T + t];
+                    for(j = 0; j < 4; j++){
+                        am[0][j] = m[j] + m[4 + j] + m[8 + j];
+                        am[1][j] = m[4 + j] - m[8 + j] - m[12 + j];
+                    }
+                    for(i = 0; i < 2 && oh + i < geom->OH; i++){
+                        o[(oh + i)*geom->os[2] + ow*geom->os[3]] = am[i][0] + am[i][1] + am[i][2];
+                        if(ow + 1 < geom->OW)
+                            o[(oh + i)*geom->os[2] + (ow + 1)*geom->os[3]] = am[i][1] - am[i][2] - am[i][3];
+                    }
+                }
+            }
+        }
+    }
+
+    _tb_releaseScratch(M);
+    _tb_releaseScratch(V);
+    if(filters != NULL)
+        _tb_releaseScratch(filters);
+}
+
+/*
+ * Winograd needs a GEMM large enough to amortize the transforms, the direct kernel wins when the reduction of each
+ * output is too short for a column buffer to pay off.
+ */
+static TBConvolutionAlgorithm _tb_convAlgorithm(TBConvolutionOperation* cop, _TBConvGeometry* geom){
+    uint8_t winograd = (geom->KH == 3) && (geom->KW == 3) && (geom->sh == 1) && (geom->sw == 1) && (geom->dh == 1) && (geom->dw == 1);
+
+    if(cop->algorithm == TBCA_WINOGRAD)
+        return winograd ? TBCA_WINOGRAD : TBCA_IM2COL;
+    if(cop->algorithm != TBCA_AUTO)
+        return cop->algorithm;
+    if(winograd && (geom->CG >= 16) && (geom->COG >= 16))
+        return TBCA_WINOGRAD;
+    if(geom->CG*geom->KH*geom->KW < 32)
+        return TBCA_DIRECT;
+
+    return TBCA_IM2COL;
+}
+
+uint64_t _tb_convPackKind(TBConvolutionOperation* cop, NDArray* uhs, NDArray* weights){
+    _TBConvGeometry geom = _tb_convGeometry(cop, uhs->shape, weights->shape);
+
+    // blocked images have a single kernel, the algorithm only applies to plain layouts
+    if(geom.block != 0)
+        return 1 + geom.block;
+
+    return (_tb_convAlgorithm(cop, &geom) == TBCA_WINOGRAD) ? 1 : 0;
+}
+
+tb_float* _tb_convPackWeights(TBConvolutionOperation* cop, NDArray* uhs, NDArray* weights){
+    uint64_t kind = _tb_convPackKind(cop, uhs, weights);
+
+    if(kind == 0)
+        return NULL;
+
+    NDArray* wf = _tb_contiguousUpcast(weights);
+    _TBConvGeometry geom = _tb_convGeometry(cop, uhs->shape, wf->shape);
+    tb_float* packed = nda_memCalloc((kind == 1) ? 16*geom.CO*geom.CG : geom.CO*geom.C*geom.KH*geom.KW, sizeof(tb_float));
+
+    if(kind == 1)
+        _tb_winogradFilters(&geom, wf->data, packed);
+    else
+        _tb_convPackBlocked(&geom, wf->data, packed);
+
+    _tb_releaseUpcast(wf, weights);
+
+    return packed;
+}
+
+uint64_t _tb_convolutionWorkspace(TBConvolutionOperation* cop, NDArray* uhs, NDArray* weights, uint8_t packed){
+    _TBConvGeometry geom = _tb_convGeometry(cop, uhs->shape, weights->shape);
+    uint64_t T = ((geom.OH + 1)/2)*((geom.OW + 1)/2);
+
+    if(geom.block != 0)
+        return packed ? 0 : _tb_scratchBytes(geom.CO*geom.C*geom.KH*geom.KW, sizeof(tb_float));
+
+    switch(_tb_convAlgorithm(cop, &geom)){
+        case TBCA_WINOGRAD:
+            return (packed ? 0 : _tb_scratchBytes(16*geom.CO*geom.CG, sizeof(tb_float))) +
+                   _tb_scratchBytes(16*geom.CG*T, sizeof(tb_float)) + _tb_scratchBytes(16*geom.COG*T, sizeof(tb_float));
+        case TBCA_DIRECT:
+            return 0;
+        case TBCA_AUTO:
+        case TBCA_IM2COL:
+            break;
+    }
+
+    return _tb_scratchBytes(geom.OH*geom.OW*geom.CG*geom.KH*geom.KW, sizeof(tb_float));
+}
+
+void _tb_convolutionInto(TBGraphSession* sess, TBConvolutionOperation* cop, NDArray* out, NDArray* uhs, NDArray* weights, const tb_float* packed){
+    NDArray* xf = _tb_contiguousUpcast(uhs);
+    NDArray* wf = _tb_contiguousUpcast(weights);
+    _TBConvGeometry geom = _tb_convGeometry(cop, xf->shape, wf->shape);
+
+    // blocked images have a single kernel, the algorithm only applies to plain layouts
+    if(geom.block != 0){
+        _tb_convBlockedKernel(sess, &geom, out->data, xf->data, wf->data, packed);
+        _tb_releaseUpcast(xf, uhs);
+        _tb_releaseUpcast(wf, weights);
+        return;
+    }
+
+    switch(_tb_convAlgorithm(cop, &geom)){
+        case TBCA_WINOGRAD:
+            _tb_convWinogradKernel(sess, &geom, out->data, xf->data, wf->data, packed);
+            break;
+        case TBCA_DIRECT:
+            _tb_convDirectKernel(sess, &geom, out->data, xf->data, wf->data);
+            break;
+        case TBCA_AUTO:
+        case TBCA_IM2COL:
+            _tb_convIm2colKernel(sess, &geom, out->data, xf->data, wf->data);
+            break;
+    }
+
+    _tb_releaseUpcast(xf, uhs);
+    _tb_releaseUpcast(wf, weights);
+}
+
+/*
+ * The derivatives of a blocked convolution are computed on NCHW copies of the input and gradient, blocked layouts
+ * target inference where the backward pass is not run.
+ */
+static void _tb_convolutionBlockedGradInto(TBGraphSession* sess, TBConvolutionOperation* cop, NDArray* dx, NDArray* dw, NDArray* uhs, NDArray* weights, NDArray* g){
+    TBConvolutionOperation plain = *cop;
+    TBReorderOperation rop = {NULL, TBCL_NCHWC, TBCL_NCHW, uhs->shape->dims[4]};
+    NDArray* x = nda_alloc(nda_newShape(4, uhs->shape->dims[0], uhs->shape->dims[1]*rop.block, uhs->shape->dims[2], uhs->shape->dims[3]));
+    NDArray* gp = nda_alloc(nda_newShape(4, g->shape->dims[0], g->shape->dims[1]*rop.block, g->shape->dims[2], g->shape->dims[3]));
+    NDArray* dxp = (dx != NULL) ? nda_alloc(nda_copyShape(x->shape)) : NULL;
+
+    plain.layout = TBCL_NCHW;
+    _tb_reorderInto(&rop, x, uhs);
+    _tb_reorderInto(&rop, gp, g);
+    _tb_convolutionGradInto(sess, &plain, dxp, dw, x, weights, gp);
+
+    if(dxp != NULL){
+        _tb_reorderGradInto(&rop, dx, dxp);
+        nda_free(dxp);
+        free(dxp);
+    }
+
+    nda_free(x);
+    free(x);
+    nda_free(gp);
+    free(gp);
+}
+
+void _tb_convolutionGradInto(TBGraphSession* sess, TBConvolutionOperation* cop, NDArray* dx, NDArray* dw, NDArray* uhs, NDArray* weights, NDArray* g){
+    if(cop->layout == TBCL_NCHWC){
+        _tb_convolutionBlockedGradInto(sess, cop, dx, dw, uhs, weights, g);
+        return;
+    }
+
+    NDArray* xf = _tb_contiguousUpcast(uhs);
+    NDArray* wf = _tb_contiguousUpcast(weights);
+    NDArray* gf = _tb_contiguousUpcast(g);
+    _TBConvGeometry geom = _tb_convGeometry(cop, xf->shape, wf->shape);
+    uint64_t P = geom.OH*geom.OW, K = geom.CG*geom.KH*geom.KW;
+    tb_float* col = _tb_scratch(P*K, sizeof(tb_float));
+    uint64_t n, gr;
+
+    if(dx != NULL)
+        memset(dx->data, 0, dx->shape->raw_len*sizeof(tb_float));
+    if(dw != NULL)
+        memset(dw->data, 0, dw->shape->raw_len*sizeof(tb_float));
+
+    for(n = 0; n < geom.N; n++){
+        for(gr = 0; gr < geom.groups; gr++){
+            const tb_float* go = gf->data + n*geom.os[0] + gr*geom.COG*geom.os[1];
+            uint8_t nchw = (geom.os[3] == 1);
+
+            // dW_g += dY_g . col
+            if(dw != NULL){
+                _tb_im2col(&geom, xf->data, n, gr, col);
+                _tb_sessionGemm(sess, nchw ? CblasNoTrans : CblasTrans, CblasNoTrans, geom.COG, K, P,
+                                1.0, go, nchw ? P : geom.CO, col, K, 1.0, dw->data + gr*geom.COG*K, K);
+            }
+
+            // dcol = dY_g^T . W_g, scattered back into dX
+            if(dx != NULL){
+                _tb_sessionGemm(sess, nchw ? CblasTrans : CblasNoTrans, CblasNoTrans, P, K, geom.COG,
+                                1.0, go, nchw ? P : geom.CO, wf->data + gr*geom.COG*K, K, 0.0, col, K);
+                _tb_col2im(&geom, col, n, gr, dx->data);
             }
-        }
-        
-        j+=shape->strides[axis];
-        for(k=1; k < shape->dims[axis]; j+=shape->strides[axis],k++){
-            //printf("%lld, %lld, %f\n", i, j,  arr->data[j]);
-            new_arr->data[i] = (new_arr->data[i]<k)?new_arr->data[i]:k;
         }
     }
-    
-    return tb_newResultNode(new_arr);
+
+    _tb_releaseScratch(col);
+    _tb_releaseUpcast(xf, uhs);
+    _tb_releaseUpcast(wf, weights);
+    _tb_releaseUpcast(gf, g);
 }
 
-TBResultNode* _tb_product(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBAxisBoundOperation* abop){
-    NDShape* shape = uhs->value->shape;
-    NDArray* arr = uhs->value;
-    
-    uint64_t axis = abop->axis;
-    
-    ASSERT(axis < shape->rank, "Cannot compute axis bound operation SUM on axis %lld >= array of rank %llu", axis, shape->rank);
-    
-    uint64_t* new_dims = NULL;
-    uint64_t new_rank = 1;
-    if(shape->rank == 1){
-        new_dims = calloc(1, sizeof(uint64_t));
-        new_dims[0] = 1;
-    }
-    else{
-        new_dims = calloc(shape->rank-1, sizeof(uint64_t));
-        new_rank =shape->rank-1;
+static _TBConvGeometry _tb_poolGeometry(TBPoolingOperation* pop, NDShape* x){
+    uint8_t nhwc = (pop->layout == TBCL_NHWC);
+    uint8_t global = (pop->type == TBPOT_GLOBAL_MAX) || (pop->type == TBPOT_GLOBAL_AVG);
+    _TBConvGeometry geom;
+    memset(&geom, 0, sizeof(_TBConvGeometry));
+
+    geom.N = x->dims[0];
+    geom.C = geom.CO = geom.groups = x->dims[nhwc ? 3 : 1];
+    geom.H = x->dims[nhwc ? 1 : 2];
+    geom.W = x->dims[nhwc ? 2 : 3];
+
+    // channel blocks are pooled independently, (N, C/c, H, W, c) is an NHWC image of N*C/c samples of c channels
+    if(pop->layout == TBCL_NCHWC){
+        geom.N *= x->dims[1];
+        geom.C = geom.CO = geom.groups = x->dims[4];
+        nhwc = 1;
     }
-    
-    uint64_t i = 0;
-    uint64_t j = 0;
-    for(; i < shape->rank; i++){
-        if (i != axis){
-            new_dims[j++] = shape->dims[i];
-        }
+    geom.KH = global ? geom.H : pop->window[0];
+    geom.KW = global ? geom.W : pop->window[1];
+    geom.sh = global ? 1 : pop->stride[0];
+    geom.sw = global ? 1 : pop->stride[1];
+    geom.ph = global ? 0 : pop->padding[0];
+    geom.pw = global ? 0 : pop->padding[1];
+    geom.dh = geom.dw = geom.CG = geom.COG = 1;
+    geom.OH = (geom.H + 2*geom.ph - geom.KH)/geom.sh + 1;
+    geom.OW = (geom.W + 2*geom.pw - geom.KW)/geom.sw + 1;
+
+    uint64_t C = geom.C;
+    if(nhwc){
+        uint64_t xs[4] = {geom.H*geom.W*C, 1, geom.W*C, C};
+        uint64_t os[4] = {geom.OH*geom.OW*C, 1, geom.OW*C, C};
+        memcpy(geom.xs, xs, sizeof(xs));
+        memcpy(geom.os, os, sizeof(os));
     }
-    
-    NDShape* newShape = nda_newShapeFromArray(new_rank, new_dims);
-    NDArray* new_arr = nda_alloc(newShape);
-    
-    i = 0;
-    uint64_t k = 0;
-    for(; i < newShape->raw_len; i++){
-        new_arr->data[i] = 1;
+    else {
+        uint64_t xs[4] = {C*geom.H*geom.W, geom.H*geom.W, geom.W, 1};
+        uint64_t os[4] = {C*geom.OH*geom.OW, geom.OH*geom.OW, geom.OW, 1};
+        memcpy(geom.xs, xs, sizeof(xs));
+        memcpy(geom.os, os, sizeof(os));
     }
-    
-    for(i=0; i < newShape->raw_len; i++){
-        
-        uint64_t m = shape->rank;
-        uint64_t mod = i;
-        j = 0; //i/shape->strides[axis] % shape->dims[axis];
-        for(;m > 0; m--){
-            if(m-1 == axis){
-                continue;
+
+    return geom;
+}
+
+typedef struct _TBPoolTask{
+    TBPoolingOperation* pop;       /**< Pooling */
+    _TBConvGeometry* geom;         /**< Dimensions of the pooling */
+    tb_float* out;                 /**< Contiguous output */
+    int64_t* indices;              /**< Input offset of the maximum of each output, NULL when not kept */
+    const tb_float* x;             /**< Contiguous input */
+    uint64_t row0;                 /**< First (n, oh) output row given to the worker */
+    uint64_t row1;                 /**< Last output row (excluded) given to the worker */
+}_TBPoolTask;
+
+/*
+ * The channel loop is innermost, NHWC windows are read as runs of contiguous channels that the compiler vectorizes.
+ * Averages are taken over the window positions inside the input, padding is not counted.
+ */
+static void* _tb_poolWorker(void* arg){
+    _TBPoolTask* task = (_TBPoolTask*)arg;
+    _TBConvGeometry* geom = task->geom;
+    uint8_t max = (task->pop->type == TBPOT_MAX) || (task->pop->type == TBPOT_GLOBAL_MAX);
+    uint64_t C = geom->C, cs = geom->xs[1];
+    uint64_t r, ow, c;
+    tb_float acc[C];
+    int64_t amax[C];
+
+    for(r = task->row0; r < task->row1; r++){
+        uint64_t n = r/geom->OH, oh = r%geom->OH;
+        int64_t h0 = (int64_t)(oh*geom->sh) - (int64_t)geom->ph;
+        int64_t h1 = h0 + (int64_t)geom->KH;
+        h0 = (h0 < 0) ? 0 : h0;
+        h1 = (h1 > (int64_t)geom->H) ? (int64_t)geom->H : h1;
+
+        for(ow = 0; ow < geom->OW; ow++){
+            int64_t w0 = (int64_t)(ow*geom->sw) - (int64_t)geom->pw;
+            int64_t w1 = w0 + (int64_t)geom->KW;
+            int64_t ih, iw;
+            w0 = (w0 < 0) ? 0 : w0;
+            w1 = (w1 > (int64_t)geom->W) ? (int64_t)geom->W : w1;
+
+            for(c = 0; c < C; c++){
+                acc[c] = max ? -INFINITY : 0;
+                amax[c] = -1;
             }
-            else{
-                j += (mod%shape->dims[m-1])*shape->strides[m-1];
-                mod = mod/shape->dims[m-1];
-                //printf("%lld, %lld, m= %lld, %f\n", i, j, m, arr->data[j]);
+
+            for(ih = h0; ih < h1; ih++){
+                for(iw = w0; iw < w1; iw++){
+                    uint64_t off = n*geom->xs[0] + ih*geom->xs[2] + iw*geom->xs[3];
+                    const tb_float* px = task->x + off;
+
+                    if(!max){
+                        for(c = 0; c < C; c++)
+                            acc[c] += px[c*cs];
+                    }
+                    else if(task->indices == NULL){
+                        for(c = 0; c < C; c++)
+                            acc[c] = (px[c*cs] > acc[c]) ? px[c*cs] : acc[c];
+                    }
+                    else {
+                        for(c = 0; c < C; c++){
+                            uint8_t greater = (px[c*cs] > acc[c]) || (amax[c] < 0);
+                            acc[c] = greater ? px[c*cs] : acc[c];
+                            amax[c] = greater ? (int64_t)(off + c*cs) : amax[c];
+                        }
+                    }
+                }
+            }
+
+            // windows lying entirely in the padding read nothing, their output is 0
+            uint64_t o = n*geom->os[0] + oh*geom->os[2] + ow*geom->os[3];
+            int64_t count = ((h1 > h0) ? h1 - h0 : 0)*((w1 > w0) ? w1 - w0 : 0);
+            tb_float scale = (count == 0) ? 0 : (max ? 1 : (tb_float)(1.0/(double)count));
+            for(c = 0; c < C; c++)
+                task->out[o + c*geom->os[1]] = (count == 0) ? 0 : acc[c]*scale;
+
+            if(task->indices != NULL){
+                for(c = 0; c < C; c++)
+                    task->indices[o + c*geom->os[1]] = amax[c];
             }
         }
+    }
+
+    return NULL;
+}
+
+/* Minimum number of values read by each worker of the pooling kernel */
+#define TB_POOL_GRAIN 65536
+
+void _tb_poolingInto(TBGraphSession* sess, TBPoolingOperation* pop, NDArray* out, NDArray* uhs, NDArray* indices){
+    NDArray* xf = _tb_contiguousUpcast(uhs);
+    _TBConvGeometry geom = _tb_poolGeometry(pop, xf->shape);
+    uint64_t rows = geom.N*geom.OH;
+    uint64_t threads = _tb_parallelThreads(sess, rows*geom.OW*geom.C*geom.KH*geom.KW, TB_POOL_GRAIN, rows);
+    uint64_t i = 0;
+    _TBPoolTask tasks[threads];
+
+    for(; i < threads; i++){
+        _TBPoolTask task = {pop, &geom, out->data, (indices != NULL) ? (int64_t*)indices->raw : NULL, xf->data,
+                            (rows*i)/threads, (rows*(i + 1))/threads};
+        tasks[i] = task;
+    }
+
+    _tb_parallelRun(sess, threads, _tb_poolWorker, tasks, sizeof(*tasks));
+
+    _tb_releaseUpcast(xf, uhs);
+}
+
+#undef TB_POOL_GRAIN
+
+void _tb_poolingGradInto(TBGraphSession* sess, TBPoolingOperation* pop, NDArray* dx, NDArray* uhs, NDArray* indices, NDArray* g){
+    NDArray* gf = _tb_contiguousUpcast(g);
+    _TBConvGeometry geom = _tb_poolGeometry(pop, uhs->shape);
+    uint8_t max = (pop->type == TBPOT_MAX) || (pop->type == TBPOT_GLOBAL_MAX);
+    uint64_t len = gf->shape->raw_len, i;
+
+    memset(dx->data, 0, dx->shape->raw_len*sizeof(tb_float));
+
+    // the maximum of each window receives the whole gradient, the indices are recomputed when they were not kept
+    if(max){
+        NDArray* idx = indices;
+        if(idx == NULL){
+            NDArray* y = nda_alloc(nda_copyShape(gf->shape));
+            idx = nda_allocType(nda_copyShape(gf->shape), NDA_DTYPE_I64);
+            _tb_poolingInto(sess, pop, y, uhs, idx);
+            nda_free(y);
+            free(y);
+        }
+
+        // empty windows have no maximum
+        for(i = 0; i < len; i++){
+            int64_t at = ((int64_t*)idx->raw)[i];
+            if(at >= 0)
+                dx->data[at] += gf->data[i];
+        }
+
+        if(idx != indices){
+            nda_free(idx);
+            free(idx);
+        }
+
+        _tb_releaseUpcast(gf, g);
+        return;
+    }
+
+    uint64_t n, c, oh, ow;
+    int64_t ih, iw;
+    for(n = 0; n < geom.N; n++)
+    for(c = 0; c < geom.C; c++)
+    for(oh = 0; oh < geom.OH; oh++)
+    for(ow = 0; ow < geom.OW; ow++){
+        int64_t h0 = (int64_t)(oh*geom.sh) - (int64_t)geom.ph, h1 = h0 + (int64_t)geom.KH;
+        int64_t w0 = (int64_t)(ow*geom.sw) - (int64_t)geom.pw, w1 = w0 + (int64_t)geom.KW;
+        h0 = (h0 < 0) ? 0 : h0;
+        w0 = (w0 < 0) ? 0 : w0;
+        h1 = (h1 > (int64_t)geom.H) ? (int64_t)geom.H : h1;
+        w1 = (w1 > (int64_t)geom.W) ? (int64_t)geom.W : w1;
+
+        if((h1 <= h0) || (w1 <= w0))
+            continue;
         
-        
-        for(k=0; k < shape->dims[axis]; j+=shape->strides[axis],k++){
-            //printf("%lld, %lld, %f\n", i, j,  arr->data[j]);
-            new_arr->data[i] *= arr->data[j];
+        tb_float v = gf->data[n*geom.os[0] + c*geom.os[1] + oh*geom.os[2] + ow*geom.os[3]]/(tb_float)((h1 - h0)*(w1 - w0));
+        for(ih = h0; ih < h1; ih++)
+            for(iw = w0; iw < w1; iw++)
+                dx->data[n*geom.xs[0] + c*geom.xs[1] + ih*geom.xs[2] + iw*geom.xs[3]] += v;
+    }
+
+    _tb_releaseUpcast(gf, g);
+}
+
+/*
+ * Accumulators are double, so long reductions over tb_float do not lose precision.
+ */
+#define TB_REDUCE_CASE(type, otype, init, accumulate, finalize)\
+        case type:\
+            for(i = 0; i < out->shape->raw_len; i++, j = _tb_nextLane(shape, axis, index, j)){\
+                tb_float* lane = uhs->data + j;\
+                double acc = (init);\
+                for(k = 0; k < len; k++){\
+                    tb_float x = lane[k*stride];\
+                    accumulate;\
+                }\
+                ((otype*)out->raw)[i] = (otype)(finalize);\
+            }\
+            break;
+
+/*
+ * Same for the arg reductions, which also keep the position of the accumulator in its lane.
+ */
+#define TB_ARG_REDUCE_CASE(type, compare)\
+        case type:\
+            for(i = 0; i < out->shape->raw_len; i++, j = _tb_nextLane(shape, axis, index, j)){\
+                tb_float* lane = uhs->data + j;\
+                tb_float acc = lane[0];\
+                uint64_t arg = 0;\
+                for(k = 0; k < len; k++){\
+                    tb_float x = lane[k*stride];\
+                    if(x compare acc){ acc = x; arg = k; }\
+                }\
+                ((int64_t*)out->raw)[i] = (int64_t)arg;\
+            }\
+            break;
+
+#ifdef TB_F64_KERNELS
+/*
+ * F64 outputs and arg reductions of F64 operands, every lane is reduced in double by the calling thread.
+ * Softmaxes write a lane of the output for each lane of the operand.
+ */
+static void _tb_doubleAxisBoundInto(TBAxisBoundOperation* abop, NDArray* out, NDArray* uhs){
+    NDArray* u = _tb_upcastF64(uhs);
+    NDShape* shape = u->shape;
+    uint64_t axis = abop->axis;
+    uint64_t index[shape->rank], oindex[shape->rank];
+    memset(index, 0, shape->rank*sizeof(uint64_t));
+    memset(oindex, 0, shape->rank*sizeof(uint64_t));
+
+    uint8_t lanewise = (abop->type == TBABOT_SOFTMAX) || (abop->type == TBABOT_LOG_SOFTMAX);
+    uint64_t len = shape->dims[axis];
+    uint64_t stride = shape->strides[axis], ostride = lanewise ? out->shape->strides[axis] : 0;
+    uint64_t lanes = (len > 0) ? shape->raw_len/len : 0;
+    uint64_t i = 0, j = 0, o = 0, k;
+    double* y = (double*)out->raw;
+
+    for(; i < lanes; i++){
+        const double* lane = (const double*)u->raw + j;
+        double acc = lane[0], s = 0;
+        uint64_t arg = 0;
+
+        switch(abop->type){
+            case TBABOT_SUM:
+            case TBABOT_MEAN:
+                for(acc = 0, k = 0; k < len; k++)
+                    acc += lane[k*stride];
+                y[i] = (abop->type == TBABOT_MEAN) ? acc/(double)len : acc;
+                break;
+            case TBABOT_PRODUCT:
+                for(acc = 1, k = 0; k < len; k++)
+                    acc *= lane[k*stride];
+                y[i] = acc;
+                break;
+            case TBABOT_MIN:
+            case TBABOT_ARGMIN:
+                for(k = 0; k < len; k++)
+                    if(lane[k*stride] < acc){ acc = lane[k*stride]; arg = k; }
+                if(abop->type == TBABOT_MIN)
+                    y[i] = acc;
+                else
+                    ((int64_t*)out->raw)[i] = (int64_t)arg;
+                break;
+            case TBABOT_MAX:
+            case TBABOT_ARGMAX:
+                for(k = 0; k < len; k++)
+                    if(lane[k*stride] > acc){ acc = lane[k*stride]; arg = k; }
+                if(abop->type == TBABOT_MAX)
+                    y[i] = acc;
+                else
+                    ((int64_t*)out->raw)[i] = (int64_t)arg;
+                break;
+            case TBABOT_VARIANCE:
+                // population variance, two passes since the lane is not read through tb_float
+                for(acc = 0, k = 0; k < len; k++)
+                    acc += lane[k*stride];
+                acc /= (double)len;
+                for(k = 0; k < len; k++)
+                    s += (lane[k*stride] - acc)*(lane[k*stride] - acc);
+                y[i] = s/(double)len;
+                break;
+            case TBABOT_SOFTMAX:
+            case TBABOT_LOG_SOFTMAX:
+                for(k = 0; k < len; k++)
+                    acc = (lane[k*stride] > acc) ? lane[k*stride] : acc;
+                for(k = 0; k < len; k++)
+                    s += exp(lane[k*stride] - acc);
+                for(k = 0; k < len; k++)
+                    y[o + k*ostride] = (abop->type == TBABOT_LOG_SOFTMAX) ? lane[k*stride] - acc - log(s) : exp(lane[k*stride] - acc)/s;
+                break;
         }
+
+        j = _tb_nextLane(shape, axis, index, j);
+        if(lanewise)
+            o = _tb_nextLane(out->shape, axis, oindex, o);
+    }
+
+    _tb_releaseUpcast(u, uhs);
+}
+#endif
+
+void _tb_axisBoundInto(TBGraphSession* sess, TBAxisBoundOperation* abop, NDArray* out, NDArray* uhs){
+#ifdef TB_F64_KERNELS
+    if((out->dtype == NDA_DTYPE_F64) || ((out->dtype == NDA_DTYPE_I64) && (uhs->dtype == NDA_DTYPE_F64))){
+        _tb_doubleAxisBoundInto(abop, out, uhs);
+        return;
+    }
+#endif
+
+    if((uhs->dtype != NDA_DTYPE_FLOAT) || (uhs->sparse != NULL)){
+        NDArray* u = _tb_upcast(uhs);
+        _tb_axisBoundInto(sess, abop, out, u);
+        _tb_releaseUpcast(u, uhs);
+        return;
+    }
+
+    if((abop->type == TBABOT_SOFTMAX) || (abop->type == TBABOT_LOG_SOFTMAX)){
+        _tb_softmaxInto(abop, out, uhs);
+        return;
+    }
+
+    if((abop->type == TBABOT_MEAN) || (abop->type == TBABOT_VARIANCE)){
+        _tb_momentsInto(sess, abop, out, uhs);
+        return;
+    }
+
+    NDShape* shape = uhs->shape;
+    uint64_t axis = abop->axis;
+    uint64_t index[shape->rank];
+    memset(index, 0, shape->rank*sizeof(uint64_t));
+
+    uint64_t len = shape->dims[axis];
+    uint64_t stride = shape->strides[axis];
+    uint64_t i, j = 0, k;
+
+    switch(abop->type){
+        TB_REDUCE_CASE(TBABOT_SUM, tb_float, 0, acc += x, acc)
+        TB_REDUCE_CASE(TBABOT_PRODUCT, tb_float, 1, acc *= x, acc)
+        TB_REDUCE_CASE(TBABOT_MIN, tb_float, lane[0], acc = (x < acc)?x:acc, acc)
+        TB_REDUCE_CASE(TBABOT_MAX, tb_float, lane[0], acc = (x > acc)?x:acc, acc)
+        TB_ARG_REDUCE_CASE(TBABOT_ARGMIN, <)
+        TB_ARG_REDUCE_CASE(TBABOT_ARGMAX, >)
+        case TBABOT_MEAN:
+        case TBABOT_VARIANCE:
+        case TBABOT_SOFTMAX:
+        case TBABOT_LOG_SOFTMAX:
+            break;
+    }
+}
+
+uint64_t _tb_axisBoundWorkspace(TBGraphSession* sess, TBAxisBoundOperation* abop, NDArray* out, NDArray* uhs){
+    uint64_t lanes = out->shape->raw_len;
+    uint64_t threads = _tb_momentsThreads(sess, lanes, uhs->shape->dims[abop->axis]);
+
+    // lanes are only split into chunks when there are fewer lanes than threads
+    if(((abop->type != TBABOT_MEAN) && (abop->type != TBABOT_VARIANCE)) || (lanes >= threads))
+        return 0;
+
+    return _tb_scratchBytes(lanes*threads, sizeof(_TBMoments));
+}
+
+#undef TB_REDUCE_CASE
+#undef TB_ARG_REDUCE_CASE
+
+/* Rows of the output moved together, so that the strided reads of a tile share their cache lines */
+#define TB_TRANSPOSE_TILE 16
+
+#define TB_TRANSPOSE_KERNEL(type)\
+    do {\
+        type* src = (type*)uhs->raw;\
+        type* dst = (type*)out->raw;\
+        uint8_t more = 1;\
+        while(more){\
+            uint64_t offs[TB_TRANSPOSE_TILE], rows = 0, r, k0;\
+            do {\
+                offs[rows++] = off;\
+                more = _tb_nextRow(shape, index, &off, strides, &unused, zeros);\
+            } while(more && (step != 1) && (rows < TB_TRANSPOSE_TILE));\
+            for(k0 = 0; k0 < cols; k0 += TB_TRANSPOSE_TILE){\
+                uint64_t k1 = (cols - k0 < TB_TRANSPOSE_TILE) ? cols : k0 + TB_TRANSPOSE_TILE;\
+                for(r = 0; r < rows; r++)\
+                    for(k = k0; k < k1; k++)\
+                        dst[r*cols + k] = src[offs[r] + k*step];\
+            }\
+            dst += rows*cols;\
+        }\
+    } while(0)
+
+void _tb_transposeView(TBTransposeOperation* top, NDArray* view, NDArray* uhs){
+    uint64_t* strides = view->shape->strides;
+
+    // vectors are transposed as (1, n) matrices
+    if(uhs->shape->rank == 1){
+        strides[0] = uhs->shape->dims[0]*uhs->shape->strides[0];
+        strides[1] = uhs->shape->strides[0];
+    }
+    else{
+        memcpy(strides, uhs->shape->strides, view->shape->rank*sizeof(uint64_t));
+    }
+
+    uint64_t istride = strides[top->axis1];
+    strides[top->axis1] = strides[top->axis2];
+    strides[top->axis2] = istride;
+
+    view->raw = uhs->raw;
+}
+
+void _tb_transposeInto(TBGraphSession* sess, TBTransposeOperation* top, NDArray* out, NDArray* uhs){
+    if(uhs->sparse != NULL){
+        NDArray* u = nda_sparseToDense(uhs);
+        _tb_transposeInto(sess, top, out, u);
+        _tb_releaseUpcast(u, uhs);
+        return;
+    }
+
+    NDShape* shape = out->shape;
+    uint64_t rank = shape->rank;
+    uint64_t strides[rank], zeros[rank], index[rank];
+    memset(zeros, 0, rank*sizeof(uint64_t));
+    memset(index, 0, rank*sizeof(uint64_t));
+
+    if(uhs->shape->rank == 1){
+        strides[0] = uhs->shape->dims[0]*uhs->shape->strides[0];
+        strides[1] = uhs->shape->strides[0];
+    }
+    else{
+        memcpy(strides, uhs->shape->strides, rank*sizeof(uint64_t));
+    }
+
+    uint64_t istride = strides[top->axis1];
+    strides[top->axis1] = strides[top->axis2];
+    strides[top->axis2] = istride;
+
+    uint64_t cols = shape->dims[rank-1], step = strides[rank-1];
+    uint64_t off = 0, unused = 0, k;
+
+    // elements are moved, not converted: the output keeps the dtype of the operand
+    switch(nda_dtypeSize(uhs->dtype)){
+        case 1:
+            TB_TRANSPOSE_KERNEL(uint8_t);
+            break;
+        case 2:
+            TB_TRANSPOSE_KERNEL(uint16_t);
+            break;
+        case 4:
+            TB_TRANSPOSE_KERNEL(uint32_t);
+            break;
+        default:
+            TB_TRANSPOSE_KERNEL(uint64_t);
+            break;
+    }
+}
+
+#undef TB_TRANSPOSE_KERNEL
+#undef TB_TRANSPOSE_TILE
+
+void _tb_quantizationInto(TBGraphSession* sess, TBQuantizationOperation* qop, NDArray* out, NDArray* uhs){
+    if(qop->type == TBQOT_QUANTIZE){
+        nda_quantizeInto(out, uhs, qop->scale, qop->zero_point);
+    }
+    else {
+        nda_dequantizeInto(out, uhs);
+    }
+}
+
+uint8_t _tb_isImplemented(TBNode* node){
+    return 1;
+}
+
+/* * * * * * * * * * *
+ * BINARY OPERATIONS *
+ * * * * * * * * * * */
+
+static TBResultNode* _tb_binaryOp(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBBinaryOperationType type, TBResultNode* lhs, TBResultNode* rhs){
+    TBError* error = NULL;
+    NDShape* shape = tb_binaryOpShape(type, lhs->value->shape, rhs->value->shape, &error);
+
+    if(shape == NULL){
+        return _tb_errorResult(error, node, graph);
+    }
+
+    NDArray* arr_res = nda_allocType(shape, tb_binaryOpDType(type, lhs->value->dtype, rhs->value->dtype));
+    _tb_binaryInto(sess, type, arr_res, lhs->value, rhs->value);
+
+    return tb_newResultNode(arr_res);
+}
+
+TBResultNode* _tb_add(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* lhs, TBResultNode* rhs){
+    return _tb_binaryOp(sess, graph, node, TBBOT_ADD, lhs, rhs);
+}
+
+TBResultNode* _tb_sub(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* lhs, TBResultNode* rhs){
+    return _tb_binaryOp(sess, graph, node, TBBOT_SUB, lhs, rhs);
+}
+
+TBResultNode* _tb_div(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* lhs, TBResultNode* rhs){
+    return _tb_binaryOp(sess, graph, node, TBBOT_DIV, lhs, rhs);
+}
+
+TBResultNode* _tb_dot(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* lhs, TBResultNode* rhs){
+    return _tb_binaryOp(sess, graph, node, TBBOT_DOT, lhs, rhs);
+}
+
+TBResultNode* _tb_packedDot(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* lhs, TBResultNode* rhs, TBPackedMatrix* packed){
+    TBError* error = NULL;
+    NDShape* shape = tb_binaryOpShape(TBBOT_DOT, lhs->value->shape, rhs->value->shape, &error);
+
+    if(shape == NULL){
+        return _tb_errorResult(error, node, graph);
+    }
+
+    NDArray* arr_res = nda_alloc(shape);
+    _tb_packedDotInto(sess, arr_res, lhs->value, packed);
+
+    return tb_newResultNode(arr_res);
+}
+
+TBResultNode* _tb_mul(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* lhs, TBResultNode* rhs){
+    return _tb_binaryOp(sess, graph, node, TBBOT_MULT, lhs, rhs);
+}
+
+TBResultNode* _tb_pow(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* lhs, TBResultNode* rhs){
+    return _tb_binaryOp(sess, graph, node, TBBOT_POW, lhs, rhs);
+}
+
+/* * * * * * * * * * * * * *
+ * AXIS-BOUNDED OPERATIONS *
+ * * * * * * * * * * * * * */
+
+static TBResultNode* _tb_axisBoundOp(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBAxisBoundOperation* abop){
+    TBError* error = NULL;
+    NDShape* shape = tb_axisBoundOpShape(abop, uhs->value->shape, &error);
+
+    if(shape == NULL){
+        return _tb_errorResult(error, node, graph);
     }
-    
-    return tb_newResultNode(new_arr);
+
+    NDArray* arr_res = nda_allocType(shape, tb_axisBoundOpDType(abop, uhs->value->dtype));
+    _tb_axisBoundInto(sess, abop, arr_res, uhs->value);
+
+    return tb_newResultNode(arr_res);
+}
+
+TBResultNode* _tb_max(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBAxisBoundOperation* abop){
+    return _tb_axisBoundOp(sess, graph, node, uhs, abop);
+}
+
+TBResultNode* _tb_min(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBAxisBoundOperation* abop){
+    return _tb_axisBoundOp(sess, graph, node, uhs, abop);
+}
+
+TBResultNode* _tb_sum(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBAxisBoundOperation* abop){
+    return _tb_axisBoundOp(sess, graph, node, uhs, abop);
+}
+
+TBResultNode* _tb_mean(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBAxisBoundOperation* abop){
+    return _tb_axisBoundOp(sess, graph, node, uhs, abop);
+}
+
+TBResultNode* _tb_variance(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBAxisBoundOperation* abop){
+    return _tb_axisBoundOp(sess, graph, node, uhs, abop);
+}
+
+TBResultNode* _tb_argmax(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBAxisBoundOperation* abop){
+    return _tb_axisBoundOp(sess, graph, node, uhs, abop);
+}
+
+TBResultNode* _tb_argmin(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBAxisBoundOperation* abop){
+    return _tb_axisBoundOp(sess, graph, node, uhs, abop);
+}
+
+TBResultNode* _tb_product(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBAxisBoundOperation* abop){
+    return _tb_axisBoundOp(sess, graph, node, uhs, abop);
 }
 
 TBResultNode* _tb_softmax(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBAxisBoundOperation* abop){
-    return NULL;
+    return _tb_axisBoundOp(sess, graph, node, uhs, abop);
+}
+
+TBResultNode* _tb_crossEntropy(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* logits, TBResultNode* labels, TBCrossEntropyOperation* ceop){
+    TBError* error = NULL;
+    NDShape* shape = tb_crossEntropyOpShape(ceop, logits->value->shape, labels->value->shape, &error);
+
+    if(shape == NULL){
+        return _tb_errorResult(error, node, graph);
+    }
+
+    NDArray* arr_res = nda_alloc(shape);
+    _tb_crossEntropyInto(sess, ceop, arr_res, logits->value, labels->value);
+
+    return tb_newResultNode(arr_res);
+}
+
+TBResultNode* _tb_normalization(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBResultNode* gamma, TBResultNode* beta, TBNormalizationOperation* nop, NDArray* stats){
+    TBError* error = NULL;
+    NDArray* g = (gamma != NULL) ? gamma->value : NULL;
+    NDArray* b = (beta != NULL) ? beta->value : NULL;
+    NDShape* shape = tb_normalizationOpShape(nop, uhs->value->shape, (g != NULL) ? g->shape : NULL, (b != NULL) ? b->shape : NULL, &error);
+
+    if(shape == NULL){
+        return _tb_errorResult(error, node, graph);
+    }
+
+    NDArray* arr_res = nda_alloc(shape);
+    _tb_normalizationInto(sess, nop, arr_res, uhs->value, g, b, stats);
+
+    return tb_newResultNode(arr_res);
+}
+
+TBResultNode* _tb_convolution(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBResultNode* weights, TBConvolutionOperation* cop){
+    TBError* error = NULL;
+    NDShape* shape = tb_convolutionOpShape(cop, uhs->value->shape, weights->value->shape, &error);
+
+    if(shape == NULL){
+        return _tb_errorResult(error, node, graph);
+    }
+
+    NDArray* arr_res = nda_alloc(shape);
+    _tb_convolutionInto(sess, cop, arr_res, uhs->value, weights->value, NULL);
+
+    return tb_newResultNode(arr_res);
+}
+
+TBResultNode* _tb_pooling(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBPoolingOperation* pop, NDArray* indices){
+    TBError* error = NULL;
+    NDShape* shape = tb_poolingOpShape(pop, uhs->value->shape, &error);
+
+    if(shape == NULL){
+        return _tb_errorResult(error, node, graph);
+    }
+
+    NDArray* arr_res = nda_alloc(shape);
+    _tb_poolingInto(sess, pop, arr_res, uhs->value, indices);
+
+    return tb_newResultNode(arr_res);
+}
+
+TBResultNode* _tb_reorder(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBReorderOperation* rop){
+    TBError* error = NULL;
+    NDShape* shape = tb_reorderOpShape(rop, uhs->value->shape, &error);
+
+    if(shape == NULL){
+        return _tb_errorResult(error, node, graph);
+    }
+
+    NDArray* arr_res = nda_alloc(shape);
+    _tb_reorderInto(rop, arr_res, uhs->value);
+
+    return tb_newResultNode(arr_res);
 }
 
 /* * * * * * * * * * *
  * UNARY  OPERATIONS *
  * * * * * * * * * * */
 
-#define TB_UNARY_OP_MAP(func_name, elt_func)\
+#define TB_UNARY_OP_MAP(func_name, op_type)\
 TBResultNode* func_name(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs){\
-    NDArray* x = nda_copy(uhs->value);\
-    _td_map_array(uhs->value->data, x->data, x->shape->raw_len, elt_func);\
+    NDArray* x = nda_allocType(tb_unaryOpShape(op_type, uhs->value->shape, NULL), tb_unaryOpDType(op_type, uhs->value->dtype));\
+    _tb_unaryInto(sess, op_type, x, uhs->value);\
 \
     TBResultNode* res = tb_newResultNode(x);\
 \
     return res;\
 }
 
-TB_UNARY_OP_MAP(_tb_negative, _negative);
-TB_UNARY_OP_MAP(_tb_sin, _sin);
-TB_UNARY_OP_MAP(_tb_cos, _cos);
-TB_UNARY_OP_MAP(_tb_exp, _exp);
-TB_UNARY_OP_MAP(_tb_log, _log);
-TB_UNARY_OP_MAP(_tb_tan, _tan);
-TB_UNARY_OP_MAP(_tb_tanh, _tanh);
-TB_UNARY_OP_MAP(_tb_relu, _relu);
-TB_UNARY_OP_MAP(_tb_softplus, _softplus);
-TB_UNARY_OP_MAP(_tb_sigmoid, _sigmoid);
-TB_UNARY_OP_MAP(_tb_dxrelu, _dxrelu);
+TB_UNARY_OP_MAP(_tb_negative, TBUOT_MINUS);
+TB_UNARY_OP_MAP(_tb_sin, TBUOT_SIN);
+TB_UNARY_OP_MAP(_tb_cos, TBUOT_COS);
+TB_UNARY_OP_MAP(_tb_exp, TBUOT_EXP);
+TB_UNARY_OP_MAP(_tb_log, TBUOT_LOG);
+TB_UNARY_OP_MAP(_tb_tan, TBUOT_TAN);
+TB_UNARY_OP_MAP(_tb_tanh, TBUOT_TANH);
+TB_UNARY_OP_MAP(_tb_relu, TBUOT_RELU);
+TB_UNARY_OP_MAP(_tb_softplus, TBUOT_SOFTPLUS);
+TB_UNARY_OP_MAP(_tb_sigmoid, TBUOT_SIGMOID);
+TB_UNARY_OP_MAP(_tb_dxrelu, TBUOT_DXRELU);
 
 TBResultNode* _tb_transpose(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBTransposeOperation* top){
     NDArray* arr = uhs->value;
+
+    // sparse matrices are transposed in CSR, the result is sparse as well
+    if(arr->sparse != NULL){
+        return tb_newResultNode(nda_sparseTranspose(arr));
+    }
+
     NDArray* arr_res = nda_copy(arr);
     NDShape* shape = arr_res->shape;
     if(shape->rank == 1){
@@ -979,17 +3568,53 @@ TBResultNode* _tb_transpose(TBGraphSession* sess, TBGraph* graph, TBNode* node,
         // TODO: free shape
         //return tb_newResultNode(arr_res);
     }
-    
+
     shape = arr_res->shape;
-    
+
     uint64_t idim = shape->dims[top->axis1];
     shape->dims[top->axis1] = shape->dims[top->axis2];
     shape->dims[top->axis2] = idim;
-    
+
     idim = shape->strides[top->axis1];
     shape->strides[top->axis1] = shape->strides[top->axis2];
     shape->strides[top->axis2] = idim;
-    
+
+    // per-channel quantization follows its axis
+    NDQuantParams* quant = arr_res->quant;
+    if((quant != NULL) && (quant->count > 1)){
+        quant->axis += (arr->shape->rank == 1);
+        quant->axis = (quant->axis == top->axis1) ? top->axis2 : ((quant->axis == top->axis2) ? top->axis1 : quant->axis);
+    }
+
+    return tb_newResultNode(arr_res);
+}
+
+TBResultNode* _tb_quantization(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* uhs, TBQuantizationOperation* qop){
+    NDShape* shape = tb_quantizationOpShape(qop, uhs->value->shape, NULL);
+    NDArray* arr_res = nda_allocType(shape, tb_quantizationOpDType(qop, uhs->value->dtype));
+
+    if(qop->type == TBQOT_QUANTIZE){
+        arr_res->quant = nda_newQuantParams(1, 0, qop->zero_point);
+        arr_res->quant->scales[0] = qop->scale;
+    }
+
+    _tb_quantizationInto(sess, qop, arr_res, uhs->value);
+
+    return tb_newResultNode(arr_res);
+}
+
+TBResultNode* _tb_gather(TBGraphSession* sess, TBGraph* graph, TBNode* node, TBResultNode* table, TBResultNode* indices, TBGatherOperation* gop){
+    TBError* error = NULL;
+    NDShape* shape = tb_gatherOpShape(gop, table->value->shape, indices->value->shape, &error);
+
+    if(shape == NULL){
+        return _tb_errorResult(error, node, graph);
+    }
+
+    NDArray* arr_res = nda_allocType(shape, tb_gatherOpDType(gop, table->value->dtype));
+    arr_res->quant = _tb_gatherQuant(table->value->quant, indices->value->shape->rank);
+    _tb_gatherInto(sess, gop, arr_res, table->value, indices->value);
+
     return tb_newResultNode(arr_res);
 }
 
@@ -0,0 +1,204 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file tb_pool.c
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing the worker threads of the parallel kernels.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include <tb_pool.h>
+
+typedef struct _TBPoolWorker{
+    struct TBThreadPool* pool;
+    uint64_t index;                /**< Task run by the worker, 1 for the first worker */
+    uint64_t seen;                 /**< Last batch of tasks seen by the worker */
+    pthread_t thread;
+}_TBPoolWorker;
+
+struct TBThreadPool{
+    pthread_mutex_t busy;          /**< Held by the caller running tasks on the pool */
+    pthread_mutex_t lock;          /**< Protects the batch and the counters */
+    pthread_cond_t wake;           /**< Signaled when a batch is posted or the pool stops */
+    pthread_cond_t done;           /**< Signaled when the last task of a batch is done */
+    
+    _TBPoolWorker** workers;       /**< Workers, each one allocated separately */
+    uint64_t workers_len;          /**< Number of workers */
+    
+    uint64_t batch;                /**< Number of batches posted */
+    uint64_t tasks_len;            /**< Number of tasks of the current batch */
+    uint64_t pending;              /**< Tasks of the current batch not done by the workers */
+    void* (*worker)(void*);        /**< Function of the current batch */
+    char* tasks;                   /**< Tasks of the current batch */
+    uint64_t task_size;            /**< Size of a task */
+    uint8_t stop;                  /**< Boolean flag, true when the workers must exit */
+};
+
+static TBThreadPool* _tb_defaultPool = NULL;
+static pthread_once_t _tb_defaultPoolOnce = PTHREAD_ONCE_INIT;
+
+static void* _tb_poolWorkerLoop(void* arg){
+    _TBPoolWorker* self = (_TBPoolWorker*)arg;
+    TBThreadPool* pool = self->pool;
+    
+    pthread_mutex_lock(&pool->lock);
+    
+    while(1){
+        while(!pool->stop && (pool->batch == self->seen))
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        
+        if(pool->stop)
+            break;
+        
+        self->seen = pool->batch;
+        
+        // workers beyond the tasks of the batch sit it out
+        if(self->index >= pool->tasks_len)
+            continue;
+        
+        void* task = pool->tasks + self->index*pool->task_size;
+        void* (*worker)(void*) = pool->worker;
+        
+        pthread_mutex_unlock(&pool->lock);
+        worker(task);
+        pthread_mutex_lock(&pool->lock);
+        
+        if(--pool->pending == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    
+    pthread_mutex_unlock(&pool->lock);
+    
+    return NULL;
+}
+
+TBThreadPool* tb_newThreadPool(void){
+    TBThreadPool* pool = calloc(1, sizeof(TBThreadPool));
+    
+    pthread_mutex_init(&pool->busy, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    
+    return pool;
+}
+
+static void _tb_createDefaultPool(void){
+    _tb_defaultPool = tb_newThreadPool();
+}
+
+TBThreadPool* tb_defaultThreadPool(void){
+    pthread_once(&_tb_defaultPoolOnce, _tb_createDefaultPool);
+    
+    return _tb_defaultPool;
+}
+
+void tb_poolRun(TBThreadPool* pool, uint64_t n, void* (*worker)(void*), void* tasks, uint64_t task_size){
+    uint64_t i = 0;
+    
+    if(pool == NULL)
+        pool = tb_defaultThreadPool();
+    
+    if((n <= 1) || (pthread_mutex_trylock(&pool->busy) != 0)){
+        for(; i < n; i++)
+            worker((char*)tasks + i*task_size);
+        return;
+    }
+    
+    pthread_mutex_lock(&pool->lock);
+    
+    // new workers start with the current batch as seen, the batch posted below is their first one
+    if(pool->workers_len < n - 1){
+        pool->workers = realloc(pool->workers, (n - 1)*sizeof(_TBPoolWorker*));
+        
+        for(i = pool->workers_len; i < n - 1; i++){
+            _TBPoolWorker* w = calloc(1, sizeof(_TBPoolWorker));
+            w->pool = pool;
+            w->index = i + 1;
+            w->seen = pool->batch;
+            pthread_create(&w->thread, NULL, _tb_poolWorkerLoop, w);
+            pool->workers[i] = w;
+        }
+        
+        pool->workers_len = n - 1;
+    }
+    
+    pool->batch++;
+    pool->tasks_len = n;
+    pool->pending = n - 1;
+    pool->worker = worker;
+    pool->tasks = (char*)tasks;
+    pool->task_size = task_size;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    
+    worker(tasks);
+    
+    pthread_mutex_lock(&pool->lock);
+    while(pool->pending > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+    
+    pthread_mutex_unlock(&pool->busy);
+}
+
+void tb_freeThreadPool(TBThreadPool* pool){
+    uint64_t i = 0;
+    
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    
+    for(; i < pool->workers_len; i++){
+        pthread_join(pool->workers[i]->thread, NULL);
+        free(pool->workers[i]);
+    }
+    
+    pthread_cond_destroy(&pool->wake);
+    pthread_cond_destroy(&pool->done);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_mutex_destroy(&pool->busy);
+    free(pool->workers);
+    free(pool);
+}
@@ -0,0 +1,276 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file tb_profiler.c
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing the per-node execution profiler of CPU sessions.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+#include <pthread.h>
+
+#include <tb_graph.h>
+#include <tb_operation.h>
+#include <tb_session_cpu.h>
+#include <tb_profiler.h>
+#include <tb_cost.h>
+
+#include <ndarray.h>
+#include <ndarray_std.h>
+
+/* Operand time accumulated by the node being timed on this thread */
+static __thread uint64_t _tb_profileChildren = 0;
+
+/* Profiler id of this thread, 0 until assigned */
+static __thread uint64_t _tb_profileTid = 0;
+static uint64_t _tb_profileThreads = 0;
+
+static inline uint64_t _tb_profileNow(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    
+    return (uint64_t)t.tv_sec*1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+void tb_sessionSetProfiling(TBGraphSession* session, uint8_t enabled){
+    if(session->profiler != NULL){
+        _tb_freeProfiler(session->profiler);
+        session->profiler = NULL;
+    }
+    
+    if(enabled){
+        TBProfiler* profiler = calloc(1, sizeof(TBProfiler));
+        pthread_mutex_init(&profiler->lock, NULL);
+        profiler->origin = _tb_profileNow();
+        
+        session->profiler = profiler;
+    }
+}
+
+TBProfiler* tb_sessionGetProfiler(TBGraphSession* session){
+    return session->profiler;
+}
+
+void tb_profilerClear(TBProfiler* profiler){
+    pthread_mutex_lock(&profiler->lock);
+    profiler->events_len = 0;
+    profiler->origin = _tb_profileNow();
+    pthread_mutex_unlock(&profiler->lock);
+}
+
+void _tb_freeProfiler(TBProfiler* profiler){
+    pthread_mutex_destroy(&profiler->lock);
+    free(profiler->events);
+    free(profiler);
+}
+
+void _tb_profileBegin(TBProfileScope* scope){
+    scope->children = _tb_profileChildren;
+    _tb_profileChildren = 0;
+    scope->start = _tb_profileNow();
+}
+
+void _tb_profileEnd(TBProfiler* profiler, TBProfileScope* scope, TBNode* node, struct NDArray* out,
+                    struct NDArray* lhs, struct NDArray* rhs, uint64_t bytes, uint8_t prepared){
+    uint64_t end = _tb_profileNow();
+    uint64_t duration = end - scope->start;
+    uint64_t self = (duration > _tb_profileChildren) ? duration - _tb_profileChildren : 0;
+    uint64_t i;
+    
+    // the enclosing node sees this one as operand time
+    _tb_profileChildren = scope->children + duration;
+    
+    if(_tb_profileTid == 0){
+        _tb_profileTid = __atomic_add_fetch(&_tb_profileThreads, 1, __ATOMIC_RELAXED);
+    }
+    
+    TBProfileEvent event;
+    event.op = tb_nodeOpName(node);
+    event.type = node->type;
+    event.node_id = node->id;
+    event.tid = _tb_profileTid - 1;
+    event.duration = duration;
+    event.self = self;
+    event.flops = (out != NULL) ? tb_nodeFlops(node, out->shape, (lhs != NULL) ? lhs->shape : NULL, (rhs != NULL) ? rhs->shape : NULL) : 0;
+    event.bytes = bytes;
+    event.rank = (out != NULL) ? out->shape->rank : 0;
+    for(i = 0; (i < event.rank) && (i < TB_PROFILE_MAX_RANK); i++)
+        event.dims[i] = out->shape->dims[i];
+    event.prepared = prepared;
+    
+    pthread_mutex_lock(&profiler->lock);
+    
+    event.start = (scope->start > profiler->origin) ? scope->start - profiler->origin : 0;
+    
+    if(profiler->events_len == profiler->events_cap){
+        profiler->events_cap = (profiler->events_cap == 0) ? 256 : profiler->events_cap*2;
+        profiler->events = realloc(profiler->events, profiler->events_cap*sizeof(TBProfileEvent));
+    }
+    profiler->events[profiler->events_len++] = event;
+    
+    pthread_mutex_unlock(&profiler->lock);
+}
+
+static void _tb_profileShape(TBProfileEvent* event, char* buffer, size_t size){
+    size_t len = snprintf(buffer, size, "[");
+    uint64_t i;
+    
+    for(i = 0; (i < event->rank) && (i < TB_PROFILE_MAX_RANK) && (len < size); i++)
+        len += snprintf(buffer + len, size - len, (i == 0) ? "%" PRIu64 : ", %" PRIu64, event->dims[i]);
+    if(len < size)
+        snprintf(buffer + len, size - len, (event->rank > TB_PROFILE_MAX_RANK) ? ", ...]" : "]");
+}
+
+void tb_profilerWriteTrace(TBProfiler* profiler, FILE* out){
+    char shape[128];
+    uint64_t i;
+    
+    pthread_mutex_lock(&profiler->lock);
+    
+    fprintf(out, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    for(i = 0; i < profiler->events_len; i++){
+        TBProfileEvent* e = profiler->events + i;
+        _tb_profileShape(e, shape, sizeof(shape));
+        
+        fprintf(out, "{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 0, \"tid\": %" PRIu64 ", "
+                     "\"args\": {\"node\": %" PRIu64 ", \"shape\": \"%s\", \"self_us\": %.3f, \"flops\": %" PRIu64 ", \"bytes\": %" PRIu64 "}}%s\n",
+                e->op, e->prepared ? "prepared" : "session", e->start/1e3, e->duration/1e3, e->tid,
+                e->node_id, shape, e->self/1e3, e->flops, e->bytes, (i + 1 < profiler->events_len) ? "," : "");
+    }
+    fprintf(out, "]}\n");
+    
+    pthread_mutex_unlock(&profiler->lock);
+}
+
+/*
+ * Events of a node, or of an operation when node_id is TB_NO_ID
+ */
+typedef struct _TBProfileTotal {
+    TBProfileEvent* first;         /**< First event, for the name and shape */
+    uint64_t node_id;
+    uint64_t calls;
+    uint64_t self;
+    uint64_t flops;
+    uint64_t bytes;
+}_TBProfileTotal;
+
+static int _tb_compareTotals(const void* a, const void* b){
+    uint64_t x = ((const _TBProfileTotal*)a)->self, y = ((const _TBProfileTotal*)b)->self;
+    
+    return (x < y) - (x > y);
+}
+
+/*
+ * Sums the events per key, node ids (and shapes, a node can be run on several shapes) or operation names.
+ */
+static uint64_t _tb_profileTotals(TBProfiler* profiler, uint8_t byNode, _TBProfileTotal* totals){
+    uint64_t count = 0, i, j;
+    
+    for(i = 0; i < profiler->events_len; i++){
+        TBProfileEvent* e = profiler->events + i;
+        
+        for(j = 0; j < count; j++){
+            TBProfileEvent* f = totals[j].first;
+            if(byNode ? ((f->node_id == e->node_id) && (f->op == e->op) && (f->rank == e->rank) &&
+                         (memcmp(f->dims, e->dims, sizeof(uint64_t)*((e->rank < TB_PROFILE_MAX_RANK) ? e->rank : TB_PROFILE_MAX_RANK)) == 0))
+                      : (strcmp(f->op, e->op) == 0))
+                break;
+        }
+        
+        if(j == count){
+            memset(totals + count, 0, sizeof(_TBProfileTotal));
+            totals[count].first = e;
+            totals[count].node_id = byNode ? e->node_id : TB_NO_ID;
+            count++;
+        }
+        
+        totals[j].calls++;
+        totals[j].self += e->self;
+        totals[j].flops += e->flops;
+        totals[j].bytes += e->bytes;
+    }
+    
+    qsort(totals, count, sizeof(_TBProfileTotal), _tb_compareTotals);
+    
+    return count;
+}
+
+void tb_profilerWriteSummary(TBProfiler* profiler, FILE* out, uint64_t top){
+    char shape[128];
+    uint64_t total = 0, count, i;
+    
+    pthread_mutex_lock(&profiler->lock);
+    
+    _TBProfileTotal* totals = calloc(profiler->events_len + 1, sizeof(_TBProfileTotal));
+    for(i = 0; i < profiler->events_len; i++)
+        total += profiler->events[i].self;
+    
+    fprintf(out, "Profile: %" PRIu64 " node evaluations, %.3f ms\n\n", profiler->events_len, total/1e6);
+    
+    count = _tb_profileTotals(profiler, 1, totals);
+    fprintf(out, "%10s %7s %7s %11s %9s %11s %6s  %-16s %s\n", "self ms", "%", "calls", "avg us", "GFLOP/s", "alloc KB", "node", "op", "shape");
+    for(i = 0; i < count && ((top == 0) || (i < top)); i++){
+        _TBProfileTotal* t = totals + i;
+        _tb_profileShape(t->first, shape, sizeof(shape));
+        
+        fprintf(out, "%10.3f %6.2f%% %7" PRIu64 " %11.3f %9.2f %11.1f %6" PRIu64 "  %-16s %s\n",
+                t->self/1e6, total ? 100.0*t->self/total : 0, t->calls, t->self/1e3/t->calls,
+                t->self ? (double)t->flops/t->self : 0, t->bytes/1024.0, t->node_id, t->first->op, shape);
+    }
+    
+    count = _tb_profileTotals(profiler, 0, totals);
+    fprintf(out, "\n%10s %7s %7s %11s %9s %11s  %s\n", "self ms", "%", "calls", "avg us", "GFLOP/s", "alloc KB", "op");
+    for(i = 0; i < count; i++){
+        _TBProfileTotal* t = totals + i;
+        
+        fprintf(out, "%10.3f %6.2f%% %7" PRIu64 " %11.3f %9.2f %11.1f  %s\n",
+                t->self/1e6, total ? 100.0*t->self/total : 0, t->calls, t->self/1e3/t->calls,
+                t->self ? (double)t->flops/t->self : 0, t->bytes/1024.0, t->first->op);
+    }
+    
+    free(totals);
+    
+    pthread_mutex_unlock(&profiler->lock);
+}
@@ -0,0 +1,333 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file tb_quantize.c
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing the post-training INT8 quantization of graphs.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+
+#include <ndarray.h>
+#include <ndarray_std.h>
+
+#include <tb_graph.h>
+#include <tb_factory.h>
+#include <tb_operation.h>
+#include <tb_session.h>
+#include <tb_quantize.h>
+
+struct TBCalibrator {
+    TBGraph* graph;                /**< Calibrated graph */
+    uint64_t len;                  /**< Number of nodes of the graph */
+    float* min;                    /**< Minimum observed value of each node, indexed by node id */
+    float* max;                    /**< Maximum observed value of each node, indexed by node id */
+    uint8_t* observed;             /**< Boolean flag set once a node has been observed */
+};
+
+/*
+ * Memoized rewrite, indexed by the ids of the calibrated graph nodes
+ */
+typedef struct TBQuantizer {
+    TBCalibrator* cal;
+    TBNode** clones;               /**< Copy of each node */
+    TBNode** quantized;            /**< QUANTIZE node of each DOT LHS */
+}TBQuantizer;
+
+TBCalibrator* tb_newCalibrator(TBGraph* graph){
+    tb_compileGraph(graph);
+    
+    TBCalibrator* cal = calloc(1, sizeof(TBCalibrator));
+    cal->graph = graph;
+    cal->len = graph->nodes.length;
+    cal->min = calloc(cal->len, sizeof(float));
+    cal->max = calloc(cal->len, sizeof(float));
+    cal->observed = calloc(cal->len, sizeof(uint8_t));
+    
+    return cal;
+}
+
+void tb_calibratorObserve(TBCalibrator* cal, struct TBGraphSession* session){
+    uint64_t i = 0;
+    
+    for(; i < cal->len; i++){
+        TBResultNode* res = tb_sessionGetResult(session, cal->graph, cal->graph->nodes.data[i]);
+        
+        if((res == NULL) || (res->value == NULL) || (res->value->quant != NULL))
+            continue;
+        
+        // results are dense copies, the order of the elements does not matter
+        NDArray* value = res->value;
+        float min = cal->observed[i] ? cal->min[i] : FLT_MAX;
+        float max = cal->observed[i] ? cal->max[i] : -FLT_MAX;
+        uint64_t j = 0;
+        
+        for(; j < value->shape->raw_len; j++){
+            float x = (float)nda_rawGet(value, j);
+            min = (x < min) ? x : min;
+            max = (x > max) ? x : max;
+        }
+        
+        cal->min[i] = min;
+        cal->max[i] = max;
+        cal->observed[i] = 1;
+    }
+}
+
+uint8_t tb_calibratorRange(TBCalibrator* cal, TBNode* node, float* min, float* max){
+    if(!tb_graphOwnsNode(cal->graph, node) || (node->id >= cal->len) || !cal->observed[node->id])
+        return 0;
+    
+    *min = cal->min[node->id];
+    *max = cal->max[node->id];
+    
+    return 1;
+}
+
+/*
+ * Constant tb_float matrix feeding a DOT, either directly or through a variable bound to a constant.
+ */
+static NDArray* _tb_constantWeights(TBGraph* graph, TBNode* node){
+    if(node->type == TBNT_VARIABLE){
+        uint64_t slot = tb_graphVarNodeSlot(graph, node);
+        
+        if((slot == TB_NO_SLOT) || (graph->slots.data[slot] == graph->feeds.data[slot]))
+            return NULL;
+        
+        node = graph->slots.data[slot];
+    }
+    
+    if((node == NULL) || (node->type != TBNT_CONSTANT))
+        return NULL;
+    
+    NDArray* w = ((TBConstant*)node->nodePtr)->value;
+    
+    if((w->dtype != NDA_DTYPE_FLOAT) || (w->quant != NULL) || (w->shape->rank != 2))
+        return NULL;
+    
+    return w;
+}
+
+/*
+ * Quantizes a (K, N) matrix per output column. The result is stored as a (N, K) row-major matrix exposed
+ * through a (K, N) view, the layout read in place by the quantized DOT kernel.
+ */
+static NDArray* _tb_quantizeWeights(NDArray* w){
+    uint64_t K = w->shape->dims[0];
+    uint64_t N = w->shape->dims[1];
+    
+    NDArray view;
+    memset(&view, 0, sizeof(NDArray));
+    view.raw = w->raw;
+    view.dtype = w->dtype;
+    view.shape = nda_newShape(2, N, K);
+    view.shape->strides[0] = w->shape->strides[1];
+    view.shape->strides[1] = w->shape->strides[0];
+    
+    NDArray* q = nda_quantizePerChannel(&view, 0);
+    
+    free(view.shape->dims);
+    free(view.shape->strides);
+    free(view.shape);
+    
+    q->shape->dims[0] = K;
+    q->shape->dims[1] = N;
+    q->shape->strides[0] = 1;
+    q->shape->strides[1] = K;
+    q->quant->axis = 1;
+    
+    return q;
+}
+
+static TBNode* _tb_quantizeNode(TBQuantizer* q, TBNode* node);
+
+static TBNode* _tb_quantizedLHS(TBQuantizer* q, TBNode* node){
+    TBCalibrator* cal = q->cal;
+    
+    if(q->quantized[node->id] == NULL){
+        float scale;
+        int32_t zero_point;
+        nda_chooseQuantParams(cal->min[node->id], cal->max[node->id], NDA_DTYPE_U8, &scale, &zero_point);
+        
+        q->quantized[node->id] = tb_newQuantizeOpNode(_tb_quantizeNode(q, node), NDA_DTYPE_U8, scale, zero_point);
+    }
+    
+    return q->quantized[node->id];
+}
+
+static TBNode* _tb_quantizeNode(TBQuantizer* q, TBNode* node){
+    TBCalibrator* cal = q->cal;
+    TBGraph* graph = cal->graph;
+    
+    // nodes out of the graph (i.e nested graph internals) are shared
+    if(!tb_graphOwnsNode(graph, node) || (node->id >= cal->len))
+        return node;
+    
+    if(q->clones[node->id] != NULL)
+        return q->clones[node->id];
+    
+    TBNode* clone = NULL;
+    
+    switch(node->type){
+        case TBNT_VARIABLE:
+            clone = tb_newVarNode(((TBVariable*)node->nodePtr)->name);
+            break;
+        case TBNT_CONSTANT:
+            clone = tb_newBorrowedConstantNode(((TBConstant*)node->nodePtr)->value);
+            break;
+        case TBNT_GRAPH:
+            clone = node;
+            break;
+        case TBNT_BINARY_OPERATION:{
+            TBBinaryOperation* bop = (TBBinaryOperation*)node->nodePtr;
+            NDArray* w = (bop->type == TBBOT_DOT) ? _tb_constantWeights(graph, bop->rhs) : NULL;
+            
+            if((w != NULL) && tb_graphOwnsNode(graph, bop->lhs) && cal->observed[bop->lhs->id]){
+                clone = tb_newBinaryOpNode(TBBOT_DOT, _tb_quantizedLHS(q, bop->lhs), tb_newConstantNode(_tb_quantizeWeights(w)));
+            }
+            else {
+                clone = tb_newBinaryOpNode(bop->type, _tb_quantizeNode(q, bop->lhs), _tb_quantizeNode(q, bop->rhs));
+            }
+            break;
+        }
+        case TBNT_UNARY_OPERATION:{
+            TBUnaryOperation* uop = (TBUnaryOperation*)node->nodePtr;
+            clone = tb_newUnaryOpNode(uop->type, _tb_quantizeNode(q, uop->uhs));
+            break;
+        }
+        case TBNT_AXIS_BOUND_OPERATION:{
+            TBAxisBoundOperation* abop = (TBAxisBoundOperation*)node->nodePtr;
+            clone = tb_newAxisBoundOpNode(abop->type, _tb_quantizeNode(q, abop->uhs), abop->axis);
+            break;
+        }
+        case TBNT_AXES_TRANSPOSE:{
+            TBTransposeOperation* top = (TBTransposeOperation*)node->nodePtr;
+            clone = tb_newTransposeOpNode(_tb_quantizeNode(q, top->uhs), top->axis1, top->axis2);
+            break;
+        }
+        case TBNT_QUANTIZATION:{
+            TBQuantizationOperation* qop = (TBQuantizationOperation*)node->nodePtr;
+            clone = (qop->type == TBQOT_QUANTIZE) ?
+                    tb_newQuantizeOpNode(_tb_quantizeNode(q, qop->uhs), qop->dtype, qop->scale, qop->zero_point) :
+                    tb_newDequantizeOpNode(_tb_quantizeNode(q, qop->uhs));
+            break;
+        }
+        case TBNT_GATHER:{
+            TBGatherOperation* gop = (TBGatherOperation*)node->nodePtr;
+            clone = tb_newGatherOpNode(_tb_quantizeNode(q, gop->table), _tb_quantizeNode(q, gop->indices));
+            break;
+        }
+        case TBNT_CROSS_ENTROPY:{
+            TBCrossEntropyOperation* ceop = (TBCrossEntropyOperation*)node->nodePtr;
+            clone = tb_newCrossEntropyOpNode(_tb_quantizeNode(q, ceop->logits), _tb_quantizeNode(q, ceop->labels), ceop->axis);
+            break;
+        }
+        case TBNT_NORMALIZATION:{
+            TBNormalizationOperation* nop = (TBNormalizationOperation*)node->nodePtr;
+            clone = tb_newNormalizationOpNode(nop->type, _tb_quantizeNode(q, nop->uhs),
+                                              (nop->gamma != NULL) ? _tb_quantizeNode(q, nop->gamma) : NULL,
+                                              (nop->beta != NULL) ? _tb_quantizeNode(q, nop->beta) : NULL,
+                                              nop->axis, nop->epsilon);
+            break;
+        }
+        case TBNT_CONVOLUTION:{
+            TBConvolutionOperation* cop = (TBConvolutionOperation*)node->nodePtr;
+            clone = tb_newConvolutionOpNode(_tb_quantizeNode(q, cop->uhs), _tb_quantizeNode(q, cop->weights), cop->layout,
+                                            cop->stride[0], cop->stride[1], cop->padding[0], cop->padding[1],
+                                            cop->dilation[0], cop->dilation[1], cop->groups);
+            ((TBConvolutionOperation*)clone->nodePtr)->algorithm = cop->algorithm;
+            break;
+        }
+        case TBNT_POOLING:{
+            TBPoolingOperation* pop = (TBPoolingOperation*)node->nodePtr;
+            clone = tb_newPoolingOpNode(pop->type, _tb_quantizeNode(q, pop->uhs), pop->layout, pop->window[0], pop->window[1],
+                                        pop->stride[0], pop->stride[1], pop->padding[0], pop->padding[1]);
+            break;
+        }
+        case TBNT_REORDER:{
+            TBReorderOperation* rop = (TBReorderOperation*)node->nodePtr;
+            clone = tb_newReorderOpNode(_tb_quantizeNode(q, rop->uhs), rop->from, rop->to, rop->block);
+            break;
+        }
+    }
+    
+    clone->calc_grad = node->calc_grad;
+    q->clones[node->id] = clone;
+    
+    return clone;
+}
+
+TBGraph* tb_quantizeGraph(TBCalibrator* cal, char* name){
+    TBGraph* graph = cal->graph;
+    
+    TBQuantizer q;
+    q.cal = cal;
+    q.clones = calloc(cal->len, sizeof(TBNode*));
+    q.quantized = calloc(cal->len, sizeof(TBNode*));
+    
+    TBGraph* res = tb_newGraph(name, _tb_quantizeNode(&q, graph->root));
+    res->base = graph;
+    
+    // bindings are shared, fed slots are left to the caller
+    const char* var_name;
+    map_iter_t iter = map_iter(&graph->slot_ids);
+    while((var_name = map_next(&graph->slot_ids, &iter))){
+        uint64_t slot = *map_get(&graph->slot_ids, var_name);
+        TBNode* bound = graph->slots.data[slot];
+        
+        if((bound != NULL) && (bound != graph->feeds.data[slot]))
+            tb_graphSetVar(res, bound, var_name);
+    }
+    
+    free(q.clones);
+    free(q.quantized);
+    
+    return res;
+}
+
+void tb_freeCalibrator(TBCalibrator* cal){
+    free(cal->min);
+    free(cal->max);
+    free(cal->observed);
+    free(cal);
+}
@@ -0,0 +1,844 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file tb_serialize.c
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing the binary serialization of graphs.
+ *
+ * The structure is a sequence of uint64 words and length prefixed strings, in host byte order:
+ *
+ *  graph   := name node_count node* root binding_count (name node_index)*
+ *  node    := type calc_grad payload
+ *  payload := name                                   (variable)
+ *           | tensor_index                           (constant)
+ *           | graph param_count (name node_index)*   (nested graph)
+ *           | op lhs rhs                             (binary)
+ *           | op uhs                                 (unary)
+ *           | op uhs axis                            (axis bound)
+ *           | uhs axis1 axis2                        (transpose)
+ *
+ * Node indices refer to previously written nodes of the same graph.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <ndarray.h>
+#include <ndarray_std.h>
+#include <ndarray_io.h>
+
+#include <tb_graph.h>
+#include <tb_factory.h>
+#include <tb_operation.h>
+#include <tb_serialize.h>
+
+/**
+ * \brief On disk header, 64 bytes long
+ */
+typedef struct TBGraphFileHeader {
+    char magic[8];              /**< TB_GRAPH_MAGIC */
+    uint32_t version;           /**< TB_GRAPH_VERSION */
+    uint32_t reserved;          /**< Always 0 */
+    uint64_t structure_len;     /**< Size in bytes of the structure following the header */
+    uint64_t archive_offset;    /**< Offset of the tensor archive, multiple of TB_GRAPH_ARCHIVE_ALIGN */
+    uint8_t padding[32];        /**< Pads the header to 64 bytes */
+}TBGraphFileHeader;
+
+/**
+ * \brief Growable output buffer and the constants collected while writing
+ */
+typedef struct TBGraphWriter {
+    uint8_t* data;          /**< Structure */
+    uint64_t len;           /**< Used bytes */
+    uint64_t cap;           /**< Allocated bytes */
+    TBNode_Vec tensors;     /**< Constant tensors, in the order they are referenced */
+}TBGraphWriter;
+
+/**
+ * \brief Bounded input cursor, and everything allocated while loading in case it has to be undone
+ */
+typedef struct TBGraphReader {
+    uint8_t* data;          /**< Structure */
+    uint64_t len;           /**< Size of the structure */
+    uint64_t pos;           /**< Cursor */
+    uint8_t ok;             /**< Cleared on the first malformed read */
+    NDArchive* archive;     /**< Constant tensors */
+    TBNode_Vec nodes;       /**< Every node created */
+    TBNode_Vec graphs;      /**< Every graph created */
+}TBGraphReader;
+
+/* * * * * *
+ * Writing *
+ * * * * * */
+
+static void _tb_writeBytes(TBGraphWriter* w, const void* bytes, uint64_t len){
+    if(w->len + len > w->cap){
+        while(w->len + len > w->cap){
+            w->cap = w->cap == 0 ? 256 : w->cap*2;
+        }
+        w->data = realloc(w->data, w->cap);
+    }
+    
+    memcpy(w->data + w->len, bytes, len);
+    w->len += len;
+}
+
+static void _tb_writeU64(TBGraphWriter* w, uint64_t value){
+    _tb_writeBytes(w, &value, sizeof(uint64_t));
+}
+
+static void _tb_writeString(TBGraphWriter* w, const char* str){
+    uint64_t len = strlen(str);
+    _tb_writeU64(w, len);
+    _tb_writeBytes(w, str, len);
+}
+
+static uint64_t _tb_writeIndex(TBNode_Vec* order, TBNode* node){
+    int idx = -1;
+    vec_find(order, node, idx);
+    
+    ASSERT(idx != -1, "Node is not ordered before its parent");
+    
+    return (uint64_t)idx;
+}
+
+static uint8_t _tb_isExcluded(TBNode_Vec* exclude, TBNode* node){
+    int idx = -1;
+    
+    if(exclude != NULL){
+        vec_find(exclude, node, idx);
+    }
+    
+    return idx != -1;
+}
+
+/*
+ * Post order traversal, every node comes after the nodes it references.
+ */
+static void _tb_orderNodes(TBNode_Vec* order, TBNode* node){
+    int idx = -1;
+    vec_find(order, node, idx);
+    
+    if(idx != -1)
+        return;
+    
+    switch(node->type){
+        case TBNT_VARIABLE:
+        case TBNT_CONSTANT:
+            break;
+        case TBNT_GRAPH:{
+            TBGraphNodeParam** params = ((TBGraphNode*)node->nodePtr)->params;
+            uint64_t i = 0;
+            
+            while(params != NULL && params[i]->node != NULL && params[i]->var_name != NULL){
+                _tb_orderNodes(order, params[i]->node);
+                i++;
+            }
+            break;
+        }
+        case TBNT_BINARY_OPERATION:
+            _tb_orderNodes(order, ((TBBinaryOperation*)node->nodePtr)->lhs);
+            _tb_orderNodes(order, ((TBBinaryOperation*)node->nodePtr)->rhs);
+            break;
+        case TBNT_UNARY_OPERATION:
+            _tb_orderNodes(order, ((TBUnaryOperation*)node->nodePtr)->uhs);
+            break;
+        case TBNT_AXIS_BOUND_OPERATION:
+            _tb_orderNodes(order, ((TBAxisBoundOperation*)node->nodePtr)->uhs);
+            break;
+        case TBNT_AXES_TRANSPOSE:
+            _tb_orderNodes(order, ((TBTransposeOperation*)node->nodePtr)->uhs);
+            break;
+        case TBNT_QUANTIZATION:
+            _tb_orderNodes(order, ((TBQuantizationOperation*)node->nodePtr)->uhs);
+            break;
+        case TBNT_GATHER:
+            _tb_orderNodes(order, ((TBGatherOperation*)node->nodePtr)->table);
+            _tb_orderNodes(order, ((TBGatherOperation*)node->nodePtr)->indices);
+            break;
+        case TBNT_CROSS_ENTROPY:
+            _tb_orderNodes(order, ((TBCrossEntropyOperation*)node->nodePtr)->logits);
+            _tb_orderNodes(order, ((TBCrossEntropyOperation*)node->nodePtr)->labels);
+            break;
+        case TBNT_NORMALIZATION:{
+            TBNormalizationOperation* nop = (TBNormalizationOperation*)node->nodePtr;
+            _tb_orderNodes(order, nop->uhs);
+            if(nop->gamma != NULL)
+                _tb_orderNodes(order, nop->gamma);
+            if(nop->beta != NULL)
+                _tb_orderNodes(order, nop->beta);
+            break;
+        }
+        case TBNT_CONVOLUTION:
+            _tb_orderNodes(order, ((TBConvolutionOperation*)node->nodePtr)->uhs);
+            _tb_orderNodes(order, ((TBConvolutionOperation*)node->nodePtr)->weights);
+            break;
+        case TBNT_POOLING:
+            _tb_orderNodes(order, ((TBPoolingOperation*)node->nodePtr)->uhs);
+            break;
+        case TBNT_REORDER:
+            _tb_orderNodes(order, ((TBReorderOperation*)node->nodePtr)->uhs);
+            break;
+    }
+    
+    vec_push(order, node);
+}
+
+static void _tb_writeGraph(TBGraphWriter* w, TBGraph* graph, TBNode_Vec* exclude);
+
+static void _tb_writeNode(TBGraphWriter* w, TBNode_Vec* order, TBNode* node){
+    _tb_writeU64(w, node->type);
+    _tb_writeU64(w, node->calc_grad);
+    
+    switch(node->type){
+        case TBNT_VARIABLE:
+            _tb_writeString(w, ((TBVariable*)node->nodePtr)->name);
+            break;
+        case TBNT_CONSTANT:
+            _tb_writeU64(w, w->tensors.length);
+            vec_push(&w->tensors, ((TBConstant*)node->nodePtr)->value);
+            break;
+        case TBNT_GRAPH:{
+            TBGraphNode* graphNode = (TBGraphNode*)node->nodePtr;
+            TBGraphNodeParam** params = graphNode->params;
+            
+            // params are bound by the graph node itself, they belong to the enclosing graph
+            TBNode_Vec param_nodes;
+            vec_init(&param_nodes);
+            
+            uint64_t count = 0;
+            while(params != NULL && params[count]->node != NULL && params[count]->var_name != NULL){
+                vec_push(&param_nodes, params[count]->node);
+                count++;
+            }
+            
+            _tb_writeGraph(w, graphNode->graph, &param_nodes);
+            vec_deinit(&param_nodes);
+            
+            _tb_writeU64(w, count);
+            
+            uint64_t i = 0;
+            for(; i < count; i++){
+                _tb_writeString(w, params[i]->var_name);
+                _tb_writeU64(w, _tb_writeIndex(order, params[i]->node));
+            }
+            break;
+        }
+        case TBNT_BINARY_OPERATION:{
+            TBBinaryOperation* bop = (TBBinaryOperation*)node->nodePtr;
+            _tb_writeU64(w, bop->type);
+            _tb_writeU64(w, _tb_writeIndex(order, bop->lhs));
+            _tb_writeU64(w, _tb_writeIndex(order, bop->rhs));
+            break;
+        }
+        case TBNT_UNARY_OPERATION:{
+            TBUnaryOperation* uop = (TBUnaryOperation*)node->nodePtr;
+            _tb_writeU64(w, uop->type);
+            _tb_writeU64(w, _tb_writeIndex(order, uop->uhs));
+            break;
+        }
+        case TBNT_AXIS_BOUND_OPERATION:{
+            TBAxisBoundOperation* abop = (TBAxisBoundOperation*)node->nodePtr;
+            _tb_writeU64(w, abop->type);
+            _tb_writeU64(w, _tb_writeIndex(order, abop->uhs));
+            _tb_writeU64(w, abop->axis);
+            break;
+        }
+        case TBNT_AXES_TRANSPOSE:{
+            TBTransposeOperation* top = (TBTransposeOperation*)node->nodePtr;
+            _tb_writeU64(w, _tb_writeIndex(order, top->uhs));
+            _tb_writeU64(w, top->axis1);
+            _tb_writeU64(w, top->axis2);
+            break;
+        }
+        case TBNT_QUANTIZATION:{
+            TBQuantizationOperation* qop = (TBQuantizationOperation*)node->nodePtr;
+            uint32_t scale_bits;
+            memcpy(&scale_bits, &qop->scale, sizeof(uint32_t));
+            
+            _tb_writeU64(w, qop->type);
+            _tb_writeU64(w, _tb_writeIndex(order, qop->uhs));
+            _tb_writeU64(w, qop->dtype);
+            _tb_writeU64(w, scale_bits);
+            _tb_writeU64(w, (uint64_t)(int64_t)qop->zero_point);
+            break;
+        }
+        case TBNT_GATHER:{
+            TBGatherOperation* gop = (TBGatherOperation*)node->nodePtr;
+            _tb_writeU64(w, _tb_writeIndex(order, gop->table));
+            _tb_writeU64(w, _tb_writeIndex(order, gop->indices));
+            break;
+        }
+        case TBNT_CROSS_ENTROPY:{
+            TBCrossEntropyOperation* ceop = (TBCrossEntropyOperation*)node->nodePtr;
+            _tb_writeU64(w, _tb_writeIndex(order, ceop->logits));
+            _tb_writeU64(w, _tb_writeIndex(order, ceop->labels));
+            _tb_writeU64(w, ceop->axis);
+            break;
+        }
+        case TBNT_NORMALIZATION:{
+            TBNormalizationOperation* nop = (TBNormalizationOperation*)node->nodePtr;
+            uint32_t epsilon_bits;
+            memcpy(&epsilon_bits, &nop->epsilon, sizeof(uint32_t));
+            
+            // bit 0 and 1 flag the presence of gamma and beta, only present operands are written
+            _tb_writeU64(w, nop->type);
+            _tb_writeU64(w, _tb_writeIndex(order, nop->uhs));
+            _tb_writeU64(w, (nop->gamma != NULL) | ((nop->beta != NULL) << 1));
+            if(nop->gamma != NULL)
+                _tb_writeU64(w, _tb_writeIndex(order, nop->gamma));
+            if(nop->beta != NULL)
+                _tb_writeU64(w, _tb_writeIndex(order, nop->beta));
+            _tb_writeU64(w, nop->axis);
+            _tb_writeU64(w, epsilon_bits);
+            break;
+        }
+        case TBNT_CONVOLUTION:{
+            TBConvolutionOperation* cop = (TBConvolutionOperation*)node->nodePtr;
+            _tb_writeU64(w, _tb_writeIndex(order, cop->uhs));
+            _tb_writeU64(w, _tb_writeIndex(order, cop->weights));
+            _tb_writeU64(w, cop->layout);
+            _tb_writeU64(w, cop->algorithm);
+            
+            uint64_t i = 0;
+            for(; i < 2; i++){
+                _tb_writeU64(w, cop->stride[i]);
+                _tb_writeU64(w, cop->padding[i]);
+                _tb_writeU64(w, cop->dilation[i]);
+            }
+            
+            _tb_writeU64(w, cop->groups);
+            break;
+        }
+        case TBNT_POOLING:{
+            TBPoolingOperation* pop = (TBPoolingOperation*)node->nodePtr;
+            _tb_writeU64(w, pop->type);
+            _tb_writeU64(w, _tb_writeIndex(order, pop->uhs));
+            _tb_writeU64(w, pop->layout);
+            
+            uint64_t i = 0;
+            for(; i < 2; i++){
+                _tb_writeU64(w, pop->window[i]);
+                _tb_writeU64(w, pop->stride[i]);
+                _tb_writeU64(w, pop->padding[i]);
+            }
+            break;
+        }
+        case TBNT_REORDER:{
+            TBReorderOperation* rop = (TBReorderOperation*)node->nodePtr;
+            _tb_writeU64(w, _tb_writeIndex(order, rop->uhs));
+            _tb_writeU64(w, rop->from);
+            _tb_writeU64(w, rop->to);
+            _tb_writeU64(w, rop->block);
+            break;
+        }
+    }
+}
+
+/*
+ * Writes a graph block. Bindings to nodes in `exclude` are skipped, they are restored
+ * by the enclosing graph node.
+ */
+static void _tb_writeGraph(TBGraphWriter* w, TBGraph* graph, TBNode_Vec* exclude){
+    tb_compileGraph(graph);
+    
+    TBNode_Vec order;
+    TBNode_Vec bindings;
+    vec_init(&order);
+    vec_init(&bindings);
+    
+    _tb_orderNodes(&order, graph->root);
+    
+    const char* name;
+    map_iter_t iter = map_iter(&graph->slot_ids);
+    while((name = map_next(&graph->slot_ids, &iter))){
+        uint64_t slot = *map_get(&graph->slot_ids, name);
+        TBNode* node = graph->slots.data[slot];
+        
+        if(node == NULL || node == graph->feeds.data[slot] || _tb_isExcluded(exclude, node))
+            continue;
+        
+        _tb_orderNodes(&order, node);
+        vec_push(&bindings, (void*)name);
+    }
+    
+    _tb_writeString(w, graph->name);
+    _tb_writeU64(w, order.length);
+    
+    uint64_t i = 0;
+    for(; i < (uint64_t)order.length; i++){
+        _tb_writeNode(w, &order, order.data[i]);
+    }
+    
+    _tb_writeU64(w, _tb_writeIndex(&order, graph->root));
+    _tb_writeU64(w, bindings.length);
+    
+    for(i = 0; i < (uint64_t)bindings.length; i++){
+        const char* var = bindings.data[i];
+        _tb_writeString(w, var);
+        _tb_writeU64(w, _tb_writeIndex(&order, tb_graphGetVar(graph, var)));
+    }
+    
+    vec_deinit(&bindings);
+    vec_deinit(&order);
+}
+
+uint8_t tb_saveGraph(TBGraph* graph, const char* path){
+    TBGraphWriter w;
+    memset(&w, 0, sizeof(TBGraphWriter));
+    vec_init(&w.tensors);
+    
+    _tb_writeGraph(&w, graph, NULL);
+    
+    TBGraphFileHeader header;
+    memset(&header, 0, sizeof(TBGraphFileHeader));
+    memcpy(header.magic, TB_GRAPH_MAGIC, sizeof(header.magic));
+    header.version = TB_GRAPH_VERSION;
+    header.structure_len = w.len;
+    header.archive_offset = (sizeof(TBGraphFileHeader) + w.len + TB_GRAPH_ARCHIVE_ALIGN - 1)
+                            / TB_GRAPH_ARCHIVE_ALIGN * TB_GRAPH_ARCHIVE_ALIGN;
+    
+    uint64_t count = w.tensors.length;
+    char** names = calloc(count + 1, sizeof(char*));
+    
+    uint64_t i = 0;
+    for(; i < count; i++){
+        names[i] = calloc(24, sizeof(char));
+        snprintf(names[i], 24, "%"PRIu64, i);
+    }
+    
+    uint8_t ok = 0;
+    FILE* file = fopen(path, "wb");
+    
+    if(file != NULL){
+        ok = fwrite(&header, sizeof(TBGraphFileHeader), 1, file) == 1 &&
+             fwrite(w.data, 1, w.len, file) == w.len &&
+             fseek(file, (long)header.archive_offset, SEEK_SET) == 0 &&
+             nda_writeArchive(file, count, (const char**)names, (NDArray**)w.tensors.data);
+        ok = (fclose(file) == 0) && ok;
+    }
+    
+    for(i = 0; i < count; i++){
+        free(names[i]);
+    }
+    
+    free(names);
+    vec_deinit(&w.tensors);
+    free(w.data);
+    
+    return ok;
+}
+
+/* * * * * *
+ * Reading *
+ * * * * * */
+
+static uint64_t _tb_readU64(TBGraphReader* r){
+    uint64_t value = 0;
+    
+    if(!r->ok || r->len - r->pos < sizeof(uint64_t)){
+        r->ok = 0;
+        return 0;
+    }
+    
+    memcpy(&value, r->data + r->pos, sizeof(uint64_t));
+    r->pos += sizeof(uint64_t);
+    
+    return value;
+}
+
+static char* _tb_readString(TBGraphReader* r){
+    uint64_t len = _tb_readU64(r);
+    
+    if(!r->ok || r->len - r->pos < len){
+        r->ok = 0;
+        return NULL;
+    }
+    
+    char* str = calloc(len + 1, sizeof(char));
+    memcpy(str, r->data + r->pos, len);
+    r->pos += len;
+    
+    return str;
+}
+
+static TBNode* _tb_readIndex(TBGraphReader* r, TBNode** nodes, uint64_t count){
+    uint64_t idx = _tb_readU64(r);
+    
+    if(!r->ok || idx >= count){
+        r->ok = 0;
+        return NULL;
+    }
+    
+    return nodes[idx];
+}
+
+static TBGraph* _tb_readGraph(TBGraphReader* r);
+
+static TBNode* _tb_readNode(TBGraphReader* r, TBNode** nodes, uint64_t count){
+    uint64_t type = _tb_readU64(r);
+    uint64_t calc_grad = _tb_readU64(r);
+    TBNode* node = NULL;
+    
+    if(!r->ok)
+        return NULL;
+    
+    switch(type){
+        case TBNT_VARIABLE:{
+            char* name = _tb_readString(r);
+            if(r->ok)
+                node = tb_newVarNode(name);
+            break;
+        }
+        case TBNT_CONSTANT:{
+            uint64_t idx = _tb_readU64(r);
+            if(r->ok && idx < nda_archiveCount(r->archive))
+                node = tb_newBorrowedConstantNode(nda_archiveArray(r->archive, idx));
+            break;
+        }
+        case TBNT_GRAPH:{
+            TBGraph* graph = _tb_readGraph(r);
+            uint64_t param_count = _tb_readU64(r);
+            
+            if(!r->ok || param_count > count)
+                break;
+            
+            TBGraphNodeParam** params = calloc(param_count + 1, sizeof(TBGraphNodeParam*));
+            
+            uint64_t i = 0;
+            for(; i <= param_count; i++){
+                params[i] = calloc(1, sizeof(TBGraphNodeParam));
+                if(i < param_count){
+                    params[i]->var_name = _tb_readString(r);
+                    params[i]->node = _tb_readIndex(r, nodes, count);
+                }
+            }
+            
+            if(!r->ok){
+                for(i = 0; i <= param_count; i++){
+                    free(params[i]->var_name);
+                    free(params[i]);
+                }
+                free(params);
+                break;
+            }
+            
+            node = tb_newGraphNode(graph, params);
+            break;
+        }
+        case TBNT_BINARY_OPERATION:{
+            uint64_t op = _tb_readU64(r);
+            TBNode* lhs = _tb_readIndex(r, nodes, count);
+            TBNode* rhs = _tb_readIndex(r, nodes, count);
+            if(r->ok && op <= MAX_BINARY_OPERATION)
+                node = tb_newBinaryOpNode((TBBinaryOperationType)op, lhs, rhs);
+            break;
+        }
+        case TBNT_UNARY_OPERATION:{
+            uint64_t op = _tb_readU64(r);
+            TBNode* uhs = _tb_readIndex(r, nodes, count);
+            if(r->ok && op <= MAX_UNARY_OPERATION)
+                node = tb_newUnaryOpNode((TBUnaryOperationType)op, uhs);
+            break;
+        }
+        case TBNT_AXIS_BOUND_OPERATION:{
+            uint64_t op = _tb_readU64(r);
+            TBNode* uhs = _tb_readIndex(r, nodes, count);
+            uint64_t axis = _tb_readU64(r);
+            if(r->ok && op <= MAX_AXIS_BOUND_OPERATION)
+                node = tb_newAxisBoundOpNode((TBAxisBoundOperationType)op, uhs, axis);
+            break;
+        }
+        case TBNT_AXES_TRANSPOSE:{
+            TBNode* uhs = _tb_readIndex(r, nodes, count);
+            uint64_t axis1 = _tb_readU64(r);
+            uint64_t axis2 = _tb_readU64(r);
+            if(r->ok)
+                node = tb_newTransposeOpNode(uhs, axis1, axis2);
+            break;
+        }
+        case TBNT_QUANTIZATION:{
+            uint64_t op = _tb_readU64(r);
+            TBNode* uhs = _tb_readIndex(r, nodes, count);
+            uint64_t dtype = _tb_readU64(r);
+            uint32_t scale_bits = (uint32_t)_tb_readU64(r);
+            int32_t zero_point = (int32_t)(int64_t)_tb_readU64(r);
+            float scale;
+            memcpy(&scale, &scale_bits, sizeof(float));
+            
+            if(r->ok && op == TBQOT_DEQUANTIZE)
+                node = tb_newDequantizeOpNode(uhs);
+            else if(r->ok && op == TBQOT_QUANTIZE && (dtype == NDA_DTYPE_U8 || dtype == NDA_DTYPE_I8))
+                node = tb_newQuantizeOpNode(uhs, (NDDType)dtype, scale, zero_point);
+            break;
+        }
+        case TBNT_GATHER:{
+            TBNode* table = _tb_readIndex(r, nodes, count);
+            TBNode* indices = _tb_readIndex(r, nodes, count);
+            if(r->ok)
+                node = tb_newGatherOpNode(table, indices);
+            break;
+        }
+        case TBNT_CROSS_ENTROPY:{
+            TBNode* logits = _tb_readIndex(r, nodes, count);
+            TBNode* labels = _tb_readIndex(r, nodes, count);
+            uint64_t axis = _tb_readU64(r);
+            if(r->ok)
+                node = tb_newCrossEntropyOpNode(logits, labels, axis);
+            break;
+        }
+        case TBNT_NORMALIZATION:{
+            uint64_t op = _tb_readU64(r);
+            TBNode* uhs = _tb_readIndex(r, nodes, count);
+            uint64_t flags = _tb_readU64(r);
+            TBNode* gamma = (flags & 1) ? _tb_readIndex(r, nodes, count) : NULL;
+            TBNode* beta = (flags & 2) ? _tb_readIndex(r, nodes, count) : NULL;
+            uint64_t axis = _tb_readU64(r);
+            uint32_t epsilon_bits = (uint32_t)_tb_readU64(r);
+            float epsilon;
+            memcpy(&epsilon, &epsilon_bits, sizeof(float));
+            
+            if(r->ok && op <= MAX_NORMALIZATION_OPERATION)
+                node = tb_newNormalizationOpNode((TBNormalizationOperationType)op, uhs, gamma, beta, axis, epsilon);
+            break;
+        }
+        case TBNT_CONVOLUTION:{
+            TBNode* uhs = _tb_readIndex(r, nodes, count);
+            TBNode* weights = _tb_readIndex(r, nodes, count);
+            uint64_t layout = _tb_readU64(r);
+            uint64_t algorithm = _tb_readU64(r);
+            uint64_t params[6];
+            
+            uint64_t i = 0;
+            for(; i < 6; i++){
+                params[i] = _tb_readU64(r);
+            }
+            
+            uint64_t groups = _tb_readU64(r);
+            
+            if(r->ok && layout <= MAX_CONVOLUTION_LAYOUT && algorithm <= MAX_CONVOLUTION_ALGORITHM){
+                node = tb_newConvolutionOpNode(uhs, weights, (TBConvolutionLayout)layout, params[0], params[3], params[1], params[4], params[2], params[5], groups);
+                ((TBConvolutionOperation*)node->nodePtr)->algorithm = (TBConvolutionAlgorithm)algorithm;
+            }
+            break;
+        }
+        case TBNT_POOLING:{
+            uint64_t op = _tb_readU64(r);
+            TBNode* uhs = _tb_readIndex(r, nodes, count);
+            uint64_t layout = _tb_readU64(r);
+            uint64_t params[6];
+            
+            uint64_t i = 0;
+            for(; i < 6; i++){
+                params[i] = _tb_readU64(r);
+            }
+            
+            if(r->ok && op <= MAX_POOLING_OPERATION && layout <= MAX_CONVOLUTION_LAYOUT)
+                node = tb_newPoolingOpNode((TBPoolingOperationType)op, uhs, (TBConvolutionLayout)layout, params[0], params[3], params[1], params[4], params[2], params[5]);
+            break;
+        }
+        case TBNT_REORDER:{
+            TBNode* uhs = _tb_readIndex(r, nodes, count);
+            uint64_t from = _tb_readU64(r);
+            uint64_t to = _tb_readU64(r);
+            uint64_t block = _tb_readU64(r);
+            
+            if(r->ok && from <= MAX_CONVOLUTION_LAYOUT && to <= MAX_CONVOLUTION_LAYOUT)
+                node = tb_newReorderOpNode(uhs, (TBConvolutionLayout)from, (TBConvolutionLayout)to, block);
+            break;
+        }
+    }
+    
+    if(node == NULL){
+        r->ok = 0;
+        return NULL;
+    }
+    
+    node->calc_grad = (uint8_t)calc_grad;
+    vec_push(&r->nodes, node);
+    
+    return node;
+}
+
+static TBGraph* _tb_readGraph(TBGraphReader* r){
+    char* name = _tb_readString(r);
+    uint64_t count = _tb_readU64(r);
+    
+    // every node takes at least two words, this bounds the allocation on corrupted counts
+    if(!r->ok || count == 0 || count > (r->len - r->pos) / (2*sizeof(uint64_t))){
+        free(name);
+        r->ok = 0;
+        return NULL;
+    }
+    
+    TBNode** nodes = calloc(count, sizeof(TBNode*));
+    
+    uint64_t i = 0;
+    for(; i < count && r->ok; i++){
+        nodes[i] = _tb_readNode(r, nodes, i);
+    }
+    
+    TBNode* root = _tb_readIndex(r, nodes, count);
+    uint64_t bindings = _tb_readU64(r);
+    
+    if(!r->ok){
+        free(nodes);
+        free(name);
+        return NULL;
+    }
+    
+    TBGraph* graph = tb_newGraph(name, root);
+    graph->owns_names = 1;
+    vec_push(&r->graphs, graph);
+    
+    for(i = 0; i < bindings && r->ok; i++){
+        char* var = _tb_readString(r);
+        TBNode* node = _tb_readIndex(r, nodes, count);
+        
+        if(r->ok){
+            tb_graphSetVar(graph, node, var);
+        }
+        
+        free(var);
+    }
+    
+    free(nodes);
+    
+    return graph;
+}
+
+/*
+ * Undoes a failed load. Constants point into the archive, only their wrappers are freed.
+ */
+static void _tb_discardLoad(TBGraphReader* r){
+    uint64_t i = 0;
+    
+    for(; i < (uint64_t)r->nodes.length; i++){
+        TBNode* node = r->nodes.data[i];
+        
+        if(node->type == TBNT_VARIABLE){
+            free(((TBVariable*)node->nodePtr)->name);
+        }
+        else if(node->type == TBNT_GRAPH){
+            TBGraphNodeParam** params = ((TBGraphNode*)node->nodePtr)->params;
+            uint64_t j = 0;
+            for(; params[j]->node != NULL; j++){
+                free(params[j]->var_name);
+                free(params[j]);
+            }
+            free(params[j]);
+            free(params);
+        }
+        
+        free(node->nodePtr);
+        free(node);
+    }
+    
+    for(i = 0; i < (uint64_t)r->graphs.length; i++){
+        TBGraph* graph = r->graphs.data[i];
+        map_deinit(&graph->vars);
+        map_deinit(&graph->slot_ids);
+        vec_deinit(&graph->nodes);
+        vec_deinit(&graph->slots);
+        vec_deinit(&graph->feeds);
+        free(graph->name);
+        free(graph);
+    }
+}
+
+TBGraph* tb_loadGraph(const char* path){
+    FILE* file = fopen(path, "rb");
+    if(file == NULL){
+        return NULL;
+    }
+    
+    TBGraphFileHeader header;
+    TBGraphReader r;
+    memset(&r, 0, sizeof(TBGraphReader));
+    
+    uint8_t ok = fread(&header, sizeof(TBGraphFileHeader), 1, file) == 1 &&
+                 memcmp(header.magic, TB_GRAPH_MAGIC, sizeof(header.magic)) == 0 &&
+                 header.version == TB_GRAPH_VERSION &&
+                 header.archive_offset % TB_GRAPH_ARCHIVE_ALIGN == 0 &&
+                 header.archive_offset >= sizeof(TBGraphFileHeader) + header.structure_len;
+    
+    if(ok){
+        r.data = malloc(header.structure_len);
+        r.len = header.structure_len;
+        ok = r.data != NULL && fread(r.data, 1, r.len, file) == r.len;
+    }
+    
+    fclose(file);
+    
+    if(ok){
+        r.archive = nda_openArchiveAt(path, header.archive_offset);
+        ok = r.archive != NULL;
+    }
+    
+    if(!ok){
+        free(r.data);
+        return NULL;
+    }
+    
+    r.ok = 1;
+    vec_init(&r.nodes);
+    vec_init(&r.graphs);
+    
+    TBGraph* graph = _tb_readGraph(&r);
+    
+    if(!r.ok || r.pos != r.len){
+        _tb_discardLoad(&r);
+        nda_closeArchive(r.archive);
+        graph = NULL;
+    }
+    else {
+        graph->archive = r.archive;
+        tb_compileGraph(graph);
+    }
+    
+    vec_deinit(&r.nodes);
+    vec_deinit(&r.graphs);
+    free(r.data);
+    
+    return graph;
+}
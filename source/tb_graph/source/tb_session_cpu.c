@@ -46,77 +46,423 @@
 #include <string.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
 
 #include <tb_session.h>
 #include <tb_graph.h>
 #include <tb_factory.h>
 #include <tb_ops.h>
+#include <tb_shape.h>
+#include <tb_profiler.h>
+#include <tb_memory.h>
+#include <tb_gemm.h>
 
 #include <ndarray.h>
 #include <ndarray_std.h>
+#include <ndarray_mem.h>
 
 /* * * * * * * *
  * Session API *
  * * * * * * * */
 
 // predeclaration of local functions
-static TBResultNode* _run_BinaryOperation(TBGraphSession* session, TBGraph* graph, TBNode* node);
-static TBResultNode* _run_UnaryOperation(TBGraphSession* session, TBGraph* graph, TBNode* node);
-static TBResultNode* _run_AxisBoundOperation(TBGraphSession* session, TBGraph* graph, TBNode* node);
-static TBResultNode* _run_TransposeOperation(TBGraphSession* session, TBGraph* graph, TBNode* node);
-static TBResultNode* _run_Node(TBGraphSession* session, TBGraph* graph, TBNode* node);
+static TBResultNode* _run_BinaryOperation(TBGraphSession* session, TBRunContext* ctx, TBNode* node);
+static TBResultNode* _run_UnaryOperation(TBGraphSession* session, TBRunContext* ctx, TBNode* node);
+static TBResultNode* _run_AxisBoundOperation(TBGraphSession* session, TBRunContext* ctx, TBNode* node);
+static TBResultNode* _run_TransposeOperation(TBGraphSession* session, TBRunContext* ctx, TBNode* node);
+static TBResultNode* _run_QuantizationOperation(TBGraphSession* session, TBRunContext* ctx, TBNode* node);
+static TBResultNode* _run_GatherOperation(TBGraphSession* session, TBRunContext* ctx, TBNode* node);
+static TBResultNode* _run_CrossEntropyOperation(TBGraphSession* session, TBRunContext* ctx, TBNode* node);
+static TBResultNode* _run_NormalizationOperation(TBGraphSession* session, TBRunContext* ctx, TBNode* node);
+static TBResultNode* _run_ConvolutionOperation(TBGraphSession* session, TBRunContext* ctx, TBNode* node);
+static TBResultNode* _run_PoolingOperation(TBGraphSession* session, TBRunContext* ctx, TBNode* node);
+static TBResultNode* _run_ReorderOperation(TBGraphSession* session, TBRunContext* ctx, TBNode* node);
+static TBResultNode* _run_NodeValue(TBGraphSession* session, TBRunContext* ctx, TBNode* node);
+static TBResultNode* _run_Node(TBGraphSession* session, TBRunContext* ctx, TBNode* node);
+static void _tb_beginRun(TBRunContext* ctx);
 
 TBGraphSession* tb_createLocalCPUSession(){
     TBGraphSession* session = calloc(1, sizeof(TBGraphSession));
+    pthread_mutex_init(&session->lock, NULL);
+    session->pool = tb_newThreadPool();
 
     return session;
 }
 
-// TODO
-// free graph & nodes
+void tb_sessionSetThreads(TBGraphSession* session, uint64_t threads){
+    session->threads = threads;
+}
+
 TBResultNode* tb_runSession(TBGraphSession* session, TBGraph* graph, TBGraphNodeParam** params){
     ASSERT(graph != NULL, "Cannot run session on a NULL Graph");
     ASSERT(graph->root != NULL, "Root node of the graph %s must be NULL", graph->name);
     
+    tb_compileGraph(graph);
+    
+    TBRunContext* ctx = _tb_sessionContext(session, graph);
+    _tb_beginRun(ctx);
+    
     if(params != NULL){
         size_t i = 0;
         
         for(;(params[i]->node != NULL) && (params[i]->var_name != NULL);i++){
-            tb_graphSetVar(graph, params[i]->node, params[i]->var_name);
+            uint64_t slot = tb_graphGetVarSlot(graph, params[i]->var_name);
+            
+            if(slot != TB_NO_SLOT){
+                ctx->bindings[slot] = params[i]->node;
+            }
         }
     }
     
-    TBNode* root = graph->root;
-    
-    tb_storeNodesInGraph(graph, root);
-    
-    // TODO: free stuff
-    
-    return _run_Node(session, graph, root);
+    return _run_Node(session, ctx, graph->root);
 }
 
 struct TBResultNode* tb_runSessionNodeOnly(struct TBGraphSession* session, struct TBNode* node){
     TBGraph* g_tmp = tb_newGraph("tmp0001", node);
-    TBResultNode* res = tb_runSession(session, g_tmp, NULL);
+    tb_compileGraph(g_tmp);
+    
+    // the temporary graph never outlives the call, neither do its state and its nodes
+    TBRunContext* ctx = _tb_newContext(g_tmp);
+    ctx->temporary = 1;
+    TBResultNode* res = _run_Node(session, ctx, node);
+    _tb_freeContext(ctx);
+    
+    // a constant root hands out its own value
+    if(res->borrowed){
+        res->value = nda_copy(res->value);
+        res->borrowed = 0;
+    }
     
-    // TODO: free stuff
+    tb_freeGraph(g_tmp);
     
     return res;
 }
 
+struct TBResultNode* tb_sessionGetResult(struct TBGraphSession* session, struct TBGraph* graph, struct TBNode* node){
+    tb_compileGraph(graph);
+    
+    return _tb_contextEntry(_tb_sessionContext(session, graph), node)->result;
+}
+
+struct TBResultNode* tb_sessionGetDiff(struct TBGraphSession* session, struct TBGraph* graph, struct TBNode* node){
+    tb_compileGraph(graph);
+    
+    return _tb_contextEntry(_tb_sessionContext(session, graph), node)->diff;
+}
+
+/* * * * * * * * * *
+ * Run context API *
+ * * * * * * * * * */
+
+TBRunContext* _tb_newContext(TBGraph* graph){
+    TBRunContext* ctx = calloc(1, sizeof(TBRunContext));
+    ctx->graph = graph;
+    ctx->entries_len = graph->nodes.length;
+    ctx->entries = calloc(ctx->entries_len + 1, sizeof(TBContextEntry));
+    ctx->bindings = calloc(graph->slots.length + 1, sizeof(TBNode*));
+    
+    uint64_t i = 0;
+    for(; i < ctx->entries_len; i++){
+        ctx->entries[i].node = graph->nodes.data[i];
+    }
+    
+    return ctx;
+}
+
+static void _tb_freeEntry(TBContextEntry* entry){
+    if(entry->result != NULL){
+        tb_freeResultNode(NULL, entry->result);
+        free(entry->result);
+    }
+    
+    if(entry->diff != NULL){
+        tb_freeResultNode(NULL, entry->diff);
+        free(entry->diff);
+    }
+    
+    if(entry->saved != NULL){
+        nda_free(entry->saved);
+        free(entry->saved);
+    }
+}
+
+void _tb_freeContext(TBRunContext* ctx){
+    uint64_t i = 0;
+    for(; i < ctx->entries_len; i++){
+        _tb_freeEntry(ctx->entries + i);
+    }
+    
+    for(i = 0; i < ctx->extras_len; i++){
+        _tb_freeEntry(ctx->extras[i]);
+        free(ctx->extras[i]);
+    }
+    
+    free(ctx->entries);
+    free(ctx->extras);
+    free(ctx->bindings);
+    free(ctx);
+}
+
+/*
+ * Session holding the contexts of the runs without session
+ */
+static TBGraphSession* _tb_sharedSession = NULL;
+static pthread_once_t _tb_sharedSessionOnce = PTHREAD_ONCE_INIT;
+
+static void _tb_createSharedSession(){
+    _tb_sharedSession = tb_createLocalCPUSession();
+}
+
+TBRunContext* _tb_sessionContext(TBGraphSession* session, TBGraph* graph){
+    if(session == NULL){
+        pthread_once(&_tb_sharedSessionOnce, _tb_createSharedSession);
+        session = _tb_sharedSession;
+    }
+    
+    TBRunContext* ctx = NULL;
+    
+    pthread_mutex_lock(&session->lock);
+    
+    int i = 0;
+    for(; i < session->contexts.length; i++){
+        if(session->contexts.data[i]->graph == graph){
+            ctx = session->contexts.data[i];
+            break;
+        }
+    }
+    
+    if(ctx == NULL){
+        ctx = _tb_newContext(graph);
+        vec_push(&session->contexts, ctx);
+    }
+    
+    pthread_mutex_unlock(&session->lock);
+    
+    return ctx;
+}
+
+void _tb_releaseGraphContext(TBGraph* graph){
+    if(_tb_sharedSession == NULL)
+        return;
+    
+    TBGraphSession* session = _tb_sharedSession;
+    
+    pthread_mutex_lock(&session->lock);
+    
+    int i = 0;
+    for(; i < session->contexts.length; i++){
+        if(session->contexts.data[i]->graph == graph){
+            _tb_freeContext(session->contexts.data[i]);
+            vec_splice(&session->contexts, i, 1);
+            break;
+        }
+    }
+    
+    pthread_mutex_unlock(&session->lock);
+}
+
+/*
+ * Starts a new run within a context, the state of nodes outside the graph which the previous run did not use
+ * is dropped, e.g nodes bound by a single run
+ */
+static void _tb_beginRun(TBRunContext* ctx){
+    ctx->runs++;
+    
+    uint64_t i = 0, kept = 0;
+    for(; i < ctx->extras_len; i++){
+        TBContextEntry* entry = ctx->extras[i];
+        
+        if(entry->run + 1 < ctx->runs){
+            _tb_freeEntry(entry);
+            free(entry);
+        }
+        else{
+            ctx->extras[kept++] = entry;
+        }
+    }
+    
+    ctx->extras_len = kept;
+}
+
+TBContextEntry* _tb_contextEntry(TBRunContext* ctx, TBNode* node){
+    if(tb_graphOwnsNode(ctx->graph, node) && (node->id < ctx->entries_len)){
+        return ctx->entries + node->id;
+    }
+    
+    uint64_t i = 0;
+    for(; i < ctx->extras_len; i++){
+        if(ctx->extras[i]->node == node){
+            ctx->extras[i]->run = ctx->runs;
+            return ctx->extras[i];
+        }
+    }
+    
+    // entries are allocated one by one so that their addresses remain valid
+    ctx->extras = realloc(ctx->extras, (ctx->extras_len + 1)*sizeof(TBContextEntry*));
+    TBContextEntry* entry = calloc(1, sizeof(TBContextEntry));
+    entry->node = node;
+    entry->run = ctx->runs;
+    ctx->extras[ctx->extras_len++] = entry;
+    
+    return entry;
+}
+
+TBNode* _tb_contextResolveVar(TBRunContext* ctx, TBNode* node){
+    TBGraph* graph = ctx->graph;
+    uint64_t slot = tb_graphVarNodeSlot(graph, node);
+    
+    if(slot == TB_NO_SLOT){
+        return tb_graphGetVar(graph, ((TBVariable*)node->nodePtr)->name);
+    }
+    
+    if(ctx->bindings[slot] != NULL){
+        return ctx->bindings[slot];
+    }
+    
+    return graph->slots.data[slot];
+}
 
 /* * * * * * * * * * * * *
  * Graph Processing  API *
  * * * * * * * * * * * * */
 
-static TBResultNode* _run_Node(TBGraphSession* session, TBGraph* graph, TBNode* node){
+/*
+ * Values of the first two operands of a node evaluated within the context, for its profile
+ */
+static void _tb_profileOperands(TBRunContext* ctx, TBNode* node, struct NDArray** lhs, struct NDArray** rhs){
+    TBNode* a = NULL;
+    TBNode* b = NULL;
+    
+    switch(node->type){
+        case TBNT_BINARY_OPERATION:
+            a = ((TBBinaryOperation*)node->nodePtr)->lhs;
+            b = ((TBBinaryOperation*)node->nodePtr)->rhs;
+            break;
+        case TBNT_UNARY_OPERATION:
+            a = ((TBUnaryOperation*)node->nodePtr)->uhs;
+            break;
+        case TBNT_AXIS_BOUND_OPERATION:
+            a = ((TBAxisBoundOperation*)node->nodePtr)->uhs;
+            break;
+        case TBNT_AXES_TRANSPOSE:
+            a = ((TBTransposeOperation*)node->nodePtr)->uhs;
+            break;
+        case TBNT_QUANTIZATION:
+            a = ((TBQuantizationOperation*)node->nodePtr)->uhs;
+            break;
+        case TBNT_GATHER:
+            a = ((TBGatherOperation*)node->nodePtr)->table;
+            b = ((TBGatherOperation*)node->nodePtr)->indices;
+            break;
+        case TBNT_CROSS_ENTROPY:
+            a = ((TBCrossEntropyOperation*)node->nodePtr)->logits;
+            b = ((TBCrossEntropyOperation*)node->nodePtr)->labels;
+            break;
+        case TBNT_NORMALIZATION:
+            a = ((TBNormalizationOperation*)node->nodePtr)->uhs;
+            break;
+        case TBNT_CONVOLUTION:
+            a = ((TBConvolutionOperation*)node->nodePtr)->uhs;
+            b = ((TBConvolutionOperation*)node->nodePtr)->weights;
+            break;
+        case TBNT_POOLING:
+            a = ((TBPoolingOperation*)node->nodePtr)->uhs;
+            break;
+        case TBNT_REORDER:
+            a = ((TBReorderOperation*)node->nodePtr)->uhs;
+            break;
+        case TBNT_VARIABLE:
+        case TBNT_CONSTANT:
+        case TBNT_GRAPH:
+            break;
+    }
+    
+    TBResultNode* ra = (a != NULL) ? _tb_contextEntry(ctx, a)->result : NULL;
+    TBResultNode* rb = (b != NULL) ? _tb_contextEntry(ctx, b)->result : NULL;
+    *lhs = (ra != NULL) ? ra->value : NULL;
+    *rhs = (rb != NULL) ? rb->value : NULL;
+}
+
+/*
+ * Evaluates a node, timed when the session is profiled and charged with its allocations when the session accounts
+ * memory. Operands are evaluated within the node and are excluded from its self time and allocations.
+ */
+static TBResultNode* _run_Node(TBGraphSession* session, TBRunContext* ctx, TBNode* node){
+    TBProfiler* profiler = ((session != NULL) && (node->type != TBNT_VARIABLE) && (node->type != TBNT_CONSTANT)) ? session->profiler : NULL;
+    TBSessionMemory* memory = (session != NULL) ? session->memory : NULL;
+    
+    if((profiler == NULL) && (memory == NULL)){
+        return _run_NodeValue(session, ctx, node);
+    }
+    
+    NDMemTracker* tracker = NULL;
+    NDMemTracker* previous = NULL;
+    uint64_t allocated = 0;
+    
+    // constants and variables are charged as well, with the derivative kept by the context
+    if(memory != NULL){
+        tracker = _tb_nodeMemory(session, ctx, node);
+        allocated = nda_memCounters(tracker).total;
+        previous = nda_memSetTracker(tracker);
+    }
+    
+    TBProfileScope scope;
+    if(profiler != NULL){
+        _tb_profileBegin(&scope);
+    }
+    
+    TBResultNode* res = _run_NodeValue(session, ctx, node);
+    
+    if(memory != NULL){
+        nda_memSetTracker(previous);
+        allocated = nda_memCounters(tracker).total - allocated;
+    }
+    
+    if(profiler == NULL){
+        return res;
+    }
+    
+    struct NDArray* out = ((res != NULL) && (res->error == NULL)) ? res->value : NULL;
+    struct NDArray* lhs = NULL;
+    struct NDArray* rhs = NULL;
+    
+    if(out != NULL){
+        _tb_profileOperands(ctx, node, &lhs, &rhs);
+        
+        if(memory == NULL){
+            allocated = nda_storedLen(out)*nda_dtypeSize(out->dtype);
+        }
+    }
+    
+    _tb_profileEnd(profiler, &scope, node, out, lhs, rhs, allocated, 0);
+    
+    return res;
+}
+
+/*
+ * Zero derivative of a node. Sparse values get sparse derivatives with the same sparsity pattern, gathered
+ * matrices get row lists which only store the looked up rows.
+ */
+static NDArray* _tb_zeroDiff(TBContextEntry* entry, NDArray* value){
+    if(nda_isSparse(value))
+        return nda_sparseZerosLike(value);
+    
+    if(entry->row_sparse && (value->shape->rank == 2) && (value->dtype == NDA_DTYPE_FLOAT))
+        return nda_allocSparseRows(value->shape->dims[0], value->shape->dims[1], 0);
+    
+    return nda_alloc(nda_copyShape(value->shape));
+}
+
+static TBResultNode* _run_NodeValue(TBGraphSession* session, TBRunContext* ctx, TBNode* node){
+    TBGraph* graph = ctx->graph;
     TBNodeType type = node->type;
     TBResultNode* res = NULL;
     
     switch(type){
         case TBNT_VARIABLE:{
             TBVariable* var = (TBVariable*)node->nodePtr;
-            TBNode* n = tb_graphGetVar(graph, var->name);
+            TBNode* n = _tb_contextResolveVar(ctx, node);
             
             if(n == NULL){
                 char msg[1024] = {0};
@@ -124,12 +470,15 @@ static TBResultNode* _run_Node(TBGraphSession* session, TBGraph* graph, TBNode*
                 return tb_newErrorResultNode(TBET_VARIABLE_DOES_NOT_EXIST, msg, node, graph);
             }
             
-            res = _run_Node(session, graph, n);
+            // the bound node is looked up like the variable
+            _tb_contextEntry(ctx, n)->row_sparse |= _tb_contextEntry(ctx, node)->row_sparse;
+            res = _run_Node(session, ctx, n);
             
             break;
         }
         case TBNT_CONSTANT:
             res = tb_newResultNode(((TBConstant*)node->nodePtr)->value);
+            res->borrowed = 1;
             break;
         case TBNT_GRAPH:
         {
@@ -142,130 +491,1246 @@ static TBResultNode* _run_Node(TBGraphSession* session, TBGraph* graph, TBNode*
             break;
         }
         case TBNT_BINARY_OPERATION:
-            res =  _run_BinaryOperation(session, graph, node);
+            res =  _run_BinaryOperation(session, ctx, node);
             break;
         case TBNT_UNARY_OPERATION:
-            res =  _run_UnaryOperation(session, graph, node);
+            res =  _run_UnaryOperation(session, ctx, node);
             break;
         case TBNT_AXIS_BOUND_OPERATION:
-            res =  _run_AxisBoundOperation(session, graph, node);
+            res =  _run_AxisBoundOperation(session, ctx, node);
             break;
         case TBNT_AXES_TRANSPOSE:
-            res =  _run_TransposeOperation(session, graph, node);
+            res =  _run_TransposeOperation(session, ctx, node);
+            break;
+        case TBNT_QUANTIZATION:
+            res =  _run_QuantizationOperation(session, ctx, node);
+            break;
+        case TBNT_GATHER:
+            res =  _run_GatherOperation(session, ctx, node);
+            break;
+        case TBNT_CROSS_ENTROPY:
+            res =  _run_CrossEntropyOperation(session, ctx, node);
+            break;
+        case TBNT_NORMALIZATION:
+            res =  _run_NormalizationOperation(session, ctx, node);
+            break;
+        case TBNT_CONVOLUTION:
+            res =  _run_ConvolutionOperation(session, ctx, node);
+            break;
+        case TBNT_POOLING:
+            res =  _run_PoolingOperation(session, ctx, node);
             break;
+        case TBNT_REORDER:
+            res =  _run_ReorderOperation(session, ctx, node);
+            break;
+    }
+    
+    if((res == NULL) || (res->error != NULL)){
+        return res;
+    }
+    
+    TBContextEntry* entry = _tb_contextEntry(ctx, node);
+    
+    if(entry->diff == NULL){
+        entry->diff = tb_newResultNode(_tb_zeroDiff(entry, res->value));
     }
     
-    if(node->diff == NULL){
-        node->diff = tb_newResultNode(nda_alloc(res->value->shape));
+    if(entry->result != NULL){
+        tb_freeResultNode(graph, entry->result);
+        free(entry->result);
     }
     
-    node->result = tb_newResultNode(nda_copy(res->value));
+    // the values of constants are kept without copy, e.g large embedding tables
+    entry->result = tb_newResultNode(res->borrowed ? res->value : nda_copy(res->value));
+    entry->result->borrowed = res->borrowed;
     
     return res;
 }
 
-static TBResultNode* _run_UnaryOperation(TBGraphSession* session, TBGraph* graph, TBNode* node){
+/*
+ * Frees the result of an operand once the node using it is computed, the context keeps its own copy
+ */
+static void _tb_releaseOperand(TBResultNode* operand){
+    if(operand != NULL){
+        tb_freeResultNode(NULL, operand);
+        free(operand);
+    }
+}
+
+static TBResultNode* _run_UnaryOperation(TBGraphSession* session, TBRunContext* ctx, TBNode* node){
+    TBGraph* graph = ctx->graph;
     TBUnaryOperation* op = (TBUnaryOperation*)node->nodePtr;
-    TBResultNode* uhs = _run_Node(session, graph, op->uhs);
+    TBResultNode* uhs = _run_Node(session, ctx, op->uhs);
+    
+    if(uhs->error != NULL){
+        return uhs;
+    }
+    
+    TBResultNode* res = NULL;
     
     switch(op->type){
         case TBUOT_MINUS:
-            return _tb_negative(session, graph, node, uhs);
+            res = _tb_negative(session, graph, node, uhs);
+            break;
         case TBUOT_EXP:
-            return _tb_exp(session, graph, node, uhs);
+            res = _tb_exp(session, graph, node, uhs);
+            break;
         case TBUOT_LOG:
-            return _tb_log(session, graph, node, uhs);
+            res = _tb_log(session, graph, node, uhs);
+            break;
         case TBUOT_SIN:
-            return _tb_sin(session, graph, node, uhs);
+            res = _tb_sin(session, graph, node, uhs);
+            break;
         case TBUOT_COS:
-            return _tb_cos(session, graph, node, uhs);
+            res = _tb_cos(session, graph, node, uhs);
+            break;
         case TBUOT_TAN:
-            return _tb_tan(session, graph, node, uhs);
+            res = _tb_tan(session, graph, node, uhs);
+            break;
         case TBUOT_TANH:
-            return _tb_tanh(session, graph, node, uhs);
+            res = _tb_tanh(session, graph, node, uhs);
+            break;
         case TBUOT_RELU:
-            return _tb_relu(session, graph, node, uhs);
+            res = _tb_relu(session, graph, node, uhs);
+            break;
         case TBUOT_SOFTPLUS:
-            return _tb_softplus(session, graph, node, uhs);
+            res = _tb_softplus(session, graph, node, uhs);
+            break;
         case TBUOT_SIGMOID:
-            return _tb_sigmoid(session, graph, node, uhs);
+            res = _tb_sigmoid(session, graph, node, uhs);
+            break;
         case TBUOT_DXRELU:
-            return _tb_dxrelu(session, graph, node, uhs);
+            res = _tb_dxrelu(session, graph, node, uhs);
+            break;
+    }
+    
+    _tb_releaseOperand(uhs);
+    
+    return res;
+}
+
+/*
+ * Packs of a constant DOT product RHS or convolution weights kept by the session, created on first use. Only constants of the graph are
+ * packed, fed tensors change with every run.
+ */
+static TBPackedWeights* _tb_sessionPackEntry(TBGraphSession* session, TBGraph* graph, TBNode* node){
+    if((session == NULL) || (node->type != TBNT_CONSTANT) || !tb_graphOwnsNode(graph, node))
+        return NULL;
+    
+    TBConstant* constant = (TBConstant*)node->nodePtr;
+    TBPackedWeights* entry = NULL;
+    int i = 0;
+    
+    pthread_mutex_lock(&session->lock);
+    
+    for(; (entry == NULL) && (i < session->packs.length); i++){
+        if(session->packs.data[i]->constant == constant)
+            entry = session->packs.data[i];
+    }
+    
+    if(entry == NULL){
+        entry = calloc(1, sizeof(TBPackedWeights));
+        entry->constant = constant;
+        vec_push(&session->packs, entry);
+    }
+    
+    pthread_mutex_unlock(&session->lock);
+    
+    return entry;
+}
+
+/*
+ * Drops the packs of an entry once its constant has changed, so that they are packed again on first use.
+ */
+static void _tb_refreshPackEntry(TBPackedWeights* entry){
+    TBConstant* constant = entry->constant;
+    
+    if((entry->value == constant->value) && (entry->raw == constant->value->raw) && (entry->version == constant->version))
+        return;
+    
+    if(entry->packed != NULL)
+        _tb_freePackedMatrix(entry->packed);
+    if(entry->quantized != NULL)
+        tb_qgemmFreePacked(entry->quantized);
+    if(entry->conv != NULL)
+        nda_memFree(entry->conv);
+    
+    entry->value = constant->value;
+    entry->raw = constant->value->raw;
+    entry->version = constant->version;
+    entry->packed = NULL;
+    entry->quantized = NULL;
+    entry->conv = NULL;
+}
+
+static TBPackedMatrix* _tb_packedWeights(TBPackedWeights* entry){
+    if(entry == NULL)
+        return NULL;
+    
+    _tb_refreshPackEntry(entry);
+    
+    if((entry->packed == NULL) && _tb_packable(entry->value))
+        entry->packed = _tb_packMatrix(entry->value);
+    
+    return entry->packed;
+}
+
+/*
+ * Same for the I8 RHS of a quantized DOT product, see `_tb_isQuantizedDot`.
+ */
+static TBQGemmPacked* _tb_quantizedWeights(TBPackedWeights* entry){
+    if(entry == NULL)
+        return NULL;
+    
+    _tb_refreshPackEntry(entry);
+    
+    if(entry->quantized == NULL){
+        NDShape* shape = entry->value->shape;
+        entry->quantized = tb_qgemmPack((const int8_t*)entry->value->raw, shape->strides[0], shape->strides[1], shape->dims[0], shape->dims[1]);
+    }
+    
+    return entry->quantized;
+}
+
+/*
+ * Same for the weights of a convolution of input `uhs`, transformed again when the kernel reads another transform.
+ */
+static tb_float* _tb_convWeights(TBPackedWeights* entry, TBConvolutionOperation* cop, NDArray* uhs){
+    if(entry == NULL)
+        return NULL;
+    
+    _tb_refreshPackEntry(entry);
+    
+    uint64_t kind = _tb_convPackKind(cop, uhs, entry->value);
+    
+    if((entry->conv != NULL) && (entry->conv_kind != kind)){
+        nda_memFree(entry->conv);
+        entry->conv = NULL;
     }
+    
+    if((entry->conv == NULL) && (kind != 0)){
+        entry->conv = _tb_convPackWeights(cop, uhs, entry->value);
+        entry->conv_kind = kind;
+    }
+    
+    return entry->conv;
 }
 
-static TBResultNode* _run_BinaryOperation(TBGraphSession* session, TBGraph* graph, TBNode* node){
+static TBResultNode* _run_BinaryOperation(TBGraphSession* session, TBRunContext* ctx, TBNode* node){
+    TBGraph* graph = ctx->graph;
     TBBinaryOperation* op = (TBBinaryOperation*)node->nodePtr;
-    TBResultNode* lhs = _run_Node(session, graph, op->lhs);
-    TBResultNode* rhs = _run_Node(session, graph, op->rhs);
+    TBResultNode* lhs = _run_Node(session, ctx, op->lhs);
+    
+    if(lhs->error != NULL){
+        return lhs;
+    }
+    
+    TBResultNode* rhs = _run_Node(session, ctx, op->rhs);
+    
+    if(rhs->error != NULL){
+        _tb_releaseOperand(lhs);
+        return rhs;
+    }
+    
+    TBResultNode* res = NULL;
     
     switch(op->type){
         case TBBOT_ADD:
-            return _tb_add(session, graph, node, lhs, rhs);
+            res = _tb_add(session, graph, node, lhs, rhs);
             break;
         case TBBOT_SUB:
-            return _tb_sub(session, graph, node, lhs, rhs);
+            res = _tb_sub(session, graph, node, lhs, rhs);
             break;
         case TBBOT_MULT:
-            return _tb_mul(session, graph, node, lhs, rhs);
+            res = _tb_mul(session, graph, node, lhs, rhs);
             break;
         case TBBOT_DIV:
-            return _tb_div(session, graph, node, lhs, rhs);
+            res = _tb_div(session, graph, node, lhs, rhs);
             break;
         case TBBOT_POW:
-            return _tb_pow(session, graph, node, lhs, rhs);
+            res = _tb_pow(session, graph, node, lhs, rhs);
             break;
-        case TBBOT_DOT:
-            return _tb_dot(session, graph, node, lhs, rhs);
+        case TBBOT_DOT:{
+            TBNode* weights = op->rhs;
+            
+            while((weights != NULL) && (weights->type == TBNT_VARIABLE))
+                weights = _tb_contextResolveVar(ctx, weights);
+            
+            TBPackedMatrix* packed = ((weights != NULL) && _tb_packedDotApplies(lhs->value, rhs->value)) ?
+                                     _tb_packedWeights(_tb_sessionPackEntry(session, graph, weights)) : NULL;
+            
+            res = (packed != NULL) ? _tb_packedDot(session, graph, node, lhs, rhs, packed) : _tb_dot(session, graph, node, lhs, rhs);
             break;
+        }
     }
-    return NULL;
+    
+    _tb_releaseOperand(lhs);
+    _tb_releaseOperand(rhs);
+    
+    return res;
 }
 
-static TBResultNode* _run_AxisBoundOperation(TBGraphSession* session, TBGraph* graph, TBNode* node){
+static TBResultNode* _run_AxisBoundOperation(TBGraphSession* session, TBRunContext* ctx, TBNode* node){
+    TBGraph* graph = ctx->graph;
     TBAxisBoundOperation* abop = (TBAxisBoundOperation*)node->nodePtr;
-    TBResultNode* uhs = _run_Node(session, graph, abop->uhs);
+    TBResultNode* uhs = _run_Node(session, ctx, abop->uhs);
+    
+    if(uhs->error != NULL){
+        return uhs;
+    }
+    
+    TBResultNode* res = NULL;
     
     switch(abop->type){
         case TBABOT_SUM:
-            return _tb_sum(session, graph, node, uhs, abop);
+            res = _tb_sum(session, graph, node, uhs, abop);
             break;
         case TBABOT_PRODUCT:
-            return _tb_product(session, graph, node, uhs, abop);
+            res = _tb_product(session, graph, node, uhs, abop);
             break;
         case TBABOT_MIN:
-            return _tb_min(session, graph, node, uhs, abop);
+            res = _tb_min(session, graph, node, uhs, abop);
             break;
         case TBABOT_MAX:
-            return _tb_max(session, graph, node, uhs, abop);
+            res = _tb_max(session, graph, node, uhs, abop);
             break;
         case TBABOT_MEAN:
-            return _tb_mean(session, graph, node, uhs, abop);
+            res = _tb_mean(session, graph, node, uhs, abop);
             break;
         case TBABOT_VARIANCE:
-            // TODO: Implement
-            return NULL;
+            res = _tb_variance(session, graph, node, uhs, abop);
             break;
         case TBABOT_SOFTMAX:
-            return _tb_softmax(session, graph, node, uhs, abop);
+        case TBABOT_LOG_SOFTMAX:
+            res = _tb_softmax(session, graph, node, uhs, abop);
             break;
         case TBABOT_ARGMIN:
-            return _tb_argmin(session, graph, node, uhs, abop);
+            res = _tb_argmin(session, graph, node, uhs, abop);
             break;
         case TBABOT_ARGMAX:
-            return _tb_argmax(session, graph, node, uhs, abop);
+            res = _tb_argmax(session, graph, node, uhs, abop);
             break;
     }
-    return NULL;
+    
+    _tb_releaseOperand(uhs);
+    
+    return res;
 }
 
-static TBResultNode* _run_TransposeOperation(TBGraphSession* session, TBGraph* graph, TBNode* node){
+static TBResultNode* _run_TransposeOperation(TBGraphSession* session, TBRunContext* ctx, TBNode* node){
+    TBGraph* graph = ctx->graph;
     TBTransposeOperation* top = (TBTransposeOperation*)node->nodePtr;
-    TBResultNode* uhs = _run_Node(session, graph, top->uhs);
+    TBResultNode* uhs = _run_Node(session, ctx, top->uhs);
     
-    return _tb_transpose(session, graph, node, uhs, top);
+    if(uhs->error != NULL){
+        return uhs;
+    }
+    
+    TBResultNode* res = _tb_transpose(session, graph, node, uhs, top);
+    _tb_releaseOperand(uhs);
+    
+    return res;
 }
 
-void tb_freeSession(struct TBGraphSession* session){
+static TBResultNode* _run_QuantizationOperation(TBGraphSession* session, TBRunContext* ctx, TBNode* node){
+    TBGraph* graph = ctx->graph;
+    TBQuantizationOperation* qop = (TBQuantizationOperation*)node->nodePtr;
+    TBResultNode* uhs = _run_Node(session, ctx, qop->uhs);
+    
+    if(uhs->error != NULL){
+        return uhs;
+    }
+    
+    TBResultNode* res = _tb_quantization(session, graph, node, uhs, qop);
+    _tb_releaseOperand(uhs);
+    
+    return res;
+}
+
+static TBResultNode* _run_GatherOperation(TBGraphSession* session, TBRunContext* ctx, TBNode* node){
+    TBGraph* graph = ctx->graph;
+    TBGatherOperation* gop = (TBGatherOperation*)node->nodePtr;
+    
+    // the derivative of the table is created as a row list, no table-sized derivative is allocated
+    _tb_contextEntry(ctx, gop->table)->row_sparse = 1;
+    TBResultNode* table = _run_Node(session, ctx, gop->table);
+    
+    if(table->error != NULL){
+        return table;
+    }
+    
+    TBResultNode* indices = _run_Node(session, ctx, gop->indices);
+    
+    if(indices->error != NULL){
+        _tb_releaseOperand(table);
+        return indices;
+    }
+    
+    TBResultNode* res = _tb_gather(session, graph, node, table, indices, gop);
+    _tb_releaseOperand(table);
+    _tb_releaseOperand(indices);
+    
+    return res;
+}
+
+static TBResultNode* _run_CrossEntropyOperation(TBGraphSession* session, TBRunContext* ctx, TBNode* node){
+    TBGraph* graph = ctx->graph;
+    TBCrossEntropyOperation* ceop = (TBCrossEntropyOperation*)node->nodePtr;
+    TBResultNode* logits = _run_Node(session, ctx, ceop->logits);
+    
+    if(logits->error != NULL){
+        return logits;
+    }
+    
+    TBResultNode* labels = _run_Node(session, ctx, ceop->labels);
+    
+    if(labels->error != NULL){
+        _tb_releaseOperand(logits);
+        return labels;
+    }
+    
+    TBResultNode* res = _tb_crossEntropy(session, graph, node, logits, labels, ceop);
+    _tb_releaseOperand(logits);
+    _tb_releaseOperand(labels);
+    
+    return res;
+}
+
+static TBResultNode* _run_NormalizationOperation(TBGraphSession* session, TBRunContext* ctx, TBNode* node){
+    TBGraph* graph = ctx->graph;
+    TBNormalizationOperation* nop = (TBNormalizationOperation*)node->nodePtr;
+    TBResultNode* uhs = _run_Node(session, ctx, nop->uhs);
+    TBResultNode* gamma = NULL;
+    TBResultNode* beta = NULL;
+    
+    if(uhs->error != NULL){
+        return uhs;
+    }
+    
+    if((nop->gamma != NULL) && ((gamma = _run_Node(session, ctx, nop->gamma))->error != NULL)){
+        _tb_releaseOperand(uhs);
+        return gamma;
+    }
+    
+    if((nop->beta != NULL) && ((beta = _run_Node(session, ctx, nop->beta))->error != NULL)){
+        _tb_releaseOperand(uhs);
+        _tb_releaseOperand(gamma);
+        return beta;
+    }
+    
+    // mean and rstd of every group are kept for the derivatives
+    TBContextEntry* entry = _tb_contextEntry(ctx, node);
+    uint64_t groups = _tb_normalizationGroups(nop, uhs->value->shape);
+    
+    if((entry->saved != NULL) && (entry->saved->shape->dims[0] != groups)){
+        nda_free(entry->saved);
+        free(entry->saved);
+        entry->saved = NULL;
+    }
+    
+    if(entry->saved == NULL){
+        entry->saved = nda_alloc(nda_newShape(2, groups, 2));
+    }
+    
+    TBResultNode* res = _tb_normalization(session, graph, node, uhs, gamma, beta, nop, entry->saved);
+    _tb_releaseOperand(uhs);
+    _tb_releaseOperand(gamma);
+    _tb_releaseOperand(beta);
+    
+    return res;
+}
+
+static TBResultNode* _run_ConvolutionOperation(TBGraphSession* session, TBRunContext* ctx, TBNode* node){
+    TBGraph* graph = ctx->graph;
+    TBConvolutionOperation* cop = (TBConvolutionOperation*)node->nodePtr;
+    TBResultNode* uhs = _run_Node(session, ctx, cop->uhs);
+    
+    if(uhs->error != NULL){
+        return uhs;
+    }
+    
+    TBResultNode* weights = _run_Node(session, ctx, cop->weights);
+    
+    if(weights->error != NULL){
+        _tb_releaseOperand(uhs);
+        return weights;
+    }
+    
+    TBResultNode* res = _tb_convolution(session, graph, node, uhs, weights, cop);
+    _tb_releaseOperand(uhs);
+    _tb_releaseOperand(weights);
+    
+    return res;
+}
+
+static TBResultNode* _run_PoolingOperation(TBGraphSession* session, TBRunContext* ctx, TBNode* node){
+    TBGraph* graph = ctx->graph;
+    TBPoolingOperation* pop = (TBPoolingOperation*)node->nodePtr;
+    TBResultNode* uhs = _run_Node(session, ctx, pop->uhs);
+    
+    if(uhs->error != NULL){
+        return uhs;
+    }
+    
+    if((pop->type != TBPOT_MAX) && (pop->type != TBPOT_GLOBAL_MAX)){
+        TBResultNode* res = _tb_pooling(session, graph, node, uhs, pop, NULL);
+        _tb_releaseOperand(uhs);
+        
+        return res;
+    }
+    
+    // positions of the maxima are kept for the derivative
+    TBContextEntry* entry = _tb_contextEntry(ctx, node);
+    NDShape* shape = tb_poolingOpShape(pop, uhs->value->shape, NULL);
+    
+    if((entry->saved != NULL) && ((shape == NULL) || !tb_shapeEquals(entry->saved->shape, shape))){
+        nda_free(entry->saved);
+        free(entry->saved);
+        entry->saved = NULL;
+    }
+    
+    if((entry->saved == NULL) && (shape != NULL)){
+        entry->saved = nda_allocType(shape, NDA_DTYPE_I64);
+    }
+    else if(shape != NULL){
+        free(shape->dims);
+        free(shape->strides);
+        free(shape);
+    }
+    
+    TBResultNode* res = _tb_pooling(session, graph, node, uhs, pop, entry->saved);
+    _tb_releaseOperand(uhs);
+    
+    return res;
+}
+
+static TBResultNode* _run_ReorderOperation(TBGraphSession* session, TBRunContext* ctx, TBNode* node){
+    TBReorderOperation* rop = (TBReorderOperation*)node->nodePtr;
+    TBResultNode* uhs = _run_Node(session, ctx, rop->uhs);
+    
+    if(uhs->error != NULL){
+        return uhs;
+    }
+    
+    TBResultNode* res = _tb_reorder(session, ctx->graph, node, uhs, rop);
+    _tb_releaseOperand(uhs);
+    
+    return res;
+}
+
+/* * * * * * * * * * *
+ * Prepared run API  *
+ * * * * * * * * * * */
+
+static uint64_t _tb_pushStep(TBPreparedRun* run, TBNode* node, uint64_t lhs, uint64_t rhs, NDArray* value, uint8_t owned){
+    if(run->steps_len == run->steps_cap){
+        run->steps_cap = run->steps_cap?2*run->steps_cap:16;
+        run->steps = realloc(run->steps, run->steps_cap*sizeof(TBPreparedStep));
+    }
+    
+    TBPreparedStep* step = run->steps + run->steps_len;
+    step->node = node;
+    step->lhs = lhs;
+    step->rhs = rhs;
+    step->aux = TB_NO_SLOT;
+    step->value = value;
+    step->owned = owned;
+    step->view = 0;
+    step->packs = NULL;
+    
+    return run->steps_len++;
+}
+
+static uint64_t _tb_planErrorMsg(TBPreparedRun* run, TBErrorType type, const char* msg, TBNode* node, TBGraph* graph){
+    TBResultNode* res = tb_newErrorResultNode(type, msg, node, graph);
+    run->result.error = res->error;
+    free(res);
+    
+    return TB_NO_SLOT;
+}
+
+static uint8_t _tb_planHasNode(TBPreparedRun* run, TBNode* node){
+    uint64_t i = 0;
+    for(; i < run->steps_len; i++){
+        if(run->steps[i].node == node)
+            return 1;
+    }
+    
+    return 0;
+}
+
+/*
+ * Packs of the constant RHS of a DOT product step, packed while planning. Runs reach them without a lookup and
+ * only repack them once the constant has changed.
+ */
+static TBPackedWeights* _tb_planPacks(TBPreparedRun* run, uint64_t lhs, uint64_t rhs){
+    TBPackedWeights* packs = _tb_sessionPackEntry(run->session, run->graph, run->steps[rhs].node);
+    
+    if(packs == NULL)
+        return NULL;
+    
+    if(_tb_isQuantizedDot(run->steps[lhs].value, run->steps[rhs].value))
+        _tb_quantizedWeights(packs);
+    else if(_tb_packedDotApplies(run->steps[lhs].value, run->steps[rhs].value))
+        _tb_packedWeights(packs);
+    
+    return packs;
+}
+
+/*
+ * Graph being planned, nested graphs resolve their parameters in the scope of their parent
+ * without binding them into the (shared) nested graph. Output shapes come from `tb_inferShapes`.
+ */
+typedef struct TBPlanScope {
+    TBGraph* graph;
+    TBGraphNodeParam** params;
+    struct TBPlanScope* parent;
+    TBGraphShapes* shapes;
+}TBPlanScope;
+
+/*
+ * Appends the steps needed to evaluate `node` and returns the index of the step holding its value, operands
+ * shared by several nodes are evaluated once. Returns TB_NO_SLOT and sets the run error on failure.
+ */
+static uint64_t _tb_planNode(TBPreparedRun* run, TBPlanScope* scope, TBNode* node){
+    TBGraph* graph = scope->graph;
+    uint64_t i = 0;
+    for(; i < run->steps_len; i++){
+        if(run->steps[i].node == node)
+            return i;
+    }
+    
+    uint64_t lhs = TB_NO_SLOT;
+    uint64_t rhs = TB_NO_SLOT;
+    uint64_t aux = TB_NO_SLOT;
+    NDDType dtype = NDA_DTYPE_FLOAT;
+    NDQuantParams* quant = NULL;
+    TBPackedWeights* packs = NULL;
+    
+    switch(node->type){
+        case TBNT_VARIABLE:{
+            TBVariable* var = (TBVariable*)node->nodePtr;
+            
+            for(i = 0; (scope->params != NULL) && (scope->params[i]->node != NULL) && (scope->params[i]->var_name != NULL); i++){
+                if(strcmp(scope->params[i]->var_name, var->name) == 0)
+                    return _tb_planNode(run, scope->parent, scope->params[i]->node);
+            }
+            
+            uint64_t slot = tb_graphVarNodeSlot(graph, node);
+            
+            if((scope->parent == NULL) && (slot != TB_NO_SLOT) && (run->inputs[slot] != NULL)){
+                // variable nodes sharing a name share the step of their slot
+                for(i = 0; i < run->steps_len; i++){
+                    TBNode* n = run->steps[i].node;
+                    if((n->type == TBNT_VARIABLE) && (tb_graphVarNodeSlot(graph, n) == slot))
+                        return i;
+                }
+                
+                return _tb_pushStep(run, node, lhs, rhs, run->inputs[slot], 0);
+            }
+            
+            TBNode* n = (slot != TB_NO_SLOT)?graph->slots.data[slot]:tb_graphGetVar(graph, var->name);
+            
+            if(n == NULL){
+                char msg[1024] = {0};
+                snprintf(msg, 1024, "Graph `%s` runtime error, variable `%s` does not exist", graph->name, var->name);
+                return _tb_planErrorMsg(run, TBET_VARIABLE_DOES_NOT_EXIST, msg, node, graph);
+            }
+            
+            return _tb_planNode(run, scope, n);
+        }
+        case TBNT_CONSTANT:
+            return _tb_pushStep(run, node, lhs, rhs, ((TBConstant*)node->nodePtr)->value, 0);
+        case TBNT_GRAPH:{
+            TBGraphNode* graphNode = (TBGraphNode*)node->nodePtr;
+            TBGraph* g = graphNode->graph;
+            
+            ASSERT(g != NULL, "Cannot start NULL nested graph");
+            
+            TBPlanScope nested = {g, graphNode->params, scope, scope->shapes};
+            
+            return _tb_planNode(run, &nested, g->root);
+        }
+        case TBNT_BINARY_OPERATION:{
+            TBBinaryOperation* op = (TBBinaryOperation*)node->nodePtr;
+            
+            if((lhs = _tb_planNode(run, scope, op->lhs)) == TB_NO_SLOT)
+                return TB_NO_SLOT;
+            if((rhs = _tb_planNode(run, scope, op->rhs)) == TB_NO_SLOT)
+                return TB_NO_SLOT;
+            
+            dtype = tb_binaryOpDType(op->type, run->steps[lhs].value->dtype, run->steps[rhs].value->dtype);
+            
+            if(op->type == TBBOT_DOT){
+                packs = _tb_planPacks(run, lhs, rhs);
+            }
+            break;
+        }
+        case TBNT_UNARY_OPERATION:{
+            TBUnaryOperation* op = (TBUnaryOperation*)node->nodePtr;
+            
+            if((lhs = _tb_planNode(run, scope, op->uhs)) == TB_NO_SLOT)
+                return TB_NO_SLOT;
+            
+            dtype = tb_unaryOpDType(op->type, run->steps[lhs].value->dtype);
+            break;
+        }
+        case TBNT_AXIS_BOUND_OPERATION:{
+            TBAxisBoundOperation* abop = (TBAxisBoundOperation*)node->nodePtr;
+            
+            if((lhs = _tb_planNode(run, scope, abop->uhs)) == TB_NO_SLOT)
+                return TB_NO_SLOT;
+            
+            dtype = tb_axisBoundOpDType(abop, run->steps[lhs].value->dtype);
+            break;
+        }
+        case TBNT_AXES_TRANSPOSE:{
+            TBTransposeOperation* top = (TBTransposeOperation*)node->nodePtr;
+            
+            if((lhs = _tb_planNode(run, scope, top->uhs)) == TB_NO_SLOT)
+                return TB_NO_SLOT;
+            
+            dtype = run->steps[lhs].value->dtype;
+            quant = run->steps[lhs].value->quant;
+            
+            if((quant != NULL) && (quant->count > 1)){
+                quant = nda_copyQuantParams(quant);
+                quant->axis += (run->steps[lhs].value->shape->rank == 1);
+                quant->axis = (quant->axis == top->axis1) ? top->axis2 : ((quant->axis == top->axis2) ? top->axis1 : quant->axis);
+            }
+            else {
+                quant = nda_copyQuantParams(quant);
+            }
+            break;
+        }
+        case TBNT_QUANTIZATION:{
+            TBQuantizationOperation* qop = (TBQuantizationOperation*)node->nodePtr;
+            TBNode* uhs = qop->uhs;
+            
+            // QUANTIZE(DOT(a, w)) of quantized operands is a single step requantizing the int32 accumulators
+            if((qop->type == TBQOT_QUANTIZE) && (uhs->type == TBNT_BINARY_OPERATION) &&
+               (((TBBinaryOperation*)uhs->nodePtr)->type == TBBOT_DOT) && !_tb_planHasNode(run, uhs)){
+                TBBinaryOperation* op = (TBBinaryOperation*)uhs->nodePtr;
+                
+                if((lhs = _tb_planNode(run, scope, op->lhs)) == TB_NO_SLOT)
+                    return TB_NO_SLOT;
+                if((rhs = _tb_planNode(run, scope, op->rhs)) == TB_NO_SLOT)
+                    return TB_NO_SLOT;
+                
+                if(_tb_isQuantizedDot(run->steps[lhs].value, run->steps[rhs].value))
+                    packs = _tb_planPacks(run, lhs, rhs);
+                else
+                    rhs = TB_NO_SLOT;
+            }
+            
+            if((rhs == TB_NO_SLOT) && ((lhs = _tb_planNode(run, scope, uhs)) == TB_NO_SLOT))
+                return TB_NO_SLOT;
+            
+            dtype = tb_quantizationOpDType(qop, run->steps[lhs].value->dtype);
+            
+            if(qop->type == TBQOT_QUANTIZE){
+                quant = nda_newQuantParams(1, 0, qop->zero_point);
+                quant->scales[0] = qop->scale;
+            }
+            break;
+        }
+        case TBNT_GATHER:{
+            TBGatherOperation* gop = (TBGatherOperation*)node->nodePtr;
+            
+            if((lhs = _tb_planNode(run, scope, gop->table)) == TB_NO_SLOT)
+                return TB_NO_SLOT;
+            if((rhs = _tb_planNode(run, scope, gop->indices)) == TB_NO_SLOT)
+                return TB_NO_SLOT;
+            
+            dtype = tb_gatherOpDType(gop, run->steps[lhs].value->dtype);
+            quant = _tb_gatherQuant(run->steps[lhs].value->quant, run->steps[rhs].value->shape->rank);
+            break;
+        }
+        case TBNT_CROSS_ENTROPY:{
+            TBCrossEntropyOperation* ceop = (TBCrossEntropyOperation*)node->nodePtr;
+            
+            if((lhs = _tb_planNode(run, scope, ceop->logits)) == TB_NO_SLOT)
+                return TB_NO_SLOT;
+            if((rhs = _tb_planNode(run, scope, ceop->labels)) == TB_NO_SLOT)
+                return TB_NO_SLOT;
+            break;
+        }
+        case TBNT_NORMALIZATION:{
+            TBNormalizationOperation* nop = (TBNormalizationOperation*)node->nodePtr;
+            
+            if((lhs = _tb_planNode(run, scope, nop->uhs)) == TB_NO_SLOT)
+                return TB_NO_SLOT;
+            if((nop->gamma != NULL) && ((rhs = _tb_planNode(run, scope, nop->gamma)) == TB_NO_SLOT))
+                return TB_NO_SLOT;
+            if((nop->beta != NULL) && ((aux = _tb_planNode(run, scope, nop->beta)) == TB_NO_SLOT))
+                return TB_NO_SLOT;
+            break;
+        }
+        case TBNT_CONVOLUTION:{
+            TBConvolutionOperation* cop = (TBConvolutionOperation*)node->nodePtr;
+            
+            if((lhs = _tb_planNode(run, scope, cop->uhs)) == TB_NO_SLOT)
+                return TB_NO_SLOT;
+            if((rhs = _tb_planNode(run, scope, cop->weights)) == TB_NO_SLOT)
+                return TB_NO_SLOT;
+            
+            packs = _tb_sessionPackEntry(run->session, run->graph, run->steps[rhs].node);
+            _tb_convWeights(packs, cop, run->steps[lhs].value);
+            break;
+        }
+        case TBNT_POOLING:{
+            TBPoolingOperation* pop = (TBPoolingOperation*)node->nodePtr;
+            
+            if((lhs = _tb_planNode(run, scope, pop->uhs)) == TB_NO_SLOT)
+                return TB_NO_SLOT;
+            break;
+        }
+        case TBNT_REORDER:{
+            TBReorderOperation* rop = (TBReorderOperation*)node->nodePtr;
+            
+            if((lhs = _tb_planNode(run, scope, rop->uhs)) == TB_NO_SLOT)
+                return TB_NO_SLOT;
+            break;
+        }
+    }
+    
+    if(!_tb_isImplemented(node)){
+        nda_freeQuantParams(quant);
+        return _tb_planErrorMsg(run, TBET_OPERATION_NOT_IMPLEMENTED, "Operation is not implemented", node, graph);
+    }
+    
+    // a fused QUANTIZE(DOT) has the shape of its DOT product
+    NDShape* shape = tb_inferredNodeShape(scope->shapes, node);
+    ASSERT(shape != NULL, "No shape was inferred for a node of graph `%s`", graph->name);
+    
+    NDArray* value = nda_allocType(nda_copyShape(shape), dtype);
+    value->quant = quant;
+    
+    uint64_t step = _tb_pushStep(run, node, lhs, rhs, value, 1);
+    run->steps[step].aux = aux;
+    run->steps[step].packs = packs;
+    
+    return step;
+}
+
+static void _tb_freePlan(TBPreparedRun* run){
+    uint64_t i = 0;
+    for(; i < run->steps_len; i++){
+        if(run->steps[i].view){
+            run->steps[i].value->raw = NULL;
+        }
+        
+        if(run->steps[i].owned){
+            nda_free(run->steps[i].value);
+            free(run->steps[i].value);
+        }
+    }
+    
+    run->steps_len = 0;
+    run->planned = 0;
+    run->result.value = NULL;
+    
+    if(run->workspace.data != NULL){
+        nda_memFree(run->workspace.data);
+    }
+    
+    run->workspace.data = NULL;
+    run->workspace.size = 0;
+    
+    if(run->result.error != NULL){
+        free((char*)run->result.error->message);
+        free(run->result.error);
+        run->result.error = NULL;
+    }
+}
+
+/*
+ * Whether the kernel of `step` reads its operand `value` through strides, as do the broadcast, unary and DOT product
+ * kernels. DOT products only take matrices laid out by rows or by columns, see `_tb_blasMatrix`.
+ */
+static uint8_t _tb_readsStrided(TBPreparedStep* step, NDArray* value){
+    NDShape* shape = value->shape;
+    
+    switch(step->node->type){
+        case TBNT_UNARY_OPERATION:
+            return 1;
+        case TBNT_BINARY_OPERATION:
+            if(((TBBinaryOperation*)step->node->nodePtr)->type != TBBOT_DOT)
+                return 1;
+            
+            return (shape->rank == 2) && (((shape->strides[1] == 1) && (shape->strides[0] == shape->dims[1])) ||
+                                          ((shape->strides[0] == 1) && (shape->strides[1] == shape->dims[0])));
+        default:
+            return 0;
+    }
+}
+
+/*
+ * Transpositions of dense tb_float operands read by strided kernels only are planned as views of their operand,
+ * no element is moved. The output of the graph is always materialized.
+ */
+static void _tb_planViews(TBPreparedRun* run){
+    uint64_t i = 0, j;
+    for(; i < run->steps_len; i++){
+        TBPreparedStep* step = run->steps + i;
+        NDArray* uhs = (step->lhs != TB_NO_SLOT) ? run->steps[step->lhs].value : NULL;
+        
+        if((step->node->type != TBNT_AXES_TRANSPOSE) || (i == run->root) || !step->owned ||
+           (uhs->dtype != NDA_DTYPE_FLOAT) || (uhs->quant != NULL) || (uhs->sparse != NULL))
+            continue;
+        
+        NDShape* shape = step->value->shape;
+        uint64_t strides[shape->rank];
+        void* raw = step->value->raw;
+        memcpy(strides, shape->strides, shape->rank*sizeof(uint64_t));
+        
+        _tb_transposeView((TBTransposeOperation*)step->node->nodePtr, step->value, uhs);
+        
+        uint8_t strided = 1;
+        for(j = i + 1; strided && (j < run->steps_len); j++){
+            TBPreparedStep* user = run->steps + j;
+            
+            if((user->lhs == i) || (user->rhs == i) || (user->aux == i))
+                strided = _tb_readsStrided(user, step->value);
+        }
+        
+        if(strided){
+            nda_memFree(raw);
+            step->view = 1;
+        }
+        else {
+            // materialized values keep their contiguous strides
+            memcpy(shape->strides, strides, shape->rank*sizeof(uint64_t));
+            step->value->raw = raw;
+        }
+    }
+}
+
+/*
+ * Bytes of scratch taken by the kernel of a step, see `_tb_scratch`
+ */
+static uint64_t _tb_stepWorkspace(TBPreparedRun* run, TBPreparedStep* step){
+    TBPreparedStep* steps = run->steps;
+    TBNode* node = step->node;
+    
+    switch(node->type){
+        case TBNT_BINARY_OPERATION:
+            // packed DOT products read their packs directly
+            if((step->packs != NULL) && (_tb_packedDotApplies(steps[step->lhs].value, steps[step->rhs].value) ||
+                                         _tb_isQuantizedDot(steps[step->lhs].value, steps[step->rhs].value)))
+                return 0;
+            
+            return _tb_binaryWorkspace(((TBBinaryOperation*)node->nodePtr)->type, step->value, steps[step->lhs].value, steps[step->rhs].value);
+        case TBNT_AXIS_BOUND_OPERATION:
+            return _tb_axisBoundWorkspace(run->session, (TBAxisBoundOperation*)node->nodePtr, step->value, steps[step->lhs].value);
+        case TBNT_CONVOLUTION:
+            return _tb_convolutionWorkspace((TBConvolutionOperation*)node->nodePtr, steps[step->lhs].value, steps[step->rhs].value,
+                                            (step->packs != NULL));
+        default:
+            return 0;
+    }
+}
+
+static void _tb_planRun(TBPreparedRun* run){
+    _tb_freePlan(run);
+    
+    run->planned = 1;
+    
+    NDShape* inputs[run->inputs_len + 1];
+    uint64_t i = 0;
+    for(; i < run->inputs_len; i++){
+        inputs[i] = (run->inputs[i] != NULL) ? run->inputs[i]->shape : NULL;
+    }
+    
+    // shape errors are reported by the inference, before any value is allocated
+    TBGraphShapes* shapes = tb_inferShapes(run->graph, inputs);
+    
+    if(shapes->root == TB_NO_SLOT){
+        run->root = TB_NO_SLOT;
+        run->result.error = shapes->error;
+        shapes->error = NULL;
+        tb_freeGraphShapes(shapes);
+        return;
+    }
+    
+    TBPlanScope scope = {run->graph, NULL, NULL, shapes};
+    run->root = _tb_planNode(run, &scope, run->graph->root);
+    tb_freeGraphShapes(shapes);
+    
+    if(run->root == TB_NO_SLOT){
+        return;
+    }
+    
+    _tb_planViews(run);
+    
+    // steps run one at a time, the workspace is sized for the most demanding one
+    for(i = 0; i < run->steps_len; i++){
+        uint64_t bytes = _tb_stepWorkspace(run, run->steps + i);
+        run->workspace.size = (bytes > run->workspace.size) ? bytes : run->workspace.size;
+    }
+    
+    if(run->workspace.size != 0){
+        run->workspace.data = nda_memCalloc(run->workspace.size, 1);
+    }
+    
+    if(run->output == NULL){
+        return;
+    }
+    
+    TBPreparedStep* root = run->steps + run->root;
+    
+    if(!tb_shapeEquals(root->value->shape, run->output->shape)){
+        char msg[1024] = {0};
+        char* outputShapeInfo = nda_shapeToString(run->output->shape);
+        char* rootShapeInfo = nda_shapeToString(root->value->shape);
+        snprintf(msg, 1024, "Bound output of shape %s does not match graph `%s` output of shape %s", outputShapeInfo, run->graph->name, rootShapeInfo);
+        
+        free(outputShapeInfo);
+        free(rootShapeInfo);
+        
+        _tb_planErrorMsg(run, TBET_INCOMPATIBLE_DIMENTIONS_EXCEPTION, msg, root->node, run->graph);
+        return;
+    }
+    
+    if(root->value->dtype != run->output->dtype){
+        char msg[1024] = {0};
+        snprintf(msg, 1024, "Bound output of dtype %s does not match graph `%s` output of dtype %s", nda_dtypeName(run->output->dtype), run->graph->name, nda_dtypeName(root->value->dtype));
+        
+        _tb_planErrorMsg(run, TBET_INCOMPATIBLE_DIMENTIONS_EXCEPTION, msg, root->node, run->graph);
+        return;
+    }
+    
+    // the last operation writes directly into the caller memory
+    if(root->owned){
+        nda_free(root->value);
+        free(root->value);
+        root->value = run->output;
+        root->owned = 0;
+    }
+}
+
+TBPreparedRun* tb_prepareRun(TBGraphSession* session, TBGraph* graph){
+    ASSERT(graph != NULL, "Cannot prepare a run on a NULL Graph");
+    ASSERT(graph->root != NULL, "Root node of the graph %s must not be NULL", graph->name);
+    
+    tb_compileGraph(graph);
+    
+    TBPreparedRun* run = calloc(1, sizeof(TBPreparedRun));
+    run->session = session;
+    run->graph = graph;
+    run->inputs_len = graph->slots.length;
+    run->inputs = calloc(run->inputs_len + 1, sizeof(NDArray*));
+    
+    return run;
+}
+
+void tb_preparedBindInput(TBPreparedRun* run, uint64_t slot, NDArray* input){
+    ASSERT(slot < run->inputs_len, "Slot %"PRIu64" is not a variable slot of graph `%s`", slot, run->graph->name);
+    
+    NDArray* previous = run->inputs[slot];
+    
+    if((previous == NULL) || (input == NULL) || !tb_shapeEquals(previous->shape, input->shape)){
+        run->planned = 0;
+    }
+    
+    run->inputs[slot] = input;
+}
+
+void tb_preparedBindOutput(TBPreparedRun* run, NDArray* output){
+    if(output != NULL){
+        NDShape* shape = output->shape;
+        ASSERT(shape->raw_len == 1 || shape->strides[shape->rank-1] == 1, "Bound output must be contiguous");
+    }
+    
+    if(run->planned && (run->result.error == NULL) && (run->output != NULL) && (output != NULL) &&
+       (run->output->dtype == output->dtype) && tb_shapeEquals(run->output->shape, output->shape)){
+        TBPreparedStep* root = run->steps + run->root;
+        
+        if(root->value == run->output){
+            root->value = output;
+        }
+        
+        run->output = output;
+        return;
+    }
+    
+    run->output = output;
+    run->planned = 0;
+}
+
+TBResultNode* tb_runPrepared(TBPreparedRun* run){
+    // planned buffers are charged to the session, steps allocate nothing
+    TBSessionMemory* memory = (run->session != NULL) ? run->session->memory : NULL;
+    NDMemTracker* previous = (memory != NULL) ? nda_memSetTracker(memory->tracker) : NULL;
+    
+    if(!run->planned){
+        _tb_planRun(run);
+    }
+    
+    if(run->result.error != NULL){
+        if(memory != NULL){
+            nda_memSetTracker(previous);
+        }
+        
+        return &run->result;
+    }
+    
+    TBPreparedStep* steps = run->steps;
+    TBProfiler* profiler = (run->session != NULL) ? run->session->profiler : NULL;
+    TBWorkspace* workspace = _tb_setWorkspace(&run->workspace);
+    uint64_t i = 0;
+    
+    for(; i < run->steps_len; i++){
+        TBPreparedStep* step = steps + i;
+        TBNode* node = step->node;
+        uint8_t profiled = (profiler != NULL) && (node->type != TBNT_VARIABLE) && (node->type != TBNT_CONSTANT);
+        TBProfileScope scope;
+        
+        run->workspace.used = 0;
+        
+        if(profiled){
+            _tb_profileBegin(&scope);
+        }
+        
+        switch(node->type){
+            case TBNT_VARIABLE:
+                step->value = run->inputs[tb_graphVarNodeSlot(run->graph, node)];
+                break;
+            case TBNT_CONSTANT:
+                step->value = ((TBConstant*)node->nodePtr)->value;
+                break;
+            case TBNT_BINARY_OPERATION:{
+                TBBinaryOperationType type = ((TBBinaryOperation*)node->nodePtr)->type;
+                TBPackedMatrix* packed = ((step->packs != NULL) && _tb_packedDotApplies(steps[step->lhs].value, steps[step->rhs].value)) ?
+                                         _tb_packedWeights(step->packs) : NULL;
+                
+                if(packed != NULL)
+                    _tb_packedDotInto(run->session, step->value, steps[step->lhs].value, packed);
+                else if((step->packs != NULL) && _tb_isQuantizedDot(steps[step->lhs].value, steps[step->rhs].value))
+                    _tb_quantizedDotInto(run->session, step->value, steps[step->lhs].value, steps[step->rhs].value,
+                                         _tb_quantizedWeights(step->packs), 1.0f, 0);
+                else
+                    _tb_binaryInto(run->session, type, step->value, steps[step->lhs].value, steps[step->rhs].value);
+                break;
+            }
+            case TBNT_UNARY_OPERATION:
+                _tb_unaryInto(run->session, ((TBUnaryOperation*)node->nodePtr)->type, step->value, steps[step->lhs].value);
+                break;
+            case TBNT_AXIS_BOUND_OPERATION:
+                _tb_axisBoundInto(run->session, (TBAxisBoundOperation*)node->nodePtr, step->value, steps[step->lhs].value);
+                break;
+            case TBNT_AXES_TRANSPOSE:
+                // views follow the data of their operand, bound inputs can change between runs
+                if(step->view)
+                    _tb_transposeView((TBTransposeOperation*)node->nodePtr, step->value, steps[step->lhs].value);
+                else
+                    _tb_transposeInto(run->session, (TBTransposeOperation*)node->nodePtr, step->value, steps[step->lhs].value);
+                break;
+            case TBNT_QUANTIZATION:{
+                TBQuantizationOperation* qop = (TBQuantizationOperation*)node->nodePtr;
+                
+                // fused steps read the operands of the DOT
+                if(step->rhs != TB_NO_SLOT){
+                    TBQGemmPacked* packed = _tb_quantizedWeights(step->packs);
+                    _tb_quantizedDotInto(run->session, step->value, steps[step->lhs].value, steps[step->rhs].value, packed, qop->scale, qop->zero_point);
+                }
+                else {
+                    _tb_quantizationInto(run->session, qop, step->value, steps[step->lhs].value);
+                }
+                break;
+            }
+            case TBNT_GATHER:
+                _tb_gatherInto(run->session, (TBGatherOperation*)node->nodePtr, step->value, steps[step->lhs].value, steps[step->rhs].value);
+                break;
+            case TBNT_CROSS_ENTROPY:
+                _tb_crossEntropyInto(run->session, (TBCrossEntropyOperation*)node->nodePtr, step->value, steps[step->lhs].value, steps[step->rhs].value);
+                break;
+            case TBNT_NORMALIZATION:
+                // statistics are only needed by the derivatives, prepared runs do not keep them
+                _tb_normalizationInto(run->session, (TBNormalizationOperation*)node->nodePtr, step->value, steps[step->lhs].value,
+                                      (step->rhs != TB_NO_SLOT) ? steps[step->rhs].value : NULL,
+                                      (step->aux != TB_NO_SLOT) ? steps[step->aux].value : NULL, NULL);
+                break;
+            case TBNT_CONVOLUTION:{
+                TBConvolutionOperation* cop = (TBConvolutionOperation*)node->nodePtr;
+                _tb_convolutionInto(run->session, cop, step->value, steps[step->lhs].value, steps[step->rhs].value,
+                                    _tb_convWeights(step->packs, cop, steps[step->lhs].value));
+                break;
+            }
+            case TBNT_POOLING:
+                _tb_poolingInto(run->session, (TBPoolingOperation*)node->nodePtr, step->value, steps[step->lhs].value, NULL);
+                break;
+            case TBNT_REORDER:
+                _tb_reorderInto((TBReorderOperation*)node->nodePtr, step->value, steps[step->lhs].value);
+                break;
+            case TBNT_GRAPH:
+                break;
+        }
+        
+        // steps write into planned buffers and take their scratch from the workspace, nothing is allocated
+        if(profiled){
+            _tb_profileEnd(profiler, &scope, node, step->value, (step->lhs != TB_NO_SLOT) ? steps[step->lhs].value : NULL,
+                           (step->rhs != TB_NO_SLOT) ? steps[step->rhs].value : NULL, 0, 1);
+        }
+    }
+    
+    _tb_setWorkspace(workspace);
+    
+    NDArray* value = steps[run->root].value;
+    
+    // the graph output is an input or a constant, there is no operation to write into the bound output
+    if((run->output != NULL) && (value != run->output)){
+        memcpy(run->output->raw, value->raw, value->shape->raw_len*nda_dtypeSize(value->dtype));
+        value = run->output;
+    }
+    
+    run->result.value = value;
+    
+    if(memory != NULL){
+        nda_memSetTracker(previous);
+    }
+    
+    return &run->result;
+}
+
+void tb_freePreparedRun(TBPreparedRun* run){
+    _tb_freePlan(run);
+    
+    free(run->steps);
+    free(run->inputs);
+    free(run);
+}
+
+void tb_freeSession(struct TBGraphSession* session){
+    int i = 0;
+    for(; i < session->contexts.length; i++){
+        _tb_freeContext(session->contexts.data[i]);
+    }
+    
+    for(i = 0; i < session->packs.length; i++){
+        TBPackedWeights* entry = session->packs.data[i];
+        
+        if(entry->packed != NULL)
+            _tb_freePackedMatrix(entry->packed);
+        if(entry->quantized != NULL)
+            tb_qgemmFreePacked(entry->quantized);
+        if(entry->conv != NULL)
+            nda_memFree(entry->conv);
+        free(entry);
+    }
+    
+    if(session->profiler != NULL){
+        _tb_freeProfiler(session->profiler);
+    }
+    
+    // reported once the session has released its own tensors
+    if(session->memory != NULL){
+        _tb_freeSessionMemory(session->memory);
+    }
+    
+    vec_deinit(&session->contexts);
+    vec_deinit(&session->packs);
+    pthread_mutex_destroy(&session->lock);
+    tb_freeThreadPool(session->pool);
     free(session);
 }
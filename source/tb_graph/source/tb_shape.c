@@ -0,0 +1,854 @@
+
+/****************************************************************************
+ * Copyright (C) 2019 by Soulaymen Chouri                                   *
+ *                                                                          *
+ * This file is part of TensorBolt.                                         *
+ *                                                                          *
+ * What follows is the Modified BSD License.                                *
+ *     See also http://www.opensource.org/licenses/BSD-3-Clause             *
+ * Copyright (c) 2019, Soulaymen Chouri. All rights reserved.               *
+ * Redistribution and use in source and binary forms, with or without       *
+ * modification, are permitted provided that the following conditions       *
+ * are met:                                                                 *
+ *                                                                          *
+ *      1. Redistributions of source code must retain the above copyright   *
+ *         notice, this list of conditions and the following disclaimer.    *
+ *                                                                          *
+ *      2. Redistributions in binary form must reproduce the above          *
+ *         copyright notice, this list of conditions and the following      *
+ *         disclaimer in the documentation and/or other materials provided  *
+ *         with the distribution.                                           *
+ *                                                                          *
+ *      3. Neither the name of the author nor the names of other            *
+ *         contributors may be used to endorse or promote products derived  *
+ *         from this software without specific prior written permission.    *
+ *                                                                          *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR      *
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED           *
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE   *
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY DIRECT,      *
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES       *
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR       *
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)       *
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,      *
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING    *
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+ * POSSIBILITY OF SUCH DAMAGE.                                              *
+ ****************************************************************************/
+
+/**
+ * @file tb_shape.c
+ * @author Soulaymen Chouri
+ * @date October 18 2026
+ * @brief File containing output shape computation of graph operations.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <ndarray.h>
+#include <ndarray_std.h>
+
+#include <tb_graph.h>
+#include <tb_errors.h>
+#include <tb_operation.h>
+#include <tb_factory.h>
+#include <tb_shape.h>
+
+static NDShape* _tb_shapeError(TBError** error, TBErrorType type, const char* msg){
+    if(error != NULL){
+        *error = calloc(1, sizeof(TBError));
+        (*error)->errorType = type;
+        (*error)->message = strdup(msg);
+    }
+    
+    return NULL;
+}
+
+/*
+ * Writes a dimension, symbolic dimensions are written as ?k
+ */
+static char* _tb_dimString(uint64_t dim, char* buffer, uint64_t size){
+    if(TB_IS_SYMBOLIC_DIM(dim))
+        snprintf(buffer, size, "?%"PRIu64, dim & ~TB_DIM_SYMBOLIC);
+    else
+        snprintf(buffer, size, "%"PRIu64, dim);
+    
+    return buffer;
+}
+
+static char* _tb_shapeString(NDShape* shape, char* buffer, uint64_t size){
+    char dim[32];
+    uint64_t i = 0, len = snprintf(buffer, size, "(");
+    
+    for(; (i < shape->rank) && (len < size); i++){
+        len += snprintf(buffer + len, size - len, (i == 0) ? "%s" : ", %s", _tb_dimString(shape->dims[i], dim, sizeof(dim)));
+    }
+    
+    if(len < size){
+        snprintf(buffer + len, size - len, ")");
+    }
+    
+    return buffer;
+}
+
+static NDShape* _tb_broadcastShape(NDShape* lhs, NDShape* rhs, TBError** error){
+    uint64_t rank = lhs->rank > rhs->rank?lhs->rank:rhs->rank;
+    uint64_t* dims = calloc(rank, sizeof(uint64_t));
+    
+    uint64_t i = 0;
+    for(; i < rank; i++){
+        uint64_t l = (i < rank - lhs->rank)?1:lhs->dims[i - (rank - lhs->rank)];
+        uint64_t r = (i < rank - rhs->rank)?1:rhs->dims[i - (rank - rhs->rank)];
+        
+        // a symbolic dimension may hold any value, it only matches itself or 1
+        if((l != r) && (l != 1) && (r != 1) && (TB_IS_SYMBOLIC_DIM(l) || TB_IS_SYMBOLIC_DIM(r))){
+            char msg[1024] = {0};
+            char lhsShapeInfo[256], rhsShapeInfo[256];
+            snprintf(msg, 1024, "Cannot broadcast shapes %s and %s, symbolic dimensions only broadcast with themselves or 1",
+                     _tb_shapeString(lhs, lhsShapeInfo, sizeof(lhsShapeInfo)), _tb_shapeString(rhs, rhsShapeInfo, sizeof(rhsShapeInfo)));
+            free(dims);
+            
+            return _tb_shapeError(error, TBET_INCOMPATIBLE_DIMENTIONS_EXCEPTION, msg);
+        }
+        
+        if((l != r) && (l != 1) && (r != 1)){
+            char msg[1024] = {0};
+            char* lhsShapeInfo = nda_shapeToString(lhs);
+            char* rhsShapeInfo = nda_shapeToString(rhs);
+            snprintf(msg, 1024, "Cannot broadcast shapes %s and %s", lhsShapeInfo, rhsShapeInfo);
+            
+            free(lhsShapeInfo);
+            free(rhsShapeInfo);
+            free(dims);
+            
+            return _tb_shapeError(error, TBET_INCOMPATIBLE_DIMENTIONS_EXCEPTION, msg);
+        }
+        
+        dims[i] = l > r?l:r;
+    }
+    
+    return nda_newShapeFromArray(rank, dims);
+}
+
+static NDShape* _tb_dotShape(NDShape* lhs, NDShape* rhs, TBError** error){
+    char msg[1024] = {0};
+    
+    if((lhs->rank > 2) || (rhs->rank > 2)){
+        snprintf(msg, 1024, "Cannot perform DOT product on shapes of ranks (%"PRIu64", %"PRIu64")", lhs->rank, rhs->rank);
+        return _tb_shapeError(error, TBET_INCOMPATIBLE_DIMENTIONS_EXCEPTION, msg);
+    }
+    
+    uint64_t lhsRows = lhs->rank > 1?lhs->dims[0]:1;
+    uint64_t lhsCols = lhs->rank > 1?lhs->dims[1]:lhs->dims[0];
+    uint64_t rhsRows = rhs->rank > 1?rhs->dims[0]:1;
+    uint64_t rhsCols = rhs->rank > 1?rhs->dims[1]:rhs->dims[0];
+    
+    if(lhsCols != rhsRows){
+        char d[4][32];
+        snprintf(msg, 1024, "Cannot perform DOT product on shapes (%s, %s) .  (%s, %s)", _tb_dimString(lhsRows, d[0], 32),
+                 _tb_dimString(lhsCols, d[1], 32), _tb_dimString(rhsRows, d[2], 32), _tb_dimString(rhsCols, d[3], 32));
+        return _tb_shapeError(error, TBET_INCOMPATIBLE_DIMENTIONS_EXCEPTION, msg);
+    }
+    
+    // when calculating the dot product over a vector as LHS, the output is a vector by default, unless LHS has been
+    // reshaped into a matrix of 1,m
+    if(lhs->rank == 1){
+        return nda_newShape(1, rhsCols);
+    }
+    
+    return nda_newShape(2, lhsRows, rhsCols);
+}
+
+NDShape* tb_binaryOpShape(TBBinaryOperationType type, NDShape* lhs, NDShape* rhs, TBError** error){
+    switch(type){
+        case TBBOT_ADD:
+        case TBBOT_SUB:
+        case TBBOT_MULT:
+        case TBBOT_DIV:
+        case TBBOT_POW:
+            return _tb_broadcastShape(lhs, rhs, error);
+        case TBBOT_DOT:
+            return _tb_dotShape(lhs, rhs, error);
+    }
+    
+    return _tb_shapeError(error, TBET_OPERATION_NOT_IMPLEMENTED, "Unknown binary operation");
+}
+
+NDShape* tb_unaryOpShape(TBUnaryOperationType type, NDShape* uhs, TBError** error){
+    (void)type;
+    (void)error;
+    
+    return nda_newShapeFromArrayCopy(uhs->rank, uhs->dims);
+}
+
+NDShape* tb_quantizationOpShape(TBQuantizationOperation* qop, NDShape* uhs, TBError** error){
+    (void)qop;
+    (void)error;
+    
+    return nda_newShapeFromArrayCopy(uhs->rank, uhs->dims);
+}
+
+NDShape* tb_axisBoundOpShape(TBAxisBoundOperation* abop, NDShape* uhs, TBError** error){
+    uint64_t axis = abop->axis;
+    
+    if(axis >= uhs->rank){
+        char msg[1024] = {0};
+        snprintf(msg, 1024, "Cannot compute axis bound operation on axis %"PRIu64" >= array of rank %"PRIu64, axis, uhs->rank);
+        return _tb_shapeError(error, TBET_INCOMPATIBLE_ARGS_EXCEPTION, msg);
+    }
+    
+    if((abop->type == TBABOT_SOFTMAX) || (abop->type == TBABOT_LOG_SOFTMAX)){
+        return nda_newShapeFromArrayCopy(uhs->rank, uhs->dims);
+    }
+    
+    if(uhs->rank == 1){
+        return nda_newShape(1, 1);
+    }
+    
+    uint64_t* dims = calloc(uhs->rank-1, sizeof(uint64_t));
+    uint64_t i = 0;
+    uint64_t j = 0;
+    for(; i < uhs->rank; i++){
+        if (i != axis){
+            dims[j++] = uhs->dims[i];
+        }
+    }
+    
+    return nda_newShapeFromArray(uhs->rank-1, dims);
+}
+
+NDShape* tb_transposeOpShape(TBTransposeOperation* top, NDShape* uhs, TBError** error){
+    uint64_t rank = uhs->rank == 1?2:uhs->rank;
+    
+    if((top->axis1 >= rank) || (top->axis2 >= rank)){
+        char msg[1024] = {0};
+        snprintf(msg, 1024, "Cannot transpose axes (%"PRIu64", %"PRIu64") of an array of rank %"PRIu64, top->axis1, top->axis2, uhs->rank);
+        return _tb_shapeError(error, TBET_INCOMPATIBLE_ARGS_EXCEPTION, msg);
+    }
+    
+    uint64_t* dims = calloc(rank, sizeof(uint64_t));
+    if(uhs->rank == 1){
+        dims[0] = 1;
+        dims[1] = uhs->dims[0];
+    }
+    else {
+        memcpy(dims, uhs->dims, rank*sizeof(uint64_t));
+    }
+    
+    uint64_t idim = dims[top->axis1];
+    dims[top->axis1] = dims[top->axis2];
+    dims[top->axis2] = idim;
+    
+    return nda_newShapeFromArray(rank, dims);
+}
+
+NDShape* tb_gatherOpShape(TBGatherOperation* gop, NDShape* table, NDShape* indices, TBError** error){
+    (void)gop;
+    
+    if(table->rank == 0){
+        return _tb_shapeError(error, TBET_INCOMPATIBLE_ARGS_EXCEPTION, "Cannot gather rows of a scalar table");
+    }
+    
+    uint64_t rank = indices->rank + table->rank - 1;
+    uint64_t* dims = calloc(rank, sizeof(uint64_t));
+    memcpy(dims, indices->dims, indices->rank*sizeof(uint64_t));
+    memcpy(dims + indices->rank, table->dims + 1, (table->rank - 1)*sizeof(uint64_t));
+    
+    return nda_newShapeFromArray(rank, dims);
+}
+
+NDShape* tb_crossEntropyOpShape(TBCrossEntropyOperation* ceop, NDShape* logits, NDShape* labels, TBError** error){
+    TBAxisBoundOperation reduce = {NULL, ceop->axis, TBABOT_SUM};
+    NDShape* shape = tb_axisBoundOpShape(&reduce, logits, error);
+    
+    if((shape == NULL) || tb_shapeEquals(labels, logits) || tb_shapeEquals(labels, shape)){
+        return shape;
+    }
+    
+    free(shape->dims);
+    free(shape->strides);
+    free(shape);
+    
+    return _tb_shapeError(error, TBET_INCOMPATIBLE_ARGS_EXCEPTION, "Labels of a cross-entropy must have the shape of the logits, or of the logits without the classes axis");
+}
+
+NDShape* tb_normalizationOpShape(TBNormalizationOperation* nop, NDShape* uhs, NDShape* gamma, NDShape* beta, TBError** error){
+    if(nop->axis >= uhs->rank){
+        char msg[1024] = {0};
+        snprintf(msg, 1024, "Cannot normalize on axis %"PRIu64" >= array of rank %"PRIu64, nop->axis, uhs->rank);
+        return _tb_shapeError(error, TBET_INCOMPATIBLE_ARGS_EXCEPTION, msg);
+    }
+    
+    uint64_t params = uhs->dims[nop->axis];
+    uint64_t i = nop->axis + 1;
+    uint8_t symbolic = TB_IS_SYMBOLIC_DIM(params);
+    for(; (nop->type == TBNOT_LAYER) && (i < uhs->rank); i++){
+        params *= uhs->dims[i];
+        symbolic |= TB_IS_SYMBOLIC_DIM(uhs->dims[i]);
+    }
+    
+    if(symbolic){
+        return _tb_shapeError(error, TBET_INCOMPATIBLE_DIMENTIONS_EXCEPTION, "Normalized dimensions cannot be symbolic");
+    }
+    
+    if(((gamma != NULL) && (gamma->raw_len != params)) || ((beta != NULL) && (beta->raw_len != params))){
+        char msg[1024] = {0};
+        snprintf(msg, 1024, "Normalization gamma and beta must hold %"PRIu64" values", params);
+        return _tb_shapeError(error, TBET_INCOMPATIBLE_DIMENTIONS_EXCEPTION, msg);
+    }
+    
+    return nda_newShapeFromArrayCopy(uhs->rank, uhs->dims);
+}
+
+/*
+ * Logical (N, C, H, W) dimensions of an image in a given layout, blocked images are (N, C/block, H, W, block).
+ * Returns 0 if the rank does not match the layout.
+ */
+static uint8_t _tb_imageDims(TBConvolutionLayout layout, NDShape* shape, uint64_t* dims, uint64_t* block){
+    uint8_t nhwc = (layout == TBCL_NHWC);
+    
+    if(shape->rank != ((layout == TBCL_NCHWC) ? 5 : 4))
+        return 0;
+    
+    dims[0] = shape->dims[0];
+    dims[1] = shape->dims[nhwc ? 3 : 1];
+    dims[2] = shape->dims[nhwc ? 1 : 2];
+    dims[3] = shape->dims[nhwc ? 2 : 3];
+    *block = 1;
+    
+    if(layout == TBCL_NCHWC){
+        *block = shape->dims[4];
+        dims[1] *= *block;
+    }
+    
+    return 1;
+}
+
+static uint8_t _tb_imageIsSymbolic(NDShape* shape){
+    uint64_t i = 1;
+    for(; i < shape->rank; i++){
+        if(TB_IS_SYMBOLIC_DIM(shape->dims[i]))
+            return 1;
+    }
+    
+    return 0;
+}
+
+#define TB_SYMBOLIC_IMAGE_MSG "Only the batch dimension of images can be symbolic"
+
+
+static NDShape* _tb_imageShape(TBConvolutionLayout layout, uint64_t N, uint64_t C, uint64_t H, uint64_t W, uint64_t block){
+    switch(layout){
+        case TBCL_NHWC:
+            return nda_newShape(4, N, H, W, C);
+        case TBCL_NCHWC:
+            return nda_newShape(5, N, C/block, H, W, block);
+        case TBCL_NCHW:
+            break;
+    }
+    
+    return nda_newShape(4, N, C, H, W);
+}
+
+NDShape* tb_convolutionOpShape(TBConvolutionOperation* cop, NDShape* uhs, NDShape* weights, TBError** error){
+    uint64_t dims[4], block;
+    
+    if(!_tb_imageDims(cop->layout, uhs, dims, &block) || (weights->rank != 4)){
+        return _tb_shapeError(error, TBET_INCOMPATIBLE_DIMENTIONS_EXCEPTION, "Convolution input must be of rank 4 (5 when blocked) and weights of rank 4");
+    }
+    
+    if(_tb_imageIsSymbolic(uhs) || tb_shapeIsSymbolic(weights)){
+        return _tb_shapeError(error, TBET_INCOMPATIBLE_DIMENTIONS_EXCEPTION, TB_SYMBOLIC_IMAGE_MSG);
+    }
+    
+    uint64_t C = dims[1];
+    uint64_t CO = weights->dims[0];
+    
+    if((cop->layout == TBCL_NCHWC) && ((cop->groups != 1) || (CO % block != 0))){
+        return _tb_shapeError(error, TBET_INCOMPATIBLE_ARGS_EXCEPTION, "Blocked convolutions take a single group and a multiple of the block of output channels");
+    }
+    
+    if((cop->groups == 0) || (C % cop->groups != 0) || (CO % cop->groups != 0) || (weights->dims[1]*cop->groups != C)){
+        char msg[1024] = {0};
+        snprintf(msg, 1024, "Convolution of %"PRIu64" input channels in %"PRIu64" groups cannot take weights of %"PRIu64" output and %"PRIu64" input channels",
+                 C, cop->groups, CO, weights->dims[1]);
+        return _tb_shapeError(error, TBET_INCOMPATIBLE_DIMENTIONS_EXCEPTION, msg);
+    }
+    
+    uint64_t out[2] = {0, 0};
+    uint64_t i = 0;
+    for(; i < 2; i++){
+        uint64_t extent = dims[2 + i] + 2*cop->padding[i];
+        uint64_t kernel = cop->dilation[i]*(weights->dims[2 + i] - 1) + 1;
+        
+        if((cop->stride[i] == 0) || (cop->dilation[i] == 0) || (weights->dims[2 + i] == 0) || (kernel > extent)){
+            return _tb_shapeError(error, TBET_INCOMPATIBLE_ARGS_EXCEPTION, "Convolution kernel does not fit in the padded input, or null stride or dilation");
+        }
+        
+        out[i] = (extent - kernel)/cop->stride[i] + 1;
+    }
+    
+    return _tb_imageShape(cop->layout, dims[0], CO, out[0], out[1], block);
+}
+
+NDShape* tb_poolingOpShape(TBPoolingOperation* pop, NDShape* uhs, TBError** error){
+    uint64_t dims[4], block;
+    
+    if(!_tb_imageDims(pop->layout, uhs, dims, &block)){
+        return _tb_shapeError(error, TBET_INCOMPATIBLE_DIMENTIONS_EXCEPTION, "Pooling input must be of rank 4 (5 when blocked)");
+    }
+    
+    if(_tb_imageIsSymbolic(uhs)){
+        return _tb_shapeError(error, TBET_INCOMPATIBLE_DIMENTIONS_EXCEPTION, TB_SYMBOLIC_IMAGE_MSG);
+    }
+    
+    uint8_t global = (pop->type == TBPOT_GLOBAL_MAX) || (pop->type == TBPOT_GLOBAL_AVG);
+    uint64_t out[2] = {1, 1};
+    uint64_t i = 0;
+    
+    for(; !global && (i < 2); i++){
+        uint64_t extent = dims[2 + i] + 2*pop->padding[i];
+        
+        if((pop->stride[i] == 0) || (pop->window[i] == 0) || (pop->padding[i] >= pop->window[i]) || (pop->window[i] > extent)){
+            return _tb_shapeError(error, TBET_INCOMPATIBLE_ARGS_EXCEPTION, "Pooling window does not fit in the padded input, or null stride or padding not smaller than the window");
+        }
+        
+        out[i] = (extent - pop->window[i])/pop->stride[i] + 1;
+    }
+    
+    return _tb_imageShape(pop->layout, dims[0], dims[1], out[0], out[1], block);
+}
+
+NDShape* tb_reorderOpShape(TBReorderOperation* rop, NDShape* uhs, TBError** error){
+    uint64_t dims[4], block;
+    
+    if(!_tb_imageDims(rop->from, uhs, dims, &block)){
+        return _tb_shapeError(error, TBET_INCOMPATIBLE_DIMENTIONS_EXCEPTION, "Reorder input must be of rank 4 (5 when blocked)");
+    }
+    
+    if(_tb_imageIsSymbolic(uhs)){
+        return _tb_shapeError(error, TBET_INCOMPATIBLE_DIMENTIONS_EXCEPTION, TB_SYMBOLIC_IMAGE_MSG);
+    }
+    
+    if((rop->block == 0) || ((rop->from == TBCL_NCHWC) && (block != rop->block)) || ((rop->to == TBCL_NCHWC) && (dims[1] % rop->block != 0))){
+        char msg[1024] = {0};
+        snprintf(msg, 1024, "Cannot reorder %"PRIu64" channels in blocks of %"PRIu64, dims[1], rop->block);
+        return _tb_shapeError(error, TBET_INCOMPATIBLE_ARGS_EXCEPTION, msg);
+    }
+    
+    return _tb_imageShape(rop->to, dims[0], dims[1], dims[2], dims[3], rop->block);
+}
+
+#undef TB_SYMBOLIC_IMAGE_MSG
+
+uint8_t tb_shapeEquals(NDShape* shape1, NDShape* shape2){
+    if(shape1->rank != shape2->rank)
+        return 0;
+    
+    uint64_t i = 0;
+    for(; i < shape1->rank; i++){
+        if(shape1->dims[i] != shape2->dims[i])
+            return 0;
+    }
+    
+    return 1;
+}
+
+uint8_t tb_shapeIsSymbolic(NDShape* shape){
+    uint64_t i = 0;
+    for(; i < shape->rank; i++){
+        if(TB_IS_SYMBOLIC_DIM(shape->dims[i]))
+            return 1;
+    }
+    
+    return 0;
+}
+
+NDShape* tb_concreteShape(NDShape* shape, uint64_t* symbols, uint64_t symbols_len){
+    uint64_t* dims = calloc(shape->rank + 1, sizeof(uint64_t));
+    uint64_t i = 0;
+    
+    for(; i < shape->rank; i++){
+        uint64_t symbol = shape->dims[i] & ~TB_DIM_SYMBOLIC;
+        
+        if(!TB_IS_SYMBOLIC_DIM(shape->dims[i])){
+            dims[i] = shape->dims[i];
+        }
+        else if(symbol < symbols_len){
+            dims[i] = symbols[symbol];
+        }
+        else {
+            free(dims);
+            return NULL;
+        }
+    }
+    
+    return nda_newShapeFromArray(shape->rank, dims);
+}
+
+/*
+ * Floating point results are F64 as soon as an operand is, whatever tb_float is, so that double data is not
+ * rounded to single precision on its way through the graph.
+ */
+static inline NDDType _tb_floatDType(NDDType lhs, NDDType rhs){
+    return ((lhs == NDA_DTYPE_F64) || (rhs == NDA_DTYPE_F64)) ? NDA_DTYPE_F64 : NDA_DTYPE_FLOAT;
+}
+
+NDDType tb_binaryOpDType(TBBinaryOperationType type, NDDType lhs, NDDType rhs){
+    uint8_t integer = (lhs == rhs) && ((lhs == NDA_DTYPE_I32) || (lhs == NDA_DTYPE_I64));
+    
+    if(integer && ((type == TBBOT_ADD) || (type == TBBOT_SUB) || (type == TBBOT_MULT)))
+        return lhs;
+    
+    return _tb_floatDType(lhs, rhs);
+}
+
+NDDType tb_unaryOpDType(TBUnaryOperationType type, NDDType uhs){
+    if((type == TBUOT_MINUS) && ((uhs == NDA_DTYPE_I32) || (uhs == NDA_DTYPE_I64)))
+        return uhs;
+    
+    return _tb_floatDType(uhs, uhs);
+}
+
+NDDType tb_axisBoundOpDType(TBAxisBoundOperation* abop, NDDType uhs){
+    if((abop->type == TBABOT_ARGMIN) || (abop->type == TBABOT_ARGMAX))
+        return NDA_DTYPE_I64;
+    
+    return _tb_floatDType(uhs, uhs);
+}
+
+NDDType tb_quantizationOpDType(TBQuantizationOperation* qop, NDDType uhs){
+    (void)uhs;
+    
+    if(qop->type == TBQOT_QUANTIZE)
+        return qop->dtype;
+    
+    return NDA_DTYPE_FLOAT;
+}
+
+NDDType tb_gatherOpDType(TBGatherOperation* gop, NDDType table){
+    (void)gop;
+    
+    return table;
+}
+
+/* * * * * * * * * * *
+ * Shape inference   *
+ * * * * * * * * * * */
+
+/*
+ * Graph being inferred, nested graphs resolve their parameters in the scope of their parent like prepared runs do
+ */
+typedef struct TBShapeScope {
+    TBGraph* graph;
+    TBGraphNodeParam** params;
+    struct TBShapeScope* parent;
+}TBShapeScope;
+
+static uint64_t _tb_pushNodeShape(TBGraphShapes* shapes, TBNode* node, TBGraph* graph, NDShape* shape, NDDType dtype,
+                                  uint64_t lhs, uint64_t rhs, uint64_t aux){
+    if(shapes->nodes_len == shapes->nodes_cap){
+        shapes->nodes_cap = shapes->nodes_cap ? 2*shapes->nodes_cap : 16;
+        shapes->nodes = realloc(shapes->nodes, shapes->nodes_cap*sizeof(TBNodeShape));
+    }
+    
+    TBNodeShape* n = shapes->nodes + shapes->nodes_len;
+    n->node = node;
+    n->graph = graph;
+    n->shape = shape;
+    n->dtype = dtype;
+    n->lhs = lhs;
+    n->rhs = rhs;
+    n->aux = aux;
+    
+    if((graph == shapes->graph) && tb_graphOwnsNode(graph, node)){
+        shapes->index[node->id] = shapes->nodes_len;
+    }
+    
+    return shapes->nodes_len++;
+}
+
+/*
+ * Gives a node the output of another one, e.g a variable the output of the node bound to it
+ */
+static uint64_t _tb_aliasNodeShape(TBGraphShapes* shapes, TBGraph* graph, TBNode* node, uint64_t index){
+    if((index != TB_NO_SLOT) && (graph == shapes->graph) && tb_graphOwnsNode(graph, node)){
+        shapes->index[node->id] = index;
+    }
+    
+    return index;
+}
+
+static uint64_t _tb_inferError(TBGraphShapes* shapes, TBError* error, TBNode* node, TBGraph* graph){
+    error->faultyNode = node;
+    error->graph = graph;
+    shapes->error = error;
+    
+    return TB_NO_SLOT;
+}
+
+static uint64_t _tb_inferErrorMsg(TBGraphShapes* shapes, TBErrorType type, const char* msg, TBNode* node, TBGraph* graph){
+    TBResultNode* res = tb_newErrorResultNode(type, msg, node, graph);
+    shapes->error = res->error;
+    free(res);
+    
+    return TB_NO_SLOT;
+}
+
+/*
+ * Infers the operands of `node` then the node itself, returns its index or TB_NO_SLOT and sets the error on
+ * failure. Walks the graph like the planning of prepared runs, which takes its shapes from here.
+ */
+static uint64_t _tb_inferNode(TBGraphShapes* shapes, NDShape** inputs, TBShapeScope* scope, TBNode* node){
+    TBGraph* graph = scope->graph;
+    uint64_t i = 0;
+    
+    if((graph == shapes->graph) && tb_graphOwnsNode(graph, node)){
+        if(shapes->index[node->id] != TB_NO_SLOT)
+            return shapes->index[node->id];
+    }
+    else {
+        for(; i < shapes->nodes_len; i++){
+            if(shapes->nodes[i].node == node)
+                return i;
+        }
+    }
+    
+    uint64_t lhs = TB_NO_SLOT;
+    uint64_t rhs = TB_NO_SLOT;
+    uint64_t aux = TB_NO_SLOT;
+    TBError* error = NULL;
+    NDShape* shape = NULL;
+    NDDType dtype = NDA_DTYPE_FLOAT;
+    
+#define INFER_OPERAND(idx, operand) if(((idx) = _tb_inferNode(shapes, inputs, scope, (operand))) == TB_NO_SLOT) return TB_NO_SLOT
+#define OPERAND_SHAPE(idx) (shapes->nodes[(idx)].shape)
+#define OPERAND_DTYPE(idx) (shapes->nodes[(idx)].dtype)
+    
+    switch(node->type){
+        case TBNT_VARIABLE:{
+            TBVariable* var = (TBVariable*)node->nodePtr;
+            
+            for(i = 0; (scope->params != NULL) && (scope->params[i]->node != NULL) && (scope->params[i]->var_name != NULL); i++){
+                if(strcmp(scope->params[i]->var_name, var->name) == 0)
+                    return _tb_aliasNodeShape(shapes, graph, node, _tb_inferNode(shapes, inputs, scope->parent, scope->params[i]->node));
+            }
+            
+            uint64_t slot = tb_graphVarNodeSlot(graph, node);
+            
+            if((scope->parent == NULL) && (slot != TB_NO_SLOT) && (inputs != NULL) && (inputs[slot] != NULL)){
+                // variable nodes sharing a name share the input of their slot
+                for(i = 0; i < shapes->nodes_len; i++){
+                    TBNode* n = shapes->nodes[i].node;
+                    if((n->type == TBNT_VARIABLE) && (shapes->nodes[i].graph == graph) && (tb_graphVarNodeSlot(graph, n) == slot))
+                        return _tb_aliasNodeShape(shapes, graph, node, i);
+                }
+                
+                return _tb_pushNodeShape(shapes, node, graph, nda_copyShape(inputs[slot]), NDA_DTYPE_FLOAT, lhs, rhs, aux);
+            }
+            
+            TBNode* n = (slot != TB_NO_SLOT) ? graph->slots.data[slot] : tb_graphGetVar(graph, var->name);
+            
+            if(n == NULL){
+                char msg[1024] = {0};
+                snprintf(msg, 1024, "Graph `%s` shape error, variable `%s` has neither input shape nor binding", graph->name, var->name);
+                return _tb_inferErrorMsg(shapes, TBET_VARIABLE_DOES_NOT_EXIST, msg, node, graph);
+            }
+            
+            return _tb_aliasNodeShape(shapes, graph, node, _tb_inferNode(shapes, inputs, scope, n));
+        }
+        case TBNT_CONSTANT:{
+            NDArray* value = ((TBConstant*)node->nodePtr)->value;
+            return _tb_pushNodeShape(shapes, node, graph, nda_copyShape(value->shape), value->dtype, lhs, rhs, aux);
+        }
+        case TBNT_GRAPH:{
+            TBGraphNode* graphNode = (TBGraphNode*)node->nodePtr;
+            TBGraph* g = graphNode->graph;
+            
+            ASSERT(g != NULL, "Cannot infer NULL nested graph");
+            tb_compileGraph(g);
+            
+            TBShapeScope nested = {g, graphNode->params, scope};
+            
+            return _tb_aliasNodeShape(shapes, graph, node, _tb_inferNode(shapes, inputs, &nested, g->root));
+        }
+        case TBNT_BINARY_OPERATION:{
+            TBBinaryOperation* op = (TBBinaryOperation*)node->nodePtr;
+            INFER_OPERAND(lhs, op->lhs);
+            INFER_OPERAND(rhs, op->rhs);
+            
+            shape = tb_binaryOpShape(op->type, OPERAND_SHAPE(lhs), OPERAND_SHAPE(rhs), &error);
+            dtype = tb_binaryOpDType(op->type, OPERAND_DTYPE(lhs), OPERAND_DTYPE(rhs));
+            break;
+        }
+        case TBNT_UNARY_OPERATION:{
+            TBUnaryOperation* op = (TBUnaryOperation*)node->nodePtr;
+            INFER_OPERAND(lhs, op->uhs);
+            
+            shape = tb_unaryOpShape(op->type, OPERAND_SHAPE(lhs), &error);
+            dtype = tb_unaryOpDType(op->type, OPERAND_DTYPE(lhs));
+            break;
+        }
+        case TBNT_AXIS_BOUND_OPERATION:{
+            TBAxisBoundOperation* abop = (TBAxisBoundOperation*)node->nodePtr;
+            INFER_OPERAND(lhs, abop->uhs);
+            
+            shape = tb_axisBoundOpShape(abop, OPERAND_SHAPE(lhs), &error);
+            dtype = tb_axisBoundOpDType(abop, OPERAND_DTYPE(lhs));
+            break;
+        }
+        case TBNT_AXES_TRANSPOSE:{
+            TBTransposeOperation* top = (TBTransposeOperation*)node->nodePtr;
+            INFER_OPERAND(lhs, top->uhs);
+            
+            shape = tb_transposeOpShape(top, OPERAND_SHAPE(lhs), &error);
+            dtype = OPERAND_DTYPE(lhs);
+            break;
+        }
+        case TBNT_QUANTIZATION:{
+            TBQuantizationOperation* qop = (TBQuantizationOperation*)node->nodePtr;
+            INFER_OPERAND(lhs, qop->uhs);
+            
+            shape = tb_quantizationOpShape(qop, OPERAND_SHAPE(lhs), &error);
+            dtype = tb_quantizationOpDType(qop, OPERAND_DTYPE(lhs));
+            break;
+        }
+        case TBNT_GATHER:{
+            TBGatherOperation* gop = (TBGatherOperation*)node->nodePtr;
+            INFER_OPERAND(lhs, gop->table);
+            INFER_OPERAND(rhs, gop->indices);
+            
+            shape = tb_gatherOpShape(gop, OPERAND_SHAPE(lhs), OPERAND_SHAPE(rhs), &error);
+            dtype = tb_gatherOpDType(gop, OPERAND_DTYPE(lhs));
+            break;
+        }
+        case TBNT_CROSS_ENTROPY:{
+            TBCrossEntropyOperation* ceop = (TBCrossEntropyOperation*)node->nodePtr;
+            INFER_OPERAND(lhs, ceop->logits);
+            INFER_OPERAND(rhs, ceop->labels);
+            
+            shape = tb_crossEntropyOpShape(ceop, OPERAND_SHAPE(lhs), OPERAND_SHAPE(rhs), &error);
+            break;
+        }
+        case TBNT_NORMALIZATION:{
+            TBNormalizationOperation* nop = (TBNormalizationOperation*)node->nodePtr;
+            INFER_OPERAND(lhs, nop->uhs);
+            if(nop->gamma != NULL){
+                INFER_OPERAND(rhs, nop->gamma);
+            }
+            if(nop->beta != NULL){
+                INFER_OPERAND(aux, nop->beta);
+            }
+            
+            shape = tb_normalizationOpShape(nop, OPERAND_SHAPE(lhs), (rhs != TB_NO_SLOT) ? OPERAND_SHAPE(rhs) : NULL,
+                                            (aux != TB_NO_SLOT) ? OPERAND_SHAPE(aux) : NULL, &error);
+            break;
+        }
+        case TBNT_CONVOLUTION:{
+            TBConvolutionOperation* cop = (TBConvolutionOperation*)node->nodePtr;
+            INFER_OPERAND(lhs, cop->uhs);
+            INFER_OPERAND(rhs, cop->weights);
+            
+            shape = tb_convolutionOpShape(cop, OPERAND_SHAPE(lhs), OPERAND_SHAPE(rhs), &error);
+            break;
+        }
+        case TBNT_POOLING:{
+            TBPoolingOperation* pop = (TBPoolingOperation*)node->nodePtr;
+            INFER_OPERAND(lhs, pop->uhs);
+            
+            shape = tb_poolingOpShape(pop, OPERAND_SHAPE(lhs), &error);
+            break;
+        }
+        case TBNT_REORDER:{
+            TBReorderOperation* rop = (TBReorderOperation*)node->nodePtr;
+            INFER_OPERAND(lhs, rop->uhs);
+            
+            shape = tb_reorderOpShape(rop, OPERAND_SHAPE(lhs), &error);
+            break;
+        }
+    }
+    
+#undef INFER_OPERAND
+#undef OPERAND_SHAPE
+#undef OPERAND_DTYPE
+    
+    if(shape == NULL){
+        return _tb_inferError(shapes, error, node, graph);
+    }
+    
+    return _tb_pushNodeShape(shapes, node, graph, shape, dtype, lhs, rhs, aux);
+}
+
+TBGraphShapes* tb_inferShapes(TBGraph* graph, NDShape** inputs){
+    ASSERT(graph != NULL, "Cannot infer the shapes of a NULL Graph");
+    ASSERT(graph->root != NULL, "Root node of the graph %s must not be NULL", graph->name);
+    
+    tb_compileGraph(graph);
+    
+    TBGraphShapes* shapes = calloc(1, sizeof(TBGraphShapes));
+    shapes->graph = graph;
+    shapes->index = malloc((graph->nodes.length + 1)*sizeof(uint64_t));
+    
+    int i = 0;
+    for(; i < graph->nodes.length; i++){
+        shapes->index[i] = TB_NO_SLOT;
+    }
+    
+    TBShapeScope scope = {graph, NULL, NULL};
+    shapes->root = _tb_inferNode(shapes, inputs, &scope, graph->root);
+    
+    return shapes;
+}
+
+TBError* tb_inferGraphShapes(TBGraph* graph, NDShape** inputs){
+    if(graph->shapes != NULL){
+        tb_freeGraphShapes(graph->shapes);
+    }
+    
+    graph->shapes = tb_inferShapes(graph, inputs);
+    
+    return graph->shapes->error;
+}
+
+NDShape* tb_inferredNodeShape(TBGraphShapes* shapes, TBNode* node){
+    if(tb_graphOwnsNode(shapes->graph, node)){
+        uint64_t i = shapes->index[node->id];
+        return (i != TB_NO_SLOT) ? shapes->nodes[i].shape : NULL;
+    }
+    
+    uint64_t i = 0;
+    for(; i < shapes->nodes_len; i++){
+        if(shapes->nodes[i].node == node)
+            return shapes->nodes[i].shape;
+    }
+    
+    return NULL;
+}
+
+NDShape* tb_graphNodeShape(TBGraph* graph, TBNode* node){
+    return (graph->shapes != NULL) ? tb_inferredNodeShape(graph->shapes, node) : NULL;
+}
+
+void tb_freeGraphShapes(TBGraphShapes* shapes){
+    uint64_t i = 0;
+    for(; i < shapes->nodes_len; i++){
+        if(shapes->nodes[i].shape != NULL){
+            free(shapes->nodes[i].shape->dims);
+            free(shapes->nodes[i].shape->strides);
+            free(shapes->nodes[i].shape);
+        }
+    }
+    
+    if(shapes->error != NULL){
+        free((char*)shapes->error->message);
+        free(shapes->error);
+    }
+    
+    free(shapes->nodes);
+    free(shapes->index);
+    free(shapes);
+}
@@ -1,19 +1,35 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
 #include <inttypes.h>
 #include <stdint.h>
+#include <unistd.h>
 
 #include "minunit.h"
 #include "ndarray.h"
 #include "ndarray_std.h"
+#include "ndarray_io.h"
+#include "ndarray_cpu.h"
 
 #include <tb_session.h>
 #include <tb_graph.h>
 #include <tb_factory.h>
 #include <tb_ops.h>
+#include <tb_session_cpu.h>
 
 #include <tb_autograd.h>
+#include <tb_batcher.h>
+#include <tb_serialize.h>
+#include <tb_quantize.h>
+#include <tb_layout.h>
+#include <tb_gemm.h>
+#include <tb_profiler.h>
+#include <tb_memory.h>
+#include <tb_cost.h>
+#include <tb_shape.h>
 
 #define ASSERT_SHAPE_EQ(shape, values)\
 {\
@@ -561,6 +577,2394 @@ MU_TEST(test_min01){
     }
 }
 
+MU_TEST(test_var_slots){
+    NDArray* x = nda_linspace(0, 1, 4);
+    NDArray* y = nda_linspace(1, 2, 4);
+    
+    TBNode* n0 = tb_newVarNode("x");
+    TBNode* n1 = tb_newBinaryOpNode(TBBOT_MULT, n0, tb_newUnaryOpNode(TBUOT_MINUS, tb_newVarNode("x")));
+    TBGraph* g = tb_newGraph("test", n1);
+    
+    uint64_t slot = tb_graphGetVarSlot(g, "x");
+    mu_assert_int_eq(0, slot);
+    mu_check(tb_graphGetVarSlot(g, "y") == TB_NO_SLOT);
+    mu_assert_int_eq(1, g->slots.length);
+    mu_assert_int_eq(slot, ((TBVariable*)n0->nodePtr)->slot);
+    
+    tb_graphFeedSlot(g, slot, x);
+    TBResultNode* res = tb_runSession(NULL, g, NULL);
+    
+    uint64_t i = 0;
+    for(; i < 4; i++){
+        mu_assert_double_eq(-x->data[i]*x->data[i], nda_get1D(res->value, i));
+    }
+    
+    tb_graphFeedSlot(g, slot, y);
+    res = tb_runSession(NULL, g, NULL);
+    
+    for(i = 0; i < 4; i++){
+        mu_assert_double_eq(-y->data[i]*y->data[i], nda_get1D(res->value, i));
+    }
+    
+    // binding by name still works once the graph is compiled
+    tb_graphSetVar(g, tb_newConstantNode(x), "x");
+    mu_check(tb_graphGetVar(g, "x") == g->slots.data[slot]);
+    res = tb_runSession(NULL, g, NULL);
+    mu_assert_double_eq(-x->data[3]*x->data[3], nda_get1D(res->value, 3));
+}
+
+MU_TEST(test_argmax01){
+    tb_float values[] = {1, 5, 2,
+                         7, 0, 3};
+    NDArray* x = nda_alloc(nda_newShape(2, 2, 3));
+    memcpy(x->data, values, sizeof(values));
+    
+    TBNode* n0 = tb_newConstantNode(x);
+    TBResultNode* res = tb_runSession(NULL, tb_newGraph("test", tb_newAxisBoundOpNode(TBABOT_ARGMAX, n0, 1)), NULL);
+    mu_check(res->value->dtype == NDA_DTYPE_I64);
+    mu_check(((int64_t*)res->value->raw)[0] == 1);
+    mu_assert_double_eq(1, nda_get1D(res->value, 0));
+    mu_assert_double_eq(0, nda_get1D(res->value, 1));
+    
+    res = tb_runSession(NULL, tb_newGraph("test", tb_newAxisBoundOpNode(TBABOT_ARGMIN, n0, 0)), NULL);
+    mu_assert_double_eq(0, nda_get1D(res->value, 0));
+    mu_assert_double_eq(1, nda_get1D(res->value, 1));
+    mu_assert_double_eq(0, nda_get1D(res->value, 2));
+}
+
+MU_TEST(test_prepared_run){
+    NDArray* w = nda_linspace(-1, 1, 4*3);
+    nda_reshape(w, nda_newShape(2, 4, 3));
+    NDArray* b = nda_linspace(0, 1, 4);
+    
+    // relu(x . transpose(w) + b)
+    TBNode* wt = tb_newTransposeOpNode(tb_newConstantNode(w), 0, 1);
+    TBNode* dot = tb_newBinaryOpNode(TBBOT_DOT, tb_newVarNode("x"), wt);
+    TBNode* out = tb_newUnaryOpNode(TBUOT_RELU, tb_newBinaryOpNode(TBBOT_ADD, dot, tb_newConstantNode(b)));
+    TBGraph* g = tb_newGraph("test", out);
+    
+    uint64_t slot = tb_graphGetVarSlot(g, "x");
+    NDArray* x1 = nda_linspace(0, 1, 2*3);
+    nda_reshape(x1, nda_newShape(2, 2, 3));
+    NDArray* x2 = nda_linspace(-2, 1, 2*3);
+    nda_reshape(x2, nda_newShape(2, 2, 3));
+    NDArray* y = nda_alloc(nda_newShape(2, 2, 4));
+    
+    TBPreparedRun* run = tb_prepareRun(NULL, g);
+    tb_preparedBindInput(run, slot, x1);
+    tb_preparedBindOutput(run, y);
+    
+    TBResultNode* res = tb_runPrepared(run);
+    mu_check(res->error == NULL);
+    mu_check(res->value == y);
+    uint64_t steps_len = run->steps_len;
+    
+    // the DOT product reads the transposed weights in place
+    uint64_t i = 0;
+    for(; i < run->steps_len; i++){
+        if(run->steps[i].node == wt)
+            mu_check(run->steps[i].view && (run->steps[i].value->raw == w->raw));
+    }
+    
+    // steps take the shapes inferred for their nodes
+    NDShape* x_shape[] = {x1->shape};
+    TBGraphShapes* shapes = tb_inferShapes(g, x_shape);
+    for(i = 0; i < run->steps_len; i++){
+        mu_check(tb_shapeEquals(run->steps[i].value->shape, tb_inferredNodeShape(shapes, run->steps[i].node)));
+    }
+    tb_freeGraphShapes(shapes);
+    
+    tb_graphFeedSlot(g, slot, x1);
+    TBResultNode* gt = tb_runSession(NULL, g, NULL);
+    
+    for(i = 0; i < 8; i++){
+        mu_assert_double_eq(gt->value->data[i], y->data[i]);
+    }
+    
+    // same shape: buffers are reused, only the data changes
+    tb_preparedBindInput(run, slot, x2);
+    mu_check(run->planned);
+    res = tb_runPrepared(run);
+    mu_check(res->value == y);
+    mu_assert_int_eq(steps_len, run->steps_len);
+    
+    tb_graphFeedSlot(g, slot, x2);
+    gt = tb_runSession(NULL, g, NULL);
+    for(i = 0; i < 8; i++){
+        mu_assert_double_eq(gt->value->data[i], y->data[i]);
+    }
+    
+    // a different batch size does not match the bound output anymore
+    NDArray* x3 = nda_linspace(0, 1, 3);
+    tb_preparedBindInput(run, slot, x3);
+    res = tb_runPrepared(run);
+    mu_check(res->error != NULL);
+    mu_assert_int_eq(TBET_INCOMPATIBLE_DIMENTIONS_EXCEPTION, res->error->errorType);
+    
+    tb_preparedBindOutput(run, NULL);
+    res = tb_runPrepared(run);
+    mu_check(res->error == NULL);
+    mu_assert_int_eq(1, res->value->shape->rank);
+    mu_assert_int_eq(4, res->value->shape->dims[0]);
+    
+    // shape errors are reported on the faulty node before anything is planned
+    NDArray* x4 = nda_linspace(0, 1, 2*5);
+    nda_reshape(x4, nda_newShape(2, 2, 5));
+    tb_preparedBindInput(run, slot, x4);
+    res = tb_runPrepared(run);
+    mu_check(res->error != NULL);
+    mu_check(res->error->faultyNode == dot);
+    mu_assert_int_eq(0, run->steps_len);
+    
+    tb_freePreparedRun(run);
+    
+    // transposes read by strided kernels are views of their operand, the output is always materialized
+    NDArray* a1 = nda_linspace(-1, 1, 3*37*21);
+    nda_reshape(a1, nda_newShape(3, 3, 37, 21));
+    NDArray* a2 = nda_linspace(2, 5, 3*37*21);
+    nda_reshape(a2, nda_newShape(3, 3, 37, 21));
+    NDArray* at = nda_alloc(nda_newShape(3, 3, 21, 37));
+    TBNode* xt = tb_newTransposeOpNode(tb_newVarNode("x"), 1, 2);
+    TBGraph* gv = tb_newGraph("views", tb_newTransposeOpNode(tb_newUnaryOpNode(TBUOT_RELU, xt), 1, 2));
+    TBGraph* gt2 = tb_newGraph("transpose", tb_newTransposeOpNode(tb_newVarNode("x"), 1, 2));
+    
+    run = tb_prepareRun(NULL, gv);
+    tb_preparedBindInput(run, tb_graphGetVarSlot(gv, "x"), a1);
+    tb_runPrepared(run);
+    for(i = 0; i < run->steps_len; i++){
+        mu_check(run->steps[i].view == (run->steps[i].node == xt));
+    }
+    
+    tb_preparedBindInput(run, tb_graphGetVarSlot(gv, "x"), a2);
+    res = tb_runPrepared(run);
+    for(i = 0; i < a2->shape->raw_len; i++){
+        mu_assert_double_eq(a2->data[i] > 0 ? a2->data[i] : 0, res->value->data[i]);
+    }
+    tb_freePreparedRun(run);
+    
+    run = tb_prepareRun(NULL, gt2);
+    tb_preparedBindInput(run, tb_graphGetVarSlot(gt2, "x"), a1);
+    tb_preparedBindOutput(run, at);
+    mu_check(tb_runPrepared(run)->error == NULL);
+    
+    uint64_t c, r0;
+    for(i = 0; i < 3; i++)
+        for(r0 = 0; r0 < 37; r0++)
+            for(c = 0; c < 21; c++)
+                mu_assert_double_eq(a1->data[(i*37 + r0)*21 + c], at->data[(i*21 + c)*37 + r0]);
+    tb_freePreparedRun(run);
+    
+    // kernel scratch comes from the planned workspace and constant weights are packed once: runs allocate nothing
+    TBGraphSession* session = tb_createLocalCPUSession();
+    NDArray* img = nda_linspace(-1, 1, 2*16*12*12);
+    nda_reshape(img, nda_newShape(4, 2, 16, 12, 12));
+    NDArray* k3 = nda_linspace(-1, 1, 16*16*3*3);
+    nda_reshape(k3, nda_newShape(4, 16, 16, 3, 3));
+    NDArray* k2 = nda_linspace(-1, 1, 8*16*2*2);
+    nda_reshape(k2, nda_newShape(4, 8, 16, 2, 2));
+    NDArray* v = nda_linspace(-1, 1, 4*300);
+    nda_reshape(v, nda_newShape(2, 4, 300));
+    NDArray* h = nda_linspace(-1, 1, 300*40);
+    nda_reshape(h, nda_newShape(2, 300, 40));
+    NDArray* wh = nda_cast(h, NDA_DTYPE_F16);
+    
+    // Winograd then im2col convolutions, DOT product of F16 weights
+    TBNode* wino = tb_newConvolutionOpNode(tb_newVarNode("x"), tb_newConstantNode(k3), TBCL_NCHW, 1, 1, 1, 1, 1, 1, 1);
+    TBNode* conv = tb_newConvolutionOpNode(wino, tb_newConstantNode(k2), TBCL_NCHW, 1, 1, 0, 0, 1, 1, 1);
+    TBGraph* graphs[2] = {tb_newGraph("convs", tb_newAxisBoundOpNode(TBABOT_MEAN, conv, 3)),
+                          tb_newGraph("half", tb_newAxisBoundOpNode(TBABOT_VARIANCE, tb_newBinaryOpNode(TBBOT_DOT, tb_newVarNode("x"), tb_newConstantNode(wh)), 0))};
+    NDArray* inputs[2] = {img, v};
+    uint64_t r;
+    
+    for(i = 0; i < 2; i++){
+        run = tb_prepareRun(session, graphs[i]);
+        tb_preparedBindInput(run, tb_graphGetVarSlot(graphs[i], "x"), inputs[i]);
+        res = tb_runPrepared(run);
+        mu_check(res->error == NULL);
+        mu_check(run->workspace.size > 0);
+        
+        tb_graphFeedSlot(graphs[i], tb_graphGetVarSlot(graphs[i], "x"), inputs[i]);
+        gt = tb_runSession(NULL, graphs[i], NULL);
+        
+        NDMemCounters before = nda_memCounters(NULL);
+        for(r = 0; r < 3; r++){
+            res = tb_runPrepared(run);
+            mu_check(res->error == NULL);
+        }
+        NDMemCounters after = nda_memCounters(NULL);
+        mu_assert_int_eq(before.allocations, after.allocations);
+        mu_assert_int_eq(before.live, after.live);
+        
+        for(r = 0; r < gt->value->shape->raw_len; r++){
+            mu_assert_double_eq(gt->value->data[r], res->value->data[r]);
+        }
+        
+        tb_freePreparedRun(run);
+    }
+    
+    tb_freeSession(session);
+}
+
+typedef struct TBBatchClient {
+    TBBatcher* batcher;
+    NDArray* x;
+    NDArray* y;
+    TBError* error;
+}TBBatchClient;
+
+static void* _test_batch_client(void* arg){
+    TBBatchClient* client = (TBBatchClient*)arg;
+    client->error = tb_batcherRun(client->batcher, client->x, client->y);
+    
+    return NULL;
+}
+
+MU_TEST(test_batcher){
+    NDArray* w = nda_linspace(-1, 1, 3*2);
+    nda_reshape(w, nda_newShape(2, 3, 2));
+    
+    TBNode* out = tb_newBinaryOpNode(TBBOT_DOT, tb_newVarNode("x"), tb_newConstantNode(w));
+    TBGraph* g = tb_newGraph("test", out);
+    
+    NDShape* example = nda_newShape(1, 3);
+    TBBatcher* batcher = tb_newBatcher(NULL, g, tb_graphGetVarSlot(g, "x"), example, 8, 200);
+    mu_assert_int_eq(2, tb_batcherOutputLen(batcher));
+    
+    NDArray* x = nda_linspace(0, 1, 3);
+    NDArray* y = nda_alloc(nda_newShape(1, 2));
+    mu_check(tb_batcherRun(batcher, x, y) == NULL);
+    
+    uint64_t i = 0;
+    for(; i < 2; i++){
+        tb_float gt = x->data[0]*w->data[i] + x->data[1]*w->data[2+i] + x->data[2]*w->data[4+i];
+        mu_assert_double_eq(gt, y->data[i]);
+    }
+    
+    TBBatcherStats stats = tb_batcherLoadTest(batcher, 4, 32, x);
+    mu_assert_int_eq(4*32, stats.requests);
+    mu_check((stats.batches > 0) && (stats.batches <= stats.requests));
+    mu_check(stats.p50_us <= stats.p99_us);
+    mu_check(stats.p99_us <= stats.max_us);
+    
+    tb_freeBatcher(batcher);
+    
+    // 5 concurrent requests make a single batch padded to 8 rows, each one gets the output of its own unbatched run
+    batcher = tb_newBatcher(NULL, g, tb_graphGetVarSlot(g, "x"), example, 8, 100000);
+    TBPreparedRun* run = tb_prepareRun(NULL, g);
+    TBBatchClient clients[5];
+    pthread_t threads[5];
+    
+    for(i = 0; i < 5; i++){
+        NDArray* xi = nda_linspace(-(tb_float)i, (tb_float)(2*i + 1), 3);
+        clients[i].batcher = batcher;
+        clients[i].x = (i == 3) ? nda_cast(xi, NDA_DTYPE_F16) : xi;
+        clients[i].y = nda_alloc(nda_newShape(1, 2));
+        pthread_create(threads + i, NULL, _test_batch_client, clients + i);
+    }
+    
+    for(i = 0; i < 5; i++){
+        pthread_join(threads[i], NULL);
+        mu_check(clients[i].error == NULL);
+        
+        NDArray* xi = nda_cast(clients[i].x, NDA_DTYPE_FLOAT);
+        nda_reshape(xi, nda_newShape(2, 1, 3));
+        tb_preparedBindInput(run, tb_graphGetVarSlot(g, "x"), xi);
+        TBResultNode* res = tb_runPrepared(run);
+        mu_check(res->error == NULL);
+        
+        uint64_t j = 0;
+        for(; j < 2; j++){
+            mu_assert_double_eq(res->value->data[j], clients[i].y->data[j]);
+        }
+    }
+    
+    tb_freePreparedRun(run);
+    tb_freeBatcher(batcher);
+}
+
+typedef struct TBConcurrentRun {
+    TBGraph* graph;
+    NDArray* x;
+    NDArray* y;
+}TBConcurrentRun;
+
+static void* _test_concurrent_worker(void* arg){
+    TBConcurrentRun* run = (TBConcurrentRun*)arg;
+    TBGraphSession* session = tb_createLocalCPUSession();
+    
+    TBGraphNodeParam param = {tb_newConstantNode(run->x), "x"};
+    TBGraphNodeParam end = {NULL, NULL};
+    TBGraphNodeParam* params[] = {&param, &end};
+    
+    uint64_t i = 0;
+    for(; i < 100; i++){
+        TBResultNode* res = tb_runSession(session, run->graph, params);
+        memcpy(run->y->data, res->value->data, res->value->shape->raw_len*sizeof(tb_float));
+        tb_freeResultNode(run->graph, res);
+        free(res);
+    }
+    
+    tb_freeSession(session);
+    
+    return NULL;
+}
+
+MU_TEST(test_concurrent_sessions){
+    TBNode* n0 = tb_newVarNode("x");
+    TBNode* n1 = tb_newBinaryOpNode(TBBOT_MULT, n0, tb_newUnaryOpNode(TBUOT_EXP, n0));
+    TBGraph* g = tb_newGraph("test", n1);
+    
+    // the first runs compile the graph concurrently
+    TBConcurrentRun runs[4];
+    pthread_t threads[4];
+    
+    uint64_t i = 0;
+    for(; i < 4; i++){
+        runs[i].graph = g;
+        runs[i].x = nda_linspace(i, i+1, 16);
+        runs[i].y = nda_alloc(nda_newShape(1, 16));
+        pthread_create(threads + i, NULL, _test_concurrent_worker, runs + i);
+    }
+    
+    for(i = 0; i < 4; i++){
+        pthread_join(threads[i], NULL);
+    }
+    
+    // every session saw its own binding of `x`
+    uint64_t j = 0;
+    for(i = 0; i < 4; i++){
+        for(j = 0; j < 16; j++){
+            tb_float x = runs[i].x->data[j];
+            mu_assert_double_eq(x*expf(x), runs[i].y->data[j]);
+        }
+    }
+    
+    mu_check(g->compiled);
+}
+
+MU_TEST(test_session_transient_bindings){
+    TBNode* n0 = tb_newVarNode("x");
+    TBNode* n1 = tb_newUnaryOpNode(TBUOT_EXP, n0);
+    TBGraph* g = tb_newGraph("test", n1);
+    
+    NDArray* x = nda_linspace(0, 1, 8);
+    TBNode* nodes[64];
+    TBGraphSession* session = tb_createLocalCPUSession();
+    TBRunContext* ctx = _tb_sessionContext(session, g);
+    
+    // every run binds a new node, the state of the previous bindings is dropped
+    uint64_t i = 0;
+    for(; i < 64; i++){
+        nodes[i] = tb_newConstantNode(nda_copy(x));
+        TBGraphNodeParam param = {nodes[i], "x"};
+        TBGraphNodeParam end = {NULL, NULL};
+        TBGraphNodeParam* params[] = {&param, &end};
+        
+        TBResultNode* res = tb_runSession(session, g, params);
+        mu_assert_double_eq(expf(x->data[3]), res->value->data[3]);
+        tb_freeResultNode(g, res);
+        free(res);
+        
+        mu_check(ctx->extras_len <= 2);
+    }
+    
+    tb_freeSession(session);
+    tb_freeGraph(g);
+    
+    for(i = 0; i < 64; i++){
+        tb_freeNode(NULL, nodes[i]);
+        free(nodes[i]);
+    }
+    
+    nda_free(x);
+    free(x);
+}
+
+MU_TEST(test_session_diff){
+    NDArray* x = nda_linspace(1, 2, 4);
+    TBNode* c = tb_newConstantNode(x);
+    
+    TBNode* n0 = tb_newVarNode("x");
+    TBNode* n1 = tb_newBinaryOpNode(TBBOT_MULT, n0, tb_newConstantNode(nda_linspace(3, 3, 4)));
+    TBGraph* g = tb_newGraph("test", n1);
+    tb_graphSetVar(g, c, "x");
+    
+    TBGraphSession* session = tb_createLocalCPUSession();
+    tb_runSession(session, g, NULL);
+    mu_assert_double_eq(3*x->data[2], tb_sessionGetResult(session, g, n1)->value->data[2]);
+    
+    tb_autogradGraph(session, g);
+    
+    TBResultNode* diff = tb_sessionGetDiff(session, g, c);
+    mu_check(diff != NULL);
+    
+    uint64_t i = 0;
+    for(; i < 4; i++){
+        mu_assert_double_eq(3, diff->value->data[i]);
+    }
+    
+    // runs without session keep their own state
+    mu_check(tb_sessionGetResult(NULL, g, n1) == NULL);
+    
+    tb_freeSession(session);
+}
+
+MU_TEST(test_archive){
+    NDArray* a = nda_linspace(0, 11, 12);
+    nda_reshape(a, nda_newShape(2, 3, 4));
+    NDArray* b = nda_linspace(-1, 1, 5);
+    
+    // transposed view of a, saved in its logical order
+    uint64_t dims[] = {4, 3};
+    uint64_t strides[] = {1, 4};
+    NDShape tshape = {2, dims, 12, strides};
+    NDArray at = {{a->data}, &tshape, NDA_DTYPE_FLOAT, NULL, NULL};
+    
+    NDArray* h = nda_cast(b, NDA_DTYPE_F16);
+    const char* names[] = {"a", "b", "at", "h"};
+    NDArray* arrays[] = {a, b, &at, h};
+    
+    char path[] = "/tmp/tb_archive_XXXXXX";
+    int fd = mkstemp(path);
+    close(fd);
+    
+    mu_check(nda_saveArchive(path, 4, names, arrays));
+    
+    NDArchive* archive = nda_openArchive(path);
+    mu_check(archive != NULL);
+    mu_check(nda_archiveCount(archive) == 4);
+    mu_check(strcmp(nda_archiveName(archive, 1), "b") == 0);
+    
+    NDArray* la = nda_archiveGet(archive, "a");
+    mu_check(nda_archiveGet(archive, "h")->dtype == NDA_DTYPE_F16);
+    mu_assert_double_eq(0.5, nda_get1D(nda_archiveGet(archive, "h"), 3));
+    NDArray* lat = nda_archiveGet(archive, "at");
+    mu_check(nda_archiveGet(archive, "c") == NULL);
+    mu_check(((uintptr_t)la->data) % NDA_ARCHIVE_ALIGN == 0);
+    mu_check(la->shape->rank == 2 && la->shape->dims[0] == 3 && la->shape->dims[1] == 4);
+    mu_check(memcmp(la->data, a->data, 12*sizeof(tb_float)) == 0);
+    mu_check(memcmp(nda_archiveArray(archive, 1)->data, b->data, 5*sizeof(tb_float)) == 0);
+    
+    uint64_t i = 0;
+    uint64_t j = 0;
+    for(; i < 4; i++){
+        for(j = 0; j < 3; j++){
+            mu_assert_double_eq(a->data[j*4+i], lat->data[i*3+j]);
+        }
+    }
+    
+    nda_closeArchive(archive);
+    
+    // corrupted headers are rejected: an array count larger than the index, a misaligned index
+    FILE* file = fopen(path, "r+b");
+    uint64_t field = UINT64_MAX / 4;
+    uint64_t index_offset = 0;
+    mu_check(fseek(file, 16, SEEK_SET) == 0 && fwrite(&field, sizeof(uint64_t), 1, file) == 1);
+    fclose(file);
+    mu_check(nda_openArchive(path) == NULL);
+    
+    mu_check(nda_saveArchive(path, 4, names, arrays));
+    file = fopen(path, "r+b");
+    mu_check(fseek(file, 24, SEEK_SET) == 0 && fread(&index_offset, sizeof(uint64_t), 1, file) == 1);
+    index_offset += 4;
+    mu_check(fseek(file, 24, SEEK_SET) == 0 && fwrite(&index_offset, sizeof(uint64_t), 1, file) == 1);
+    fclose(file);
+    mu_check(nda_openArchive(path) == NULL);
+    
+    // truncated files are rejected
+    mu_check(truncate(path, 100) == 0);
+    mu_check(nda_openArchive(path) == NULL);
+    
+    unlink(path);
+    nda_free(a);
+    nda_free(b);
+}
+
+MU_TEST(test_graph_serialization){
+    // nested graph: y = exp(a) * w, a bound by the parent
+    TBNode* na = tb_newVarNode("a");
+    TBNode* nw = tb_newConstantNode(nda_linspace(1, 4, 4));
+    TBGraph* nested = tb_newGraph("nested", tb_newBinaryOpNode(TBBOT_MULT, tb_newUnaryOpNode(TBUOT_EXP, na), nw));
+    
+    TBNode* nx = tb_newVarNode("x");
+    TBNode* nb = tb_newVarNode("b");
+    
+    TBGraphNodeParam p0 = {tb_newConstantNode(nda_linspace(-2, 2, 4)), "a"};
+    TBGraphNodeParam end = {NULL, NULL};
+    TBGraphNodeParam* params[] = {&p0, &end};
+    
+    TBNode* nsum = tb_newBinaryOpNode(TBBOT_ADD, nx, nb);
+    TBNode* root = tb_newBinaryOpNode(TBBOT_MULT, tb_newAxisBoundOpNode(TBABOT_SUM, tb_newGraphNode(nested, params), 0), nsum);
+    TBGraph* g = tb_newGraph("outer", root);
+    tb_graphSetVar(g, tb_newConstantNode(nda_linspace(0.5, 0.5, 4)), "b");
+    
+    char path[] = "/tmp/tb_graph_XXXXXX";
+    int fd = mkstemp(path);
+    close(fd);
+    
+    mu_check(tb_saveGraph(g, path));
+    
+    TBGraph* loaded = tb_loadGraph(path);
+    mu_check(loaded != NULL);
+    mu_check(loaded->compiled);
+    mu_check(strcmp(loaded->name, "outer") == 0);
+    mu_check(loaded->root->type == TBNT_BINARY_OPERATION);
+    
+    NDArray* x = nda_linspace(-1, 1, 4);
+    uint64_t slot = tb_graphGetVarSlot(g, "x");
+    uint64_t lslot = tb_graphGetVarSlot(loaded, "x");
+    mu_check(lslot != TB_NO_SLOT);
+    
+    tb_graphFeedSlot(g, slot, x);
+    tb_graphFeedSlot(loaded, lslot, x);
+    
+    TBResultNode* expected = tb_runSession(NULL, g, NULL);
+    TBResultNode* res = tb_runSession(NULL, loaded, NULL);
+    mu_check(res->error == NULL);
+    
+    uint64_t i = 0;
+    for(; i < 4; i++){
+        mu_assert_double_eq(expected->value->data[i], res->value->data[i]);
+    }
+    
+    // fed tensors are not saved
+    char path2[] = "/tmp/tb_graph_XXXXXX";
+    fd = mkstemp(path2);
+    close(fd);
+    
+    mu_check(tb_saveGraph(loaded, path2));
+    TBGraph* reloaded = tb_loadGraph(path2);
+    mu_check(reloaded != NULL);
+    mu_check(reloaded->slots.data[tb_graphGetVarSlot(reloaded, "x")] == NULL);
+    
+    // corrupted files are rejected
+    FILE* file = fopen(path2, "r+b");
+    fseek(file, 72, SEEK_SET);
+    uint64_t garbage = UINT64_MAX;
+    fwrite(&garbage, sizeof(uint64_t), 1, file);
+    fclose(file);
+    mu_check(tb_loadGraph(path2) == NULL);
+    
+    unlink(path2);
+    unlink(path);
+}
+
+MU_TEST(test_half_precision){
+    mu_check(nda_floatToHalf(1.0f) == 0x3c00);
+    mu_check(nda_floatToHalf(-2.0f) == 0xc000);
+    mu_check(nda_floatToHalf(65504.0f) == 0x7bff);
+    mu_check(nda_floatToHalf(65520.0f) == 0x7c00);
+    mu_check(nda_floatToHalf(ldexpf(1, -24)) == 0x0001);
+    mu_check(nda_floatToHalf(NAN) == 0x7e00);
+    mu_check(nda_halfToFloat(0x0001) == ldexpf(1, -24));
+    mu_check(nda_halfToFloat(0x7bff) == 65504.0f);
+    
+    // ties round to even
+    mu_check(nda_floatToBf16(1.0f + ldexpf(1, -8)) == 0x3f80);
+    mu_check(nda_floatToBf16(1.0f + 3*ldexpf(1, -8)) == 0x3f82);
+    mu_check(nda_bf16ToFloat(0x3f82) == 1.0f + ldexpf(1, -6));
+    
+    NDArray* x = nda_linspace(-8, 8, 33);
+    NDArray* h = nda_cast(x, NDA_DTYPE_F16);
+    NDArray* back = nda_cast(h, NDA_DTYPE_FLOAT);
+    mu_check(h->dtype == NDA_DTYPE_F16);
+    mu_check(memcmp(back->data, x->data, 33*sizeof(tb_float)) == 0);
+    mu_assert_double_eq(x->data[3], nda_get1D(h, 3));
+    
+    // DOT with half precision weights spanning several tiles
+    NDArray* a = nda_randomNormal(nda_newShape(2, 3, 300), 0, 1);
+    NDArray* w = nda_cast(nda_randomNormal(nda_newShape(2, 300, 270), 0, 1), NDA_DTYPE_F16);
+    NDArray* wf = nda_cast(w, NDA_DTYPE_FLOAT);
+    
+    TBNode* node = tb_newBinaryOpNode(TBBOT_DOT, tb_newConstantNode(a), tb_newConstantNode(w));
+    TBNode* ref = tb_newBinaryOpNode(TBBOT_DOT, tb_newConstantNode(a), tb_newConstantNode(wf));
+    TBResultNode* res = tb_runSession(NULL, tb_newGraph("half", node), NULL);
+    TBResultNode* expected = tb_runSession(NULL, tb_newGraph("ref", ref), NULL);
+    
+    mu_check(res->value->dtype == NDA_DTYPE_FLOAT);
+    mu_check(res->value->shape->dims[0] == 3 && res->value->shape->dims[1] == 270);
+    
+    uint64_t i = 0;
+    for(; i < 3*270; i++){
+        mu_check(fabsf(res->value->data[i] - expected->value->data[i]) < 1e-3);
+    }
+    
+    // element-wise operations upcast bfloat16 operands
+    NDArray* b = nda_cast(nda_linspace(1, 4, 4), NDA_DTYPE_BF16);
+    node = tb_newBinaryOpNode(TBBOT_ADD, tb_newConstantNode(b), tb_newConstantNode(nda_linspace(1, 1, 4)));
+    res = tb_runSession(NULL, tb_newGraph("bf16", node), NULL);
+    mu_assert_double_eq(5, res->value->data[3]);
+    
+    // the vectorized conversions agree with the portable ones, tails included
+    tb_float src[37];
+    uint16_t fast[37], slow[37];
+    tb_float up[37];
+    for(i = 0; i < 37; i++)
+        src[i] = (i == 5) ? 65520.0f : sinf(i*0.7f)*powf(2, (tb_float)i - 18);
+    
+    NDDType types[2] = {NDA_DTYPE_F16, NDA_DTYPE_BF16};
+    uint64_t t = 0;
+    for(; t < 2; t++){
+        nda_fromFloat(src, types[t], fast, 37);
+        uint32_t previous = nda_cpuRestrictFeatures(0);
+        nda_fromFloat(src, types[t], slow, 37);
+        nda_toFloat(slow, types[t], up, 37);
+        nda_cpuRestrictFeatures(previous);
+        mu_check(memcmp(fast, slow, sizeof(fast)) == 0);
+        
+        tb_float back[37];
+        nda_toFloat(fast, types[t], back, 37);
+        mu_check(memcmp(back, up, sizeof(back)) == 0);
+    }
+}
+
+MU_TEST(test_runtime_dtype){
+    NDArray* a = nda_cast(nda_linspace(1, 6, 6), NDA_DTYPE_I32);
+    NDArray* b = nda_cast(nda_linspace(-3, 2, 6), NDA_DTYPE_I32);
+    nda_reshape(a, nda_newShape(2, 2, 3));
+    nda_reshape(b, nda_newShape(2, 2, 3));
+    mu_check(((int32_t*)b->raw)[0] == -3);
+    
+    // integer arithmetic stays integer
+    TBNode* na = tb_newConstantNode(a);
+    TBNode* nb = tb_newConstantNode(b);
+    TBResultNode* res = tb_runSession(NULL, tb_newGraph("i32", tb_newBinaryOpNode(TBBOT_MULT, na, nb)), NULL);
+    mu_check(res->value->dtype == NDA_DTYPE_I32);
+    mu_check(((int32_t*)res->value->raw)[5] == 12);
+    
+    // divisions and mixed operands are computed in tb_float
+    res = tb_runSession(NULL, tb_newGraph("div", tb_newBinaryOpNode(TBBOT_DIV, na, nb)), NULL);
+    mu_check(res->value->dtype == NDA_DTYPE_FLOAT);
+    mu_assert_double_eq(-1.0/3, res->value->data[0]);
+    
+    res = tb_runSession(NULL, tb_newGraph("mixed", tb_newBinaryOpNode(TBBOT_ADD, na, tb_newConstantNode(nda_linspace(0.5, 0.5, 3)))), NULL);
+    mu_check(res->value->dtype == NDA_DTYPE_FLOAT);
+    mu_assert_double_eq(6.5, res->value->data[5]);
+    
+    // wide indices survive negation and transposition untouched
+    NDArray* big = nda_allocType(nda_newShape(2, 1, 2), NDA_DTYPE_I64);
+    ((int64_t*)big->raw)[0] = ((int64_t)1 << 40) + 1;
+    ((int64_t*)big->raw)[1] = -7;
+    TBNode* neg = tb_newUnaryOpNode(TBUOT_MINUS, tb_newConstantNode(big));
+    res = tb_runSession(NULL, tb_newGraph("i64", tb_newTransposeOpNode(neg, 0, 1)), NULL);
+    mu_check(res->value->dtype == NDA_DTYPE_I64);
+    mu_check(res->value->shape->dims[0] == 2);
+    mu_check(((int64_t*)res->value->raw)[0] == -(((int64_t)1 << 40) + 1));
+    mu_check(((int64_t*)res->value->raw)[1] == 7);
+    
+    // conversions to integers round and saturate instead of wrapping
+    NDArray* wide = nda_linspace(-300, 300, 5);
+    wide->data[1] = -2.5;
+    wide->data[2] = NAN;
+    NDArray* u8 = nda_cast(wide, NDA_DTYPE_U8);
+    NDArray* i8 = nda_cast(wide, NDA_DTYPE_I8);
+    wide->data[3] = 1e12;
+    NDArray* i32 = nda_cast(wide, NDA_DTYPE_I32);
+    mu_check(((uint8_t*)u8->raw)[0] == 0 && ((uint8_t*)u8->raw)[1] == 0 && ((uint8_t*)u8->raw)[4] == 255);
+    mu_check(((int8_t*)i8->raw)[0] == -128 && ((int8_t*)i8->raw)[1] == -3 && ((int8_t*)i8->raw)[2] == 0);
+    mu_check(((int8_t*)i8->raw)[3] == 127 && ((int32_t*)i32->raw)[3] == INT32_MAX && ((int32_t*)i32->raw)[0] == -300);
+    NDArray* casts[] = {wide, u8, i8, i32};
+    uint64_t c;
+    for(c = 0; c < 4; c++){
+        nda_free(casts[c]);
+        free(casts[c]);
+    }
+    
+    // boolean masks
+    NDArray* mask = nda_cast(nda_linspace(0, 2, 3), NDA_DTYPE_BOOL);
+    mu_check(((uint8_t*)mask->raw)[2] == 1);
+    res = tb_runSession(NULL, tb_newGraph("mask", tb_newBinaryOpNode(TBBOT_MULT, na, tb_newConstantNode(mask))), NULL);
+    mu_assert_double_eq(0, res->value->data[3]);
+    mu_assert_double_eq(6, res->value->data[5]);
+    
+    // prepared runs allocate integer buffers and check the bound output dtype
+    NDArray* x = nda_linspace(0, 1, 6);
+    nda_reshape(x, nda_newShape(2, 2, 3));
+    TBGraph* g = tb_newGraph("argmax", tb_newAxisBoundOpNode(TBABOT_ARGMAX, tb_newUnaryOpNode(TBUOT_MINUS, tb_newVarNode("x")), 1));
+    TBPreparedRun* run = tb_prepareRun(NULL, g);
+    tb_preparedBindInput(run, tb_graphGetVarSlot(g, "x"), x);
+    
+    NDArray* indices = nda_allocType(nda_newShape(1, 2), NDA_DTYPE_I64);
+    tb_preparedBindOutput(run, indices);
+    res = tb_runPrepared(run);
+    mu_check(res->error == NULL);
+    mu_check(res->value == indices);
+    mu_check(((int64_t*)indices->raw)[1] == 0);
+    
+    tb_preparedBindOutput(run, nda_alloc(nda_newShape(1, 2)));
+    res = tb_runPrepared(run);
+    mu_check(res->error != NULL);
+    
+    tb_freePreparedRun(run);
+}
+
+/*
+ * Rows of (1, len) F64 values
+ */
+static NDArray* _test_doubles(uint64_t len, const double* values){
+    NDArray* x = nda_allocType(nda_newShape(2, 1, len), NDA_DTYPE_F64);
+    memcpy(x->raw, values, len*sizeof(double));
+    
+    return x;
+}
+
+MU_TEST(test_double_precision){
+    static const double big[2] = {16777217.0, 1.0};
+    static const double tiny[2] = {16777217.0, 1e-12};
+    TBNode* a = tb_newConstantNode(_test_doubles(2, big));
+    TBNode* b = tb_newConstantNode(_test_doubles(2, tiny));
+    
+    // F64 operands are computed and stored in double, not rounded through tb_float
+    TBResultNode* res = tb_runSession(NULL, tb_newGraph("add", tb_newBinaryOpNode(TBBOT_ADD, a, b)), NULL);
+    mu_check(res->value->dtype == NDA_DTYPE_F64);
+    mu_check(((double*)res->value->raw)[0] == 33554434.0);
+    mu_check(((double*)res->value->raw)[1] == 1.0 + 1e-12);
+    
+    // integers are widened exactly
+    NDArray* wide = nda_allocType(nda_newShape(2, 1, 2), NDA_DTYPE_I64);
+    ((int64_t*)wide->raw)[0] = ((int64_t)1 << 40) + 1;
+    ((int64_t*)wide->raw)[1] = 3;
+    res = tb_runSession(NULL, tb_newGraph("mixed", tb_newBinaryOpNode(TBBOT_SUB, tb_newConstantNode(wide), b)), NULL);
+    mu_check(res->value->dtype == NDA_DTYPE_F64);
+    mu_check(((double*)res->value->raw)[0] == (double)(((int64_t)1 << 40) + 1) - 16777217.0);
+    
+    // DOT product, unary operations and reductions
+    NDArray* ones = nda_allocType(nda_newShape(2, 2, 1), NDA_DTYPE_F64);
+    ((double*)ones->raw)[0] = ((double*)ones->raw)[1] = 1.0;
+    res = tb_runSession(NULL, tb_newGraph("dot", tb_newBinaryOpNode(TBBOT_DOT, a, tb_newConstantNode(ones))), NULL);
+    mu_check(res->value->dtype == NDA_DTYPE_F64);
+    mu_check(((double*)res->value->raw)[0] == 16777218.0);
+    
+    res = tb_runSession(NULL, tb_newGraph("exp", tb_newUnaryOpNode(TBUOT_EXP, b)), NULL);
+    mu_check(res->value->dtype == NDA_DTYPE_F64);
+    mu_check(fabs(((double*)res->value->raw)[1] - 1 - 1e-12) < 1e-15);
+    
+    static const double spread[2] = {1e8, 1e8 + 1};
+    TBNode* s = tb_newConstantNode(_test_doubles(2, spread));
+    TBAxisBoundOperationType reductions[4] = {TBABOT_SUM, TBABOT_MEAN, TBABOT_VARIANCE, TBABOT_MAX};
+    double expected[4] = {2e8 + 1, 1e8 + 0.5, 0.25, 1e8 + 1};
+    uint64_t i = 0;
+    for(; i < 4; i++){
+        res = tb_runSession(NULL, tb_newGraph("reduce", tb_newAxisBoundOpNode(reductions[i], s, 1)), NULL);
+        mu_check(res->value->dtype == NDA_DTYPE_F64);
+        mu_check(((double*)res->value->raw)[0] == expected[i]);
+    }
+    
+    res = tb_runSession(NULL, tb_newGraph("argmin", tb_newAxisBoundOpNode(TBABOT_ARGMIN, s, 1)), NULL);
+    mu_check(res->value->dtype == NDA_DTYPE_I64);
+    mu_check(((int64_t*)res->value->raw)[0] == 0);
+    
+    res = tb_runSession(NULL, tb_newGraph("softmax", tb_newAxisBoundOpNode(TBABOT_SOFTMAX, s, 1)), NULL);
+    mu_check(res->value->dtype == NDA_DTYPE_F64);
+    mu_check(fabs(((double*)res->value->raw)[0] - 1/(1 + exp(1.0))) < 1e-12);
+    
+    // prepared runs plan F64 buffers from the dtypes of the bound inputs
+    static const double ints[2] = {1.0, 2.0};
+    static const double eps[2] = {1e-12, 1e-12};
+    NDArray* x = _test_doubles(2, ints);
+    TBGraph* g = tb_newGraph("sum", tb_newAxisBoundOpNode(TBABOT_SUM, tb_newBinaryOpNode(TBBOT_ADD, tb_newVarNode("x"),
+                                                                                        tb_newConstantNode(_test_doubles(2, eps))), 1));
+    TBPreparedRun* run = tb_prepareRun(NULL, g);
+    tb_preparedBindInput(run, tb_graphGetVarSlot(g, "x"), x);
+    
+    NDArray* y = nda_allocType(nda_newShape(1, 1), NDA_DTYPE_F64);
+    tb_preparedBindOutput(run, y);
+    res = tb_runPrepared(run);
+    mu_check(res->error == NULL);
+    mu_check(res->value == y);
+    mu_check(fabs(((double*)y->raw)[0] - (3 + 2e-12)) < 1e-15);
+    
+    tb_freePreparedRun(run);
+    
+    // and so are the derivatives
+    TBNode* c = tb_newConstantNode(_test_doubles(2, ints));
+    TBGraph* gm = tb_newGraph("mult", tb_newBinaryOpNode(TBBOT_MULT, tb_newVarNode("x"), b));
+    tb_graphSetVar(gm, c, "x");
+    
+    TBGraphSession* session = tb_createLocalCPUSession();
+    tb_runSession(session, gm, NULL);
+    tb_autogradGraph(session, gm);
+    
+    TBResultNode* diff = tb_sessionGetDiff(session, gm, c);
+    mu_check(diff->value->dtype == NDA_DTYPE_F64);
+    mu_check(((double*)diff->value->raw)[0] == 16777217.0);
+    mu_check(((double*)diff->value->raw)[1] == 1e-12);
+    
+    tb_freeSession(session);
+}
+
+MU_TEST(test_quantized_dot){
+    // per-tensor round trip: the error is bounded by half a quantization step
+    NDArray* v = nda_linspace(-1, 3, 9);
+    float scale;
+    int32_t zero_point;
+    nda_chooseQuantParams(-1, 3, NDA_DTYPE_U8, &scale, &zero_point);
+    mu_check(zero_point == 64);
+    
+    NDArray* qv = nda_quantize(v, NDA_DTYPE_U8, scale, zero_point);
+    NDArray* dv = nda_dequantize(qv);
+    mu_check(qv->dtype == NDA_DTYPE_U8 && qv->quant != NULL);
+    mu_check(fabs(dv->data[8] - 3) <= scale/2);
+    mu_check(fabs(dv->data[1] + 0.5) <= scale/2);
+    
+    // y = (x.W1).W2, the second DOT consumes the requantized output of the first one
+    NDArray* x = nda_alloc(nda_newShape(2, 4, 40));
+    NDArray* w1 = nda_alloc(nda_newShape(2, 40, 24));
+    NDArray* w2 = nda_alloc(nda_newShape(2, 24, 8));
+    uint64_t i = 0;
+    for(; i < x->shape->raw_len; i++)
+        x->data[i] = sinf(i*0.37f);
+    for(i = 0; i < w1->shape->raw_len; i++)
+        w1->data[i] = 0.3f*cosf(i*0.11f);
+    for(i = 0; i < w2->shape->raw_len; i++)
+        w2->data[i] = 0.1f + 0.05f*sinf(i*0.23f + 1);
+    
+    TBGraph* g = tb_newGraph("mlp", tb_newBinaryOpNode(TBBOT_DOT, tb_newBinaryOpNode(TBBOT_DOT, tb_newVarNode("x"), tb_newConstantNode(w1)), tb_newConstantNode(w2)));
+    tb_graphSetVar(g, tb_newConstantNode(x), "x");
+    
+    TBGraphSession* session = tb_createLocalCPUSession();
+    TBResultNode* ref = tb_runSession(session, g, NULL);
+    mu_check(ref->error == NULL);
+    
+    TBCalibrator* cal = tb_newCalibrator(g);
+    tb_calibratorObserve(cal, session);
+    
+    float min, max;
+    mu_check(tb_calibratorRange(cal, g->root, &min, &max));
+    mu_check(min < 0 && max > 0);
+    
+    TBGraph* qg = tb_quantizeGraph(cal, "mlp_int8");
+    TBResultNode* res = tb_runSession(NULL, qg, NULL);
+    mu_check(res->error == NULL);
+    mu_check(res->value->dtype == NDA_DTYPE_FLOAT);
+    
+    float bound = (max > -min) ? max : -min;
+    for(i = 0; i < res->value->shape->raw_len; i++)
+        mu_check(fabs(res->value->data[i] - ref->value->data[i]) < 0.06*bound);
+    
+    // the prepared run fuses the requantization into the first DOT and matches the unfused run
+    TBPreparedRun* run = tb_prepareRun(NULL, qg);
+    NDArray* y = nda_alloc(nda_newShape(2, 4, 8));
+    tb_preparedBindOutput(run, y);
+    mu_check(tb_runPrepared(run)->error == NULL);
+    
+    uint64_t fused = 0;
+    for(i = 0; i < run->steps_len; i++)
+        fused += (run->steps[i].node->type == TBNT_QUANTIZATION) && (run->steps[i].rhs != TB_NO_SLOT);
+    mu_check(fused == 1);
+    
+    for(i = 0; i < y->shape->raw_len; i++)
+        mu_assert_double_eq(res->value->data[i], y->data[i]);
+    
+    // in a session the int8 weights of both DOT products are packed once, when planning
+    TBPreparedRun* srun = tb_prepareRun(session, qg);
+    NDArray* sy = nda_alloc(nda_newShape(2, 4, 8));
+    tb_preparedBindOutput(srun, sy);
+    mu_check(tb_runPrepared(srun)->error == NULL && tb_runPrepared(srun)->error == NULL);
+    
+    uint64_t packed = 0;
+    for(i = 0; i < srun->steps_len; i++)
+        packed += (srun->steps[i].packs != NULL) && (srun->steps[i].packs->quantized != NULL);
+    mu_check(packed == 2);
+    mu_check(memcmp(sy->raw, y->raw, y->shape->raw_len*sizeof(tb_float)) == 0);
+    tb_freePreparedRun(srun);
+    
+    // quantization parameters survive archives
+    NDArray* qw = nda_quantizePerChannel(w2, 1);
+    char path[] = "/tmp/tb_quant_XXXXXX";
+    int fd = mkstemp(path);
+    close(fd);
+    const char* names[] = {"w2"};
+    mu_check(nda_saveArchive(path, 1, names, &qw));
+    
+    NDArchive* archive = nda_openArchive(path);
+    mu_check(archive != NULL);
+    NDArray* lw = nda_archiveGet(archive, "w2");
+    mu_check(lw->dtype == NDA_DTYPE_I8 && lw->quant != NULL);
+    mu_check(lw->quant->count == 8 && lw->quant->axis == 1);
+    mu_check(lw->quant->scales[3] == qw->quant->scales[3]);
+    mu_check(((int8_t*)lw->raw)[17] == ((int8_t*)qw->raw)[17]);
+    nda_closeArchive(archive);
+    
+    // as do quantization nodes
+    mu_check(tb_saveGraph(qg, path));
+    TBGraph* loaded = tb_loadGraph(path);
+    mu_check(loaded != NULL);
+    TBResultNode* lres = tb_runSession(NULL, loaded, NULL);
+    mu_check(lres->error == NULL);
+    for(i = 0; i < y->shape->raw_len; i++)
+        mu_assert_double_eq(res->value->data[i], lres->value->data[i]);
+    unlink(path);
+    
+    tb_freePreparedRun(run);
+    tb_freeCalibrator(cal);
+    tb_freeSession(session);
+}
+
+MU_TEST(test_sparse_dot){
+    // duplicated coordinates are summed, rows are sorted by column
+    uint64_t rows[] = {2, 0, 1, 0, 2, 2};
+    uint64_t cols[] = {3, 1, 0, 1, 0, 3};
+    tb_float values[] = {1, 2, 3, 4, 5, 6};
+    NDArray* s = nda_sparseFromCOO(3, 4, 6, rows, cols, values);
+    mu_check(nda_isSparse(s) && nda_storedLen(s) == 4);
+    
+    NDArray* d = nda_sparseToDense(s);
+    mu_assert_double_eq(6, nda_get(d, (uint64_t[]){0, 1}));
+    mu_assert_double_eq(7, nda_get(d, (uint64_t[]){2, 3}));
+    mu_assert_double_eq(0, nda_get(d, (uint64_t[]){1, 1}));
+    
+    NDArray* w = nda_linspace(1, 8, 8);
+    nda_reshape(w, nda_newShape(2, 4, 2));
+    
+    TBNode* sn = tb_newConstantNode(s);
+    TBNode* wn = tb_newConstantNode(w);
+    TBGraph* g = tb_newGraph("sparse", tb_newBinaryOpNode(TBBOT_DOT, sn, wn));
+    TBGraph* gd = tb_newGraph("dense", tb_newBinaryOpNode(TBBOT_DOT, tb_newConstantNode(d), tb_newConstantNode(w)));
+    
+    TBGraphSession* session = tb_createLocalCPUSession();
+    TBResultNode* res = tb_runSession(session, g, NULL);
+    TBResultNode* ref = tb_runSession(NULL, gd, NULL);
+    mu_check(res->error == NULL && !nda_isSparse(res->value));
+    
+    uint64_t i = 0;
+    for(; i < 6; i++)
+        mu_assert_double_eq(ref->value->data[i], res->value->data[i]);
+    
+    // d(sum(S.W))/dW = S^T.1 is dense, d/dS[m, k] = sum_n W[k, n] keeps the pattern of S
+    tb_autogradGraph(session, g);
+    TBResultNode* ds = tb_sessionGetDiff(session, g, sn);
+    TBResultNode* dw = tb_sessionGetDiff(session, g, wn);
+    mu_check(nda_isSparse(ds->value) && nda_storedLen(ds->value) == 4);
+    mu_check(!nda_isSparse(dw->value));
+    
+    NDArray* dsd = nda_sparseToDense(ds->value);
+    mu_assert_double_eq(3 + 4, nda_get(dsd, (uint64_t[]){0, 1}));
+    mu_assert_double_eq(7 + 8, nda_get(dsd, (uint64_t[]){2, 3}));
+    mu_assert_double_eq(0, nda_get(dsd, (uint64_t[]){0, 0}));
+    mu_assert_double_eq(6, nda_get(dw->value, (uint64_t[]){1, 0}));
+    mu_assert_double_eq(3 + 5, nda_get(dw->value, (uint64_t[]){0, 1}));
+    mu_assert_double_eq(7, nda_get(dw->value, (uint64_t[]){3, 1}));
+    tb_freeSession(session);
+    
+    // large enough to be split across threads, prepared runs share the kernel
+    uint64_t M = 300, K = 200, N = 64, nnz = 0;
+    uint64_t* r = calloc(M*K, sizeof(uint64_t));
+    uint64_t* c = calloc(M*K, sizeof(uint64_t));
+    tb_float* v = calloc(M*K, sizeof(tb_float));
+    for(i = 0; i < M*K; i++){
+        if((i*2654435761u) % 97 < 10){
+            r[nnz] = i / K;
+            c[nnz] = i % K;
+            v[nnz++] = sinf(i*0.7f);
+        }
+    }
+    
+    NDArray* bs = nda_sparseFromCOO(M, K, nnz, r, c, v);
+    NDArray* bw = nda_alloc(nda_newShape(2, K, N));
+    for(i = 0; i < bw->shape->raw_len; i++)
+        bw->data[i] = cosf(i*0.13f);
+    
+    TBGraph* bg = tb_newGraph("big", tb_newBinaryOpNode(TBBOT_DOT, tb_newConstantNode(bs), tb_newConstantNode(bw)));
+    TBGraph* bgd = tb_newGraph("big_dense", tb_newBinaryOpNode(TBBOT_DOT, tb_newConstantNode(nda_sparseToDense(bs)), tb_newConstantNode(bw)));
+    
+    session = tb_createLocalCPUSession();
+    tb_sessionSetThreads(session, 4);
+    res = tb_runSession(session, bg, NULL);
+    ref = tb_runSession(NULL, bgd, NULL);
+    
+    TBPreparedRun* run = tb_prepareRun(session, bg);
+    TBResultNode* prep = tb_runPrepared(run);
+    mu_check(prep->error == NULL);
+    
+    for(i = 0; i < M*N; i++){
+        mu_check(fabs(res->value->data[i] - ref->value->data[i]) < 1e-4);
+        mu_check(prep->value->data[i] == res->value->data[i]);
+    }
+    
+    tb_freePreparedRun(run);
+    tb_freeSession(session);
+    free(r);
+    free(c);
+    free(v);
+}
+
+/*
+ * Bytes allocated by a forward and backward pass of 16 lookups into a fed table of `rows` rows, after a first
+ * pass, along with the table derivative.
+ */
+static uint64_t _test_gatherStepBytes(uint64_t rows, NDArray** diff){
+    NDArray* table = nda_alloc(nda_newShape(2, rows, 32));
+    NDArray* ids = nda_allocType(nda_newShape(1, 16), NDA_DTYPE_I64);
+    uint64_t i = 0;
+    for(; i < 16; i++)
+        ((int64_t*)ids->raw)[i] = (int64_t)((i*7919) % rows);
+    
+    TBNode* tn = tb_newVarNode("table");
+    TBGraph* g = tb_newGraph("gather_cost", tb_newGatherOpNode(tn, tb_newConstantNode(ids)));
+    tb_graphFeedSlot(g, tb_graphGetVarSlot(g, "table"), table);
+    
+    TBGraphSession* session = tb_createLocalCPUSession();
+    tb_runSession(session, g, NULL);
+    tb_autogradGraph(session, g);
+    
+    uint64_t total = nda_memCounters(NULL).total;
+    tb_runSession(session, g, NULL);
+    tb_autogradGraph(session, g);
+    total = nda_memCounters(NULL).total - total;
+    
+    *diff = nda_copy(tb_sessionGetDiff(session, g, tn)->value);
+    tb_freeSession(session);
+    nda_free(table);
+    free(table);
+    
+    return total;
+}
+
+MU_TEST(test_gather){
+    NDArray* table = nda_linspace(0, 29, 30);
+    nda_reshape(table, nda_newShape(2, 10, 3));
+    
+    NDArray* ids = nda_allocType(nda_newShape(2, 2, 3), NDA_DTYPE_I64);
+    int64_t rows[] = {4, 0, 4, 7, 9, 1};
+    memcpy(ids->raw, rows, sizeof(rows));
+    
+    TBNode* tn = tb_newConstantNode(table);
+    TBGraph* g = tb_newGraph("embedding", tb_newGatherOpNode(tn, tb_newConstantNode(ids)));
+    
+    TBGraphSession* session = tb_createLocalCPUSession();
+    TBResultNode* res = tb_runSession(session, g, NULL);
+    mu_check(res->error == NULL);
+    mu_check(res->value->shape->rank == 3 && res->value->shape->dims[0] == 2 && res->value->shape->dims[2] == 3);
+    
+    uint64_t i = 0, c = 0;
+    for(; i < 6; i++){
+        for(c = 0; c < 3; c++)
+            mu_assert_double_eq(rows[i]*3 + c, res->value->data[i*3 + c]);
+    }
+    
+    TBPreparedRun* run = tb_prepareRun(session, g);
+    TBResultNode* prep = tb_runPrepared(run);
+    mu_check(prep->error == NULL);
+    mu_check(memcmp(prep->value->data, res->value->data, 18*sizeof(tb_float)) == 0);
+    tb_freePreparedRun(run);
+    
+    // the table derivative only stores the looked up rows, repeated rows are summed
+    tb_autogradGraph(session, g);
+    TBResultNode* diff = tb_sessionGetDiff(session, g, tn);
+    mu_check(nda_isSparse(diff->value) && nda_storedLen(diff->value) == 5*3);
+    
+    NDArray* dense = nda_sparseToDense(diff->value);
+    mu_assert_double_eq(2, nda_get(dense, (uint64_t[]){4, 1}));
+    mu_assert_double_eq(1, nda_get(dense, (uint64_t[]){9, 2}));
+    mu_assert_double_eq(0, nda_get(dense, (uint64_t[]){5, 0}));
+    
+    // the row list goes through the CSR kernels
+    NDArray* dt = nda_sparseToDense(nda_sparseTranspose(diff->value));
+    mu_assert_double_eq(2, nda_get(dt, (uint64_t[]){1, 4}));
+    mu_assert_double_eq(0, nda_get(dt, (uint64_t[]){0, 5}));
+    tb_freeSession(session);
+    
+    // the cost of a step depends on the lookups, not on the table: the table is not copied and its derivative
+    // only holds the looked up rows
+    NDArray* small_diff = NULL;
+    NDArray* large_diff = NULL;
+    uint64_t small = _test_gatherStepBytes(100, &small_diff);
+    uint64_t large = _test_gatherStepBytes(200000, &large_diff);
+    mu_assert_int_eq(small, large);
+    mu_check(large < 100*32*sizeof(tb_float));
+    mu_assert_int_eq(16*32, nda_storedLen(large_diff));
+    mu_assert_double_eq(2, large_diff->data[0]);
+    nda_free(small_diff);
+    free(small_diff);
+    nda_free(large_diff);
+    free(large_diff);
+    
+    // large lookups are split across threads
+    NDArray* big = nda_alloc(nda_newShape(2, 5000, 64));
+    for(i = 0; i < big->shape->raw_len; i++)
+        big->data[i] = (tb_float)i;
+    
+    NDArray* fids = nda_alloc(nda_newShape(1, 4000));
+    for(i = 0; i < 4000; i++)
+        fids->data[i] = (tb_float)((i*7919) % 5000);
+    
+    TBGraph* bg = tb_newGraph("big_embedding", tb_newGatherOpNode(tb_newConstantNode(big), tb_newConstantNode(fids)));
+    session = tb_createLocalCPUSession();
+    tb_sessionSetThreads(session, 4);
+    res = tb_runSession(session, bg, NULL);
+    mu_check(res->error == NULL);
+    
+    for(i = 0; i < 4000; i++){
+        uint64_t r = (i*7919) % 5000;
+        mu_check(res->value->data[i*64] == r*64 && res->value->data[i*64 + 63] == r*64 + 63);
+    }
+    
+    tb_freeSession(session);
+}
+
+MU_TEST(test_softmax){
+    // large logits do not overflow, rows of 11 values go through the vectorized and scalar paths
+    NDArray* x = nda_alloc(nda_newShape(2, 3, 11));
+    uint64_t i = 0, k = 0;
+    for(; i < x->shape->raw_len; i++)
+        x->data[i] = 3*sinf(i*0.7f) + ((i < 11) ? 1000 : 0);
+    
+    TBNode* xn = tb_newConstantNode(x);
+    TBGraph* g = tb_newGraph("softmax", tb_newAxisBoundOpNode(TBABOT_SOFTMAX, xn, 1));
+    TBGraph* lg = tb_newGraph("log_softmax", tb_newAxisBoundOpNode(TBABOT_LOG_SOFTMAX, xn, 1));
+    TBGraph* tg = tb_newGraph("softmax_t", tb_newAxisBoundOpNode(TBABOT_SOFTMAX, tb_newTransposeOpNode(xn, 0, 1), 0));
+    
+    TBResultNode* y = tb_runSession(NULL, g, NULL);
+    TBResultNode* ly = tb_runSession(NULL, lg, NULL);
+    TBResultNode* ty = tb_runSession(NULL, tg, NULL);
+    mu_check(y->error == NULL && ly->error == NULL && ty->error == NULL);
+    
+    for(i = 0; i < 3; i++){
+        double sum = 0, m = x->data[i*11];
+        for(k = 0; k < 11; k++)
+            m = fmax(m, x->data[i*11 + k]);
+        for(k = 0; k < 11; k++)
+            sum += exp(x->data[i*11 + k] - m);
+        
+        for(k = 0; k < 11; k++){
+            double p = exp(x->data[i*11 + k] - m)/sum;
+            mu_check(fabs(y->value->data[i*11 + k] - p) < 1e-6);
+            mu_check(fabs(ly->value->data[i*11 + k] - log(p)) < 1e-4);
+            mu_check(fabs(ty->value->data[k*3 + i] - p) < 1e-6);
+        }
+    }
+    
+    // the portable path agrees with the vectorized one
+    TBGraphSession* portable = tb_createLocalCPUSession();
+    uint32_t previous = nda_cpuRestrictFeatures(0);
+    TBResultNode* py = tb_runSession(portable, g, NULL);
+    nda_cpuRestrictFeatures(previous);
+    for(i = 0; i < 33; i++)
+        mu_check(fabs(py->value->data[i] - y->value->data[i]) < 1e-6);
+    tb_freeResultNode(g, py);
+    free(py);
+    tb_freeSession(portable);
+    
+    // cross-entropy against class indices or one-hot distributions: -log_softmax(x)[label]
+    NDArray* labels = nda_allocType(nda_newShape(1, 3), NDA_DTYPE_I32);
+    NDArray* onehot = nda_alloc(nda_newShape(2, 3, 11));
+    int32_t classes[] = {4, 0, 10};
+    memcpy(labels->raw, classes, sizeof(classes));
+    for(i = 0; i < 3; i++)
+        onehot->data[i*11 + classes[i]] = 1;
+    
+    TBGraph* ce = tb_newGraph("ce", tb_newCrossEntropyOpNode(xn, tb_newConstantNode(labels), 1));
+    TBGraph* dce = tb_newGraph("dense_ce", tb_newCrossEntropyOpNode(xn, tb_newConstantNode(onehot), 1));
+    
+    TBGraphSession* session = tb_createLocalCPUSession();
+    TBResultNode* loss = tb_runSession(session, ce, NULL);
+    TBResultNode* dloss = tb_runSession(NULL, dce, NULL);
+    mu_check(loss->error == NULL && dloss->error == NULL && loss->value->shape->raw_len == 3);
+    
+    for(i = 0; i < 3; i++){
+        mu_check(fabs(loss->value->data[i] + ly->value->data[i*11 + classes[i]]) < 1e-4);
+        mu_check(fabs(dloss->value->data[i] - loss->value->data[i]) < 1e-4);
+    }
+    
+    TBPreparedRun* run = tb_prepareRun(NULL, ce);
+    TBResultNode* prep = tb_runPrepared(run);
+    mu_check(prep->error == NULL && memcmp(prep->value->data, loss->value->data, 3*sizeof(tb_float)) == 0);
+    tb_freePreparedRun(run);
+    
+    // d(sum(loss))/dx = softmax(x) - onehot
+    tb_autogradGraph(session, ce);
+    TBResultNode* dx = tb_sessionGetDiff(session, ce, xn);
+    for(i = 0; i < 33; i++)
+        mu_check(fabs(dx->value->data[i] - (y->value->data[i] - onehot->data[i])) < 1e-6);
+    tb_freeSession(session);
+    
+    // d(sum(log_softmax(x)))/dx = 1 - 11*softmax(x), log-probabilities of logits around 1000 have ~1e-4 ulps
+    session = tb_createLocalCPUSession();
+    tb_runSession(session, lg, NULL);
+    tb_autogradGraph(session, lg);
+    dx = tb_sessionGetDiff(session, lg, xn);
+    for(i = 0; i < 33; i++)
+        mu_check(fabs(dx->value->data[i] - (1 - 11*y->value->data[i])) < 1e-4);
+    tb_freeSession(session);
+    
+    // mismatched labels are reported
+    TBGraph* bad = tb_newGraph("bad_ce", tb_newCrossEntropyOpNode(xn, tb_newConstantNode(nda_alloc(nda_newShape(1, 11))), 1));
+    mu_check(tb_runSession(NULL, bad, NULL)->error != NULL);
+}
+
+MU_TEST(test_variance){
+    // a single long lane is split into chunks whose moments are merged
+    uint64_t n = 300000, i = 0, k = 0;
+    NDArray* x = nda_alloc(nda_newShape(1, n));
+    double mean = 0, var = 0;
+    for(; i < n; i++){
+        x->data[i] = 1000 + sinf(i*0.01f);
+        mean += x->data[i];
+    }
+    mean /= n;
+    for(i = 0; i < n; i++)
+        var += (x->data[i] - mean)*(x->data[i] - mean);
+    var /= n;
+    
+    TBGraphSession* session = tb_createLocalCPUSession();
+    tb_sessionSetThreads(session, 4);
+    TBResultNode* v = tb_runSession(session, tb_newGraph("variance", tb_newAxisBoundOpNode(TBABOT_VARIANCE, tb_newConstantNode(x), 0)), NULL);
+    TBResultNode* m = tb_runSession(session, tb_newGraph("mean", tb_newAxisBoundOpNode(TBABOT_MEAN, tb_newConstantNode(x), 0)), NULL);
+    mu_check(v->error == NULL && m->error == NULL);
+    mu_check(fabs(v->value->data[0] - var) < 1e-6);
+    mu_check(fabs(m->value->data[0] - mean) < 1e-3);
+    tb_freeSession(session);
+    
+    // contiguous and strided lanes of a matrix
+    NDArray* a = nda_alloc(nda_newShape(2, 37, 21));
+    for(i = 0; i < a->shape->raw_len; i++)
+        a->data[i] = cosf(i*0.3f)*(1 + i%5);
+    
+    TBGraph* rows = tb_newGraph("rows", tb_newAxisBoundOpNode(TBABOT_VARIANCE, tb_newConstantNode(a), 1));
+    TBGraph* cols = tb_newGraph("cols", tb_newAxisBoundOpNode(TBABOT_VARIANCE, tb_newConstantNode(a), 0));
+    TBResultNode* rv = tb_runSession(NULL, rows, NULL);
+    TBResultNode* cv = tb_runSession(NULL, cols, NULL);
+    
+    for(i = 0; i < 37; i++){
+        double s = 0, s2 = 0;
+        for(k = 0; k < 21; k++){
+            s += a->data[i*21 + k];
+            s2 += a->data[i*21 + k]*a->data[i*21 + k];
+        }
+        mu_check(fabs(rv->value->data[i] - (s2/21 - (s/21)*(s/21))) < 1e-5);
+    }
+    
+    for(k = 0; k < 21; k++){
+        double s = 0, s2 = 0;
+        for(i = 0; i < 37; i++){
+            s += a->data[i*21 + k];
+            s2 += a->data[i*21 + k]*a->data[i*21 + k];
+        }
+        mu_check(fabs(cv->value->data[k] - (s2/37 - (s/37)*(s/37))) < 1e-5);
+    }
+    
+    TBPreparedRun* run = tb_prepareRun(NULL, cols);
+    TBResultNode* prep = tb_runPrepared(run);
+    mu_check(prep->error == NULL && memcmp(prep->value->data, cv->value->data, 21*sizeof(tb_float)) == 0);
+    tb_freePreparedRun(run);
+}
+
+/*
+ * sum(gamma*(x - mean)*rstd + beta) of a (4, 3, 5) array in double, LAYER normalizes each of the 4 samples and
+ * BATCH each of the 3 channels
+ */
+static double _test_normSum(uint8_t batch, const double* x, const tb_float* gamma, const tb_float* beta){
+    double sum = 0;
+    uint64_t grp = 0, e;
+    
+    for(; grp < (batch ? 3 : 4); grp++){
+        double mean = 0, var = 0, n = batch ? 20 : 15;
+        for(e = 0; e < 60; e++)
+            mean += ((batch ? (e/5)%3 : e/15) == grp) ? x[e]/n : 0;
+        for(e = 0; e < 60; e++)
+            var += ((batch ? (e/5)%3 : e/15) == grp) ? (x[e] - mean)*(x[e] - mean)/n : 0;
+        for(e = 0; e < 60; e++){
+            uint64_t p = batch ? grp : e%15;
+            if((batch ? (e/5)%3 : e/15) == grp)
+                sum += gamma[p]*(x[e] - mean)/sqrt(var + 1e-5) + beta[p];
+        }
+    }
+    
+    return sum;
+}
+
+MU_TEST(test_normalization){
+    NDArray* x = nda_alloc(nda_newShape(3, 4, 3, 5));
+    NDArray* lg = nda_alloc(nda_newShape(2, 3, 5));
+    NDArray* lb = nda_alloc(nda_newShape(2, 3, 5));
+    NDArray* bg = nda_alloc(nda_newShape(1, 3));
+    NDArray* bb = nda_alloc(nda_newShape(1, 3));
+    double xd[60];
+    uint64_t i = 0, batch;
+    for(; i < 60; i++){
+        x->data[i] = 10 + 2*sinf(i*1.3f) + (i%7);
+        xd[i] = x->data[i];
+    }
+    for(i = 0; i < 15; i++){
+        lg->data[i] = 1 + 0.1f*i;
+        lb->data[i] = cosf(i);
+    }
+    for(i = 0; i < 3; i++){
+        bg->data[i] = 2 - i;
+        bb->data[i] = 0.5f*i;
+    }
+    
+    for(batch = 0; batch < 2; batch++){
+        NDArray* gamma = batch ? bg : lg;
+        NDArray* beta = batch ? bb : lb;
+        TBNode* xn = tb_newConstantNode(x);
+        TBNode* gn = tb_newConstantNode(gamma);
+        TBNode* bn = tb_newConstantNode(beta);
+        TBNode* norm = tb_newNormalizationOpNode(batch ? TBNOT_BATCH : TBNOT_LAYER, xn, gn, bn, 1, 1e-5f);
+        TBGraph* graph = tb_newGraph("normalization", norm);
+        
+        TBGraphSession* session = tb_createLocalCPUSession();
+        TBResultNode* y = tb_runSession(session, graph, NULL);
+        mu_check(y->error == NULL);
+        
+        // normalized groups have a zero mean and a unit variance before the affine transform
+        double sum = 0;
+        for(i = 0; i < 60; i++)
+            sum += y->value->data[i];
+        mu_check(fabs(sum - _test_normSum(batch, xd, gamma->data, beta->data)) < 1e-3);
+        
+        TBPreparedRun* run = tb_prepareRun(NULL, graph);
+        TBResultNode* prep = tb_runPrepared(run);
+        mu_check(prep->error == NULL && memcmp(prep->value->data, y->value->data, 60*sizeof(tb_float)) == 0);
+        tb_freePreparedRun(run);
+        
+        // d(sum(y))/dx against central differences, d/dbeta counts the normalized values of each parameter
+        tb_autogradGraph(session, graph);
+        TBResultNode* dx = tb_sessionGetDiff(session, graph, xn);
+        TBResultNode* dbeta = tb_sessionGetDiff(session, graph, bn);
+        for(i = 0; i < 60; i++){
+            double h = 1e-4, v = xd[i];
+            xd[i] = v + h;
+            double up = _test_normSum(batch, xd, gamma->data, beta->data);
+            xd[i] = v - h;
+            double down = _test_normSum(batch, xd, gamma->data, beta->data);
+            xd[i] = v;
+            mu_check(fabs(dx->value->data[i] - (up - down)/(2*h)) < 1e-3);
+        }
+        for(i = 0; i < beta->shape->raw_len; i++)
+            mu_check(dbeta->value->data[i] == (batch ? 20 : 4));
+        
+        tb_freeSession(session);
+    }
+    
+    // gamma and beta are optional, their number of values is checked
+    TBGraph* plain = tb_newGraph("plain", tb_newNormalizationOpNode(TBNOT_LAYER, tb_newConstantNode(x), NULL, NULL, 2, 1e-5f));
+    TBResultNode* p = tb_runSession(NULL, plain, NULL);
+    mu_check(p->error == NULL);
+    for(i = 0; i < 12; i++){
+        double s = 0, s2 = 0;
+        uint64_t k = 0;
+        for(; k < 5; k++){
+            s += p->value->data[i*5 + k];
+            s2 += p->value->data[i*5 + k]*p->value->data[i*5 + k];
+        }
+        mu_check(fabs(s) < 1e-4 && fabs(s2/5 - 1) < 1e-3);
+    }
+    
+    TBGraph* bad = tb_newGraph("bad_norm", tb_newNormalizationOpNode(TBNOT_BATCH, tb_newConstantNode(x), tb_newConstantNode(lg), NULL, 1, 1e-5f));
+    mu_check(tb_runSession(NULL, bad, NULL)->error != NULL);
+}
+
+/*
+ * Reference NCHW convolution with square stride, padding and dilation. Optionally accumulates the derivatives of
+ * sum(y) w.r.t x and w.
+ */
+static void _test_conv2d(const tb_float* x, const tb_float* w, uint64_t* dims, uint64_t s, uint64_t p, uint64_t d, uint64_t groups,
+                         double* y, double* dx, double* dw){
+    uint64_t N = dims[0], C = dims[1], H = dims[2], W = dims[3], CO = dims[4], K = dims[5];
+    uint64_t OH = (H + 2*p - d*(K - 1) - 1)/s + 1, OW = (W + 2*p - d*(K - 1) - 1)/s + 1;
+    uint64_t CG = C/groups, COG = CO/groups;
+    uint64_t n, co, oh, ow, c, kh, kw;
+    
+    for(n = 0; n < N; n++)
+    for(co = 0; co < CO; co++)
+    for(oh = 0; oh < OH; oh++)
+    for(ow = 0; ow < OW; ow++){
+        double acc = 0;
+        for(c = 0; c < CG; c++)
+        for(kh = 0; kh < K; kh++)
+        for(kw = 0; kw < K; kw++){
+            int64_t ih = (int64_t)(oh*s + kh*d) - (int64_t)p, iw = (int64_t)(ow*s + kw*d) - (int64_t)p;
+            if(ih < 0 || iw < 0 || ih >= (int64_t)H || iw >= (int64_t)W)
+                continue;
+            uint64_t xi = ((n*C + (co/COG)*CG + c)*H + ih)*W + iw, wi = ((co*CG + c)*K + kh)*K + kw;
+            acc += x[xi]*w[wi];
+            if(dx != NULL){
+                dx[xi] += w[wi];
+                dw[wi] += x[xi];
+            }
+        }
+        y[((n*CO + co)*OH + oh)*OW + ow] = acc;
+    }
+}
+
+MU_TEST(test_convolution){
+    // (N, C, H, W, CO, K) with (stride, padding, dilation, groups)
+    uint64_t cases[3][10] = {
+        {2, 4, 7, 6, 6, 3, 1, 1, 1, 2},
+        {1, 3, 9, 8, 4, 3, 2, 2, 2, 1},
+        {2, 16, 5, 5, 16, 3, 1, 1, 1, 1},
+    };
+    uint64_t t = 0, i, a;
+    
+    for(; t < 3; t++){
+        uint64_t* cd = cases[t];
+        uint64_t N = cd[0], C = cd[1], H = cd[2], W = cd[3], CO = cd[4], K = cd[5], s = cd[6], p = cd[7], d = cd[8], groups = cd[9];
+        uint64_t OH = (H + 2*p - d*(K - 1) - 1)/s + 1, OW = (W + 2*p - d*(K - 1) - 1)/s + 1;
+        NDArray* x = nda_alloc(nda_newShape(4, N, C, H, W));
+        NDArray* xt = nda_alloc(nda_newShape(4, N, H, W, C));
+        NDArray* w = nda_alloc(nda_newShape(4, CO, C/groups, K, K));
+        for(i = 0; i < x->shape->raw_len; i++)
+            x->data[i] = sinf(i*0.37f);
+        for(i = 0; i < w->shape->raw_len; i++)
+            w->data[i] = cosf(i*0.53f);
+        for(i = 0; i < x->shape->raw_len; i++){
+            uint64_t n = i/(C*H*W), c = (i/(H*W))%C, hw = i%(H*W);
+            xt->data[(n*H*W + hw)*C + c] = x->data[i];
+        }
+        
+        uint64_t len = N*CO*OH*OW;
+        double* y = calloc(len, sizeof(double));
+        double* dx = calloc(x->shape->raw_len, sizeof(double));
+        double* dw = calloc(w->shape->raw_len, sizeof(double));
+        _test_conv2d(x->data, w->data, cd, s, p, d, groups, y, dx, dw);
+        
+        // every algorithm in both layouts, WINOGRAD falls back to IM2COL on strided or dilated kernels
+        for(a = TBCA_AUTO; a <= TBCA_WINOGRAD; a++){
+            TBNode* nchw = tb_newConvolutionOpNode(tb_newConstantNode(x), tb_newConstantNode(w), TBCL_NCHW, s, s, p, p, d, d, groups);
+            TBNode* nhwc = tb_newConvolutionOpNode(tb_newConstantNode(xt), tb_newConstantNode(w), TBCL_NHWC, s, s, p, p, d, d, groups);
+            ((TBConvolutionOperation*)nchw->nodePtr)->algorithm = (TBConvolutionAlgorithm)a;
+            ((TBConvolutionOperation*)nhwc->nodePtr)->algorithm = (TBConvolutionAlgorithm)a;
+            
+            TBResultNode* r = tb_runSession(NULL, tb_newGraph("conv_nchw", nchw), NULL);
+            TBResultNode* rt = tb_runSession(NULL, tb_newGraph("conv_nhwc", nhwc), NULL);
+            mu_check(r->error == NULL && rt->error == NULL);
+            mu_check(r->value->shape->dims[1] == CO && r->value->shape->dims[2] == OH && rt->value->shape->dims[3] == CO);
+            
+            for(i = 0; i < len; i++){
+                uint64_t n = i/(CO*OH*OW), co = (i/(OH*OW))%CO, hw = i%(OH*OW);
+                mu_check(fabs(r->value->data[i] - y[i]) < 1e-4);
+                mu_check(fabs(rt->value->data[(n*OH*OW + hw)*CO + co] - y[i]) < 1e-4);
+            }
+        }
+        
+        // d(sum(y))/dx and d(sum(y))/dw
+        TBNode* xn = tb_newConstantNode(x);
+        TBNode* wn = tb_newConstantNode(w);
+        TBGraph* graph = tb_newGraph("conv_grad", tb_newConvolutionOpNode(xn, wn, TBCL_NCHW, s, s, p, p, d, d, groups));
+        TBGraphSession* session = tb_createLocalCPUSession();
+        tb_runSession(session, graph, NULL);
+        tb_autogradGraph(session, graph);
+        TBResultNode* gx = tb_sessionGetDiff(session, graph, xn);
+        TBResultNode* gw = tb_sessionGetDiff(session, graph, wn);
+        for(i = 0; i < x->shape->raw_len; i++)
+            mu_check(fabs(gx->value->data[i] - dx[i]) < 1e-4);
+        for(i = 0; i < w->shape->raw_len; i++)
+            mu_check(fabs(gw->value->data[i] - dw[i]) < 1e-3);
+        tb_freeSession(session);
+        
+        TBPreparedRun* run = tb_prepareRun(NULL, graph);
+        TBResultNode* prep = tb_runPrepared(run);
+        mu_check(prep->error == NULL && fabs(prep->value->data[len - 1] - y[len - 1]) < 1e-4);
+        tb_freePreparedRun(run);
+        
+        free(y);
+        free(dx);
+        free(dw);
+    }
+    
+    // weights must match the channels of their group
+    NDArray* x = nda_alloc(nda_newShape(4, 1, 4, 5, 5));
+    NDArray* w = nda_alloc(nda_newShape(4, 2, 4, 3, 3));
+    TBGraph* bad = tb_newGraph("bad_conv", tb_newConvolutionOpNode(tb_newConstantNode(x), tb_newConstantNode(w), TBCL_NCHW, 1, 1, 0, 0, 1, 1, 2));
+    mu_check(tb_runSession(NULL, bad, NULL)->error != NULL);
+}
+
+// reference 2-D pooling of an NCHW tensor, y and the derivative of sum(y) w.r.t x
+static void _test_pool2d(const tb_float* x, uint64_t* dims, uint64_t k, uint64_t s, uint64_t p, uint8_t max, double* y, double* dx){
+    uint64_t C = dims[0]*dims[1], H = dims[2], W = dims[3];
+    uint64_t OH = (H + 2*p - k)/s + 1, OW = (W + 2*p - k)/s + 1;
+    uint64_t c, oh, ow, kh, kw;
+    
+    for(c = 0; c < C; c++)
+        for(oh = 0; oh < OH; oh++)
+            for(ow = 0; ow < OW; ow++){
+                double acc = max ? -INFINITY : 0;
+                uint64_t count = 0, best = 0;
+                for(kh = 0; kh < k; kh++)
+                    for(kw = 0; kw < k; kw++){
+                        int64_t h = (int64_t)(oh*s + kh) - (int64_t)p, w = (int64_t)(ow*s + kw) - (int64_t)p;
+                        if(h < 0 || w < 0 || h >= (int64_t)H || w >= (int64_t)W)
+                            continue;
+                        uint64_t off = (c*H + h)*W + w;
+                        if(max && x[off] > acc){
+                            acc = x[off];
+                            best = off;
+                        }
+                        if(!max)
+                            acc += x[off];
+                        count++;
+                    }
+                y[(c*OH + oh)*OW + ow] = max ? acc : acc/count;
+                if(max){
+                    dx[best] += 1;
+                    continue;
+                }
+                for(kh = 0; kh < k; kh++)
+                    for(kw = 0; kw < k; kw++){
+                        int64_t h = (int64_t)(oh*s + kh) - (int64_t)p, w = (int64_t)(ow*s + kw) - (int64_t)p;
+                        if(h >= 0 && w >= 0 && h < (int64_t)H && w < (int64_t)W)
+                            dx[(c*H + h)*W + w] += 1.0/count;
+                    }
+            }
+}
+
+MU_TEST(test_pooling){
+    // (N, C, H, W) with (window, stride, padding)
+    uint64_t cases[3][7] = {
+        {2, 5, 7, 6, 3, 2, 1},
+        {1, 3, 4, 4, 2, 2, 0},
+        {3, 2, 5, 9, 3, 1, 1},
+    };
+    uint64_t t = 0, i;
+    uint8_t m;
+    
+    for(; t < 3; t++){
+        uint64_t* cd = cases[t];
+        uint64_t N = cd[0], C = cd[1], H = cd[2], W = cd[3], k = cd[4], s = cd[5], p = cd[6];
+        uint64_t OH = (H + 2*p - k)/s + 1, OW = (W + 2*p - k)/s + 1;
+        NDArray* x = nda_alloc(nda_newShape(4, N, C, H, W));
+        NDArray* xt = nda_alloc(nda_newShape(4, N, H, W, C));
+        for(i = 0; i < x->shape->raw_len; i++){
+            uint64_t n = i/(C*H*W), c = (i/(H*W))%C, hw = i%(H*W);
+            x->data[i] = sinf(i*0.71f);
+            xt->data[(n*H*W + hw)*C + c] = x->data[i];
+        }
+        
+        uint64_t len = N*C*OH*OW;
+        for(m = 0; m < 2; m++){
+            TBPoolingOperationType type = m ? TBPOT_MAX : TBPOT_AVG;
+            double* y = calloc(len, sizeof(double));
+            double* dx = calloc(x->shape->raw_len, sizeof(double));
+            _test_pool2d(x->data, cd, k, s, p, m, y, dx);
+            
+            TBNode* xn = tb_newConstantNode(x);
+            TBGraph* graph = tb_newGraph("pool_nchw", tb_newPoolingOpNode(type, xn, TBCL_NCHW, k, k, s, s, p, p));
+            TBNode* nhwc = tb_newPoolingOpNode(type, tb_newConstantNode(xt), TBCL_NHWC, k, k, s, s, p, p);
+            TBGraphSession* session = tb_createLocalCPUSession();
+            TBResultNode* r = tb_runSession(session, graph, NULL);
+            TBResultNode* rt = tb_runSession(NULL, tb_newGraph("pool_nhwc", nhwc), NULL);
+            mu_check(r->error == NULL && rt->error == NULL);
+            mu_check(r->value->shape->dims[2] == OH && r->value->shape->dims[3] == OW && rt->value->shape->dims[3] == C);
+            
+            for(i = 0; i < len; i++){
+                uint64_t n = i/(C*OH*OW), c = (i/(OH*OW))%C, hw = i%(OH*OW);
+                mu_check(fabs(r->value->data[i] - y[i]) < 1e-5);
+                mu_check(fabs(rt->value->data[(n*OH*OW + hw)*C + c] - y[i]) < 1e-5);
+            }
+            
+            // max pooling scatters to the recorded maxima, average pooling spreads over the unpadded window
+            tb_autogradGraph(session, graph);
+            TBResultNode* gx = tb_sessionGetDiff(session, graph, xn);
+            for(i = 0; i < x->shape->raw_len; i++)
+                mu_check(fabs(gx->value->data[i] - dx[i]) < 1e-5);
+            tb_freeSession(session);
+            
+            TBPreparedRun* run = tb_prepareRun(NULL, graph);
+            TBResultNode* prep = tb_runPrepared(run);
+            mu_check(prep->error == NULL && fabs(prep->value->data[len - 1] - y[len - 1]) < 1e-5);
+            tb_freePreparedRun(run);
+            
+            free(y);
+            free(dx);
+        }
+        
+        // global poolings reduce each channel to a single pixel
+        TBResultNode* gmax = tb_runSession(NULL, tb_newGraph("gmax", tb_newPoolingOpNode(TBPOT_GLOBAL_MAX, tb_newConstantNode(xt), TBCL_NHWC, 0, 0, 0, 0, 0, 0)), NULL);
+        TBResultNode* gavg = tb_runSession(NULL, tb_newGraph("gavg", tb_newPoolingOpNode(TBPOT_GLOBAL_AVG, tb_newConstantNode(x), TBCL_NCHW, 0, 0, 0, 0, 0, 0)), NULL);
+        mu_check(gmax->error == NULL && gavg->error == NULL);
+        mu_check(gmax->value->shape->dims[1] == 1 && gmax->value->shape->dims[3] == C && gavg->value->shape->dims[1] == C);
+        for(i = 0; i < N*C; i++){
+            double mx = -INFINITY, sum = 0;
+            uint64_t j;
+            for(j = 0; j < H*W; j++){
+                mx = fmax(mx, x->data[i*H*W + j]);
+                sum += x->data[i*H*W + j];
+            }
+            mu_check(fabs(gmax->value->data[i] - mx) < 1e-6);
+            mu_check(fabs(gavg->value->data[i] - sum/(H*W)) < 1e-5);
+        }
+    }
+    
+    // padding must be smaller than the window
+    NDArray* x = nda_alloc(nda_newShape(4, 1, 2, 5, 5));
+    TBGraph* bad = tb_newGraph("bad_pool", tb_newPoolingOpNode(TBPOT_MAX, tb_newConstantNode(x), TBCL_NCHW, 2, 2, 1, 1, 2, 2));
+    mu_check(tb_runSession(NULL, bad, NULL)->error != NULL);
+    
+    // kernels called on such windows write 0 and propagate nothing, instead of dividing by an empty window
+    for(m = 0; m < 2; m++){
+        TBNode* pool = tb_newPoolingOpNode(m ? TBPOT_MAX : TBPOT_AVG, tb_newConstantNode(x), TBCL_NCHW, 1, 1, 1, 1, 1, 1);
+        TBPoolingOperation* pop = (TBPoolingOperation*)pool->nodePtr;
+        NDArray* y = nda_alloc(nda_newShape(4, 1, 2, 7, 7));
+        NDArray* dx = nda_alloc(nda_copyShape(x->shape));
+        for(i = 0; i < x->shape->raw_len; i++)
+            x->data[i] = 1 + i;
+        for(i = 0; i < y->shape->raw_len; i++)
+            y->data[i] = 1;
+        
+        _tb_poolingInto(NULL, pop, y, x, NULL);
+        mu_check(y->data[0] == 0 && y->data[8] == 1 && y->data[48] == 0);
+        _tb_poolingGradInto(NULL, pop, dx, x, NULL, y);
+        for(i = 0; i < dx->shape->raw_len; i++)
+            mu_check(isfinite(dx->data[i]) && (dx->data[i] == x->data[i]));
+        
+        nda_free(y);
+        free(y);
+        nda_free(dx);
+        free(dx);
+    }
+}
+
+// conv -> relu -> max pool -> conv
+static TBNode* _test_convNet(NDArray* x, NDArray* w1, NDArray* w2, TBConvolutionLayout layout, TBNode** xn){
+    *xn = tb_newConstantNode(x);
+    TBNode* c1 = tb_newConvolutionOpNode(*xn, tb_newConstantNode(w1), layout, 1, 1, 1, 1, 1, 1, 1);
+    TBNode* pool = tb_newPoolingOpNode(TBPOT_MAX, tb_newUnaryOpNode(TBUOT_RELU, c1), layout, 2, 2, 2, 2, 0, 0);
+    
+    return tb_newConvolutionOpNode(pool, tb_newConstantNode(w2), layout, 1, 1, 1, 1, 1, 1, 1);
+}
+
+MU_TEST(test_blocked_layout){
+    uint64_t i, l;
+    
+    // NCHW -> NCHWc -> NHWC is the plain NCHW -> NHWC permutation
+    NDArray* img = nda_alloc(nda_newShape(4, 2, 8, 3, 5));
+    for(i = 0; i < img->shape->raw_len; i++)
+        img->data[i] = (tb_float)i;
+    TBNode* blocked = tb_newReorderOpNode(tb_newConstantNode(img), TBCL_NCHW, TBCL_NCHWC, 4);
+    TBResultNode* rb = tb_runSession(NULL, tb_newGraph("to_blocked", blocked), NULL);
+    TBResultNode* rt = tb_runSession(NULL, tb_newGraph("to_nhwc", tb_newReorderOpNode(blocked, TBCL_NCHWC, TBCL_NHWC, 4)), NULL);
+    mu_check(rb->error == NULL && rt->error == NULL);
+    mu_check(rb->value->shape->rank == 5 && rb->value->shape->dims[1] == 2 && rb->value->shape->dims[4] == 4);
+    for(i = 0; i < img->shape->raw_len; i++){
+        uint64_t n = i/120, c = (i/15)%8, h = (i/5)%3, w = i%5;
+        mu_check(rb->value->data[(((n*2 + c/4)*3 + h)*5 + w)*4 + c%4] == img->data[i]);
+        mu_check(rt->value->data[((n*3 + h)*5 + w)*8 + c] == img->data[i]);
+    }
+    mu_check(tb_runSession(NULL, tb_newGraph("bad_reorder", tb_newReorderOpNode(tb_newConstantNode(img), TBCL_NCHW, TBCL_NCHWC, 3)), NULL)->error != NULL);
+    
+    for(l = TBCL_NCHW; l <= TBCL_NHWC; l++){
+        TBConvolutionLayout layout = (TBConvolutionLayout)l;
+        NDArray* x = nda_alloc((layout == TBCL_NCHW) ? nda_newShape(4, 2, 8, 9, 7) : nda_newShape(4, 2, 9, 7, 8));
+        NDArray* w1 = nda_alloc(nda_newShape(4, 16, 8, 3, 3));
+        NDArray* w2 = nda_alloc(nda_newShape(4, 8, 16, 3, 3));
+        for(i = 0; i < x->shape->raw_len; i++)
+            x->data[i] = sinf(i*0.29f);
+        for(i = 0; i < w1->shape->raw_len; i++)
+            w1->data[i] = cosf(i*0.41f)/8;
+        for(i = 0; i < w2->shape->raw_len; i++)
+            w2->data[i] = sinf(i*0.17f)/8;
+        
+        // read twice by a plain ADD, one reorder enters the blocked region and one leaves it
+        TBNode* xn;
+        TBNode* net = _test_convNet(x, w1, w2, layout, &xn);
+        TBGraph* graph = tb_newGraph("plain", tb_newBinaryOpNode(TBBOT_ADD, net, net));
+        TBGraph* fast = tb_blockGraphLayouts(graph, 4, "blocked");
+        tb_compileGraph(fast);
+        
+        uint64_t reorders = 0, convs = 0;
+        for(i = 0; i < (uint64_t)fast->nodes.length; i++){
+            TBNode* node = fast->nodes.data[i];
+            reorders += (node->type == TBNT_REORDER);
+            convs += (node->type == TBNT_CONVOLUTION) && (((TBConvolutionOperation*)node->nodePtr)->layout == TBCL_NCHWC);
+        }
+        mu_check(reorders == 2 && convs == 2);
+        
+        TBResultNode* r = tb_runSession(NULL, graph, NULL);
+        TBResultNode* rf = tb_runSession(NULL, fast, NULL);
+        mu_check(r->error == NULL && rf->error == NULL);
+        mu_check(r->value->shape->raw_len == rf->value->shape->raw_len && rf->value->shape->rank == 4);
+        for(i = 0; i < r->value->shape->raw_len; i++)
+            mu_check(fabs(r->value->data[i] - rf->value->data[i]) < 1e-4);
+        
+        TBPreparedRun* run = tb_prepareRun(NULL, fast);
+        TBResultNode* prep = tb_runPrepared(run);
+        mu_check(prep->error == NULL && fabs(prep->value->data[5] - r->value->data[5]) < 1e-4);
+        tb_freePreparedRun(run);
+        
+        // derivatives flow back through the blocked nodes to the plain input
+        TBGraph* grad = tb_newGraph("plain_grad", _test_convNet(x, w1, w2, layout, &xn));
+        TBGraph* fast_grad = tb_blockGraphLayouts(grad, 4, "blocked_grad");
+        TBNode* fx = fast_grad->root;
+        while(fx->type != TBNT_CONSTANT){
+            switch(fx->type){
+                case TBNT_REORDER: fx = ((TBReorderOperation*)fx->nodePtr)->uhs; break;
+                case TBNT_CONVOLUTION: fx = ((TBConvolutionOperation*)fx->nodePtr)->uhs; break;
+                case TBNT_POOLING: fx = ((TBPoolingOperation*)fx->nodePtr)->uhs; break;
+                default: fx = ((TBUnaryOperation*)fx->nodePtr)->uhs; break;
+            }
+        }
+        TBGraphSession* ref = tb_createLocalCPUSession();
+        TBGraphSession* session = tb_createLocalCPUSession();
+        tb_runSession(ref, grad, NULL);
+        tb_runSession(session, fast_grad, NULL);
+        tb_autogradGraph(ref, grad);
+        tb_autogradGraph(session, fast_grad);
+        TBResultNode* gx = tb_sessionGetDiff(ref, grad, xn);
+        TBResultNode* gfx = tb_sessionGetDiff(session, fast_grad, fx);
+        mu_check(gx != NULL && gfx != NULL);
+        for(i = 0; i < x->shape->raw_len; i++)
+            mu_check(fabs(gx->value->data[i] - gfx->value->data[i]) < 1e-4);
+        tb_freeSession(ref);
+        tb_freeSession(session);
+    }
+}
+
+MU_TEST(test_packed_weights){
+    uint64_t M = 5, K = 37, N = 45;
+    uint64_t i, j, k;
+    NDArray* x = nda_alloc(nda_newShape(2, K, M));
+    NDArray* w = nda_alloc(nda_newShape(2, K, N));
+    for(i = 0; i < x->shape->raw_len; i++)
+        x->data[i] = sinf(i*0.13f);
+    for(i = 0; i < w->shape->raw_len; i++)
+        w->data[i] = cosf(i*0.07f);
+    
+    // strided LHS, small enough for the packed kernel
+    TBNode* wn = tb_newConstantNode(w);
+    TBGraph* graph = tb_newGraph("packed", tb_newBinaryOpNode(TBBOT_DOT, tb_newTransposeOpNode(tb_newConstantNode(x), 0, 1), wn));
+    TBGraphSession* session = tb_createLocalCPUSession();
+    uint8_t round = 0;
+    
+    for(; round < 3; round++){
+        // the weights change in place before the last run
+        if(round == 2){
+            for(i = 0; i < w->shape->raw_len; i++)
+                w->data[i] = sinf(i*0.05f);
+            tb_constantChanged(wn);
+        }
+        
+        TBResultNode* r = tb_runSession(session, graph, NULL);
+        mu_check(r->error == NULL && r->value->shape->dims[0] == M && r->value->shape->dims[1] == N);
+        for(i = 0; i < M; i++)
+            for(j = 0; j < N; j++){
+                double acc = 0;
+                for(k = 0; k < K; k++)
+                    acc += x->data[k*M + i]*w->data[k*N + j];
+                mu_check(fabs(r->value->data[i*N + j] - acc) < 1e-4);
+            }
+        
+        mu_check(session->packs.length == 1 && session->packs.data[0]->version == ((round == 2) ? 1 : 0));
+    }
+    
+    // prepared runs of the session reuse the packed weights
+    TBPackedMatrix* packed = session->packs.data[0]->packed;
+    TBPreparedRun* run = tb_prepareRun(session, graph);
+    TBResultNode* prep = tb_runPrepared(run);
+    mu_check(prep->error == NULL && session->packs.length == 1 && session->packs.data[0]->packed == packed);
+    double acc = 0;
+    for(k = 0; k < K; k++)
+        acc += x->data[k*M + M - 1]*w->data[k*N + N - 1];
+    mu_check(fabs(prep->value->data[M*N - 1] - acc) < 1e-4);
+    
+    // the step keeps the packs resolved when planning, changed weights are repacked on the next run
+    mu_check(run->steps[run->root].packs == session->packs.data[0]);
+    for(i = 0; i < w->shape->raw_len; i++)
+        w->data[i] = cosf(i*0.03f);
+    tb_constantChanged(wn);
+    prep = tb_runPrepared(run);
+    mu_check(prep->error == NULL && session->packs.length == 1 && session->packs.data[0]->version == 2);
+    mu_check(run->steps[run->root].packs == session->packs.data[0]);
+    acc = 0;
+    for(k = 0; k < K; k++)
+        acc += x->data[k*M + M - 1]*w->data[k*N + N - 1];
+    mu_check(fabs(prep->value->data[M*N - 1] - acc) < 1e-4);
+    tb_freePreparedRun(run);
+    tb_freeSession(session);
+    
+    // large LHS are left to BLAS
+    NDArray* big = nda_alloc(nda_newShape(2, 128, K));
+    TBGraphSession* blas = tb_createLocalCPUSession();
+    TBResultNode* rb = tb_runSession(blas, tb_newGraph("unpacked", tb_newBinaryOpNode(TBBOT_DOT, tb_newConstantNode(big), tb_newConstantNode(w))), NULL);
+    mu_check(rb->error == NULL && blas->packs.length == 0);
+    tb_freeSession(blas);
+}
+
+MU_TEST(test_gemm){
+    uint64_t M = 37, N = 53, K = 300;
+    uint64_t i, j, k;
+    uint8_t ta, tb;
+    tb_float* A = calloc(M*K, sizeof(tb_float));
+    tb_float* B = calloc(K*N, sizeof(tb_float));
+    tb_float* C = calloc(M*N, sizeof(tb_float));
+    tb_float* bias = calloc(N, sizeof(tb_float));
+    for(i = 0; i < M*K; i++)
+        A[i] = sinf(i*0.11f);
+    for(i = 0; i < K*N; i++)
+        B[i] = cosf(i*0.03f);
+    for(j = 0; j < N; j++)
+        bias[j] = 0.5f - j*0.02f;
+    
+    // every micro-kernel the CPU runs and every transposition, with the reduction spanning two cache blocks and
+    // partial register tiles
+    uint32_t masks[3] = {NDA_CPU_ALL, NDA_CPU_AVX2 | NDA_CPU_FMA, 0};
+    uint64_t f = 0;
+    for(f = 0; f < 3; f++){
+        uint32_t previous = nda_cpuRestrictFeatures(masks[f]);
+        
+        for(ta = 0; ta < 2; ta++)
+            for(tb = 0; tb < 2; tb++){
+                for(i = 0; i < M*N; i++)
+                    C[i] = i*0.01f;
+                tb_gemm(NULL, 2, ta, tb, M, N, K, 0.5f, A, ta ? M : K, B, tb ? K : N, 2.0f, C, N, NULL);
+                
+                for(i = 0; i < M; i++)
+                    for(j = 0; j < N; j++){
+                        double acc = 0;
+                        for(k = 0; k < K; k++)
+                            acc += (ta ? A[k*M + i] : A[i*K + k])*(tb ? B[j*K + k] : B[k*N + j]);
+                        mu_check(fabs(C[i*N + j] - (0.5*acc + 2.0*(i*N + j)*0.01f)) < 1e-3);
+                    }
+            }
+        
+        nda_cpuRestrictFeatures(previous);
+    }
+    
+    // beta 0 ignores NaN outputs, bias and ReLU are fused
+    TBGemmEpilogue epilogue = {bias, TBGA_RELU};
+    for(i = 0; i < M*N; i++)
+        C[i] = NAN;
+    tb_gemm(NULL, 0, 0, 0, M, N, K, 1.0f, A, K, B, N, 0, C, N, &epilogue);
+    for(i = 0; i < M; i++)
+        for(j = 0; j < N; j++){
+            double acc = bias[j];
+            for(k = 0; k < K; k++)
+                acc += A[i*K + k]*B[k*N + j];
+            mu_check(fabs(C[i*N + j] - ((acc > 0) ? acc : 0)) < 1e-3);
+        }
+    
+    // column-major CBLAS calls map to the transposed product
+    tb_cblasGemm(CblasColMajor, CblasNoTrans, CblasNoTrans, N, M, K, 1.0f, B, N, A, K, 0, C, N);
+    double acc = 0;
+    for(k = 0; k < K; k++)
+        acc += A[(M - 1)*K + k]*B[k*N + N - 1];
+    mu_check(fabs(C[M*N - 1] - acc) < 1e-3);
+    
+    free(A);
+    free(B);
+    free(C);
+    free(bias);
+    
+    // the workers of a pool split the output tiles, each tile is reduced as on a single thread
+    uint64_t S = 192;
+    TBThreadPool* pool = tb_newThreadPool();
+    A = calloc(S*S, sizeof(tb_float));
+    B = calloc(S*S, sizeof(tb_float));
+    C = calloc(S*S, sizeof(tb_float));
+    tb_float* D = calloc(S*S, sizeof(tb_float));
+    for(i = 0; i < S*S; i++){
+        A[i] = sinf(i*0.07f);
+        B[i] = cosf(i*0.05f);
+    }
+    
+    tb_gemm(NULL, 1, 0, 0, S, S, S, 1.0f, A, S, B, S, 0, D, S, NULL);
+    for(k = 0; k < 2; k++){
+        tb_gemm(pool, 4, 0, 0, S, S, S, 1.0f, A, S, B, S, 0, C, S, NULL);
+        mu_check(memcmp(C, D, S*S*sizeof(tb_float)) == 0);
+    }
+    
+    tb_freeThreadPool(pool);
+    free(A);
+    free(B);
+    free(C);
+    free(D);
+}
+
+MU_TEST(test_qgemm){
+    uint64_t M = 29, N = 37, K = 523;
+    uint64_t i, j, k, f;
+    uint8_t* A = calloc(M*K, sizeof(uint8_t));
+    int8_t* B = calloc(K*N, sizeof(int8_t));
+    float scales[37];
+    tb_float* C = calloc(M*N, sizeof(tb_float));
+    uint8_t* Q = calloc(M*N, sizeof(uint8_t));
+    uint8_t* R = calloc(M*N, sizeof(uint8_t));
+    int32_t za = 131;
+    for(i = 0; i < M*K; i++)
+        A[i] = (uint8_t)((i*37 + 11) % 256);
+    for(i = 0; i < K*N; i++)
+        B[i] = (int8_t)((int)((i*53 + 7) % 256) - 128);
+    for(j = 0; j < N; j++)
+        scales[j] = 0.001f + j*1e-4f;
+    
+    // every micro-kernel the CPU runs, on full range operands stored as a (N, K) matrix and packed on each call
+    // or once, against exact int32 accumulators
+    TBQGemmPacked* packed = tb_qgemmPack(B, 1, K, K, N);
+    uint32_t masks[4] = {NDA_CPU_ALL, NDA_CPU_AVX2 | NDA_CPU_AVXVNNI, NDA_CPU_AVX2, 0};
+    for(f = 0; f < 4; f++){
+        uint32_t previous = nda_cpuRestrictFeatures(masks[f]);
+        TBQGemmOutput out = {NDA_DTYPE_FLOAT, C, N, 0.02f, scales, 1, 0, 0};
+        
+        tb_qgemm(NULL, 2, M, N, K, A, K, za, B, 1, K, (f % 2) ? packed : NULL, &out);
+        for(i = 0; i < M; i++)
+            for(j = 0; j < N; j++){
+                int32_t acc = 0;
+                for(k = 0; k < K; k++)
+                    acc += ((int32_t)A[i*K + k] - za)*(int32_t)B[j*K + k];
+                mu_check(C[i*N + j] == (float)acc*0.02f*scales[j]);
+            }
+        
+        // requantized outputs match the portable kernel
+        TBQGemmOutput qout = {NDA_DTYPE_U8, (f == 3) ? R : Q, N, 0.02f, scales, 0, 1.0f/0.5f, 100};
+        tb_qgemm(NULL, 0, M, N, K, A, K, za, B, 1, K, packed, &qout);
+        
+        nda_cpuRestrictFeatures(previous);
+    }
+    mu_check(memcmp(Q, R, M*N) == 0);
+    
+    tb_qgemmFreePacked(packed);
+    free(A);
+    free(B);
+    free(C);
+    free(Q);
+    free(R);
+    
+    // the workers of a pool split the output tiles
+    uint64_t S = 128;
+    TBThreadPool* pool = tb_newThreadPool();
+    A = calloc(S*S, sizeof(uint8_t));
+    B = calloc(S*S, sizeof(int8_t));
+    C = calloc(S*S, sizeof(tb_float));
+    tb_float* D = calloc(S*S, sizeof(tb_float));
+    for(i = 0; i < S*S; i++){
+        A[i] = (uint8_t)(i*7 % 251);
+        B[i] = (int8_t)((int)(i*13 % 255) - 127);
+    }
+    
+    TBQGemmOutput out = {NDA_DTYPE_FLOAT, D, S, 0.1f, scales, 0, 0, 0};
+    tb_qgemm(NULL, 1, S, S, S, A, S, 3, B, S, 1, NULL, &out);
+    out.C = C;
+    for(k = 0; k < 2; k++){
+        tb_qgemm(pool, 4, S, S, S, A, S, 3, B, S, 1, NULL, &out);
+        mu_check(memcmp(C, D, S*S*sizeof(tb_float)) == 0);
+    }
+    
+    tb_freeThreadPool(pool);
+    free(A);
+    free(B);
+    free(C);
+    free(D);
+}
+
+MU_TEST(test_small_dot){
+    uint64_t M = 7, K = 13, N = 45;
+    uint64_t i, j, k;
+    uint8_t tl, tr;
+    NDArray* a = nda_alloc(nda_newShape(2, M, K));
+    NDArray* at = nda_alloc(nda_newShape(2, K, M));
+    NDArray* b = nda_alloc(nda_newShape(2, K, N));
+    NDArray* bt = nda_alloc(nda_newShape(2, N, K));
+    for(i = 0; i < M; i++)
+        for(k = 0; k < K; k++)
+            a->data[i*K + k] = at->data[k*M + i] = sinf((i*K + k)*0.17f);
+    for(k = 0; k < K; k++)
+        for(j = 0; j < N; j++)
+            b->data[k*N + j] = bt->data[j*K + k] = cosf((k*N + j)*0.09f);
+    
+    // row tiles of 4 and 1, column tiles of 32, 8 and 1, operands given as transposed views, fed weights are not prepacked,
+    // with the AVX2 kernels and the portable ones
+    uint32_t masks[2] = {NDA_CPU_ALL, 0};
+    uint64_t f = 0;
+    for(f = 0; f < 2; f++){
+        uint32_t previous = nda_cpuRestrictFeatures(masks[f]);
+        
+        for(tl = 0; tl < 2; tl++)
+            for(tr = 0; tr < 2; tr++){
+                TBNode* lhs = tl ? tb_newTransposeOpNode(tb_newConstantNode(at), 0, 1) : tb_newConstantNode(a);
+                TBNode* rhs = tr ? tb_newTransposeOpNode(tb_newConstantNode(bt), 0, 1) : tb_newVarNode("b");
+                TBGraphNodeParam param = {tb_newConstantNode(b), "b"};
+                TBGraphNodeParam end = {NULL, NULL};
+                TBGraphNodeParam* params[] = {&param, &end};
+                TBGraphSession* session = tb_createLocalCPUSession();
+                TBResultNode* r = tb_runSession(session, tb_newGraph("small", tb_newBinaryOpNode(TBBOT_DOT, lhs, rhs)), params);
+                mu_check(r->error == NULL && r->value->shape->dims[0] == M && r->value->shape->dims[1] == N);
+                
+                for(i = 0; i < M; i++)
+                    for(j = 0; j < N; j++){
+                        double acc = 0;
+                        for(k = 0; k < K; k++)
+                            acc += a->data[i*K + k]*b->data[k*N + j];
+                        mu_check(fabs(r->value->data[i*N + j] - acc) < 1e-4);
+                    }
+                tb_freeSession(session);
+            }
+        
+        nda_cpuRestrictFeatures(previous);
+    }
+}
+
+MU_TEST(test_profiler){
+    NDArray* w = nda_linspace(-1, 1, 3*4);
+    nda_reshape(w, nda_newShape(2, 3, 4));
+    NDArray* x = nda_linspace(0, 1, 2*3);
+    nda_reshape(x, nda_newShape(2, 2, 3));
+    
+    // relu(x . w)
+    TBNode* dot = tb_newBinaryOpNode(TBBOT_DOT, tb_newVarNode("x"), tb_newConstantNode(w));
+    TBGraph* g = tb_newGraph("profiled", tb_newUnaryOpNode(TBUOT_RELU, dot));
+    TBGraphNodeParam param = {tb_newConstantNode(x), "x"};
+    TBGraphNodeParam end = {NULL, NULL};
+    TBGraphNodeParam* params[] = {&param, &end};
+    
+    // disabled by default
+    TBGraphSession* session = tb_createLocalCPUSession();
+    mu_check(tb_sessionGetProfiler(session) == NULL);
+    mu_check(tb_runSession(session, g, params)->error == NULL);
+    
+    tb_sessionSetProfiling(session, 1);
+    TBProfiler* profiler = tb_sessionGetProfiler(session);
+    mu_check(profiler != NULL);
+    mu_check(tb_runSession(session, g, params)->error == NULL);
+    
+    // variables and constants are not recorded, the DOT product ends first and is nested in the ReLU
+    mu_assert_int_eq(2, profiler->events_len);
+    TBProfileEvent* d = profiler->events;
+    TBProfileEvent* r = profiler->events + 1;
+    mu_check(strcmp(d->op, "DOT") == 0);
+    mu_check(strcmp(r->op, "RELU") == 0);
+    mu_assert_int_eq(2*2*4*3, d->flops);
+    mu_assert_int_eq(2*4, r->flops);
+    mu_assert_int_eq(2*4*sizeof(tb_float), r->bytes);
+    mu_assert_int_eq(2, d->rank);
+    mu_assert_int_eq(4, d->dims[1]);
+    mu_check(d->self <= d->duration && r->self <= r->duration);
+    mu_check(r->start <= d->start && r->duration >= d->duration);
+    mu_check(!d->prepared);
+    
+    // prepared runs record their steps without allocations
+    tb_profilerClear(profiler);
+    TBPreparedRun* run = tb_prepareRun(session, g);
+    tb_preparedBindInput(run, tb_graphGetVarSlot(g, "x"), x);
+    mu_check(tb_runPrepared(run)->error == NULL);
+    mu_check(profiler->events_len >= 1);
+    uint64_t i, dots = 0;
+    for(i = 0; i < profiler->events_len; i++){
+        mu_check(profiler->events[i].prepared);
+        mu_assert_int_eq(0, profiler->events[i].bytes);
+        dots += (strcmp(profiler->events[i].op, "DOT") == 0) && (profiler->events[i].flops == 2*2*4*3);
+    }
+    mu_assert_int_eq(1, dots);
+    
+    FILE* f = tmpfile();
+    tb_profilerWriteTrace(profiler, f);
+    tb_profilerWriteSummary(profiler, f, 0);
+    char text[4096] = {0};
+    rewind(f);
+    mu_check(fread(text, 1, sizeof(text) - 1, f) > 0);
+    fclose(f);
+    mu_check(strstr(text, "\"traceEvents\"") != NULL);
+    mu_check(strstr(text, "\"name\": \"DOT\"") != NULL);
+    mu_check(strstr(text, "Profile: ") != NULL);
+    
+    tb_freePreparedRun(run);
+    
+    tb_sessionSetProfiling(session, 0);
+    mu_check(tb_sessionGetProfiler(session) == NULL);
+    mu_check(tb_runSession(session, g, params)->error == NULL);
+    tb_freeSession(session);
+}
+
+MU_TEST(test_memory_accounting){
+    uint64_t sz = sizeof(tb_float);
+    NDMemCounters base = nda_memCounters(NULL);
+    NDArray* a = nda_alloc(nda_newShape(1, 1000));
+    NDMemCounters c = nda_memCounters(NULL);
+    mu_assert_int_eq(base.current + 1000*sz, c.current);
+    mu_assert_int_eq(base.live + 1, c.live);
+    mu_check(c.peak >= c.current && c.total >= base.total + 1000*sz);
+    nda_free(a);
+    free(a);
+    mu_assert_int_eq(base.current, nda_memCounters(NULL).current);
+    
+    // trackers are charged along with their parents, frees are credited whatever the current tracker
+    NDMemTracker* parent = nda_newMemTracker(NULL);
+    NDMemTracker* child = nda_newMemTracker(parent);
+    NDMemTracker* previous = nda_memSetTracker(child);
+    mu_check(nda_memGetTracker() == child);
+    a = nda_alloc(nda_newShape(1, 100));
+    NDArray* b = nda_alloc(nda_newShape(1, 50));
+    nda_memSetTracker(previous);
+    nda_free(a);
+    free(a);
+    
+    c = nda_memCounters(child);
+    mu_assert_int_eq(50*sz, c.current);
+    mu_assert_int_eq(150*sz, c.peak);
+    mu_assert_int_eq(150*sz, c.total);
+    mu_assert_int_eq(2, c.allocations);
+    mu_assert_int_eq(1, c.live);
+    mu_assert_int_eq(50*sz, nda_memCounters(parent).current);
+    
+    // released trackers live as long as their buffers
+    nda_releaseMemTracker(child);
+    nda_free(b);
+    free(b);
+    mu_assert_int_eq(0, nda_memCounters(parent).current);
+    mu_assert_int_eq(0, nda_memCounters(parent).live);
+    nda_memResetPeak(parent);
+    mu_assert_int_eq(0, nda_memCounters(parent).peak);
+    nda_releaseMemTracker(parent);
+    
+    // relu(x . w), allocations are charged to the evaluating node
+    base = nda_memCounters(NULL);
+    NDArray* w = nda_linspace(-1, 1, 3*4);
+    nda_reshape(w, nda_newShape(2, 3, 4));
+    NDArray* x = nda_linspace(0, 1, 2*3);
+    nda_reshape(x, nda_newShape(2, 2, 3));
+    TBNode* dot = tb_newBinaryOpNode(TBBOT_DOT, tb_newConstantNode(x), tb_newConstantNode(w));
+    TBNode* relu = tb_newUnaryOpNode(TBUOT_RELU, dot);
+    TBGraph* g = tb_newGraph("accounted", relu);
+    
+    TBGraphSession* session = tb_createLocalCPUSession();
+    mu_assert_int_eq(0, tb_sessionMemory(session).total);
+    FILE* leaks = tmpfile();
+    tb_sessionTrackMemory(session, leaks);
+    TBResultNode* kept = tb_runSession(session, g, NULL);
+    mu_check(kept->error == NULL);
+    
+    // the DOT product output is freed by the ReLU, the packed weights and the copy and derivative kept by the
+    // run context remain
+    c = tb_sessionNodeMemory(session, g, dot);
+    mu_assert_int_eq(2*4*sz, c.total - c.current);
+    mu_assert_int_eq(3, c.live);
+    NDMemCounters r = tb_sessionNodeMemory(session, g, relu);
+    mu_assert_int_eq(3*2*4*sz, r.current);
+    mu_assert_int_eq(3, r.live);
+    
+    // constants are not copied, they only hold their derivative
+    NDMemCounters s = tb_sessionMemory(session);
+    mu_assert_int_eq(c.current + r.current + (6 + 12)*sz, s.current);
+    mu_check(s.peak >= s.current && s.total >= c.total + r.total);
+    
+    char text[4096] = {0};
+    FILE* f = tmpfile();
+    tb_sessionWriteMemoryReport(session, f);
+    rewind(f);
+    mu_check(fread(text, 1, sizeof(text) - 1, f) > 0);
+    fclose(f);
+    mu_check(strstr(text, "Memory: ") != NULL && strstr(text, "RELU") != NULL && strstr(text, "accounted") != NULL);
+    
+    // the result handed to the caller is still allocated when the session is freed
+    tb_freeSession(session);
+    memset(text, 0, sizeof(text));
+    rewind(leaks);
+    mu_check(fread(text, 1, sizeof(text) - 1, leaks) > 0);
+    fclose(leaks);
+    mu_check(strstr(text, "Session leaks ") != NULL);
+    mu_check(strstr(text, "(RELU) of graph `accounted`") != NULL);
+    mu_check(strstr(text, "(DOT)") == NULL);
+    
+    tb_freeResultNode(NULL, kept);
+    free(kept);
+    tb_freeGraph(g);
+    mu_assert_int_eq(base.current, nda_memCounters(NULL).current);
+    
+    // temporary graphs are freed along with their nodes
+    base = nda_memCounters(NULL);
+    TBResultNode* once = tb_runSessionNodeOnly(NULL, tb_newUnaryOpNode(TBUOT_RELU, tb_newConstantNode(nda_linspace(-1, 1, 8))));
+    mu_check(once->error == NULL);
+    mu_assert_int_eq(base.current + 8*sz, nda_memCounters(NULL).current);
+    tb_freeResultNode(NULL, once);
+    free(once);
+    mu_assert_int_eq(base.current, nda_memCounters(NULL).current);
+}
+
+MU_TEST(test_cost_model){
+    uint64_t sz = sizeof(tb_float);
+    
+    // softmax(relu(x . w1) . w2) for a batch of 8
+    TBNode* w1 = tb_newConstantNode(nda_alloc(nda_newShape(2, 64, 32)));
+    TBNode* w2 = tb_newConstantNode(nda_alloc(nda_newShape(2, 32, 10)));
+    TBNode* dot1 = tb_newBinaryOpNode(TBBOT_DOT, tb_newVarNode("x"), w1);
+    TBNode* relu = tb_newUnaryOpNode(TBUOT_RELU, dot1);
+    TBNode* dot2 = tb_newBinaryOpNode(TBBOT_DOT, relu, w2);
+    TBGraph* g = tb_newGraph("mlp_cost", tb_newAxisBoundOpNode(TBABOT_SOFTMAX, dot2, 1));
+    
+    uint64_t slot = tb_graphGetVarSlot(g, "x");
+    NDShape* inputs[] = {NULL};
+    inputs[slot] = nda_newShape(2, 8, 64);
+    
+    // 1 GFLOP/s and 1 GB/s, i.e one FLOP or one byte per nanosecond
+    TBRoofline roofline = {1, 1, 0};
+    TBGraphCost* cost = tb_estimateGraphCost(g, inputs, &roofline);
+    mu_check(cost->error == NULL);
+    mu_assert_int_eq(7, cost->nodes_len);
+    mu_assert_int_eq(6, cost->root);
+    
+    TBNodeCost* c = cost->nodes + 2;
+    mu_check(c->node == dot1 && strcmp(c->op, "DOT") == 0);
+    mu_check(c->lhs == 0 && c->rhs == 1 && c->aux == TB_NO_SLOT);
+    mu_assert_int_eq(2, c->shape->rank);
+    mu_assert_int_eq(8, c->shape->dims[0]);
+    mu_assert_int_eq(32, c->shape->dims[1]);
+    mu_assert_int_eq(2*8*32*64, c->flops);
+    mu_assert_int_eq((8*64 + 64*32)*sz, c->bytes_read);
+    mu_assert_int_eq(8*32*sz, c->bytes_written);
+    mu_assert_double_eq(2*8*32*64, c->ns);
+    mu_check(!c->memory_bound && c->intensity > 1);
+    
+    c = cost->nodes + 3;
+    mu_check(c->node == relu && c->memory_bound);
+    mu_assert_double_eq(2*8*32*sz, c->ns);
+    
+    c = cost->nodes + 6;
+    mu_check(strcmp(c->op, "SOFTMAX") == 0 && c->memory_bound);
+    mu_assert_int_eq(10, c->shape->dims[1]);
+    
+    mu_assert_int_eq(2*8*32*64 + 8*32 + 2*8*10*32 + 8*10, cost->flops);
+    double ns = 0;
+    uint64_t i;
+    for(i = 0; i < cost->nodes_len; i++)
+        ns += cost->nodes[i].ns;
+    mu_assert_double_eq(ns, cost->ns);
+    mu_assert_int_eq(0, cost->nodes[0].ns + cost->nodes[1].ns);
+    
+    FILE* f = tmpfile();
+    tb_writeGraphCost(cost, f);
+    char text[4096] = {0};
+    rewind(f);
+    mu_check(fread(text, 1, sizeof(text) - 1, f) > 0);
+    fclose(f);
+    mu_check(strstr(text, "Cost of `mlp_cost`") != NULL && strstr(text, "compute") != NULL);
+    tb_freeGraphCost(cost);
+    
+    // shape errors are reported on the faulty node, nothing is run
+    inputs[slot]->dims[1] = 63;
+    cost = tb_estimateGraphCost(g, inputs, NULL);
+    mu_check(cost->error != NULL && cost->root == TB_NO_SLOT);
+    mu_assert_int_eq(TBET_INCOMPATIBLE_DIMENTIONS_EXCEPTION, cost->error->errorType);
+    mu_check(cost->error->faultyNode == dot1);
+    tb_freeGraphCost(cost);
+    
+    cost = tb_estimateGraphCost(g, NULL, NULL);
+    mu_check(cost->error != NULL);
+    mu_assert_int_eq(TBET_VARIABLE_DOES_NOT_EXIST, cost->error->errorType);
+    tb_freeGraphCost(cost);
+    
+    // calibration from the output of tb_bench
+    char path[] = "/tmp/tb_bench_XXXXXX";
+    int fd = mkstemp(path);
+    mu_check(fd >= 0);
+    f = fdopen(fd, "w");
+    fprintf(f, "{\n  \"threads\": 0,\n  \"benchmarks\": [\n");
+    fprintf(f, "    {\"name\": \"tiny\", \"ns\": 100.000, \"flops\": 0, \"bytes\": 0, \"elements\": 1},\n");
+    fprintf(f, "    {\"name\": \"gemm\", \"ns\": 1100.000, \"flops\": 10000, \"bytes\": 100, \"elements\": 1},\n");
+    fprintf(f, "    {\"name\": \"copy\", \"ns\": 2100.000, \"flops\": 0, \"bytes\": 8000, \"elements\": 1},\n");
+    fprintf(f, "    {\"name\": \"short\", \"ns\": 300.000, \"flops\": 100000, \"bytes\": 0, \"elements\": 1}\n  ]\n}\n");
+    fclose(f);
+    
+    mu_check(tb_calibrateRoofline(path, &roofline));
+    mu_assert_double_eq(10, roofline.gflops);
+    mu_assert_double_eq(4, roofline.gbps);
+    mu_assert_double_eq(100, roofline.overhead);
+    unlink(path);
+    mu_check(!tb_calibrateRoofline(path, &roofline));
+    
+    free(inputs[slot]->dims);
+    free(inputs[slot]->strides);
+    free(inputs[slot]);
+    tb_freeGraph(g);
+}
+
+MU_TEST(test_shape_inference){
+    // softmax(relu(x . w1 + b) . w2) for a symbolic batch
+    TBNode* x = tb_newVarNode("x");
+    TBNode* dot1 = tb_newBinaryOpNode(TBBOT_DOT, x, tb_newConstantNode(nda_alloc(nda_newShape(2, 64, 32))));
+    TBNode* add = tb_newBinaryOpNode(TBBOT_ADD, dot1, tb_newConstantNode(nda_alloc(nda_newShape(2, 1, 32))));
+    TBNode* dot2 = tb_newBinaryOpNode(TBBOT_DOT, tb_newUnaryOpNode(TBUOT_RELU, add), tb_newConstantNode(nda_alloc(nda_newShape(2, 32, 10))));
+    TBNode* sum = tb_newAxisBoundOpNode(TBABOT_SUM, dot2, 0);
+    TBGraph* g = tb_newGraph("symbolic", tb_newAxisBoundOpNode(TBABOT_SOFTMAX, dot2, 1));
+    TBGraph* sg = tb_newGraph("batch_sum", sum);
+    sg->base = g;
+    
+    NDShape* inputs[] = {nda_newShape(2, TB_DIM_BATCH, 64)};
+    mu_assert_int_eq(0, tb_graphGetVarSlot(g, "x"));
+    mu_check(tb_graphNodeShape(g, dot2) == NULL);
+    mu_check(tb_inferGraphShapes(g, inputs) == NULL);
+    
+    NDShape* shape = tb_graphNodeShape(g, dot2);
+    mu_check(shape != NULL && tb_shapeIsSymbolic(shape));
+    mu_assert_int_eq(2, shape->rank);
+    mu_check(shape->dims[0] == TB_DIM_BATCH);
+    mu_assert_int_eq(10, shape->dims[1]);
+    mu_check(tb_graphNodeShape(g, add)->dims[0] == TB_DIM_BATCH);
+    mu_check(tb_graphNodeShape(g, x)->dims[0] == TB_DIM_BATCH);
+    mu_check(tb_shapeEquals(shape, tb_graphNodeShape(g, g->root)));
+    mu_check(!tb_shapeIsSymbolic(tb_graphNodeShape(g, ((TBBinaryOperation*)dot1->nodePtr)->rhs)));
+    
+    // reducing the batch axis leaves a concrete shape
+    mu_check(tb_inferGraphShapes(sg, inputs) == NULL);
+    shape = tb_graphNodeShape(sg, sum);
+    mu_check(!tb_shapeIsSymbolic(shape));
+    mu_assert_int_eq(1, shape->rank);
+    mu_assert_int_eq(10, shape->dims[0]);
+    
+    // symbols are resolved once known
+    uint64_t batch = 32;
+    NDShape* concrete = tb_concreteShape(tb_graphNodeShape(g, dot2), &batch, 1);
+    mu_assert_int_eq(32, concrete->dims[0]);
+    mu_assert_int_eq(320, concrete->raw_len);
+    free(concrete->dims);
+    free(concrete->strides);
+    free(concrete);
+    NDShape* other = nda_newShape(2, TB_SYMBOLIC_DIM(1), 4);
+    mu_check(tb_concreteShape(other, &batch, 1) == NULL);
+    
+    // shape errors are found before any computation, on the faulty node
+    TBNode* bad = tb_newBinaryOpNode(TBBOT_ADD, tb_newVarNode("x"), tb_newConstantNode(nda_alloc(nda_newShape(2, 8, 64))));
+    TBGraph* bg = tb_newGraph("bad_broadcast", bad);
+    TBError* error = tb_inferGraphShapes(bg, inputs);
+    mu_check(error != NULL && error->faultyNode == bad && error->graph == bg);
+    mu_assert_int_eq(TBET_INCOMPATIBLE_DIMENTIONS_EXCEPTION, error->errorType);
+    mu_check(strstr(error->message, "(?0, 64)") != NULL);
+    mu_check(tb_graphNodeShape(bg, bad) == NULL);
+    
+    // the same graph is fine for a concrete batch of 8
+    inputs[0]->dims[0] = 8;
+    mu_check(tb_inferGraphShapes(bg, inputs) == NULL);
+    mu_assert_int_eq(8, tb_graphNodeShape(bg, bad)->dims[0]);
+    
+    TBGraphShapes* shapes = tb_inferShapes(bg, NULL);
+    mu_check(shapes->error != NULL && shapes->root == TB_NO_SLOT);
+    mu_assert_int_eq(TBET_VARIABLE_DOES_NOT_EXIST, shapes->error->errorType);
+    tb_freeGraphShapes(shapes);
+    
+    // only the batch of images can be symbolic
+    NDShape* images[] = {nda_newShape(4, TB_DIM_BATCH, 3, 8, 8)};
+    TBNode* conv = tb_newConvolutionOpNode(tb_newVarNode("img"), tb_newConstantNode(nda_alloc(nda_newShape(4, 4, 3, 3, 3))),
+                                           TBCL_NCHW, 1, 1, 1, 1, 1, 1, 1);
+    TBGraph* cg = tb_newGraph("symbolic_conv", conv);
+    mu_check(tb_inferGraphShapes(cg, images) == NULL);
+    shape = tb_graphNodeShape(cg, conv);
+    mu_check(shape->dims[0] == TB_DIM_BATCH);
+    mu_assert_int_eq(4, shape->dims[1]);
+    mu_assert_int_eq(8, shape->dims[3]);
+    
+    images[0]->dims[2] = TB_SYMBOLIC_DIM(1);
+    error = tb_inferGraphShapes(cg, images);
+    mu_check(error != NULL && error->faultyNode == conv);
+    
+    // the cost model needs concrete shapes
+    inputs[0]->dims[0] = TB_DIM_BATCH;
+    TBGraphCost* cost = tb_estimateGraphCost(g, inputs, NULL);
+    mu_check(cost->error != NULL && cost->root == TB_NO_SLOT);
+    tb_freeGraphCost(cost);
+    
+    NDShape* all[] = {inputs[0], images[0], other};
+    uint64_t i;
+    for(i = 0; i < 3; i++){
+        free(all[i]->dims);
+        free(all[i]->strides);
+        free(all[i]);
+    }
+    
+    tb_freeGraph(cg);
+    tb_freeGraph(bg);
+    tb_freeGraph(sg);
+    tb_freeGraph(g);
+}
+
 MU_TEST_SUITE(nda_array_test) {
     MU_RUN_TEST(test_shape1);
     MU_RUN_TEST(test_shape2);
@@ -582,6 +2986,35 @@ MU_TEST_SUITE(tb_test) {
     MU_RUN_TEST(test_sum02);
     MU_RUN_TEST(test_max01);
     MU_RUN_TEST(test_min01);
+    MU_RUN_TEST(test_var_slots);
+    MU_RUN_TEST(test_argmax01);
+    MU_RUN_TEST(test_prepared_run);
+    MU_RUN_TEST(test_batcher);
+    MU_RUN_TEST(test_concurrent_sessions);
+    MU_RUN_TEST(test_session_transient_bindings);
+    MU_RUN_TEST(test_session_diff);
+    MU_RUN_TEST(test_archive);
+    MU_RUN_TEST(test_graph_serialization);
+    MU_RUN_TEST(test_half_precision);
+    MU_RUN_TEST(test_runtime_dtype);
+    MU_RUN_TEST(test_double_precision);
+    MU_RUN_TEST(test_quantized_dot);
+    MU_RUN_TEST(test_sparse_dot);
+    MU_RUN_TEST(test_gather);
+    MU_RUN_TEST(test_softmax);
+    MU_RUN_TEST(test_variance);
+    MU_RUN_TEST(test_normalization);
+    MU_RUN_TEST(test_convolution);
+    MU_RUN_TEST(test_pooling);
+    MU_RUN_TEST(test_blocked_layout);
+    MU_RUN_TEST(test_packed_weights);
+    MU_RUN_TEST(test_gemm);
+    MU_RUN_TEST(test_qgemm);
+    MU_RUN_TEST(test_small_dot);
+    MU_RUN_TEST(test_profiler);
+    MU_RUN_TEST(test_memory_accounting);
+    MU_RUN_TEST(test_cost_model);
+    MU_RUN_TEST(test_shape_inference);
 }
 
 void runAllTests(){
@@ -669,5 +3102,5 @@ int main(){
     runAllTests();
     //test();
     
-    return 0;
+    return minunit_fail != 0;
 }